@@ -468,7 +468,13 @@ void config_register_defaults(config_system *config) {
     config_set_int(config, "storage.innodb_log_file_size", 256, "InnoDB log file size in MB");
     config_set_int(config, "storage.innodb_log_files_in_group", 2, "Number of InnoDB log files in group");
     config_set_int(config, "storage.innodb_flush_log_at_trx_commit", 1, "InnoDB flush log at transaction commit");
-    
+    config_set_bool(config, "storage.wal_enabled", false, "Enable write-ahead log");
+    config_set_string(config, "storage.wal_dir", "./data/wal", "Write-ahead log directory");
+    config_set_int(config, "storage.wal_buffer_size", 16, "Write-ahead log buffer size in MB");
+    config_set_int(config, "storage.wal_segment_size", 64, "Write-ahead log segment size in MB");
+    config_set_int(config, "storage.wal_commit_delay_us", 0, "Group commit delay in microseconds");
+    config_set_int(config, "storage.checkpoint_interval", 300, "Checkpoint interval in seconds (0 disables background checkpoints)");
+
     // 内存配置
     config_set_int(config, "memory.memory_pool_size", 512, "Memory pool size in MB");
     config_set_int(config, "memory.cache_size", 256, "Cache size in MB");
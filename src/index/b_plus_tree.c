@@ -2,531 +2,2668 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-
-// 创建B+树节点
-BPlusTreeNode* b_plus_tree_create_node(BPlusTree* tree, NodeType type) {
-    BPlusTreeNode* node = (BPlusTreeNode*)malloc(sizeof(BPlusTreeNode));
-    if (!node) {
-        return NULL;
+#include <stddef.h>
+#include <sched.h>
+
+#define B_PLUS_TREE_ALIGN(size, alignment) (((size) + (alignment) - 1) & ~((size_t)(alignment) - 1))
+
+// 乐观读者不加锁读取节点，已发布节点中读者可能访问的内容（键数、键区、指针数组和叶子链表）
+// 都用原子操作读写，读到的值是否一致由版本号校验保证。标量用relaxed；指针用release/acquire，
+// 读者经指针访问的节点、键和值能看到发布前的初始化
+#define B_PLUS_TREE_LOAD(field) __atomic_load_n((field), __ATOMIC_RELAXED)
+#define B_PLUS_TREE_STORE(field, value) __atomic_store_n((field), (value), __ATOMIC_RELAXED)
+#define B_PLUS_TREE_LOAD_POINTER(field) __atomic_load_n((field), __ATOMIC_ACQUIRE)
+#define B_PLUS_TREE_STORE_POINTER(field, value) __atomic_store_n((field), (value), __ATOMIC_RELEASE)
+
+// 按宽度为type的单元原子地移动size字节（目标在源之后时从后向前复制，允许重叠）
+#define B_PLUS_TREE_MOVE_UNITS(type, dst, src, size) do { \
+    type* to_ = (type*)(dst); \
+    const type* from_ = (const type*)(src); \
+    size_t units_ = (size) / sizeof(type); \
+    if (to_ > from_) { \
+        for (size_t i_ = units_; i_ > 0; i_--) { \
+            B_PLUS_TREE_STORE(&to_[i_ - 1], B_PLUS_TREE_LOAD(&from_[i_ - 1])); \
+        } \
+    } else { \
+        for (size_t i_ = 0; i_ < units_; i_++) { \
+            B_PLUS_TREE_STORE(&to_[i_], B_PLUS_TREE_LOAD(&from_[i_])); \
+        } \
+    } \
+} while (0)
+
+// 原子地移动节点中的字节（代替memmove/memcpy），位置和长度对齐时按最大的对齐宽度复制
+static void b_plus_tree_move_bytes(void* dst, const void* src, size_t size) {
+    uintptr_t alignment = (uintptr_t)dst | (uintptr_t)src | (uintptr_t)size;
+    if (alignment % sizeof(uint64_t) == 0) {
+        B_PLUS_TREE_MOVE_UNITS(uint64_t, dst, src, size);
+    } else if (alignment % sizeof(uint32_t) == 0) {
+        B_PLUS_TREE_MOVE_UNITS(uint32_t, dst, src, size);
+    } else if (alignment % sizeof(uint16_t) == 0) {
+        B_PLUS_TREE_MOVE_UNITS(uint16_t, dst, src, size);
+    } else {
+        B_PLUS_TREE_MOVE_UNITS(uint8_t, dst, src, size);
     }
+}
 
-    node->type = type;
-    node->key_count = 0;
-    node->capacity = tree->node_capacity;
-    node->keys = (void**)malloc(sizeof(void*) * tree->node_capacity);
-    if (!node->keys) {
-        free(node);
-        return NULL;
+// 原子地移动count个指针（release存储，移动后的指针同样发布了所指向的对象）
+static void b_plus_tree_move_pointers(void* dst, const void* src, size_t count) {
+    void** to = (void**)dst;
+    void* const* from = (void* const*)src;
+    if (to > from) {
+        for (size_t i = count; i > 0; i--) {
+            B_PLUS_TREE_STORE_POINTER(&to[i - 1], B_PLUS_TREE_LOAD_POINTER(&from[i - 1]));
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            B_PLUS_TREE_STORE_POINTER(&to[i], B_PLUS_TREE_LOAD_POINTER(&from[i]));
+        }
     }
+}
 
-    if (type == NODE_TYPE_INTERNAL) {
-        node->ptrs.children = (BPlusTreeNode**)malloc(sizeof(BPlusTreeNode*) * (tree->node_capacity + 1));
-        if (!node->ptrs.children) {
-            free(node->keys);
-            free(node);
-            return NULL;
+// 按字节比较节点中的内容和调用者的字节串（节点内容逐字节原子读取）
+static inline int b_plus_tree_compare_stored(const uint8_t* stored, const uint8_t* bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = B_PLUS_TREE_LOAD(&stored[i]);
+        if (byte != bytes[i]) {
+            return byte < bytes[i] ? -1 : 1;
         }
+    }
+    return 0;
+}
+
+// 节点头部大小（键数组从下一个缓存行开始）
+static size_t b_plus_tree_header_size(void) {
+    return B_PLUS_TREE_ALIGN(sizeof(BPlusTreeNode), BPLUS_TREE_CACHE_LINE_SIZE);
+}
+
+// 节点需要的字节数：头部、键数组区域和capacity + 1个指针
+static size_t b_plus_tree_node_bytes(size_t key_area_size, uint32_t capacity) {
+    return b_plus_tree_header_size() + key_area_size + sizeof(void*) * (capacity + 1);
+}
+
+// 键数组中第index个键的位置
+static inline uint8_t* b_plus_tree_key_slot(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t index) {
+    return node->key_data + (size_t)index * tree->key_stride;
+}
+
+// 第index个键（指针键模式下为键指针，定长键模式下指向节点内的键）
+static inline const void* b_plus_tree_key_at(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t index) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        return B_PLUS_TREE_LOAD_POINTER(&node->keys[index]);
+    }
+    return b_plus_tree_key_slot(tree, node, index);
+}
+
+// 写入第index个键（key可以指向另一个节点中的键）
+static inline void b_plus_tree_set_key(const BPlusTree* tree, BPlusTreeNode* node, uint32_t index, const void* key) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        B_PLUS_TREE_STORE_POINTER(&node->keys[index], (void*)key);
     } else {
-        node->ptrs.values = (void**)malloc(sizeof(void*) * tree->node_capacity);
-        if (!node->ptrs.values) {
-            free(node->keys);
-            free(node);
-            return NULL;
+        b_plus_tree_move_bytes(b_plus_tree_key_slot(tree, node, index), key, tree->key_stride);
+    }
+}
+
+// 在节点间移动count个键（可以是同一个节点）
+static inline void b_plus_tree_copy_keys(const BPlusTree* tree, BPlusTreeNode* dst_node, uint32_t dst,
+                                         const BPlusTreeNode* src_node, uint32_t src, uint32_t count) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        b_plus_tree_move_pointers(dst_node->keys + dst, src_node->keys + src, count);
+    } else {
+        b_plus_tree_move_bytes(b_plus_tree_key_slot(tree, dst_node, dst), b_plus_tree_key_slot(tree, src_node, src),
+                               (size_t)count * tree->key_stride);
+    }
+}
+
+// 在节点内移动count个键
+static inline void b_plus_tree_move_keys(const BPlusTree* tree, BPlusTreeNode* node, uint32_t dst, uint32_t src, uint32_t count) {
+    b_plus_tree_copy_keys(tree, node, dst, node, src, count);
+}
+
+// 变长键节点的键区布局：键区头部 | 槽数组（向后增长） | 空闲空间 | 键堆（从键区末尾向前增长）
+// 键堆保存每个键去掉节点前缀后的后缀，以及节点的上下界键。节点中的键都在[下界键, 上界键)内，
+// 因此都以两者的公共前缀开头，前缀只保存一次（下界键的前prefix_length个字节）。
+// 上下界只在分裂、合并和借键时改变，插入和删除不会使前缀失效。
+typedef struct {
+    uint16_t prefix_length;
+    uint16_t heap_offset; // 键堆的起始位置
+    uint16_t garbage; // 键堆中已删除的后缀占用的字节数
+    uint16_t lower_offset; // 下界键
+    uint16_t lower_length;
+    uint16_t upper_offset; // 上界键
+    uint16_t upper_length; // B_PLUS_TREE_VAR_NO_UPPER表示没有上界（每层最右侧的节点）
+    uint16_t reserved;
+} BPlusTreeVarHeader;
+
+#define B_PLUS_TREE_VAR_NO_UPPER UINT16_MAX
+
+// 键区的最大字节数（键区内的位置用16位表示）
+#define B_PLUS_TREE_VAR_MAX_AREA 65528
+
+// 变长键的槽：后缀在键区中的位置和长度，以及后缀的前4个字节（大端序，不足补0）。
+// 二分查找时多数比较只需比较head，不访问键堆
+typedef struct {
+    uint16_t offset;
+    uint16_t length;
+    uint32_t head;
+} BPlusTreeVarSlot;
+
+static inline BPlusTreeVarHeader* b_plus_tree_var_header(const BPlusTreeNode* node) {
+    return (BPlusTreeVarHeader*)node->key_data;
+}
+
+static inline BPlusTreeVarSlot* b_plus_tree_var_slots(const BPlusTreeNode* node) {
+    return (BPlusTreeVarSlot*)(node->key_data + sizeof(BPlusTreeVarHeader));
+}
+
+static inline uint32_t b_plus_tree_var_head(const uint8_t* suffix, uint32_t length) {
+    uint32_t head = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        head = (head << 8) | (i < length ? suffix[i] : 0);
+    }
+    return head;
+}
+
+// 键区中[offset, offset + length)的字节（乐观读取时位置可能无效，越界时按空串处理）
+static inline const uint8_t* b_plus_tree_var_bytes(const BPlusTree* tree, const BPlusTreeNode* node,
+                                                   uint32_t offset, uint32_t* length) {
+    if ((size_t)offset + *length > tree->key_area_size) {
+        *length = 0;
+        return node->key_data;
+    }
+    return node->key_data + offset;
+}
+
+// 节点的公共前缀
+static inline const uint8_t* b_plus_tree_var_prefix(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t* length) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    *length = B_PLUS_TREE_LOAD(&header->prefix_length);
+    return b_plus_tree_var_bytes(tree, node, B_PLUS_TREE_LOAD(&header->lower_offset), length);
+}
+
+// 第index个键的后缀
+static inline const uint8_t* b_plus_tree_var_suffix(const BPlusTree* tree, const BPlusTreeNode* node,
+                                                    uint32_t index, uint32_t* length) {
+    const BPlusTreeVarSlot* slot = &b_plus_tree_var_slots(node)[index];
+    *length = B_PLUS_TREE_LOAD(&slot->length);
+    return b_plus_tree_var_bytes(tree, node, B_PLUS_TREE_LOAD(&slot->offset), length);
+}
+
+// 节点中可用的字节数（包括键堆中可以整理回收的字节）
+static inline size_t b_plus_tree_var_free(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t count) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    size_t used = sizeof(BPlusTreeVarHeader) + (size_t)count * sizeof(BPlusTreeVarSlot);
+    size_t end = (size_t)B_PLUS_TREE_LOAD(&header->heap_offset) + B_PLUS_TREE_LOAD(&header->garbage);
+    if (end > tree->key_area_size) {
+        end = tree->key_area_size;
+    }
+    return end > used ? end - used : 0;
+}
+
+// 按字节比较（较短的字节串是较长字节串的前缀时较短的更小）
+static inline int b_plus_tree_var_compare_bytes(const uint8_t* a, uint32_t a_length, const uint8_t* b, uint32_t b_length) {
+    int cmp = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+// 比较节点中的字节串和调用者的字节串
+static inline int b_plus_tree_var_compare_stored(const uint8_t* stored, uint32_t stored_length,
+                                                 const uint8_t* bytes, uint32_t length) {
+    int cmp = b_plus_tree_compare_stored(stored, bytes, stored_length < length ? stored_length : length);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (stored_length > length) - (stored_length < length);
+}
+
+// 比较两个键
+static inline int b_plus_tree_compare_keys(const BPlusTree* tree, const void* a, const void* b) {
+    switch (tree->key_type) {
+        case BPLUS_TREE_KEY_INT64: {
+            int64_t x;
+            int64_t y;
+            memcpy(&x, a, sizeof(int64_t));
+            memcpy(&y, b, sizeof(int64_t));
+            return (x > y) - (x < y);
+        }
+        case BPLUS_TREE_KEY_FIXED:
+            return memcmp(a, b, tree->key_size);
+        case BPLUS_TREE_KEY_VARIABLE: {
+            const BPlusTreeKey* x = (const BPlusTreeKey*)a;
+            const BPlusTreeKey* y = (const BPlusTreeKey*)b;
+            return b_plus_tree_var_compare_bytes(x->data, x->length, y->data, y->length);
+        }
+        default:
+            return tree->compare(a, b);
+    }
+}
+
+// 读取节点的键数（乐观读取时可能读到正在修改的值，限制在容量以内保证不越界）
+static inline uint32_t b_plus_tree_load_count(const BPlusTreeNode* node) {
+    uint32_t count = __atomic_load_n(&node->key_count, __ATOMIC_RELAXED);
+    return count > node->capacity ? node->capacity : count;
+}
+
+// 在节点中查找第一个大于等于key的位置（upper为true时查找第一个大于key的位置）
+// 定长键直接在连续的键数组上比较，不经过compare函数指针
+static uint32_t b_plus_tree_search(const BPlusTree* tree, const BPlusTreeNode* node, const void* key, bool upper) {
+    uint32_t count = b_plus_tree_load_count(node);
+    if (count == 0) {
+        return 0;
+    }
+
+    switch (tree->key_type) {
+        case BPLUS_TREE_KEY_INT64: {
+            const int64_t* keys = (const int64_t*)node->key_data;
+            const int64_t* base = keys;
+            int64_t target;
+            memcpy(&target, key, sizeof(int64_t));
+
+            // 无分支二分查找：比较结果只决定基址是否前移，编译为条件传送
+            if (upper) {
+                while (count > 1) {
+                    uint32_t half = count / 2;
+                    base = B_PLUS_TREE_LOAD(&base[half]) <= target ? base + half : base;
+                    count -= half;
+                }
+                return (uint32_t)(base - keys) + (B_PLUS_TREE_LOAD(base) <= target);
+            }
+            while (count > 1) {
+                uint32_t half = count / 2;
+                base = B_PLUS_TREE_LOAD(&base[half]) < target ? base + half : base;
+                count -= half;
+            }
+            return (uint32_t)(base - keys) + (B_PLUS_TREE_LOAD(base) < target);
+        }
+        case BPLUS_TREE_KEY_FIXED: {
+            uint32_t left = 0;
+            uint32_t right = count;
+            while (left < right) {
+                uint32_t mid = left + (right - left) / 2;
+                int cmp = b_plus_tree_compare_stored(b_plus_tree_key_slot(tree, node, mid), key, tree->key_size);
+                if (cmp < 0 || (upper && cmp == 0)) {
+                    left = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+            return left;
+        }
+        case BPLUS_TREE_KEY_VARIABLE: {
+            // 先比较节点前缀，之后只比较后缀；键不以节点前缀开头时（只在乐观读取到
+            // 正在修改的节点时出现）位于所有键之前或之后
+            const BPlusTreeKey* target = (const BPlusTreeKey*)key;
+            uint32_t prefix_length;
+            const uint8_t* prefix = b_plus_tree_var_prefix(tree, node, &prefix_length);
+            int cmp = b_plus_tree_compare_stored(prefix, target->data, prefix_length < target->length ? prefix_length : target->length);
+            if (cmp != 0 || target->length < prefix_length) {
+                return cmp < 0 ? count : 0;
+            }
+
+            const uint8_t* suffix = target->data + prefix_length;
+            uint32_t suffix_length = target->length - prefix_length;
+            uint32_t head = b_plus_tree_var_head(suffix, suffix_length);
+            const BPlusTreeVarSlot* slots = b_plus_tree_var_slots(node);
+            uint32_t left = 0;
+            uint32_t right = count;
+            while (left < right) {
+                uint32_t mid = left + (right - left) / 2;
+                uint32_t slot_head = B_PLUS_TREE_LOAD(&slots[mid].head);
+                if (slot_head != head) {
+                    cmp = slot_head < head ? -1 : 1;
+                } else {
+                    uint32_t length;
+                    const uint8_t* stored = b_plus_tree_var_suffix(tree, node, mid, &length);
+                    cmp = b_plus_tree_var_compare_stored(stored, length, suffix, suffix_length);
+                }
+                if (cmp < 0 || (upper && cmp == 0)) {
+                    left = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+            return left;
+        }
+        default: {
+            uint32_t left = 0;
+            uint32_t right = count;
+            while (left < right) {
+                uint32_t mid = left + (right - left) / 2;
+                int cmp = tree->compare(B_PLUS_TREE_LOAD_POINTER(&node->keys[mid]), key);
+                if (cmp < 0 || (upper && cmp == 0)) {
+                    left = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+            return left;
+        }
+    }
+}
+
+// 比较节点中第index个键和key（变长键模式下依次比较节点前缀和后缀）
+static inline int b_plus_tree_compare_at(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t index, const void* key) {
+    switch (tree->key_type) {
+        case BPLUS_TREE_KEY_INT64: {
+            int64_t stored = B_PLUS_TREE_LOAD((const int64_t*)b_plus_tree_key_slot(tree, node, index));
+            int64_t target;
+            memcpy(&target, key, sizeof(int64_t));
+            return (stored > target) - (stored < target);
         }
+        case BPLUS_TREE_KEY_FIXED:
+            return b_plus_tree_compare_stored(b_plus_tree_key_slot(tree, node, index), key, tree->key_size);
+        case BPLUS_TREE_KEY_VARIABLE:
+            break;
+        default:
+            return tree->compare(b_plus_tree_key_at(tree, node, index), key);
+    }
+
+    const BPlusTreeKey* target = (const BPlusTreeKey*)key;
+    uint32_t prefix_length;
+    const uint8_t* prefix = b_plus_tree_var_prefix(tree, node, &prefix_length);
+    int cmp = b_plus_tree_compare_stored(prefix, target->data, prefix_length < target->length ? prefix_length : target->length);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (target->length < prefix_length) {
+        return 1;
+    }
+
+    uint32_t length;
+    const uint8_t* suffix = b_plus_tree_var_suffix(tree, node, index, &length);
+    return b_plus_tree_var_compare_stored(suffix, length, target->data + prefix_length, target->length - prefix_length);
+}
+
+// 槽格式的键占用的字节数（变长键只有长度和实际内容有效）
+static inline size_t b_plus_tree_slot_bytes(const BPlusTree* tree, const uint8_t* slot) {
+    if (tree->key_type != BPLUS_TREE_KEY_VARIABLE) {
+        return tree->key_stride;
+    }
+    uint16_t length;
+    memcpy(&length, slot, sizeof(uint16_t));
+    return offsetof(BPlusTreeKey, data) + length;
+}
+
+// 把节点中第index个键复制为槽格式（变长键拼接节点前缀和后缀）
+static inline void b_plus_tree_read_key(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t index, uint8_t* slot) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        void* key = B_PLUS_TREE_LOAD_POINTER(&node->keys[index]);
+        memcpy(slot, &key, sizeof(void*));
+        return;
+    }
+    if (tree->key_type != BPLUS_TREE_KEY_VARIABLE) {
+        b_plus_tree_move_bytes(slot, b_plus_tree_key_slot(tree, node, index), tree->key_stride);
+        return;
+    }
+
+    uint32_t prefix_length;
+    uint32_t suffix_length;
+    const uint8_t* prefix = b_plus_tree_var_prefix(tree, node, &prefix_length);
+    const uint8_t* suffix = b_plus_tree_var_suffix(tree, node, index, &suffix_length);
+    // 乐观读取时长度可能无效，限制在最大长度以内（读取结果会在校验版本号时丢弃）
+    if (prefix_length > tree->key_size) {
+        prefix_length = (uint32_t)tree->key_size;
+    }
+    if (suffix_length > tree->key_size - prefix_length) {
+        suffix_length = (uint32_t)tree->key_size - prefix_length;
+    }
+    uint16_t length = (uint16_t)(prefix_length + suffix_length);
+    memcpy(slot, &length, sizeof(uint16_t));
+    b_plus_tree_move_bytes(slot + offsetof(BPlusTreeKey, data), prefix, prefix_length);
+    b_plus_tree_move_bytes(slot + offsetof(BPlusTreeKey, data) + prefix_length, suffix, suffix_length);
+}
+
+// 创建B+树节点
+BPlusTreeNode* b_plus_tree_create_node(BPlusTree* tree, NodeType type) {
+    void* memory = NULL;
+    if (posix_memalign(&memory, BPLUS_TREE_CACHE_LINE_SIZE, tree->node_size) != 0) {
+        return NULL;
     }
 
-    node->parent = NULL;
+    BPlusTreeNode* node = (BPlusTreeNode*)memory;
+    node->version = 0;
+    node->type = type;
+    node->key_count = 0;
+    node->capacity = tree->node_capacity;
+    node->min_keys = tree->key_type == BPLUS_TREE_KEY_VARIABLE ? 1 : (tree->node_capacity - 1) / 2;
+    node->key_data = (uint8_t*)memory + b_plus_tree_header_size();
+    node->keys = tree->key_type == BPLUS_TREE_KEY_POINTER ? (void**)node->key_data : NULL;
+    node->ptrs.values = (void**)(node->key_data + tree->key_area_size);
     node->prev = NULL;
     node->next = NULL;
 
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        // 新节点没有下界（空串）和上界，前缀为空
+        BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+        memset(header, 0, sizeof(BPlusTreeVarHeader));
+        header->heap_offset = (uint16_t)tree->key_area_size;
+        header->lower_offset = header->heap_offset;
+        header->upper_offset = header->heap_offset;
+        header->upper_length = B_PLUS_TREE_VAR_NO_UPPER;
+    }
+
     return node;
 }
 
-// 销毁B+树节点
+// 销毁B+树节点（包括子树）
 void b_plus_tree_destroy_node(BPlusTree* tree, BPlusTreeNode* node) {
     if (!node) {
         return;
     }
 
-    // 释放键
-    for (uint32_t i = 0; i < node->key_count; i++) {
-        if (tree->destroy_key && node->keys[i]) {
-            tree->destroy_key(node->keys[i]);
-        }
-    }
-    free(node->keys);
-
-    // 释放值或子节点
     if (node->type == NODE_TYPE_INTERNAL) {
+        // 内部节点的分隔键与叶子节点共享，不单独释放
         for (uint32_t i = 0; i < node->key_count + 1; i++) {
-            if (node->ptrs.children[i]) {
-                b_plus_tree_destroy_node(tree, node->ptrs.children[i]);
-            }
+            b_plus_tree_destroy_node(tree, node->ptrs.children[i]);
         }
-        free(node->ptrs.children);
     } else {
         for (uint32_t i = 0; i < node->key_count; i++) {
+            if (tree->key_type == BPLUS_TREE_KEY_POINTER && tree->destroy_key && node->keys[i]) {
+                tree->destroy_key(node->keys[i]);
+            }
             if (tree->destroy_value && node->ptrs.values[i]) {
                 tree->destroy_value(node->ptrs.values[i]);
             }
         }
-        free(node->ptrs.values);
     }
 
-    free(node);
-}
+    free(node);
+}
+
+// 检查节点是否已满
+bool b_plus_tree_node_is_full(BPlusTreeNode* node) {
+    return node->key_count >= node->capacity;
+}
+
+// 非根节点的最少键数（保证两个最少键数的兄弟节点可以合并为一个节点）
+// 变长键节点按字节计算空间，只要求至少一个键
+static inline uint32_t b_plus_tree_node_min_keys(const BPlusTreeNode* node) {
+    return node->min_keys;
+}
+
+// 检查节点是否下溢
+bool b_plus_tree_node_is_underflow(BPlusTreeNode* node) {
+    return node->key_count < b_plus_tree_node_min_keys(node);
+}
+
+// 第index个键（指针键模式下为键指针，定长键模式下指向节点内的键）
+const void* b_plus_tree_node_key(BPlusTree* tree, BPlusTreeNode* node, uint32_t index) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return NULL;
+    }
+    return b_plus_tree_key_at(tree, node, index);
+}
+
+// 查找键在节点中的索引（第一个大于等于key的位置）
+int b_plus_tree_find_key_index(BPlusTree* tree, BPlusTreeNode* node, const void* key) {
+    return (int)b_plus_tree_search(tree, node, key, false);
+}
+
+// 由两段组成的变长键（节点前缀和后缀，或完整的键和空串）
+typedef struct {
+    const uint8_t* prefix;
+    uint32_t prefix_length;
+    const uint8_t* suffix;
+    uint32_t suffix_length;
+} BPlusTreeVarKey;
+
+static inline uint32_t b_plus_tree_var_key_length(const BPlusTreeVarKey* key) {
+    return key->prefix_length + key->suffix_length;
+}
+
+static inline uint8_t b_plus_tree_var_key_byte(const BPlusTreeVarKey* key, uint32_t index) {
+    return index < key->prefix_length ? key->prefix[index] : key->suffix[index - key->prefix_length];
+}
+
+// 复制键中从from开始的length个字节
+static void b_plus_tree_var_key_read(const BPlusTreeVarKey* key, uint32_t from, uint32_t length, uint8_t* out) {
+    if (from < key->prefix_length) {
+        uint32_t part = key->prefix_length - from < length ? key->prefix_length - from : length;
+        memcpy(out, key->prefix + from, part);
+        out += part;
+        length -= part;
+        from = 0;
+    } else {
+        from -= key->prefix_length;
+    }
+    if (length > 0) {
+        memcpy(out, key->suffix + from, length);
+    }
+}
+
+// 两个键的公共前缀长度
+static uint32_t b_plus_tree_var_key_common(const BPlusTreeVarKey* a, const BPlusTreeVarKey* b) {
+    uint32_t a_length = b_plus_tree_var_key_length(a);
+    uint32_t b_length = b_plus_tree_var_key_length(b);
+    uint32_t limit = a_length < b_length ? a_length : b_length;
+    uint32_t i = 0;
+    while (i < limit && b_plus_tree_var_key_byte(a, i) == b_plus_tree_var_key_byte(b, i)) {
+        i++;
+    }
+    return i;
+}
+
+// 节点中的第index个键
+static inline BPlusTreeVarKey b_plus_tree_var_key(const BPlusTree* tree, const BPlusTreeNode* node, uint32_t index) {
+    BPlusTreeVarKey key;
+    key.prefix = b_plus_tree_var_prefix(tree, node, &key.prefix_length);
+    key.suffix = b_plus_tree_var_suffix(tree, node, index, &key.suffix_length);
+    return key;
+}
+
+static inline BPlusTreeVarKey b_plus_tree_var_key_of(const BPlusTreeKey* key) {
+    BPlusTreeVarKey result = {key->data, key->length, NULL, 0};
+    return result;
+}
+
+// 节点的下界
+static inline BPlusTreeVarKey b_plus_tree_var_lower(const BPlusTree* tree, const BPlusTreeNode* node) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    BPlusTreeVarKey key = {NULL, header->lower_length, NULL, 0};
+    key.prefix = b_plus_tree_var_bytes(tree, node, header->lower_offset, &key.prefix_length);
+    return key;
+}
+
+// 节点的上界（没有上界时返回false）
+static inline bool b_plus_tree_var_upper(const BPlusTree* tree, const BPlusTreeNode* node, BPlusTreeVarKey* key) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    if (header->upper_length == B_PLUS_TREE_VAR_NO_UPPER) {
+        return false;
+    }
+    key->prefix_length = header->upper_length;
+    key->prefix = b_plus_tree_var_bytes(tree, node, header->upper_offset, &key->prefix_length);
+    key->suffix = NULL;
+    key->suffix_length = 0;
+    return true;
+}
+
+// 区分a和b（a < b）的最短分隔键：b的最短前缀s，满足a < s <= b（后缀截断）
+static void b_plus_tree_var_separator(const BPlusTreeVarKey* a, const BPlusTreeVarKey* b, BPlusTreeKey* separator) {
+    uint32_t length = b_plus_tree_var_key_common(a, b) + 1;
+    if (length > b_plus_tree_var_key_length(b)) {
+        length = b_plus_tree_var_key_length(b);
+    }
+    separator->length = (uint16_t)length;
+    b_plus_tree_var_key_read(b, 0, length, separator->data);
+}
+
+// 把键序列写入空节点：先写入上下界并确定前缀，再依次写入键的后缀
+// pointers为值（叶子节点，count个）或子节点（内部节点，count + 1个）；空间不足时返回false
+static bool b_plus_tree_var_write(const BPlusTree* tree, BPlusTreeNode* node, const BPlusTreeVarKey* keys, uint32_t count,
+                                  void* const* pointers, const BPlusTreeVarKey* lower, const BPlusTreeVarKey* upper) {
+    if (count > node->capacity) {
+        return false;
+    }
+
+    BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    BPlusTreeVarSlot* slots = b_plus_tree_var_slots(node);
+    size_t used = sizeof(BPlusTreeVarHeader) + (size_t)count * sizeof(BPlusTreeVarSlot);
+    size_t heap = tree->key_area_size;
+    uint32_t lower_length = b_plus_tree_var_key_length(lower);
+    uint32_t upper_length = upper ? b_plus_tree_var_key_length(upper) : 0;
+    if (heap < used + lower_length + upper_length) {
+        return false;
+    }
+
+    heap -= lower_length;
+    b_plus_tree_var_key_read(lower, 0, lower_length, node->key_data + heap);
+    header->lower_offset = (uint16_t)heap;
+    header->lower_length = (uint16_t)lower_length;
+    heap -= upper_length;
+    if (upper) {
+        b_plus_tree_var_key_read(upper, 0, upper_length, node->key_data + heap);
+    }
+    header->upper_offset = (uint16_t)heap;
+    header->upper_length = upper ? (uint16_t)upper_length : B_PLUS_TREE_VAR_NO_UPPER;
+
+    // 前缀为上下界的公共前缀；没有上界时节点中的键可以任意大，没有公共前缀
+    uint32_t prefix_length = upper ? b_plus_tree_var_key_common(lower, upper) : 0;
+    header->prefix_length = (uint16_t)prefix_length;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t length = b_plus_tree_var_key_length(&keys[i]) - prefix_length;
+        if (heap < used + length) {
+            return false;
+        }
+        heap -= length;
+        b_plus_tree_var_key_read(&keys[i], prefix_length, length, node->key_data + heap);
+        slots[i].offset = (uint16_t)heap;
+        slots[i].length = (uint16_t)length;
+        slots[i].head = b_plus_tree_var_head(node->key_data + heap, length);
+    }
+
+    header->heap_offset = (uint16_t)heap;
+    header->garbage = 0;
+    header->reserved = 0;
+    memcpy(node->ptrs.values, pointers, sizeof(void*) * (count + (node->type == NODE_TYPE_INTERNAL ? 1 : 0)));
+    node->key_count = count;
+    return true;
+}
+
+// 用临时节点的内容替换节点的内容（调用者持有节点的写锁）
+static void b_plus_tree_var_install(const BPlusTree* tree, BPlusTreeNode* node, const BPlusTreeNode* source) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(source);
+    b_plus_tree_move_bytes(node->key_data, source->key_data,
+                           sizeof(BPlusTreeVarHeader) + (size_t)source->key_count * sizeof(BPlusTreeVarSlot));
+    b_plus_tree_move_bytes(node->key_data + header->heap_offset, source->key_data + header->heap_offset,
+                           tree->key_area_size - header->heap_offset);
+    b_plus_tree_move_pointers(node->ptrs.values, source->ptrs.values, source->key_count + 1);
+    B_PLUS_TREE_STORE(&node->key_count, source->key_count);
+}
+
+// 变长键节点重组时按顺序排列的键和指针（指向参与重组的节点，在安装重组结果之前有效）
+typedef struct {
+    BPlusTreeVarKey* keys;
+    void** pointers;
+    uint32_t key_count;
+    uint32_t pointer_count;
+    BPlusTreeKey* separator; // 重组后的分隔键
+    BPlusTreeNode* output[2]; // 保存重组结果的临时节点
+} BPlusTreeVarBuild;
+
+static void b_plus_tree_var_build_free(BPlusTreeVarBuild* build) {
+    free(build->keys);
+    free(build->pointers);
+    free(build->separator);
+    free(build->output[0]);
+    free(build->output[1]);
+}
+
+static bool b_plus_tree_var_build_init(BPlusTree* tree, BPlusTreeVarBuild* build, NodeType type, uint32_t outputs) {
+    memset(build, 0, sizeof(BPlusTreeVarBuild));
+
+    // 最多两个节点的键和父节点的一个分隔键
+    size_t capacity = (size_t)tree->node_capacity * 2 + 2;
+    build->keys = (BPlusTreeVarKey*)malloc(sizeof(BPlusTreeVarKey) * capacity);
+    build->pointers = (void**)malloc(sizeof(void*) * capacity);
+    build->separator = (BPlusTreeKey*)malloc(tree->key_stride);
+    bool allocated = build->keys && build->pointers && build->separator;
+    for (uint32_t i = 0; i < outputs && allocated; i++) {
+        build->output[i] = b_plus_tree_create_node(tree, type);
+        allocated = build->output[i] != NULL;
+    }
+
+    if (!allocated) {
+        b_plus_tree_var_build_free(build);
+        return false;
+    }
+    return true;
+}
+
+// 追加节点的全部键和指针
+static void b_plus_tree_var_build_add(const BPlusTree* tree, BPlusTreeVarBuild* build, const BPlusTreeNode* node) {
+    for (uint32_t i = 0; i < node->key_count; i++) {
+        build->keys[build->key_count++] = b_plus_tree_var_key(tree, node, i);
+    }
+    uint32_t pointers = node->key_count + (node->type == NODE_TYPE_INTERNAL ? 1 : 0);
+    memcpy(build->pointers + build->pointer_count, node->ptrs.values, sizeof(void*) * pointers);
+    build->pointer_count += pointers;
+}
+
+// 前split个键与其余键之间的分隔键：叶子节点截断为最短分隔键，内部节点为第split个键
+static BPlusTreeVarKey b_plus_tree_var_build_separator(BPlusTreeVarBuild* build, uint32_t split, bool leaf) {
+    if (leaf) {
+        b_plus_tree_var_separator(&build->keys[split - 1], &build->keys[split], build->separator);
+    } else {
+        uint32_t length = b_plus_tree_var_key_length(&build->keys[split]);
+        build->separator->length = (uint16_t)length;
+        b_plus_tree_var_key_read(&build->keys[split], 0, length, build->separator->data);
+    }
+    return b_plus_tree_var_key_of(build->separator);
+}
+
+// 把键[from, to)写入节点（内部节点同时写入子节点[from, to]）
+static bool b_plus_tree_var_build_write(const BPlusTree* tree, const BPlusTreeVarBuild* build, BPlusTreeNode* node,
+                                        uint32_t from, uint32_t to,
+                                        const BPlusTreeVarKey* lower, const BPlusTreeVarKey* upper) {
+    return b_plus_tree_var_write(tree, node, build->keys + from, to - from, build->pointers + from, lower, upper);
+}
+
+// 分隔第split - 1个和第split个键需要的最短分隔键长度
+static uint32_t b_plus_tree_var_separator_length(const BPlusTreeVarBuild* build, uint32_t split) {
+    uint32_t length = b_plus_tree_var_key_common(&build->keys[split - 1], &build->keys[split]) + 1;
+    uint32_t limit = b_plus_tree_var_key_length(&build->keys[split]);
+    return length < limit ? length : limit;
+}
+
+// 分裂位置：按后缀字节数把键分成大致相等的两半。叶子节点在中点附近（两半相差不超过
+// 总字节数的1/8）选择分隔键最短的位置，缩短上移到内部节点的分隔键
+static uint32_t b_plus_tree_var_split_point(const BPlusTreeVarBuild* build, bool leaf) {
+    uint32_t count = build->key_count;
+    size_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += sizeof(BPlusTreeVarSlot) + build->keys[i].suffix_length;
+    }
+
+    // 内部节点的分隔键上移，两侧都至少保留一个键
+    uint32_t low = 1;
+    uint32_t high = leaf ? count - 1 : count - 2;
+    uint32_t split = 0;
+    size_t bytes = 0;
+    while (split < high && (split < low || bytes < total / 2)) {
+        bytes += sizeof(BPlusTreeVarSlot) + build->keys[split].suffix_length;
+        split++;
+    }
+    if (!leaf) {
+        return split;
+    }
+
+    size_t window = total / 16;
+    uint32_t best = split;
+    uint32_t best_length = b_plus_tree_var_separator_length(build, split);
+    size_t left_bytes = bytes;
+    for (uint32_t s = split; s > low; s--) {
+        left_bytes -= sizeof(BPlusTreeVarSlot) + build->keys[s - 1].suffix_length;
+        if (left_bytes + window < total / 2) {
+            break;
+        }
+        uint32_t length = b_plus_tree_var_separator_length(build, s - 1);
+        if (length < best_length) {
+            best = s - 1;
+            best_length = length;
+        }
+    }
+    left_bytes = bytes;
+    for (uint32_t s = split; s < high; s++) {
+        left_bytes += sizeof(BPlusTreeVarSlot) + build->keys[s].suffix_length;
+        if (left_bytes > total / 2 + window) {
+            break;
+        }
+        uint32_t length = b_plus_tree_var_separator_length(build, s + 1);
+        if (length < best_length) {
+            best = s + 1;
+            best_length = length;
+        }
+    }
+    return best;
+}
+
+// 以新的上下界重写节点（同时整理键堆），lower和upper可以指向节点自身的上下界
+static bool b_plus_tree_var_rebuild(BPlusTree* tree, BPlusTreeNode* node, const BPlusTreeVarKey* lower, const BPlusTreeVarKey* upper) {
+    BPlusTreeVarBuild build;
+    if (!b_plus_tree_var_build_init(tree, &build, node->type, 1)) {
+        return false;
+    }
+
+    b_plus_tree_var_build_add(tree, &build, node);
+    bool written = b_plus_tree_var_build_write(tree, &build, build.output[0], 0, build.key_count, lower, upper);
+    if (written) {
+        b_plus_tree_var_install(tree, node, build.output[0]);
+    }
+
+    b_plus_tree_var_build_free(&build);
+    return written;
+}
+
+// 保证键堆之前有bytes字节的连续空间，不足时整理键堆
+static bool b_plus_tree_var_reserve(BPlusTree* tree, BPlusTreeNode* node, size_t bytes) {
+    const BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    size_t used = sizeof(BPlusTreeVarHeader) + (size_t)node->key_count * sizeof(BPlusTreeVarSlot);
+    size_t contiguous = header->heap_offset - used;
+    if (contiguous >= bytes) {
+        return true;
+    }
+    if (contiguous + header->garbage < bytes) {
+        return false;
+    }
+
+    BPlusTreeVarKey lower = b_plus_tree_var_lower(tree, node);
+    BPlusTreeVarKey upper;
+    bool has_upper = b_plus_tree_var_upper(tree, node, &upper);
+    return b_plus_tree_var_rebuild(tree, node, &lower, has_upper ? &upper : NULL);
+}
+
+// 在第index个位置插入键的后缀（键必须以节点前缀开头；不修改键数和指针）
+static bool b_plus_tree_var_insert(BPlusTree* tree, BPlusTreeNode* node, uint32_t index, const BPlusTreeKey* key) {
+    BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    uint32_t prefix_length = header->prefix_length;
+    uint32_t suffix_length = key->length - prefix_length;
+    if (!b_plus_tree_var_reserve(tree, node, sizeof(BPlusTreeVarSlot) + suffix_length)) {
+        return false;
+    }
+
+    uint16_t offset = (uint16_t)(header->heap_offset - suffix_length);
+    B_PLUS_TREE_STORE(&header->heap_offset, offset);
+    b_plus_tree_move_bytes(node->key_data + offset, key->data + prefix_length, suffix_length);
+
+    BPlusTreeVarSlot* slots = b_plus_tree_var_slots(node);
+    b_plus_tree_move_bytes(slots + index + 1, slots + index, sizeof(BPlusTreeVarSlot) * (node->key_count - index));
+    B_PLUS_TREE_STORE(&slots[index].offset, offset);
+    B_PLUS_TREE_STORE(&slots[index].length, (uint16_t)suffix_length);
+    B_PLUS_TREE_STORE(&slots[index].head, b_plus_tree_var_head(key->data + prefix_length, suffix_length));
+    return true;
+}
+
+// 释放后缀占用的键堆空间（位于键堆开头时直接归还，否则记为待整理）
+static void b_plus_tree_var_release(BPlusTreeNode* node, const BPlusTreeVarSlot* slot) {
+    BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    if (slot->offset == header->heap_offset) {
+        B_PLUS_TREE_STORE(&header->heap_offset, (uint16_t)(header->heap_offset + slot->length));
+    } else {
+        B_PLUS_TREE_STORE(&header->garbage, (uint16_t)(header->garbage + slot->length));
+    }
+}
+
+// 删除第index个键（不修改键数和指针）
+static void b_plus_tree_var_remove(BPlusTreeNode* node, uint32_t index) {
+    BPlusTreeVarSlot* slots = b_plus_tree_var_slots(node);
+    b_plus_tree_var_release(node, &slots[index]);
+    b_plus_tree_move_bytes(slots + index, slots + index + 1, sizeof(BPlusTreeVarSlot) * (node->key_count - index - 1));
+}
+
+// 替换第index个键（调用者已预留空间）
+static void b_plus_tree_var_replace(BPlusTreeNode* node, uint32_t index, const BPlusTreeKey* key) {
+    BPlusTreeVarHeader* header = b_plus_tree_var_header(node);
+    BPlusTreeVarSlot* slot = &b_plus_tree_var_slots(node)[index];
+    uint32_t prefix_length = header->prefix_length;
+    uint32_t suffix_length = key->length - prefix_length;
+
+    b_plus_tree_var_release(node, slot);
+    uint16_t offset = (uint16_t)(header->heap_offset - suffix_length);
+    B_PLUS_TREE_STORE(&header->heap_offset, offset);
+    b_plus_tree_move_bytes(node->key_data + offset, key->data + prefix_length, suffix_length);
+    B_PLUS_TREE_STORE(&slot->offset, offset);
+    B_PLUS_TREE_STORE(&slot->length, (uint16_t)suffix_length);
+    B_PLUS_TREE_STORE(&slot->head, b_plus_tree_var_head(key->data + prefix_length, suffix_length));
+}
+
+// 连接分裂出的叶子节点
+static void b_plus_tree_link_leaf(BPlusTree* tree, BPlusTreeNode* node, BPlusTreeNode* new_node) {
+    new_node->prev = node;
+    new_node->next = node->next;
+    if (node->next) {
+        B_PLUS_TREE_STORE_POINTER(&node->next->prev, new_node);
+    } else {
+        __atomic_store_n(&tree->last_leaf, new_node, __ATOMIC_RELEASE);
+    }
+    B_PLUS_TREE_STORE_POINTER(&node->next, new_node);
+}
+
+// 从叶子链表中移除合并后的右节点
+static void b_plus_tree_unlink_leaf(BPlusTree* tree, BPlusTreeNode* left, BPlusTreeNode* right) {
+    B_PLUS_TREE_STORE_POINTER(&left->next, right->next);
+    if (right->next) {
+        B_PLUS_TREE_STORE_POINTER(&right->next->prev, left);
+    } else {
+        __atomic_store_n(&tree->last_leaf, left, __ATOMIC_RELEASE);
+    }
+}
+
+// 分裂变长键节点（父节点的第index个子节点），返回分裂出的右节点
+// 左半部分写入临时节点后再复制回原节点，父节点在最后才修改，失败时树保持不变
+static BPlusTreeNode* b_plus_tree_var_split(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index) {
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    bool leaf = node->type == NODE_TYPE_LEAF;
+    BPlusTreeVarBuild build;
+    if (!b_plus_tree_var_build_init(tree, &build, node->type, 1)) {
+        return NULL;
+    }
+    BPlusTreeNode* new_node = b_plus_tree_create_node(tree, node->type);
+    if (!new_node) {
+        b_plus_tree_var_build_free(&build);
+        return NULL;
+    }
+
+    b_plus_tree_var_build_add(tree, &build, node);
+    uint32_t split = b_plus_tree_var_split_point(&build, leaf);
+    BPlusTreeVarKey separator = b_plus_tree_var_build_separator(&build, split, leaf);
+    BPlusTreeVarKey lower = b_plus_tree_var_lower(tree, node);
+    BPlusTreeVarKey upper;
+    bool has_upper = b_plus_tree_var_upper(tree, node, &upper);
+
+    bool written = b_plus_tree_var_build_write(tree, &build, build.output[0], 0, split, &lower, &separator) &&
+                   b_plus_tree_var_build_write(tree, &build, new_node, leaf ? split : split + 1, build.key_count,
+                                               &separator, has_upper ? &upper : NULL) &&
+                   b_plus_tree_var_reserve(tree, parent, sizeof(BPlusTreeVarSlot) + build.separator->length);
+    if (!written) {
+        free(new_node);
+        b_plus_tree_var_build_free(&build);
+        return NULL;
+    }
+
+    b_plus_tree_var_install(tree, node, build.output[0]);
+    if (leaf) {
+        b_plus_tree_link_leaf(tree, node, new_node);
+    }
+
+    b_plus_tree_var_insert(tree, parent, index, build.separator);
+    b_plus_tree_move_pointers(parent->ptrs.children + index + 2, parent->ptrs.children + index + 1,
+                              parent->key_count - index);
+    B_PLUS_TREE_STORE_POINTER(&parent->ptrs.children[index + 1], new_node);
+    B_PLUS_TREE_STORE(&parent->key_count, parent->key_count + 1);
+
+    b_plus_tree_var_build_free(&build);
+    return new_node;
+}
+
+// 合并变长键节点（父节点的第index个和第index + 1个子节点）
+// 合并后的前缀可能变短，放不下或剩余空间少于reserve字节时不合并，返回NULL
+static BPlusTreeNode* b_plus_tree_var_merge(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index, size_t reserve) {
+    BPlusTreeNode* left = parent->ptrs.children[index];
+    BPlusTreeNode* right = parent->ptrs.children[index + 1];
+    BPlusTreeVarBuild build;
+    if (!b_plus_tree_var_build_init(tree, &build, left->type, 1)) {
+        return NULL;
+    }
+
+    b_plus_tree_var_build_add(tree, &build, left);
+    if (left->type == NODE_TYPE_INTERNAL) {
+        build.keys[build.key_count++] = b_plus_tree_var_key(tree, parent, index);
+    }
+    b_plus_tree_var_build_add(tree, &build, right);
+    BPlusTreeVarKey lower = b_plus_tree_var_lower(tree, left);
+    BPlusTreeVarKey upper;
+    bool has_upper = b_plus_tree_var_upper(tree, right, &upper);
+
+    BPlusTreeNode* output = build.output[0];
+    if (!b_plus_tree_var_build_write(tree, &build, output, 0, build.key_count, &lower, has_upper ? &upper : NULL) ||
+        b_plus_tree_var_free(tree, output, output->key_count) < reserve) {
+        b_plus_tree_var_build_free(&build);
+        return NULL;
+    }
+
+    b_plus_tree_var_install(tree, left, output);
+    if (left->type == NODE_TYPE_LEAF) {
+        b_plus_tree_unlink_leaf(tree, left, right);
+    }
+
+    b_plus_tree_var_remove(parent, index);
+    b_plus_tree_move_pointers(parent->ptrs.children + index + 1, parent->ptrs.children + index + 2,
+                              parent->key_count - index - 1);
+    B_PLUS_TREE_STORE(&parent->key_count, parent->key_count - 1);
+
+    b_plus_tree_var_build_free(&build);
+    return left;
+}
+
+// 在父节点的第index个和第index + 1个子节点之间重新分配键，左节点保留按顺序排列的前split个键
+static bool b_plus_tree_var_redistribute(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index, uint32_t split) {
+    BPlusTreeNode* left = parent->ptrs.children[index];
+    BPlusTreeNode* right = parent->ptrs.children[index + 1];
+    bool leaf = left->type == NODE_TYPE_LEAF;
+    BPlusTreeVarBuild build;
+    if (!b_plus_tree_var_build_init(tree, &build, left->type, 2)) {
+        return false;
+    }
+
+    b_plus_tree_var_build_add(tree, &build, left);
+    if (!leaf) {
+        build.keys[build.key_count++] = b_plus_tree_var_key(tree, parent, index);
+    }
+    b_plus_tree_var_build_add(tree, &build, right);
+    BPlusTreeVarKey separator = b_plus_tree_var_build_separator(&build, split, leaf);
+    BPlusTreeVarKey lower = b_plus_tree_var_lower(tree, left);
+    BPlusTreeVarKey upper;
+    bool has_upper = b_plus_tree_var_upper(tree, right, &upper);
+
+    // 重组结果写入临时节点之后不再引用原节点，此时才可以整理父节点的键堆
+    bool written = b_plus_tree_var_build_write(tree, &build, build.output[0], 0, split, &lower, &separator) &&
+                   b_plus_tree_var_build_write(tree, &build, build.output[1], leaf ? split : split + 1, build.key_count,
+                                               &separator, has_upper ? &upper : NULL) &&
+                   b_plus_tree_var_reserve(tree, parent, sizeof(BPlusTreeVarSlot) + build.separator->length);
+    if (written) {
+        b_plus_tree_var_install(tree, left, build.output[0]);
+        b_plus_tree_var_install(tree, right, build.output[1]);
+        b_plus_tree_var_replace(parent, index, build.separator);
+    }
+
+    b_plus_tree_var_build_free(&build);
+    return written;
+}
+
+// 补足变长键节点（父节点的第index个子节点）：合并后仍能插入最长的键时优先合并，否则从兄弟节点借一个键
+static bool b_plus_tree_var_fill_child(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index, BPlusTreeNode** removed) {
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    BPlusTreeNode* left = index > 0 ? parent->ptrs.children[index - 1] : NULL;
+    BPlusTreeNode* right = index < parent->key_count ? parent->ptrs.children[index + 1] : NULL;
+    size_t reserve = sizeof(BPlusTreeVarSlot) + tree->key_size;
+
+    *removed = NULL;
+    if (left && b_plus_tree_var_merge(tree, parent, index - 1, reserve)) {
+        *removed = node;
+        return true;
+    }
+    if (right && b_plus_tree_var_merge(tree, parent, index, reserve)) {
+        *removed = right;
+        return true;
+    }
+    if (left && left->key_count > b_plus_tree_node_min_keys(left)) {
+        return b_plus_tree_var_redistribute(tree, parent, index - 1, left->key_count - 1);
+    }
+    if (right && right->key_count > b_plus_tree_node_min_keys(right)) {
+        return b_plus_tree_var_redistribute(tree, parent, index, node->key_count + 1);
+    }
+    return false;
+}
+
+// 在第index个位置插入键（不修改键数和指针，变长键模式下空间不足时返回false）
+static bool b_plus_tree_insert_key(BPlusTree* tree, BPlusTreeNode* node, uint32_t index, const void* key) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_insert(tree, node, index, (const BPlusTreeKey*)key);
+    }
+    b_plus_tree_move_keys(tree, node, index + 1, index, node->key_count - index);
+    b_plus_tree_set_key(tree, node, index, key);
+    return true;
+}
+
+// 删除第index个键（不修改键数和指针）
+static void b_plus_tree_remove_key(BPlusTree* tree, BPlusTreeNode* node, uint32_t index) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        b_plus_tree_var_remove(node, index);
+        return;
+    }
+    b_plus_tree_move_keys(tree, node, index, index + 1, node->key_count - index - 1);
+}
+
+// 插入key之前节点是否需要分裂（key为NULL时按最长的键计算）
+// 变长键模式下叶子节点要能容纳key，内部节点要能容纳子节点分裂时上移的任意分隔键
+static inline bool b_plus_tree_node_needs_split(const BPlusTree* tree, const BPlusTreeNode* node, const void* key) {
+    uint32_t count = b_plus_tree_load_count(node);
+    if (count >= node->capacity) {
+        return true;
+    }
+    if (tree->key_type != BPLUS_TREE_KEY_VARIABLE) {
+        return false;
+    }
+
+    size_t needed = sizeof(BPlusTreeVarSlot) + tree->key_size;
+    if (node->type == NODE_TYPE_LEAF && key) {
+        uint32_t prefix_length = B_PLUS_TREE_LOAD(&b_plus_tree_var_header(node)->prefix_length);
+        uint32_t length = ((const BPlusTreeKey*)key)->length;
+        needed = sizeof(BPlusTreeVarSlot) + (length > prefix_length ? length - prefix_length : 0);
+    }
+    return b_plus_tree_var_free(tree, node, count) < needed;
+}
+
+// 乐观读：等待写者解锁后返回节点版本号，节点已移除时返回false
+static inline bool b_plus_tree_read_lock(BPlusTreeNode* node, uint64_t* version) {
+    uint64_t current = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE);
+    while (current & BPLUS_TREE_VERSION_LOCKED) {
+        sched_yield();
+        current = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE);
+    }
+    if (current & BPLUS_TREE_VERSION_OBSOLETE) {
+        return false;
+    }
+    *version = current;
+    return true;
+}
+
+// 检查读取节点期间版本号没有变化
+static inline bool b_plus_tree_validate(BPlusTreeNode* node, uint64_t version) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&node->version, __ATOMIC_RELAXED) == version;
+}
+
+// 把乐观读升级为写锁（版本号变化时失败）
+static inline bool b_plus_tree_upgrade_lock(BPlusTreeNode* node, uint64_t version) {
+    return __atomic_compare_exchange_n(&node->version, &version, version + BPLUS_TREE_VERSION_LOCKED,
+                                       false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// 尝试锁定节点（已锁定或已移除时立即失败，持有其他锁时使用以避免死锁）
+static inline bool b_plus_tree_try_lock(BPlusTreeNode* node) {
+    uint64_t version = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE);
+    if (version & (BPLUS_TREE_VERSION_LOCKED | BPLUS_TREE_VERSION_OBSOLETE)) {
+        return false;
+    }
+    return b_plus_tree_upgrade_lock(node, version);
+}
+
+// 解锁节点，版本号递增
+static inline void b_plus_tree_unlock(BPlusTreeNode* node) {
+    __atomic_fetch_add(&node->version, BPLUS_TREE_VERSION_LOCKED, __ATOMIC_RELEASE);
+}
+
+// 解锁并标记节点已从树中移除
+static inline void b_plus_tree_unlock_obsolete(BPlusTreeNode* node) {
+    __atomic_fetch_add(&node->version, BPLUS_TREE_VERSION_LOCKED + BPLUS_TREE_VERSION_OBSOLETE, __ATOMIC_RELEASE);
+}
+
+static inline BPlusTreeNode* b_plus_tree_load_root(BPlusTree* tree) {
+    return __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+}
+
+// 线程对应的读者计数槽
+static uint32_t b_plus_tree_next_slot = 0;
+static __thread uint32_t b_plus_tree_thread_slot = UINT32_MAX;
+
+// 进入读临界区，返回用于退出的令牌（槽号和纪元奇偶位）
+static uint32_t b_plus_tree_enter(BPlusTree* tree) {
+    if (b_plus_tree_thread_slot == UINT32_MAX) {
+        b_plus_tree_thread_slot = __atomic_fetch_add(&b_plus_tree_next_slot, 1, __ATOMIC_RELAXED) % BPLUS_TREE_EPOCH_SLOTS;
+    }
+    BPlusTreeEpochSlot* slot = &tree->epoch_slots[b_plus_tree_thread_slot];
+
+    for (;;) {
+        uint64_t epoch = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+        uint32_t parity = (uint32_t)(epoch & 1);
+        __atomic_fetch_add(&slot->readers[parity], 1, __ATOMIC_SEQ_CST);
+        // 登记期间纪元推进，回收者可能没有看到这次登记，重新登记
+        if (__atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return b_plus_tree_thread_slot * 2 + parity;
+        }
+        __atomic_fetch_sub(&slot->readers[parity], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// 退出读临界区
+static void b_plus_tree_exit(BPlusTree* tree, uint32_t token) {
+    __atomic_fetch_sub(&tree->epoch_slots[token / 2].readers[token % 2], 1, __ATOMIC_RELEASE);
+}
+
+// 延迟释放已从树中移除的对象
+static void b_plus_tree_retire(BPlusTree* tree, void* pointer, void (*destroy)(void*)) {
+    pthread_mutex_lock(&tree->reclaim_mutex);
+
+    if (tree->retired_count == tree->retired_capacity) {
+        size_t new_capacity = tree->retired_capacity ? tree->retired_capacity * 2 : BPLUS_TREE_RECLAIM_THRESHOLD;
+        BPlusTreeRetired* retired = (BPlusTreeRetired*)realloc(tree->retired, sizeof(BPlusTreeRetired) * new_capacity);
+        if (!retired) {
+            // 无法记录时宁可泄漏也不能释放可能仍被读者访问的内存
+            pthread_mutex_unlock(&tree->reclaim_mutex);
+            fprintf(stderr, "Failed to defer B+ tree reclamation\n");
+            return;
+        }
+        tree->retired = retired;
+        tree->retired_capacity = new_capacity;
+    }
+    tree->retired[tree->retired_count].pointer = pointer;
+    tree->retired[tree->retired_count].destroy = destroy;
+    // 计数在锁外用于快速判断是否需要回收
+    __atomic_store_n(&tree->retired_count, tree->retired_count + 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&tree->reclaim_mutex);
+}
+
+// 释放待回收列表中的对象
+static void b_plus_tree_free_retired(BPlusTreeRetired* retired, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        retired[i].destroy(retired[i].pointer);
+    }
+}
+
+// 回收不再可能被读者访问的对象（调用者不能处于读临界区）
+// 待回收列表在纪元推进时整体转为等待状态；旧奇偶位的读者全部退出后释放，
+// 然后才能再次推进纪元，因此旧奇偶位上只会有推进前一个纪元的读者。
+static void b_plus_tree_reclaim(BPlusTree* tree) {
+    if (__atomic_load_n(&tree->retired_count, __ATOMIC_RELAXED) < BPLUS_TREE_RECLAIM_THRESHOLD &&
+        __atomic_load_n(&tree->pending_count, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    if (pthread_mutex_trylock(&tree->reclaim_mutex) != 0) {
+        return;
+    }
+
+    if (tree->pending_count > 0) {
+        bool drained = true;
+        for (uint32_t i = 0; i < BPLUS_TREE_EPOCH_SLOTS && drained; i++) {
+            drained = __atomic_load_n(&tree->epoch_slots[i].readers[tree->pending_parity], __ATOMIC_SEQ_CST) == 0;
+        }
+        if (drained) {
+            b_plus_tree_free_retired(tree->pending, tree->pending_count);
+            __atomic_store_n(&tree->pending_count, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (tree->pending_count == 0 && tree->retired_count >= BPLUS_TREE_RECLAIM_THRESHOLD) {
+        BPlusTreeRetired* empty = tree->pending;
+        size_t empty_capacity = tree->pending_capacity;
+        tree->pending = tree->retired;
+        tree->pending_capacity = tree->retired_capacity;
+        __atomic_store_n(&tree->pending_count, tree->retired_count, __ATOMIC_RELAXED);
+        tree->pending_parity = (uint32_t)(tree->epoch & 1);
+        tree->retired = empty;
+        tree->retired_capacity = empty_capacity;
+        __atomic_store_n(&tree->retired_count, 0, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&tree->epoch, 1, __ATOMIC_SEQ_CST);
+    }
+
+    pthread_mutex_unlock(&tree->reclaim_mutex);
+}
+
+// 查找叶子节点（不能与写操作并发）
+BPlusTreeNode* b_plus_tree_find_leaf(BPlusTree* tree, const void* key) {
+    BPlusTreeNode* node = tree->root;
+
+    while (node->type == NODE_TYPE_INTERNAL) {
+        node = node->ptrs.children[b_plus_tree_search(tree, node, key, true)];
+    }
+
+    return node;
+}
+
+// 分裂父节点的第index个子节点（子节点已满，父节点未满），返回分裂出的右节点
+BPlusTreeNode* b_plus_tree_split_node(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_split(tree, parent, index);
+    }
+
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    BPlusTreeNode* new_node = b_plus_tree_create_node(tree, node->type);
+    if (!new_node) {
+        return NULL;
+    }
+
+    uint32_t mid = node->key_count / 2;
+    const void* separator;
+
+    if (node->type == NODE_TYPE_LEAF) {
+        // 后一半键值对移到新节点，新节点的第一个键作为分隔键
+        new_node->key_count = node->key_count - mid;
+        b_plus_tree_copy_keys(tree, new_node, 0, node, mid, new_node->key_count);
+        memcpy(new_node->ptrs.values, node->ptrs.values + mid, sizeof(void*) * new_node->key_count);
+        B_PLUS_TREE_STORE(&node->key_count, mid);
+
+        b_plus_tree_link_leaf(tree, node, new_node);
+        separator = b_plus_tree_key_at(tree, new_node, 0);
+    } else {
+        // 中间的键上移到父节点，之后的键和子节点移到新节点
+        new_node->key_count = node->key_count - mid - 1;
+        b_plus_tree_copy_keys(tree, new_node, 0, node, mid + 1, new_node->key_count);
+        memcpy(new_node->ptrs.children, node->ptrs.children + mid + 1, sizeof(BPlusTreeNode*) * (new_node->key_count + 1));
+        B_PLUS_TREE_STORE(&node->key_count, mid);
+
+        separator = b_plus_tree_key_at(tree, node, mid);
+    }
+
+    // 插入分隔键到父节点
+    b_plus_tree_move_keys(tree, parent, index + 1, index, parent->key_count - index);
+    b_plus_tree_move_pointers(parent->ptrs.children + index + 2, parent->ptrs.children + index + 1, parent->key_count - index);
+    b_plus_tree_set_key(tree, parent, index, separator);
+    B_PLUS_TREE_STORE_POINTER(&parent->ptrs.children[index + 1], new_node);
+    B_PLUS_TREE_STORE(&parent->key_count, parent->key_count + 1);
+
+    return new_node;
+}
+
+// 分裂根节点，树高加一（调用者持有根节点的写锁）
+static bool b_plus_tree_split_root(BPlusTree* tree, BPlusTreeNode* root) {
+    BPlusTreeNode* new_root = b_plus_tree_create_node(tree, NODE_TYPE_INTERNAL);
+    if (!new_root) {
+        return false;
+    }
+
+    new_root->ptrs.children[0] = root;
+    if (!b_plus_tree_split_node(tree, new_root, 0)) {
+        free(new_root);
+        return false;
+    }
+
+    __atomic_store_n(&tree->root, new_root, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&tree->height, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// 合并父节点的第index个和第index + 1个子节点，返回合并后的节点
+// 右节点已从树中移除但不释放，由调用者延迟回收。变长键节点合并后放不下时返回NULL
+BPlusTreeNode* b_plus_tree_merge_nodes(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_merge(tree, parent, index, 0);
+    }
+
+    BPlusTreeNode* left = parent->ptrs.children[index];
+    BPlusTreeNode* right = parent->ptrs.children[index + 1];
+
+    if (left->type == NODE_TYPE_LEAF) {
+        b_plus_tree_copy_keys(tree, left, left->key_count, right, 0, right->key_count);
+        b_plus_tree_move_pointers(left->ptrs.values + left->key_count, right->ptrs.values, right->key_count);
+        B_PLUS_TREE_STORE(&left->key_count, left->key_count + right->key_count);
+        b_plus_tree_unlink_leaf(tree, left, right);
+    } else {
+        // 父节点的分隔键下移到两个节点的键之间
+        b_plus_tree_set_key(tree, left, left->key_count, b_plus_tree_key_at(tree, parent, index));
+        b_plus_tree_copy_keys(tree, left, left->key_count + 1, right, 0, right->key_count);
+        b_plus_tree_move_pointers(left->ptrs.children + left->key_count + 1, right->ptrs.children, right->key_count + 1);
+        B_PLUS_TREE_STORE(&left->key_count, left->key_count + right->key_count + 1);
+    }
+
+    // 从父节点移除分隔键和右节点
+    b_plus_tree_move_keys(tree, parent, index, index + 1, parent->key_count - index - 1);
+    b_plus_tree_move_pointers(parent->ptrs.children + index + 1, parent->ptrs.children + index + 2, parent->key_count - index - 1);
+    B_PLUS_TREE_STORE(&parent->key_count, parent->key_count - 1);
+
+    return left;
+}
+
+// 从左兄弟借一个键给父节点的第index个子节点
+static bool b_plus_tree_borrow_from_left(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index) {
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    BPlusTreeNode* left = parent->ptrs.children[index - 1];
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_redistribute(tree, parent, index - 1, left->key_count - 1);
+    }
+
+    b_plus_tree_move_keys(tree, node, 1, 0, node->key_count);
+    if (node->type == NODE_TYPE_LEAF) {
+        b_plus_tree_move_pointers(node->ptrs.values + 1, node->ptrs.values, node->key_count);
+        b_plus_tree_set_key(tree, node, 0, b_plus_tree_key_at(tree, left, left->key_count - 1));
+        B_PLUS_TREE_STORE_POINTER(&node->ptrs.values[0], left->ptrs.values[left->key_count - 1]);
+        b_plus_tree_set_key(tree, parent, index - 1, b_plus_tree_key_at(tree, node, 0));
+    } else {
+        b_plus_tree_move_pointers(node->ptrs.children + 1, node->ptrs.children, node->key_count + 1);
+        b_plus_tree_set_key(tree, node, 0, b_plus_tree_key_at(tree, parent, index - 1));
+        B_PLUS_TREE_STORE_POINTER(&node->ptrs.children[0], left->ptrs.children[left->key_count]);
+        b_plus_tree_set_key(tree, parent, index - 1, b_plus_tree_key_at(tree, left, left->key_count - 1));
+    }
+    B_PLUS_TREE_STORE(&node->key_count, node->key_count + 1);
+    B_PLUS_TREE_STORE(&left->key_count, left->key_count - 1);
+    return true;
+}
+
+// 从右兄弟借一个键给父节点的第index个子节点
+static bool b_plus_tree_borrow_from_right(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index) {
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    BPlusTreeNode* right = parent->ptrs.children[index + 1];
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_redistribute(tree, parent, index, node->key_count + 1);
+    }
+
+    if (node->type == NODE_TYPE_LEAF) {
+        b_plus_tree_set_key(tree, node, node->key_count, b_plus_tree_key_at(tree, right, 0));
+        B_PLUS_TREE_STORE_POINTER(&node->ptrs.values[node->key_count], right->ptrs.values[0]);
+        b_plus_tree_move_pointers(right->ptrs.values, right->ptrs.values + 1, right->key_count - 1);
+        b_plus_tree_move_keys(tree, right, 0, 1, right->key_count - 1);
+        B_PLUS_TREE_STORE(&right->key_count, right->key_count - 1);
+        b_plus_tree_set_key(tree, parent, index, b_plus_tree_key_at(tree, right, 0));
+    } else {
+        b_plus_tree_set_key(tree, node, node->key_count, b_plus_tree_key_at(tree, parent, index));
+        B_PLUS_TREE_STORE_POINTER(&node->ptrs.children[node->key_count + 1], right->ptrs.children[0]);
+        b_plus_tree_set_key(tree, parent, index, b_plus_tree_key_at(tree, right, 0));
+        b_plus_tree_move_pointers(right->ptrs.children, right->ptrs.children + 1, right->key_count);
+        b_plus_tree_move_keys(tree, right, 0, 1, right->key_count - 1);
+        B_PLUS_TREE_STORE(&right->key_count, right->key_count - 1);
+    }
+    B_PLUS_TREE_STORE(&node->key_count, node->key_count + 1);
+    return true;
+}
+
+// 保证父节点的第index个子节点删除一个键后不会下溢：
+// 从有富余的兄弟节点借一个键，否则与兄弟节点合并。removed返回因合并而移除的节点（没有时为NULL）。
+// 变长键节点重组需要分配临时空间，分配失败时返回false
+static bool b_plus_tree_fill_child(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index, BPlusTreeNode** removed) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        return b_plus_tree_var_fill_child(tree, parent, index, removed);
+    }
+
+    BPlusTreeNode* node = parent->ptrs.children[index];
+    BPlusTreeNode* left = index > 0 ? parent->ptrs.children[index - 1] : NULL;
+    BPlusTreeNode* right = index < parent->key_count ? parent->ptrs.children[index + 1] : NULL;
+
+    *removed = NULL;
+    if (left && left->key_count > b_plus_tree_node_min_keys(left)) {
+        return b_plus_tree_borrow_from_left(tree, parent, index);
+    }
+    if (right && right->key_count > b_plus_tree_node_min_keys(right)) {
+        return b_plus_tree_borrow_from_right(tree, parent, index);
+    }
+    if (left) {
+        b_plus_tree_merge_nodes(tree, parent, index - 1);
+        *removed = node;
+        return true;
+    }
+    b_plus_tree_merge_nodes(tree, parent, index);
+    *removed = right;
+    return true;
+}
+
+// 创建B+树（节点容量和键布局由调用者设置）
+static BPlusTree* b_plus_tree_create_internal(BPlusTree* config) {
+    BPlusTree* tree = (BPlusTree*)malloc(sizeof(BPlusTree));
+    if (!tree) {
+        return NULL;
+    }
+
+    *tree = *config;
+    tree->node_size = B_PLUS_TREE_ALIGN(b_plus_tree_node_bytes(tree->key_area_size, tree->node_capacity), BPLUS_TREE_CACHE_LINE_SIZE);
+
+    void* slots = NULL;
+    if (posix_memalign(&slots, BPLUS_TREE_CACHE_LINE_SIZE, sizeof(BPlusTreeEpochSlot) * BPLUS_TREE_EPOCH_SLOTS) != 0) {
+        free(tree);
+        return NULL;
+    }
+    memset(slots, 0, sizeof(BPlusTreeEpochSlot) * BPLUS_TREE_EPOCH_SLOTS);
+    tree->epoch_slots = (BPlusTreeEpochSlot*)slots;
+
+    // 创建根节点（叶子节点）
+    BPlusTreeNode* root = b_plus_tree_create_node(tree, NODE_TYPE_LEAF);
+    if (!root) {
+        free(tree->epoch_slots);
+        free(tree);
+        return NULL;
+    }
+    pthread_mutex_init(&tree->reclaim_mutex, NULL);
+
+    tree->root = root;
+    tree->first_leaf = root;
+    tree->last_leaf = root;
+    tree->height = 1;
+
+    return tree;
+}
+
+// 创建B+树索引
+BPlusTree* b_plus_tree_create(uint32_t node_capacity, size_t key_size, size_t value_size,
+                             int (*compare)(const void*, const void*),
+                             void (*destroy_key)(void*),
+                             void (*destroy_value)(void*)) {
+    if (!compare) {
+        return NULL;
+    }
+
+    BPlusTree config;
+    memset(&config, 0, sizeof(config));
+    config.node_capacity = node_capacity < BPLUS_TREE_MIN_CAPACITY ? BPLUS_TREE_MIN_CAPACITY : node_capacity;
+    config.key_type = BPLUS_TREE_KEY_POINTER;
+    config.key_size = key_size;
+    config.key_stride = sizeof(void*);
+    config.key_area_size = sizeof(void*) * config.node_capacity;
+    config.value_size = value_size;
+    config.compare = compare;
+    config.destroy_key = destroy_key;
+    config.destroy_value = destroy_value;
+
+    return b_plus_tree_create_internal(&config);
+}
+
+// 创建定长键B+树索引
+BPlusTree* b_plus_tree_create_fixed(BPlusTreeKeyType key_type, size_t key_size, size_t node_size,
+                                   void (*destroy_value)(void*)) {
+    if (key_type == BPLUS_TREE_KEY_INT64) {
+        key_size = sizeof(int64_t);
+    } else if (key_type != BPLUS_TREE_KEY_FIXED || key_size == 0) {
+        return NULL;
+    }
+    if (node_size == 0) {
+        node_size = BPLUS_TREE_DEFAULT_NODE_SIZE;
+    }
+
+    // 按节点大小计算容量：每个键占key_size字节和一个值（或子节点）指针
+    size_t fixed_size = b_plus_tree_header_size() + sizeof(void*);
+    size_t capacity = node_size > fixed_size ? (node_size - fixed_size) / (key_size + sizeof(void*)) : 0;
+    while (capacity > BPLUS_TREE_MIN_CAPACITY &&
+           b_plus_tree_node_bytes(B_PLUS_TREE_ALIGN(key_size * capacity, sizeof(void*)), (uint32_t)capacity) > node_size) {
+        capacity--;
+    }
+    if (capacity < BPLUS_TREE_MIN_CAPACITY) {
+        capacity = BPLUS_TREE_MIN_CAPACITY;
+    }
+
+    BPlusTree config;
+    memset(&config, 0, sizeof(config));
+    config.node_capacity = (uint32_t)capacity;
+    config.key_type = key_type;
+    config.key_size = key_size;
+    config.key_stride = key_size;
+    config.key_area_size = B_PLUS_TREE_ALIGN(key_size * capacity, sizeof(void*));
+    config.value_size = sizeof(void*);
+    config.destroy_value = destroy_value;
+
+    return b_plus_tree_create_internal(&config);
+}
+
+// 创建变长键B+树索引
+BPlusTree* b_plus_tree_create_variable(size_t max_key_length, size_t node_size,
+                                      void (*destroy_value)(void*)) {
+    if (max_key_length == 0 || max_key_length > BPLUS_TREE_MAX_KEY_LENGTH) {
+        return NULL;
+    }
+    if (node_size == 0) {
+        node_size = BPLUS_TREE_DEFAULT_NODE_SIZE;
+    }
+
+    // 槽数上限按每个键平均8字节后缀估算：每个键占一个槽、后缀和一个值（或子节点）指针，
+    // 其余空间作为键区
+    size_t fixed_size = b_plus_tree_header_size() + sizeof(void*);
+    size_t entry_size = sizeof(BPlusTreeVarSlot) + 8 + sizeof(void*);
+    size_t capacity = node_size > fixed_size ? (node_size - fixed_size) / entry_size : 0;
+    if (capacity < BPLUS_TREE_MIN_CAPACITY) {
+        return NULL;
+    }
+    size_t area = (node_size - fixed_size - sizeof(void*) * capacity) & ~(size_t)(sizeof(void*) - 1);
+    if (area > B_PLUS_TREE_VAR_MAX_AREA) {
+        area = B_PLUS_TREE_VAR_MAX_AREA;
+    }
+
+    // 按字节分裂后两个节点都要能再容纳一个最长的键和各自的上下界
+    if (sizeof(BPlusTreeVarHeader) + 10 * (sizeof(BPlusTreeVarSlot) + max_key_length) > area) {
+        fprintf(stderr, "B+ tree node size %zu is too small for keys of %zu bytes\n", node_size, max_key_length);
+        return NULL;
+    }
+
+    BPlusTree config;
+    memset(&config, 0, sizeof(config));
+    config.node_capacity = (uint32_t)capacity;
+    config.key_type = BPLUS_TREE_KEY_VARIABLE;
+    config.key_size = max_key_length;
+    config.key_stride = B_PLUS_TREE_ALIGN(offsetof(BPlusTreeKey, data) + max_key_length, sizeof(uint16_t));
+    config.key_area_size = area;
+    config.value_size = sizeof(void*);
+    config.destroy_value = destroy_value;
+
+    return b_plus_tree_create_internal(&config);
+}
+
+// 规范化键编码：清空键
+void b_plus_tree_key_init(BPlusTreeKey* key) {
+    key->length = 0;
+}
+
+// 追加int64列：符号位取反后负数排在正数之前，大端序使字节顺序与数值顺序一致
+bool b_plus_tree_key_append_int64(BPlusTreeKey* key, int64_t value) {
+    if (key->length + sizeof(int64_t) > BPLUS_TREE_MAX_KEY_LENGTH) {
+        return false;
+    }
+
+    uint64_t bits = (uint64_t)value ^ ((uint64_t)1 << 63);
+    for (int i = 0; i < 8; i++) {
+        key->data[key->length++] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    return true;
+}
+
+// 追加字符串列：0x00转义为0x00 0xFF，以0x00 0x00结尾。
+// 结尾标记小于任何字符，较短的字符串排在以它为前缀的字符串之前，后续列不会影响字符串之间的顺序
+bool b_plus_tree_key_append_string(BPlusTreeKey* key, const char* value, size_t length) {
+    size_t encoded = length + 2;
+    for (size_t i = 0; i < length; i++) {
+        encoded += value[i] == '\0';
+    }
+    if (key->length + encoded > BPLUS_TREE_MAX_KEY_LENGTH) {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        key->data[key->length++] = (uint8_t)value[i];
+        if (value[i] == '\0') {
+            key->data[key->length++] = 0xFF;
+        }
+    }
+    key->data[key->length++] = 0x00;
+    key->data[key->length++] = 0x00;
+    return true;
+}
+
+// 销毁B+树索引
+void b_plus_tree_destroy(BPlusTree* tree) {
+    if (!tree) {
+        return;
+    }
+
+    b_plus_tree_destroy_node(tree, tree->root);
+
+    // 销毁时不再有并发读者，待回收的对象全部释放
+    b_plus_tree_free_retired(tree->pending, tree->pending_count);
+    b_plus_tree_free_retired(tree->retired, tree->retired_count);
+    free(tree->pending);
+    free(tree->retired);
+    free(tree->epoch_slots);
+    pthread_mutex_destroy(&tree->reclaim_mutex);
+    free(tree);
+}
+
+// 乐观操作的结果
+typedef enum {
+    B_PLUS_TREE_RESTART, // 读取的节点被并发修改，从根节点重试
+    B_PLUS_TREE_DONE,
+    B_PLUS_TREE_NOT_FOUND,
+    B_PLUS_TREE_FAILED
+} BPlusTreeStatus;
+
+// 解锁一组节点
+static void b_plus_tree_unlock_all(BPlusTreeNode** nodes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        b_plus_tree_unlock(nodes[i]);
+    }
+}
+
+// 分裂已满的节点：锁定父节点、节点和（叶子节点的）后继，分裂后从根节点重试
+static BPlusTreeStatus b_plus_tree_try_split(BPlusTree* tree, BPlusTreeNode* parent, uint64_t parent_version,
+                                             uint32_t index, BPlusTreeNode* node, uint64_t version) {
+    BPlusTreeNode* locked[3];
+    size_t locked_count = 0;
+
+    if (parent) {
+        if (!b_plus_tree_upgrade_lock(parent, parent_version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        locked[locked_count++] = parent;
+    }
+    if (!b_plus_tree_upgrade_lock(node, version)) {
+        b_plus_tree_unlock_all(locked, locked_count);
+        return B_PLUS_TREE_RESTART;
+    }
+    locked[locked_count++] = node;
+
+    // 分裂会修改后继叶子节点的前驱指针
+    if (node->type == NODE_TYPE_LEAF && node->next) {
+        if (!b_plus_tree_try_lock(node->next)) {
+            b_plus_tree_unlock_all(locked, locked_count);
+            return B_PLUS_TREE_RESTART;
+        }
+        locked[locked_count++] = node->next;
+    }
+
+    // 没有父节点时node是根节点（根节点被替换前必须先锁定旧根节点）
+    bool split = parent ? b_plus_tree_split_node(tree, parent, index) != NULL : b_plus_tree_split_root(tree, node);
+    b_plus_tree_unlock_all(locked, locked_count);
+
+    return split ? B_PLUS_TREE_RESTART : B_PLUS_TREE_FAILED;
+}
+
+// 补足键数不超过最少键数的子节点：锁定父节点、子节点、兄弟节点和受影响的后继叶子节点，
+// 借键或合并后从根节点重试
+static BPlusTreeStatus b_plus_tree_try_fill(BPlusTree* tree, BPlusTreeNode* parent, uint64_t parent_version,
+                                            uint32_t index, BPlusTreeNode* node, uint64_t version) {
+    BPlusTreeNode* locked[5];
+    size_t locked_count = 0;
+
+    if (!b_plus_tree_upgrade_lock(parent, parent_version)) {
+        return B_PLUS_TREE_RESTART;
+    }
+    locked[locked_count++] = parent;
+    if (!b_plus_tree_upgrade_lock(node, version)) {
+        b_plus_tree_unlock_all(locked, locked_count);
+        return B_PLUS_TREE_RESTART;
+    }
+    locked[locked_count++] = node;
+
+    BPlusTreeNode* siblings[3];
+    siblings[0] = index > 0 ? parent->ptrs.children[index - 1] : NULL;
+    siblings[1] = index < parent->key_count ? parent->ptrs.children[index + 1] : NULL;
+    siblings[2] = NULL;
+    for (int i = 0; i < 3; i++) {
+        if (i == 2 && node->type == NODE_TYPE_LEAF) {
+            // 合并会修改最右侧参与节点的后继的前驱指针（在锁定右兄弟之后读取）
+            siblings[2] = siblings[1] ? siblings[1]->next : node->next;
+        }
+        if (!siblings[i]) {
+            continue;
+        }
+        if (!b_plus_tree_try_lock(siblings[i])) {
+            b_plus_tree_unlock_all(locked, locked_count);
+            return B_PLUS_TREE_RESTART;
+        }
+        locked[locked_count++] = siblings[i];
+    }
+
+    BPlusTreeNode* removed = NULL;
+    if (!b_plus_tree_fill_child(tree, parent, index, &removed)) {
+        b_plus_tree_unlock_all(locked, locked_count);
+        return B_PLUS_TREE_FAILED;
+    }
+
+    // 根节点的最后一个分隔键下移后，树高减一
+    BPlusTreeNode* removed_root = NULL;
+    if (parent == b_plus_tree_load_root(tree) && parent->key_count == 0) {
+        __atomic_store_n(&tree->root, parent->ptrs.children[0], __ATOMIC_RELEASE);
+        __atomic_fetch_sub(&tree->height, 1, __ATOMIC_RELAXED);
+        removed_root = parent;
+    }
+
+    for (size_t i = 0; i < locked_count; i++) {
+        if (locked[i] == removed || locked[i] == removed_root) {
+            b_plus_tree_unlock_obsolete(locked[i]);
+            b_plus_tree_retire(tree, locked[i], free);
+        } else {
+            b_plus_tree_unlock(locked[i]);
+        }
+    }
+
+    return B_PLUS_TREE_RESTART;
+}
+
+// 乐观查找
+static BPlusTreeStatus b_plus_tree_try_find(BPlusTree* tree, const void* key, void** value) {
+    BPlusTreeNode* node = b_plus_tree_load_root(tree);
+    uint64_t version;
+    if (!b_plus_tree_read_lock(node, &version) || node != b_plus_tree_load_root(tree)) {
+        return B_PLUS_TREE_RESTART;
+    }
+
+    while (node->type == NODE_TYPE_INTERNAL) {
+        BPlusTreeNode* child = B_PLUS_TREE_LOAD_POINTER(&node->ptrs.children[b_plus_tree_search(tree, node, key, true)]);
+        if (!b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        uint64_t child_version;
+        if (!b_plus_tree_read_lock(child, &child_version) || !b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        node = child;
+        version = child_version;
+    }
+
+    uint32_t index = b_plus_tree_search(tree, node, key, false);
+    bool found = index < b_plus_tree_load_count(node) && b_plus_tree_compare_at(tree, node, index, key) == 0;
+    void* result = found ? B_PLUS_TREE_LOAD_POINTER(&node->ptrs.values[index]) : NULL;
+    if (!b_plus_tree_validate(node, version)) {
+        return B_PLUS_TREE_RESTART;
+    }
+
+    *value = result;
+    return found ? B_PLUS_TREE_DONE : B_PLUS_TREE_NOT_FOUND;
+}
+
+// 乐观插入
+// 下降过程中遇到已满的节点先分裂再重试，保证插入时父节点总有空间容纳分隔键
+static BPlusTreeStatus b_plus_tree_try_insert(BPlusTree* tree, void* key, void* value) {
+    BPlusTreeNode* parent = NULL;
+    uint64_t parent_version = 0;
+    uint32_t index = 0;
+
+    BPlusTreeNode* node = b_plus_tree_load_root(tree);
+    uint64_t version;
+    if (!b_plus_tree_read_lock(node, &version) || node != b_plus_tree_load_root(tree)) {
+        return B_PLUS_TREE_RESTART;
+    }
+
+    for (;;) {
+        if (b_plus_tree_node_needs_split(tree, node, key)) {
+            return b_plus_tree_try_split(tree, parent, parent_version, index, node, version);
+        }
+        if (node->type == NODE_TYPE_LEAF) {
+            break;
+        }
+
+        index = b_plus_tree_search(tree, node, key, true);
+        BPlusTreeNode* child = B_PLUS_TREE_LOAD_POINTER(&node->ptrs.children[index]);
+        if (!b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        uint64_t child_version;
+        if (!b_plus_tree_read_lock(child, &child_version) || !b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        parent = node;
+        parent_version = version;
+        node = child;
+        version = child_version;
+    }
+
+    if (!b_plus_tree_upgrade_lock(node, version)) {
+        return B_PLUS_TREE_RESTART;
+    }
+    if (parent && !b_plus_tree_validate(parent, parent_version)) {
+        b_plus_tree_unlock(node);
+        return B_PLUS_TREE_RESTART;
+    }
+
+    index = b_plus_tree_search(tree, node, key, false);
+
+    // 检查键是否已存在
+    if (index < node->key_count && b_plus_tree_compare_at(tree, node, index, key) == 0) {
+        // 更新值
+        void* old_value = node->ptrs.values[index];
+        bool duplicate_key = tree->key_type == BPLUS_TREE_KEY_POINTER && node->keys[index] != key;
+        B_PLUS_TREE_STORE_POINTER(&node->ptrs.values[index], value);
+        b_plus_tree_unlock(node);
+
+        if (tree->destroy_value && old_value && old_value != value) {
+            tree->destroy_value(old_value);
+        }
+        // 指针键模式下树持有键，重复的键不再需要
+        if (duplicate_key && tree->destroy_key) {
+            tree->destroy_key(key);
+        }
+        return B_PLUS_TREE_DONE;
+    }
+
+    // 插入新键，移动值为新值腾出空间
+    if (!b_plus_tree_insert_key(tree, node, index, key)) {
+        b_plus_tree_unlock(node);
+        return B_PLUS_TREE_FAILED;
+    }
+    b_plus_tree_move_pointers(node->ptrs.values + index + 1, node->ptrs.values + index, node->key_count - index);
+    B_PLUS_TREE_STORE_POINTER(&node->ptrs.values[index], value);
+    B_PLUS_TREE_STORE(&node->key_count, node->key_count + 1);
+
+    b_plus_tree_unlock(node);
+    return B_PLUS_TREE_DONE;
+}
+
+// 乐观删除
+// 下降过程中遇到键数不超过最少键数的子节点先补足再重试，保证删除后无需向上回溯。
+// 指针键模式下被删除的键可能是祖先节点的分隔键（分隔键总是右侧子树中最小的键），
+// 释放前锁定从该祖先到叶子的整条路径，把分隔键替换为叶子节点新的第一个键，
+// 已经越过该祖先的并发写者会在路径上某个节点的版本校验中失败并重试。
+static BPlusTreeStatus b_plus_tree_try_delete(BPlusTree* tree, const void* key) {
+    BPlusTreeNode* path[BPLUS_TREE_MAX_HEIGHT];
+    uint64_t versions[BPLUS_TREE_MAX_HEIGHT];
+    uint32_t depth = 0;
+    bool track_separator = tree->key_type == BPLUS_TREE_KEY_POINTER && tree->destroy_key;
+    int separator_depth = -1;
+    uint32_t separator_index = 0;
+
+    BPlusTreeNode* node = b_plus_tree_load_root(tree);
+    uint64_t version;
+    if (!b_plus_tree_read_lock(node, &version) || node != b_plus_tree_load_root(tree)) {
+        return B_PLUS_TREE_RESTART;
+    }
+
+    // 变长键节点借键时父节点的分隔键可能变长，下降过程中和插入一样先分裂空间不足的内部节点
+    bool split_full = tree->key_type == BPLUS_TREE_KEY_VARIABLE;
+    if (split_full && node->type == NODE_TYPE_INTERNAL && b_plus_tree_node_needs_split(tree, node, NULL)) {
+        return b_plus_tree_try_split(tree, NULL, 0, 0, node, version);
+    }
+
+    while (node->type == NODE_TYPE_INTERNAL) {
+        if (depth == BPLUS_TREE_MAX_HEIGHT) {
+            return B_PLUS_TREE_FAILED;
+        }
+
+        uint32_t index = b_plus_tree_search(tree, node, key, true);
+        if (track_separator && index > 0 && tree->compare(B_PLUS_TREE_LOAD_POINTER(&node->keys[index - 1]), key) == 0) {
+            separator_depth = (int)depth;
+            separator_index = index - 1;
+        }
+        BPlusTreeNode* child = B_PLUS_TREE_LOAD_POINTER(&node->ptrs.children[index]);
+        if (!b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        uint64_t child_version;
+        if (!b_plus_tree_read_lock(child, &child_version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+        if (b_plus_tree_load_count(child) <= b_plus_tree_node_min_keys(child)) {
+            return b_plus_tree_try_fill(tree, node, version, index, child, child_version);
+        }
+        if (split_full && child->type == NODE_TYPE_INTERNAL && b_plus_tree_node_needs_split(tree, child, NULL)) {
+            return b_plus_tree_try_split(tree, node, version, index, child, child_version);
+        }
+        if (!b_plus_tree_validate(node, version)) {
+            return B_PLUS_TREE_RESTART;
+        }
+
+        path[depth] = node;
+        versions[depth] = version;
+        depth++;
+        node = child;
+        version = child_version;
+    }
+
+    if (!b_plus_tree_upgrade_lock(node, version)) {
+        return B_PLUS_TREE_RESTART;
+    }
+    if (depth > 0 && !b_plus_tree_validate(path[depth - 1], versions[depth - 1])) {
+        b_plus_tree_unlock(node);
+        return B_PLUS_TREE_RESTART;
+    }
+
+    uint32_t index = b_plus_tree_search(tree, node, key, false);
+
+    // 检查键是否存在
+    if (index >= node->key_count || b_plus_tree_compare_at(tree, node, index, key) != 0) {
+        b_plus_tree_unlock(node);
+        return B_PLUS_TREE_NOT_FOUND;
+    }
+
+    void* stored_key = tree->key_type == BPLUS_TREE_KEY_POINTER ? node->keys[index] : NULL;
+    void* value = node->ptrs.values[index];
+
+    // 锁定从分隔键所在节点到叶子的路径
+    uint32_t locked_from = depth;
+    if (track_separator && index == 0 && separator_depth >= 0 &&
+        B_PLUS_TREE_LOAD_POINTER(&path[separator_depth]->keys[separator_index]) == stored_key) {
+        for (uint32_t d = (uint32_t)separator_depth; d < depth; d++) {
+            if (!b_plus_tree_upgrade_lock(path[d], versions[d])) {
+                b_plus_tree_unlock_all(path + separator_depth, d - (uint32_t)separator_depth);
+                b_plus_tree_unlock(node);
+                return B_PLUS_TREE_RESTART;
+            }
+        }
+        locked_from = (uint32_t)separator_depth;
+    }
+
+    // 移动键和值填补空缺
+    b_plus_tree_remove_key(tree, node, index);
+    b_plus_tree_move_pointers(node->ptrs.values + index, node->ptrs.values + index + 1, node->key_count - index - 1);
+    B_PLUS_TREE_STORE(&node->key_count, node->key_count - 1);
+
+    if (locked_from < depth) {
+        B_PLUS_TREE_STORE_POINTER(&path[separator_depth]->keys[separator_index], node->keys[0]);
+        b_plus_tree_unlock_all(path + locked_from, depth - locked_from);
+    }
+    b_plus_tree_unlock(node);
+
+    // 并发读者可能仍在比较被删除的键，延迟释放；值由调用者保证不再使用
+    if (stored_key && tree->destroy_key) {
+        b_plus_tree_retire(tree, stored_key, tree->destroy_key);
+    }
+    if (tree->destroy_value && value) {
+        tree->destroy_value(value);
+    }
+
+    return B_PLUS_TREE_DONE;
+}
+
+// 检查键的长度（变长键不能超过创建时指定的最大长度）
+static inline bool b_plus_tree_key_valid(const BPlusTree* tree, const void* key) {
+    return tree->key_type != BPLUS_TREE_KEY_VARIABLE || ((const BPlusTreeKey*)key)->length <= tree->key_size;
+}
+
+// 插入键值对
+bool b_plus_tree_insert(BPlusTree* tree, void* key, void* value) {
+    if (!tree || !key || !b_plus_tree_key_valid(tree, key)) {
+        return false;
+    }
+
+    uint32_t token = b_plus_tree_enter(tree);
+    BPlusTreeStatus status;
+    do {
+        status = b_plus_tree_try_insert(tree, key, value);
+    } while (status == B_PLUS_TREE_RESTART);
+    b_plus_tree_exit(tree, token);
 
-// 检查节点是否已满
-bool b_plus_tree_node_is_full(BPlusTreeNode* node) {
-    return node->key_count >= node->capacity;
+    return status == B_PLUS_TREE_DONE;
 }
 
-// 检查节点是否下溢
-bool b_plus_tree_node_is_underflow(BPlusTreeNode* node) {
-    return node->key_count < node->capacity / 2;
-}
+// 删除键值对
+bool b_plus_tree_delete(BPlusTree* tree, void* key) {
+    if (!tree || !key || !b_plus_tree_key_valid(tree, key)) {
+        return false;
+    }
 
-// 查找键在节点中的索引
-int b_plus_tree_find_key_index(BPlusTreeNode* node, void* key, int (*compare)(const void*, const void*)) {
-    int left = 0;
-    int right = node->key_count - 1;
-    int index = -1;
+    uint32_t token = b_plus_tree_enter(tree);
+    BPlusTreeStatus status;
+    do {
+        status = b_plus_tree_try_delete(tree, key);
+    } while (status == B_PLUS_TREE_RESTART);
+    b_plus_tree_exit(tree, token);
 
-    while (left <= right) {
-        int mid = (left + right) / 2;
-        int cmp = compare(key, node->keys[mid]);
+    b_plus_tree_reclaim(tree);
+    return status == B_PLUS_TREE_DONE;
+}
 
-        if (cmp == 0) {
-            return mid;
-        } else if (cmp < 0) {
-            right = mid - 1;
-        } else {
-            left = mid + 1;
-        }
+// 查找键对应的值
+void* b_plus_tree_find(BPlusTree* tree, void* key) {
+    if (!tree || !key || !b_plus_tree_key_valid(tree, key)) {
+        return NULL;
     }
 
-    return left;
-}
+    void* value = NULL;
+    uint32_t token = b_plus_tree_enter(tree);
+    while (b_plus_tree_try_find(tree, key, &value) == B_PLUS_TREE_RESTART) {
+    }
+    b_plus_tree_exit(tree, token);
 
-// 查找叶子节点
-BPlusTreeNode* b_plus_tree_find_leaf(BPlusTree* tree, void* key) {
-    BPlusTreeNode* node = tree->root;
+    return value;
+}
 
-    while (node->type == NODE_TYPE_INTERNAL) {
-        int index = b_plus_tree_find_key_index(node, key, tree->compare);
-        node = node->ptrs.children[index];
+// 槽格式的键（与节点键数组相同：指针键模式下为键指针，定长键模式下为键的内容）
+static inline const void* b_plus_tree_slot_key(const BPlusTree* tree, const uint8_t* slot) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        return *(void* const*)slot;
     }
+    return slot;
+}
 
-    return node;
+// 把键保存为槽格式
+static inline void b_plus_tree_store_slot(const BPlusTree* tree, uint8_t* slot, const void* key) {
+    if (tree->key_type == BPLUS_TREE_KEY_POINTER) {
+        memcpy(slot, &key, sizeof(void*));
+    } else if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        memcpy(slot, key, offsetof(BPlusTreeKey, data) + ((const BPlusTreeKey*)key)->length);
+    } else {
+        memcpy(slot, key, tree->key_stride);
+    }
 }
 
-// 分割节点
-BPlusTreeNode* b_plus_tree_split_node(BPlusTree* tree, BPlusTreeNode* node) {
-    BPlusTreeNode* new_node = b_plus_tree_create_node(tree, node->type);
-    if (!new_node) {
+// 打开范围游标
+BPlusTreeCursor* b_plus_tree_cursor_open(BPlusTree* tree, const void* start_key, const void* end_key, bool reverse) {
+    if (!tree || (start_key && !b_plus_tree_key_valid(tree, start_key)) || (end_key && !b_plus_tree_key_valid(tree, end_key))) {
         return NULL;
     }
 
-    uint32_t mid = node->key_count / 2;
+    // 起止键、上次返回的键和暂存键紧跟游标结构存放
+    BPlusTreeCursor* cursor = (BPlusTreeCursor*)malloc(sizeof(BPlusTreeCursor) + tree->key_stride * 4);
+    if (!cursor) {
+        return NULL;
+    }
 
-    // 复制键到新节点
-    for (uint32_t i = mid; i < node->key_count; i++) {
-        new_node->keys[new_node->key_count] = node->keys[i];
-        node->keys[i] = NULL;
-        new_node->key_count++;
+    memset(cursor, 0, sizeof(BPlusTreeCursor));
+    cursor->tree = tree;
+    cursor->reverse = reverse;
+    cursor->start_key = (uint8_t*)(cursor + 1);
+    cursor->end_key = cursor->start_key + tree->key_stride;
+    cursor->last_key = cursor->end_key + tree->key_stride;
+    cursor->scratch_key = cursor->last_key + tree->key_stride;
+    if (start_key) {
+        b_plus_tree_store_slot(tree, cursor->start_key, start_key);
+        cursor->has_start = true;
+    }
+    if (end_key) {
+        b_plus_tree_store_slot(tree, cursor->end_key, end_key);
+        cursor->has_end = true;
     }
 
-    // 复制值或子节点到新节点
-    if (node->type == NODE_TYPE_INTERNAL) {
-        for (uint32_t i = mid; i < node->key_count + 1; i++) {
-            new_node->ptrs.children[new_node->key_count] = node->ptrs.children[i];
-            node->ptrs.children[i] = NULL;
-            new_node->ptrs.children[new_node->key_count]->parent = new_node;
-            new_node->key_count++;
-        }
-        new_node->key_count--; // 内部节点的子节点数比键数多1
-    } else {
-        for (uint32_t i = mid; i < node->key_count; i++) {
-            new_node->ptrs.values[new_node->key_count] = node->ptrs.values[i];
-            node->ptrs.values[i] = NULL;
-            new_node->key_count++;
+    // 游标打开期间保持在读临界区内，访问过的叶子节点和键不会被释放
+    cursor->token = b_plus_tree_enter(tree);
+    return cursor;
+}
+
+// 定位游标：从根节点下降到应继续遍历的叶子节点
+// 正向时从上次返回的键（或起始键）之后继续，反向时从上次返回的键（或结束键）之前继续
+static void b_plus_tree_cursor_seek(BPlusTreeCursor* cursor) {
+    BPlusTree* tree = cursor->tree;
+    const void* target = NULL;
+    if (cursor->has_last) {
+        target = b_plus_tree_slot_key(tree, cursor->last_key);
+    } else if (!cursor->reverse && cursor->has_start) {
+        target = b_plus_tree_slot_key(tree, cursor->start_key);
+    } else if (cursor->reverse && cursor->has_end) {
+        target = b_plus_tree_slot_key(tree, cursor->end_key);
+    }
+
+    for (;;) {
+        BPlusTreeNode* node = b_plus_tree_load_root(tree);
+        uint64_t version;
+        if (!b_plus_tree_read_lock(node, &version) || node != b_plus_tree_load_root(tree)) {
+            continue;
         }
 
-        // 连接叶子节点
-        new_node->prev = node;
-        new_node->next = node->next;
-        if (node->next) {
-            node->next->prev = new_node;
+        bool restart = false;
+        while (node->type == NODE_TYPE_INTERNAL) {
+            uint32_t index;
+            if (target) {
+                index = b_plus_tree_search(tree, node, target, true);
+            } else {
+                index = cursor->reverse ? b_plus_tree_load_count(node) : 0;
+            }
+            BPlusTreeNode* child = B_PLUS_TREE_LOAD_POINTER(&node->ptrs.children[index]);
+            uint64_t child_version;
+            if (!b_plus_tree_validate(node, version) || !b_plus_tree_read_lock(child, &child_version) ||
+                !b_plus_tree_validate(node, version)) {
+                restart = true;
+                break;
+            }
+            node = child;
+            version = child_version;
+        }
+        if (restart) {
+            continue;
         }
-        node->next = new_node;
 
-        // 更新树的最后叶子节点
-        if (tree->last_leaf == node) {
-            tree->last_leaf = new_node;
+        // 起始位置只是遍历的起点，范围和已返回键的过滤在读取时进行
+        uint32_t position;
+        if (!cursor->reverse) {
+            position = target ? b_plus_tree_search(tree, node, target, false) : 0;
+        } else {
+            position = target ? b_plus_tree_search(tree, node, target, true) : UINT32_MAX;
+        }
+        if (!b_plus_tree_validate(node, version)) {
+            continue;
         }
+
+        cursor->leaf = node;
+        cursor->version = version;
+        cursor->position = position;
+        return;
+    }
+}
+
+// 读取下一批键值对到调用者的缓冲区，返回读取的数量，0表示遍历结束
+// 每个叶子节点读取后校验版本号；叶子被并发修改时丢弃该叶子上读取的结果，
+// 从上次返回的键重新定位。返回的键严格单调，不会重复。
+size_t b_plus_tree_cursor_next(BPlusTreeCursor* cursor, void* keys, void** values, size_t max_count) {
+    if (!cursor || cursor->finished || max_count == 0) {
+        return 0;
     }
 
-    node->key_count = mid;
+    BPlusTree* tree = cursor->tree;
+    uint8_t* key_buffer = (uint8_t*)keys;
+    size_t count = 0;
 
-    // 更新父节点
-    if (node->parent == NULL) {
-        // 创建新的根节点
-        BPlusTreeNode* new_root = b_plus_tree_create_node(tree, NODE_TYPE_INTERNAL);
-        if (!new_root) {
-            b_plus_tree_destroy_node(tree, new_node);
-            return NULL;
+    while (count < max_count && !cursor->finished) {
+        if (!cursor->leaf) {
+            b_plus_tree_cursor_seek(cursor);
         }
 
-        new_root->keys[0] = node->keys[mid];
-        node->keys[mid] = NULL;
-        new_root->ptrs.children[0] = node;
-        new_root->ptrs.children[1] = new_node;
-        new_root->key_count = 1;
+        BPlusTreeNode* leaf = cursor->leaf;
+        size_t leaf_start = count;
+        uint32_t key_count = b_plus_tree_load_count(leaf);
+        uint32_t position = cursor->position > key_count ? key_count : cursor->position;
+        const void* last = cursor->has_last ? b_plus_tree_slot_key(tree, cursor->last_key) : NULL;
+        bool reached_end = false;
+
+        if (!cursor->reverse) {
+            const void* end = cursor->has_end ? b_plus_tree_slot_key(tree, cursor->end_key) : NULL;
+            for (; position < key_count && count < max_count; position++) {
+                if (end && b_plus_tree_compare_at(tree, leaf, position, end) > 0) {
+                    reached_end = true;
+                    break;
+                }
+                if (last && b_plus_tree_compare_at(tree, leaf, position, last) <= 0) {
+                    continue;
+                }
+                b_plus_tree_read_key(tree, leaf, position, cursor->scratch_key);
+                if (key_buffer) {
+                    memcpy(key_buffer + count * tree->key_stride, cursor->scratch_key, b_plus_tree_slot_bytes(tree, cursor->scratch_key));
+                }
+                if (values) {
+                    values[count] = B_PLUS_TREE_LOAD_POINTER(&leaf->ptrs.values[position]);
+                }
+                count++;
+                last = NULL; // 同一叶子内的键已经有序
+            }
+        } else {
+            const void* start = cursor->has_start ? b_plus_tree_slot_key(tree, cursor->start_key) : NULL;
+            for (; position > 0 && count < max_count; position--) {
+                if (start && b_plus_tree_compare_at(tree, leaf, position - 1, start) < 0) {
+                    reached_end = true;
+                    break;
+                }
+                if (last && b_plus_tree_compare_at(tree, leaf, position - 1, last) >= 0) {
+                    continue;
+                }
+                b_plus_tree_read_key(tree, leaf, position - 1, cursor->scratch_key);
+                if (key_buffer) {
+                    memcpy(key_buffer + count * tree->key_stride, cursor->scratch_key, b_plus_tree_slot_bytes(tree, cursor->scratch_key));
+                }
+                if (values) {
+                    values[count] = B_PLUS_TREE_LOAD_POINTER(&leaf->ptrs.values[position - 1]);
+                }
+                count++;
+                last = NULL;
+            }
+        }
 
-        node->parent = new_root;
-        new_node->parent = new_root;
+        bool exhausted = cursor->reverse ? position == 0 : position >= key_count;
+        BPlusTreeNode* neighbor = cursor->reverse ? B_PLUS_TREE_LOAD_POINTER(&leaf->prev) : B_PLUS_TREE_LOAD_POINTER(&leaf->next);
 
-        tree->root = new_root;
-        tree->height++;
-    } else {
-        BPlusTreeNode* parent = node->parent;
-        int index = b_plus_tree_find_key_index(parent, node->keys[node->key_count], tree->compare);
+        if (!b_plus_tree_validate(leaf, cursor->version)) {
+            count = leaf_start;
+            cursor->leaf = NULL;
+            continue;
+        }
 
-        // 插入键到父节点
-        for (uint32_t i = parent->key_count; i > index; i--) {
-            parent->keys[i] = parent->keys[i - 1];
-            parent->ptrs.children[i + 1] = parent->ptrs.children[i];
+        // 结果有效，记录最后返回的键用于重新定位和去重
+        if (count > leaf_start) {
+            memcpy(cursor->last_key, cursor->scratch_key, b_plus_tree_slot_bytes(tree, cursor->scratch_key));
+            cursor->has_last = true;
         }
+        cursor->position = position;
 
-        parent->keys[index] = node->keys[node->key_count];
-        parent->ptrs.children[index + 1] = new_node;
-        parent->key_count++;
-        node->keys[node->key_count] = NULL;
-        new_node->parent = parent;
+        if (reached_end || (exhausted && !neighbor)) {
+            cursor->finished = true;
+            break;
+        }
+        if (!exhausted) {
+            break;
+        }
 
-        // 检查父节点是否需要分裂
-        if (b_plus_tree_node_is_full(parent)) {
-            b_plus_tree_split_node(tree, parent);
+        // 移动到相邻叶子节点。取得相邻节点版本号后再次校验当前叶子，
+        // 保证两者之间借键时键不会从两边都漏掉；相邻节点已移除时重新定位
+        uint64_t version;
+        if (!b_plus_tree_read_lock(neighbor, &version) || !b_plus_tree_validate(leaf, cursor->version)) {
+            cursor->leaf = NULL;
+            continue;
         }
+        cursor->leaf = neighbor;
+        cursor->version = version;
+        cursor->position = cursor->reverse ? UINT32_MAX : 0;
     }
 
-    return new_node;
+    return count;
 }
 
-// 合并节点
-BPlusTreeNode* b_plus_tree_merge_nodes(BPlusTree* tree, BPlusTreeNode* left, BPlusTreeNode* right) {
-    if (!left || !right || left->parent != right->parent) {
-        return NULL;
+// 关闭范围游标
+void b_plus_tree_cursor_close(BPlusTreeCursor* cursor) {
+    if (!cursor) {
+        return;
     }
 
-    BPlusTreeNode* parent = left->parent;
+    b_plus_tree_exit(cursor->tree, cursor->token);
+    b_plus_tree_reclaim(cursor->tree);
+    free(cursor);
+}
 
-    // 复制键和值到左节点
-    for (uint32_t i = 0; i < right->key_count; i++) {
-        left->keys[left->key_count] = right->keys[i];
-        left->ptrs.values[left->key_count] = right->ptrs.values[i];
-        left->key_count++;
+// 范围查询
+// 从起始键所在位置开始沿叶子链表遍历，之后的键只需与结束键比较；结果数组按倍数扩容
+bool b_plus_tree_range_query(BPlusTree* tree, void* start_key, void* end_key,
+                           void*** keys, void*** values, size_t* count) {
+    if (!tree || !start_key || !end_key || !keys || !values || !count) {
+        return false;
     }
-
-    // 更新叶子节点的连接
-    left->next = right->next;
-    if (right->next) {
-        right->next->prev = left;
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        // 变长键在节点中按前缀压缩存放，无法返回指向节点内部的键
+        return false;
     }
 
-    // 更新树的最后叶子节点
-    if (tree->last_leaf == right) {
-        tree->last_leaf = left;
-    }
+    *count = 0;
+    size_t capacity = 0;
 
-    // 从父节点移除键
-    int index = b_plus_tree_find_key_index(parent, right->keys[0], tree->compare);
-    if (index > 0) {
-        index--;
-    }
+    // 查找起始键所在的叶子节点
+    BPlusTreeNode* leaf = b_plus_tree_find_leaf(tree, start_key);
+    uint32_t position = b_plus_tree_search(tree, leaf, start_key, false);
 
-    for (uint32_t i = index; i < parent->key_count - 1; i++) {
-        parent->keys[i] = parent->keys[i + 1];
-        parent->ptrs.children[i + 1] = parent->ptrs.children[i + 2];
-    }
-    parent->key_count--;
+    // 遍历叶子节点
+    while (leaf) {
+        for (; position < leaf->key_count; position++) {
+            const void* key = b_plus_tree_key_at(tree, leaf, position);
+            if (b_plus_tree_compare_keys(tree, key, end_key) > 0) {
+                // 超出范围，结束查询
+                return true;
+            }
 
-    // 检查父节点是否需要合并
-    if (parent->key_count == 0) {
-        // 父节点是根节点
-        tree->root = left;
-        left->parent = NULL;
-        b_plus_tree_destroy_node(tree, parent);
-        tree->height--;
-    } else if (b_plus_tree_node_is_underflow(parent)) {
-        BPlusTreeNode* left_sibling = NULL;
-        BPlusTreeNode* right_sibling = NULL;
+            // 扩展结果数组
+            if (*count == capacity) {
+                size_t new_capacity = capacity ? capacity * 2 : leaf->capacity;
+                void** new_keys = (void**)realloc(*keys, sizeof(void*) * new_capacity);
+                if (new_keys) {
+                    *keys = new_keys;
+                }
+                void** new_values = (void**)realloc(*values, sizeof(void*) * new_capacity);
+                if (new_values) {
+                    *values = new_values;
+                }
+                if (!new_keys || !new_values) {
+                    // 键和值仍归树所有，只释放结果数组
+                    free(*keys);
+                    free(*values);
+                    *keys = NULL;
+                    *values = NULL;
+                    *count = 0;
+                    return false;
+                }
+                capacity = new_capacity;
+            }
 
-        // 查找左兄弟或右兄弟
-        int parent_index = b_plus_tree_find_key_index(parent, left->keys[0], tree->compare);
-        if (parent_index > 0) {
-            left_sibling = parent->ptrs.children[parent_index - 1];
-        }
-        if (parent_index < parent->key_count) {
-            right_sibling = parent->ptrs.children[parent_index + 1];
+            // 复制键值对
+            (*keys)[*count] = (void*)key;
+            (*values)[*count] = leaf->ptrs.values[position];
+            (*count)++;
         }
 
-        if (left_sibling && left_sibling->key_count > left_sibling->capacity / 2) {
-            // 从左兄弟借一个键
-            // 简化实现，实际需要更复杂的逻辑
-        } else if (right_sibling && right_sibling->key_count > right_sibling->capacity / 2) {
-            // 从右兄弟借一个键
-            // 简化实现，实际需要更复杂的逻辑
-        } else if (left_sibling) {
-            // 与左兄弟合并
-            b_plus_tree_merge_nodes(tree, left_sibling, left);
-        } else if (right_sibling) {
-            // 与右兄弟合并
-            b_plus_tree_merge_nodes(tree, left, right_sibling);
-        }
+        // 移动到下一个叶子节点
+        leaf = leaf->next;
+        position = 0;
     }
 
-    b_plus_tree_destroy_node(tree, right);
-    return left;
+    return true;
 }
 
-// 创建B+树索引
-BPlusTree* b_plus_tree_create(uint32_t node_capacity, size_t key_size, size_t value_size, 
-                             int (*compare)(const void*, const void*),
-                             void (*destroy_key)(void*),
-                             void (*destroy_value)(void*)) {
-    BPlusTree* tree = (BPlusTree*)malloc(sizeof(BPlusTree));
-    if (!tree) {
-        return NULL;
+// 批量加载时各层正在填充的最右节点
+typedef struct {
+    BPlusTree* tree;
+    BPlusTreeNode* levels[BPLUS_TREE_MAX_HEIGHT]; // levels[0]为叶子层
+    uint32_t height;
+    uint32_t leaf_target; // 叶子节点填充的键数
+    uint32_t internal_target; // 内部节点填充的键数
+    size_t byte_target; // 变长键节点填充的键区字节数（按未压缩的键计算）
+    BPlusTreeKey* separator; // 变长键模式下新叶子节点的分隔键
+} BPlusTreeLoader;
+
+// 释放节点及其子树（不释放键和值）
+static void b_plus_tree_free_nodes(BPlusTreeNode* node) {
+    if (node->type == NODE_TYPE_INTERNAL) {
+        for (uint32_t i = 0; i < node->key_count + 1; i++) {
+            b_plus_tree_free_nodes(node->ptrs.children[i]);
+        }
     }
+    free(node);
+}
 
-    // 创建根节点（叶子节点）
-    BPlusTreeNode* root = b_plus_tree_create_node(tree, NODE_TYPE_LEAF);
-    if (!root) {
-        free(tree);
-        return NULL;
+// 节点是否还能追加key：定长键按键数，变长键按键区字节数（每个节点至少两个键）
+static bool b_plus_tree_loader_has_room(const BPlusTreeLoader* loader, const BPlusTreeNode* node, uint32_t target, const void* key) {
+    const BPlusTree* tree = loader->tree;
+    if (tree->key_type != BPLUS_TREE_KEY_VARIABLE) {
+        return node->key_count < target;
     }
-
-    tree->root = root;
-    tree->first_leaf = root;
-    tree->last_leaf = root;
-    tree->height = 1;
-    tree->node_capacity = node_capacity;
-    tree->key_size = key_size;
-    tree->value_size = value_size;
-    tree->compare = compare;
-    tree->destroy_key = destroy_key;
-    tree->destroy_value = destroy_value;
-
-    return tree;
+    if (node->key_count >= node->capacity) {
+        return false;
+    }
+    if (node->key_count < 2) {
+        return true;
+    }
+    size_t used = tree->key_area_size - b_plus_tree_var_free(tree, node, node->key_count);
+    return used + sizeof(BPlusTreeVarSlot) + ((const BPlusTreeKey*)key)->length <= loader->byte_target;
 }
 
-// 销毁B+树索引
-void b_plus_tree_destroy(BPlusTree* tree) {
-    if (!tree) {
-        return;
+// 填满的变长键节点设置上界：正在填充的节点没有上界，键不压缩；确定上界后按新的前缀重写
+static bool b_plus_tree_loader_close(BPlusTreeLoader* loader, BPlusTreeNode* node, BPlusTreeNode* next, const void* separator) {
+    BPlusTree* tree = loader->tree;
+    if (tree->key_type != BPLUS_TREE_KEY_VARIABLE) {
+        return true;
     }
-
-    b_plus_tree_destroy_node(tree, tree->root);
-    free(tree);
+    BPlusTreeVarKey bound = b_plus_tree_var_key_of((const BPlusTreeKey*)separator);
+    BPlusTreeVarKey lower = b_plus_tree_var_lower(tree, node);
+    return b_plus_tree_var_rebuild(tree, next, &bound, NULL) && b_plus_tree_var_rebuild(tree, node, &lower, &bound);
 }
 
-// 插入键值对
-bool b_plus_tree_insert(BPlusTree* tree, void* key, void* value) {
-    BPlusTreeNode* leaf = b_plus_tree_find_leaf(tree, key);
-    int index = b_plus_tree_find_key_index(leaf, key, tree->compare);
+// 把分隔键和新的子节点追加到第level层；当前节点已填满时新建节点，分隔键继续上移
+static bool b_plus_tree_loader_push(BPlusTreeLoader* loader, uint32_t level, const void* separator, BPlusTreeNode* child) {
+    BPlusTree* tree = loader->tree;
 
-    // 检查键是否已存在
-    if (index < leaf->key_count && tree->compare(key, leaf->keys[index]) == 0) {
-        // 更新值
-        if (tree->destroy_value && leaf->ptrs.values[index]) {
-            tree->destroy_value(leaf->ptrs.values[index]);
+    if (level == loader->height) {
+        // 新的一层：只有一个子节点（下一层原来的最右节点）的根节点
+        if (level == BPLUS_TREE_MAX_HEIGHT) {
+            return false;
         }
-        leaf->ptrs.values[index] = value;
-        return true;
-    }
-
-    // 插入键值对
-    if (b_plus_tree_node_is_full(leaf)) {
-        // 分裂节点
-        BPlusTreeNode* new_leaf = b_plus_tree_split_node(tree, leaf);
-        if (!new_leaf) {
+        BPlusTreeNode* root = b_plus_tree_create_node(tree, NODE_TYPE_INTERNAL);
+        if (!root) {
             return false;
         }
+        root->ptrs.children[0] = loader->levels[level - 1];
+        loader->levels[level] = root;
+        loader->height++;
+    }
 
-        // 确定插入到哪个节点
-        if (tree->compare(key, leaf->keys[leaf->key_count - 1]) > 0) {
-            leaf = new_leaf;
-            index = 0;
+    BPlusTreeNode* node = loader->levels[level];
+    if (b_plus_tree_loader_has_room(loader, node, loader->internal_target, separator)) {
+        if (!b_plus_tree_insert_key(tree, node, node->key_count, separator)) {
+            return false;
         }
+        node->ptrs.children[node->key_count + 1] = child;
+        node->key_count++;
+        return true;
     }
 
-    // 移动键和值为新键腾出空间
-    for (uint32_t i = leaf->key_count; i > index; i--) {
-        leaf->keys[i] = leaf->keys[i - 1];
-        leaf->ptrs.values[i] = leaf->ptrs.values[i - 1];
+    BPlusTreeNode* sibling = b_plus_tree_create_node(tree, NODE_TYPE_INTERNAL);
+    if (!sibling) {
+        return false;
     }
-
-    // 插入新键值对
-    leaf->keys[index] = key;
-    leaf->ptrs.values[index] = value;
-    leaf->key_count++;
-
+    sibling->ptrs.children[0] = child;
+    if (!b_plus_tree_loader_close(loader, node, sibling, separator) ||
+        !b_plus_tree_loader_push(loader, level + 1, separator, sibling)) {
+        free(sibling);
+        return false;
+    }
+    loader->levels[level] = sibling;
     return true;
 }
 
-// 删除键值对
-bool b_plus_tree_delete(BPlusTree* tree, void* key) {
-    BPlusTreeNode* leaf = b_plus_tree_find_leaf(tree, key);
-    int index = b_plus_tree_find_key_index(leaf, key, tree->compare);
+// 追加一个键值对到叶子层（键必须严格递增）
+static bool b_plus_tree_loader_add(BPlusTreeLoader* loader, void* key, void* value) {
+    BPlusTree* tree = loader->tree;
+    BPlusTreeNode* leaf = loader->levels[0];
 
-    // 检查键是否存在
-    if (index >= leaf->key_count || tree->compare(key, leaf->keys[index]) != 0) {
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE && ((const BPlusTreeKey*)key)->length > tree->key_size) {
+        fprintf(stderr, "B+ tree bulk load key exceeds the maximum key length\n");
         return false;
     }
-
-    // 释放键和值
-    if (tree->destroy_key && leaf->keys[index]) {
-        tree->destroy_key(leaf->keys[index]);
+    if (leaf->key_count > 0 && b_plus_tree_compare_at(tree, leaf, leaf->key_count - 1, key) >= 0) {
+        fprintf(stderr, "B+ tree bulk load input is not strictly ascending\n");
+        return false;
     }
-    if (tree->destroy_value && leaf->ptrs.values[index]) {
-        tree->destroy_value(leaf->ptrs.values[index]);
+
+    if (b_plus_tree_loader_has_room(loader, leaf, loader->leaf_target, key)) {
+        if (!b_plus_tree_insert_key(tree, leaf, leaf->key_count, key)) {
+            return false;
+        }
+        leaf->ptrs.values[leaf->key_count] = value;
+        leaf->key_count++;
+        return true;
     }
 
-    // 移动键和值填补空缺
-    for (uint32_t i = index; i < leaf->key_count - 1; i++) {
-        leaf->keys[i] = leaf->keys[i + 1];
-        leaf->ptrs.values[i] = leaf->ptrs.values[i + 1];
+    BPlusTreeNode* new_leaf = b_plus_tree_create_node(tree, NODE_TYPE_LEAF);
+    if (!new_leaf) {
+        return false;
+    }
+    const void* separator = NULL;
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        // 变长键以截断的最短分隔键作为两个叶子节点的边界
+        BPlusTreeVarKey last = b_plus_tree_var_key(tree, leaf, leaf->key_count - 1);
+        BPlusTreeVarKey next = b_plus_tree_var_key_of((const BPlusTreeKey*)key);
+        b_plus_tree_var_separator(&last, &next, loader->separator);
+        separator = loader->separator;
+    } else {
+        b_plus_tree_set_key(tree, new_leaf, 0, key);
+        separator = b_plus_tree_key_at(tree, new_leaf, 0);
+    }
+    if (!b_plus_tree_loader_close(loader, leaf, new_leaf, separator) ||
+        !b_plus_tree_loader_push(loader, 1, separator, new_leaf)) {
+        free(new_leaf);
+        return false;
+    }
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE && !b_plus_tree_insert_key(tree, new_leaf, 0, key)) {
+        return false;
     }
-    leaf->key_count--;
+    new_leaf->ptrs.values[0] = value;
+    new_leaf->key_count = 1;
 
-    // 检查节点是否下溢
-    if (leaf->key_count > 0) {
-        return true;
+    new_leaf->prev = leaf;
+    leaf->next = new_leaf;
+    loader->levels[0] = new_leaf;
+    return true;
+}
+
+// 补足最右侧路径上的节点：左侧节点都按填充因子填满，只有最右节点可能不足最少键数。
+// 自顶向下保证路径上每个节点的键数多于最少键数，下一层合并时父节点不会下溢。
+static void b_plus_tree_fix_right_edge(BPlusTree* tree) {
+    BPlusTreeNode* node = tree->root;
+
+    while (node->type == NODE_TYPE_INTERNAL) {
+        uint32_t index = node->key_count;
+        BPlusTreeNode* child = node->ptrs.children[index];
+        BPlusTreeNode* left = node->ptrs.children[index - 1];
+
+        // 变长键节点重组放不下时保留不足的节点，之后删除时再补足
+        while (child->key_count <= b_plus_tree_node_min_keys(child) && left->key_count > b_plus_tree_node_min_keys(left)) {
+            if (!b_plus_tree_borrow_from_left(tree, node, index)) {
+                break;
+            }
+        }
+        if (child->key_count <= b_plus_tree_node_min_keys(child) && b_plus_tree_merge_nodes(tree, node, index - 1)) {
+            free(child);
+            child = left;
+        }
+
+        // 根节点的最后一个分隔键下移后，树高减一
+        if (node == tree->root && node->key_count == 0) {
+            tree->root = child;
+            tree->height--;
+            free(node);
+        }
+        node = child;
     }
+}
 
-    // 处理下溢
-    BPlusTreeNode* left_sibling = leaf->prev;
-    BPlusTreeNode* right_sibling = leaf->next;
+// 批量加载
+bool b_plus_tree_bulk_load(BPlusTree* tree, BPlusTreeLoadNext next, void* arg, double fill_factor) {
+    if (!tree || !next) {
+        return false;
+    }
+    if (tree->root->type != NODE_TYPE_LEAF || tree->root->key_count != 0) {
+        fprintf(stderr, "B+ tree bulk load requires an empty tree\n");
+        return false;
+    }
+    if (fill_factor <= 0 || fill_factor > 1) {
+        fill_factor = BPLUS_TREE_DEFAULT_FILL_FACTOR;
+    }
 
-    if (left_sibling && left_sibling->key_count > left_sibling->capacity / 2) {
-        // 从左兄弟借一个键值对
-        for (uint32_t i = leaf->key_count; i > 0; i--) {
-            leaf->keys[i] = leaf->keys[i - 1];
-            leaf->ptrs.values[i] = leaf->ptrs.values[i - 1];
+    // 填充键数不少于最少键数加一，使加载后的节点可以直接删除
+    BPlusTreeLoader loader;
+    memset(&loader, 0, sizeof(loader));
+    loader.tree = tree;
+    loader.leaf_target = (uint32_t)(tree->node_capacity * fill_factor);
+    if (loader.leaf_target <= (tree->node_capacity - 1) / 2) {
+        loader.leaf_target = (tree->node_capacity - 1) / 2 + 1;
+    }
+    loader.internal_target = loader.leaf_target;
+    if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+        // 节点填满后仍要能容纳一个最长的键（上界或之后插入的键）
+        size_t reserve = sizeof(BPlusTreeVarSlot) + tree->key_size;
+        loader.byte_target = (size_t)(tree->key_area_size * fill_factor);
+        if (loader.byte_target > tree->key_area_size - reserve) {
+            loader.byte_target = tree->key_area_size - reserve;
         }
-        leaf->keys[0] = left_sibling->keys[left_sibling->key_count - 1];
-        leaf->ptrs.values[0] = left_sibling->ptrs.values[left_sibling->key_count - 1];
-        leaf->key_count++;
-        left_sibling->key_count--;
-
-        // 更新父节点的键
-        BPlusTreeNode* parent = leaf->parent;
-        int parent_index = b_plus_tree_find_key_index(parent, leaf->keys[0], tree->compare);
-        if (tree->destroy_key && parent->keys[parent_index - 1]) {
-            tree->destroy_key(parent->keys[parent_index - 1]);
-        }
-        parent->keys[parent_index - 1] = leaf->keys[0];
-    } else if (right_sibling && right_sibling->key_count > right_sibling->capacity / 2) {
-        // 从右兄弟借一个键值对
-        leaf->keys[leaf->key_count] = right_sibling->keys[0];
-        leaf->ptrs.values[leaf->key_count] = right_sibling->ptrs.values[0];
-        leaf->key_count++;
+        loader.separator = (BPlusTreeKey*)malloc(sizeof(BPlusTreeKey));
+        if (!loader.separator) {
+            return false;
+        }
+    }
 
-        for (uint32_t i = 0; i < right_sibling->key_count - 1; i++) {
-            right_sibling->keys[i] = right_sibling->keys[i + 1];
-            right_sibling->ptrs.values[i] = right_sibling->ptrs.values[i + 1];
-        }
-        right_sibling->key_count--;
-
-        // 更新父节点的键
-        BPlusTreeNode* parent = leaf->parent;
-        int parent_index = b_plus_tree_find_key_index(parent, right_sibling->keys[0], tree->compare);
-        if (tree->destroy_key && parent->keys[parent_index]) {
-            tree->destroy_key(parent->keys[parent_index]);
-        }
-        parent->keys[parent_index] = right_sibling->keys[0];
-    } else if (left_sibling) {
-        // 与左兄弟合并
-        b_plus_tree_merge_nodes(tree, left_sibling, leaf);
-    } else if (right_sibling) {
-        // 与右兄弟合并
-        b_plus_tree_merge_nodes(tree, leaf, right_sibling);
-    } else {
-        // 叶子节点是根节点
-        // 简化实现，实际需要处理根节点的情况
+    BPlusTreeNode* first_leaf = b_plus_tree_create_node(tree, NODE_TYPE_LEAF);
+    if (!first_leaf) {
+        free(loader.separator);
+        return false;
     }
+    loader.levels[0] = first_leaf;
+    loader.height = 1;
+
+    void* key = NULL;
+    void* value = NULL;
+    while (next(arg, &key, &value)) {
+        if (!b_plus_tree_loader_add(&loader, key, value)) {
+            // 加载失败时树保持为空，已读取的键和值仍归调用者所有
+            b_plus_tree_free_nodes(loader.levels[loader.height - 1]);
+            free(loader.separator);
+            return false;
+        }
+    }
+    free(loader.separator);
+
+    free(tree->root);
+    tree->root = loader.levels[loader.height - 1];
+    tree->height = loader.height;
+    tree->first_leaf = first_leaf;
+    tree->last_leaf = loader.levels[0];
+    b_plus_tree_fix_right_edge(tree);
 
     return true;
 }
 
-// 查找键对应的值
-void* b_plus_tree_find(BPlusTree* tree, void* key) {
-    BPlusTreeNode* leaf = b_plus_tree_find_leaf(tree, key);
-    int index = b_plus_tree_find_key_index(leaf, key, tree->compare);
+// 从已排序数组读取键值对
+typedef struct {
+    void** keys;
+    void** values;
+    size_t count;
+    size_t position;
+} BPlusTreeArrayInput;
+
+static bool b_plus_tree_array_next(void* arg, void** key, void** value) {
+    BPlusTreeArrayInput* input = (BPlusTreeArrayInput*)arg;
+    if (input->position == input->count) {
+        return false;
+    }
+    *key = input->keys[input->position];
+    *value = input->values ? input->values[input->position] : NULL;
+    input->position++;
+    return true;
+}
 
-    if (index < leaf->key_count && tree->compare(key, leaf->keys[index]) == 0) {
-        return leaf->ptrs.values[index];
+// 从已排序数组批量加载
+bool b_plus_tree_bulk_load_sorted(BPlusTree* tree, void** keys, void** values, size_t count, double fill_factor) {
+    if (!keys && count > 0) {
+        return false;
     }
 
-    return NULL;
+    BPlusTreeArrayInput input = {keys, values, count, 0};
+    return b_plus_tree_bulk_load(tree, b_plus_tree_array_next, &input, fill_factor);
 }
 
-// 范围查询
-bool b_plus_tree_range_query(BPlusTree* tree, void* start_key, void* end_key, 
-                           void*** keys, void*** values, size_t* count) {
-    if (!tree || !keys || !values || !count) {
-        return false;
+// 批量插入的键值对
+typedef struct {
+    void* key;
+    void* value;
+} BPlusTreeEntry;
+
+// 按键归并排序（稳定，相同的键保持输入顺序）
+static void b_plus_tree_sort_entries(BPlusTree* tree, BPlusTreeEntry* entries, BPlusTreeEntry* buffer, size_t count) {
+    BPlusTreeEntry* source = entries;
+    BPlusTreeEntry* target = buffer;
+
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t left = 0; left < count; left += width * 2) {
+            size_t middle = left + width < count ? left + width : count;
+            size_t right = left + width * 2 < count ? left + width * 2 : count;
+            size_t i = left;
+            size_t j = middle;
+            size_t k = left;
+            while (i < middle && j < right) {
+                if (b_plus_tree_compare_keys(tree, source[j].key, source[i].key) < 0) {
+                    target[k++] = source[j++];
+                } else {
+                    target[k++] = source[i++];
+                }
+            }
+            while (i < middle) {
+                target[k++] = source[i++];
+            }
+            while (j < right) {
+                target[k++] = source[j++];
+            }
+        }
+        BPlusTreeEntry* swap = source;
+        source = target;
+        target = swap;
     }
 
-    *count = 0;
+    if (source != entries) {
+        memcpy(entries, source, sizeof(BPlusTreeEntry) * count);
+    }
+}
 
-    // 查找起始键所在的叶子节点
-    BPlusTreeNode* leaf = b_plus_tree_find_leaf(tree, start_key);
-    if (!leaf) {
+// 从键值对数组读取
+typedef struct {
+    BPlusTreeEntry* entries;
+    size_t count;
+    size_t position;
+} BPlusTreeEntryInput;
+
+static bool b_plus_tree_entry_next(void* arg, void** key, void** value) {
+    BPlusTreeEntryInput* input = (BPlusTreeEntryInput*)arg;
+    if (input->position == input->count) {
         return false;
     }
+    *key = input->entries[input->position].key;
+    *value = input->entries[input->position].value;
+    input->position++;
+    return true;
+}
 
-    // 遍历叶子节点
-    while (leaf) {
-        for (uint32_t i = 0; i < leaf->key_count; i++) {
-            // 检查键是否在范围内
-            if (tree->compare(leaf->keys[i], start_key) >= 0 && 
-                tree->compare(leaf->keys[i], end_key) <= 0) {
-                // 扩展结果数组
-                *keys = (void**)realloc(*keys, sizeof(void*) * (*count + 1));
-                *values = (void**)realloc(*values, sizeof(void*) * (*count + 1));
-                if (!*keys || !*values) {
-                    // 释放已分配的内存
-                    for (size_t j = 0; j < *count; j++) {
-                        if (tree->destroy_key) {
-                            tree->destroy_key((*keys)[j]);
-                        }
-                        if (tree->destroy_value) {
-                            tree->destroy_value((*values)[j]);
-                        }
-                    }
-                    free(*keys);
-                    free(*values);
-                    *count = 0;
-                    return false;
-                }
+// 批量插入
+bool b_plus_tree_insert_batch(BPlusTree* tree, void** keys, void** values, size_t count) {
+    if (!tree || (!keys && count > 0)) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
 
-                // 复制键值对
-                (*keys)[*count] = leaf->keys[i];
-                (*values)[*count] = leaf->ptrs.values[i];
-                (*count)++;
-            } else if (tree->compare(leaf->keys[i], end_key) > 0) {
-                // 超出范围，结束查询
-                return true;
+    BPlusTreeEntry* entries = (BPlusTreeEntry*)malloc(sizeof(BPlusTreeEntry) * count * 2);
+    if (!entries) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        entries[i].key = keys[i];
+        entries[i].value = values ? values[i] : NULL;
+    }
+    b_plus_tree_sort_entries(tree, entries, entries + count, count);
+
+    // 相同的键只保留最后一个，与逐个插入时后插入的值覆盖先插入的值一致
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && b_plus_tree_compare_keys(tree, entries[unique - 1].key, entries[i].key) == 0) {
+            if (tree->destroy_value && entries[unique - 1].value && entries[unique - 1].value != entries[i].value) {
+                tree->destroy_value(entries[unique - 1].value);
+            }
+            if (tree->key_type == BPLUS_TREE_KEY_POINTER && tree->destroy_key && entries[unique - 1].key != entries[i].key) {
+                tree->destroy_key(entries[unique - 1].key);
             }
+            entries[unique - 1] = entries[i];
+        } else {
+            entries[unique++] = entries[i];
         }
+    }
 
-        // 移动到下一个叶子节点
-        leaf = leaf->next;
+    bool result = true;
+    if (tree->root->type == NODE_TYPE_LEAF && tree->root->key_count == 0) {
+        // 空树直接自底向上构建
+        BPlusTreeEntryInput input = {entries, unique, 0};
+        result = b_plus_tree_bulk_load(tree, b_plus_tree_entry_next, &input, BPLUS_TREE_DEFAULT_FILL_FACTOR);
+    } else {
+        // 按键顺序插入，相邻的键落在同一叶子节点，下降路径保持在缓存中
+        for (size_t i = 0; i < unique && result; i++) {
+            result = b_plus_tree_insert(tree, entries[i].key, entries[i].value);
+        }
     }
 
-    return true;
+    free(entries);
+    return result;
 }
 
 // 获取树的高度
@@ -555,17 +2692,35 @@ void b_plus_tree_print(BPlusTree* tree) {
 
     printf("B+ Tree Height: %u\n", tree->height);
     printf("Node Capacity: %u\n", tree->node_capacity);
-    printf("Key Count: %llu\n", b_plus_tree_key_count(tree));
+    printf("Node Size: %zu\n", tree->node_size);
+    printf("Key Count: %llu\n", (unsigned long long)b_plus_tree_key_count(tree));
 
     // 打印叶子节点
     BPlusTreeNode* leaf = tree->first_leaf;
+    uint8_t* slot = tree->key_type == BPLUS_TREE_KEY_VARIABLE ? (uint8_t*)malloc(tree->key_stride) : NULL;
     printf("Leaf Nodes:\n");
     while (leaf) {
         printf("Leaf node with %u keys:", leaf->key_count);
         for (uint32_t i = 0; i < leaf->key_count; i++) {
-            printf(" %p", leaf->keys[i]);
+            if (tree->key_type == BPLUS_TREE_KEY_VARIABLE) {
+                if (slot) {
+                    b_plus_tree_read_key(tree, leaf, i, slot);
+                    const BPlusTreeKey* key = (const BPlusTreeKey*)slot;
+                    printf(" %.*s", (int)key->length, (const char*)key->data);
+                }
+                continue;
+            }
+            const void* key = b_plus_tree_key_at(tree, leaf, i);
+            if (tree->key_type == BPLUS_TREE_KEY_INT64) {
+                int64_t value;
+                memcpy(&value, key, sizeof(int64_t));
+                printf(" %lld", (long long)value);
+            } else {
+                printf(" %p", key);
+            }
         }
         printf("\n");
         leaf = leaf->next;
     }
+    free(slot);
 }
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
 
 // B+树节点类型
 typedef enum {
@@ -10,45 +12,176 @@ typedef enum {
     NODE_TYPE_LEAF
 } NodeType;
 
-// B+树节点结构
+// 键的存储方式
+typedef enum {
+    BPLUS_TREE_KEY_POINTER, // 键以指针存放，通过compare函数比较
+    BPLUS_TREE_KEY_INT64,   // int64键，内联存放在节点中，直接按整数比较
+    BPLUS_TREE_KEY_FIXED,   // 定长字节键（key_size字节），内联存放在节点中，按memcmp比较
+    BPLUS_TREE_KEY_VARIABLE // 变长字节键（BPlusTreeKey），节点内前缀压缩存放，按memcmp比较
+} BPlusTreeKeyType;
+
+// 节点按缓存行对齐
+#define BPLUS_TREE_CACHE_LINE_SIZE 64
+
+// 定长键模式下节点的默认大小（字节）
+#define BPLUS_TREE_DEFAULT_NODE_SIZE 4096
+
+// 节点的最小容量
+#define BPLUS_TREE_MIN_CAPACITY 3
+
+// 变长键的最大长度
+#define BPLUS_TREE_MAX_KEY_LENGTH 1024
+
+// 树的最大高度（删除时记录下降路径）
+#define BPLUS_TREE_MAX_HEIGHT 64
+
+// 内存回收的读者计数槽数量（线程按编号映射到槽）
+#define BPLUS_TREE_EPOCH_SLOTS 64
+
+// 累积多少个待回收对象后尝试推进纪元
+#define BPLUS_TREE_RECLAIM_THRESHOLD 64
+
+// 批量加载的默认填充因子（叶子和内部节点填充到容量的比例）
+#define BPLUS_TREE_DEFAULT_FILL_FACTOR 0.9
+
+// 节点版本号的标志位
+#define BPLUS_TREE_VERSION_OBSOLETE 0x1 // 节点已从树中移除
+#define BPLUS_TREE_VERSION_LOCKED 0x2   // 节点被写者锁定
+
+// 变长键（规范化键）
+// 键按字节比较（memcmp，较短的键是较长键的前缀时较短的键更小）。多列键或非字符串列通过
+// b_plus_tree_key_append_*依次追加编码，编码后的字节顺序与按列依次比较的顺序一致。
+// 单列字符串键可以直接存放原始字节。调用者只需分配length之后实际使用的字节。
 typedef struct {
+    uint16_t length;
+    uint8_t data[BPLUS_TREE_MAX_KEY_LENGTH];
+} BPlusTreeKey;
+
+// 批量加载的输入：依次返回按键严格递增的键值对，没有更多输入时返回false
+typedef bool (*BPlusTreeLoadNext)(void* arg, void** key, void** value);
+
+// B+树节点结构
+// 节点头部、键数组和指针数组位于同一块按缓存行对齐的内存中，
+// 键数组紧跟头部连续存放，二分查找时只访问键数组所在的缓存行。
+// 并发控制采用乐观锁耦合：读者不加锁，读取节点前后比较版本号，版本变化则重试；
+// 写者只锁定要修改的节点（版本号加锁定位），解锁时版本号递增。读者可能与写者同时访问的
+// 字段和键区都通过原子操作读写（见b_plus_tree.c）。
+// 变长键模式下键数组区域保存前缀压缩后的键（见b_plus_tree.c），节点容量是槽数的上限。
+typedef struct BPlusTreeNode {
+    uint64_t version; // 版本号（低两位为BPLUS_TREE_VERSION_*标志）
     NodeType type;
     uint32_t key_count;
     uint32_t capacity;
-    void** keys;
+    uint32_t min_keys; // 非根节点的最少键数
+    void** keys; // 指针键模式下的键数组（与key_data相同），定长键模式下为NULL
+    uint8_t* key_data; // 键数组（每个键占key_stride字节）
     union {
-        struct BPlusTreeNode** children; // 内部节点
+        struct BPlusTreeNode** children; // 内部节点（capacity + 1个）
         void** values; // 叶子节点
     } ptrs;
-    struct BPlusTreeNode* parent;
     struct BPlusTreeNode* prev; // 叶子节点的前驱
     struct BPlusTreeNode* next; // 叶子节点的后继
 } BPlusTreeNode;
 
+// 读者计数槽（独占一个缓存行）
+typedef struct {
+    uint64_t readers[2]; // 按纪元奇偶位分别计数
+    uint8_t padding[BPLUS_TREE_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+} BPlusTreeEpochSlot;
+
+// 待回收的对象
+typedef struct {
+    void* pointer;
+    void (*destroy)(void*);
+} BPlusTreeRetired;
+
 // B+树索引结构
+// 内部节点的分隔键满足：children[i]中的键 < keys[i] <= children[i + 1]中的键。
+// 指针键模式下分隔键与叶子节点共享键指针，键只由叶子节点释放。
+// 查找、插入和删除可以由多个线程并发调用。从树中移除的节点和键在所有
+// 可能访问它们的读者退出后才释放（基于纪元的回收）。值在删除时立即释放。
 typedef struct {
-    BPlusTreeNode* root;
+    BPlusTreeNode* root; // 原子访问
     BPlusTreeNode* first_leaf;
     BPlusTreeNode* last_leaf;
     uint32_t height;
     uint32_t node_capacity;
+    BPlusTreeKeyType key_type;
     size_t key_size;
+    size_t key_stride; // 键数组中每个键占用的字节数（变长键模式下为游标中保存一个键的字节数）
+    size_t key_area_size; // 节点中键数组区域的字节数
+    size_t node_size; // 节点占用的字节数
     size_t value_size;
     int (*compare)(const void*, const void*);
     void (*destroy_key)(void*);
     void (*destroy_value)(void*);
+
+    // 基于纪元的内存回收：读者在当前纪元奇偶位对应的计数上登记，
+    // 推进纪元后旧奇偶位的计数归零时，推进前移除的对象不再可能被访问
+    uint64_t epoch;
+    BPlusTreeEpochSlot* epoch_slots;
+    pthread_mutex_t reclaim_mutex;
+    BPlusTreeRetired* retired; // 当前纪元移除的对象
+    size_t retired_count;
+    size_t retired_capacity;
+    BPlusTreeRetired* pending; // 等待旧纪元读者退出的对象
+    size_t pending_count;
+    size_t pending_capacity;
+    uint32_t pending_parity;
 } BPlusTree;
 
-// 创建B+树索引
-BPlusTree* b_plus_tree_create(uint32_t node_capacity, size_t key_size, size_t value_size, 
+// 范围游标
+// 沿叶子链表按批读取[start_key, end_key]范围内的键值对，可以与写操作并发。
+// 游标打开期间会推迟已删除节点的回收，用完应尽快关闭。
+typedef struct {
+    BPlusTree* tree;
+    bool reverse; // 从结束键向起始键反向遍历
+    bool finished;
+    bool has_start;
+    bool has_end;
+    bool has_last;
+    uint32_t token; // 读临界区令牌
+    BPlusTreeNode* leaf; // 继续遍历的叶子节点（NULL表示需要重新定位）
+    uint64_t version; // 读取leaf时的版本号
+    uint32_t position; // leaf中继续读取的位置（反向时为下一个读取位置加一）
+    uint8_t* start_key; // 以下键按槽格式保存（每个键key_stride字节，变长键为BPlusTreeKey的前缀）
+    uint8_t* end_key;
+    uint8_t* last_key; // 上次返回的最后一个键
+    uint8_t* scratch_key; // 读取叶子期间暂存的最后一个键，校验通过后写入last_key
+} BPlusTreeCursor;
+
+// 创建B+树索引（指针键，通过compare比较）
+BPlusTree* b_plus_tree_create(uint32_t node_capacity, size_t key_size, size_t value_size,
                              int (*compare)(const void*, const void*),
                              void (*destroy_key)(void*),
                              void (*destroy_value)(void*));
 
+// 创建定长键B+树索引
+// key_type为BPLUS_TREE_KEY_INT64时忽略key_size；node_size为节点字节数，0表示默认值，
+// 节点容量按node_size计算。插入时复制键的内容，调用者保留键的所有权。
+BPlusTree* b_plus_tree_create_fixed(BPlusTreeKeyType key_type, size_t key_size, size_t node_size,
+                                   void (*destroy_value)(void*));
+
+// 创建变长键B+树索引
+// 键为BPlusTreeKey，长度不超过max_key_length。每个节点只保存键去掉节点公共前缀后的后缀，
+// 内部节点的分隔键截断为区分左右子树所需的最短前缀。节点键区要能容纳约10个最长的键
+// （node_size为0时使用默认值），否则返回NULL。插入时复制键的内容。
+BPlusTree* b_plus_tree_create_variable(size_t max_key_length, size_t node_size,
+                                      void (*destroy_value)(void*));
+
+// 规范化键编码：清空键
+void b_plus_tree_key_init(BPlusTreeKey* key);
+
+// 追加int64列（符号位取反后按大端序存放）
+bool b_plus_tree_key_append_int64(BPlusTreeKey* key, int64_t value);
+
+// 追加字符串列（0x00编码为0x00 0xFF，以0x00 0x00结尾，保证后续列不影响字符串之间的顺序）
+bool b_plus_tree_key_append_string(BPlusTreeKey* key, const char* value, size_t length);
+
 // 销毁B+树索引
 void b_plus_tree_destroy(BPlusTree* tree);
 
-// 插入键值对
+// 插入键值对（键已存在时替换值）
 bool b_plus_tree_insert(BPlusTree* tree, void* key, void* value);
 
 // 删除键值对
@@ -57,27 +190,54 @@ bool b_plus_tree_delete(BPlusTree* tree, void* key);
 // 查找键对应的值
 void* b_plus_tree_find(BPlusTree* tree, void* key);
 
-// 范围查询
-bool b_plus_tree_range_query(BPlusTree* tree, void* start_key, void* end_key, 
+// 批量加载（只能加载到空树，不能与其他操作并发）
+// 从左到右按填充因子填充叶子节点，再自底向上构建内部节点。fill_factor取(0, 1]，
+// 超出范围时使用默认值。输入不是严格递增时失败，树保持为空，已读取的键和值仍归调用者所有。
+// 外部排序的输入可以通过next逐个读取，不需要一次放入内存。
+bool b_plus_tree_bulk_load(BPlusTree* tree, BPlusTreeLoadNext next, void* arg, double fill_factor);
+
+// 从已排序的数组批量加载（values为NULL时值均为NULL）
+bool b_plus_tree_bulk_load_sorted(BPlusTree* tree, void** keys, void** values, size_t count, double fill_factor);
+
+// 批量插入键值对（输入不要求有序，相同的键保留最后一个值）
+// 先按键排序：树为空时批量加载（此时不能与其他操作并发），否则按键顺序逐个插入
+bool b_plus_tree_insert_batch(BPlusTree* tree, void** keys, void** values, size_t count);
+
+// 打开范围游标（start_key或end_key为NULL表示该方向不设边界，范围包含两端）
+// 指针键模式下边界键在游标关闭前必须保持有效
+BPlusTreeCursor* b_plus_tree_cursor_open(BPlusTree* tree, const void* start_key, const void* end_key, bool reverse);
+
+// 读取下一批键值对，返回读取的数量，0表示遍历结束
+// keys容纳max_count个键：指针键模式下为void*数组，定长键模式下每个键占key_size字节，
+// 变长键模式下每个键占key_stride字节（按BPlusTreeKey的格式）；keys或values为NULL时不输出对应内容
+size_t b_plus_tree_cursor_next(BPlusTreeCursor* cursor, void* keys, void** values, size_t max_count);
+
+// 关闭范围游标
+void b_plus_tree_cursor_close(BPlusTreeCursor* cursor);
+
+// 范围查询（不能与写操作并发，并发遍历使用游标）
+// 定长键模式下返回的键指针指向节点内部，在下一次修改树之前有效；变长键模式不支持，使用游标
+bool b_plus_tree_range_query(BPlusTree* tree, void* start_key, void* end_key,
                            void*** keys, void*** values, size_t* count);
 
 // 获取树的高度
 uint32_t b_plus_tree_height(BPlusTree* tree);
 
-// 获取键的数量
+// 获取键的数量（不能与写操作并发）
 uint64_t b_plus_tree_key_count(BPlusTree* tree);
 
 // 打印B+树结构（用于调试）
 void b_plus_tree_print(BPlusTree* tree);
 
-// B+树辅助函数
+// B+树辅助函数（分裂和合并要求调用者持有相关节点的写锁）
 BPlusTreeNode* b_plus_tree_create_node(BPlusTree* tree, NodeType type);
 void b_plus_tree_destroy_node(BPlusTree* tree, BPlusTreeNode* node);
 bool b_plus_tree_node_is_full(BPlusTreeNode* node);
 bool b_plus_tree_node_is_underflow(BPlusTreeNode* node);
-BPlusTreeNode* b_plus_tree_split_node(BPlusTree* tree, BPlusTreeNode* node);
-BPlusTreeNode* b_plus_tree_merge_nodes(BPlusTree* tree, BPlusTreeNode* left, BPlusTreeNode* right);
-BPlusTreeNode* b_plus_tree_find_leaf(BPlusTree* tree, void* key);
-int b_plus_tree_find_key_index(BPlusTreeNode* node, void* key, int (*compare)(const void*, const void*));
+BPlusTreeNode* b_plus_tree_split_node(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index);
+BPlusTreeNode* b_plus_tree_merge_nodes(BPlusTree* tree, BPlusTreeNode* parent, uint32_t index);
+BPlusTreeNode* b_plus_tree_find_leaf(BPlusTree* tree, const void* key);
+const void* b_plus_tree_node_key(BPlusTree* tree, BPlusTreeNode* node, uint32_t index); // 变长键模式下返回NULL
+int b_plus_tree_find_key_index(BPlusTree* tree, BPlusTreeNode* node, const void* key);
 
-#endif // B_PLUS_TREE_H
\ No newline at end of file
+#endif // B_PLUS_TREE_H
@@ -37,4 +37,53 @@ uint32_t bloom_filter_size(bloom_filter *filter);
 // 获取布隆过滤器中元素数量
 uint32_t bloom_filter_item_count(bloom_filter *filter);
 
+// 分块布隆过滤器
+// 位数组分成64字节（一个缓存行）的块，一个键的全部位都在由哈希值选出的同一个块中：
+// 查询只访问一个缓存行，按键的位构造出整块的掩码后一次比较（SSE2）。
+// 键在块之间分布不均，同样的位数下假阳性率比普通布隆过滤器略高，按假阳性率计算位数时已经考虑。
+#define BLOCKED_BLOOM_FILTER_BLOCK_SIZE 64
+#define BLOCKED_BLOOM_FILTER_BLOCK_BITS (BLOCKED_BLOOM_FILTER_BLOCK_SIZE * 8)
+#define BLOCKED_BLOOM_FILTER_BLOCK_WORDS (BLOCKED_BLOOM_FILTER_BLOCK_SIZE / 8)
+#define BLOCKED_BLOOM_FILTER_MAX_HASHES 16
+#define BLOCKED_BLOOM_FILTER_MAX_BITS_PER_KEY 64
+#define BLOCKED_BLOOM_FILTER_DEFAULT_BITS_PER_KEY 10
+
+// 分块布隆过滤器结构
+typedef struct {
+    uint64_t *blocks; // 按块大小对齐，每块BLOCKED_BLOOM_FILTER_BLOCK_WORDS个字
+    uint32_t block_count;
+    uint32_t hash_count; // 每个键在块内设置的位数
+    uint32_t item_count;
+} blocked_bloom_filter;
+
+// 初始化（嵌入在其他结构中的）分块布隆过滤器，位全部清零
+bool blocked_bloom_filter_init(blocked_bloom_filter *filter, uint32_t block_count, uint32_t hash_count);
+
+// 释放blocked_bloom_filter_init分配的位数组
+void blocked_bloom_filter_free(blocked_bloom_filter *filter);
+
+// 创建容纳key_count个键、每个键bits_per_key位的分块布隆过滤器（bits_per_key为0时使用默认值）
+blocked_bloom_filter *blocked_bloom_filter_create(uint32_t key_count, uint32_t bits_per_key);
+
+// 销毁分块布隆过滤器
+void blocked_bloom_filter_destroy(blocked_bloom_filter *filter);
+
+// 添加元素
+bool blocked_bloom_filter_add(blocked_bloom_filter *filter, const char *key, uint32_t key_size);
+
+// 检查元素是否可能存在
+bool blocked_bloom_filter_contains(const blocked_bloom_filter *filter, const char *key, uint32_t key_size);
+
+// key_count个键、每个键bits_per_key位需要的块数
+uint32_t blocked_bloom_filter_block_count(uint32_t key_count, uint32_t bits_per_key);
+
+// 每个键bits_per_key位时的哈希函数个数
+uint32_t blocked_bloom_filter_hashes(uint32_t bits_per_key);
+
+// 每个键bits_per_key位时估计的假阳性率
+double blocked_bloom_filter_false_positive_rate(uint32_t bits_per_key);
+
+// 假阳性率不超过false_positive_rate需要的每个键的位数（最多BLOCKED_BLOOM_FILTER_MAX_BITS_PER_KEY）
+uint32_t blocked_bloom_filter_bits_per_key(double false_positive_rate);
+
 #endif // BLOOM_FILTER_H
@@ -0,0 +1,675 @@
+#include "disk_b_plus_tree.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DISK_B_PLUS_TREE_MAGIC 0x45455254 // "TREE"
+#define DISK_B_PLUS_TREE_FORMAT_VERSION 2
+
+// 根节点的初始页号（第0页是元数据页）
+#define DISK_B_PLUS_TREE_FIRST_ROOT 1
+
+// 页面类型
+typedef enum {
+    DISK_PAGE_FREE = 0,
+    DISK_PAGE_META,
+    DISK_PAGE_INTERNAL,
+    DISK_PAGE_LEAF
+} DiskPageType;
+
+// 节点页头部，之后是键数组和值（叶子节点）或子节点页号（内部节点）数组
+typedef struct {
+    BufferPageHeader page;
+    uint16_t type; // DiskPageType
+    uint16_t reserved;
+    uint32_t key_count;
+    uint64_t next; // 叶子节点的右兄弟（空闲页为下一个空闲页），0表示没有
+    uint64_t prev; // 叶子节点的左兄弟
+} DiskNodeHeader;
+
+// 元数据页
+typedef struct {
+    DiskPageMetaHeader header; // type为DISK_PAGE_META
+    uint32_t key_type;
+    uint32_t key_size;
+    uint32_t height;
+    uint32_t reserved;
+    uint64_t root;
+    uint64_t page_count; // 已分配的页数
+    uint64_t free_page; // 空闲页链表头，0表示没有
+} DiskMetaPage;
+
+static inline DiskNodeHeader* disk_node(BufferFrame* frame) {
+    return (DiskNodeHeader*)frame->data;
+}
+
+static inline DiskMetaPage* disk_meta(DiskBPlusTree* tree) {
+    return (DiskMetaPage*)tree->file.meta->data;
+}
+
+static inline uint8_t* disk_key_at(DiskBPlusTree* tree, BufferFrame* frame, uint32_t index) {
+    return frame->data + sizeof(DiskNodeHeader) + (size_t)index * tree->key_size;
+}
+
+// 叶子节点的值或内部节点的子节点页号
+static inline uint64_t* disk_slots(DiskBPlusTree* tree, BufferFrame* frame) {
+    return (uint64_t*)(frame->data + tree->values_offset);
+}
+
+static inline void disk_set_key(DiskBPlusTree* tree, BufferFrame* frame, uint32_t index, const void* key) {
+    memcpy(disk_key_at(tree, frame, index), key, tree->key_size);
+}
+
+// 移动count个键（区间可以重叠）
+static inline void disk_move_keys(DiskBPlusTree* tree, BufferFrame* target, uint32_t to, BufferFrame* source, uint32_t from, uint32_t count) {
+    memmove(disk_key_at(tree, target, to), disk_key_at(tree, source, from), (size_t)count * tree->key_size);
+}
+
+static int disk_compare_keys(const DiskBPlusTree* tree, const void* a, const void* b) {
+    if (tree->key_type == BPLUS_TREE_KEY_INT64) {
+        int64_t x;
+        int64_t y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        return (x > y) - (x < y);
+    }
+    return memcmp(a, b, tree->key_size);
+}
+
+// 在节点中查找第一个大于等于key的位置（upper为true时查找第一个大于key的位置）
+static uint32_t disk_search(DiskBPlusTree* tree, BufferFrame* frame, const void* key, bool upper) {
+    uint32_t left = 0;
+    uint32_t right = disk_node(frame)->key_count;
+    while (left < right) {
+        uint32_t mid = left + (right - left) / 2;
+        int cmp = disk_compare_keys(tree, disk_key_at(tree, frame, mid), key);
+        if (cmp < 0 || (upper && cmp == 0)) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+// 叶子节点中插入或更新键值对
+static void disk_leaf_put(DiskBPlusTree* tree, BufferFrame* leaf, const void* key, uint64_t value) {
+    DiskNodeHeader* node = disk_node(leaf);
+    uint64_t* values = disk_slots(tree, leaf);
+    uint32_t index = disk_search(tree, leaf, key, false);
+    if (index < node->key_count && disk_compare_keys(tree, disk_key_at(tree, leaf, index), key) == 0) {
+        values[index] = value;
+        return;
+    }
+
+    disk_move_keys(tree, leaf, index + 1, leaf, index, node->key_count - index);
+    memmove(values + index + 1, values + index, sizeof(uint64_t) * (node->key_count - index));
+    disk_set_key(tree, leaf, index, key);
+    values[index] = value;
+    node->key_count++;
+}
+
+// 从叶子节点删除键，不存在时返回false
+static bool disk_leaf_remove(DiskBPlusTree* tree, BufferFrame* leaf, const void* key) {
+    DiskNodeHeader* node = disk_node(leaf);
+    uint64_t* values = disk_slots(tree, leaf);
+    uint32_t index = disk_search(tree, leaf, key, false);
+    if (index >= node->key_count || disk_compare_keys(tree, disk_key_at(tree, leaf, index), key) != 0) {
+        return false;
+    }
+
+    disk_move_keys(tree, leaf, index, leaf, index + 1, node->key_count - index - 1);
+    memmove(values + index, values + index + 1, sizeof(uint64_t) * (node->key_count - index - 1));
+    node->key_count--;
+    return true;
+}
+
+// 分配一个页面（优先复用空闲页），返回固定的帧
+static BufferFrame* disk_alloc_page(DiskBPlusTree* tree, DiskPageOp* op, DiskPageType type) {
+    DiskMetaPage* meta = disk_meta(tree);
+    uint64_t page_id = meta->free_page ? meta->free_page : meta->page_count;
+    BufferFrame* frame = buffer_pool_fetch(tree->file.pool, page_id);
+    if (!frame) {
+        return NULL;
+    }
+
+    if (meta->free_page) {
+        meta->free_page = disk_node(frame)->next;
+    } else {
+        meta->page_count++;
+    }
+    memset(frame->data + sizeof(BufferPageHeader), 0, tree->file.page_size - sizeof(BufferPageHeader));
+    disk_node(frame)->type = (uint16_t)type;
+
+    disk_page_op_touch(&tree->file, op, tree->file.meta, true);
+    disk_page_op_touch(&tree->file, op, frame, true);
+    return frame;
+}
+
+// 释放页面到空闲页链表
+static void disk_free_page(DiskBPlusTree* tree, DiskPageOp* op, BufferFrame* frame) {
+    DiskMetaPage* meta = disk_meta(tree);
+    memset(frame->data + sizeof(BufferPageHeader), 0, tree->file.page_size - sizeof(BufferPageHeader));
+    disk_node(frame)->type = DISK_PAGE_FREE;
+    disk_node(frame)->next = meta->free_page;
+    meta->free_page = frame->page_id;
+
+    disk_page_op_touch(&tree->file, op, tree->file.meta, true);
+    disk_page_op_touch(&tree->file, op, frame, true);
+}
+
+// 设置叶子节点的左兄弟
+static bool disk_set_prev(DiskBPlusTree* tree, DiskPageOp* op, uint64_t page_id, uint64_t prev) {
+    BufferFrame* frame = buffer_pool_fetch(tree->file.pool, page_id);
+    if (!frame) {
+        return false;
+    }
+    disk_node(frame)->prev = prev;
+    disk_page_op_touch(&tree->file, op, frame, true);
+    buffer_pool_unpin(tree->file.pool, frame, false);
+    return true;
+}
+
+// 分裂父节点的第index个子节点（子节点已满，父节点未满）
+static bool disk_split_child(DiskBPlusTree* tree, DiskPageOp* op, BufferFrame* parent, uint32_t index, BufferFrame* child) {
+    DiskNodeHeader* node = disk_node(child);
+    BufferFrame* sibling = disk_alloc_page(tree, op, (DiskPageType)node->type);
+    if (!sibling) {
+        return false;
+    }
+    DiskNodeHeader* new_node = disk_node(sibling);
+    uint32_t mid = node->key_count / 2;
+
+    if (node->type == DISK_PAGE_LEAF) {
+        if (node->next && !disk_set_prev(tree, op, node->next, sibling->page_id)) {
+            disk_free_page(tree, op, sibling);
+            buffer_pool_unpin(tree->file.pool, sibling, false);
+            return false;
+        }
+        new_node->key_count = node->key_count - mid;
+        disk_move_keys(tree, sibling, 0, child, mid, new_node->key_count);
+        memcpy(disk_slots(tree, sibling), disk_slots(tree, child) + mid, sizeof(uint64_t) * new_node->key_count);
+        new_node->next = node->next;
+        new_node->prev = child->page_id;
+        node->next = sibling->page_id;
+        node->key_count = mid;
+    } else {
+        // 中间的键上移到父节点
+        new_node->key_count = node->key_count - mid - 1;
+        disk_move_keys(tree, sibling, 0, child, mid + 1, new_node->key_count);
+        memcpy(disk_slots(tree, sibling), disk_slots(tree, child) + mid + 1, sizeof(uint64_t) * (new_node->key_count + 1));
+        node->key_count = mid;
+    }
+
+    // 分隔键：叶子节点为右节点的第一个键，内部节点为上移的中间键（仍保留在子节点的键数组中）
+    const uint8_t* separator = node->type == DISK_PAGE_LEAF ? disk_key_at(tree, sibling, 0) : disk_key_at(tree, child, mid);
+    DiskNodeHeader* parent_node = disk_node(parent);
+    uint64_t* children = disk_slots(tree, parent);
+    disk_move_keys(tree, parent, index + 1, parent, index, parent_node->key_count - index);
+    memmove(children + index + 2, children + index + 1, sizeof(uint64_t) * (parent_node->key_count - index));
+    disk_set_key(tree, parent, index, separator);
+    children[index + 1] = sibling->page_id;
+    parent_node->key_count++;
+
+    disk_page_op_touch(&tree->file, op, parent, true);
+    disk_page_op_touch(&tree->file, op, child, true);
+    buffer_pool_unpin(tree->file.pool, sibling, false);
+    return true;
+}
+
+// 从左兄弟借一个键给父节点的第index个子节点
+static void disk_borrow_from_left(DiskBPlusTree* tree, BufferFrame* parent, uint32_t index, BufferFrame* left, BufferFrame* child) {
+    DiskNodeHeader* node = disk_node(child);
+    DiskNodeHeader* left_node = disk_node(left);
+    uint64_t* slots = disk_slots(tree, child);
+    uint64_t* left_slots = disk_slots(tree, left);
+
+    disk_move_keys(tree, child, 1, child, 0, node->key_count);
+    if (node->type == DISK_PAGE_LEAF) {
+        memmove(slots + 1, slots, sizeof(uint64_t) * node->key_count);
+        disk_set_key(tree, child, 0, disk_key_at(tree, left, left_node->key_count - 1));
+        slots[0] = left_slots[left_node->key_count - 1];
+        disk_set_key(tree, parent, index - 1, disk_key_at(tree, child, 0));
+    } else {
+        memmove(slots + 1, slots, sizeof(uint64_t) * (node->key_count + 1));
+        disk_set_key(tree, child, 0, disk_key_at(tree, parent, index - 1));
+        slots[0] = left_slots[left_node->key_count];
+        disk_set_key(tree, parent, index - 1, disk_key_at(tree, left, left_node->key_count - 1));
+    }
+    node->key_count++;
+    left_node->key_count--;
+}
+
+// 从右兄弟借一个键给父节点的第index个子节点
+static void disk_borrow_from_right(DiskBPlusTree* tree, BufferFrame* parent, uint32_t index, BufferFrame* child, BufferFrame* right) {
+    DiskNodeHeader* node = disk_node(child);
+    DiskNodeHeader* right_node = disk_node(right);
+    uint64_t* slots = disk_slots(tree, child);
+    uint64_t* right_slots = disk_slots(tree, right);
+
+    if (node->type == DISK_PAGE_LEAF) {
+        disk_set_key(tree, child, node->key_count, disk_key_at(tree, right, 0));
+        slots[node->key_count] = right_slots[0];
+        memmove(right_slots, right_slots + 1, sizeof(uint64_t) * (right_node->key_count - 1));
+        disk_move_keys(tree, right, 0, right, 1, right_node->key_count - 1);
+        right_node->key_count--;
+        disk_set_key(tree, parent, index, disk_key_at(tree, right, 0));
+    } else {
+        disk_set_key(tree, child, node->key_count, disk_key_at(tree, parent, index));
+        slots[node->key_count + 1] = right_slots[0];
+        disk_set_key(tree, parent, index, disk_key_at(tree, right, 0));
+        memmove(right_slots, right_slots + 1, sizeof(uint64_t) * right_node->key_count);
+        disk_move_keys(tree, right, 0, right, 1, right_node->key_count - 1);
+        right_node->key_count--;
+    }
+    node->key_count++;
+}
+
+// 合并父节点的第index个和第index + 1个子节点，释放右节点
+static bool disk_merge(DiskBPlusTree* tree, DiskPageOp* op, BufferFrame* parent, uint32_t index, BufferFrame* left, BufferFrame* right) {
+    DiskNodeHeader* left_node = disk_node(left);
+    DiskNodeHeader* right_node = disk_node(right);
+    uint64_t* left_slots = disk_slots(tree, left);
+    uint64_t* right_slots = disk_slots(tree, right);
+
+    if (left_node->type == DISK_PAGE_LEAF) {
+        if (right_node->next && !disk_set_prev(tree, op, right_node->next, left->page_id)) {
+            return false;
+        }
+        disk_move_keys(tree, left, left_node->key_count, right, 0, right_node->key_count);
+        memcpy(left_slots + left_node->key_count, right_slots, sizeof(uint64_t) * right_node->key_count);
+        left_node->key_count += right_node->key_count;
+        left_node->next = right_node->next;
+    } else {
+        // 父节点的分隔键下移到两个节点的键之间
+        disk_set_key(tree, left, left_node->key_count, disk_key_at(tree, parent, index));
+        disk_move_keys(tree, left, left_node->key_count + 1, right, 0, right_node->key_count);
+        memcpy(left_slots + left_node->key_count + 1, right_slots, sizeof(uint64_t) * (right_node->key_count + 1));
+        left_node->key_count += right_node->key_count + 1;
+    }
+
+    DiskNodeHeader* parent_node = disk_node(parent);
+    uint64_t* children = disk_slots(tree, parent);
+    disk_move_keys(tree, parent, index, parent, index + 1, parent_node->key_count - index - 1);
+    memmove(children + index + 1, children + index + 2, sizeof(uint64_t) * (parent_node->key_count - index - 1));
+    parent_node->key_count--;
+
+    disk_page_op_touch(&tree->file, op, left, true);
+    disk_free_page(tree, op, right);
+    return true;
+}
+
+// 保证父节点的第index个子节点删除一个键后不会下溢：从有富余的兄弟节点借一个键，否则合并。
+// 返回之后继续下降的节点（合并到左兄弟时为左兄弟），child的固定转移给返回的节点
+static BufferFrame* disk_fill_child(DiskBPlusTree* tree, DiskPageOp* op, BufferFrame* parent, uint32_t index, BufferFrame* child) {
+    uint64_t* children = disk_slots(tree, parent);
+    uint32_t parent_count = disk_node(parent)->key_count;
+    BufferFrame* left = index > 0 ? buffer_pool_fetch(tree->file.pool, children[index - 1]) : NULL;
+    BufferFrame* right = index < parent_count ? buffer_pool_fetch(tree->file.pool, children[index + 1]) : NULL;
+    BufferFrame* result = child;
+
+    if ((index > 0 && !left) || (index < parent_count && !right)) {
+        result = NULL;
+    } else if (left && disk_node(left)->key_count > tree->min_keys) {
+        disk_borrow_from_left(tree, parent, index, left, child);
+        disk_page_op_touch(&tree->file, op, left, true);
+    } else if (right && disk_node(right)->key_count > tree->min_keys) {
+        disk_borrow_from_right(tree, parent, index, child, right);
+        disk_page_op_touch(&tree->file, op, right, true);
+    } else if (left) {
+        if (disk_merge(tree, op, parent, index - 1, left, child)) {
+            result = left;
+            left = NULL;
+        } else {
+            result = NULL;
+        }
+    } else if (!disk_merge(tree, op, parent, index, child, right)) {
+        result = NULL;
+    }
+
+    if (result) {
+        disk_page_op_touch(&tree->file, op, parent, true);
+        disk_page_op_touch(&tree->file, op, result, true);
+    }
+    if (result != child) {
+        buffer_pool_unpin(tree->file.pool, child, false);
+    }
+    buffer_pool_unpin(tree->file.pool, left, false);
+    buffer_pool_unpin(tree->file.pool, right, false);
+    return result;
+}
+
+// 插入键值对
+bool disk_b_plus_tree_insert(DiskBPlusTree* tree, const void* key, uint64_t value) {
+    if (!tree || !key) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&tree->lock);
+    if (tree->file.failed) {
+        pthread_rwlock_unlock(&tree->lock);
+        return false;
+    }
+
+    DiskPageOp op;
+    disk_page_op_init(&op, DISK_B_PLUS_TREE_MAX_OP_PAGES);
+    DiskMetaPage* meta = disk_meta(tree);
+    bool success = false;
+
+    BufferFrame* node = buffer_pool_fetch(tree->file.pool, meta->root);
+    if (node && disk_node(node)->key_count == tree->capacity) {
+        // 根节点已满：新建根节点后分裂原根节点，树高加一
+        BufferFrame* root = meta->height < DISK_B_PLUS_TREE_MAX_HEIGHT ? disk_alloc_page(tree, &op, DISK_PAGE_INTERNAL) : NULL;
+        if (root) {
+            disk_slots(tree, root)[0] = node->page_id;
+            if (disk_split_child(tree, &op, root, 0, node)) {
+                meta->root = root->page_id;
+                meta->height++;
+            }
+        }
+        buffer_pool_unpin(tree->file.pool, node, false);
+        node = root && meta->root == root->page_id ? root : NULL;
+        if (root && !node) {
+            disk_free_page(tree, &op, root);
+            buffer_pool_unpin(tree->file.pool, root, false);
+        }
+    }
+
+    // 下降过程中先分裂已满的子节点，保证父节点总能容纳上移的分隔键
+    while (node && disk_node(node)->type == DISK_PAGE_INTERNAL) {
+        uint32_t index = disk_search(tree, node, key, true);
+        BufferFrame* child = buffer_pool_fetch(tree->file.pool, disk_slots(tree, node)[index]);
+        if (child && disk_node(child)->key_count == tree->capacity) {
+            if (!disk_split_child(tree, &op, node, index, child)) {
+                buffer_pool_unpin(tree->file.pool, child, false);
+                child = NULL;
+            } else if (disk_compare_keys(tree, key, disk_key_at(tree, node, index)) >= 0) {
+                buffer_pool_unpin(tree->file.pool, child, false);
+                child = buffer_pool_fetch(tree->file.pool, disk_slots(tree, node)[index + 1]);
+            }
+        }
+        buffer_pool_unpin(tree->file.pool, node, false);
+        node = child;
+    }
+
+    if (node) {
+        disk_leaf_put(tree, node, key, value);
+        disk_page_op_entry(&tree->file, &op, node, DISK_PAGE_LOG_PUT, key, value);
+        buffer_pool_unpin(tree->file.pool, node, false);
+        success = true;
+    }
+
+    // 中途失败时已完成的分裂仍然有效，同样需要记录日志
+    success = disk_page_op_commit(&tree->file, &op) && success;
+    pthread_rwlock_unlock(&tree->lock);
+    return success;
+}
+
+// 删除键
+bool disk_b_plus_tree_delete(DiskBPlusTree* tree, const void* key) {
+    if (!tree || !key) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&tree->lock);
+    if (tree->file.failed) {
+        pthread_rwlock_unlock(&tree->lock);
+        return false;
+    }
+
+    DiskPageOp op;
+    disk_page_op_init(&op, DISK_B_PLUS_TREE_MAX_OP_PAGES);
+    DiskMetaPage* meta = disk_meta(tree);
+    bool found = false;
+
+    // 下降过程中先补足键数最少的子节点，保证删除后不会下溢
+    BufferFrame* node = buffer_pool_fetch(tree->file.pool, meta->root);
+    while (node && disk_node(node)->type == DISK_PAGE_INTERNAL) {
+        uint32_t index = disk_search(tree, node, key, true);
+        BufferFrame* child = buffer_pool_fetch(tree->file.pool, disk_slots(tree, node)[index]);
+        if (child && disk_node(child)->key_count <= tree->min_keys) {
+            child = disk_fill_child(tree, &op, node, index, child);
+        }
+
+        // 根节点的最后一个分隔键下移后，树高减一
+        if (child && node->page_id == meta->root && disk_node(node)->key_count == 0) {
+            meta->root = child->page_id;
+            meta->height--;
+            disk_free_page(tree, &op, node);
+        }
+        buffer_pool_unpin(tree->file.pool, node, false);
+        node = child;
+    }
+
+    if (node) {
+        found = disk_leaf_remove(tree, node, key);
+        if (found) {
+            disk_page_op_entry(&tree->file, &op, node, DISK_PAGE_LOG_REMOVE, key, 0);
+        }
+        buffer_pool_unpin(tree->file.pool, node, false);
+    }
+
+    found = disk_page_op_commit(&tree->file, &op) && found;
+    pthread_rwlock_unlock(&tree->lock);
+    return found;
+}
+
+// 找到key所在的叶子节点（调用者持有读锁或写锁），返回固定的帧
+static BufferFrame* disk_find_leaf(DiskBPlusTree* tree, const void* key) {
+    BufferFrame* node = buffer_pool_fetch(tree->file.pool, disk_meta(tree)->root);
+    while (node && disk_node(node)->type == DISK_PAGE_INTERNAL) {
+        uint32_t index = key ? disk_search(tree, node, key, true) : 0;
+        BufferFrame* child = buffer_pool_fetch(tree->file.pool, disk_slots(tree, node)[index]);
+        buffer_pool_unpin(tree->file.pool, node, false);
+        node = child;
+    }
+    return node;
+}
+
+// 查找键
+bool disk_b_plus_tree_find(DiskBPlusTree* tree, const void* key, uint64_t* value) {
+    if (!tree || !key) {
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&tree->lock);
+    bool found = false;
+    BufferFrame* leaf = disk_find_leaf(tree, key);
+    if (leaf) {
+        uint32_t index = disk_search(tree, leaf, key, false);
+        if (index < disk_node(leaf)->key_count && disk_compare_keys(tree, disk_key_at(tree, leaf, index), key) == 0) {
+            found = true;
+            if (value) {
+                *value = disk_slots(tree, leaf)[index];
+            }
+        }
+        buffer_pool_unpin(tree->file.pool, leaf, false);
+    }
+    pthread_rwlock_unlock(&tree->lock);
+    return found;
+}
+
+// 范围扫描
+bool disk_b_plus_tree_scan(DiskBPlusTree* tree, const void* start_key, const void* end_key,
+                           DiskBPlusTreeScanCallback callback, void* arg) {
+    if (!tree || !callback) {
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&tree->lock);
+    BufferFrame* leaf = disk_find_leaf(tree, start_key);
+    bool success = leaf != NULL;
+    uint32_t index = leaf && start_key ? disk_search(tree, leaf, start_key, false) : 0;
+
+    // 沿叶子链表遍历
+    while (leaf) {
+        bool done = false;
+        for (; index < disk_node(leaf)->key_count && !done; index++) {
+            const uint8_t* key = disk_key_at(tree, leaf, index);
+            done = (end_key && disk_compare_keys(tree, key, end_key) > 0) ||
+                   !callback(key, disk_slots(tree, leaf)[index], arg);
+        }
+
+        uint64_t next = done ? 0 : disk_node(leaf)->next;
+        buffer_pool_unpin(tree->file.pool, leaf, false);
+        leaf = next ? buffer_pool_fetch(tree->file.pool, next) : NULL;
+        success = success && (!next || leaf);
+        index = 0;
+    }
+
+    pthread_rwlock_unlock(&tree->lock);
+    return success;
+}
+
+// 重做叶子节点的键值修改
+static void disk_b_plus_tree_apply(void* arg, BufferFrame* frame, DiskPageLogType type, const void* key, uint64_t value) {
+    DiskBPlusTree* tree = (DiskBPlusTree*)arg;
+    if (type == DISK_PAGE_LOG_PUT) {
+        disk_leaf_put(tree, frame, key, value);
+    } else {
+        disk_leaf_remove(tree, frame, key);
+    }
+}
+
+// 初始化新索引：元数据页和空的根节点
+static bool disk_b_plus_tree_format(DiskBPlusTree* tree) {
+    DiskMetaPage* meta = disk_meta(tree);
+    memset(tree->file.meta->data, 0, tree->file.page_size);
+    meta->header.type = DISK_PAGE_META;
+    meta->header.magic = DISK_B_PLUS_TREE_MAGIC;
+    meta->header.version = DISK_B_PLUS_TREE_FORMAT_VERSION;
+    meta->header.page_size = (uint32_t)tree->file.page_size;
+    meta->key_type = (uint32_t)tree->key_type;
+    meta->key_size = (uint32_t)tree->key_size;
+    meta->height = 1;
+    meta->root = DISK_B_PLUS_TREE_FIRST_ROOT;
+    meta->page_count = DISK_B_PLUS_TREE_FIRST_ROOT + 1;
+
+    BufferFrame* root = buffer_pool_fetch(tree->file.pool, DISK_B_PLUS_TREE_FIRST_ROOT);
+    if (!root) {
+        return false;
+    }
+    memset(root->data, 0, tree->file.page_size);
+    disk_node(root)->type = DISK_PAGE_LEAF;
+    buffer_pool_unpin(tree->file.pool, root, true);
+    return disk_page_file_checkpoint(&tree->file, false);
+}
+
+// 打开已有索引：校验元数据后按日志恢复
+static bool disk_b_plus_tree_recover(DiskBPlusTree* tree) {
+    DiskMetaPage* meta = disk_meta(tree);
+    if (meta->header.version != DISK_B_PLUS_TREE_FORMAT_VERSION || meta->key_type != (uint32_t)tree->key_type ||
+        meta->key_size != (uint32_t)tree->key_size) {
+        fprintf(stderr, "Disk B+ tree %s does not match the requested key type\n", tree->file.name);
+        return false;
+    }
+    return disk_page_file_recover(&tree->file, disk_b_plus_tree_apply, tree);
+}
+
+// 打开磁盘B+树
+DiskBPlusTree* disk_b_plus_tree_open(const DiskBPlusTreeConfig* config) {
+    if (!config || !config->path) {
+        return NULL;
+    }
+    if (config->key_type != BPLUS_TREE_KEY_INT64 && (config->key_type != BPLUS_TREE_KEY_FIXED || config->key_size == 0)) {
+        return NULL;
+    }
+
+    DiskBPlusTree* tree = (DiskBPlusTree*)malloc(sizeof(DiskBPlusTree));
+    if (!tree) {
+        return NULL;
+    }
+    memset(tree, 0, sizeof(DiskBPlusTree));
+    tree->key_type = config->key_type;
+    tree->key_size = config->key_type == BPLUS_TREE_KEY_INT64 ? sizeof(int64_t) : config->key_size;
+
+    // 已有索引沿用创建时的页大小
+    size_t stored_page_size = disk_page_file_stored_page_size(config->path, DISK_B_PLUS_TREE_MAGIC);
+    size_t page_size = stored_page_size ? stored_page_size :
+                       (config->page_size ? config->page_size : DISK_B_PLUS_TREE_DEFAULT_PAGE_SIZE);
+
+    // 键数组之后是按8字节对齐的值数组，内部节点比键多一个子节点
+    size_t fixed_size = sizeof(DiskNodeHeader) + sizeof(uint64_t) + sizeof(uint64_t) - 1;
+    size_t capacity = page_size > fixed_size ? (page_size - fixed_size) / (tree->key_size + sizeof(uint64_t)) : 0;
+    if (capacity < BPLUS_TREE_MIN_CAPACITY || tree->key_size > BUFFER_POOL_MAX_PAGE_SIZE / 4 || page_size < sizeof(DiskMetaPage)) {
+        fprintf(stderr, "Invalid disk B+ tree page size %zu for keys of %zu bytes\n", page_size, tree->key_size);
+        free(tree);
+        return NULL;
+    }
+    tree->capacity = (uint32_t)capacity;
+    tree->min_keys = (tree->capacity - 1) / 2;
+    tree->values_offset = (sizeof(DiskNodeHeader) + capacity * tree->key_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+    // 写操作期间固定所有修改的页面，帧数至少要能容纳一个操作
+    uint32_t frames = config->buffer_frames ? config->buffer_frames : DISK_B_PLUS_TREE_DEFAULT_FRAMES;
+    if (!disk_page_file_open(&tree->file, config->path, config->name ? config->name : config->path, "disk B+ tree",
+                             config->wal, page_size, tree->key_size, frames, DISK_B_PLUS_TREE_MAX_OP_PAGES + 8,
+                             DISK_B_PLUS_TREE_MAX_OP_PAGES)) {
+        free(tree);
+        return NULL;
+    }
+    pthread_rwlock_init(&tree->lock, NULL);
+
+    bool opened = disk_meta(tree)->header.magic == DISK_B_PLUS_TREE_MAGIC ?
+                  disk_b_plus_tree_recover(tree) : disk_b_plus_tree_format(tree);
+    if (!opened) {
+        // 没有打开的索引不做检查点，文件保持原样
+        tree->file.failed = true;
+        disk_page_file_close(&tree->file);
+        pthread_rwlock_destroy(&tree->lock);
+        free(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+// 关闭磁盘B+树
+void disk_b_plus_tree_close(DiskBPlusTree* tree) {
+    if (!tree) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&tree->lock);
+    disk_page_file_close(&tree->file);
+    pthread_rwlock_unlock(&tree->lock);
+
+    pthread_rwlock_destroy(&tree->lock);
+    free(tree);
+}
+
+// 检查点
+bool disk_b_plus_tree_checkpoint(DiskBPlusTree* tree) {
+    if (!tree) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&tree->lock);
+    bool success = !tree->file.failed && disk_page_file_checkpoint(&tree->file, false);
+    pthread_rwlock_unlock(&tree->lock);
+    return success;
+}
+
+// 最近一次检查点的LSN
+uint64_t disk_b_plus_tree_checkpoint_lsn(DiskBPlusTree* tree) {
+    if (!tree) {
+        return 0;
+    }
+
+    pthread_rwlock_rdlock(&tree->lock);
+    uint64_t lsn = tree->file.checkpoint_lsn;
+    pthread_rwlock_unlock(&tree->lock);
+    return lsn;
+}
+
+// 获取树高
+uint32_t disk_b_plus_tree_height(DiskBPlusTree* tree) {
+    if (!tree) {
+        return 0;
+    }
+
+    pthread_rwlock_rdlock(&tree->lock);
+    uint32_t height = disk_meta(tree)->height;
+    pthread_rwlock_unlock(&tree->lock);
+    return height;
+}
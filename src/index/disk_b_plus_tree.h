@@ -0,0 +1,86 @@
+#ifndef DISK_B_PLUS_TREE_H
+#define DISK_B_PLUS_TREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "b_plus_tree.h"
+#include "disk_page_file.h"
+
+// 磁盘B+树索引
+// 节点是页文件中的定长页面，以页号寻址，通过缓冲池读写，索引大小不受内存限制。
+// 第0页是元数据页（根页号、树高、页数和空闲页链表）。键为定长键（int64或定长字节），
+// 值为64位整数（通常是行ID）。
+// 日志和恢复见disk_page_file.h：分裂、合并记录页面镜像，叶子节点的插入删除只记录键值。
+// 并发控制：读操作共享、写操作独占索引级读写锁。
+
+// 默认页大小
+#define DISK_B_PLUS_TREE_DEFAULT_PAGE_SIZE 4096
+
+// 默认缓冲池帧数
+#define DISK_B_PLUS_TREE_DEFAULT_FRAMES 1024
+
+// 树的最大高度（限制单个写操作修改的页数）
+#define DISK_B_PLUS_TREE_MAX_HEIGHT 16
+
+// 单个写操作最多修改的页数：每层的节点和兄弟节点、新的根节点、释放的页和元数据页
+// （不超过DISK_PAGE_OP_MAX_PAGES）
+#define DISK_B_PLUS_TREE_MAX_OP_PAGES (DISK_B_PLUS_TREE_MAX_HEIGHT * 3 + 2)
+
+// 磁盘B+树配置
+typedef struct {
+    const char* path; // 页文件路径
+    const char* name; // 日志记录中区分索引的名称
+    BPlusTreeKeyType key_type; // BPLUS_TREE_KEY_INT64或BPLUS_TREE_KEY_FIXED
+    size_t key_size; // 定长字节键的长度（int64键忽略）
+    size_t page_size; // 页大小（2的幂），0表示默认值；打开已有索引时忽略
+    uint32_t buffer_frames; // 缓冲池帧数，0表示默认值
+    WriteAheadLog* wal; // NULL表示不记录日志，只有检查点和关闭时的状态是一致的
+} DiskBPlusTreeConfig;
+
+// 磁盘B+树索引
+typedef struct {
+    DiskPageFile file; // 页文件、日志和元数据页
+
+    BPlusTreeKeyType key_type;
+    size_t key_size;
+    uint32_t capacity; // 每个节点的最大键数
+    uint32_t min_keys; // 非根节点的最少键数
+    size_t values_offset; // 页面中值（或子节点页号）数组的偏移
+
+    pthread_rwlock_t lock;
+} DiskBPlusTree;
+
+// 范围扫描回调，返回false停止扫描
+typedef bool (*DiskBPlusTreeScanCallback)(const void* key, uint64_t value, void* arg);
+
+// 打开磁盘B+树（文件不存在时创建，存在时按日志恢复）
+DiskBPlusTree* disk_b_plus_tree_open(const DiskBPlusTreeConfig* config);
+
+// 检查点后关闭
+void disk_b_plus_tree_close(DiskBPlusTree* tree);
+
+// 插入键值对（键已存在时更新值）
+bool disk_b_plus_tree_insert(DiskBPlusTree* tree, const void* key, uint64_t value);
+
+// 删除键，键不存在时返回false
+bool disk_b_plus_tree_delete(DiskBPlusTree* tree, const void* key);
+
+// 查找键
+bool disk_b_plus_tree_find(DiskBPlusTree* tree, const void* key, uint64_t* value);
+
+// 按键顺序扫描[start_key, end_key]，start_key或end_key为NULL表示不限
+bool disk_b_plus_tree_scan(DiskBPlusTree* tree, const void* start_key, const void* end_key,
+                           DiskBPlusTreeScanCallback callback, void* arg);
+
+// 检查点：写回全部脏页，之后恢复时从当前日志位置开始重做
+bool disk_b_plus_tree_checkpoint(DiskBPlusTree* tree);
+
+// 最近一次检查点的LSN
+uint64_t disk_b_plus_tree_checkpoint_lsn(DiskBPlusTree* tree);
+
+// 获取树高
+uint32_t disk_b_plus_tree_height(DiskBPlusTree* tree);
+
+#endif // DISK_B_PLUS_TREE_H
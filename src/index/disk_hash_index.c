@@ -0,0 +1,550 @@
+#include "disk_hash_index.h"
+#include "../util/hash.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DISK_HASH_INDEX_MAGIC 0x48534148 // "HASH"
+#define DISK_HASH_INDEX_FORMAT_VERSION 2
+
+// 第一个桶的页号（第0页是元数据页）
+#define DISK_HASH_INDEX_FIRST_BUCKET 1
+
+// 页面类型（桶的主页面在第一次写入之前是全零页面，即空桶）
+typedef enum {
+    DISK_HASH_PAGE_FREE = 0,
+    DISK_HASH_PAGE_META,
+    DISK_HASH_PAGE_BUCKET,
+    DISK_HASH_PAGE_OVERFLOW
+} DiskHashPageType;
+
+// 桶页头部，之后是条目数组（键和值）
+typedef struct {
+    BufferPageHeader page;
+    uint16_t type; // DiskHashPageType
+    uint16_t reserved;
+    uint32_t entry_count;
+    uint64_t next; // 下一个溢出页（空闲页为下一个空闲页），0表示没有
+} DiskHashPageHeader;
+
+// 元数据页
+typedef struct {
+    DiskPageMetaHeader header; // type为DISK_HASH_PAGE_META
+    uint32_t key_size;
+    uint32_t level; // 当前一轮开始时桶数为initial_buckets << level
+    uint64_t initial_buckets;
+    uint64_t split_bucket; // 下一个要分裂的桶
+    uint64_t page_count; // 已分配（包括预留）的页数
+    uint64_t free_page; // 空闲页链表头，0表示没有
+    uint64_t segments[DISK_HASH_INDEX_MAX_LEVEL + 1]; // 第0组是初始的桶，第g组是第g - 1轮新增的桶，记录主页面的起始页号
+} DiskHashMetaPage;
+
+static inline DiskHashPageHeader* disk_hash_page(BufferFrame* frame) {
+    return (DiskHashPageHeader*)frame->data;
+}
+
+static inline DiskHashMetaPage* disk_hash_meta(DiskHashIndex* index) {
+    return (DiskHashMetaPage*)index->file.meta->data;
+}
+
+static inline uint8_t* disk_hash_entry(DiskHashIndex* index, BufferFrame* frame, uint32_t position) {
+    return frame->data + sizeof(DiskHashPageHeader) + (size_t)position * index->entry_size;
+}
+
+// 键所在的桶：按本轮的桶数取低位，已经分裂的桶再多取一位
+static uint64_t disk_hash_bucket(const DiskHashMetaPage* meta, uint64_t hash) {
+    uint64_t round = meta->initial_buckets << meta->level;
+    uint64_t bucket = hash & (round - 1);
+    return bucket < meta->split_bucket ? hash & (round * 2 - 1) : bucket;
+}
+
+// 桶的主页面页号
+static uint64_t disk_hash_bucket_page(const DiskHashMetaPage* meta, uint64_t bucket) {
+    if (bucket < meta->initial_buckets) {
+        return meta->segments[0] + bucket;
+    }
+    uint32_t group = 64 - (uint32_t)__builtin_clzll(bucket / meta->initial_buckets);
+    return meta->segments[group] + bucket - (meta->initial_buckets << (group - 1));
+}
+
+// 在页面中查找键，返回条目下标，不存在时返回UINT32_MAX
+static uint32_t disk_hash_page_search(DiskHashIndex* index, BufferFrame* frame, const void* key) {
+    uint32_t count = disk_hash_page(frame)->entry_count;
+    for (uint32_t i = 0; i < count && i < index->capacity; i++) {
+        if (memcmp(disk_hash_entry(index, frame, i), key, index->key_size) == 0) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// 页面中插入或更新键值对，页面已满时返回false
+static bool disk_hash_page_put(DiskHashIndex* index, BufferFrame* frame, const void* key, uint64_t value) {
+    DiskHashPageHeader* page = disk_hash_page(frame);
+    uint32_t position = disk_hash_page_search(index, frame, key);
+    if (position == UINT32_MAX) {
+        if (page->entry_count >= index->capacity) {
+            return false;
+        }
+        position = page->entry_count++;
+        memcpy(disk_hash_entry(index, frame, position), key, index->key_size);
+    }
+    memcpy(disk_hash_entry(index, frame, position) + index->key_size, &value, sizeof(value));
+    return true;
+}
+
+// 从页面删除键（最后一个条目移到空出的位置），不存在时返回false
+static bool disk_hash_page_remove(DiskHashIndex* index, BufferFrame* frame, const void* key) {
+    DiskHashPageHeader* page = disk_hash_page(frame);
+    uint32_t position = disk_hash_page_search(index, frame, key);
+    if (position == UINT32_MAX) {
+        return false;
+    }
+    page->entry_count--;
+    if (position != page->entry_count) {
+        memcpy(disk_hash_entry(index, frame, position), disk_hash_entry(index, frame, page->entry_count), index->entry_size);
+    }
+    return true;
+}
+
+// 分配一个溢出页（优先复用空闲页），返回固定的帧
+static BufferFrame* disk_hash_alloc_page(DiskHashIndex* index, DiskPageOp* op) {
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    uint64_t page_id = meta->free_page ? meta->free_page : meta->page_count;
+    BufferFrame* frame = buffer_pool_fetch(index->file.pool, page_id);
+    if (!frame) {
+        return NULL;
+    }
+
+    if (meta->free_page) {
+        meta->free_page = disk_hash_page(frame)->next;
+    } else {
+        meta->page_count++;
+    }
+    memset(frame->data + sizeof(BufferPageHeader), 0, index->file.page_size - sizeof(BufferPageHeader));
+    disk_hash_page(frame)->type = DISK_HASH_PAGE_OVERFLOW;
+
+    disk_page_op_touch(&index->file, op, index->file.meta, true);
+    disk_page_op_touch(&index->file, op, frame, true);
+    return frame;
+}
+
+// 释放溢出页到空闲页链表
+static void disk_hash_free_page(DiskHashIndex* index, DiskPageOp* op, BufferFrame* frame) {
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    memset(frame->data + sizeof(BufferPageHeader), 0, index->file.page_size - sizeof(BufferPageHeader));
+    disk_hash_page(frame)->type = DISK_HASH_PAGE_FREE;
+    disk_hash_page(frame)->next = meta->free_page;
+    meta->free_page = frame->page_id;
+
+    disk_page_op_touch(&index->file, op, index->file.meta, true);
+    disk_page_op_touch(&index->file, op, frame, true);
+}
+
+// 读入桶的全部页面（固定），返回页数，读取失败或链表过长时返回0
+static uint32_t disk_hash_fetch_chain(DiskHashIndex* index, uint64_t bucket, BufferFrame** frames) {
+    uint64_t page_id = disk_hash_bucket_page(disk_hash_meta(index), bucket);
+    uint32_t count = 0;
+    while (page_id != 0) {
+        BufferFrame* frame = count < DISK_HASH_INDEX_MAX_CHAIN ? buffer_pool_fetch(index->file.pool, page_id) : NULL;
+        if (!frame) {
+            for (uint32_t i = 0; i < count; i++) {
+                buffer_pool_unpin(index->file.pool, frames[i], false);
+            }
+            return 0;
+        }
+        frames[count++] = frame;
+        page_id = disk_hash_page(frame)->next;
+    }
+    return count;
+}
+
+// 把条目依次写入桶的页面：第一个页面是主页面，之后是溢出页，页面原有内容清空
+static void disk_hash_fill_chain(DiskHashIndex* index, DiskPageOp* op, BufferFrame** frames, uint32_t count, const uint8_t* entries, uint32_t total) {
+    for (uint32_t i = 0; i < count; i++) {
+        DiskHashPageHeader* page = disk_hash_page(frames[i]);
+        uint32_t entry_count = total < index->capacity ? total : index->capacity;
+        memset(frames[i]->data + sizeof(BufferPageHeader), 0, index->file.page_size - sizeof(BufferPageHeader));
+        page->type = i == 0 ? DISK_HASH_PAGE_BUCKET : DISK_HASH_PAGE_OVERFLOW;
+        page->entry_count = entry_count;
+        page->next = i + 1 < count ? frames[i + 1]->page_id : 0;
+        memcpy(disk_hash_entry(index, frames[i], 0), entries, (size_t)entry_count * index->entry_size);
+        entries += (size_t)entry_count * index->entry_size;
+        total -= entry_count;
+        disk_page_op_touch(&index->file, op, frames[i], true);
+    }
+}
+
+// 分裂分裂指针指向的桶：条目按多取一位的桶号分成留下和移走两部分，各自紧凑排列。
+// 两部分占用的页数之和不超过原桶的页数加一，新桶使用预留的主页面和原桶用不到的溢出页，
+// 剩下的溢出页释放，不需要分配页面。修改任何页面之前先读入全部页面，之后不会中途失败
+static bool disk_hash_split(DiskHashIndex* index) {
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    if (meta->level >= DISK_HASH_INDEX_MAX_LEVEL) {
+        fprintf(stderr, "Disk hash index %s cannot grow beyond %llu buckets\n", index->file.name,
+                (unsigned long long)(meta->initial_buckets << meta->level));
+        return false;
+    }
+
+    uint64_t round = meta->initial_buckets << meta->level;
+    uint64_t bucket = meta->split_bucket;
+    BufferFrame* old_frames[DISK_HASH_INDEX_MAX_CHAIN];
+    uint32_t old_count = disk_hash_fetch_chain(index, bucket, old_frames);
+    // 新一轮的第一次分裂从当前页数开始预留这一轮新增的桶的主页面
+    uint64_t new_page = bucket == 0 ? meta->page_count : disk_hash_bucket_page(meta, bucket + round);
+    BufferFrame* new_frame = old_count > 0 ? buffer_pool_fetch(index->file.pool, new_page) : NULL;
+    size_t buffer_size = (size_t)old_count * index->capacity * index->entry_size;
+    uint8_t* entries = new_frame ? (uint8_t*)malloc(buffer_size) : NULL;
+    if (!entries) {
+        if (new_frame) {
+            buffer_pool_unpin(index->file.pool, new_frame, false);
+        }
+        for (uint32_t i = 0; i < old_count; i++) {
+            buffer_pool_unpin(index->file.pool, old_frames[i], false);
+        }
+        return false;
+    }
+
+    // 复制出全部条目：留下的从缓冲区开头、移走的从末尾开始排列
+    uint32_t keep = 0;
+    uint32_t move = 0;
+    for (uint32_t i = 0; i < old_count; i++) {
+        uint32_t count = disk_hash_page(old_frames[i])->entry_count;
+        for (uint32_t j = 0; j < count && j < index->capacity; j++) {
+            const uint8_t* entry = disk_hash_entry(index, old_frames[i], j);
+            if ((hash64(entry, index->key_size, 0) & (round * 2 - 1)) == bucket) {
+                memcpy(entries + (size_t)keep++ * index->entry_size, entry, index->entry_size);
+            } else {
+                memcpy(entries + buffer_size - (size_t)++move * index->entry_size, entry, index->entry_size);
+            }
+        }
+    }
+    uint32_t keep_pages = keep > index->capacity ? (keep + index->capacity - 1) / index->capacity : 1;
+    uint32_t move_pages = move > index->capacity ? (move + index->capacity - 1) / index->capacity : 1;
+    BufferFrame* new_frames[DISK_HASH_INDEX_MAX_CHAIN];
+    new_frames[0] = new_frame;
+    for (uint32_t i = 1; i < move_pages; i++) {
+        new_frames[i] = old_frames[keep_pages + i - 1];
+    }
+
+    DiskPageOp op;
+    disk_page_op_init(&op, DISK_HASH_INDEX_MAX_OP_PAGES);
+    if (bucket == 0) {
+        meta->segments[meta->level + 1] = meta->page_count;
+        meta->page_count += round;
+    }
+    meta->split_bucket++;
+    if (meta->split_bucket == round) {
+        meta->split_bucket = 0;
+        meta->level++;
+    }
+    disk_page_op_touch(&index->file, &op, index->file.meta, true);
+
+    disk_hash_fill_chain(index, &op, old_frames, keep_pages, entries, keep);
+    disk_hash_fill_chain(index, &op, new_frames, move_pages, entries + buffer_size - (size_t)move * index->entry_size, move);
+    for (uint32_t i = keep_pages + move_pages - 1; i < old_count; i++) {
+        disk_hash_free_page(index, &op, old_frames[i]);
+    }
+
+    free(entries);
+    buffer_pool_unpin(index->file.pool, new_frame, false);
+    for (uint32_t i = 0; i < old_count; i++) {
+        buffer_pool_unpin(index->file.pool, old_frames[i], false);
+    }
+    return disk_page_op_commit(&index->file, &op);
+}
+
+// 桶已达到页数上限时，直到这个桶被分裂还需要的分裂次数（本轮已经分裂过的桶要等到下一轮）
+static uint64_t disk_hash_splits_until(const DiskHashMetaPage* meta, uint64_t bucket) {
+    uint64_t round = meta->initial_buckets << meta->level;
+    if (bucket >= meta->split_bucket && bucket < round) {
+        return bucket - meta->split_bucket + 1;
+    }
+    return round - meta->split_bucket + bucket + 1;
+}
+
+// 插入：键已存在时原地更新；桶的页面都满时追加溢出页并分裂一个桶。桶已达到页数上限时先分裂
+// 直到这个桶被分裂，之后仍然放不下（条目的哈希值低位都相同）时插入失败
+static bool disk_hash_insert_locked(DiskHashIndex* index, const void* key, uint64_t value) {
+    uint64_t hash = hash64(key, index->key_size, 0);
+    bool split = false;
+    for (;;) {
+        uint64_t bucket = disk_hash_bucket(disk_hash_meta(index), hash);
+        BufferFrame* frames[DISK_HASH_INDEX_MAX_CHAIN];
+        uint32_t count = disk_hash_fetch_chain(index, bucket, frames);
+        if (count == 0) {
+            return false;
+        }
+
+        BufferFrame* target = NULL;
+        for (uint32_t i = 0; i < count && !target; i++) {
+            if (disk_hash_page_search(index, frames[i], key) != UINT32_MAX) {
+                target = frames[i];
+            }
+        }
+        for (uint32_t i = 0; i < count && !target; i++) {
+            if (disk_hash_page(frames[i])->entry_count < index->capacity) {
+                target = frames[i];
+            }
+        }
+
+        DiskPageOp op;
+        disk_page_op_init(&op, DISK_HASH_INDEX_MAX_OP_PAGES);
+        bool extend = !target && count < DISK_HASH_INDEX_MAX_CHAIN;
+        if (extend) {
+            target = disk_hash_alloc_page(index, &op);
+            if (target) {
+                disk_hash_page(frames[count - 1])->next = target->page_id;
+                disk_page_op_touch(&index->file, &op, frames[count - 1], true);
+                buffer_pool_unpin(index->file.pool, target, false);
+            }
+        }
+        if (target) {
+            disk_hash_page_put(index, target, key, value);
+            disk_page_op_entry(&index->file, &op, target, DISK_PAGE_LOG_PUT, key, value);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            buffer_pool_unpin(index->file.pool, frames[i], false);
+        }
+
+        if (target) {
+            // 分裂失败不影响已经完成的插入
+            bool success = disk_page_op_commit(&index->file, &op);
+            if (success && extend) {
+                disk_hash_split(index);
+            }
+            return success;
+        }
+        if (extend || split) {
+            return false;
+        }
+        for (uint64_t i = disk_hash_splits_until(disk_hash_meta(index), bucket); i > 0; i--) {
+            if (!disk_hash_split(index)) {
+                return false;
+            }
+        }
+        split = true;
+    }
+}
+
+static bool disk_hash_delete_locked(DiskHashIndex* index, const void* key) {
+    BufferFrame* frames[DISK_HASH_INDEX_MAX_CHAIN];
+    uint32_t count = disk_hash_fetch_chain(index, disk_hash_bucket(disk_hash_meta(index), hash64(key, index->key_size, 0)), frames);
+    uint32_t found = count;
+    for (uint32_t i = 0; i < count && found == count; i++) {
+        if (disk_hash_page_search(index, frames[i], key) != UINT32_MAX) {
+            found = i;
+        }
+    }
+
+    DiskPageOp op;
+    disk_page_op_init(&op, DISK_HASH_INDEX_MAX_OP_PAGES);
+    if (found < count) {
+        disk_hash_page_remove(index, frames[found], key);
+        // 溢出页删空后从链表中摘除
+        if (found > 0 && disk_hash_page(frames[found])->entry_count == 0) {
+            disk_hash_page(frames[found - 1])->next = disk_hash_page(frames[found])->next;
+            disk_page_op_touch(&index->file, &op, frames[found - 1], true);
+            disk_hash_free_page(index, &op, frames[found]);
+        } else {
+            disk_page_op_entry(&index->file, &op, frames[found], DISK_PAGE_LOG_REMOVE, key, 0);
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        buffer_pool_unpin(index->file.pool, frames[i], false);
+    }
+    return found < count && disk_page_op_commit(&index->file, &op);
+}
+
+// 插入键值对
+bool disk_hash_index_insert(DiskHashIndex* index, const void* key, uint64_t value) {
+    if (!index || !key) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&index->lock);
+    bool success = !index->file.failed && disk_hash_insert_locked(index, key, value);
+    pthread_rwlock_unlock(&index->lock);
+    return success;
+}
+
+// 删除键
+bool disk_hash_index_delete(DiskHashIndex* index, const void* key) {
+    if (!index || !key) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&index->lock);
+    bool success = !index->file.failed && disk_hash_delete_locked(index, key);
+    pthread_rwlock_unlock(&index->lock);
+    return success;
+}
+
+// 查找键
+bool disk_hash_index_find(DiskHashIndex* index, const void* key, uint64_t* value) {
+    if (!index || !key) {
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&index->lock);
+    bool found = false;
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    uint64_t page_id = disk_hash_bucket_page(meta, disk_hash_bucket(meta, hash64(key, index->key_size, 0)));
+    while (page_id != 0 && !found) {
+        BufferFrame* frame = buffer_pool_fetch(index->file.pool, page_id);
+        if (!frame) {
+            break;
+        }
+        uint32_t position = disk_hash_page_search(index, frame, key);
+        if (position != UINT32_MAX) {
+            found = true;
+            if (value) {
+                memcpy(value, disk_hash_entry(index, frame, position) + index->key_size, sizeof(uint64_t));
+            }
+        }
+        page_id = disk_hash_page(frame)->next;
+        buffer_pool_unpin(index->file.pool, frame, false);
+    }
+    pthread_rwlock_unlock(&index->lock);
+    return found;
+}
+
+// 重做桶内的键值修改
+static void disk_hash_index_apply(void* arg, BufferFrame* frame, DiskPageLogType type, const void* key, uint64_t value) {
+    DiskHashIndex* index = (DiskHashIndex*)arg;
+    if (type == DISK_PAGE_LOG_PUT) {
+        disk_hash_page_put(index, frame, key, value);
+    } else {
+        disk_hash_page_remove(index, frame, key);
+    }
+}
+
+// 初始化新索引：元数据页和初始的桶（主页面在第一次写入之前是全零页面）
+static bool disk_hash_index_format(DiskHashIndex* index, uint32_t initial_buckets) {
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    memset(index->file.meta->data, 0, index->file.page_size);
+    meta->header.type = DISK_HASH_PAGE_META;
+    meta->header.magic = DISK_HASH_INDEX_MAGIC;
+    meta->header.version = DISK_HASH_INDEX_FORMAT_VERSION;
+    meta->header.page_size = (uint32_t)index->file.page_size;
+    meta->key_size = (uint32_t)index->key_size;
+    meta->initial_buckets = initial_buckets;
+    meta->segments[0] = DISK_HASH_INDEX_FIRST_BUCKET;
+    meta->page_count = DISK_HASH_INDEX_FIRST_BUCKET + initial_buckets;
+    return disk_page_file_checkpoint(&index->file, false);
+}
+
+// 打开已有索引：校验元数据后按日志恢复
+static bool disk_hash_index_recover(DiskHashIndex* index) {
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    if (meta->header.version != DISK_HASH_INDEX_FORMAT_VERSION || meta->key_size != (uint32_t)index->key_size) {
+        fprintf(stderr, "Disk hash index %s does not match the requested key size\n", index->file.name);
+        return false;
+    }
+    return disk_page_file_recover(&index->file, disk_hash_index_apply, index);
+}
+
+// 打开磁盘哈希索引
+DiskHashIndex* disk_hash_index_open(const DiskHashIndexConfig* config) {
+    if (!config || !config->path) {
+        return NULL;
+    }
+    uint32_t initial_buckets = config->initial_buckets ? config->initial_buckets : DISK_HASH_INDEX_DEFAULT_BUCKETS;
+    if ((initial_buckets & (initial_buckets - 1)) != 0) {
+        return NULL;
+    }
+
+    DiskHashIndex* index = (DiskHashIndex*)malloc(sizeof(DiskHashIndex));
+    if (!index) {
+        return NULL;
+    }
+    memset(index, 0, sizeof(DiskHashIndex));
+    index->key_size = config->key_size ? config->key_size : sizeof(uint64_t);
+    index->entry_size = index->key_size + sizeof(uint64_t);
+
+    // 已有索引沿用创建时的页大小
+    size_t stored_page_size = disk_page_file_stored_page_size(config->path, DISK_HASH_INDEX_MAGIC);
+    size_t page_size = stored_page_size ? stored_page_size :
+                       (config->page_size ? config->page_size : DISK_HASH_INDEX_DEFAULT_PAGE_SIZE);
+    size_t capacity = page_size > sizeof(DiskHashPageHeader) ? (page_size - sizeof(DiskHashPageHeader)) / index->entry_size : 0;
+    if (capacity < 2 || index->key_size > BUFFER_POOL_MAX_PAGE_SIZE / 4 || page_size < sizeof(DiskHashMetaPage)) {
+        fprintf(stderr, "Invalid disk hash index page size %zu for keys of %zu bytes\n", page_size, index->key_size);
+        free(index);
+        return NULL;
+    }
+    index->capacity = (uint32_t)capacity;
+
+    // 写操作期间固定所有修改的页面，帧数至少要能容纳一个操作和一个桶的全部页面
+    uint32_t frames = config->buffer_frames ? config->buffer_frames : DISK_HASH_INDEX_DEFAULT_FRAMES;
+    if (!disk_page_file_open(&index->file, config->path, config->name ? config->name : config->path, "disk hash index",
+                             config->wal, page_size, index->key_size, frames,
+                             DISK_HASH_INDEX_MAX_OP_PAGES + DISK_HASH_INDEX_MAX_CHAIN + 8, DISK_HASH_INDEX_MAX_OP_PAGES)) {
+        free(index);
+        return NULL;
+    }
+    pthread_rwlock_init(&index->lock, NULL);
+
+    bool opened = disk_hash_meta(index)->header.magic == DISK_HASH_INDEX_MAGIC ?
+                  disk_hash_index_recover(index) : disk_hash_index_format(index, initial_buckets);
+    if (!opened) {
+        // 没有打开的索引不做检查点，文件保持原样
+        index->file.failed = true;
+        disk_page_file_close(&index->file);
+        pthread_rwlock_destroy(&index->lock);
+        free(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+// 检查点后关闭
+void disk_hash_index_close(DiskHashIndex* index) {
+    if (!index) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&index->lock);
+    disk_page_file_close(&index->file);
+    pthread_rwlock_unlock(&index->lock);
+
+    pthread_rwlock_destroy(&index->lock);
+    free(index);
+}
+
+// 检查点
+bool disk_hash_index_checkpoint(DiskHashIndex* index) {
+    if (!index) {
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&index->lock);
+    bool success = !index->file.failed && disk_page_file_checkpoint(&index->file, false);
+    pthread_rwlock_unlock(&index->lock);
+    return success;
+}
+
+// 当前桶数
+uint64_t disk_hash_index_bucket_count(DiskHashIndex* index) {
+    if (!index) {
+        return 0;
+    }
+
+    pthread_rwlock_rdlock(&index->lock);
+    DiskHashMetaPage* meta = disk_hash_meta(index);
+    uint64_t count = (meta->initial_buckets << meta->level) + meta->split_bucket;
+    pthread_rwlock_unlock(&index->lock);
+    return count;
+}
+
+// 已分配的页数
+uint64_t disk_hash_index_page_count(DiskHashIndex* index) {
+    if (!index) {
+        return 0;
+    }
+
+    pthread_rwlock_rdlock(&index->lock);
+    uint64_t count = disk_hash_meta(index)->page_count;
+    pthread_rwlock_unlock(&index->lock);
+    return count;
+}
@@ -0,0 +1,83 @@
+#ifndef DISK_HASH_INDEX_H
+#define DISK_HASH_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "disk_page_file.h"
+
+// 磁盘哈希索引（线性哈希）
+// 每个桶是一个定长的主页面加上溢出页链表，通过缓冲池读写。键为定长字节，值为64位整数（通常是行ID）。
+// 桶数从initial_buckets开始逐个增加：每次插入需要新的溢出页时分裂分裂指针指向的桶（只读写这一个桶和
+// 新桶的页面），指针走完一轮后级别加一。桶号由哈希值的低位决定，不需要目录：
+// 同一轮新增的桶的主页面在这一轮开始时一次预留为连续的页号，按桶号直接算出页号，
+// 溢链不长时等值查询只读一个页面。
+// 日志和恢复见disk_page_file.h：分裂和溢出页的分配释放记录页面镜像，桶内的插入删除只记录键值。
+// 并发控制：读操作共享、写操作独占索引级读写锁。
+
+// 默认页大小
+#define DISK_HASH_INDEX_DEFAULT_PAGE_SIZE 4096
+
+// 默认缓冲池帧数
+#define DISK_HASH_INDEX_DEFAULT_FRAMES 1024
+
+// 默认初始桶数
+#define DISK_HASH_INDEX_DEFAULT_BUCKETS 16
+
+// 级别上限（桶数最多为初始桶数乘以2的这个次方）
+#define DISK_HASH_INDEX_MAX_LEVEL 32
+
+// 一个桶最多的页数（主页面和溢出页），限制分裂一次修改的页数
+#define DISK_HASH_INDEX_MAX_CHAIN 8
+
+// 单个写操作最多修改的页数：分裂时原桶的全部页面、新桶的主页面和元数据页
+#define DISK_HASH_INDEX_MAX_OP_PAGES (DISK_HASH_INDEX_MAX_CHAIN + 2)
+
+// 磁盘哈希索引配置
+typedef struct {
+    const char* path; // 页文件路径
+    const char* name; // 日志记录中区分索引的名称
+    size_t key_size; // 键的长度，0表示8字节
+    size_t page_size; // 页大小（2的幂），0表示默认值；打开已有索引时忽略
+    uint32_t initial_buckets; // 初始桶数（2的幂），0表示默认值；打开已有索引时忽略
+    uint32_t buffer_frames; // 缓冲池帧数，0表示默认值
+    WriteAheadLog* wal; // NULL表示不记录日志，只有检查点和关闭时的状态是一致的
+} DiskHashIndexConfig;
+
+// 磁盘哈希索引
+typedef struct {
+    DiskPageFile file; // 页文件、日志和元数据页
+
+    size_t key_size;
+    size_t entry_size; // 键和值
+    uint32_t capacity; // 每个页面的最大条目数
+
+    pthread_rwlock_t lock;
+} DiskHashIndex;
+
+// 打开磁盘哈希索引（文件不存在时创建，存在时按日志恢复）
+DiskHashIndex* disk_hash_index_open(const DiskHashIndexConfig* config);
+
+// 检查点后关闭
+void disk_hash_index_close(DiskHashIndex* index);
+
+// 插入键值对（键已存在时更新值）
+bool disk_hash_index_insert(DiskHashIndex* index, const void* key, uint64_t value);
+
+// 删除键，键不存在时返回false
+bool disk_hash_index_delete(DiskHashIndex* index, const void* key);
+
+// 查找键
+bool disk_hash_index_find(DiskHashIndex* index, const void* key, uint64_t* value);
+
+// 检查点：写回全部脏页，之后恢复时从当前日志位置开始重做
+bool disk_hash_index_checkpoint(DiskHashIndex* index);
+
+// 当前桶数
+uint64_t disk_hash_index_bucket_count(DiskHashIndex* index);
+
+// 已分配的页数（包括预留的桶主页面和空闲页）
+uint64_t disk_hash_index_page_count(DiskHashIndex* index);
+
+#endif // DISK_HASH_INDEX_H
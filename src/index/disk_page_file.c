@@ -0,0 +1,288 @@
+#include "disk_page_file.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 重做时的上下文
+typedef struct {
+    DiskPageFile* file;
+    DiskPageApplyFunc apply;
+    void* arg;
+} DiskPageRedo;
+
+static inline DiskPageMetaHeader* disk_page_meta(DiskPageFile* file) {
+    return (DiskPageMetaHeader*)file->meta->data;
+}
+
+// 读取已有页文件的页大小
+size_t disk_page_file_stored_page_size(const char* path, uint32_t magic) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    DiskPageMetaHeader meta;
+    ssize_t read_size = pread(fd, &meta, sizeof(meta), 0);
+    close(fd);
+    if (read_size != (ssize_t)sizeof(meta) || meta.magic != magic) {
+        return 0;
+    }
+    return meta.page_size;
+}
+
+// 打开页文件
+bool disk_page_file_open(DiskPageFile* file, const char* path, const char* name, const char* kind, WriteAheadLog* wal,
+                         size_t page_size, size_t key_size, uint32_t frames, uint32_t min_frames, uint32_t max_op_pages) {
+    memset(file, 0, sizeof(DiskPageFile));
+    file->name = strdup(name);
+    file->kind = kind;
+    file->wal = wal;
+    file->page_size = page_size;
+    file->key_size = key_size;
+    if (!file->name) {
+        return false;
+    }
+
+    // 单个写操作的全部页面镜像必须能放进一条日志记录
+    size_t max_record = max_op_pages * (sizeof(DiskPageLogEntry) + page_size) +
+                        sizeof(WalRecordHeader) + strlen(file->name) + WAL_ALIGNMENT;
+    if (wal && max_record > wal->capacity) {
+        fprintf(stderr, "WAL buffer is too small for %s pages of %zu bytes\n", kind, page_size);
+        free(file->name);
+        return false;
+    }
+
+    file->pool = buffer_pool_open(path, page_size, frames < min_frames ? min_frames : frames, wal);
+    file->meta = file->pool ? buffer_pool_fetch(file->pool, 0) : NULL;
+    if (!file->meta) {
+        buffer_pool_close(file->pool);
+        free(file->name);
+        return false;
+    }
+
+    // 恢复或格式化完成前还不知道重做起点，保留全部日志
+    wal_add_retainer(wal, &file->retainer, 0);
+    return true;
+}
+
+// 检查点后关闭
+void disk_page_file_close(DiskPageFile* file) {
+    if (!file->failed) {
+        disk_page_file_checkpoint(file, true);
+    }
+    wal_remove_retainer(file->wal, &file->retainer);
+    buffer_pool_unpin(file->pool, file->meta, false);
+    buffer_pool_close(file->pool);
+    free(file->name);
+    file->name = NULL;
+}
+
+// 检查点
+bool disk_page_file_checkpoint(DiskPageFile* file, bool clean) {
+    uint64_t lsn = file->wal ? wal_current_lsn(file->wal) : 0;
+    if (!buffer_pool_flush(file->pool)) {
+        return false;
+    }
+
+    DiskPageMetaHeader* meta = disk_page_meta(file);
+    meta->checkpoint_lsn = lsn;
+    meta->clean = clean;
+    buffer_pool_pin(file->pool, file->meta);
+    buffer_pool_unpin(file->pool, file->meta, true);
+    if (!buffer_pool_flush(file->pool)) {
+        return false;
+    }
+
+    file->checkpoint_lsn = lsn;
+    wal_set_retainer(file->wal, &file->retainer, lsn);
+    return true;
+}
+
+// 重做一条日志记录中本索引的页面修改（页面LSN不小于记录结束LSN的修改已在页面中）
+static bool disk_page_file_redo(const WalRecord* record, void* arg) {
+    DiskPageRedo* redo = (DiskPageRedo*)arg;
+    DiskPageFile* file = redo->file;
+    if (record->type != WAL_RECORD_INDEX_PAGE || record->table_name_length != strlen(file->name) ||
+        memcmp(record->table_name, file->name, record->table_name_length) != 0) {
+        return true;
+    }
+
+    size_t body_size = file->page_size - sizeof(BufferPageHeader);
+    size_t offset = 0;
+    while (offset < record->data_length) {
+        DiskPageLogEntry entry;
+        if (record->data_length - offset < sizeof(entry)) {
+            break;
+        }
+        memcpy(&entry, record->data + offset, sizeof(entry));
+        offset += sizeof(entry);
+        const uint8_t* payload = record->data + offset;
+        bool valid = entry.length <= record->data_length - offset &&
+                     ((entry.type == DISK_PAGE_LOG_IMAGE && entry.length == body_size) ||
+                      (entry.type == DISK_PAGE_LOG_PUT && entry.length == file->key_size + sizeof(uint64_t)) ||
+                      (entry.type == DISK_PAGE_LOG_REMOVE && entry.length == file->key_size));
+        if (!valid) {
+            break;
+        }
+        offset += entry.length;
+
+        BufferFrame* frame = buffer_pool_fetch(file->pool, entry.page_id);
+        if (!frame) {
+            file->failed = true;
+            return false;
+        }
+        BufferPageHeader* header = (BufferPageHeader*)frame->data;
+        if (header->lsn >= record->end_lsn) {
+            buffer_pool_unpin(file->pool, frame, false);
+            continue;
+        }
+
+        if (entry.type == DISK_PAGE_LOG_IMAGE) {
+            memcpy(frame->data + sizeof(BufferPageHeader), payload, body_size);
+        } else {
+            uint64_t value = 0;
+            if (entry.type == DISK_PAGE_LOG_PUT) {
+                memcpy(&value, payload + file->key_size, sizeof(value));
+            }
+            redo->apply(redo->arg, frame, (DiskPageLogType)entry.type, payload, value);
+        }
+        header->lsn = record->end_lsn;
+        buffer_pool_unpin(file->pool, frame, true);
+    }
+
+    if (offset != record->data_length) {
+        fprintf(stderr, "Invalid %s WAL record at LSN %llu\n", file->kind, (unsigned long long)record->lsn);
+    }
+    return true;
+}
+
+// 打开已有索引
+bool disk_page_file_recover(DiskPageFile* file, DiskPageApplyFunc apply, void* arg) {
+    DiskPageMetaHeader* meta = disk_page_meta(file);
+    file->checkpoint_lsn = meta->checkpoint_lsn;
+
+    if (!meta->clean && file->wal) {
+        if (meta->checkpoint_lsn < wal_start_lsn(file->wal)) {
+            fprintf(stderr, "WAL was truncated past the checkpoint of %s %s\n", file->kind, file->name);
+            return false;
+        }
+        DiskPageRedo redo = {file, apply, arg};
+        buffer_pool_set_recovering(file->pool, true);
+        bool replayed = wal_replay(file->wal, meta->checkpoint_lsn, disk_page_file_redo, &redo) && !file->failed;
+        buffer_pool_set_recovering(file->pool, false);
+        if (!replayed) {
+            fprintf(stderr, "Failed to recover %s %s\n", file->kind, file->name);
+            return false;
+        }
+    }
+
+    // 重做的结果写回后，之后的恢复从当前日志位置开始
+    return disk_page_file_checkpoint(file, false);
+}
+
+// 开始写操作
+void disk_page_op_init(DiskPageOp* op, uint32_t limit) {
+    memset(op, 0, sizeof(DiskPageOp));
+    op->limit = limit < DISK_PAGE_OP_MAX_PAGES ? limit : DISK_PAGE_OP_MAX_PAGES;
+}
+
+// 记录修改的页面
+void disk_page_op_touch(DiskPageFile* file, DiskPageOp* op, BufferFrame* frame, bool image) {
+    for (uint32_t i = 0; i < op->count; i++) {
+        if (op->frames[i] == frame) {
+            op->images[i] = op->images[i] || image;
+            return;
+        }
+    }
+    if (op->count == op->limit) {
+        op->overflow = true;
+        return;
+    }
+
+    buffer_pool_pin(file->pool, frame);
+    op->frames[op->count] = frame;
+    op->images[op->count] = image;
+    op->count++;
+}
+
+// 只记录键值的修改
+void disk_page_op_entry(DiskPageFile* file, DiskPageOp* op, BufferFrame* frame, DiskPageLogType type, const void* key, uint64_t value) {
+    disk_page_op_touch(file, op, frame, false);
+    op->entry_page = frame;
+    op->entry_op = type;
+    op->key = key;
+    op->value = value;
+}
+
+static uint8_t* disk_page_log_put_entry(uint8_t* out, DiskPageLogType type, uint64_t page_id, const void* data, size_t length) {
+    DiskPageLogEntry entry = {(uint32_t)type, (uint32_t)length, page_id};
+    memcpy(out, &entry, sizeof(entry));
+    memcpy(out + sizeof(entry), data, length);
+    return out + sizeof(entry) + length;
+}
+
+// 结束写操作
+bool disk_page_op_commit(DiskPageFile* file, DiskPageOp* op) {
+    bool success = !op->overflow;
+    uint64_t lsn = 0;
+
+    // 检查点之后第一次修改的页面记录镜像：页面写回时可能不完整，恢复时由镜像重建
+    for (uint32_t i = 0; i < op->count; i++) {
+        if (((BufferPageHeader*)op->frames[i]->data)->lsn <= file->checkpoint_lsn) {
+            op->images[i] = true;
+        }
+    }
+
+    if (success && file->wal && op->count > 0) {
+        size_t body_size = file->page_size - sizeof(BufferPageHeader);
+        size_t entry_size = file->key_size + (op->entry_op == DISK_PAGE_LOG_PUT ? sizeof(uint64_t) : 0);
+        size_t size = 0;
+        for (uint32_t i = 0; i < op->count; i++) {
+            if (op->images[i]) {
+                size += sizeof(DiskPageLogEntry) + body_size;
+            } else if (op->frames[i] == op->entry_page) {
+                size += sizeof(DiskPageLogEntry) + entry_size;
+            }
+        }
+
+        uint8_t* data = (uint8_t*)malloc(size);
+        if (data) {
+            uint8_t* out = data;
+            for (uint32_t i = 0; i < op->count; i++) {
+                BufferFrame* frame = op->frames[i];
+                if (op->images[i]) {
+                    out = disk_page_log_put_entry(out, DISK_PAGE_LOG_IMAGE, frame->page_id, frame->data + sizeof(BufferPageHeader), body_size);
+                } else if (frame == op->entry_page) {
+                    uint8_t entry[BUFFER_POOL_MAX_PAGE_SIZE / 4 + sizeof(uint64_t)];
+                    memcpy(entry, op->key, file->key_size);
+                    memcpy(entry + file->key_size, &op->value, sizeof(uint64_t));
+                    out = disk_page_log_put_entry(out, op->entry_op, frame->page_id, entry, entry_size);
+                }
+            }
+            lsn = wal_append(file->wal, WAL_RECORD_INDEX_PAGE, 0, file->name, 0, data, size);
+            free(data);
+        }
+        success = lsn != 0;
+    }
+
+    // 没有记录日志的修改不能写回文件，页面留在缓冲池中直到关闭，重启时按日志恢复
+    for (uint32_t i = 0; i < op->count; i++) {
+        if (!success) {
+            buffer_pool_unpin_unlogged(file->pool, op->frames[i]);
+            continue;
+        }
+        if (lsn != 0) {
+            ((BufferPageHeader*)op->frames[i]->data)->lsn = lsn;
+        }
+        buffer_pool_unpin(file->pool, op->frames[i], true);
+    }
+
+    // 内存中的页面已经修改但没有记录日志，继续写入会破坏恢复的正确性
+    if (!success) {
+        file->failed = true;
+        fprintf(stderr, "Failed to log %s %s, index is now read-only\n", file->kind, file->name);
+    }
+    return success;
+}
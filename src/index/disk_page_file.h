@@ -0,0 +1,106 @@
+#ifndef DISK_PAGE_FILE_H
+#define DISK_PAGE_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../storage/buffer_pool.h"
+#include "../storage/wal.h"
+
+// 磁盘索引的页文件
+// 磁盘B+树和磁盘哈希索引共用的页文件、日志和恢复。第0页是元数据页，以DiskPageMetaHeader开头，
+// 始终固定在缓冲池中。每个写操作修改的全部页面在一条WAL_RECORD_INDEX_PAGE日志记录中记录：
+// 结构修改记录页面镜像，单个键的插入删除只记录键值（检查点后第一次修改页面时仍记录镜像，
+// 用于修复不完整写入的页面）。打开时从元数据页中的检查点LSN开始重做日志。
+// 页文件把检查点LSN登记为日志的保留点，与其他模块共用日志时截断不会删除索引重做需要的记录。
+// 日志写入失败后内存中的页面与日志不一致，之后拒绝写操作，页面不再写回，重启时按日志恢复。
+
+// 单个写操作最多修改的页数上限（各索引按自己的结构限制在这个值以内）
+#define DISK_PAGE_OP_MAX_PAGES 64
+
+// 日志记录中的页面修改
+typedef enum {
+    DISK_PAGE_LOG_IMAGE = 1, // 页面镜像（不含缓冲池页头）
+    DISK_PAGE_LOG_PUT,       // 插入或更新（键和值）
+    DISK_PAGE_LOG_REMOVE     // 删除（键）
+} DiskPageLogType;
+
+// 日志记录数据由若干修改依次组成
+typedef struct {
+    uint32_t type; // DiskPageLogType
+    uint32_t length; // 之后数据的字节数
+    uint64_t page_id;
+} DiskPageLogEntry;
+
+// 元数据页的公共头部，之后是各索引自己的字段
+typedef struct {
+    BufferPageHeader page;
+    uint16_t type; // 页面类型
+    uint16_t clean; // 上次关闭时已写回全部页面，之后没有需要重做的日志
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t checkpoint_lsn; // 重做起点
+} DiskPageMetaHeader;
+
+// 重做只记录键值的修改
+typedef void (*DiskPageApplyFunc)(void* arg, BufferFrame* frame, DiskPageLogType type, const void* key, uint64_t value);
+
+// 页文件
+typedef struct {
+    char* name; // 日志记录中区分索引的名称
+    const char* kind; // 出错信息中的索引类型
+    BufferPool* pool;
+    WriteAheadLog* wal;
+    BufferFrame* meta; // 元数据页（始终固定在缓冲池中）
+    size_t page_size;
+    size_t key_size; // 只记录键值的修改中键的长度
+
+    uint64_t checkpoint_lsn; // 最近一次检查点的LSN，之后第一次修改页面时记录镜像
+    WalRetainer retainer; // 日志保留点（打开期间为检查点LSN）
+    bool failed; // 日志写入失败后拒绝写操作
+} DiskPageFile;
+
+// 写操作上下文：修改过的页面各固定一次，操作结束时写一条日志记录后取消固定
+typedef struct {
+    BufferFrame* frames[DISK_PAGE_OP_MAX_PAGES];
+    bool images[DISK_PAGE_OP_MAX_PAGES];
+    uint32_t count;
+    uint32_t limit; // 这个操作最多修改的页数
+    bool overflow;
+    BufferFrame* entry_page; // 只记录键值的页面
+    DiskPageLogType entry_op;
+    const void* key;
+    uint64_t value;
+} DiskPageOp;
+
+// 读取已有页文件的页大小（文件不存在、还没有写入元数据页或magic不符时返回0）
+size_t disk_page_file_stored_page_size(const char* path, uint32_t magic);
+
+// 打开页文件并固定元数据页；max_op_pages个页面的镜像必须能放进一条日志记录，缓冲池帧数至少为min_frames
+bool disk_page_file_open(DiskPageFile* file, const char* path, const char* name, const char* kind, WriteAheadLog* wal,
+                         size_t page_size, size_t key_size, uint32_t frames, uint32_t min_frames, uint32_t max_op_pages);
+
+// 检查点后关闭并释放元数据页；failed时不做检查点（文件中的页面停留在最后一次检查点或写回时的状态）
+void disk_page_file_close(DiskPageFile* file);
+
+// 检查点：先写回全部页面，再持久化新的检查点LSN，元数据页写入之前崩溃时仍从上一个检查点恢复
+bool disk_page_file_checkpoint(DiskPageFile* file, bool clean);
+
+// 打开已有索引（元数据已由调用者校验）：未正常关闭时从检查点开始重做日志，之后做检查点
+bool disk_page_file_recover(DiskPageFile* file, DiskPageApplyFunc apply, void* arg);
+
+// 开始写操作，limit为这个操作最多修改的页数
+void disk_page_op_init(DiskPageOp* op, uint32_t limit);
+
+// 记录修改的页面，image为true时日志中记录页面镜像
+void disk_page_op_touch(DiskPageFile* file, DiskPageOp* op, BufferFrame* frame, bool image);
+
+// 单个键的插入删除只记录键值
+void disk_page_op_entry(DiskPageFile* file, DiskPageOp* op, BufferFrame* frame, DiskPageLogType type, const void* key, uint64_t value);
+
+// 结束写操作：把修改的页面写入一条日志记录，页面LSN设为记录的结束LSN后取消固定。
+// 失败时（包括页数超过上限）页面不再写回，页文件之后拒绝写操作
+bool disk_page_op_commit(DiskPageFile* file, DiskPageOp* op);
+
+#endif // DISK_PAGE_FILE_H
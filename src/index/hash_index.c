@@ -1,55 +1,282 @@
 #include "hash_index.h"
+#include "../util/hash.h"
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-// 哈希函数
-static uint32_t hash_function(const char *key, uint32_t key_size, uint32_t bucket_count) {
-    uint32_t hash = 5381;
-    for (uint32_t i = 0; i < key_size; i++) {
-        hash = ((hash << 5) + hash) + key[i];
+// 控制字节：空和已删除的最高位为1，已用的槽位是哈希值的低7位
+#define HASH_INDEX_EMPTY ((int8_t)-128)
+#define HASH_INDEX_DELETED ((int8_t)-2)
+
+#define HASH_INDEX_NOT_FOUND UINT32_MAX
+#define HASH_INDEX_MIGRATE_SLOTS 64 // 每次插入或删除从旧表迁移的槽位数
+
+// 一组控制字节中等于value的位置，第i位对应组内第i个槽位
+static uint32_t group_match(const int8_t *control, int8_t value) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)control);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < HASH_INDEX_GROUP_SIZE; i++) {
+        mask |= (uint32_t)(control[i] == value) << i;
     }
-    return hash % bucket_count;
+    return mask;
+#endif
 }
 
-// 创建哈希节点
-static hash_node *hash_node_create(const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
-    hash_node *node = (hash_node *)malloc(sizeof(hash_node));
-    if (!node) {
-        return NULL;
+// 一组中空或已删除的位置
+static uint32_t group_match_free(const int8_t *control) {
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)control));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < HASH_INDEX_GROUP_SIZE; i++) {
+        mask |= (uint32_t)(control[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+static bool slot_is_inline(uint32_t key_size, uint32_t value_size) {
+    return (uint64_t)key_size + value_size <= HASH_INDEX_INLINE_SIZE;
+}
+
+static const char *slot_key(const hash_index_slot *slot) {
+    return slot_is_inline(slot->key_size, slot->value_size) ? slot->payload.data : slot->payload.external;
+}
+
+// 设置槽位的键值（occupied表示槽位原来有键值），失败时槽位不变
+static bool slot_set(hash_index_slot *slot, bool occupied, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    char *old_external = occupied && !slot_is_inline(slot->key_size, slot->value_size) ? slot->payload.external : NULL;
+    if (slot_is_inline(key_size, value_size)) {
+        memcpy(slot->payload.data, key, key_size);
+        memcpy(slot->payload.data + key_size, value, value_size);
+    } else {
+        char *external = (char *)malloc((size_t)key_size + value_size);
+        if (!external) {
+            return false;
+        }
+        memcpy(external, key, key_size);
+        memcpy(external + key_size, value, value_size);
+        slot->payload.external = external;
+    }
+    slot->key_size = key_size;
+    slot->value_size = value_size;
+    free(old_external);
+    return true;
+}
+
+static bool table_init(hash_index_table *table, uint32_t capacity) {
+    table->control = (int8_t *)malloc(capacity);
+    table->slots = (hash_index_slot *)malloc(sizeof(hash_index_slot) * (size_t)capacity);
+    if (!table->control || !table->slots) {
+        free(table->control);
+        free(table->slots);
+        return false;
     }
     
-    node->key = (char *)malloc(key_size);
-    if (!node->key) {
-        free(node);
-        return NULL;
+    memset(table->control, HASH_INDEX_EMPTY, capacity);
+    table->capacity = capacity;
+    table->item_count = 0;
+    table->deleted_count = 0;
+    return true;
+}
+
+static void table_free(hash_index_table *table) {
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        hash_index_slot *slot = &table->slots[i];
+        if (table->control[i] >= 0 && !slot_is_inline(slot->key_size, slot->value_size)) {
+            free(slot->payload.external);
+        }
+    }
+    free(table->control);
+    free(table->slots);
+    memset(table, 0, sizeof(hash_index_table));
+}
+
+// 在表中查找键，返回槽位下标
+// 按组做三角数探测（组偏移1、3、6……），组数是2的幂时会访问每个组；遇到有空槽位的组说明键不存在
+static uint32_t table_find(const hash_index_table *table, uint64_t hash, const char *key, uint32_t key_size) {
+    if (table->capacity == 0) {
+        return HASH_INDEX_NOT_FOUND;
     }
-    memcpy(node->key, key, key_size);
-    node->key_size = key_size;
     
-    node->value = (char *)malloc(value_size);
-    if (!node->value) {
-        free(node->key);
-        free(node);
-        return NULL;
+    uint32_t group_mask = table->capacity / HASH_INDEX_GROUP_SIZE - 1;
+    uint32_t group = (uint32_t)(hash >> 7) & group_mask;
+    int8_t tag = (int8_t)(hash & 0x7F);
+    for (uint32_t step = 1; step <= group_mask + 1; step++) {
+        const int8_t *control = table->control + (size_t)group * HASH_INDEX_GROUP_SIZE;
+        for (uint32_t match = group_match(control, tag); match; match &= match - 1) {
+            uint32_t position = group * HASH_INDEX_GROUP_SIZE + (uint32_t)__builtin_ctz(match);
+            const hash_index_slot *slot = &table->slots[position];
+            if (slot->key_size == key_size && memcmp(slot_key(slot), key, key_size) == 0) {
+                return position;
+            }
+        }
+        if (group_match(control, HASH_INDEX_EMPTY)) {
+            return HASH_INDEX_NOT_FOUND;
+        }
+        group = (group + step) & group_mask;
+    }
+    return HASH_INDEX_NOT_FOUND;
+}
+
+// 把槽位放到探测序列上第一个空或已删除的位置（装载率保证有这样的位置）
+static void table_place(hash_index_table *table, uint64_t hash, const hash_index_slot *slot) {
+    uint32_t group_mask = table->capacity / HASH_INDEX_GROUP_SIZE - 1;
+    uint32_t group = (uint32_t)(hash >> 7) & group_mask;
+    uint32_t match = 0;
+    for (uint32_t step = 1; !(match = group_match_free(table->control + (size_t)group * HASH_INDEX_GROUP_SIZE)); step++) {
+        group = (group + step) & group_mask;
     }
-    memcpy(node->value, value, value_size);
-    node->value_size = value_size;
     
-    node->next = NULL;
-    return node;
+    uint32_t position = group * HASH_INDEX_GROUP_SIZE + (uint32_t)__builtin_ctz(match);
+    if (table->control[position] == HASH_INDEX_DELETED) {
+        table->deleted_count--;
+    }
+    table->control[position] = (int8_t)(hash & 0x7F);
+    table->slots[position] = *slot;
+    table->item_count++;
 }
 
-// 销毁哈希节点
-static void hash_node_destroy(hash_node *node) {
-    if (node) {
-        if (node->key) {
-            free(node->key);
+// 清空槽位：组内还有空槽位时没有探测序列经过这个组，可以直接标记为空
+static void table_clear(hash_index_table *table, uint32_t position) {
+    const int8_t *group = table->control + (position & ~(uint32_t)(HASH_INDEX_GROUP_SIZE - 1));
+    if (group_match(group, HASH_INDEX_EMPTY)) {
+        table->control[position] = HASH_INDEX_EMPTY;
+    } else {
+        table->control[position] = HASH_INDEX_DELETED;
+        table->deleted_count++;
+    }
+    table->item_count--;
+}
+
+// 从旧表迁移最多count个槽位，迁移完成后释放旧表
+static void index_migrate(hash_index *index, uint32_t count) {
+    hash_index_table *old = &index->old;
+    while (old->capacity > 0 && count > 0 && index->migrate_position < old->capacity) {
+        uint32_t position = index->migrate_position++;
+        count--;
+        if (old->control[position] < 0) {
+            continue;
         }
-        if (node->value) {
-            free(node->value);
+    
+        // 迁移后的槽位标记为已删除，查找旧表时不会再比较它
+        hash_index_slot *slot = &old->slots[position];
+        table_place(&index->table, hash64(slot_key(slot), slot->key_size, 0), slot);
+        old->control[position] = HASH_INDEX_DELETED;
+        old->item_count--;
+    }
+    if (old->capacity > 0 && index->migrate_position == old->capacity) {
+        table_free(old);
+        index->migrate_position = 0;
+    }
+}
+
+// 分配新表并开始迁移：元素超过容量的7/16时容量翻倍，否则只是清除已删除的槽位
+static bool index_resize(hash_index *index) {
+    index_migrate(index, UINT32_MAX);
+    
+    uint32_t capacity = index->table.capacity;
+    if ((uint64_t)index->table.item_count * 16 > (uint64_t)capacity * 7) {
+        if (capacity > UINT32_MAX / 2) {
+            return false;
         }
-        free(node);
+        capacity *= 2;
+    }
+    
+    hash_index_table table;
+    if (!table_init(&table, capacity)) {
+        return false;
+    }
+    index->old = index->table;
+    index->table = table;
+    index->migrate_position = 0;
+    return true;
+}
+
+// 查找键所在的表和槽位
+static hash_index_table *index_find(hash_index *index, uint64_t hash, const char *key, uint32_t key_size, uint32_t *position) {
+    *position = table_find(&index->table, hash, key, key_size);
+    if (*position != HASH_INDEX_NOT_FOUND) {
+        return &index->table;
+    }
+    *position = table_find(&index->old, hash, key, key_size);
+    return *position != HASH_INDEX_NOT_FOUND ? &index->old : NULL;
+}
+
+// 初始化容量不小于bucket_count的索引
+static bool index_init(hash_index *index, uint32_t bucket_count) {
+    memset(index, 0, sizeof(hash_index));
+    uint32_t capacity = HASH_INDEX_GROUP_SIZE;
+    while (capacity < bucket_count && capacity <= UINT32_MAX / 4) {
+        capacity *= 2;
+    }
+    return table_init(&index->table, capacity);
+}
+
+static void index_free(hash_index *index) {
+    table_free(&index->table);
+    table_free(&index->old);
+}
+
+// 插入键值对，已存在时原地更新（可能还在旧表中）
+static bool index_insert(hash_index *index, uint64_t hash, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    uint32_t position;
+    hash_index_table *table = index_find(index, hash, key, key_size, &position);
+    if (table) {
+        return slot_set(&table->slots[position], true, key, key_size, value, value_size);
+    }
+    
+    table = &index->table;
+    if ((uint64_t)(table->item_count + table->deleted_count + 1) * 8 > (uint64_t)table->capacity * 7 && !index_resize(index)) {
+        return false;
+    }
+    hash_index_slot slot;
+    if (!slot_set(&slot, false, key, key_size, value, value_size)) {
+        return false;
+    }
+    table_place(&index->table, hash, &slot);
+    index_migrate(index, HASH_INDEX_MIGRATE_SLOTS);
+    
+    return true;
+}
+
+// 查询键值对，返回值的副本
+static char *index_get(hash_index *index, uint64_t hash, const char *key, uint32_t key_size, uint32_t *value_size) {
+    uint32_t position;
+    hash_index_table *table = index_find(index, hash, key, key_size, &position);
+    if (!table) {
+        return NULL;
+    }
+    
+    const hash_index_slot *slot = &table->slots[position];
+    *value_size = slot->value_size;
+    char *value = (char *)malloc(slot->value_size ? slot->value_size : 1);
+    if (value) {
+        memcpy(value, slot_key(slot) + slot->key_size, slot->value_size);
+    }
+    return value;
+}
+
+static bool index_delete(hash_index *index, uint64_t hash, const char *key, uint32_t key_size) {
+    uint32_t position;
+    hash_index_table *table = index_find(index, hash, key, key_size, &position);
+    if (!table) {
+        return false;
     }
+    
+    hash_index_slot *slot = &table->slots[position];
+    if (!slot_is_inline(slot->key_size, slot->value_size)) {
+        free(slot->payload.external);
+    }
+    table_clear(table, position);
+    index_migrate(index, HASH_INDEX_MIGRATE_SLOTS);
+    
+    return true;
 }
 
 // 初始化哈希索引
@@ -62,31 +289,18 @@ hash_index *hash_index_create(uint32_t bucket_count) {
     if (!index) {
         return NULL;
     }
-    
-    index->buckets = (hash_node **)calloc(bucket_count, sizeof(hash_node *));
-    if (!index->buckets) {
+    if (!index_init(index, bucket_count)) {
         free(index);
         return NULL;
     }
     
-    index->bucket_count = bucket_count;
-    index->item_count = 0;
-    
     return index;
 }
 
 // 销毁哈希索引
 void hash_index_destroy(hash_index *index) {
     if (index) {
-        for (uint32_t i = 0; i < index->bucket_count; i++) {
-            hash_node *node = index->buckets[i];
-            while (node) {
-                hash_node *next = node->next;
-                hash_node_destroy(node);
-                node = next;
-            }
-        }
-        free(index->buckets);
+        index_free(index);
         free(index);
     }
 }
@@ -96,39 +310,7 @@ bool hash_index_insert(hash_index *index, const char *key, uint32_t key_size, co
     if (!index || !key) {
         return false;
     }
-    
-    // 计算哈希值
-    uint32_t bucket_idx = hash_function(key, key_size, index->bucket_count);
-    
-    // 检查是否已存在
-    hash_node *current = index->buckets[bucket_idx];
-    while (current) {
-        if (current->key_size == key_size && memcmp(current->key, key, key_size) == 0) {
-            // 更新现有值
-            char *new_value = (char *)realloc(current->value, value_size);
-            if (!new_value) {
-                return false;
-            }
-            memcpy(new_value, value, value_size);
-            current->value = new_value;
-            current->value_size = value_size;
-            return true;
-        }
-        current = current->next;
-    }
-    
-    // 创建新节点
-    hash_node *node = hash_node_create(key, key_size, value, value_size);
-    if (!node) {
-        return false;
-    }
-    
-    // 插入到链表头部
-    node->next = index->buckets[bucket_idx];
-    index->buckets[bucket_idx] = node;
-    index->item_count++;
-    
-    return true;
+    return index_insert(index, hash64(key, key_size, 0), key, key_size, value, value_size);
 }
 
 // 查询键值对
@@ -136,62 +318,115 @@ char *hash_index_get(hash_index *index, const char *key, uint32_t key_size, uint
     if (!index || !key) {
         return NULL;
     }
+    return index_get(index, hash64(key, key_size, 0), key, key_size, value_size);
+}
+
+// 删除键值对
+bool hash_index_delete(hash_index *index, const char *key, uint32_t key_size) {
+    if (!index || !key) {
+        return false;
+    }
+    return index_delete(index, hash64(key, key_size, 0), key, key_size);
+}
+
+// 获取哈希索引大小
+uint32_t hash_index_size(hash_index *index) {
+    if (!index) {
+        return 0;
+    }
+    return index->table.item_count + index->old.item_count;
+}
+
+// 并发哈希索引
+// 按哈希值的最高位选择分片（分片内的表使用低位，两者互不相关）
+static hash_index_shard *concurrent_shard(concurrent_hash_index *index, uint64_t hash) {
+    return &index->shards[hash >> (64 - HASH_INDEX_SHARD_BITS)];
+}
+
+concurrent_hash_index *concurrent_hash_index_create(uint32_t bucket_count) {
+    if (bucket_count == 0) {
+        bucket_count = HASH_INDEX_BUCKET_SIZE;
+    }
     
-    // 计算哈希值
-    uint32_t bucket_idx = hash_function(key, key_size, index->bucket_count);
-    
-    // 查找节点
-    hash_node *current = index->buckets[bucket_idx];
-    while (current) {
-        if (current->key_size == key_size && memcmp(current->key, key, key_size) == 0) {
-            *value_size = current->value_size;
-            char *value = (char *)malloc(current->value_size);
-            if (value) {
-                memcpy(value, current->value, current->value_size);
+    concurrent_hash_index *index = (concurrent_hash_index *)malloc(sizeof(concurrent_hash_index));
+    if (!index) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < HASH_INDEX_SHARDS; i++) {
+        if (!index_init(&index->shards[i].index, bucket_count / HASH_INDEX_SHARDS)) {
+            for (uint32_t j = 0; j < i; j++) {
+                pthread_rwlock_destroy(&index->shards[j].lock);
+                index_free(&index->shards[j].index);
             }
-            return value;
+            free(index);
+            return NULL;
         }
-        current = current->next;
+        pthread_rwlock_init(&index->shards[i].lock, NULL);
     }
     
-    return NULL;
+    return index;
 }
 
-// 删除键值对
-bool hash_index_delete(hash_index *index, const char *key, uint32_t key_size) {
+void concurrent_hash_index_destroy(concurrent_hash_index *index) {
+    if (index) {
+        for (uint32_t i = 0; i < HASH_INDEX_SHARDS; i++) {
+            pthread_rwlock_destroy(&index->shards[i].lock);
+            index_free(&index->shards[i].index);
+        }
+        free(index);
+    }
+}
+
+bool concurrent_hash_index_insert(concurrent_hash_index *index, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
     if (!index || !key) {
         return false;
     }
     
-    // 计算哈希值
-    uint32_t bucket_idx = hash_function(key, key_size, index->bucket_count);
-    
-    // 查找并删除节点
-    hash_node *current = index->buckets[bucket_idx];
-    hash_node *prev = NULL;
+    uint64_t hash = hash64(key, key_size, 0);
+    hash_index_shard *shard = concurrent_shard(index, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    bool success = index_insert(&shard->index, hash, key, key_size, value, value_size);
+    pthread_rwlock_unlock(&shard->lock);
+    return success;
+}
+
+char *concurrent_hash_index_get(concurrent_hash_index *index, const char *key, uint32_t key_size, uint32_t *value_size) {
+    if (!index || !key) {
+        return NULL;
+    }
     
-    while (current) {
-        if (current->key_size == key_size && memcmp(current->key, key, key_size) == 0) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                index->buckets[bucket_idx] = current->next;
-            }
-            hash_node_destroy(current);
-            index->item_count--;
-            return true;
-        }
-        prev = current;
-        current = current->next;
+    uint64_t hash = hash64(key, key_size, 0);
+    hash_index_shard *shard = concurrent_shard(index, hash);
+    pthread_rwlock_rdlock(&shard->lock);
+    char *value = index_get(&shard->index, hash, key, key_size, value_size);
+    pthread_rwlock_unlock(&shard->lock);
+    return value;
+}
+
+bool concurrent_hash_index_delete(concurrent_hash_index *index, const char *key, uint32_t key_size) {
+    if (!index || !key) {
+        return false;
     }
     
-    return false;
+    uint64_t hash = hash64(key, key_size, 0);
+    hash_index_shard *shard = concurrent_shard(index, hash);
+    pthread_rwlock_wrlock(&shard->lock);
+    bool success = index_delete(&shard->index, hash, key, key_size);
+    pthread_rwlock_unlock(&shard->lock);
+    return success;
 }
 
-// 获取哈希索引大小
-uint32_t hash_index_size(hash_index *index) {
+uint32_t concurrent_hash_index_size(concurrent_hash_index *index) {
     if (!index) {
         return 0;
     }
-    return index->item_count;
+    
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < HASH_INDEX_SHARDS; i++) {
+        hash_index_shard *shard = &index->shards[i];
+        pthread_rwlock_rdlock(&shard->lock);
+        size += shard->index.table.item_count + shard->index.old.item_count;
+        pthread_rwlock_unlock(&shard->lock);
+    }
+    return size;
 }
@@ -3,27 +3,73 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
 
-// 哈希桶大小
+// 哈希索引
+// 开放寻址：槽位按16个一组，每个槽位有一个控制字节（空、已删除或哈希值的低7位），
+// 查找时一次比较一组的16个控制字节（SSE2），只对控制字节相同的槽位比较键。
+// 键和值合计不超过HASH_INDEX_INLINE_SIZE字节时直接存在槽位中，否则存在一块单独分配的内存中。
+// 已用和已删除的槽位超过7/8时分配新表（元素较多时容量翻倍，否则只清除已删除的槽位），
+// 之后每次插入或删除把旧表的一部分槽位迁移到新表，避免一次性重建造成的停顿；迁移期间查找两个表。
+
+// 并发哈希索引按哈希值的最高位分成HASH_INDEX_SHARDS个分片，每个分片是一个独立的哈希索引和一个读写锁：
+// 查询只持有分片的读锁，不同分片的写入互不阻塞。
+
+// 默认初始容量
 #define HASH_INDEX_BUCKET_SIZE 1024
 
-// 哈希节点结构
-typedef struct hash_node {
-    char *key;
+// 每组的槽位数
+#define HASH_INDEX_GROUP_SIZE 16
+
+// 直接存在槽位中的键值最大字节数
+#define HASH_INDEX_INLINE_SIZE 24
+
+// 槽位
+typedef struct {
     uint32_t key_size;
-    char *value;
     uint32_t value_size;
-    struct hash_node *next;
-} hash_node;
+    union {
+        char data[HASH_INDEX_INLINE_SIZE]; // 键之后是值
+        char *external; // 不能内联时指向键和值
+    } payload;
+} hash_index_slot;
 
-// 哈希索引结构
+// 一个开放寻址表
 typedef struct {
-    hash_node **buckets;
-    uint32_t bucket_count;
+    int8_t *control; // 每个槽位一个控制字节
+    hash_index_slot *slots;
+    uint32_t capacity; // 槽位数，HASH_INDEX_GROUP_SIZE乘以2的幂，0表示没有表
     uint32_t item_count;
+    uint32_t deleted_count;
+} hash_index_table;
+
+// 哈希索引结构
+typedef struct {
+    hash_index_table table;
+    hash_index_table old; // 正在迁移到table的旧表
+    uint32_t migrate_position; // 旧表中下一个要迁移的槽位
 } hash_index;
 
-// 初始化哈希索引
+// 并发哈希索引的分片数
+#define HASH_INDEX_SHARD_BITS 6
+#define HASH_INDEX_SHARDS (1 << HASH_INDEX_SHARD_BITS)
+
+// 缓存行大小
+#define HASH_INDEX_CACHE_LINE 64
+
+// 并发哈希索引的分片，填充到与相邻分片的锁不在同一个缓存行
+typedef struct {
+    pthread_rwlock_t lock;
+    hash_index index;
+    char padding[HASH_INDEX_CACHE_LINE];
+} hash_index_shard;
+
+// 并发哈希索引结构
+typedef struct {
+    hash_index_shard shards[HASH_INDEX_SHARDS];
+} concurrent_hash_index;
+
+// 初始化哈希索引，bucket_count是初始容量（0时使用HASH_INDEX_BUCKET_SIZE）
 hash_index *hash_index_create(uint32_t bucket_count);
 
 // 销毁哈希索引
@@ -41,4 +87,22 @@ bool hash_index_delete(hash_index *index, const char *key, uint32_t key_size);
 // 获取哈希索引大小
 uint32_t hash_index_size(hash_index *index);
 
+// 初始化并发哈希索引，bucket_count是所有分片合计的初始容量（0时使用HASH_INDEX_BUCKET_SIZE）
+concurrent_hash_index *concurrent_hash_index_create(uint32_t bucket_count);
+
+// 销毁并发哈希索引（不能有其他线程正在使用）
+void concurrent_hash_index_destroy(concurrent_hash_index *index);
+
+// 插入键值对（线程安全）
+bool concurrent_hash_index_insert(concurrent_hash_index *index, const char *key, uint32_t key_size, const char *value, uint32_t value_size);
+
+// 查询键值对（线程安全），返回malloc分配的值
+char *concurrent_hash_index_get(concurrent_hash_index *index, const char *key, uint32_t key_size, uint32_t *value_size);
+
+// 删除键值对（线程安全）
+bool concurrent_hash_index_delete(concurrent_hash_index *index, const char *key, uint32_t key_size);
+
+// 获取并发哈希索引大小（并发修改时是近似值）
+uint32_t concurrent_hash_index_size(concurrent_hash_index *index);
+
 #endif // HASH_INDEX_H
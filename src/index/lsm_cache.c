@@ -0,0 +1,237 @@
+#include "lsm_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LSM_CACHE_INITIAL_BUCKETS 16
+
+static uint32_t cache_hash(uint64_t id, uint64_t offset) {
+    uint64_t h = id * 0x9E3779B97F4A7C15ULL ^ offset;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return (uint32_t)(h >> 32);
+}
+
+static lsm_cache_shard *cache_shard(lsm_cache *cache, uint32_t hash) {
+    return &cache->shards[cache->shard_bits ? hash >> (32 - cache->shard_bits) : 0];
+}
+
+// LRU链表
+static void lru_remove(lsm_cache_handle *handle) {
+    handle->prev->next = handle->next;
+    handle->next->prev = handle->prev;
+    handle->prev = NULL;
+    handle->next = NULL;
+}
+
+// 追加到最近使用的一端
+static void lru_append(lsm_cache_shard *shard, lsm_cache_handle *handle) {
+    handle->next = &shard->lru;
+    handle->prev = shard->lru.prev;
+    handle->prev->next = handle;
+    handle->next->prev = handle;
+}
+
+// 哈希表
+static lsm_cache_handle **table_find(lsm_cache_shard *shard, uint32_t hash, uint64_t id, uint64_t offset) {
+    lsm_cache_handle **slot = &shard->buckets[hash & (shard->bucket_count - 1)];
+    while (*slot && ((*slot)->hash != hash || (*slot)->id != id || (*slot)->offset != offset)) {
+        slot = &(*slot)->hash_next;
+    }
+    return slot;
+}
+
+// 条目数超过桶数时桶数翻倍（内存不足时保持原来的桶数，只是链变长）
+static void table_grow(lsm_cache_shard *shard) {
+    uint32_t bucket_count = shard->bucket_count * 2;
+    lsm_cache_handle **buckets = (lsm_cache_handle **)calloc(bucket_count, sizeof(lsm_cache_handle *));
+    if (!buckets) {
+        return;
+    }
+    for (uint32_t i = 0; i < shard->bucket_count; i++) {
+        lsm_cache_handle *handle = shard->buckets[i];
+        while (handle) {
+            lsm_cache_handle *next = handle->hash_next;
+            lsm_cache_handle **slot = &buckets[handle->hash & (bucket_count - 1)];
+            handle->hash_next = *slot;
+            *slot = handle;
+            handle = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucket_count = bucket_count;
+}
+
+// 释放一个引用，最后一个引用释放时删除；只剩缓存的引用时放回LRU链表
+static void cache_unref(lsm_cache_shard *shard, lsm_cache_handle *handle) {
+    handle->refs--;
+    if (handle->refs == 0) {
+        handle->deleter(handle->id, handle->offset, handle->value);
+        free(handle);
+    } else if (handle->in_cache && handle->refs == 1) {
+        lru_append(shard, handle);
+    }
+}
+
+// 已从哈希表中移除的条目离开缓存
+static void cache_finish_erase(lsm_cache_shard *shard, lsm_cache_handle *handle) {
+    if (handle->refs == 1) {
+        lru_remove(handle);
+    }
+    handle->in_cache = false;
+    shard->usage -= handle->charge;
+    shard->entry_count--;
+    cache_unref(shard, handle);
+}
+
+lsm_cache *lsm_cache_create(size_t capacity, size_t min_shard_capacity) {
+    lsm_cache *cache = (lsm_cache *)calloc(1, sizeof(lsm_cache));
+    if (!cache) {
+        return NULL;
+    }
+    cache->capacity = capacity;
+    while (cache->shard_bits < LSM_CACHE_SHARD_BITS && (capacity >> (cache->shard_bits + 1)) >= min_shard_capacity) {
+        cache->shard_bits++;
+    }
+
+    size_t shard_capacity = (capacity + (1u << cache->shard_bits) - 1) >> cache->shard_bits;
+    for (uint32_t i = 0; i < LSM_CACHE_SHARDS; i++) {
+        lsm_cache_shard *shard = &cache->shards[i];
+        shard->buckets = (lsm_cache_handle **)calloc(LSM_CACHE_INITIAL_BUCKETS, sizeof(lsm_cache_handle *));
+        if (!shard->buckets) {
+            for (uint32_t j = 0; j < i; j++) {
+                pthread_mutex_destroy(&cache->shards[j].mutex);
+                free(cache->shards[j].buckets);
+            }
+            free(cache);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->mutex, NULL);
+        shard->bucket_count = LSM_CACHE_INITIAL_BUCKETS;
+        shard->capacity = shard_capacity;
+        shard->lru.prev = &shard->lru;
+        shard->lru.next = &shard->lru;
+    }
+    return cache;
+}
+
+void lsm_cache_destroy(lsm_cache *cache) {
+    if (!cache) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < LSM_CACHE_SHARDS; i++) {
+        lsm_cache_shard *shard = &cache->shards[i];
+        for (uint32_t j = 0; j < shard->bucket_count; j++) {
+            lsm_cache_handle *handle = shard->buckets[j];
+            while (handle) {
+                lsm_cache_handle *next = handle->hash_next;
+                handle->deleter(handle->id, handle->offset, handle->value);
+                free(handle);
+                handle = next;
+            }
+        }
+        pthread_mutex_destroy(&shard->mutex);
+        free(shard->buckets);
+    }
+    free(cache);
+}
+
+lsm_cache_handle *lsm_cache_lookup(lsm_cache *cache, uint64_t id, uint64_t offset) {
+    uint32_t hash = cache_hash(id, offset);
+    lsm_cache_shard *shard = cache_shard(cache, hash);
+    pthread_mutex_lock(&shard->mutex);
+    lsm_cache_handle *handle = *table_find(shard, hash, id, offset);
+    if (handle) {
+        if (handle->refs == 1) {
+            lru_remove(handle);
+        }
+        handle->refs++;
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return handle;
+}
+
+lsm_cache_handle *lsm_cache_insert(lsm_cache *cache, uint64_t id, uint64_t offset, void *value, size_t charge,
+                                   lsm_cache_deleter deleter) {
+    lsm_cache_handle *handle = (lsm_cache_handle *)calloc(1, sizeof(lsm_cache_handle));
+    if (!handle) {
+        return NULL;
+    }
+    handle->id = id;
+    handle->offset = offset;
+    handle->value = value;
+    handle->charge = charge;
+    handle->deleter = deleter;
+    handle->hash = cache_hash(id, offset);
+    handle->refs = 2;
+    handle->in_cache = true;
+
+    lsm_cache_shard *shard = cache_shard(cache, handle->hash);
+    pthread_mutex_lock(&shard->mutex);
+    lsm_cache_handle **slot = table_find(shard, handle->hash, id, offset);
+    lsm_cache_handle *old = *slot;
+    if (old) {
+        handle->hash_next = old->hash_next;
+        *slot = handle;
+        cache_finish_erase(shard, old);
+    } else {
+        *slot = handle;
+    }
+    shard->usage += charge;
+    shard->entry_count++;
+    if (shard->entry_count > shard->bucket_count) {
+        table_grow(shard);
+    }
+
+    // 淘汰最久未使用的条目，正在使用的条目不淘汰
+    while (shard->usage > shard->capacity && shard->lru.next != &shard->lru) {
+        lsm_cache_handle *victim = shard->lru.next;
+        *table_find(shard, victim->hash, victim->id, victim->offset) = victim->hash_next;
+        cache_finish_erase(shard, victim);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return handle;
+}
+
+void lsm_cache_release(lsm_cache *cache, lsm_cache_handle *handle) {
+    if (!handle) {
+        return;
+    }
+
+    lsm_cache_shard *shard = cache_shard(cache, handle->hash);
+    pthread_mutex_lock(&shard->mutex);
+    cache_unref(shard, handle);
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void lsm_cache_erase(lsm_cache *cache, uint64_t id, uint64_t offset) {
+    uint32_t hash = cache_hash(id, offset);
+    lsm_cache_shard *shard = cache_shard(cache, hash);
+    pthread_mutex_lock(&shard->mutex);
+    lsm_cache_handle **slot = table_find(shard, hash, id, offset);
+    lsm_cache_handle *handle = *slot;
+    if (handle) {
+        *slot = handle->hash_next;
+        cache_finish_erase(shard, handle);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void lsm_cache_get_stats(lsm_cache *cache, lsm_cache_stats *stats) {
+    memset(stats, 0, sizeof(lsm_cache_stats));
+    stats->capacity = cache->capacity;
+    for (uint32_t i = 0; i < LSM_CACHE_SHARDS; i++) {
+        lsm_cache_shard *shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->usage += shard->usage;
+        stats->entry_count += shard->entry_count;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef LSM_CACHE_H
+#define LSM_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// LSM树的分片LRU缓存
+// 键为(id, offset)，块缓存中是(文件编号, 块偏移)，表缓存中是(文件编号, 0)。
+// 按键的哈希分到最多LSM_CACHE_SHARDS个分片，每个分片有自己的锁、哈希表和LRU链表，容量平均分配；
+// 容量较小时减少分片数，保证每个分片的容量不小于创建时指定的最小值。
+// 查找和插入返回引用计数的句柄，使用者释放之前条目不会被淘汰；只有没有使用者的条目在LRU链表中，
+// 超出容量时从最久未使用的一端淘汰。被淘汰或替换的条目在最后一个使用者释放时才调用删除函数。
+
+#define LSM_CACHE_SHARD_BITS 4
+#define LSM_CACHE_SHARDS (1 << LSM_CACHE_SHARD_BITS)
+
+// 释放条目的值
+typedef void (*lsm_cache_deleter)(uint64_t id, uint64_t offset, void *value);
+
+// 缓存条目
+typedef struct lsm_cache_handle {
+    uint64_t id;
+    uint64_t offset;
+    void *value;
+    size_t charge; // 占用的容量
+    lsm_cache_deleter deleter;
+    uint32_t hash;
+    uint32_t refs; // 在缓存中时缓存持有一个引用，每个使用者一个
+    bool in_cache;
+    struct lsm_cache_handle *hash_next;
+    struct lsm_cache_handle *prev; // LRU链表（只包含没有使用者的条目）
+    struct lsm_cache_handle *next;
+} lsm_cache_handle;
+
+// 缓存分片
+typedef struct {
+    pthread_mutex_t mutex;
+    lsm_cache_handle **buckets;
+    uint32_t bucket_count; // 2的幂
+    uint32_t entry_count;
+    size_t capacity;
+    size_t usage;
+    lsm_cache_handle lru; // 链表头，next是最久未使用的条目
+    uint64_t hits;
+    uint64_t misses;
+} lsm_cache_shard;
+
+typedef struct {
+    lsm_cache_shard shards[LSM_CACHE_SHARDS];
+    uint32_t shard_bits; // 使用前(1 << shard_bits)个分片
+    size_t capacity;
+} lsm_cache;
+
+// 缓存统计
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    size_t usage;
+    size_t capacity;
+    uint32_t entry_count;
+} lsm_cache_stats;
+
+// 创建容量为capacity的缓存，每个分片的容量不小于min_shard_capacity（容量本身更小时只有一个分片）
+lsm_cache *lsm_cache_create(size_t capacity, size_t min_shard_capacity);
+
+// 销毁缓存（所有句柄必须已经释放）
+void lsm_cache_destroy(lsm_cache *cache);
+
+// 查找条目，命中时返回句柄（用完后调用lsm_cache_release）
+lsm_cache_handle *lsm_cache_lookup(lsm_cache *cache, uint64_t id, uint64_t offset);
+
+// 插入条目并返回句柄（替换同一个键的旧条目），失败时返回NULL且不接管value
+lsm_cache_handle *lsm_cache_insert(lsm_cache *cache, uint64_t id, uint64_t offset, void *value, size_t charge,
+                                   lsm_cache_deleter deleter);
+
+// 释放句柄
+void lsm_cache_release(lsm_cache *cache, lsm_cache_handle *handle);
+
+// 从缓存中删除条目（有使用者时在最后一个使用者释放后删除）
+void lsm_cache_erase(lsm_cache *cache, uint64_t id, uint64_t offset);
+
+// 汇总各分片的统计
+void lsm_cache_get_stats(lsm_cache *cache, lsm_cache_stats *stats);
+
+#endif // LSM_CACHE_H
@@ -0,0 +1,438 @@
+#include "lsm_manifest.h"
+#include "../storage/wal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// 版本修改中的字段标记
+#define LSM_EDIT_NEXT_FILE_NUMBER 1
+#define LSM_EDIT_LAST_SEQUENCE 2
+#define LSM_EDIT_POINTER 3
+#define LSM_EDIT_DELETED_FILE 4
+#define LSM_EDIT_NEW_FILE 5
+
+// 记录头：内容长度和CRC32C
+typedef struct {
+    uint32_t size;
+    uint32_t checksum;
+} lsm_manifest_record_header;
+
+// 编码缓冲区
+typedef struct {
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    bool failed;
+} lsm_edit_buffer;
+
+static void edit_buffer_append(lsm_edit_buffer *buffer, const void *data, uint32_t size) {
+    if (buffer->failed) {
+        return;
+    }
+    if (buffer->size + size > buffer->capacity) {
+        uint32_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (capacity < buffer->size + size) {
+            capacity *= 2;
+        }
+        char *new_data = (char *)realloc(buffer->data, capacity);
+        if (!new_data) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = new_data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void edit_buffer_append_tag(lsm_edit_buffer *buffer, uint8_t tag) {
+    edit_buffer_append(buffer, &tag, sizeof(tag));
+}
+
+static void edit_buffer_append_key(lsm_edit_buffer *buffer, const char *key, uint32_t key_size) {
+    edit_buffer_append(buffer, &key_size, sizeof(key_size));
+    edit_buffer_append(buffer, key, key_size);
+}
+
+// 解码游标
+typedef struct {
+    const char *data;
+    const char *limit;
+} lsm_edit_reader;
+
+static bool edit_reader_read(lsm_edit_reader *reader, void *data, uint32_t size) {
+    if ((uint64_t)(reader->limit - reader->data) < size) {
+        return false;
+    }
+    memcpy(data, reader->data, size);
+    reader->data += size;
+    return true;
+}
+
+// 读取键（指向记录内容，不复制）
+static bool edit_reader_read_key(lsm_edit_reader *reader, const char **key, uint32_t *key_size) {
+    if (!edit_reader_read(reader, key_size, sizeof(uint32_t)) ||
+        (uint64_t)(reader->limit - reader->data) < *key_size) {
+        return false;
+    }
+    *key = reader->data;
+    reader->data += *key_size;
+    return true;
+}
+
+static char *copy_key(const char *key, uint32_t key_size) {
+    char *copy = (char *)malloc(key_size ? key_size : 1);
+    if (copy && key_size) {
+        memcpy(copy, key, key_size);
+    }
+    return copy;
+}
+
+void lsm_version_edit_init(lsm_version_edit *edit) {
+    memset(edit, 0, sizeof(lsm_version_edit));
+}
+
+void lsm_version_edit_clear(lsm_version_edit *edit) {
+    for (uint32_t i = 0; i < edit->new_file_count; i++) {
+        free(edit->new_files[i].min_key);
+        free(edit->new_files[i].max_key);
+    }
+    for (uint32_t i = 0; i < edit->pointer_count; i++) {
+        free(edit->pointers[i].key);
+    }
+    free(edit->new_files);
+    free(edit->deleted_files);
+    free(edit->pointers);
+    lsm_version_edit_init(edit);
+}
+
+bool lsm_version_edit_add_file(lsm_version_edit *edit, uint32_t level, uint64_t file_number, uint64_t file_size,
+                               const char *min_key, uint32_t min_key_size, const char *max_key, uint32_t max_key_size) {
+    lsm_manifest_file *files = (lsm_manifest_file *)realloc(edit->new_files, (edit->new_file_count + 1) * sizeof(lsm_manifest_file));
+    if (!files) {
+        return false;
+    }
+    edit->new_files = files;
+
+    lsm_manifest_file *file = &files[edit->new_file_count];
+    file->level = level;
+    file->file_number = file_number;
+    file->file_size = file_size;
+    file->min_key = copy_key(min_key, min_key_size);
+    file->min_key_size = min_key_size;
+    file->max_key = copy_key(max_key, max_key_size);
+    file->max_key_size = max_key_size;
+    if (!file->min_key || !file->max_key) {
+        free(file->min_key);
+        free(file->max_key);
+        return false;
+    }
+
+    edit->new_file_count++;
+    return true;
+}
+
+bool lsm_version_edit_delete_file(lsm_version_edit *edit, uint32_t level, uint64_t file_number) {
+    lsm_manifest_deleted_file *files = (lsm_manifest_deleted_file *)realloc(edit->deleted_files,
+                                                                            (edit->deleted_file_count + 1) * sizeof(lsm_manifest_deleted_file));
+    if (!files) {
+        return false;
+    }
+    edit->deleted_files = files;
+    files[edit->deleted_file_count].level = level;
+    files[edit->deleted_file_count].file_number = file_number;
+    edit->deleted_file_count++;
+    return true;
+}
+
+bool lsm_version_edit_set_pointer(lsm_version_edit *edit, uint32_t level, const char *key, uint32_t key_size) {
+    lsm_manifest_pointer *pointers = (lsm_manifest_pointer *)realloc(edit->pointers, (edit->pointer_count + 1) * sizeof(lsm_manifest_pointer));
+    if (!pointers) {
+        return false;
+    }
+    edit->pointers = pointers;
+
+    char *copy = copy_key(key, key_size);
+    if (!copy) {
+        return false;
+    }
+    pointers[edit->pointer_count].level = level;
+    pointers[edit->pointer_count].key = copy;
+    pointers[edit->pointer_count].key_size = key_size;
+    edit->pointer_count++;
+    return true;
+}
+
+// 编码版本修改
+static bool version_edit_encode(const lsm_version_edit *edit, lsm_edit_buffer *buffer) {
+    if (edit->has_next_file_number) {
+        edit_buffer_append_tag(buffer, LSM_EDIT_NEXT_FILE_NUMBER);
+        edit_buffer_append(buffer, &edit->next_file_number, sizeof(uint64_t));
+    }
+    if (edit->has_last_sequence) {
+        edit_buffer_append_tag(buffer, LSM_EDIT_LAST_SEQUENCE);
+        edit_buffer_append(buffer, &edit->last_sequence, sizeof(uint64_t));
+    }
+    for (uint32_t i = 0; i < edit->pointer_count; i++) {
+        edit_buffer_append_tag(buffer, LSM_EDIT_POINTER);
+        edit_buffer_append(buffer, &edit->pointers[i].level, sizeof(uint32_t));
+        edit_buffer_append_key(buffer, edit->pointers[i].key, edit->pointers[i].key_size);
+    }
+    for (uint32_t i = 0; i < edit->deleted_file_count; i++) {
+        edit_buffer_append_tag(buffer, LSM_EDIT_DELETED_FILE);
+        edit_buffer_append(buffer, &edit->deleted_files[i].level, sizeof(uint32_t));
+        edit_buffer_append(buffer, &edit->deleted_files[i].file_number, sizeof(uint64_t));
+    }
+    for (uint32_t i = 0; i < edit->new_file_count; i++) {
+        const lsm_manifest_file *file = &edit->new_files[i];
+        edit_buffer_append_tag(buffer, LSM_EDIT_NEW_FILE);
+        edit_buffer_append(buffer, &file->level, sizeof(uint32_t));
+        edit_buffer_append(buffer, &file->file_number, sizeof(uint64_t));
+        edit_buffer_append(buffer, &file->file_size, sizeof(uint64_t));
+        edit_buffer_append_key(buffer, file->min_key, file->min_key_size);
+        edit_buffer_append_key(buffer, file->max_key, file->max_key_size);
+    }
+    return !buffer->failed;
+}
+
+// 解码版本修改（复制键），内容不合法时返回false
+static bool version_edit_decode(lsm_version_edit *edit, const char *data, uint32_t size) {
+    lsm_edit_reader reader = {data, data + size};
+    while (reader.data < reader.limit) {
+        uint8_t tag = 0;
+        uint32_t level = 0;
+        uint64_t file_number = 0;
+        uint64_t file_size = 0;
+        const char *min_key = NULL;
+        const char *max_key = NULL;
+        uint32_t min_key_size = 0;
+        uint32_t max_key_size = 0;
+        bool success = edit_reader_read(&reader, &tag, sizeof(tag));
+        switch (success ? tag : 0) {
+            case LSM_EDIT_NEXT_FILE_NUMBER:
+                success = edit_reader_read(&reader, &edit->next_file_number, sizeof(uint64_t));
+                edit->has_next_file_number = true;
+                break;
+            case LSM_EDIT_LAST_SEQUENCE:
+                success = edit_reader_read(&reader, &edit->last_sequence, sizeof(uint64_t));
+                edit->has_last_sequence = true;
+                break;
+            case LSM_EDIT_POINTER:
+                success = edit_reader_read(&reader, &level, sizeof(uint32_t)) &&
+                          edit_reader_read_key(&reader, &min_key, &min_key_size) &&
+                          lsm_version_edit_set_pointer(edit, level, min_key, min_key_size);
+                break;
+            case LSM_EDIT_DELETED_FILE:
+                success = edit_reader_read(&reader, &level, sizeof(uint32_t)) &&
+                          edit_reader_read(&reader, &file_number, sizeof(uint64_t)) &&
+                          lsm_version_edit_delete_file(edit, level, file_number);
+                break;
+            case LSM_EDIT_NEW_FILE:
+                success = edit_reader_read(&reader, &level, sizeof(uint32_t)) &&
+                          edit_reader_read(&reader, &file_number, sizeof(uint64_t)) &&
+                          edit_reader_read(&reader, &file_size, sizeof(uint64_t)) &&
+                          edit_reader_read_key(&reader, &min_key, &min_key_size) &&
+                          edit_reader_read_key(&reader, &max_key, &max_key_size) &&
+                          lsm_version_edit_add_file(edit, level, file_number, file_size,
+                                                    min_key, min_key_size, max_key, max_key_size);
+                break;
+            default:
+                success = false;
+                break;
+        }
+        if (!success) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 持久化目录项（新建和重命名的文件）
+static bool sync_directory(const char *directory) {
+    int fd = open(directory, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = fsync(fd) == 0;
+    close(fd);
+    return success;
+}
+
+char *lsm_manifest_filename(const char *directory, uint64_t number) {
+    char *filename = (char *)malloc(strlen(directory) + 32);
+    if (!filename) {
+        return NULL;
+    }
+
+    snprintf(filename, strlen(directory) + 32, "%s/MANIFEST-%06llu", directory, (unsigned long long)number);
+    return filename;
+}
+
+// 写入一条记录（不持久化）
+static bool manifest_write_record(lsm_manifest *manifest, const lsm_version_edit *edit) {
+    lsm_edit_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    bool success = version_edit_encode(edit, &buffer);
+
+    lsm_manifest_record_header header;
+    header.size = buffer.size;
+    header.checksum = wal_checksum(0, buffer.data, buffer.size);
+    success = success && fwrite(&header, sizeof(header), 1, manifest->file) == 1 &&
+              (buffer.size == 0 || fwrite(buffer.data, buffer.size, 1, manifest->file) == 1);
+    if (success) {
+        manifest->size += sizeof(header) + buffer.size;
+    }
+
+    free(buffer.data);
+    return success;
+}
+
+// 原子地把CURRENT指向编号为number的MANIFEST
+static bool manifest_set_current(const char *directory, uint64_t number) {
+    size_t length = strlen(directory) + 32;
+    char *temp = (char *)malloc(length);
+    char *current = (char *)malloc(length);
+    bool success = temp && current;
+    if (success) {
+        snprintf(temp, length, "%s/%s.tmp", directory, LSM_MANIFEST_CURRENT);
+        snprintf(current, length, "%s/%s", directory, LSM_MANIFEST_CURRENT);
+
+        FILE *file = fopen(temp, "w");
+        success = file && fprintf(file, "MANIFEST-%06llu\n", (unsigned long long)number) > 0 &&
+                  fflush(file) == 0 && fsync(fileno(file)) == 0;
+        if (file && fclose(file) != 0) {
+            success = false;
+        }
+        success = success && rename(temp, current) == 0 && sync_directory(directory);
+        if (!success) {
+            remove(temp);
+        }
+    }
+
+    free(temp);
+    free(current);
+    return success;
+}
+
+lsm_manifest *lsm_manifest_create(const char *directory, uint64_t number, const lsm_version_edit *snapshot) {
+    lsm_manifest *manifest = (lsm_manifest *)calloc(1, sizeof(lsm_manifest));
+    if (!manifest) {
+        return NULL;
+    }
+
+    manifest->directory = strdup(directory);
+    manifest->filename = lsm_manifest_filename(directory, number);
+    manifest->number = number;
+    manifest->file = manifest->filename ? fopen(manifest->filename, "wb") : NULL;
+    bool success = manifest->directory && manifest->file && manifest_write_record(manifest, snapshot) &&
+                   fflush(manifest->file) == 0 && fsync(fileno(manifest->file)) == 0 &&
+                   manifest_set_current(directory, number);
+    if (!success) {
+        fprintf(stderr, "Failed to create LSM manifest in %s\n", directory);
+        if (manifest->file) {
+            fclose(manifest->file);
+            remove(manifest->filename);
+        }
+        free(manifest->directory);
+        free(manifest->filename);
+        free(manifest);
+        return NULL;
+    }
+
+    return manifest;
+}
+
+bool lsm_manifest_append(lsm_manifest *manifest, const lsm_version_edit *edit) {
+    // 新文件的目录项先于引用它的记录持久化
+    bool success = (edit->new_file_count == 0 || sync_directory(manifest->directory)) &&
+                   manifest_write_record(manifest, edit) &&
+                   fflush(manifest->file) == 0 && fsync(fileno(manifest->file)) == 0;
+    if (!success) {
+        fprintf(stderr, "Failed to append to LSM manifest: %s\n", manifest->filename);
+    }
+    return success;
+}
+
+void lsm_manifest_close(lsm_manifest *manifest) {
+    if (!manifest) {
+        return;
+    }
+
+    fclose(manifest->file);
+    free(manifest->directory);
+    free(manifest->filename);
+    free(manifest);
+}
+
+bool lsm_manifest_recover(const char *directory, lsm_manifest_replay_callback callback, void *arg,
+                          bool *found, uint64_t *number) {
+    *found = false;
+    size_t length = strlen(directory) + 32;
+    char *current = (char *)malloc(length);
+    if (!current) {
+        return false;
+    }
+    snprintf(current, length, "%s/%s", directory, LSM_MANIFEST_CURRENT);
+    FILE *file = fopen(current, "r");
+    free(current);
+    if (!file) {
+        return true;
+    }
+
+    unsigned long long manifest_number = 0;
+    bool success = fscanf(file, "MANIFEST-%llu", &manifest_number) == 1;
+    fclose(file);
+    char *filename = success ? lsm_manifest_filename(directory, manifest_number) : NULL;
+    file = filename ? fopen(filename, "rb") : NULL;
+    if (!file) {
+        fprintf(stderr, "Failed to open LSM manifest named by CURRENT in %s\n", directory);
+        free(filename);
+        return false;
+    }
+    *found = true;
+    *number = manifest_number;
+
+    // 重放到第一条不完整或校验失败的记录（崩溃时正在写入，对应的修改没有生效）
+    char *data = NULL;
+    uint32_t capacity = 0;
+    uint32_t record_count = 0;
+    lsm_manifest_record_header header;
+    while (success && fread(&header, sizeof(header), 1, file) == 1) {
+        if (header.size > capacity) {
+            char *new_data = (char *)realloc(data, header.size);
+            if (!new_data) {
+                success = false;
+                break;
+            }
+            data = new_data;
+            capacity = header.size;
+        }
+        if ((header.size > 0 && fread(data, header.size, 1, file) != 1) ||
+            wal_checksum(0, data, header.size) != header.checksum) {
+            break;
+        }
+
+        lsm_version_edit edit;
+        lsm_version_edit_init(&edit);
+        if (!version_edit_decode(&edit, data, header.size)) {
+            lsm_version_edit_clear(&edit);
+            break;
+        }
+        success = callback(&edit, arg);
+        lsm_version_edit_clear(&edit);
+        record_count++;
+    }
+
+    // 第一条记录是快照，缺少快照的MANIFEST不可用
+    if (success && record_count == 0) {
+        fprintf(stderr, "LSM manifest has no snapshot: %s\n", filename);
+        success = false;
+    }
+
+    free(data);
+    free(filename);
+    fclose(file);
+    return success;
+}
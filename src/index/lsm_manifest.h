@@ -0,0 +1,99 @@
+#ifndef LSM_MANIFEST_H
+#define LSM_MANIFEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// LSM树的MANIFEST日志
+// 每条记录是一次版本修改：新增或删除的SSTable（层、文件编号、大小和键范围）、下一个文件编号、
+// 最后的写入序号和压缩位置。记录格式为[长度][CRC32C][内容]，恢复时遇到不完整的记录即停止。
+// 新的MANIFEST以当前版本的完整快照开头，写完并持久化后通过重命名CURRENT文件原子地切换，
+// 之后旧的MANIFEST可以删除。恢复只需重放一个MANIFEST，不需要扫描SSTable文件。
+
+#define LSM_MANIFEST_CURRENT "CURRENT"
+#define LSM_MANIFEST_MAX_SIZE (1024 * 1024 * 4) // 超过该大小时写入新的快照
+
+// 新增的SSTable
+typedef struct {
+    uint32_t level;
+    uint64_t file_number;
+    uint64_t file_size;
+    char *min_key;
+    uint32_t min_key_size;
+    char *max_key;
+    uint32_t max_key_size;
+} lsm_manifest_file;
+
+// 删除的SSTable
+typedef struct {
+    uint32_t level;
+    uint64_t file_number;
+} lsm_manifest_deleted_file;
+
+// 压缩位置
+typedef struct {
+    uint32_t level;
+    char *key;
+    uint32_t key_size;
+} lsm_manifest_pointer;
+
+// 版本修改
+typedef struct {
+    bool has_next_file_number;
+    uint64_t next_file_number;
+    bool has_last_sequence;
+    uint64_t last_sequence;
+    lsm_manifest_file *new_files;
+    uint32_t new_file_count;
+    lsm_manifest_deleted_file *deleted_files;
+    uint32_t deleted_file_count;
+    lsm_manifest_pointer *pointers;
+    uint32_t pointer_count;
+} lsm_version_edit;
+
+// MANIFEST写入器
+typedef struct {
+    FILE *file;
+    char *directory;
+    char *filename;
+    uint64_t number;
+    uint64_t size; // 已写入的字节数
+} lsm_manifest;
+
+// 恢复回调，返回false终止恢复
+typedef bool (*lsm_manifest_replay_callback)(const lsm_version_edit *edit, void *arg);
+
+// 初始化版本修改
+void lsm_version_edit_init(lsm_version_edit *edit);
+
+// 释放版本修改中的文件和键
+void lsm_version_edit_clear(lsm_version_edit *edit);
+
+// 记录新增的SSTable（复制键）
+bool lsm_version_edit_add_file(lsm_version_edit *edit, uint32_t level, uint64_t file_number, uint64_t file_size,
+                               const char *min_key, uint32_t min_key_size, const char *max_key, uint32_t max_key_size);
+
+// 记录删除的SSTable
+bool lsm_version_edit_delete_file(lsm_version_edit *edit, uint32_t level, uint64_t file_number);
+
+// 记录压缩位置（复制键）
+bool lsm_version_edit_set_pointer(lsm_version_edit *edit, uint32_t level, const char *key, uint32_t key_size);
+
+// 创建编号为number的MANIFEST，写入快照后切换CURRENT
+lsm_manifest *lsm_manifest_create(const char *directory, uint64_t number, const lsm_version_edit *snapshot);
+
+// 追加版本修改并持久化（有新增文件时先持久化目录项）
+bool lsm_manifest_append(lsm_manifest *manifest, const lsm_version_edit *edit);
+
+// 关闭MANIFEST
+void lsm_manifest_close(lsm_manifest *manifest);
+
+// 按CURRENT指向的MANIFEST重放版本修改，没有CURRENT时found为false
+bool lsm_manifest_recover(const char *directory, lsm_manifest_replay_callback callback, void *arg,
+                          bool *found, uint64_t *number);
+
+// 生成MANIFEST文件名
+char *lsm_manifest_filename(const char *directory, uint64_t number);
+
+#endif // LSM_MANIFEST_H
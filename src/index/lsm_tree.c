@@ -3,15 +3,83 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <sched.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 // 内存表操作函数
+static inline char *memtable_node_key(lsm_skiplist_node *node) {
+    return (char *)&node->next[node->height];
+}
+
+static inline char *memtable_node_value(lsm_skiplist_node *node) {
+    return memtable_node_key(node) + node->key_size;
+}
+
+// 从内存池分配（8字节对齐），空间不足时返回NULL
+static void *memtable_allocate(lsm_memtable *memtable, uint64_t size) {
+    size = (size + 7) & ~(uint64_t)7;
+    uint32_t offset = __atomic_load_n(&memtable->size, __ATOMIC_RELAXED);
+    do {
+        if (offset + size > memtable->capacity) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&memtable->size, &offset, offset + (uint32_t)size, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    
+    return memtable->data + offset;
+}
+
+// 随机层数：每升一层的概率为1/4
+static uint32_t memtable_random_height(lsm_memtable *memtable) {
+    uint64_t x = __atomic_add_fetch(&memtable->random_state, 0x9E3779B97F4A7C15ULL, __ATOMIC_RELAXED);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    
+    uint32_t height = 1;
+    while (height < LSM_SKIPLIST_MAX_HEIGHT && (x & 3) == 0) {
+        height++;
+        x >>= 2;
+    }
+    return height;
+}
+
+// 比较节点与(key, sequence)：先按键的字节序，同一个键序号大的在前
+static int memtable_compare(lsm_skiplist_node *node, const char *key, uint32_t key_size, uint64_t sequence) {
+    uint32_t min_size = node->key_size < key_size ? node->key_size : key_size;
+    int cmp = min_size ? memcmp(memtable_node_key(node), key, min_size) : 0;
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (node->key_size != key_size) {
+        return node->key_size < key_size ? -1 : 1;
+    }
+    return (node->sequence < sequence) - (node->sequence > sequence);
+}
+
+// 从before开始在level层查找(key, sequence)的位置：*prev < (key, sequence) <= *next
+static void memtable_find_splice(lsm_skiplist_node *before, int level, const char *key, uint32_t key_size, uint64_t sequence,
+                                 lsm_skiplist_node **prev, lsm_skiplist_node **next) {
+    while (true) {
+        lsm_skiplist_node *after = __atomic_load_n(&before->next[level], __ATOMIC_ACQUIRE);
+        if (!after || memtable_compare(after, key, key_size, sequence) >= 0) {
+            *prev = before;
+            *next = after;
+            return;
+        }
+        before = after;
+    }
+}
+
 static lsm_memtable *memtable_create(uint32_t capacity) {
     lsm_memtable *memtable = (lsm_memtable *)malloc(sizeof(lsm_memtable));
     if (!memtable) {
         return NULL;
     }
     
-    memtable->data = (char *)calloc(1, capacity);
+    memtable->data = (char *)malloc(capacity);
     if (!memtable->data) {
         free(memtable);
         return NULL;
@@ -20,6 +88,20 @@ static lsm_memtable *memtable_create(uint32_t capacity) {
     memtable->size = 0;
     memtable->capacity = capacity;
     memtable->immutable = false;
+    memtable->entry_count = 0;
+    memtable->refs = 1;
+    memtable->random_state = (uint64_t)(uintptr_t)memtable;
+    
+    // 头节点占满所有层
+    memtable->head = (lsm_skiplist_node *)memtable_allocate(memtable, sizeof(lsm_skiplist_node) +
+                                                            LSM_SKIPLIST_MAX_HEIGHT * sizeof(lsm_skiplist_node *));
+    if (!memtable->head) {
+        free(memtable->data);
+        free(memtable);
+        return NULL;
+    }
+    memset(memtable->head, 0, sizeof(lsm_skiplist_node) + LSM_SKIPLIST_MAX_HEIGHT * sizeof(lsm_skiplist_node *));
+    memtable->head->height = LSM_SKIPLIST_MAX_HEIGHT;
     
     return memtable;
 }
@@ -29,167 +111,1384 @@ static void memtable_destroy(lsm_memtable *memtable) {
         if (memtable->data) {
             free(memtable->data);
         }
-        free(memtable);
+        free(memtable);
+    }
+}
+
+static void memtable_ref(lsm_memtable *memtable) {
+    __atomic_add_fetch(&memtable->refs, 1, __ATOMIC_RELAXED);
+}
+
+// 释放引用，最后一个引用释放时销毁内存表
+static void memtable_unref(lsm_memtable *memtable) {
+    if (memtable && __atomic_sub_fetch(&memtable->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        memtable_destroy(memtable);
+    }
+}
+
+// 插入一个版本（可以多个线程并发插入），内存表已满或不可变时返回false
+static bool memtable_put(lsm_memtable *memtable, uint64_t sequence, uint8_t type, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    if (__atomic_load_n(&memtable->immutable, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    
+    uint32_t height = memtable_random_height(memtable);
+    lsm_skiplist_node *node = (lsm_skiplist_node *)memtable_allocate(memtable, sizeof(lsm_skiplist_node) +
+                                                                     height * sizeof(lsm_skiplist_node *) +
+                                                                     (uint64_t)key_size + value_size);
+    if (!node) {
+        return false;
+    }
+    node->sequence = sequence;
+    node->key_size = key_size;
+    node->value_size = value_size;
+    node->height = height;
+    node->type = type;
+    memcpy(memtable_node_key(node), key, key_size);
+    memcpy(memtable_node_value(node), value, value_size);
+    
+    // 自顶向下查找每层的插入位置
+    lsm_skiplist_node *prev[LSM_SKIPLIST_MAX_HEIGHT];
+    lsm_skiplist_node *next[LSM_SKIPLIST_MAX_HEIGHT];
+    lsm_skiplist_node *before = memtable->head;
+    for (int level = LSM_SKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+        memtable_find_splice(before, level, key, key_size, sequence, &prev[level], &next[level]);
+        before = prev[level];
+    }
+    
+    // 自底向上逐层链接：第0层链接后节点即对读者可见，CAS失败说明其他线程在同一位置插入了节点，
+    // 从原来的前驱重新查找（节点不会删除，前驱仍然有效）
+    for (uint32_t level = 0; level < height; level++) {
+        while (true) {
+            __atomic_store_n(&node->next[level], next[level], __ATOMIC_RELAXED);
+            if (__atomic_compare_exchange_n(&prev[level]->next[level], &next[level], node, false,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                break;
+            }
+            memtable_find_splice(prev[level], (int)level, key, key_size, sequence, &prev[level], &next[level]);
+        }
+    }
+    
+    __atomic_fetch_add(&memtable->entry_count, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// 从新到旧把键序号不大于sequence的版本交给callback
+static void memtable_get(lsm_memtable *memtable, const char *key, uint32_t key_size, uint64_t sequence,
+                         sstable_version_callback callback, void *arg) {
+    lsm_skiplist_node *before = memtable->head;
+    lsm_skiplist_node *next = NULL;
+    for (int level = LSM_SKIPLIST_MAX_HEIGHT - 1; level >= 0; level--) {
+        memtable_find_splice(before, level, key, key_size, sequence, &before, &next);
+    }
+    
+    while (next && next->key_size == key_size && memcmp(memtable_node_key(next), key, key_size) == 0) {
+        if (!callback(next->sequence, (uint8_t)next->type, memtable_node_value(next), next->value_size, arg)) {
+            return;
+        }
+        next = __atomic_load_n(&next->next[0], __ATOMIC_ACQUIRE);
+    }
+}
+
+// 按(键, 序号降序)遍历所有版本
+static lsm_skiplist_node *memtable_first(lsm_memtable *memtable) {
+    return __atomic_load_n(&memtable->head->next[0], __ATOMIC_ACQUIRE);
+}
+
+static lsm_skiplist_node *memtable_next(lsm_skiplist_node *node) {
+    return __atomic_load_n(&node->next[0], __ATOMIC_ACQUIRE);
+}
+
+// 树锁
+// 共享加锁前等待独占等待者：读写不断时，切换内存表和替换文件的独占加锁也不会饿死
+static void tree_lock_shared(lsm_tree *tree) {
+    while (__atomic_load_n(&tree->exclusive_waiters, __ATOMIC_ACQUIRE) > 0) {
+        sched_yield();
+    }
+    pthread_rwlock_rdlock(&tree->lock);
+}
+
+static void tree_lock_exclusive(lsm_tree *tree) {
+    __atomic_add_fetch(&tree->exclusive_waiters, 1, __ATOMIC_ACQ_REL);
+    pthread_rwlock_wrlock(&tree->lock);
+    __atomic_sub_fetch(&tree->exclusive_waiters, 1, __ATOMIC_ACQ_REL);
+}
+
+static void tree_unlock(lsm_tree *tree) {
+    pthread_rwlock_unlock(&tree->lock);
+}
+
+// SSTable操作函数
+static char *generate_sstable_filename(const char *base_dir, uint64_t file_number) {
+    char *filename = (char *)malloc(strlen(base_dir) + 32);
+    if (!filename) {
+        return NULL;
+    }
+    
+    snprintf(filename, strlen(base_dir) + 32, "%s/%06llu.sst", base_dir, (unsigned long long)file_number);
+    return filename;
+}
+
+static char *copy_key(const char *key, uint32_t key_size) {
+    char *copy = (char *)malloc(key_size ? key_size : 1);
+    if (copy && key_size) {
+        memcpy(copy, key, key_size);
+    }
+    return copy;
+}
+
+static void sstable_destroy(lsm_sstable_meta *meta) {
+    if (meta) {
+        // 关闭表缓存中的读取器（文件删除前必须关闭，否则映射一直占用磁盘空间）
+        if (meta->table_cache) {
+            lsm_cache_erase(meta->table_cache, meta->file_number, 0);
+        }
+        if (meta->filename) {
+            free(meta->filename);
+        }
+        free(meta->min_key);
+        free(meta->max_key);
+        free(meta);
+    }
+}
+
+static void sstable_ref(lsm_sstable_meta *meta) {
+    __atomic_add_fetch(&meta->refs, 1, __ATOMIC_RELAXED);
+}
+
+// 释放引用，最后一个引用释放时关闭文件，已被压缩替换的文件同时删除
+static void sstable_unref(lsm_sstable_meta *meta) {
+    if (meta && __atomic_sub_fetch(&meta->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (meta->obsolete) {
+            remove(meta->filename);
+        }
+        sstable_destroy(meta);
+    }
+}
+
+static void table_cache_delete(uint64_t id, uint64_t offset, void *value) {
+    (void)id;
+    (void)offset;
+    sstable_reader_close((sstable_reader *)value);
+}
+
+// 从表缓存取得SSTable的读取器，不在缓存中时打开文件；用完后释放句柄
+static lsm_cache_handle *table_acquire(lsm_tree *tree, lsm_sstable_meta *meta) {
+    lsm_cache_handle *handle = lsm_cache_lookup(tree->table_cache, meta->file_number, 0);
+    if (handle) {
+        return handle;
+    }
+    
+    sstable_reader *reader = sstable_reader_open(meta->filename, meta->file_number, tree->block_cache);
+    if (!reader) {
+        fprintf(stderr, "Failed to open LSM SSTable %s\n", meta->filename);
+        return NULL;
+    }
+    handle = lsm_cache_insert(tree->table_cache, meta->file_number, 0, reader, 1, table_cache_delete);
+    if (!handle) {
+        sstable_reader_close(reader);
+    }
+    return handle;
+}
+
+// 打开写好的SSTable并创建元数据，读取器放入表缓存
+static lsm_sstable_meta *sstable_meta_open(lsm_tree *tree, const char *filename, uint64_t file_number, uint32_t level) {
+    lsm_sstable_meta *meta = (lsm_sstable_meta *)calloc(1, sizeof(lsm_sstable_meta));
+    if (!meta) {
+        return NULL;
+    }
+    
+    meta->filename = strdup(filename);
+    meta->file_number = file_number;
+    lsm_cache_handle *table = meta->filename ? table_acquire(tree, meta) : NULL;
+    if (!table) {
+        sstable_destroy(meta);
+        return NULL;
+    }
+    meta->table_cache = tree->table_cache;
+    
+    sstable_reader *reader = (sstable_reader *)table->value;
+    meta->refs = 1;
+    meta->file_size = reader->size;
+    meta->entry_count = (uint32_t)reader->entry_count;
+    meta->level = level;
+    // 元数据中的键范围是用户键（去掉内部键的尾部）
+    bool success = reader->smallest_key_size >= SSTABLE_KEY_TRAILER_SIZE && reader->largest_key_size >= SSTABLE_KEY_TRAILER_SIZE;
+    if (success) {
+        meta->min_key_size = reader->smallest_key_size - SSTABLE_KEY_TRAILER_SIZE;
+        meta->min_key = copy_key(reader->smallest_key, meta->min_key_size);
+        meta->max_key_size = reader->largest_key_size - SSTABLE_KEY_TRAILER_SIZE;
+        meta->max_key = copy_key(reader->largest_key, meta->max_key_size);
+        success = meta->min_key && meta->max_key;
+    }
+    lsm_cache_release(tree->table_cache, table);
+    if (!success) {
+        sstable_destroy(meta);
+        return NULL;
+    }
+    
+    return meta;
+}
+
+// 在可复用的缓冲区中构造内部键
+static bool internal_key_build(char **buffer, uint32_t *capacity, const char *key, uint32_t key_size, uint64_t sequence, uint8_t type) {
+    uint32_t size = key_size + SSTABLE_KEY_TRAILER_SIZE;
+    if (size > *capacity) {
+        char *data = (char *)realloc(*buffer, size);
+        if (!data) {
+            return false;
+        }
+        *buffer = data;
+        *capacity = size;
+    }
+    memcpy(*buffer, key, key_size);
+    sstable_encode_trailer(*buffer, key_size, sequence, type);
+    return true;
+}
+
+// 写入level层的文件使用的压缩算法
+static compression_codec level_compression(const lsm_tree *tree, uint32_t level) {
+    switch (tree->config.compression[level]) {
+        case LSM_COMPRESSION_NONE:
+            return COMPRESSION_NONE;
+        case LSM_COMPRESSION_FAST:
+            return COMPRESSION_FAST;
+        case LSM_COMPRESSION_HIGH:
+            return COMPRESSION_HIGH;
+        default:
+            return level + 1 == LSM_SSTABLE_LEVELS ? COMPRESSION_HIGH : COMPRESSION_FAST;
+    }
+}
+
+static bool flush_memtable_to_sstable(lsm_tree *tree, lsm_memtable *memtable, const char *filename, uint64_t file_number, lsm_sstable_meta **meta) {
+    sstable_builder *builder = sstable_builder_create(filename, tree->config.bloom_bits_per_key, tree->config.partitioned_filters,
+                                                      level_compression(tree, 0));
+    if (!builder) {
+        return false;
+    }
+    
+    // 写入所有版本（快照可能还需要旧版本，由压缩丢弃）
+    char *key = NULL;
+    uint32_t key_capacity = 0;
+    for (lsm_skiplist_node *node = memtable_first(memtable); node; node = memtable_next(node)) {
+        if (!internal_key_build(&key, &key_capacity, memtable_node_key(node), node->key_size, node->sequence, (uint8_t)node->type) ||
+            !sstable_builder_add(builder, key, node->key_size + SSTABLE_KEY_TRAILER_SIZE, memtable_node_value(node), node->value_size)) {
+            free(key);
+            sstable_builder_abandon(builder);
+            return false;
+        }
+    }
+    free(key);
+    if (!sstable_builder_finish(builder)) {
+        return false;
+    }
+    
+    // 创建元数据
+    *meta = sstable_meta_open(tree, filename, file_number, 0);
+    if (!*meta) {
+        remove(filename);
+        return false;
+    }
+    
+    return true;
+}
+
+// 文件的键范围是否与[min_key, max_key]相交
+static bool sstable_overlaps(const lsm_sstable_meta *meta, const char *min_key, uint32_t min_key_size,
+                             const char *max_key, uint32_t max_key_size) {
+    return sstable_compare_keys(meta->max_key, meta->max_key_size, min_key, min_key_size) >= 0 &&
+           sstable_compare_keys(meta->min_key, meta->min_key_size, max_key, max_key_size) <= 0;
+}
+
+// 层操作函数
+// 预留空间，之后插入不会失败
+static bool level_reserve(lsm_tree *tree, uint32_t level, uint32_t extra) {
+    lsm_sstable_meta **files = (lsm_sstable_meta **)realloc(tree->sstables[level],
+                                                            (tree->sstable_counts[level] + extra) * sizeof(lsm_sstable_meta *));
+    if (!files) {
+        return false;
+    }
+    tree->sstables[level] = files;
+    return true;
+}
+
+// 插入文件（调用者已预留空间）：第0层按刷写顺序追加，其他层按最小键排序
+static void level_insert(lsm_tree *tree, uint32_t level, lsm_sstable_meta *meta) {
+    lsm_sstable_meta **files = tree->sstables[level];
+    uint32_t position = tree->sstable_counts[level];
+    while (level > 0 && position > 0 &&
+           sstable_compare_keys(files[position - 1]->min_key, files[position - 1]->min_key_size, meta->min_key, meta->min_key_size) > 0) {
+        files[position] = files[position - 1];
+        position--;
+    }
+    files[position] = meta;
+    meta->level = level;
+    // 写入者不加锁读取第0层文件数
+    __atomic_store_n(&tree->sstable_counts[level], tree->sstable_counts[level] + 1, __ATOMIC_RELAXED);
+}
+
+static void level_remove(lsm_tree *tree, uint32_t level, lsm_sstable_meta *meta) {
+    lsm_sstable_meta **files = tree->sstables[level];
+    for (uint32_t i = 0; i < tree->sstable_counts[level]; i++) {
+        if (files[i] == meta) {
+            memmove(files + i, files + i + 1, (tree->sstable_counts[level] - i - 1) * sizeof(lsm_sstable_meta *));
+            __atomic_store_n(&tree->sstable_counts[level], tree->sstable_counts[level] - 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+// 二分查找第一个最大键不小于key的文件（第1层及以下）
+static uint32_t level_find_file(lsm_sstable_meta **files, uint32_t count, const char *key, uint32_t key_size) {
+    uint32_t left = 0;
+    uint32_t right = count;
+    while (left < right) {
+        uint32_t mid = left + (right - left) / 2;
+        if (sstable_compare_keys(files[mid]->max_key, files[mid]->max_key_size, key, key_size) < 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+static uint64_t level_bytes(lsm_tree *tree, uint32_t level) {
+    uint64_t bytes = 0;
+    for (uint32_t i = 0; i < tree->sstable_counts[level]; i++) {
+        bytes += tree->sstables[level][i]->file_size;
+    }
+    return bytes;
+}
+
+// 第1层的目标大小为LSM_LEVEL_BASE_SIZE，之后每层是上一层的LSM_SSTABLE_RATIO倍
+static uint64_t level_max_bytes(uint32_t level) {
+    uint64_t bytes = LSM_LEVEL_BASE_SIZE;
+    for (uint32_t i = 1; i < level; i++) {
+        bytes *= LSM_SSTABLE_RATIO;
+    }
+    return bytes;
+}
+
+// 键是否可能存在于level之下的层中
+static bool key_in_deeper_levels(lsm_tree *tree, uint32_t level, const char *key, uint32_t key_size) {
+    for (uint32_t i = level + 1; i < LSM_SSTABLE_LEVELS; i++) {
+        for (uint32_t j = 0; j < tree->sstable_counts[i]; j++) {
+            if (sstable_overlaps(tree->sstables[i][j], key, key_size, key, key_size)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// MANIFEST操作函数
+static bool version_edit_add_meta(lsm_version_edit *edit, const lsm_sstable_meta *meta, uint32_t level) {
+    return lsm_version_edit_add_file(edit, level, meta->file_number, meta->file_size,
+                                     meta->min_key, meta->min_key_size, meta->max_key, meta->max_key_size);
+}
+
+// 当前版本的完整快照（调用者持有树锁或没有其他线程）
+static bool version_snapshot(lsm_tree *tree, lsm_version_edit *snapshot) {
+    bool success = true;
+    snapshot->has_next_file_number = true;
+    snapshot->next_file_number = __atomic_load_n(&tree->next_file_number, __ATOMIC_RELAXED);
+    snapshot->has_last_sequence = true;
+    snapshot->last_sequence = __atomic_load_n(&tree->last_sequence, __ATOMIC_RELAXED);
+    for (uint32_t level = 0; level < LSM_SSTABLE_LEVELS; level++) {
+        for (uint32_t i = 0; i < tree->sstable_counts[level]; i++) {
+            success = success && version_edit_add_meta(snapshot, tree->sstables[level][i], level);
+        }
+        if (tree->compact_pointers[level]) {
+            success = success && lsm_version_edit_set_pointer(snapshot, level, tree->compact_pointers[level],
+                                                              tree->compact_pointer_sizes[level]);
+        }
+    }
+    return success;
+}
+
+// 持久化版本修改，之后才能修改内存中的文件列表
+// 调用者持有manifest_mutex（版本修改按应用的顺序记录），不持有树锁
+static bool manifest_log(lsm_tree *tree, lsm_version_edit *edit) {
+    edit->has_next_file_number = true;
+    edit->next_file_number = __atomic_load_n(&tree->next_file_number, __ATOMIC_RELAXED);
+    edit->has_last_sequence = true;
+    edit->last_sequence = __atomic_load_n(&tree->last_sequence, __ATOMIC_RELAXED);
+    return lsm_manifest_append(tree->manifest, edit);
+}
+
+// MANIFEST超过LSM_MANIFEST_MAX_SIZE时写入新的快照并切换（调用者持有manifest_mutex）
+// 失败时继续使用原来的MANIFEST
+static void manifest_checkpoint(lsm_tree *tree) {
+    if (tree->manifest->size < LSM_MANIFEST_MAX_SIZE) {
+        return;
+    }
+    
+    uint64_t number = __atomic_fetch_add(&tree->next_file_number, 1, __ATOMIC_RELAXED);
+    lsm_version_edit snapshot;
+    lsm_version_edit_init(&snapshot);
+    tree_lock_shared(tree);
+    bool success = version_snapshot(tree, &snapshot);
+    tree_unlock(tree);
+    lsm_manifest *manifest = success ? lsm_manifest_create(tree->base_dir, number, &snapshot) : NULL;
+    lsm_version_edit_clear(&snapshot);
+    
+    if (manifest) {
+        remove(tree->manifest->filename);
+        lsm_manifest_close(tree->manifest);
+        tree->manifest = manifest;
+    }
+}
+
+// 恢复状态：重放MANIFEST得到的文件集合
+typedef struct {
+    lsm_tree *tree;
+    lsm_version_edit version; // new_files是当前存在的文件
+} tree_recovery;
+
+static bool recovery_apply(const lsm_version_edit *edit, void *arg) {
+    tree_recovery *recovery = (tree_recovery *)arg;
+    lsm_tree *tree = recovery->tree;
+    lsm_version_edit *version = &recovery->version;
+    
+    // 刷写和压缩的修改可能交错记录，文件编号和序号取最大值
+    if (edit->has_next_file_number && edit->next_file_number > tree->next_file_number) {
+        tree->next_file_number = edit->next_file_number;
+    }
+    if (edit->has_last_sequence && edit->last_sequence > tree->last_sequence) {
+        tree->last_sequence = edit->last_sequence;
+    }
+    
+    for (uint32_t i = 0; i < edit->pointer_count; i++) {
+        const lsm_manifest_pointer *pointer = &edit->pointers[i];
+        char *key = pointer->level < LSM_SSTABLE_LEVELS ? copy_key(pointer->key, pointer->key_size) : NULL;
+        if (!key) {
+            return false;
+        }
+        free(tree->compact_pointers[pointer->level]);
+        tree->compact_pointers[pointer->level] = key;
+        tree->compact_pointer_sizes[pointer->level] = pointer->key_size;
+    }
+    
+    for (uint32_t i = 0; i < edit->deleted_file_count; i++) {
+        const lsm_manifest_deleted_file *deleted = &edit->deleted_files[i];
+        for (uint32_t j = 0; j < version->new_file_count; j++) {
+            lsm_manifest_file *file = &version->new_files[j];
+            if (file->level == deleted->level && file->file_number == deleted->file_number) {
+                free(file->min_key);
+                free(file->max_key);
+                *file = version->new_files[--version->new_file_count];
+                break;
+            }
+        }
+    }
+    
+    for (uint32_t i = 0; i < edit->new_file_count; i++) {
+        const lsm_manifest_file *file = &edit->new_files[i];
+        if (file->level >= LSM_SSTABLE_LEVELS ||
+            !lsm_version_edit_add_file(version, file->level, file->file_number, file->file_size,
+                                       file->min_key, file->min_key_size, file->max_key, file->max_key_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int manifest_file_compare(const void *a, const void *b) {
+    uint64_t x = ((const lsm_manifest_file *)a)->file_number;
+    uint64_t y = ((const lsm_manifest_file *)b)->file_number;
+    return x < y ? -1 : x > y;
+}
+
+static bool tree_has_file(lsm_tree *tree, uint64_t file_number) {
+    for (uint32_t level = 0; level < LSM_SSTABLE_LEVELS; level++) {
+        for (uint32_t i = 0; i < tree->sstable_counts[level]; i++) {
+            if (tree->sstables[level][i]->file_number == file_number) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// 删除不属于当前版本的文件：崩溃前未记录的刷写和压缩输出、已压缩但未删除的输入、旧的MANIFEST
+static void remove_obsolete_files(lsm_tree *tree) {
+    DIR *dir = opendir(tree->base_dir);
+    if (!dir) {
+        return;
+    }
+    
+    size_t length = strlen(tree->base_dir) + 300;
+    char *path = (char *)malloc(length);
+    struct dirent *entry;
+    while (path && (entry = readdir(dir)) != NULL) {
+        unsigned long long number = 0;
+        int consumed = 0;
+        bool obsolete = false;
+        if (sscanf(entry->d_name, "%llu.sst%n", &number, &consumed) == 1 && entry->d_name[consumed] == '\0' && consumed > 4) {
+            obsolete = !tree_has_file(tree, number);
+        } else if (sscanf(entry->d_name, "MANIFEST-%llu%n", &number, &consumed) == 1 && entry->d_name[consumed] == '\0') {
+            obsolete = number != tree->manifest->number;
+        } else if (strcmp(entry->d_name, LSM_MANIFEST_CURRENT ".tmp") == 0) {
+            obsolete = true;
+        }
+        if (obsolete) {
+            snprintf(path, length, "%s/%s", tree->base_dir, entry->d_name);
+            remove(path);
+        }
+    }
+    
+    free(path);
+    closedir(dir);
+}
+
+// 按MANIFEST恢复文件列表并打开SSTable，之后写入新的MANIFEST
+static bool tree_recover(lsm_tree *tree) {
+    tree_recovery recovery;
+    recovery.tree = tree;
+    lsm_version_edit_init(&recovery.version);
+    bool found = false;
+    uint64_t manifest_number = 0;
+    bool success = lsm_manifest_recover(tree->base_dir, recovery_apply, &recovery, &found, &manifest_number);
+    
+    // 第0层按文件编号（刷写顺序）插入，其他层按最小键排序
+    lsm_version_edit *version = &recovery.version;
+    if (version->new_file_count > 0) {
+        qsort(version->new_files, version->new_file_count, sizeof(lsm_manifest_file), manifest_file_compare);
+    }
+    for (uint32_t i = 0; success && i < version->new_file_count; i++) {
+        const lsm_manifest_file *file = &version->new_files[i];
+        char *filename = generate_sstable_filename(tree->base_dir, file->file_number);
+        lsm_sstable_meta *meta = filename ? sstable_meta_open(tree, filename, file->file_number, file->level) : NULL;
+        if (!meta || meta->file_size != file->file_size || !level_reserve(tree, file->level, 1)) {
+            fprintf(stderr, "Failed to open LSM SSTable %s\n", filename ? filename : "");
+            sstable_destroy(meta);
+            success = false;
+        } else {
+            level_insert(tree, file->level, meta);
+        }
+        if (tree->next_file_number <= file->file_number) {
+            tree->next_file_number = file->file_number + 1;
+        }
+        free(filename);
+    }
+    if (found && tree->next_file_number <= manifest_number) {
+        tree->next_file_number = manifest_number + 1;
+    }
+    lsm_version_edit_clear(version);
+    
+    // 每次打开都从快照开始新的MANIFEST，丢弃旧日志和其中不完整的尾部记录
+    if (success) {
+        uint64_t number = tree->next_file_number++;
+        lsm_version_edit snapshot;
+        lsm_version_edit_init(&snapshot);
+        success = version_snapshot(tree, &snapshot) &&
+                  (tree->manifest = lsm_manifest_create(tree->base_dir, number, &snapshot)) != NULL;
+        lsm_version_edit_clear(&snapshot);
+    }
+    if (success) {
+        remove_obsolete_files(tree);
+    }
+    return success;
+}
+
+// 快照操作函数
+// 压缩需要保留的最小读取序号：最早的快照，没有快照时是当前的可见序号
+static uint64_t snapshot_smallest(lsm_tree *tree) {
+    pthread_mutex_lock(&tree->snapshot_mutex);
+    uint64_t sequence = tree->snapshots.next != &tree->snapshots ? tree->snapshots.next->sequence
+                                                                  : __atomic_load_n(&tree->visible_sequence, __ATOMIC_ACQUIRE);
+    pthread_mutex_unlock(&tree->snapshot_mutex);
+    return sequence;
+}
+
+// 合并迭代器函数
+static void merge_input_update(lsm_merge_input *input) {
+    input->valid = false;
+    if (input->memtable) {
+        lsm_skiplist_node *node = input->node;
+        if (node) {
+            input->valid = true;
+            input->key = memtable_node_key(node);
+            input->key_size = node->key_size;
+            input->sequence = node->sequence;
+            input->type = (uint8_t)node->type;
+            input->value = memtable_node_value(node);
+            input->value_size = node->value_size;
+        }
+        return;
+    }
+    
+    if (!input->iterator || !input->iterator->valid) {
+        input->corrupted = input->corrupted || (input->iterator && input->iterator->corrupted);
+        return;
+    }
+    sstable_block_iterator *entry = &input->iterator->block;
+    if (!sstable_decode_trailer(entry->key, entry->key_size, &input->sequence, &input->type)) {
+        input->corrupted = true;
+        return;
+    }
+    input->valid = true;
+    input->key = entry->key;
+    input->key_size = entry->key_size - SSTABLE_KEY_TRAILER_SIZE;
+    input->value = entry->value;
+    input->value_size = entry->value_size;
+}
+
+// 关闭当前文件的迭代器并释放读取器
+static void merge_input_close_file(lsm_merge_input *input) {
+    sstable_iterator_destroy(input->iterator);
+    input->iterator = NULL;
+    if (input->table) {
+        lsm_cache_release(input->tree->table_cache, input->table);
+        input->table = NULL;
+    }
+}
+
+// 打开第index个文件的迭代器
+static bool merge_input_open_file(lsm_merge_input *input, uint32_t index) {
+    merge_input_close_file(input);
+    input->file_index = index;
+    input->table = table_acquire(input->tree, input->files[index]);
+    input->iterator = input->table ? sstable_iterator_create((sstable_reader *)input->table->value) : NULL;
+    if (input->iterator) {
+        input->iterator->fill_cache = input->fill_cache;
+    }
+    input->corrupted = input->corrupted || !input->iterator;
+    return input->iterator != NULL;
+}
+
+// 当前文件读完时移动到之后的文件
+static void merge_input_skip_files(lsm_merge_input *input) {
+    while (!input->iterator->valid && !input->iterator->corrupted && input->file_index + 1 < input->file_count) {
+        if (!merge_input_open_file(input, input->file_index + 1)) {
+            return;
+        }
+        sstable_iterator_seek_first(input->iterator);
+    }
+    merge_input_update(input);
+}
+
+// 定位到第一个用户键不小于key的条目，key为NULL时定位到第一个条目
+static void merge_input_seek(lsm_merge_input *input, const char *key, uint32_t key_size) {
+    input->valid = false;
+    if (input->memtable) {
+        lsm_skiplist_node *before = input->memtable->head;
+        lsm_skiplist_node *next = memtable_first(input->memtable);
+        for (int level = LSM_SKIPLIST_MAX_HEIGHT - 1; key && level >= 0; level--) {
+            memtable_find_splice(before, level, key, key_size, UINT64_MAX, &before, &next);
+        }
+        input->node = next;
+        merge_input_update(input);
+        return;
+    }
+    
+    // 只有第一个最大键不小于key的文件及之后的文件可能包含不小于key的键
+    uint32_t index = key ? level_find_file(input->files, input->file_count, key, key_size) : 0;
+    if (index == input->file_count || !merge_input_open_file(input, index)) {
+        return;
+    }
+    if (!key) {
+        sstable_iterator_seek_first(input->iterator);
+    } else {
+        // 查找键(key, 最大序号)排在该用户键的所有版本之前
+        char *seek_key = NULL;
+        uint32_t seek_key_capacity = 0;
+        if (!internal_key_build(&seek_key, &seek_key_capacity, key, key_size, SSTABLE_MAX_SEQUENCE, SSTABLE_TYPE_SEEK)) {
+            input->corrupted = true;
+            return;
+        }
+        sstable_iterator_seek(input->iterator, seek_key, key_size + SSTABLE_KEY_TRAILER_SIZE);
+        free(seek_key);
+    }
+    merge_input_skip_files(input);
+}
+
+static void merge_input_next(lsm_merge_input *input) {
+    if (input->memtable) {
+        input->node = memtable_next(input->node);
+        merge_input_update(input);
+        return;
+    }
+    sstable_iterator_next(input->iterator);
+    merge_input_skip_files(input);
+}
+
+// 同一个用户键序号大的在前（序号唯一）
+static bool merge_less(lsm_merge_iterator *merge, uint32_t a, uint32_t b) {
+    lsm_merge_input *x = &merge->inputs[a];
+    lsm_merge_input *y = &merge->inputs[b];
+    int cmp = sstable_compare_keys(x->key, x->key_size, y->key, y->key_size);
+    return cmp < 0 || (cmp == 0 && x->sequence > y->sequence);
+}
+
+static void merge_sift_down(lsm_merge_iterator *merge, uint32_t position) {
+    while (true) {
+        uint32_t smallest = position;
+        uint32_t left = position * 2 + 1;
+        uint32_t right = left + 1;
+        if (left < merge->heap_size && merge_less(merge, merge->heap[left], merge->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < merge->heap_size && merge_less(merge, merge->heap[right], merge->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == position) {
+            return;
+        }
+        uint32_t temp = merge->heap[position];
+        merge->heap[position] = merge->heap[smallest];
+        merge->heap[smallest] = temp;
+        position = smallest;
+    }
+}
+
+// 分配count个输入，由调用者逐个初始化；fill_cache为false时读取的数据块不放入块缓存
+static bool merge_create(lsm_merge_iterator *merge, uint32_t count, lsm_tree *tree, bool fill_cache) {
+    memset(merge, 0, sizeof(lsm_merge_iterator));
+    merge->inputs = (lsm_merge_input *)calloc(count ? count : 1, sizeof(lsm_merge_input));
+    merge->heap = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    merge->input_count = count;
+    for (uint32_t i = 0; merge->inputs && i < count; i++) {
+        merge->inputs[i].tree = tree;
+        merge->inputs[i].fill_cache = fill_cache;
+    }
+    return merge->inputs && merge->heap;
+}
+
+static void merge_destroy(lsm_merge_iterator *merge) {
+    for (uint32_t i = 0; merge->inputs && i < merge->input_count; i++) {
+        merge_input_close_file(&merge->inputs[i]);
+    }
+    free(merge->inputs);
+    free(merge->heap);
+    merge->inputs = NULL;
+    merge->heap = NULL;
+}
+
+static void merge_add_memtable(lsm_merge_iterator *merge, uint32_t index, lsm_memtable *memtable) {
+    merge->inputs[index].memtable = memtable;
+}
+
+static void merge_add_files(lsm_merge_iterator *merge, uint32_t index, lsm_sstable_meta **files, uint32_t file_count) {
+    merge->inputs[index].files = files;
+    merge->inputs[index].file_count = file_count;
+}
+
+// 所有输入定位到第一个用户键不小于key的条目后建堆，key为NULL时定位到第一个条目
+static void merge_seek(lsm_merge_iterator *merge, const char *key, uint32_t key_size) {
+    merge->heap_size = 0;
+    for (uint32_t i = 0; i < merge->input_count; i++) {
+        merge_input_seek(&merge->inputs[i], key, key_size);
+        merge->corrupted = merge->corrupted || merge->inputs[i].corrupted;
+        if (merge->inputs[i].valid) {
+            merge->heap[merge->heap_size++] = i;
+        }
+    }
+    for (uint32_t i = merge->heap_size / 2; i-- > 0;) {
+        merge_sift_down(merge, i);
+    }
+}
+
+static lsm_merge_input *merge_top(lsm_merge_iterator *merge) {
+    return merge->heap_size ? &merge->inputs[merge->heap[0]] : NULL;
+}
+
+static void merge_next(lsm_merge_iterator *merge) {
+    lsm_merge_input *input = &merge->inputs[merge->heap[0]];
+    merge_input_next(input);
+    if (!input->valid) {
+        merge->corrupted = merge->corrupted || input->corrupted;
+        merge->heap[0] = merge->heap[--merge->heap_size];
+    }
+    merge_sift_down(merge, 0);
+}
+
+// 压缩操作函数
+// 压缩输出：按LSM_SSTABLE_TARGET_SIZE切分为多个文件
+// 只在用户键变化处切分，同一个键的所有版本在同一个文件中，第1层及以下的文件键范围不重叠
+typedef struct {
+    lsm_tree *tree;
+    uint32_t level;
+    sstable_builder *builder;
+    char *filename;
+    uint64_t file_number;
+    lsm_sstable_meta **files;
+    uint32_t file_count;
+} compaction_output;
+
+static bool compaction_output_finish(compaction_output *output) {
+    if (!output->builder) {
+        return true;
+    }
+    
+    bool success = sstable_builder_finish(output->builder);
+    output->builder = NULL;
+    lsm_sstable_meta *meta = success ? sstable_meta_open(output->tree, output->filename, output->file_number, output->level) : NULL;
+    lsm_sstable_meta **files = meta ? (lsm_sstable_meta **)realloc(output->files, (output->file_count + 1) * sizeof(lsm_sstable_meta *)) : NULL;
+    if (!files) {
+        if (success) {
+            remove(output->filename);
+        }
+        sstable_destroy(meta);
+        free(output->filename);
+        output->filename = NULL;
+        return false;
+    }
+    
+    files[output->file_count++] = meta;
+    output->files = files;
+    free(output->filename);
+    output->filename = NULL;
+    return true;
+}
+
+static bool compaction_output_add(compaction_output *output, const char *key, uint32_t key_size, const char *value, uint32_t value_size,
+                                  bool new_user_key) {
+    if (output->builder && new_user_key && output->builder->offset >= LSM_SSTABLE_TARGET_SIZE &&
+        !compaction_output_finish(output)) {
+        return false;
+    }
+    if (!output->builder) {
+        output->file_number = __atomic_fetch_add(&output->tree->next_file_number, 1, __ATOMIC_RELAXED);
+        output->filename = generate_sstable_filename(output->tree->base_dir, output->file_number);
+        output->builder = output->filename ? sstable_builder_create(output->filename, output->tree->config.bloom_bits_per_key,
+                                                                    output->tree->config.partitioned_filters,
+                                                                    level_compression(output->tree, output->level)) : NULL;
+        if (!output->builder) {
+            free(output->filename);
+            output->filename = NULL;
+            return false;
+        }
+    }
+    
+    return sstable_builder_add(output->builder, key, key_size, value, value_size);
+}
+
+// 放弃压缩，删除已写入的输出文件
+static void compaction_output_abandon(compaction_output *output) {
+    sstable_builder_abandon(output->builder);
+    free(output->filename);
+    for (uint32_t i = 0; i < output->file_count; i++) {
+        remove(output->files[i]->filename);
+        sstable_destroy(output->files[i]);
+    }
+    free(output->files);
+}
+
+// 选择需要压缩的层：第0层按文件数，其他层按大小与目标大小之比，得分最高且不小于1的层
+static int compaction_pick_level(lsm_tree *tree) {
+    double best_score = 1.0;
+    int best_level = -1;
+    for (uint32_t level = 0; level + 1 < LSM_SSTABLE_LEVELS; level++) {
+        double score = level == 0 ? (double)tree->sstable_counts[0] / LSM_L0_COMPACTION_TRIGGER
+                                  : (double)level_bytes(tree, level) / (double)level_max_bytes(level);
+        if (score >= best_score) {
+            best_score = score;
+            best_level = (int)level;
+        }
+    }
+    return best_level;
+}
+
+// 估算待压缩的数据量：达到触发条件时第0层的全部文件，以及其他层超出目标大小的部分
+static uint64_t compaction_pending_bytes(lsm_tree *tree) {
+    uint64_t bytes = tree->sstable_counts[0] >= LSM_L0_COMPACTION_TRIGGER ? level_bytes(tree, 0) : 0;
+    for (uint32_t level = 1; level + 1 < LSM_SSTABLE_LEVELS; level++) {
+        uint64_t size = level_bytes(tree, level);
+        if (size > level_max_bytes(level)) {
+            bytes += size - level_max_bytes(level);
+        }
+    }
+    return bytes;
+}
+
+// 版本修改记录到清单后更新压缩位置（键的所有权从修改转给树）
+static void compaction_apply_pointers(lsm_tree *tree, lsm_version_edit *edit) {
+    for (uint32_t i = 0; i < edit->pointer_count; i++) {
+        lsm_manifest_pointer *pointer = &edit->pointers[i];
+        free(tree->compact_pointers[pointer->level]);
+        tree->compact_pointers[pointer->level] = pointer->key;
+        tree->compact_pointer_sizes[pointer->level] = pointer->key_size;
+        pointer->key = NULL;
+    }
+}
+
+// 选择得分最高的层，把其中的文件与下一层中键范围重叠的文件合并，输出到下一层
+// 选择输入和替换文件时独占树锁，合并期间不持有锁（同一时刻只有一个压缩任务，只有压缩修改第1层及以下）
+static bool compaction_run(lsm_tree *tree) {
+    pthread_mutex_lock(&tree->manifest_mutex);
+    tree_lock_exclusive(tree);
+    int picked = compaction_pick_level(tree);
+    if (picked < 0) {
+        tree_unlock(tree);
+        pthread_mutex_unlock(&tree->manifest_mutex);
+        return true;
+    }
+    uint32_t level = (uint32_t)picked;
+    uint32_t output_level = level + 1;
+    lsm_sstable_meta **files = tree->sstables[level];
+    
+    // 第0层的文件键范围互相重叠，全部参与压缩；其他层从上次压缩的位置之后选一个文件，轮流覆盖整个键空间
+    uint32_t first = 0;
+    uint32_t input_count = tree->sstable_counts[level];
+    if (level > 0) {
+        while (tree->compact_pointers[level] && first < input_count &&
+               sstable_compare_keys(files[first]->min_key, files[first]->min_key_size,
+                                    tree->compact_pointers[level], tree->compact_pointer_sizes[level]) <= 0) {
+            first++;
+        }
+        if (first == input_count) {
+            first = 0;
+        }
+        input_count = 1;
+    }
+    const char *min_key = files[first]->min_key;
+    uint32_t min_key_size = files[first]->min_key_size;
+    const char *max_key = files[first]->max_key;
+    uint32_t max_key_size = files[first]->max_key_size;
+    for (uint32_t i = first + 1; i < first + input_count; i++) {
+        if (sstable_compare_keys(files[i]->min_key, files[i]->min_key_size, min_key, min_key_size) < 0) {
+            min_key = files[i]->min_key;
+            min_key_size = files[i]->min_key_size;
+        }
+        if (sstable_compare_keys(files[i]->max_key, files[i]->max_key_size, max_key, max_key_size) > 0) {
+            max_key = files[i]->max_key;
+            max_key_size = files[i]->max_key_size;
+        }
+    }
+    
+    // 下一层中与键范围重叠的文件（下一层按最小键排序且互不重叠，重叠的文件是连续的）
+    uint32_t next_first = 0;
+    uint32_t next_count = 0;
+    while (next_first < tree->sstable_counts[output_level] &&
+           !sstable_overlaps(tree->sstables[output_level][next_first], min_key, min_key_size, max_key, max_key_size)) {
+        next_first++;
+    }
+    while (next_first + next_count < tree->sstable_counts[output_level] &&
+           sstable_overlaps(tree->sstables[output_level][next_first + next_count], min_key, min_key_size, max_key, max_key_size)) {
+        next_count++;
+    }
+    
+    lsm_version_edit edit;
+    lsm_version_edit_init(&edit);
+    bool success = true;
+    if (level > 0) {
+        // 压缩位置随版本修改一起记录，提交之前失败时下次仍从原位置选择
+        success = lsm_version_edit_set_pointer(&edit, level, max_key, max_key_size);
+        
+        // 下一层没有重叠的文件时直接移动，不重写
+        if (next_count == 0) {
+            lsm_sstable_meta *meta = files[first];
+            success = success && level_reserve(tree, output_level, 1);
+            tree_unlock(tree);
+            
+            success = success && lsm_version_edit_delete_file(&edit, level, meta->file_number) &&
+                      version_edit_add_meta(&edit, meta, output_level) && manifest_log(tree, &edit);
+            if (success) {
+                tree_lock_exclusive(tree);
+                compaction_apply_pointers(tree, &edit);
+                level_remove(tree, level, meta);
+                level_insert(tree, output_level, meta);
+                __atomic_store_n(&tree->pending_compaction_bytes, compaction_pending_bytes(tree), __ATOMIC_RELAXED);
+                tree_unlock(tree);
+                manifest_checkpoint(tree);
+            }
+            pthread_mutex_unlock(&tree->manifest_mutex);
+            lsm_version_edit_clear(&edit);
+            return success;
+        }
+    }
+    
+    // 输入文件：本层和下一层中键范围重叠的文件，本层的每个文件和下一层的连续文件各是一个合并输入
+    uint32_t total = input_count + next_count;
+    lsm_sstable_meta **inputs = (lsm_sstable_meta **)malloc(total * sizeof(lsm_sstable_meta *));
+    lsm_merge_iterator merge;
+    success = merge_create(&merge, input_count + (next_count > 0), tree, false) && success && inputs;
+    for (uint32_t i = 0; success && i < total; i++) {
+        inputs[i] = i < input_count ? files[first + i] : tree->sstables[output_level][next_first + i - input_count];
+        if (i < input_count) {
+            merge_add_files(&merge, i, &inputs[i], 1);
+        }
     }
-}
-
-static bool memtable_put(lsm_memtable *memtable, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
-    if (memtable->immutable || memtable->size + key_size + value_size + 8 > memtable->capacity) {
-        return false;
+    if (success && next_count > 0) {
+        merge_add_files(&merge, input_count, &inputs[input_count], next_count);
     }
+    tree_unlock(tree);
+    pthread_mutex_unlock(&tree->manifest_mutex);
     
-    // 写入键值对（简单实现，实际应该排序）
-    memcpy(memtable->data + memtable->size, &key_size, 4);
-    memcpy(memtable->data + memtable->size + 4, &value_size, 4);
-    memcpy(memtable->data + memtable->size + 8, key, key_size);
-    memcpy(memtable->data + memtable->size + 8 + key_size, value, value_size);
+    compaction_output output;
+    memset(&output, 0, sizeof(output));
+    output.tree = tree;
+    output.level = output_level;
     
-    memtable->size += 8 + key_size + value_size;
-    return true;
-}
-
-static char *memtable_get(lsm_memtable *memtable, const char *key, uint32_t key_size, uint32_t *value_size) {
-    uint32_t offset = 0;
-    while (offset < memtable->size) {
-        uint32_t current_key_size, current_value_size;
-        memcpy(&current_key_size, memtable->data + offset, 4);
-        memcpy(&current_value_size, memtable->data + offset + 4, 4);
+    // 同一个用户键从新到旧处理：比它新的PUT或DELETE对所有快照都可见时，该版本不会再被读到，丢弃；
+    // 所有快照都能看到的DELETE在更深的层中没有旧版本时也丢弃（合并操作数不覆盖旧版本）
+    uint64_t smallest_snapshot = snapshot_smallest(tree);
+    char *last_key = NULL;
+    uint32_t last_key_size = 0;
+    bool has_last_key = false;
+    uint64_t shadow_sequence = 0;
+    bool shadowed = false;
+    char *internal_key = NULL;
+    uint32_t internal_key_capacity = 0;
+    if (success) {
+        merge_seek(&merge, NULL, 0);
+    }
+    lsm_merge_input *top = NULL;
+    while (success && (top = merge_top(&merge)) != NULL) {
+        bool new_user_key = !has_last_key || sstable_compare_keys(top->key, top->key_size, last_key, last_key_size) != 0;
+        if (new_user_key) {
+            char *key = copy_key(top->key, top->key_size);
+            success = key != NULL;
+            free(last_key);
+            last_key = key;
+            last_key_size = top->key_size;
+            has_last_key = true;
+            shadowed = false;
+        }
         
-        if (current_key_size == key_size && memcmp(memtable->data + offset + 8, key, key_size) == 0) {
-            *value_size = current_value_size;
-            char *value = (char *)malloc(current_value_size);
-            if (value) {
-                memcpy(value, memtable->data + offset + 8 + current_key_size, current_value_size);
-            }
-            return value;
+        bool drop = shadowed && shadow_sequence <= smallest_snapshot;
+        if (!drop && top->type == SSTABLE_TYPE_DELETE && top->sequence <= smallest_snapshot) {
+            drop = !key_in_deeper_levels(tree, output_level, top->key, top->key_size);
         }
+        if (top->type != SSTABLE_TYPE_MERGE) {
+            shadowed = true;
+            shadow_sequence = top->sequence;
+        }
+        if (success && !drop) {
+            success = internal_key_build(&internal_key, &internal_key_capacity, top->key, top->key_size, top->sequence, top->type) &&
+                      compaction_output_add(&output, internal_key, top->key_size + SSTABLE_KEY_TRAILER_SIZE,
+                                            top->value, top->value_size, new_user_key);
+        }
+        merge_next(&merge);
+    }
+    success = success && !merge.corrupted;
+    merge_destroy(&merge);
+    free(internal_key);
+    success = success && compaction_output_finish(&output);
+    
+    // 记录版本修改后替换输入文件（查询持有共享锁，替换后没有查询再访问输入文件）
+    for (uint32_t i = 0; success && i < total; i++) {
+        success = lsm_version_edit_delete_file(&edit, inputs[i]->level, inputs[i]->file_number);
+    }
+    for (uint32_t i = 0; success && i < output.file_count; i++) {
+        success = version_edit_add_meta(&edit, output.files[i], output_level);
+    }
+    if (success) {
+        pthread_mutex_lock(&tree->manifest_mutex);
+        tree_lock_exclusive(tree);
+        success = level_reserve(tree, output_level, output.file_count);
+        tree_unlock(tree);
         
-        offset += 8 + current_key_size + current_value_size;
+        success = success && manifest_log(tree, &edit);
+        if (success) {
+            tree_lock_exclusive(tree);
+            compaction_apply_pointers(tree, &edit);
+            for (uint32_t i = 0; i < total; i++) {
+                level_remove(tree, inputs[i]->level, inputs[i]);
+            }
+            for (uint32_t i = 0; i < output.file_count; i++) {
+                level_insert(tree, output_level, output.files[i]);
+            }
+            __atomic_store_n(&tree->pending_compaction_bytes, compaction_pending_bytes(tree), __ATOMIC_RELAXED);
+            tree_unlock(tree);
+            manifest_checkpoint(tree);
+        }
+        pthread_mutex_unlock(&tree->manifest_mutex);
+    }
+    if (success) {
+        // 迭代器可能还在读取输入文件，最后一个引用释放时删除
+        for (uint32_t i = 0; i < total; i++) {
+            inputs[i]->obsolete = true;
+            sstable_unref(inputs[i]);
+        }
+        free(output.files);
+    } else {
+        fprintf(stderr, "Failed to compact LSM level %u\n", level);
+        compaction_output_abandon(&output);
     }
     
-    return NULL;
+    free(inputs);
+    free(last_key);
+    lsm_version_edit_clear(&edit);
+    return success;
 }
 
-// SSTable操作函数
-static char *generate_sstable_filename(const char *base_dir, uint32_t level) {
-    char *filename = (char *)malloc(strlen(base_dir) + 32);
+// 后台任务函数
+// 刷写不可变内存表到第0层（只有刷写任务清除不可变内存表，刷写期间它不会被替换）
+static bool background_flush(lsm_tree *tree) {
+    tree_lock_shared(tree);
+    lsm_memtable *memtable = tree->immutable_memtable;
+    tree_unlock(tree);
+    
+    // 生成SSTable文件名
+    uint64_t file_number = __atomic_fetch_add(&tree->next_file_number, 1, __ATOMIC_RELAXED);
+    char *filename = generate_sstable_filename(tree->base_dir, file_number);
     if (!filename) {
-        return NULL;
+        return false;
     }
     
-    time_t now = time(NULL);
-    snprintf(filename, strlen(base_dir) + 32, "%s/%d_%ld.sst", base_dir, level, now);
-    return filename;
-}
-
-static bool flush_memtable_to_sstable(lsm_memtable *memtable, const char *filename, lsm_sstable_meta **meta) {
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) {
+    // 刷写内存表到SSTable
+    lsm_sstable_meta *meta = NULL;
+    if (!flush_memtable_to_sstable(tree, memtable, filename, file_number, &meta)) {
+        fprintf(stderr, "Failed to flush LSM memtable to %s\n", filename);
+        free(filename);
         return false;
     }
+    free(filename);
     
-    // 写入元数据
-    uint32_t entry_count = 0;
-    uint32_t offset = 0;
-    while (offset < memtable->size) {
-        uint32_t key_size, value_size;
-        memcpy(&key_size, memtable->data + offset, 4);
-        memcpy(&value_size, memtable->data + offset + 4, 4);
-        offset += 8 + key_size + value_size;
-        entry_count++;
-    }
+    // 记录版本修改后将新的SSTable添加到第0层，之后查询不再访问不可变内存表
+    lsm_version_edit edit;
+    lsm_version_edit_init(&edit);
+    pthread_mutex_lock(&tree->manifest_mutex);
+    tree_lock_exclusive(tree);
+    bool success = level_reserve(tree, 0, 1);
+    tree_unlock(tree);
     
-    fwrite(&entry_count, sizeof(uint32_t), 1, fp);
+    success = success && version_edit_add_meta(&edit, meta, 0) && manifest_log(tree, &edit);
+    if (success) {
+        tree_lock_exclusive(tree);
+        level_insert(tree, 0, meta);
+        tree->immutable_memtable = NULL;
+        __atomic_store_n(&tree->pending_compaction_bytes, compaction_pending_bytes(tree), __ATOMIC_RELAXED);
+        tree_unlock(tree);
+        manifest_checkpoint(tree);
+    }
+    pthread_mutex_unlock(&tree->manifest_mutex);
+    lsm_version_edit_clear(&edit);
     
-    // 写入数据
-    fwrite(memtable->data, 1, memtable->size, fp);
-    fclose(fp);
+    if (!success) {
+        remove(meta->filename);
+        sstable_destroy(meta);
+        return false;
+    }
+    memtable_unref(memtable);
+    return true;
+}
+
+// 领取并执行一个后台任务，没有可执行的任务时返回false
+// 刷写优先（不可变内存表阻塞写入），同一时刻最多一个刷写任务和一个压缩任务
+static bool background_work(lsm_tree *tree) {
+    tree_lock_shared(tree);
+    bool flush = tree->immutable_memtable != NULL;
+    bool compact = compaction_pick_level(tree) >= 0;
+    tree_unlock(tree);
     
-    // 创建元数据
-    *meta = (lsm_sstable_meta *)malloc(sizeof(lsm_sstable_meta));
-    if (!*meta) {
+    pthread_mutex_lock(&tree->background_mutex);
+    bool *running = NULL;
+    if (!tree->background_failed && flush && !tree->flush_running) {
+        running = &tree->flush_running;
+    } else if (!tree->background_failed && compact && !tree->compaction_running) {
+        running = &tree->compaction_running;
+    }
+    if (running) {
+        *running = true;
+    }
+    pthread_mutex_unlock(&tree->background_mutex);
+    if (!running) {
         return false;
     }
     
-    (*meta)->filename = strdup(filename);
-    (*meta)->entry_count = entry_count;
-    (*meta)->min_key = 0; // 简化实现
-    (*meta)->max_key = 0; // 简化实现
-    (*meta)->level = 0;
+    bool success = running == &tree->flush_running ? background_flush(tree) : compaction_run(tree);
     
+    pthread_mutex_lock(&tree->background_mutex);
+    *running = false;
+    if (running == &tree->flush_running) {
+        tree->stats.flushes++;
+    } else {
+        tree->stats.compactions++;
+    }
+    if (!success) {
+        // 后台错误之后拒绝写入，避免不可变内存表和第0层无限增长
+        __atomic_store_n(&tree->background_failed, true, __ATOMIC_RELEASE);
+    }
+    tree->background_generation++;
+    pthread_cond_broadcast(&tree->background_cond);
+    pthread_mutex_unlock(&tree->background_mutex);
     return true;
 }
 
-static void sstable_destroy(lsm_sstable_meta *meta) {
-    if (meta) {
-        if (meta->filename) {
-            free(meta->filename);
+static void *background_main(void *arg) {
+    lsm_tree *tree = (lsm_tree *)arg;
+    
+    pthread_mutex_lock(&tree->background_mutex);
+    while (tree->background_running) {
+        uint64_t generation = tree->background_generation;
+        pthread_mutex_unlock(&tree->background_mutex);
+        bool worked = background_work(tree);
+        pthread_mutex_lock(&tree->background_mutex);
+        
+        // 检查任务之后状态没有变化才等待，避免错过唤醒
+        if (!worked && tree->background_running && generation == tree->background_generation) {
+            pthread_cond_wait(&tree->background_cond, &tree->background_mutex);
         }
-        free(meta);
     }
+    pthread_mutex_unlock(&tree->background_mutex);
+    
+    return NULL;
 }
 
-static char *sstable_get(const char *filename, const char *key, uint32_t key_size, uint32_t *value_size) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        return NULL;
+// 通知后台线程有新的任务
+static void background_schedule(lsm_tree *tree) {
+    pthread_mutex_lock(&tree->background_mutex);
+    tree->background_generation++;
+    pthread_cond_broadcast(&tree->background_cond);
+    pthread_mutex_unlock(&tree->background_mutex);
+}
+
+static uint64_t background_generation(lsm_tree *tree) {
+    pthread_mutex_lock(&tree->background_mutex);
+    uint64_t generation = tree->background_generation;
+    pthread_mutex_unlock(&tree->background_mutex);
+    return generation;
+}
+
+// 等待后台状态在generation之后发生变化
+static void background_wait(lsm_tree *tree, uint64_t generation) {
+    pthread_mutex_lock(&tree->background_mutex);
+    while (tree->background_running && generation == tree->background_generation) {
+        pthread_cond_wait(&tree->background_cond, &tree->background_mutex);
     }
+    pthread_mutex_unlock(&tree->background_mutex);
+}
+
+static void background_stop(lsm_tree *tree) {
+    pthread_mutex_lock(&tree->background_mutex);
+    tree->background_running = false;
+    pthread_cond_broadcast(&tree->background_cond);
+    pthread_mutex_unlock(&tree->background_mutex);
     
-    uint32_t entry_count;
-    fread(&entry_count, sizeof(uint32_t), 1, fp);
-    
-    // 简单线性查找，实际应该使用二分查找
-    char *data = (char *)malloc(1024 * 1024); // 简化实现
-    if (!data) {
-        fclose(fp);
-        return NULL;
+    for (uint32_t i = 0; i < tree->background_thread_count; i++) {
+        pthread_join(tree->background_threads[i], NULL);
+    }
+    tree->background_thread_count = 0;
+}
+
+// 第0层文件或待压缩数据超过上限时停止写入，直到后台压缩跟上
+static bool write_should_stop(lsm_tree *tree) {
+    return __atomic_load_n(&tree->sstable_counts[0], __ATOMIC_RELAXED) >= LSM_L0_STOP_TRIGGER ||
+           __atomic_load_n(&tree->pending_compaction_bytes, __ATOMIC_RELAXED) >= LSM_PENDING_COMPACTION_STOP_BYTES;
+}
+
+static bool write_should_slow_down(lsm_tree *tree) {
+    return __atomic_load_n(&tree->sstable_counts[0], __ATOMIC_RELAXED) >= LSM_L0_SLOWDOWN_TRIGGER ||
+           __atomic_load_n(&tree->pending_compaction_bytes, __ATOMIC_RELAXED) >= LSM_PENDING_COMPACTION_SLOWDOWN_BYTES;
+}
+
+// 把已满的活跃内存表切换为不可变内存表，交给后台线程刷写
+// 上一个不可变内存表还没有刷写完或写入需要停止时等待后台任务
+static bool switch_memtable(lsm_tree *tree, lsm_memtable *full) {
+    lsm_memtable *memtable = memtable_create(LSM_MEMTABLE_MAX_SIZE);
+    if (!memtable) {
+        return false;
     }
     
-    size_t data_size = fread(data, 1, 1024 * 1024, fp);
-    fclose(fp);
-    
-    uint32_t offset = 0;
-    while (offset < data_size) {
-        uint32_t current_key_size, current_value_size;
-        memcpy(&current_key_size, data + offset, 4);
-        memcpy(&current_value_size, data + offset + 4, 4);
+    bool stopped = false;
+    while (true) {
+        uint64_t generation = background_generation(tree);
+        if (__atomic_load_n(&tree->background_failed, __ATOMIC_ACQUIRE)) {
+            memtable_destroy(memtable);
+            return false;
+        }
         
-        if (current_key_size == key_size && memcmp(data + offset + 8, key, key_size) == 0) {
-            *value_size = current_value_size;
-            char *value = (char *)malloc(current_value_size);
-            if (value) {
-                memcpy(value, data + offset + 8 + current_key_size, current_value_size);
-            }
-            free(data);
-            return value;
+        tree_lock_exclusive(tree);
+        if (tree->active_memtable != full) {
+            // 其他写入者已经切换
+            tree_unlock(tree);
+            memtable_destroy(memtable);
+            return true;
         }
+        if (!tree->immutable_memtable && !write_should_stop(tree)) {
+            __atomic_store_n(&full->immutable, true, __ATOMIC_RELEASE);
+            tree->immutable_memtable = full;
+            tree->active_memtable = memtable;
+            tree_unlock(tree);
+            break;
+        }
+        tree_unlock(tree);
         
-        offset += 8 + current_key_size + current_value_size;
+        if (!stopped) {
+            stopped = true;
+            pthread_mutex_lock(&tree->background_mutex);
+            tree->stats.write_stops++;
+            pthread_mutex_unlock(&tree->background_mutex);
+        }
+        background_wait(tree, generation);
     }
     
-    free(data);
-    return NULL;
+    background_schedule(tree);
+    return true;
 }
 
 // LSM树核心函数
 lsm_tree *lsm_tree_create(const char *base_dir) {
-    lsm_tree *tree = (lsm_tree *)malloc(sizeof(lsm_tree));
+    return lsm_tree_create_with_config(base_dir, NULL);
+}
+
+lsm_tree *lsm_tree_create_with_config(const char *base_dir, const lsm_tree_config *config) {
+    lsm_tree *tree = (lsm_tree *)calloc(1, sizeof(lsm_tree));
     if (!tree) {
         return NULL;
     }
+    if (config) {
+        tree->config = *config;
+    }
+    if (tree->config.bloom_false_positive_rate > 0) {
+        tree->config.bloom_bits_per_key = blocked_bloom_filter_bits_per_key(tree->config.bloom_false_positive_rate);
+    }
+    tree->block_cache = lsm_cache_create(tree->config.block_cache_size ? tree->config.block_cache_size : LSM_BLOCK_CACHE_SIZE,
+                                         LSM_BLOCK_CACHE_MIN_SHARD_SIZE);
+    tree->table_cache = lsm_cache_create(tree->config.max_open_files ? tree->config.max_open_files : LSM_MAX_OPEN_FILES,
+                                         LSM_TABLE_CACHE_MIN_SHARD_SIZE);
+    pthread_rwlock_init(&tree->lock, NULL);
+    pthread_mutex_init(&tree->background_mutex, NULL);
+    pthread_cond_init(&tree->background_cond, NULL);
+    pthread_mutex_init(&tree->manifest_mutex, NULL);
+    pthread_mutex_init(&tree->snapshot_mutex, NULL);
+    tree->snapshots.prev = &tree->snapshots;
+    tree->snapshots.next = &tree->snapshots;
     
     tree->active_memtable = memtable_create(LSM_MEMTABLE_MAX_SIZE);
-    if (!tree->active_memtable) {
-        free(tree);
+    tree->base_dir = strdup(base_dir);
+    if (!tree->active_memtable || !tree->base_dir || !tree->block_cache || !tree->table_cache) {
+        lsm_tree_destroy(tree);
         return NULL;
     }
     
     tree->immutable_memtable = NULL;
-    tree->base_dir = strdup(base_dir);
+    tree->last_sequence = 0;
+    tree->next_file_number = 1;
     
     for (int i = 0; i < LSM_SSTABLE_LEVELS; i++) {
         tree->sstable_counts[i] = 0;
         tree->sstables[i] = NULL;
+        tree->compact_pointers[i] = NULL;
+        tree->compact_pointer_sizes[i] = 0;
+    }
+    
+    // 按MANIFEST恢复已刷写的数据
+    if (mkdir(base_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create LSM directory: %s\n", base_dir);
+        lsm_tree_destroy(tree);
+        return NULL;
+    }
+    if (!tree_recover(tree)) {
+        fprintf(stderr, "Failed to recover LSM tree: %s\n", base_dir);
+        lsm_tree_destroy(tree);
+        return NULL;
+    }
+    tree->visible_sequence = tree->last_sequence;
+    
+    // 启动后台刷写和压缩线程
+    tree->background_running = true;
+    for (uint32_t i = 0; i < LSM_BACKGROUND_THREADS; i++) {
+        if (pthread_create(&tree->background_threads[i], NULL, background_main, tree) != 0) {
+            fprintf(stderr, "Failed to start LSM background thread\n");
+            lsm_tree_destroy(tree);
+            return NULL;
+        }
+        tree->background_thread_count++;
     }
     
     return tree;
@@ -197,21 +1496,40 @@ lsm_tree *lsm_tree_create(const char *base_dir) {
 
 void lsm_tree_destroy(lsm_tree *tree) {
     if (tree) {
-        if (tree->active_memtable) {
-            memtable_destroy(tree->active_memtable);
+        // 关闭前刷写内存表，重新打开时数据都在SSTable中；之后等待正在执行的后台任务结束
+        if (tree->background_thread_count > 0) {
+            lsm_tree_flush(tree);
         }
-        if (tree->immutable_memtable) {
-            memtable_destroy(tree->immutable_memtable);
+        background_stop(tree);
+        lsm_manifest_close(tree->manifest);
+        pthread_rwlock_destroy(&tree->lock);
+        pthread_mutex_destroy(&tree->background_mutex);
+        pthread_cond_destroy(&tree->background_cond);
+        pthread_mutex_destroy(&tree->manifest_mutex);
+        pthread_mutex_destroy(&tree->snapshot_mutex);
+        
+        // 释放调用者没有释放的快照
+        while (tree->snapshots.next && tree->snapshots.next != &tree->snapshots) {
+            lsm_snapshot *snapshot = tree->snapshots.next;
+            tree->snapshots.next = snapshot->next;
+            free(snapshot);
         }
         
+        memtable_unref(tree->active_memtable);
+        memtable_unref(tree->immutable_memtable);
+        
         for (int i = 0; i < LSM_SSTABLE_LEVELS; i++) {
-            for (int j = 0; j < tree->sstable_counts[i]; j++) {
-                sstable_destroy(tree->sstables[i][j]);
+            for (uint32_t j = 0; j < tree->sstable_counts[i]; j++) {
+                sstable_unref(tree->sstables[i][j]);
             }
             if (tree->sstables[i]) {
                 free(tree->sstables[i]);
             }
+            free(tree->compact_pointers[i]);
         }
+        // 所有SSTable关闭后读取器和数据块都不再被引用
+        lsm_cache_destroy(tree->table_cache);
+        lsm_cache_destroy(tree->block_cache);
         
         if (tree->base_dir) {
             free(tree->base_dir);
@@ -221,108 +1539,515 @@ void lsm_tree_destroy(lsm_tree *tree) {
     }
 }
 
-bool lsm_tree_insert(lsm_tree *tree, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
-    // 尝试插入到活跃内存表
-    if (memtable_put(tree->active_memtable, key, key_size, value, value_size)) {
-        return true;
+// 按序号顺序发布写入：之前的写入都完成后才推进可见序号，查询不会看到序号之间的空洞
+static void publish_sequence(lsm_tree *tree, uint64_t sequence) {
+    while (__atomic_load_n(&tree->visible_sequence, __ATOMIC_ACQUIRE) != sequence - 1) {
+        sched_yield();
+    }
+    __atomic_store_n(&tree->visible_sequence, sequence, __ATOMIC_RELEASE);
+}
+
+// 写入一个版本
+static bool tree_write(lsm_tree *tree, uint8_t type, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    if (__atomic_load_n(&tree->background_failed, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    
+    // 后台任务落后时每次写入延迟一小段时间，把停止写入的长时间等待分摊到多次写入
+    if (write_should_slow_down(tree)) {
+        struct timespec delay = {0, LSM_SLOWDOWN_DELAY_US * 1000L};
+        nanosleep(&delay, NULL);
+        pthread_mutex_lock(&tree->background_mutex);
+        tree->stats.write_slowdowns++;
+        pthread_mutex_unlock(&tree->background_mutex);
     }
     
-    // 活跃内存表已满，需要刷写到磁盘
-    if (!tree->immutable_memtable) {
-        // 将活跃内存表标记为不可变
-        tree->active_memtable->immutable = true;
-        tree->immutable_memtable = tree->active_memtable;
+    while (true) {
+        // 共享锁内分配序号并插入：切换内存表需要独占锁，之后的写入的序号都大于已切换内存表中的序号
+        // 插入失败的序号也要发布，否则之后的写入永远不可见
+        tree_lock_shared(tree);
+        lsm_memtable *memtable = tree->active_memtable;
+        uint64_t sequence = __atomic_add_fetch(&tree->last_sequence, 1, __ATOMIC_RELAXED);
+        bool inserted = memtable_put(memtable, sequence, type, key, key_size, value, value_size);
+        tree_unlock(tree);
+        publish_sequence(tree, sequence);
+        if (inserted) {
+            return true;
+        }
         
-        // 创建新的活跃内存表
-        tree->active_memtable = memtable_create(LSM_MEMTABLE_MAX_SIZE);
-        if (!tree->active_memtable) {
+        // 空内存表也放不下的键值对无法插入
+        if (__atomic_load_n(&memtable->entry_count, __ATOMIC_RELAXED) == 0) {
             return false;
         }
         
-        // 异步刷写不可变内存表到磁盘（简化实现，同步执行）
-        lsm_tree_flush(tree);
+        // 活跃内存表已满，切换后重试
+        if (!switch_memtable(tree, memtable)) {
+            return false;
+        }
+    }
+}
+
+// 查找状态：从新到旧收集同一个键的版本，遇到PUT或DELETE时结束
+typedef struct {
+    bool done;
+    bool found; // 找到PUT
+    bool failed;
+    char *value;
+    uint32_t value_size;
+    char **operands; // 合并操作数（从新到旧）
+    uint32_t *operand_sizes;
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+} lookup_state;
+
+static bool lookup_add_version(uint64_t sequence, uint8_t type, const char *value, uint32_t value_size, void *arg) {
+    lookup_state *state = (lookup_state *)arg;
+    (void)sequence;
+    
+    if (type == SSTABLE_TYPE_MERGE) {
+        if (state->operand_count == state->operand_capacity) {
+            uint32_t capacity = state->operand_capacity ? state->operand_capacity * 2 : 4;
+            char **operands = (char **)realloc(state->operands, capacity * sizeof(char *));
+            if (operands) {
+                state->operands = operands;
+            }
+            uint32_t *sizes = operands ? (uint32_t *)realloc(state->operand_sizes, capacity * sizeof(uint32_t)) : NULL;
+            if (!sizes) {
+                state->failed = true;
+                state->done = true;
+                return false;
+            }
+            state->operand_sizes = sizes;
+            state->operand_capacity = capacity;
+        }
+        char *operand = copy_key(value, value_size);
+        if (!operand) {
+            state->failed = true;
+            state->done = true;
+            return false;
+        }
+        state->operands[state->operand_count] = operand;
+        state->operand_sizes[state->operand_count++] = value_size;
+        return true;
     }
     
-    // 再次尝试插入
-    return memtable_put(tree->active_memtable, key, key_size, value, value_size);
+    if (type == SSTABLE_TYPE_PUT) {
+        state->value = copy_key(value, value_size);
+        state->value_size = value_size;
+        state->found = state->value != NULL;
+        state->failed = state->value == NULL;
+    }
+    state->done = true;
+    return false;
 }
 
-char *lsm_tree_get(lsm_tree *tree, const char *key, uint32_t key_size, uint32_t *value_size) {
-    // 1. 先查询活跃内存表
-    char *value = memtable_get(tree->active_memtable, key, key_size, value_size);
-    if (value) {
-        return value;
+// 把合并操作数从旧到新应用到找到的值上，返回最终的值
+static char *lookup_finish(lsm_tree *tree, lookup_state *state, const char *key, uint32_t key_size, uint32_t *value_size) {
+    char *value = state->found ? state->value : NULL;
+    uint32_t size = state->value_size;
+    if (!state->failed && state->operand_count > 0) {
+        if (!tree->merge_operator) {
+            fprintf(stderr, "LSM merge operand found without a merge operator\n");
+            state->failed = true;
+        }
+        for (uint32_t i = state->operand_count; !state->failed && i-- > 0;) {
+            uint32_t result_size = 0;
+            char *result = tree->merge_operator(key, key_size, value, size, state->operands[i], state->operand_sizes[i],
+                                                &result_size, tree->merge_operator_arg);
+            free(value);
+            value = result;
+            size = result_size;
+            state->failed = result == NULL;
+        }
+    }
+    
+    for (uint32_t i = 0; i < state->operand_count; i++) {
+        free(state->operands[i]);
+    }
+    free(state->operands);
+    free(state->operand_sizes);
+    if (state->failed || (!value && state->operand_count == 0)) {
+        free(value);
+        return NULL;
+    }
+    *value_size = size;
+    return value;
+}
+
+// 查找一个SSTable，读到损坏的块时查找失败
+// 常驻内存的过滤器排除不包含该键的文件，不访问文件内容
+static void lookup_sstable(lsm_tree *tree, lsm_sstable_meta *meta, const char *key, uint32_t key_size, uint64_t sequence,
+                           lookup_state *state) {
+    lsm_cache_handle *table = table_acquire(tree, meta);
+    if (!table || !sstable_reader_get((sstable_reader *)table->value, key, key_size, sequence, lookup_add_version, state)) {
+        state->failed = true;
+        state->done = true;
+    }
+    if (table) {
+        lsm_cache_release(tree->table_cache, table);
     }
+}
+
+// 读取序号不大于sequence的最新版本
+static char *tree_get(lsm_tree *tree, const lsm_snapshot *snapshot, const char *key, uint32_t key_size, uint32_t *value_size) {
+    lookup_state state;
+    memset(&state, 0, sizeof(state));
+    
+    // 共享锁保证查询期间内存表和SSTable不被后台任务释放
+    tree_lock_shared(tree);
+    uint64_t sequence = snapshot ? snapshot->sequence : __atomic_load_n(&tree->visible_sequence, __ATOMIC_ACQUIRE);
+    
+    // 1. 先查询活跃内存表
+    memtable_get(tree->active_memtable, key, key_size, sequence, lookup_add_version, &state);
     
     // 2. 查询不可变内存表
-    if (tree->immutable_memtable) {
-        value = memtable_get(tree->immutable_memtable, key, key_size, value_size);
-        if (value) {
-            return value;
+    if (!state.done && tree->immutable_memtable) {
+        memtable_get(tree->immutable_memtable, key, key_size, sequence, lookup_add_version, &state);
+    }
+    
+    // 3. 第0层的文件键范围重叠，从最新刷写的文件开始查询
+    for (uint32_t j = tree->sstable_counts[0]; !state.done && j-- > 0;) {
+        lsm_sstable_meta *meta = tree->sstables[0][j];
+        if (sstable_overlaps(meta, key, key_size, key, key_size)) {
+            lookup_sstable(tree, meta, key, key_size, sequence, &state);
         }
     }
     
-    // 3. 查询各层SSTable
-    for (int i = 0; i < LSM_SSTABLE_LEVELS; i++) {
-        for (int j = 0; j < tree->sstable_counts[i]; j++) {
-            value = sstable_get(tree->sstables[i][j]->filename, key, key_size, value_size);
-            if (value) {
-                return value;
-            }
+    // 4. 其他层的文件键范围不重叠，只查询第一个最大键不小于key的文件
+    for (int i = 1; !state.done && i < LSM_SSTABLE_LEVELS; i++) {
+        uint32_t index = level_find_file(tree->sstables[i], tree->sstable_counts[i], key, key_size);
+        if (index < tree->sstable_counts[i] && sstable_overlaps(tree->sstables[i][index], key, key_size, key, key_size)) {
+            lookup_sstable(tree, tree->sstables[i][index], key, key_size, sequence, &state);
         }
     }
     
-    return NULL;
+    tree_unlock(tree);
+    return lookup_finish(tree, &state, key, key_size, value_size);
+}
+
+bool lsm_tree_insert(lsm_tree *tree, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    return tree_write(tree, SSTABLE_TYPE_PUT, key, key_size, value, value_size);
+}
+
+char *lsm_tree_get(lsm_tree *tree, const char *key, uint32_t key_size, uint32_t *value_size) {
+    return tree_get(tree, NULL, key, key_size, value_size);
 }
 
 bool lsm_tree_delete(lsm_tree *tree, const char *key, uint32_t key_size) {
-    // 删除操作通过插入 tombstone 实现
-    return lsm_tree_insert(tree, key, key_size, "", 0);
+    // 删除写入DELETE版本，查询遇到它时停止；压缩在没有快照需要旧版本时丢弃
+    return tree_write(tree, SSTABLE_TYPE_DELETE, key, key_size, "", 0);
 }
 
-bool lsm_tree_flush(lsm_tree *tree) {
-    if (!tree->immutable_memtable) {
-        return true;
+void lsm_tree_set_merge_operator(lsm_tree *tree, lsm_merge_operator merge_operator, void *arg) {
+    tree->merge_operator = merge_operator;
+    tree->merge_operator_arg = arg;
+}
+
+bool lsm_tree_merge(lsm_tree *tree, const char *key, uint32_t key_size, const char *operand, uint32_t operand_size) {
+    if (!tree->merge_operator) {
+        fprintf(stderr, "LSM merge requires a merge operator\n");
+        return false;
+    }
+    return tree_write(tree, SSTABLE_TYPE_MERGE, key, key_size, operand, operand_size);
+}
+
+lsm_snapshot *lsm_tree_create_snapshot(lsm_tree *tree) {
+    lsm_snapshot *snapshot = (lsm_snapshot *)malloc(sizeof(lsm_snapshot));
+    if (!snapshot) {
+        return NULL;
     }
     
-    // 生成SSTable文件名
-    char *filename = generate_sstable_filename(tree->base_dir, 0);
-    if (!filename) {
-        return false;
+    // 在快照锁内读取可见序号，链表按序号递增
+    pthread_mutex_lock(&tree->snapshot_mutex);
+    snapshot->sequence = __atomic_load_n(&tree->visible_sequence, __ATOMIC_ACQUIRE);
+    snapshot->prev = tree->snapshots.prev;
+    snapshot->next = &tree->snapshots;
+    tree->snapshots.prev->next = snapshot;
+    tree->snapshots.prev = snapshot;
+    pthread_mutex_unlock(&tree->snapshot_mutex);
+    return snapshot;
+}
+
+void lsm_tree_release_snapshot(lsm_tree *tree, lsm_snapshot *snapshot) {
+    if (!snapshot) {
+        return;
     }
     
-    // 刷写内存表到SSTable
-    lsm_sstable_meta *meta = NULL;
-    if (!flush_memtable_to_sstable(tree->immutable_memtable, filename, &meta)) {
-        free(filename);
+    pthread_mutex_lock(&tree->snapshot_mutex);
+    snapshot->prev->next = snapshot->next;
+    snapshot->next->prev = snapshot->prev;
+    pthread_mutex_unlock(&tree->snapshot_mutex);
+    free(snapshot);
+}
+
+char *lsm_tree_snapshot_get(lsm_tree *tree, const lsm_snapshot *snapshot, const char *key, uint32_t key_size, uint32_t *value_size) {
+    return tree_get(tree, snapshot, key, key_size, value_size);
+}
+
+bool lsm_tree_flush(lsm_tree *tree) {
+    // 切换活跃内存表，等待它和之前的不可变内存表刷写完成
+    tree_lock_shared(tree);
+    lsm_memtable *memtable = tree->active_memtable;
+    bool empty = __atomic_load_n(&memtable->entry_count, __ATOMIC_RELAXED) == 0;
+    tree_unlock(tree);
+    if (!empty && !switch_memtable(tree, memtable)) {
         return false;
     }
     
-    // 将新的SSTable添加到第0层
-    tree->sstables[0] = (lsm_sstable_meta **)realloc(tree->sstables[0], (tree->sstable_counts[0] + 1) * sizeof(lsm_sstable_meta *));
-    if (!tree->sstables[0]) {
-        free(filename);
-        sstable_destroy(meta);
-        return false;
+    while (true) {
+        uint64_t generation = background_generation(tree);
+        if (__atomic_load_n(&tree->background_failed, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        tree_lock_shared(tree);
+        bool pending = tree->immutable_memtable != NULL;
+        tree_unlock(tree);
+        if (!pending) {
+            return true;
+        }
+        background_wait(tree, generation);
+    }
+}
+
+bool lsm_tree_compact(lsm_tree *tree) {
+    // 等待后台线程把每层压缩到目标大小以内
+    background_schedule(tree);
+    while (true) {
+        pthread_mutex_lock(&tree->background_mutex);
+        uint64_t generation = tree->background_generation;
+        bool busy = tree->flush_running || tree->compaction_running;
+        pthread_mutex_unlock(&tree->background_mutex);
+        if (__atomic_load_n(&tree->background_failed, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        
+        tree_lock_shared(tree);
+        bool pending = tree->immutable_memtable != NULL || compaction_pick_level(tree) >= 0;
+        tree_unlock(tree);
+        if (!busy && !pending) {
+            return true;
+        }
+        background_wait(tree, generation);
+    }
+}
+
+void lsm_tree_get_stats(lsm_tree *tree, lsm_tree_stats *stats) {
+    pthread_mutex_lock(&tree->background_mutex);
+    *stats = tree->stats;
+    pthread_mutex_unlock(&tree->background_mutex);
+}
+
+void lsm_tree_get_cache_stats(lsm_tree *tree, lsm_cache_stats *block_cache, lsm_cache_stats *table_cache) {
+    lsm_cache_get_stats(tree->block_cache, block_cache);
+    lsm_cache_get_stats(tree->table_cache, table_cache);
+}
+
+// 迭代器函数
+// 复制到可复用的缓冲区
+static bool iterator_assign(char **buffer, uint32_t *size, uint32_t *capacity, const char *data, uint32_t data_size) {
+    if (data_size > *capacity || !*buffer) {
+        char *grown = (char *)realloc(*buffer, data_size ? data_size : 1);
+        if (!grown) {
+            return false;
+        }
+        *buffer = grown;
+        *capacity = data_size;
+    }
+    if (data_size) {
+        memcpy(*buffer, data, data_size);
+    }
+    *size = data_size;
+    return true;
+}
+
+// 文件的键范围是否与[lower_bound, upper_bound)相交
+static bool iterator_file_in_range(const lsm_iterator *iterator, const lsm_sstable_meta *meta) {
+    return (!iterator->upper_bound ||
+            sstable_compare_keys(meta->min_key, meta->min_key_size, iterator->upper_bound, iterator->upper_bound_size) < 0) &&
+           (!iterator->lower_bound ||
+            sstable_compare_keys(meta->max_key, meta->max_key_size, iterator->lower_bound, iterator->lower_bound_size) >= 0);
+}
+
+// 从合并迭代器的当前位置找到下一个可见的键：同一个键的版本从新到旧交给查找状态，删除的键跳过
+static void iterator_find_visible(lsm_iterator *iterator) {
+    iterator->valid = false;
+    lsm_merge_input *top = NULL;
+    while (!iterator->failed && (top = merge_top(&iterator->merge)) != NULL) {
+        if (iterator->upper_bound &&
+            sstable_compare_keys(top->key, top->key_size, iterator->upper_bound, iterator->upper_bound_size) >= 0) {
+            break;
+        }
+        if (!iterator_assign(&iterator->key, &iterator->key_size, &iterator->key_capacity, top->key, top->key_size)) {
+            iterator->failed = true;
+            break;
+        }
+        
+        // 最新的可见版本是PUT时直接复制值，否则收集合并操作数
+        lookup_state state;
+        memset(&state, 0, sizeof(state));
+        bool found = false;
+        bool more = true;
+        while (top && sstable_compare_keys(top->key, top->key_size, iterator->key, iterator->key_size) == 0) {
+            if (more && top->sequence <= iterator->sequence) {
+                if (top->type == SSTABLE_TYPE_PUT && state.operand_count == 0) {
+                    found = iterator_assign(&iterator->value, &iterator->value_size, &iterator->value_capacity, top->value, top->value_size);
+                    state.failed = !found;
+                    more = false;
+                } else {
+                    more = lookup_add_version(top->sequence, top->type, top->value, top->value_size, &state);
+                }
+            }
+            merge_next(&iterator->merge);
+            top = merge_top(&iterator->merge);
+        }
+        if (!found) {
+            // 应用合并操作数并释放查找状态（失败时返回NULL）
+            uint32_t value_size = 0;
+            char *value = lookup_finish(iterator->tree, &state, iterator->key, iterator->key_size, &value_size);
+            found = value && iterator_assign(&iterator->value, &iterator->value_size, &iterator->value_capacity, value, value_size);
+            state.failed = state.failed || (value && !found);
+            free(value);
+        }
+        iterator->failed = state.failed || iterator->merge.corrupted;
+        if (found && !iterator->failed) {
+            iterator->valid = true;
+            return;
+        }
+    }
+    iterator->failed = iterator->failed || iterator->merge.corrupted;
+}
+
+lsm_iterator *lsm_tree_iterator_create(lsm_tree *tree, const lsm_snapshot *snapshot, const char *lower_bound, uint32_t lower_bound_size,
+                                       const char *upper_bound, uint32_t upper_bound_size) {
+    lsm_iterator *iterator = (lsm_iterator *)calloc(1, sizeof(lsm_iterator));
+    if (!iterator) {
+        return NULL;
+    }
+    iterator->tree = tree;
+    if (lower_bound) {
+        iterator->lower_bound = copy_key(lower_bound, lower_bound_size);
+        iterator->lower_bound_size = lower_bound_size;
+    }
+    if (upper_bound) {
+        iterator->upper_bound = copy_key(upper_bound, upper_bound_size);
+        iterator->upper_bound_size = upper_bound_size;
+    }
+    if ((lower_bound && !iterator->lower_bound) || (upper_bound && !iterator->upper_bound)) {
+        lsm_iterator_destroy(iterator);
+        return NULL;
     }
     
-    tree->sstables[0][tree->sstable_counts[0]] = meta;
-    tree->sstable_counts[0]++;
+    // 共享锁内引用内存表和键范围内的文件，之后不再需要树锁
+    tree_lock_shared(tree);
+    iterator->sequence = snapshot ? snapshot->sequence : __atomic_load_n(&tree->visible_sequence, __ATOMIC_ACQUIRE);
+    uint32_t total_files = 0;
+    for (int i = 0; i < LSM_SSTABLE_LEVELS; i++) {
+        total_files += tree->sstable_counts[i];
+    }
+    iterator->files = (lsm_sstable_meta **)malloc((total_files ? total_files : 1) * sizeof(lsm_sstable_meta *));
+    bool success = iterator->files &&
+                   merge_create(&iterator->merge, 2 + tree->sstable_counts[0] + LSM_SSTABLE_LEVELS - 1, tree, true);
     
-    // 销毁不可变内存表
-    memtable_destroy(tree->immutable_memtable);
-    tree->immutable_memtable = NULL;
+    uint32_t input_count = 0;
+    lsm_memtable *memtables[2] = {tree->active_memtable, tree->immutable_memtable};
+    for (int i = 0; success && i < 2; i++) {
+        if (memtables[i]) {
+            memtable_ref(memtables[i]);
+            iterator->memtables[iterator->memtable_count++] = memtables[i];
+            merge_add_memtable(&iterator->merge, input_count++, memtables[i]);
+        }
+    }
     
-    // 检查是否需要压缩
-    if (tree->sstable_counts[0] >= LSM_SSTABLE_RATIO) {
-        lsm_tree_compact(tree);
+    // 第0层的每个文件是一个输入，其他层键范围内的连续文件是一个输入
+    for (uint32_t j = 0; success && j < tree->sstable_counts[0]; j++) {
+        lsm_sstable_meta *meta = tree->sstables[0][j];
+        if (iterator_file_in_range(iterator, meta)) {
+            sstable_ref(meta);
+            iterator->files[iterator->file_count] = meta;
+            merge_add_files(&iterator->merge, input_count++, &iterator->files[iterator->file_count++], 1);
+        }
+    }
+    for (int i = 1; success && i < LSM_SSTABLE_LEVELS; i++) {
+        uint32_t first = iterator->file_count;
+        for (uint32_t j = 0; j < tree->sstable_counts[i]; j++) {
+            lsm_sstable_meta *meta = tree->sstables[i][j];
+            if (iterator_file_in_range(iterator, meta)) {
+                sstable_ref(meta);
+                iterator->files[iterator->file_count++] = meta;
+            }
+        }
+        if (iterator->file_count > first) {
+            merge_add_files(&iterator->merge, input_count++, &iterator->files[first], iterator->file_count - first);
+        }
     }
+    iterator->merge.input_count = input_count;
+    tree_unlock(tree);
     
-    free(filename);
-    return true;
+    if (!success) {
+        lsm_iterator_destroy(iterator);
+        return NULL;
+    }
+    return iterator;
 }
 
-bool lsm_tree_compact(lsm_tree *tree) {
-    // 简化的压缩实现，实际应该更复杂
-    return true;
+lsm_iterator *lsm_tree_prefix_iterator_create(lsm_tree *tree, const lsm_snapshot *snapshot, const char *prefix, uint32_t prefix_size) {
+    // 上界是比所有以prefix开头的键都大的最短键：去掉末尾的0xFF后最后一个字节加一，全是0xFF时不设上界
+    uint32_t upper_size = prefix_size;
+    while (upper_size > 0 && (uint8_t)prefix[upper_size - 1] == 0xFF) {
+        upper_size--;
+    }
+    char *upper = upper_size ? copy_key(prefix, upper_size) : NULL;
+    if (upper_size && !upper) {
+        return NULL;
+    }
+    if (upper) {
+        upper[upper_size - 1] = (char)((uint8_t)upper[upper_size - 1] + 1);
+    }
+    
+    lsm_iterator *iterator = lsm_tree_iterator_create(tree, snapshot, prefix, prefix_size, upper, upper_size);
+    free(upper);
+    return iterator;
+}
+
+void lsm_iterator_destroy(lsm_iterator *iterator) {
+    if (!iterator) {
+        return;
+    }
+    
+    // 先销毁SSTable迭代器再释放文件引用
+    merge_destroy(&iterator->merge);
+    for (uint32_t i = 0; i < iterator->memtable_count; i++) {
+        memtable_unref(iterator->memtables[i]);
+    }
+    for (uint32_t i = 0; i < iterator->file_count; i++) {
+        sstable_unref(iterator->files[i]);
+    }
+    free(iterator->files);
+    free(iterator->lower_bound);
+    free(iterator->upper_bound);
+    free(iterator->key);
+    free(iterator->value);
+    free(iterator);
+}
+
+void lsm_iterator_seek_first(lsm_iterator *iterator) {
+    lsm_iterator_seek(iterator, NULL, 0);
+}
+
+void lsm_iterator_seek(lsm_iterator *iterator, const char *key, uint32_t key_size) {
+    // 不早于下界
+    if (iterator->lower_bound &&
+        (!key || sstable_compare_keys(key, key_size, iterator->lower_bound, iterator->lower_bound_size) < 0)) {
+        key = iterator->lower_bound;
+        key_size = iterator->lower_bound_size;
+    }
+    merge_seek(&iterator->merge, key, key_size);
+    iterator_find_visible(iterator);
+}
+
+void lsm_iterator_next(lsm_iterator *iterator) {
+    // 当前键的所有版本已经在定位时跳过
+    if (iterator->valid) {
+        iterator_find_visible(iterator);
+    }
 }
@@ -3,11 +3,29 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include "sstable.h"
+#include "lsm_manifest.h"
+#include "lsm_cache.h"
 
 // LSM树配置参数
 #define LSM_MEMTABLE_MAX_SIZE (1024 * 1024 * 10) // 10MB
 #define LSM_SSTABLE_LEVELS 3
-#define LSM_SSTABLE_RATIO 10
+#define LSM_SSTABLE_RATIO 10 // 相邻两层的目标大小之比
+#define LSM_L0_COMPACTION_TRIGGER 4 // 第0层文件数达到该值时压缩到第1层
+#define LSM_LEVEL_BASE_SIZE ((uint64_t)LSM_MEMTABLE_MAX_SIZE * LSM_SSTABLE_RATIO) // 第1层的目标大小
+#define LSM_SSTABLE_TARGET_SIZE (1024 * 1024 * 2) // 压缩输出的单个文件大小
+#define LSM_L0_SLOWDOWN_TRIGGER 8 // 第0层文件数达到该值时每次写入延迟LSM_SLOWDOWN_DELAY_US
+#define LSM_L0_STOP_TRIGGER 12 // 第0层文件数达到该值时停止切换内存表，直到压缩跟上
+#define LSM_PENDING_COMPACTION_SLOWDOWN_BYTES (LSM_LEVEL_BASE_SIZE * 4) // 待压缩数据量达到该值时延迟写入
+#define LSM_PENDING_COMPACTION_STOP_BYTES (LSM_LEVEL_BASE_SIZE * 16) // 待压缩数据量达到该值时停止写入
+#define LSM_SLOWDOWN_DELAY_US 1000
+#define LSM_BACKGROUND_THREADS 2 // 后台线程数（刷写和压缩各最多一个任务）
+#define LSM_SKIPLIST_MAX_HEIGHT 12 // 跳表最大层数（每层节点数约为下一层的1/4）
+#define LSM_BLOCK_CACHE_SIZE (1024 * 1024 * 8) // 默认的数据块缓存容量
+#define LSM_MAX_OPEN_FILES 1000 // 默认同时打开的SSTable数（表缓存容量）
+#define LSM_BLOCK_CACHE_MIN_SHARD_SIZE (512 * 1024) // 块缓存每个分片的最小容量
+#define LSM_TABLE_CACHE_MIN_SHARD_SIZE 64 // 表缓存每个分片最少能打开的文件数
 
 // 键值对结构
 typedef struct {
@@ -17,36 +35,191 @@ typedef struct {
     char *value;
 } lsm_kv_pair;
 
+// 跳表节点（在内存表的内存池中分配，之后是键和值）
+typedef struct lsm_skiplist_node {
+    uint64_t sequence; // 写入序号，同一个键的新版本排在旧版本之前
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t height;
+    uint32_t type; // 条目类型（sstable_entry_type）
+    struct lsm_skiplist_node *next[]; // 各层的后继节点（height个）
+} lsm_skiplist_node;
+
 // 内存表结构 (MemTable)
+// 按(键, 序号降序)排序的无锁跳表：插入逐层CAS链接节点，读取不加锁。
+// 节点从预分配的内存池中原子递增分配，内存表整体释放。
 typedef struct {
-    char *data;
-    uint32_t size;
+    char *data; // 内存池
+    uint32_t size; // 已分配字节数
     uint32_t capacity;
     bool immutable;
+    lsm_skiplist_node *head;
+    uint32_t entry_count;
+    uint64_t random_state; // 生成节点层数
+    uint32_t refs; // 引用计数（树和迭代器各持有一个）
 } lsm_memtable;
 
 // SSTable文件元数据
+// 第0层的文件由内存表刷写而来，键范围可能互相重叠；其他层的文件按最小键排序，键范围互不重叠
 typedef struct {
     char *filename;
-    uint64_t min_key;
-    uint64_t max_key;
+    uint64_t file_number;
+    uint64_t file_size;
+    char *min_key;
+    uint32_t min_key_size;
+    char *max_key;
+    uint32_t max_key_size;
     uint32_t entry_count;
     uint32_t level;
+    lsm_cache *table_cache; // 打开的读取器在表缓存中，按需打开
+    uint32_t refs; // 引用计数（树和迭代器各持有一个）
+    bool obsolete; // 已被压缩替换，最后一个引用释放时删除文件
 } lsm_sstable_meta;
 
+// 快照：读取序号不大于sequence的版本，压缩保留快照能看到的版本
+typedef struct lsm_snapshot {
+    uint64_t sequence;
+    struct lsm_snapshot *prev;
+    struct lsm_snapshot *next;
+} lsm_snapshot;
+
+// 合并操作：把一个合并操作数应用到已有值上（没有已有值时existing为NULL），返回malloc分配的结果，失败时返回NULL
+typedef char *(*lsm_merge_operator)(const char *key, uint32_t key_size, const char *existing, uint32_t existing_size,
+                                    const char *operand, uint32_t operand_size, uint32_t *result_size, void *arg);
+
+// 后台任务和写入限流统计
+typedef struct {
+    uint64_t flushes;
+    uint64_t compactions;
+    uint64_t write_slowdowns; // 被延迟的写入次数
+    uint64_t write_stops; // 等待后台任务才能切换内存表的次数
+} lsm_tree_stats;
+
+// SSTable数据块的压缩方式
+typedef enum {
+    LSM_COMPRESSION_DEFAULT = 0, // 最后一层用高压缩率算法，其他层用快速算法
+    LSM_COMPRESSION_NONE,
+    LSM_COMPRESSION_FAST,
+    LSM_COMPRESSION_HIGH
+} lsm_compression;
+
+// LSM树选项（0表示默认值）
+typedef struct {
+    uint32_t bloom_bits_per_key; // 每个键的过滤器位数，默认SSTABLE_BLOOM_BITS_PER_KEY
+    double bloom_false_positive_rate; // 过滤器的目标假阳性率，非0时按它计算每个键的位数（忽略bloom_bits_per_key）
+    bool partitioned_filters; // 大文件使用分区过滤器，查询只检查一个分区
+    uint64_t block_cache_size; // 数据块缓存的字节数，默认LSM_BLOCK_CACHE_SIZE
+    uint32_t max_open_files; // 同时打开的SSTable数，默认LSM_MAX_OPEN_FILES
+    lsm_compression compression[LSM_SSTABLE_LEVELS]; // 每层的压缩方式，新写入的数据很快被压缩合并，较冷的层压缩得更多
+} lsm_tree_config;
+
 // LSM树结构
+// 写入只在活跃内存表满时切换内存表，刷写和压缩由后台线程执行。
+// 读写操作持有共享的树锁，切换内存表和修改文件列表时独占。
+// 文件列表的每次修改先记录到MANIFEST，打开时按MANIFEST恢复；内存表在关闭时刷写，崩溃时丢失。
+// 每次写入（PUT、DELETE或MERGE）分配一个序号，查询从新到旧（内存表、第0层从新到旧、之后各层）
+// 读取序号不大于读取序号的版本，遇到PUT或DELETE即停止。
 typedef struct {
     lsm_memtable *active_memtable;
     lsm_memtable *immutable_memtable;
     lsm_sstable_meta **sstables[LSM_SSTABLE_LEVELS];
     uint32_t sstable_counts[LSM_SSTABLE_LEVELS];
     char *base_dir;
+    lsm_tree_config config;
+    lsm_cache *block_cache; // 校验过的数据块，键为(文件编号, 块偏移)
+    lsm_cache *table_cache; // 打开的SSTable读取器（文件映射、索引块和过滤器），键为(文件编号, 0)
+    uint64_t last_sequence; // 最后分配的写入序号
+    uint64_t visible_sequence; // 之前的写入都已完成的序号，查询读取不大于它的版本
+    uint64_t next_file_number; // 下一个SSTable文件编号
+    char *compact_pointers[LSM_SSTABLE_LEVELS]; // 每层上次压缩的最大键，下次从之后的文件开始
+    uint32_t compact_pointer_sizes[LSM_SSTABLE_LEVELS];
+    uint64_t pending_compaction_bytes; // 估算的待压缩数据量
+    
+    pthread_rwlock_t lock;
+    uint32_t exclusive_waiters; // 等待独占树锁的线程数
+    pthread_mutex_t background_mutex; // 保护后台任务状态和统计
+    pthread_cond_t background_cond; // 后台任务状态变化（新任务或任务完成）
+    pthread_t background_threads[LSM_BACKGROUND_THREADS];
+    uint32_t background_thread_count;
+    uint64_t background_generation; // 每次状态变化递增，等待者据此判断是否错过唤醒
+    bool background_running;
+    bool flush_running;
+    bool compaction_running;
+    bool background_failed; // 后台任务失败后拒绝写入
+    lsm_tree_stats stats;
+    
+    lsm_snapshot snapshots; // 快照链表头（按创建顺序，序号递增）
+    pthread_mutex_t snapshot_mutex;
+    lsm_merge_operator merge_operator;
+    void *merge_operator_arg;
+    
+    lsm_manifest *manifest;
+    pthread_mutex_t manifest_mutex; // 记录版本修改并应用（先于树锁获取）
 } lsm_tree;
 
-// 初始化LSM树
+// 合并输入：一个内存表，或按键排序、键范围互不重叠的一组SSTable（第0层的单个文件或其他层的连续文件）
+// 当前条目的键是用户键，指向内存表节点或SSTable迭代器的缓冲区，移动后失效
+typedef struct {
+    lsm_memtable *memtable;
+    lsm_skiplist_node *node;
+    lsm_sstable_meta **files;
+    uint32_t file_count;
+    uint32_t file_index;
+    lsm_tree *tree; // 通过树的表缓存打开文件
+    bool fill_cache; // 读取的数据块是否放入块缓存
+    lsm_cache_handle *table; // 当前文件的读取器
+    sstable_iterator *iterator; // 当前文件的迭代器
+    bool valid;
+    bool corrupted;
+    const char *key;
+    uint32_t key_size;
+    uint64_t sequence;
+    uint8_t type;
+    const char *value;
+    uint32_t value_size;
+} lsm_merge_input;
+
+// 合并迭代器：按(用户键, 序号降序)的最小堆合并多个输入
+typedef struct {
+    lsm_merge_input *inputs;
+    uint32_t input_count;
+    uint32_t *heap;
+    uint32_t heap_size;
+    bool corrupted; // 有输入读到损坏的块
+} lsm_merge_iterator;
+
+// 范围迭代器
+// 按用户键顺序返回[lower_bound, upper_bound)内读取序号可见的键值对，每个键只返回最新版本，跳过删除的键。
+// 创建时引用内存表和键范围内的SSTable，之后不持有树锁，看到的是创建时的一致状态；必须在关闭树之前销毁。
+typedef struct {
+    lsm_tree *tree;
+    uint64_t sequence; // 读取序号
+    lsm_memtable *memtables[2];
+    uint32_t memtable_count;
+    lsm_sstable_meta **files;
+    uint32_t file_count;
+    lsm_merge_iterator merge;
+    char *lower_bound; // NULL表示不限
+    uint32_t lower_bound_size;
+    char *upper_bound; // NULL表示不限
+    uint32_t upper_bound_size;
+    bool valid;
+    bool failed; // 读到损坏的块或内存不足，之后迭代器失效
+    char *key; // 当前键和值
+    uint32_t key_size;
+    uint32_t key_capacity;
+    char *value;
+    uint32_t value_size;
+    uint32_t value_capacity;
+} lsm_iterator;
+
+// 打开LSM树（目录中有MANIFEST时恢复已刷写的数据）
 lsm_tree *lsm_tree_create(const char *base_dir);
 
-// 销毁LSM树
+// 按选项打开LSM树，config为NULL时使用默认选项
+lsm_tree *lsm_tree_create_with_config(const char *base_dir, const lsm_tree_config *config);
+
+// 刷写内存表后关闭LSM树
 void lsm_tree_destroy(lsm_tree *tree);
 
 // 插入键值对
@@ -58,10 +231,50 @@ char *lsm_tree_get(lsm_tree *tree, const char *key, uint32_t key_size, uint32_t
 // 删除键值对
 bool lsm_tree_delete(lsm_tree *tree, const char *key, uint32_t key_size);
 
-// 强制刷写内存表到磁盘
+// 设置合并操作（在第一次合并写入或查询之前设置）
+void lsm_tree_set_merge_operator(lsm_tree *tree, lsm_merge_operator merge_operator, void *arg);
+
+// 写入合并操作数，查询时按写入顺序应用到最近的PUT上（没有设置合并操作时失败）
+bool lsm_tree_merge(lsm_tree *tree, const char *key, uint32_t key_size, const char *operand, uint32_t operand_size);
+
+// 创建当前状态的快照
+lsm_snapshot *lsm_tree_create_snapshot(lsm_tree *tree);
+
+// 释放快照
+void lsm_tree_release_snapshot(lsm_tree *tree, lsm_snapshot *snapshot);
+
+// 在快照上查询键值对
+char *lsm_tree_snapshot_get(lsm_tree *tree, const lsm_snapshot *snapshot, const char *key, uint32_t key_size, uint32_t *value_size);
+
+// 强制刷写内存表到磁盘（等待后台刷写完成）
 bool lsm_tree_flush(lsm_tree *tree);
 
-// 执行后台压缩
+// 等待后台压缩把每层压缩到目标大小以内
 bool lsm_tree_compact(lsm_tree *tree);
 
+// 获取统计信息
+void lsm_tree_get_stats(lsm_tree *tree, lsm_tree_stats *stats);
+
+// 获取块缓存和表缓存的统计（通过monitoring_record_cache导出到监控系统）
+void lsm_tree_get_cache_stats(lsm_tree *tree, lsm_cache_stats *block_cache, lsm_cache_stats *table_cache);
+
+// 创建范围迭代器（创建后未定位），snapshot为NULL时读取当前状态
+lsm_iterator *lsm_tree_iterator_create(lsm_tree *tree, const lsm_snapshot *snapshot, const char *lower_bound, uint32_t lower_bound_size,
+                                       const char *upper_bound, uint32_t upper_bound_size);
+
+// 创建只返回以prefix开头的键的迭代器
+lsm_iterator *lsm_tree_prefix_iterator_create(lsm_tree *tree, const lsm_snapshot *snapshot, const char *prefix, uint32_t prefix_size);
+
+// 销毁迭代器，释放对内存表和SSTable的引用
+void lsm_iterator_destroy(lsm_iterator *iterator);
+
+// 定位到第一个键
+void lsm_iterator_seek_first(lsm_iterator *iterator);
+
+// 定位到第一个不小于key的键
+void lsm_iterator_seek(lsm_iterator *iterator, const char *key, uint32_t key_size);
+
+// 移动到下一个键（当前键和值在iterator->key和iterator->value中）
+void lsm_iterator_next(lsm_iterator *iterator);
+
 #endif // LSM_TREE_H
@@ -0,0 +1,1004 @@
+#include "sstable.h"
+#include "../storage/wal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 变长整数编码（每字节7位，最高位表示后面还有字节）
+static uint32_t sstable_put_varint32(char *dst, uint32_t value) {
+    uint8_t *p = (uint8_t *)dst;
+    uint32_t count = 0;
+    while (value >= 0x80) {
+        p[count++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[count++] = (uint8_t)value;
+    return count;
+}
+
+static const char *sstable_get_varint32(const char *p, const char *limit, uint32_t *value) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7) {
+        uint8_t byte = (uint8_t)*p++;
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+int sstable_compare_keys(const char *a, uint32_t a_size, const char *b, uint32_t b_size) {
+    uint32_t min_size = a_size < b_size ? a_size : b_size;
+    int cmp = min_size ? memcmp(a, b, min_size) : 0;
+    if (cmp != 0) {
+        return cmp;
+    }
+    return (a_size > b_size) - (a_size < b_size);
+}
+
+static uint64_t sstable_load_trailer(const char *key, uint32_t key_size) {
+    const uint8_t *p = (const uint8_t *)key + key_size - SSTABLE_KEY_TRAILER_SIZE;
+    uint64_t trailer = 0;
+    for (int i = SSTABLE_KEY_TRAILER_SIZE - 1; i >= 0; i--) {
+        trailer = (trailer << 8) | p[i];
+    }
+    return trailer;
+}
+
+int sstable_compare_internal_keys(const char *a, uint32_t a_size, const char *b, uint32_t b_size) {
+    // 过短的键（只可能来自损坏的文件）当作尾部为0
+    uint32_t a_user_size = a_size >= SSTABLE_KEY_TRAILER_SIZE ? a_size - SSTABLE_KEY_TRAILER_SIZE : a_size;
+    uint32_t b_user_size = b_size >= SSTABLE_KEY_TRAILER_SIZE ? b_size - SSTABLE_KEY_TRAILER_SIZE : b_size;
+    int cmp = sstable_compare_keys(a, a_user_size, b, b_user_size);
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    uint64_t a_trailer = a_size >= SSTABLE_KEY_TRAILER_SIZE ? sstable_load_trailer(a, a_size) : 0;
+    uint64_t b_trailer = b_size >= SSTABLE_KEY_TRAILER_SIZE ? sstable_load_trailer(b, b_size) : 0;
+    return (a_trailer < b_trailer) - (a_trailer > b_trailer);
+}
+
+void sstable_encode_trailer(char *dst, uint32_t user_key_size, uint64_t sequence, uint8_t type) {
+    uint64_t trailer = (sequence << 8) | type;
+    uint8_t *p = (uint8_t *)dst + user_key_size;
+    for (int i = 0; i < SSTABLE_KEY_TRAILER_SIZE; i++) {
+        p[i] = (uint8_t)(trailer >> (i * 8));
+    }
+}
+
+bool sstable_decode_trailer(const char *key, uint32_t key_size, uint64_t *sequence, uint8_t *type) {
+    if (key_size < SSTABLE_KEY_TRAILER_SIZE) {
+        return false;
+    }
+    uint64_t trailer = sstable_load_trailer(key, key_size);
+    *sequence = trailer >> 8;
+    *type = (uint8_t)(trailer & 0xFF);
+    return true;
+}
+
+// 扩充缓冲区到至少needed字节
+static bool sstable_reserve(char **data, uint32_t *capacity, uint64_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    if (needed > UINT32_MAX) {
+        return false;
+    }
+
+    uint64_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > UINT32_MAX) {
+        new_capacity = UINT32_MAX;
+    }
+
+    char *new_data = (char *)realloc(*data, new_capacity);
+    if (!new_data) {
+        return false;
+    }
+    *data = new_data;
+    *capacity = (uint32_t)new_capacity;
+    return true;
+}
+
+// 块构建器
+static void block_builder_init(sstable_block_builder *builder, uint32_t restart_interval) {
+    memset(builder, 0, sizeof(sstable_block_builder));
+    builder->restart_interval = restart_interval;
+}
+
+static void block_builder_reset(sstable_block_builder *builder) {
+    builder->size = 0;
+    builder->restart_count = 0;
+    builder->counter = 0;
+    builder->last_key_size = 0;
+    builder->entry_count = 0;
+}
+
+static void block_builder_free(sstable_block_builder *builder) {
+    free(builder->data);
+    free(builder->restarts);
+    free(builder->last_key);
+}
+
+// 块的当前大小（含重启点数组）
+static uint64_t block_builder_estimate(const sstable_block_builder *builder) {
+    return (uint64_t)builder->size + sizeof(uint32_t) * ((uint64_t)builder->restart_count + 1);
+}
+
+static bool block_builder_add(sstable_block_builder *builder, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    uint32_t shared = 0;
+    if (builder->entry_count == 0 || builder->counter == builder->restart_interval) {
+        // 重启点保存完整的键
+        if (builder->restart_count == builder->restart_capacity) {
+            uint32_t capacity = builder->restart_capacity ? builder->restart_capacity * 2 : 16;
+            uint32_t *restarts = (uint32_t *)realloc(builder->restarts, capacity * sizeof(uint32_t));
+            if (!restarts) {
+                return false;
+            }
+            builder->restarts = restarts;
+            builder->restart_capacity = capacity;
+        }
+        builder->restarts[builder->restart_count++] = builder->size;
+        builder->counter = 0;
+    } else {
+        uint32_t min_size = builder->last_key_size < key_size ? builder->last_key_size : key_size;
+        while (shared < min_size && builder->last_key[shared] == key[shared]) {
+            shared++;
+        }
+    }
+
+    uint32_t non_shared = key_size - shared;
+    if (!sstable_reserve(&builder->data, &builder->capacity, (uint64_t)builder->size + 15 + non_shared + value_size) ||
+        !sstable_reserve(&builder->last_key, &builder->last_key_capacity, key_size)) {
+        return false;
+    }
+
+    char *p = builder->data + builder->size;
+    p += sstable_put_varint32(p, shared);
+    p += sstable_put_varint32(p, non_shared);
+    p += sstable_put_varint32(p, value_size);
+    memcpy(p, key + shared, non_shared);
+    memcpy(p + non_shared, value, value_size);
+    builder->size = (uint32_t)(p + non_shared + value_size - builder->data);
+
+    memcpy(builder->last_key + shared, key + shared, non_shared);
+    builder->last_key_size = key_size;
+    builder->counter++;
+    builder->entry_count++;
+    return true;
+}
+
+// 在条目之后追加重启点数组和重启点个数，返回块内容
+static const char *block_builder_finish(sstable_block_builder *builder, uint32_t *size) {
+    uint64_t total = block_builder_estimate(builder);
+    if (!sstable_reserve(&builder->data, &builder->capacity, total)) {
+        return NULL;
+    }
+    memcpy(builder->data + builder->size, builder->restarts, sizeof(uint32_t) * builder->restart_count);
+    memcpy(builder->data + builder->size + sizeof(uint32_t) * builder->restart_count, &builder->restart_count, sizeof(uint32_t));
+    *size = (uint32_t)total;
+    return builder->data;
+}
+
+// SSTable构建器
+sstable_builder *sstable_builder_create(const char *filename, uint32_t bits_per_key, bool partition_filters, compression_codec codec) {
+    sstable_builder *builder = (sstable_builder *)malloc(sizeof(sstable_builder));
+    if (!builder) {
+        return NULL;
+    }
+    memset(builder, 0, sizeof(sstable_builder));
+    builder->bits_per_key = bits_per_key ? bits_per_key : SSTABLE_BLOOM_BITS_PER_KEY;
+    builder->partition_filters = partition_filters;
+    builder->codec = codec;
+
+    builder->filename = strdup(filename);
+    builder->file = fopen(filename, "wb");
+    if (!builder->filename || !builder->file) {
+        if (builder->file) {
+            fclose(builder->file);
+            remove(filename);
+        }
+        free(builder->filename);
+        free(builder);
+        return NULL;
+    }
+
+    block_builder_init(&builder->data_block, SSTABLE_RESTART_INTERVAL);
+    // 索引块的每个条目都是重启点，可以直接二分查找
+    block_builder_init(&builder->index_block, 1);
+    block_builder_init(&builder->filter_index_block, 1);
+    return builder;
+}
+
+static void sstable_builder_free(sstable_builder *builder) {
+    block_builder_free(&builder->data_block);
+    block_builder_free(&builder->index_block);
+    block_builder_free(&builder->filter_index_block);
+    free(builder->filter_keys);
+    free(builder->filter_key_offsets);
+    free(builder->compressed);
+    free(builder->filename);
+    free(builder);
+}
+
+// 写入一个块（块头和内容），codec不是COMPRESSION_NONE时压缩，压缩效果不明显时保存原内容
+static bool sstable_builder_write_block(sstable_builder *builder, const char *contents, uint32_t size, compression_codec codec,
+                                        sstable_block_handle *handle) {
+    sstable_block_header header;
+    memset(&header, 0, sizeof(header));
+    header.codec = COMPRESSION_NONE;
+    header.size = size;
+
+    uint64_t capacity = sizeof(uint32_t) + compression_bound(size);
+    if (codec != COMPRESSION_NONE && sstable_reserve(&builder->compressed, &builder->compressed_capacity, capacity)) {
+        size_t compressed = compression_compress(codec, contents, size, builder->compressed + sizeof(uint32_t), capacity - sizeof(uint32_t));
+        if (compressed > 0 && compressed + sizeof(uint32_t) < size - size / 8) {
+            memcpy(builder->compressed, &size, sizeof(uint32_t));
+            header.codec = (uint8_t)codec;
+            header.size = (uint32_t)(compressed + sizeof(uint32_t));
+            contents = builder->compressed;
+        }
+    }
+    header.checksum = wal_checksum(0, contents, header.size);
+
+    if (fwrite(&header, sizeof(header), 1, builder->file) != 1 || fwrite(contents, 1, header.size, builder->file) != header.size) {
+        builder->failed = true;
+        return false;
+    }
+
+    handle->offset = builder->offset;
+    handle->size = sizeof(header) + header.size;
+    builder->offset += handle->size;
+    return true;
+}
+
+// 记录用户键（同一个键的多个版本只记录一次）
+static bool sstable_builder_add_filter_key(sstable_builder *builder, const char *key, uint32_t key_size) {
+    if (builder->filter_key_count > 0) {
+        uint32_t last = builder->filter_key_offsets[builder->filter_key_count - 1];
+        if (sstable_compare_keys(builder->filter_keys + last, builder->filter_keys_size - last, key, key_size) == 0) {
+            return true;
+        }
+    }
+    if (builder->filter_key_count == builder->filter_key_capacity) {
+        uint32_t capacity = builder->filter_key_capacity ? builder->filter_key_capacity * 2 : 256;
+        uint32_t *offsets = (uint32_t *)realloc(builder->filter_key_offsets, capacity * sizeof(uint32_t));
+        if (!offsets) {
+            return false;
+        }
+        builder->filter_key_offsets = offsets;
+        builder->filter_key_capacity = capacity;
+    }
+    if (!sstable_reserve(&builder->filter_keys, &builder->filter_keys_capacity, (uint64_t)builder->filter_keys_size + key_size)) {
+        return false;
+    }
+    builder->filter_key_offsets[builder->filter_key_count++] = builder->filter_keys_size;
+    memcpy(builder->filter_keys + builder->filter_keys_size, key, key_size);
+    builder->filter_keys_size += key_size;
+    return true;
+}
+
+// 按记录的用户键构建过滤块（块数、哈希函数个数和分块布隆过滤器的位数组）并写入，之后清空记录的键
+static bool sstable_builder_write_filter(sstable_builder *builder, sstable_block_handle *handle) {
+    blocked_bloom_filter filter;
+    if (!blocked_bloom_filter_init(&filter, blocked_bloom_filter_block_count(builder->filter_key_count, builder->bits_per_key),
+                                   blocked_bloom_filter_hashes(builder->bits_per_key))) {
+        builder->failed = true;
+        return false;
+    }
+    for (uint32_t i = 0; i < builder->filter_key_count; i++) {
+        uint32_t offset = builder->filter_key_offsets[i];
+        uint32_t end = i + 1 < builder->filter_key_count ? builder->filter_key_offsets[i + 1] : builder->filter_keys_size;
+        blocked_bloom_filter_add(&filter, builder->filter_keys + offset, end - offset);
+    }
+
+    uint64_t bytes = (uint64_t)filter.block_count * BLOCKED_BLOOM_FILTER_BLOCK_SIZE;
+    char *contents = bytes <= UINT32_MAX - sizeof(uint32_t) * 2 ? (char *)malloc(sizeof(uint32_t) * 2 + bytes) : NULL;
+    if (!contents) {
+        blocked_bloom_filter_free(&filter);
+        builder->failed = true;
+        return false;
+    }
+    memcpy(contents, &filter.block_count, sizeof(uint32_t));
+    memcpy(contents + sizeof(uint32_t), &filter.hash_count, sizeof(uint32_t));
+    memcpy(contents + sizeof(uint32_t) * 2, filter.blocks, bytes);
+
+    bool success = sstable_builder_write_block(builder, contents, (uint32_t)(sizeof(uint32_t) * 2 + bytes), COMPRESSION_NONE, handle);
+    free(contents);
+    blocked_bloom_filter_free(&filter);
+    builder->filter_key_count = 0;
+    builder->filter_keys_size = 0;
+    return success;
+}
+
+// 写入一个过滤器分区，并在分区索引中记录分区的最后一个用户键和位置
+static bool sstable_builder_flush_filter_partition(sstable_builder *builder) {
+    if (builder->filter_key_count == 0) {
+        return true;
+    }
+
+    uint32_t last = builder->filter_key_offsets[builder->filter_key_count - 1];
+    uint32_t last_size = builder->filter_keys_size - last;
+    char *last_key = (char *)malloc(last_size ? last_size : 1);
+    if (!last_key) {
+        builder->failed = true;
+        return false;
+    }
+    memcpy(last_key, builder->filter_keys + last, last_size);
+
+    sstable_block_handle handle;
+    bool success = sstable_builder_write_filter(builder, &handle) &&
+                   block_builder_add(&builder->filter_index_block, last_key, last_size, (const char *)&handle, sizeof(handle));
+    free(last_key);
+    if (!success) {
+        builder->failed = true;
+        return false;
+    }
+    builder->filter_partition_count++;
+    return true;
+}
+
+// 写入当前数据块，并在索引块中记录块的最后一个键和位置
+static bool sstable_builder_flush_block(sstable_builder *builder) {
+    if (builder->data_block.entry_count == 0) {
+        return true;
+    }
+
+    uint32_t size = 0;
+    const char *contents = block_builder_finish(&builder->data_block, &size);
+    sstable_block_handle handle;
+    if (!contents || !sstable_builder_write_block(builder, contents, size, builder->codec, &handle) ||
+        !block_builder_add(&builder->index_block, builder->data_block.last_key, builder->data_block.last_key_size,
+                           (const char *)&handle, sizeof(handle))) {
+        builder->failed = true;
+        return false;
+    }
+
+    block_builder_reset(&builder->data_block);
+
+    // 过滤器分区在数据块边界切分
+    if (builder->partition_filters && builder->filter_key_count >= SSTABLE_FILTER_PARTITION_KEYS) {
+        return sstable_builder_flush_filter_partition(builder);
+    }
+    return true;
+}
+
+bool sstable_builder_add(sstable_builder *builder, const char *key, uint32_t key_size, const char *value, uint32_t value_size) {
+    if (builder->failed) {
+        return false;
+    }
+    if (key_size < SSTABLE_KEY_TRAILER_SIZE || !block_builder_add(&builder->data_block, key, key_size, value, value_size) ||
+        !sstable_builder_add_filter_key(builder, key, key_size - SSTABLE_KEY_TRAILER_SIZE)) {
+        builder->failed = true;
+        return false;
+    }
+    builder->entry_count++;
+
+    // 数据块达到目标大小后写入
+    if (block_builder_estimate(&builder->data_block) >= SSTABLE_BLOCK_SIZE) {
+        return sstable_builder_flush_block(builder);
+    }
+    return true;
+}
+
+bool sstable_builder_finish(sstable_builder *builder) {
+    sstable_footer footer;
+    memset(&footer, 0, sizeof(footer));
+    bool success = !builder->failed && sstable_builder_flush_block(builder);
+
+    // 过滤块：已经写过分区时写入最后一个分区和分区索引，否则整个文件一个过滤块
+    if (success && builder->filter_partition_count > 0) {
+        uint32_t size = 0;
+        const char *contents = NULL;
+        success = sstable_builder_flush_filter_partition(builder) &&
+                  (contents = block_builder_finish(&builder->filter_index_block, &size)) != NULL &&
+                  sstable_builder_write_block(builder, contents, size, COMPRESSION_NONE, &footer.filter);
+        footer.filter_partition_count = builder->filter_partition_count;
+    } else if (success) {
+        success = sstable_builder_write_filter(builder, &footer.filter);
+    }
+
+    // 索引块
+    if (success) {
+        uint32_t size = 0;
+        const char *contents = block_builder_finish(&builder->index_block, &size);
+        success = contents && sstable_builder_write_block(builder, contents, size, COMPRESSION_NONE, &footer.index);
+    }
+
+    footer.entry_count = builder->entry_count;
+    footer.magic = SSTABLE_MAGIC;
+    success = success && fwrite(&footer, sizeof(footer), 1, builder->file) == 1 &&
+              fflush(builder->file) == 0 && fsync(fileno(builder->file)) == 0;
+    if (fclose(builder->file) != 0) {
+        success = false;
+    }
+    if (!success) {
+        fprintf(stderr, "Failed to write SSTable: %s\n", builder->filename);
+        remove(builder->filename);
+    }
+
+    sstable_builder_free(builder);
+    return success;
+}
+
+void sstable_builder_abandon(sstable_builder *builder) {
+    if (!builder) {
+        return;
+    }
+
+    fclose(builder->file);
+    remove(builder->filename);
+    sstable_builder_free(builder);
+}
+
+// 块内迭代器
+bool sstable_block_iterator_init(sstable_block_iterator *iterator, const char *contents, uint32_t size) {
+    memset(iterator, 0, sizeof(sstable_block_iterator));
+    if (size < sizeof(uint32_t)) {
+        return false;
+    }
+
+    uint32_t restart_count;
+    memcpy(&restart_count, contents + size - sizeof(uint32_t), sizeof(uint32_t));
+    if (restart_count > (size - sizeof(uint32_t)) / sizeof(uint32_t)) {
+        return false;
+    }
+
+    iterator->data = contents;
+    iterator->restart_count = restart_count;
+    iterator->restarts_offset = size - sizeof(uint32_t) * (restart_count + 1);
+    iterator->next_offset = iterator->restarts_offset;
+    return true;
+}
+
+void sstable_block_iterator_destroy(sstable_block_iterator *iterator) {
+    free(iterator->key);
+    iterator->key = NULL;
+    iterator->valid = false;
+}
+
+static uint32_t block_iterator_restart(const sstable_block_iterator *iterator, uint32_t index) {
+    uint32_t offset;
+    memcpy(&offset, iterator->data + iterator->restarts_offset + sizeof(uint32_t) * index, sizeof(uint32_t));
+    return offset;
+}
+
+// 解析next_offset处的条目，之后的数据损坏时迭代器失效
+static void block_iterator_parse(sstable_block_iterator *iterator) {
+    const char *limit = iterator->data + iterator->restarts_offset;
+    const char *p = iterator->data + iterator->next_offset;
+    uint32_t shared = 0;
+    uint32_t non_shared = 0;
+    uint32_t value_size = 0;
+    iterator->valid = false;
+    if (p >= limit) {
+        return;
+    }
+
+    p = sstable_get_varint32(p, limit, &shared);
+    p = p ? sstable_get_varint32(p, limit, &non_shared) : NULL;
+    p = p ? sstable_get_varint32(p, limit, &value_size) : NULL;
+    if (!p || shared > iterator->key_size || (uint64_t)non_shared + value_size > (uint64_t)(limit - p) ||
+        !sstable_reserve(&iterator->key, &iterator->key_capacity, (uint64_t)shared + non_shared)) {
+        return;
+    }
+
+    memcpy(iterator->key + shared, p, non_shared);
+    iterator->key_size = shared + non_shared;
+    iterator->value = p + non_shared;
+    iterator->value_size = value_size;
+    iterator->next_offset = (uint32_t)(p + non_shared + value_size - iterator->data);
+    iterator->valid = true;
+}
+
+// 定位到第index个重启点（之后调用parse读取该条目）
+static void block_iterator_seek_restart(sstable_block_iterator *iterator, uint32_t index) {
+    iterator->key_size = 0;
+    iterator->next_offset = block_iterator_restart(iterator, index);
+}
+
+void sstable_block_iterator_seek_first(sstable_block_iterator *iterator) {
+    if (iterator->restart_count == 0) {
+        iterator->valid = false;
+        return;
+    }
+    block_iterator_seek_restart(iterator, 0);
+    block_iterator_parse(iterator);
+}
+
+void sstable_block_iterator_next(sstable_block_iterator *iterator) {
+    if (iterator->valid) {
+        block_iterator_parse(iterator);
+    }
+}
+
+void sstable_block_iterator_seek(sstable_block_iterator *iterator, const char *key, uint32_t key_size) {
+    if (iterator->restart_count == 0) {
+        iterator->valid = false;
+        return;
+    }
+
+    // 二分查找最后一个键小于key的重启点
+    uint32_t left = 0;
+    uint32_t right = iterator->restart_count - 1;
+    while (left < right) {
+        uint32_t mid = left + (right - left + 1) / 2;
+        block_iterator_seek_restart(iterator, mid);
+        block_iterator_parse(iterator);
+        if (!iterator->valid) {
+            return;
+        }
+        if (sstable_compare_internal_keys(iterator->key, iterator->key_size, key, key_size) < 0) {
+            left = mid;
+        } else {
+            right = mid - 1;
+        }
+    }
+
+    // 从重启点向后线性查找
+    block_iterator_seek_restart(iterator, left);
+    block_iterator_parse(iterator);
+    while (iterator->valid && sstable_compare_internal_keys(iterator->key, iterator->key_size, key, key_size) < 0) {
+        block_iterator_parse(iterator);
+    }
+}
+
+// SSTable读取器
+const char *sstable_reader_block(sstable_reader *reader, const sstable_block_handle *handle, uint32_t *size, char **owned) {
+    *owned = NULL;
+    sstable_block_header header;
+    if (handle->size < sizeof(header) || handle->offset > reader->size || handle->size > reader->size - handle->offset) {
+        return NULL;
+    }
+
+    memcpy(&header, reader->data + handle->offset, sizeof(header));
+    const char *contents = reader->data + handle->offset + sizeof(header);
+    if (header.size != handle->size - sizeof(header) || !compression_codec_valid(header.codec)) {
+        return NULL;
+    }
+    if (header.checksum != wal_checksum(0, contents, header.size)) {
+        fprintf(stderr, "SSTable block checksum mismatch at offset %llu\n", (unsigned long long)handle->offset);
+        return NULL;
+    }
+    if (header.codec == COMPRESSION_NONE) {
+        *size = header.size;
+        return contents;
+    }
+
+    uint32_t raw_size = 0;
+    char *buffer = NULL;
+    if (header.size >= sizeof(uint32_t)) {
+        memcpy(&raw_size, contents, sizeof(uint32_t));
+        buffer = (char *)malloc(raw_size ? raw_size : 1);
+    }
+    if (!buffer || !compression_decompress((compression_codec)header.codec, contents + sizeof(uint32_t), header.size - sizeof(uint32_t),
+                                           buffer, raw_size)) {
+        fprintf(stderr, "SSTable block decompression failed at offset %llu\n", (unsigned long long)handle->offset);
+        free(buffer);
+        return NULL;
+    }
+    *size = raw_size;
+    *owned = buffer;
+    return buffer;
+}
+
+static void sstable_cached_block_delete(uint64_t id, uint64_t offset, void *value) {
+    (void)id;
+    (void)offset;
+    free(value);
+}
+
+// 读取索引条目指向的数据块，从块缓存读取或放入块缓存时通过cached返回句柄（块内容在释放句柄之前有效），
+// 不在块缓存中的解压内容通过owned返回（由调用者释放）
+static bool sstable_reader_data_block(sstable_reader *reader, const sstable_block_iterator *index, sstable_block_iterator *block,
+                                      bool fill_cache, lsm_cache_handle **cached, char **owned) {
+    *cached = NULL;
+    *owned = NULL;
+    sstable_block_handle handle;
+    if (index->value_size != sizeof(handle)) {
+        return false;
+    }
+    memcpy(&handle, index->value, sizeof(handle));
+
+    if (reader->block_cache) {
+        *cached = lsm_cache_lookup(reader->block_cache, reader->file_number, handle.offset);
+        if (*cached) {
+            return sstable_block_iterator_init(block, (const char *)(*cached)->value, (uint32_t)(*cached)->charge);
+        }
+    }
+
+    uint32_t size = 0;
+    char *buffer = NULL;
+    const char *contents = sstable_reader_block(reader, &handle, &size, &buffer);
+    if (!contents) {
+        return false;
+    }
+    // 解压的内容直接放入块缓存，未压缩的内容从映射的文件中复制
+    if (reader->block_cache && fill_cache) {
+        char *copy = buffer ? buffer : (char *)malloc(size ? size : 1);
+        if (copy && !buffer) {
+            memcpy(copy, contents, size);
+        }
+        *cached = copy ? lsm_cache_insert(reader->block_cache, reader->file_number, handle.offset, copy, size,
+                                          sstable_cached_block_delete) : NULL;
+        if (*cached) {
+            contents = copy;
+            buffer = NULL;
+        } else if (copy != buffer) {
+            free(copy);
+        }
+    }
+    *owned = buffer;
+    return sstable_block_iterator_init(block, contents, size);
+}
+
+static char *sstable_copy_key(const char *key, uint32_t key_size) {
+    char *copy = (char *)malloc(key_size ? key_size : 1);
+    if (copy) {
+        memcpy(copy, key, key_size);
+    }
+    return copy;
+}
+
+// 读取最小键（第一个数据块的第一个键）和最大键（最后一个索引条目的键）
+static bool sstable_reader_load_key_range(sstable_reader *reader) {
+    sstable_block_iterator index;
+    if (!sstable_block_iterator_init(&index, reader->index, reader->index_size)) {
+        return false;
+    }
+
+    sstable_block_iterator_seek_first(&index);
+    if (!index.valid) {
+        sstable_block_iterator_destroy(&index);
+        return reader->entry_count == 0;
+    }
+
+    sstable_block_iterator block;
+    lsm_cache_handle *cached = NULL;
+    char *buffer = NULL;
+    bool success = sstable_reader_data_block(reader, &index, &block, false, &cached, &buffer);
+    if (success) {
+        sstable_block_iterator_seek_first(&block);
+        success = block.valid;
+        if (success) {
+            reader->smallest_key = sstable_copy_key(block.key, block.key_size);
+            reader->smallest_key_size = block.key_size;
+        }
+        sstable_block_iterator_destroy(&block);
+    }
+    if (cached) {
+        lsm_cache_release(reader->block_cache, cached);
+    }
+    free(buffer);
+
+    block_iterator_seek_restart(&index, index.restart_count - 1);
+    block_iterator_parse(&index);
+    if (success && index.valid) {
+        reader->largest_key = sstable_copy_key(index.key, index.key_size);
+        reader->largest_key_size = index.key_size;
+    }
+    sstable_block_iterator_destroy(&index);
+    return reader->smallest_key && reader->largest_key;
+}
+
+// 读取过滤块，位数组复制到按缓存行对齐的堆内存中
+static bool sstable_reader_load_filter(sstable_reader *reader, const sstable_block_handle *handle, blocked_bloom_filter *filter) {
+    uint32_t size = 0;
+    char *buffer = NULL;
+    const char *contents = sstable_reader_block(reader, handle, &size, &buffer);
+    if (!contents || size < sizeof(uint32_t) * 2) {
+        free(buffer);
+        return false;
+    }
+
+    uint32_t block_count;
+    uint32_t hash_count;
+    memcpy(&block_count, contents, sizeof(uint32_t));
+    memcpy(&hash_count, contents + sizeof(uint32_t), sizeof(uint32_t));
+    uint64_t bytes = (uint64_t)block_count * BLOCKED_BLOOM_FILTER_BLOCK_SIZE;
+    bool success = bytes <= size - sizeof(uint32_t) * 2 && blocked_bloom_filter_init(filter, block_count, hash_count);
+    if (success) {
+        memcpy(filter->blocks, contents + sizeof(uint32_t) * 2, bytes);
+    }
+    free(buffer);
+    return success;
+}
+
+// 读取分区索引和每个分区的过滤器
+static bool sstable_reader_load_filter_partitions(sstable_reader *reader, const sstable_block_handle *handle, uint64_t count) {
+    uint32_t size = 0;
+    char *buffer = NULL;
+    const char *contents = sstable_reader_block(reader, handle, &size, &buffer);
+    if (!contents || count > UINT32_MAX / sizeof(sstable_filter_partition)) {
+        free(buffer);
+        return false;
+    }
+    reader->filter_partitions = (sstable_filter_partition *)calloc(count, sizeof(sstable_filter_partition));
+    sstable_block_iterator index;
+    if (!reader->filter_partitions || !sstable_block_iterator_init(&index, contents, size)) {
+        free(buffer);
+        return false;
+    }
+
+    bool success = true;
+    sstable_block_iterator_seek_first(&index);
+    while (success && index.valid) {
+        sstable_filter_partition *partition = &reader->filter_partitions[reader->filter_partition_count];
+        sstable_block_handle partition_handle;
+        success = reader->filter_partition_count < count && index.value_size == sizeof(partition_handle);
+        if (success) {
+            memcpy(&partition_handle, index.value, sizeof(partition_handle));
+            partition->last_key = sstable_copy_key(index.key, index.key_size);
+            partition->last_key_size = index.key_size;
+            success = partition->last_key && sstable_reader_load_filter(reader, &partition_handle, &partition->filter);
+            reader->filter_partition_count++;
+        }
+        sstable_block_iterator_next(&index);
+    }
+    sstable_block_iterator_destroy(&index);
+    free(buffer);
+    return success && reader->filter_partition_count == count;
+}
+
+sstable_reader *sstable_reader_open(const char *filename, uint64_t file_number, lsm_cache *block_cache) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(sstable_footer)) {
+        close(fd);
+        return NULL;
+    }
+
+    sstable_reader *reader = (sstable_reader *)malloc(sizeof(sstable_reader));
+    if (!reader) {
+        close(fd);
+        return NULL;
+    }
+    memset(reader, 0, sizeof(sstable_reader));
+    reader->fd = fd;
+    reader->size = (uint64_t)st.st_size;
+    reader->file_number = file_number;
+    reader->block_cache = block_cache;
+
+    void *data = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        free(reader);
+        return NULL;
+    }
+    reader->data = (char *)data;
+
+    sstable_footer footer;
+    memcpy(&footer, reader->data + reader->size - sizeof(footer), sizeof(footer));
+    bool success = footer.magic == SSTABLE_MAGIC;
+    if (success) {
+        reader->entry_count = footer.entry_count;
+        reader->index = sstable_reader_block(reader, &footer.index, &reader->index_size, &reader->index_buffer);
+        success = reader->index != NULL;
+    }
+
+    // 过滤器常驻内存，点查询不需要为过滤块访问映射的文件
+    if (success && footer.filter_partition_count > 0) {
+        success = sstable_reader_load_filter_partitions(reader, &footer.filter, footer.filter_partition_count);
+    } else if (success) {
+        success = sstable_reader_load_filter(reader, &footer.filter, &reader->filter);
+    }
+
+    if (!success || !sstable_reader_load_key_range(reader)) {
+        fprintf(stderr, "Invalid SSTable: %s\n", filename);
+        sstable_reader_close(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void sstable_reader_close(sstable_reader *reader) {
+    if (!reader) {
+        return;
+    }
+
+    munmap(reader->data, reader->size);
+    close(reader->fd);
+    blocked_bloom_filter_free(&reader->filter);
+    for (uint32_t i = 0; i < reader->filter_partition_count; i++) {
+        free(reader->filter_partitions[i].last_key);
+        blocked_bloom_filter_free(&reader->filter_partitions[i].filter);
+    }
+    free(reader->filter_partitions);
+    free(reader->index_buffer);
+    free(reader->smallest_key);
+    free(reader->largest_key);
+    free(reader);
+}
+
+// SSTable迭代器
+sstable_iterator *sstable_iterator_create(sstable_reader *reader) {
+    sstable_iterator *iterator = (sstable_iterator *)malloc(sizeof(sstable_iterator));
+    if (!iterator) {
+        return NULL;
+    }
+    memset(iterator, 0, sizeof(sstable_iterator));
+    iterator->reader = reader;
+    iterator->readahead_size = SSTABLE_READAHEAD_SIZE;
+    iterator->fill_cache = true;
+    if (!sstable_block_iterator_init(&iterator->index, reader->index, reader->index_size)) {
+        free(iterator);
+        return NULL;
+    }
+    return iterator;
+}
+
+void sstable_iterator_destroy(sstable_iterator *iterator) {
+    if (!iterator) {
+        return;
+    }
+
+    sstable_block_iterator_destroy(&iterator->index);
+    sstable_block_iterator_destroy(&iterator->block);
+    if (iterator->block_handle) {
+        lsm_cache_release(iterator->reader->block_cache, iterator->block_handle);
+    }
+    free(iterator->block_buffer);
+    free(iterator);
+}
+
+// 读到预读范围之外的数据块时提示内核读入之后的页面（文件是映射的，缺页时才会读盘）
+static void sstable_iterator_readahead(sstable_iterator *iterator) {
+    sstable_block_handle handle;
+    if (iterator->readahead_size == 0 || iterator->index.value_size != sizeof(handle)) {
+        return;
+    }
+    memcpy(&handle, iterator->index.value, sizeof(handle));
+    sstable_reader *reader = iterator->reader;
+    if (handle.offset + handle.size <= iterator->readahead_offset || handle.offset >= reader->size) {
+        return;
+    }
+
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = handle.offset & ~(page_size - 1);
+    uint64_t end = handle.offset + iterator->readahead_size;
+    if (end > reader->size) {
+        end = reader->size;
+    }
+    posix_madvise(reader->data + start, end - start, POSIX_MADV_WILLNEED);
+    iterator->readahead_offset = end;
+}
+
+// 读入当前索引条目指向的数据块（沿用块内迭代器的键缓冲区）
+static bool sstable_iterator_load_block(sstable_iterator *iterator) {
+    sstable_iterator_readahead(iterator);
+    char *key = iterator->block.key;
+    uint32_t key_capacity = iterator->block.key_capacity;
+    if (iterator->block_handle) {
+        lsm_cache_release(iterator->reader->block_cache, iterator->block_handle);
+        iterator->block_handle = NULL;
+    }
+    free(iterator->block_buffer);
+    bool loaded = sstable_reader_data_block(iterator->reader, &iterator->index, &iterator->block, iterator->fill_cache,
+                                            &iterator->block_handle, &iterator->block_buffer);
+    if (!loaded) {
+        memset(&iterator->block, 0, sizeof(sstable_block_iterator));
+        iterator->corrupted = true;
+    }
+    iterator->block.key = key;
+    iterator->block.key_capacity = key_capacity;
+    return loaded;
+}
+
+// 当前数据块已经读完时移动到之后的数据块
+static void sstable_iterator_skip_empty_blocks(sstable_iterator *iterator) {
+    while (!iterator->block.valid && !iterator->corrupted) {
+        sstable_block_iterator_next(&iterator->index);
+        if (!iterator->index.valid || !sstable_iterator_load_block(iterator)) {
+            break;
+        }
+        sstable_block_iterator_seek_first(&iterator->block);
+    }
+    iterator->valid = iterator->block.valid && !iterator->corrupted;
+}
+
+void sstable_iterator_seek_first(sstable_iterator *iterator) {
+    iterator->block.valid = false;
+    sstable_block_iterator_seek_first(&iterator->index);
+    if (iterator->index.valid && sstable_iterator_load_block(iterator)) {
+        sstable_block_iterator_seek_first(&iterator->block);
+    }
+    sstable_iterator_skip_empty_blocks(iterator);
+}
+
+void sstable_iterator_seek(sstable_iterator *iterator, const char *key, uint32_t key_size) {
+    iterator->block.valid = false;
+    sstable_block_iterator_seek(&iterator->index, key, key_size);
+    if (iterator->index.valid && sstable_iterator_load_block(iterator)) {
+        sstable_block_iterator_seek(&iterator->block, key, key_size);
+    }
+    sstable_iterator_skip_empty_blocks(iterator);
+}
+
+void sstable_iterator_next(sstable_iterator *iterator) {
+    if (!iterator->valid) {
+        return;
+    }
+    sstable_block_iterator_next(&iterator->block);
+    sstable_iterator_skip_empty_blocks(iterator);
+}
+
+bool sstable_reader_may_contain(sstable_reader *reader, const char *key, uint32_t key_size) {
+    if (reader->filter_partition_count == 0) {
+        return blocked_bloom_filter_contains(&reader->filter, key, key_size);
+    }
+
+    // 二分查找第一个最后一个键不小于key的分区
+    uint32_t left = 0;
+    uint32_t right = reader->filter_partition_count;
+    while (left < right) {
+        uint32_t mid = left + (right - left) / 2;
+        const sstable_filter_partition *partition = &reader->filter_partitions[mid];
+        if (sstable_compare_keys(partition->last_key, partition->last_key_size, key, key_size) < 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left < reader->filter_partition_count &&
+           blocked_bloom_filter_contains(&reader->filter_partitions[left].filter, key, key_size);
+}
+
+bool sstable_reader_get(sstable_reader *reader, const char *key, uint32_t key_size, uint64_t sequence,
+                        sstable_version_callback callback, void *arg) {
+    if (!sstable_reader_may_contain(reader, key, key_size)) {
+        return true;
+    }
+
+    // 查找键(key, sequence)排在该用户键所有可见版本之前
+    char buffer[256];
+    char *seek_key = key_size + SSTABLE_KEY_TRAILER_SIZE <= sizeof(buffer) ? buffer
+                                                                         : (char *)malloc(key_size + SSTABLE_KEY_TRAILER_SIZE);
+    if (!seek_key) {
+        return false;
+    }
+    memcpy(seek_key, key, key_size);
+    sstable_encode_trailer(seek_key, key_size, sequence, SSTABLE_TYPE_SEEK);
+
+    // 同一个键的版本可能跨越数据块，用迭代器向后读取
+    sstable_iterator iterator;
+    memset(&iterator, 0, sizeof(iterator));
+    iterator.reader = reader;
+    iterator.fill_cache = true;
+    bool success = sstable_block_iterator_init(&iterator.index, reader->index, reader->index_size);
+    if (success) {
+        sstable_iterator_seek(&iterator, seek_key, key_size + SSTABLE_KEY_TRAILER_SIZE);
+        while (iterator.valid) {
+            uint64_t version = 0;
+            uint8_t type = 0;
+            if (!sstable_decode_trailer(iterator.block.key, iterator.block.key_size, &version, &type) ||
+                sstable_compare_keys(iterator.block.key, iterator.block.key_size - SSTABLE_KEY_TRAILER_SIZE, key, key_size) != 0 ||
+                !callback(version, type, iterator.block.value, iterator.block.value_size, arg)) {
+                break;
+            }
+            sstable_iterator_next(&iterator);
+        }
+        success = !iterator.corrupted;
+    }
+    sstable_block_iterator_destroy(&iterator.index);
+    sstable_block_iterator_destroy(&iterator.block);
+    if (iterator.block_handle) {
+        lsm_cache_release(reader->block_cache, iterator.block_handle);
+    }
+    free(iterator.block_buffer);
+    if (seek_key != buffer) {
+        free(seek_key);
+    }
+    return success;
+}
@@ -0,0 +1,240 @@
+#ifndef SSTABLE_H
+#define SSTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "bloom_filter.h"
+#include "lsm_cache.h"
+#include "../util/compression.h"
+
+// SSTable文件格式
+// [数据块1]...[数据块N][过滤块][索引块][文件尾]
+// 每个块由块头和内容组成，块头记录压缩算法、内容长度和内容的校验和。
+// 数据块按构建器的压缩算法压缩，压缩后小于原来的7/8时才保存压缩结果，压缩的内容前4字节是原长度；
+// 过滤块和索引块不压缩。
+// 数据块：按键排序的条目，每个条目只保存与前一个键不同的后缀；每SSTABLE_RESTART_INTERVAL个条目
+//   设一个重启点（保存完整的键），块末尾是重启点偏移数组和重启点个数，块内按重启点二分查找。
+// 索引块：每个数据块一个条目，键为该块的最后一个键，值为块的位置。
+// 过滤块：文件中全部用户键的分块布隆过滤器（块数、哈希函数个数和位数组），按实际键数和每键位数确定大小。
+//   分区过滤器：每SSTABLE_FILTER_PARTITION_KEYS个键左右（在数据块边界）一个过滤块，
+//   过滤块之后是分区索引块，键为分区的最后一个用户键，值为分区过滤块的位置。
+// 文件尾：过滤块（或分区索引块）和索引块的位置、条目数、过滤器分区数和魔数（定长，位于文件末尾）。
+// 读取时整个文件映射到内存，一次查找最多访问一个数据块。过滤器在打开时复制到堆内存中常驻，
+// 不存在的键只检查过滤器，不读文件。有块缓存时校验过的数据块按(文件编号, 偏移)缓存，再次访问不需要校验。
+// 文件中的键都是内部键：用户键之后是8字节的尾部（序号 << 8 | 类型，小端），按用户键升序、
+// 同一个用户键序号降序排列，因此同一个键的多个版本相邻且新版本在前。布隆过滤器只记录用户键。
+
+// SSTable参数
+#define SSTABLE_BLOCK_SIZE 4096 // 数据块的目标大小
+#define SSTABLE_RESTART_INTERVAL 16
+#define SSTABLE_BLOOM_BITS_PER_KEY BLOCKED_BLOOM_FILTER_DEFAULT_BITS_PER_KEY // 默认每个键的过滤器位数（假阳性率约1%）
+#define SSTABLE_FILTER_PARTITION_KEYS 4096 // 分区过滤器每个分区的键数
+#define SSTABLE_MAGIC 0x33454C4241545353ULL // "SSTABLE3"
+#define SSTABLE_READAHEAD_SIZE (256 * 1024) // 迭代器顺序读取时提前读入的字节数
+
+// 内部键尾部
+#define SSTABLE_KEY_TRAILER_SIZE 8
+#define SSTABLE_MAX_SEQUENCE ((1ULL << 56) - 1)
+
+// 条目类型（按某个序号查找时用最大的类型构造查找键，使其排在该序号的所有条目之前）
+typedef enum {
+    SSTABLE_TYPE_DELETE = 0,
+    SSTABLE_TYPE_PUT = 1,
+    SSTABLE_TYPE_MERGE = 2,
+    SSTABLE_TYPE_SEEK = SSTABLE_TYPE_MERGE
+} sstable_entry_type;
+
+// 块头
+typedef struct {
+    uint8_t codec; // 压缩算法（compression_codec）
+    uint8_t reserved[3];
+    uint32_t size; // 内容长度
+    uint32_t checksum; // 内容的CRC32C
+} sstable_block_header;
+
+// 块在文件中的位置（长度含块头）
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} sstable_block_handle;
+
+// 文件尾
+typedef struct {
+    sstable_block_handle filter;
+    sstable_block_handle index;
+    uint64_t entry_count;
+    uint64_t filter_partition_count; // 0表示整个文件一个过滤块
+    uint64_t magic;
+} sstable_footer;
+
+// 块构建器
+typedef struct {
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t *restarts; // 重启点偏移
+    uint32_t restart_count;
+    uint32_t restart_capacity;
+    uint32_t counter; // 当前重启点之后的条目数
+    uint32_t restart_interval;
+    char *last_key;
+    uint32_t last_key_size;
+    uint32_t last_key_capacity;
+    uint32_t entry_count;
+} sstable_block_builder;
+
+// SSTable构建器（内部键必须严格递增）
+typedef struct {
+    FILE *file;
+    char *filename;
+    uint64_t offset;
+    sstable_block_builder data_block;
+    sstable_block_builder index_block;
+    uint64_t entry_count;
+    bool failed;
+    compression_codec codec; // 数据块的压缩算法
+    char *compressed; // 压缩缓冲区
+    uint32_t compressed_capacity;
+    uint32_t bits_per_key;
+    bool partition_filters;
+    char *filter_keys; // 当前过滤器（分区）的用户键，写入过滤块时按实际键数构建布隆过滤器
+    uint32_t filter_keys_size;
+    uint32_t filter_keys_capacity;
+    uint32_t *filter_key_offsets;
+    uint32_t filter_key_count;
+    uint32_t filter_key_capacity;
+    sstable_block_builder filter_index_block; // 分区索引
+    uint32_t filter_partition_count;
+} sstable_builder;
+
+// 块内迭代器
+typedef struct {
+    const char *data;
+    uint32_t restarts_offset; // 重启点数组的偏移（之前是条目）
+    uint32_t restart_count;
+    uint32_t next_offset; // 下一个条目的偏移
+    char *key; // 当前键（由共享前缀和后缀拼成）
+    uint32_t key_size;
+    uint32_t key_capacity;
+    const char *value;
+    uint32_t value_size;
+    bool valid;
+} sstable_block_iterator;
+
+// 过滤器分区
+typedef struct {
+    char *last_key; // 分区中最后一个用户键
+    uint32_t last_key_size;
+    blocked_bloom_filter filter;
+} sstable_filter_partition;
+
+// SSTable读取器
+typedef struct {
+    int fd;
+    char *data; // 映射的文件内容
+    uint64_t size;
+    const char *index; // 索引块内容
+    uint32_t index_size;
+    char *index_buffer; // 索引块压缩时解压后的内容
+    blocked_bloom_filter filter; // 整个文件的过滤器（位数组在堆内存中，分区时为空）
+    sstable_filter_partition *filter_partitions;
+    uint32_t filter_partition_count;
+    uint64_t entry_count;
+    char *smallest_key;
+    uint32_t smallest_key_size;
+    char *largest_key;
+    uint32_t largest_key_size;
+    lsm_cache *block_cache; // 数据块缓存，NULL表示直接读取映射的文件
+    uint64_t file_number;
+} sstable_reader;
+
+// SSTable迭代器：索引块定位数据块，再在块内迭代
+typedef struct {
+    sstable_reader *reader;
+    sstable_block_iterator index;
+    sstable_block_iterator block;
+    bool valid;
+    bool corrupted; // 读到损坏的块，之后迭代器失效
+    uint64_t readahead_size; // 0表示不预读（点查询）
+    uint64_t readahead_offset; // 已经提示预读到的文件偏移
+    bool fill_cache; // 未命中的数据块是否放入块缓存（压缩时为false，避免冲掉热点数据块）
+    lsm_cache_handle *block_handle; // 当前数据块在块缓存中的句柄
+    char *block_buffer; // 当前数据块不在块缓存中且是解压得到的内容
+} sstable_iterator;
+
+// 查找时逐个返回的版本（从新到旧），返回false时停止
+typedef bool (*sstable_version_callback)(uint64_t sequence, uint8_t type, const char *value, uint32_t value_size, void *arg);
+
+// 比较两个键（按字节序，前缀较短的在前）
+int sstable_compare_keys(const char *a, uint32_t a_size, const char *b, uint32_t b_size);
+
+// 比较两个内部键（用户键升序，尾部降序）
+int sstable_compare_internal_keys(const char *a, uint32_t a_size, const char *b, uint32_t b_size);
+
+// 在dst的user_key_size处写入尾部，dst需要有user_key_size + SSTABLE_KEY_TRAILER_SIZE字节
+void sstable_encode_trailer(char *dst, uint32_t user_key_size, uint64_t sequence, uint8_t type);
+
+// 解析内部键的尾部，键过短时返回false
+bool sstable_decode_trailer(const char *key, uint32_t key_size, uint64_t *sequence, uint8_t *type);
+
+// 创建构建器，bits_per_key为0时使用SSTABLE_BLOOM_BITS_PER_KEY，partition_filters为true时大文件使用分区过滤器，
+// 数据块用codec压缩
+sstable_builder *sstable_builder_create(const char *filename, uint32_t bits_per_key, bool partition_filters, compression_codec codec);
+
+// 追加键值对（key为内部键）
+bool sstable_builder_add(sstable_builder *builder, const char *key, uint32_t key_size, const char *value, uint32_t value_size);
+
+// 写入过滤块、索引块和文件尾并持久化，之后释放构建器
+bool sstable_builder_finish(sstable_builder *builder);
+
+// 放弃构建，删除文件并释放构建器
+void sstable_builder_abandon(sstable_builder *builder);
+
+// 打开SSTable文件，block_cache不为NULL时数据块通过它按(file_number, 偏移)缓存
+sstable_reader *sstable_reader_open(const char *filename, uint64_t file_number, lsm_cache *block_cache);
+
+// 关闭SSTable文件
+void sstable_reader_close(sstable_reader *reader);
+
+// 用户键是否可能在文件中（只检查常驻内存的过滤器）
+bool sstable_reader_may_contain(sstable_reader *reader, const char *key, uint32_t key_size);
+
+// 查找用户键序号不大于sequence的版本，从新到旧依次交给callback，读到损坏的块时返回false
+bool sstable_reader_get(sstable_reader *reader, const char *key, uint32_t key_size, uint64_t sequence,
+                        sstable_version_callback callback, void *arg);
+
+// 初始化块内迭代器（内容来自已校验的块），失败时返回false
+bool sstable_block_iterator_init(sstable_block_iterator *iterator, const char *contents, uint32_t size);
+
+// 释放块内迭代器的键缓冲区
+void sstable_block_iterator_destroy(sstable_block_iterator *iterator);
+
+// 定位到第一个条目
+void sstable_block_iterator_seek_first(sstable_block_iterator *iterator);
+
+// 定位到第一个大于等于key（内部键）的条目
+void sstable_block_iterator_seek(sstable_block_iterator *iterator, const char *key, uint32_t key_size);
+
+// 移动到下一个条目
+void sstable_block_iterator_next(sstable_block_iterator *iterator);
+
+// 读取并校验块，返回块内容；压缩的块解压到堆内存中并通过owned返回（由调用者释放），否则owned为NULL
+const char *sstable_reader_block(sstable_reader *reader, const sstable_block_handle *handle, uint32_t *size, char **owned);
+
+// 创建SSTable迭代器（创建后未定位），读取数据块时预读之后的SSTABLE_READAHEAD_SIZE字节
+sstable_iterator *sstable_iterator_create(sstable_reader *reader);
+
+// 销毁SSTable迭代器
+void sstable_iterator_destroy(sstable_iterator *iterator);
+
+// 定位到第一个条目
+void sstable_iterator_seek_first(sstable_iterator *iterator);
+
+// 定位到第一个大于等于key（内部键）的条目
+void sstable_iterator_seek(sstable_iterator *iterator, const char *key, uint32_t key_size);
+
+// 移动到下一个条目（当前条目的键和值在iterator->block中）
+void sstable_iterator_next(sstable_iterator *iterator);
+
+#endif // SSTABLE_H
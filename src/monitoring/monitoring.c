@@ -1,4 +1,5 @@
 #include "monitoring.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -274,6 +275,27 @@ void monitoring_record_timer(monitoring_system *monitoring, const char *name, do
     }
 }
 
+// 记录缓存统计
+void monitoring_record_cache(monitoring_system *monitoring, const char *prefix, uint64_t hits, uint64_t misses, uint64_t usage) {
+    if (!monitoring || !prefix || !monitoring->enabled) {
+        return;
+    }
+    
+    static const char *suffixes[] = {"hits", "misses", "hit_rate", "usage"};
+    static const char *descriptions[] = {"Cache hits", "Cache misses", "Cache hit rate", "Cache usage"};
+    uint64_t lookups = hits + misses;
+    double values[] = {(double)hits, (double)misses, lookups ? (double)hits / (double)lookups : 0.0, (double)usage};
+    
+    char name[128];
+    for (int i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "%s.%s", prefix, suffixes[i]);
+        if (!find_stat(monitoring, name)) {
+            monitoring_register_gauge(monitoring, name, descriptions[i]);
+        }
+        monitoring_set_gauge(monitoring, name, values[i]);
+    }
+}
+
 // 获取统计值
 bool monitoring_get_stat(monitoring_system *monitoring, const char *name, void *value) {
     if (!monitoring || !name || !value) {
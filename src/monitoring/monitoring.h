@@ -81,6 +81,10 @@ void monitoring_set_gauge(monitoring_system *monitoring, const char *name, doubl
 // 记录计时器
 void monitoring_record_timer(monitoring_system *monitoring, const char *name, double value);
 
+// 记录缓存的命中次数、未命中次数、命中率和占用量（仪表盘prefix.hits、prefix.misses、prefix.hit_rate、prefix.usage，
+// 第一次记录时注册）
+void monitoring_record_cache(monitoring_system *monitoring, const char *prefix, uint64_t hits, uint64_t misses, uint64_t usage);
+
 // 获取统计值
 bool monitoring_get_stat(monitoring_system *monitoring, const char *name, void *value);
 
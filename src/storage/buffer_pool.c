@@ -0,0 +1,416 @@
+#include "buffer_pool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BUFFER_POOL_NO_FRAME UINT32_MAX
+
+// 页面校验和（跳过checksum字段）
+static uint32_t buffer_pool_page_checksum(const BufferPool* pool, const uint8_t* data) {
+    size_t skip = offsetof(BufferPageHeader, checksum);
+    uint32_t checksum = wal_checksum(0, data, skip);
+    skip += sizeof(uint32_t);
+    return wal_checksum(checksum, data + skip, pool->page_size - skip);
+}
+
+static bool buffer_pool_page_is_zero(const BufferPool* pool, const uint8_t* data) {
+    for (size_t i = 0; i < pool->page_size; i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline uint32_t buffer_pool_bucket(const BufferPool* pool, uint64_t page_id) {
+    return (uint32_t)((page_id * 0x9E3779B97F4A7C15ULL) >> 32) & (pool->bucket_count - 1);
+}
+
+// 在页表中查找页面所在的帧
+static uint32_t buffer_pool_lookup(const BufferPool* pool, uint64_t page_id) {
+    uint32_t index = pool->buckets[buffer_pool_bucket(pool, page_id)];
+    while (index != BUFFER_POOL_NO_FRAME && pool->frames[index].page_id != page_id) {
+        index = pool->frames[index].hash_next;
+    }
+    return index;
+}
+
+static void buffer_pool_table_insert(BufferPool* pool, uint32_t index) {
+    uint32_t bucket = buffer_pool_bucket(pool, pool->frames[index].page_id);
+    pool->frames[index].hash_next = pool->buckets[bucket];
+    pool->buckets[bucket] = index;
+}
+
+static void buffer_pool_table_remove(BufferPool* pool, uint32_t index) {
+    uint32_t* link = &pool->buckets[buffer_pool_bucket(pool, pool->frames[index].page_id)];
+    while (*link != index) {
+        link = &pool->frames[*link].hash_next;
+    }
+    *link = pool->frames[index].hash_next;
+}
+
+#define BUFFER_POOL_RETRY (UINT32_MAX - 1)
+
+// 写回页面内容：先持久化日志再写文件（淘汰时在锁外写回页面的副本）
+static bool buffer_pool_write_page(BufferPool* pool, uint64_t page_id, uint8_t* data) {
+    BufferPageHeader* header = (BufferPageHeader*)data;
+
+    // 先写日志：页面反映的日志记录必须先于页面持久化
+    if (pool->wal && header->lsn > 0 && !wal_flush(pool->wal, header->lsn)) {
+        fprintf(stderr, "Failed to flush WAL before writing page %llu\n", (unsigned long long)page_id);
+        return false;
+    }
+
+    header->checksum = buffer_pool_page_checksum(pool, data);
+    size_t done = 0;
+    while (done < pool->page_size) {
+        ssize_t written = pwrite(pool->fd, data + done, pool->page_size - done,
+                                 (off_t)(page_id * pool->page_size + done));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            fprintf(stderr, "Failed to write page %llu\n", (unsigned long long)page_id);
+            return false;
+        }
+        done += (size_t)written;
+    }
+    return true;
+}
+
+// 写回帧中的页面（调用者持有互斥锁）
+static bool buffer_pool_write_frame(BufferPool* pool, BufferFrame* frame) {
+    if (!buffer_pool_write_page(pool, frame->page_id, frame->data)) {
+        return false;
+    }
+    if (frame->page_id >= pool->file_pages) {
+        pool->file_pages = frame->page_id + 1;
+    }
+    frame->dirty = false;
+    pool->stats.writes++;
+    return true;
+}
+
+// 在锁外写回要淘汰的脏页（调用者持有互斥锁，返回时重新持有）：
+// 写回期间帧保持固定，锁内复制的页面在锁外写回；期间帧被再次修改时仍是脏页
+static bool buffer_pool_write_victim(BufferPool* pool, BufferFrame* frame) {
+    uint8_t* copy = (uint8_t*)malloc(pool->page_size);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, frame->data, pool->page_size);
+    uint64_t page_id = frame->page_id;
+    frame->pin_count++;
+    frame->dirty = false;
+    pool->writes_in_flight++;
+
+    pthread_mutex_unlock(&pool->mutex);
+    bool success = buffer_pool_write_page(pool, page_id, copy);
+    pthread_mutex_lock(&pool->mutex);
+
+    free(copy);
+    frame->pin_count--;
+    if (success) {
+        if (page_id >= pool->file_pages) {
+            pool->file_pages = page_id + 1;
+        }
+        pool->stats.writes++;
+    } else {
+        frame->dirty = true;
+    }
+    pool->writes_in_flight--;
+    pthread_cond_broadcast(&pool->write_cond);
+    return success;
+}
+
+// 读入页面到帧（调用者持有互斥锁）
+static bool buffer_pool_read_frame(BufferPool* pool, BufferFrame* frame) {
+    memset(frame->data, 0, pool->page_size);
+    if (frame->page_id >= pool->file_pages) {
+        return true;
+    }
+
+    size_t done = 0;
+    while (done < pool->page_size) {
+        ssize_t read_size = pread(pool->fd, frame->data + done, pool->page_size - done,
+                                  (off_t)(frame->page_id * pool->page_size + done));
+        if (read_size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_size < 0) {
+            fprintf(stderr, "Failed to read page %llu\n", (unsigned long long)frame->page_id);
+            return false;
+        }
+        if (read_size == 0) {
+            break;
+        }
+        done += (size_t)read_size;
+    }
+
+    // 从未写入过的页面全为零，不做校验
+    const BufferPageHeader* header = (const BufferPageHeader*)frame->data;
+    if (header->checksum == buffer_pool_page_checksum(pool, frame->data) || buffer_pool_page_is_zero(pool, frame->data)) {
+        return true;
+    }
+
+    pool->stats.torn_pages++;
+    if (!pool->recovering) {
+        fprintf(stderr, "Checksum mismatch on page %llu\n", (unsigned long long)frame->page_id);
+        return false;
+    }
+    memset(frame->data, 0, pool->page_size);
+    return true;
+}
+
+// 按CLOCK算法选择一个未固定的帧。选中脏页时在锁外写回后返回BUFFER_POOL_RETRY：
+// 期间锁被释放过，调用者需要重新查找页面后再次淘汰（写回的帧没有被再次访问时成为干净的候选）
+static uint32_t buffer_pool_evict(BufferPool* pool) {
+    for (uint32_t scanned = 0; scanned < pool->frame_count * 2; scanned++) {
+        uint32_t index = pool->clock_hand;
+        pool->clock_hand = (pool->clock_hand + 1) % pool->frame_count;
+
+        BufferFrame* frame = &pool->frames[index];
+        if (!frame->valid) {
+            return index;
+        }
+        if (frame->pin_count > 0 || frame->unlogged) {
+            continue;
+        }
+        if (frame->referenced) {
+            frame->referenced = false;
+            continue;
+        }
+
+        if (frame->dirty) {
+            return buffer_pool_write_victim(pool, frame) ? BUFFER_POOL_RETRY : BUFFER_POOL_NO_FRAME;
+        }
+        buffer_pool_table_remove(pool, index);
+        frame->valid = false;
+        pool->stats.evictions++;
+        return index;
+    }
+    return BUFFER_POOL_NO_FRAME;
+}
+
+// 打开页文件
+BufferPool* buffer_pool_open(const char* path, size_t page_size, uint32_t frame_count, WriteAheadLog* wal) {
+    if (!path || page_size < BUFFER_POOL_MIN_PAGE_SIZE || page_size > BUFFER_POOL_MAX_PAGE_SIZE ||
+        (page_size & (page_size - 1)) != 0 || frame_count == 0) {
+        return NULL;
+    }
+
+    BufferPool* pool = (BufferPool*)malloc(sizeof(BufferPool));
+    if (!pool) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(BufferPool));
+    pool->page_size = page_size;
+    pool->frame_count = frame_count;
+    pool->wal = wal;
+
+    // 页表桶数取不小于帧数的2的幂
+    pool->bucket_count = 1;
+    while (pool->bucket_count < frame_count) {
+        pool->bucket_count <<= 1;
+    }
+
+    pool->frames = (BufferFrame*)calloc(frame_count, sizeof(BufferFrame));
+    pool->buckets = (uint32_t*)malloc(sizeof(uint32_t) * pool->bucket_count);
+    void* memory = NULL;
+    if (!pool->frames || !pool->buckets || posix_memalign(&memory, page_size, page_size * frame_count) != 0) {
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+    pool->memory = (uint8_t*)memory;
+    for (uint32_t i = 0; i < frame_count; i++) {
+        pool->frames[i].data = pool->memory + (size_t)i * page_size;
+        pool->frames[i].hash_next = BUFFER_POOL_NO_FRAME;
+    }
+    for (uint32_t i = 0; i < pool->bucket_count; i++) {
+        pool->buckets[i] = BUFFER_POOL_NO_FRAME;
+    }
+
+    pool->fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (pool->fd < 0 || fstat(pool->fd, &st) != 0) {
+        fprintf(stderr, "Failed to open page file: %s\n", path);
+        if (pool->fd >= 0) {
+            close(pool->fd);
+        }
+        free(pool->memory);
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+    // 文件末尾不完整的页面按全零读入
+    pool->file_pages = ((uint64_t)st.st_size + page_size - 1) / page_size;
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->write_cond, NULL);
+    return pool;
+}
+
+// 关闭页文件
+void buffer_pool_close(BufferPool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    buffer_pool_flush(pool);
+    close(pool->fd);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->write_cond);
+    free(pool->memory);
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool);
+}
+
+// 读取页面并固定
+BufferFrame* buffer_pool_fetch(BufferPool* pool, uint64_t page_id) {
+    if (!pool) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    // 淘汰时写回脏页会释放锁，之后页面可能已经被其他线程读入
+    uint32_t index = BUFFER_POOL_RETRY;
+    while (index == BUFFER_POOL_RETRY) {
+        index = buffer_pool_lookup(pool, page_id);
+        if (index != BUFFER_POOL_NO_FRAME) {
+            BufferFrame* frame = &pool->frames[index];
+            frame->pin_count++;
+            frame->referenced = true;
+            pool->stats.hits++;
+            pthread_mutex_unlock(&pool->mutex);
+            return frame;
+        }
+        index = buffer_pool_evict(pool);
+    }
+    if (index == BUFFER_POOL_NO_FRAME) {
+        pthread_mutex_unlock(&pool->mutex);
+        fprintf(stderr, "No free frame in buffer pool\n");
+        return NULL;
+    }
+
+    BufferFrame* frame = &pool->frames[index];
+    frame->page_id = page_id;
+    if (!buffer_pool_read_frame(pool, frame)) {
+        pthread_mutex_unlock(&pool->mutex);
+        return NULL;
+    }
+    frame->valid = true;
+    frame->dirty = false;
+    frame->referenced = true;
+    frame->pin_count = 1;
+    buffer_pool_table_insert(pool, index);
+    pool->stats.misses++;
+
+    pthread_mutex_unlock(&pool->mutex);
+    return frame;
+}
+
+// 再固定一次
+void buffer_pool_pin(BufferPool* pool, BufferFrame* frame) {
+    pthread_mutex_lock(&pool->mutex);
+    frame->pin_count++;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// 取消固定
+void buffer_pool_unpin(BufferPool* pool, BufferFrame* frame, bool dirty) {
+    if (!pool || !frame) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    if (dirty) {
+        frame->dirty = true;
+    }
+    if (frame->pin_count > 0) {
+        frame->pin_count--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// 取消固定，帧中的修改没有日志
+void buffer_pool_unpin_unlogged(BufferPool* pool, BufferFrame* frame) {
+    if (!pool || !frame) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    frame->unlogged = true;
+    if (frame->pin_count > 0) {
+        frame->pin_count--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// 写回全部脏页
+bool buffer_pool_flush(BufferPool* pool) {
+    if (!pool) {
+        return false;
+    }
+
+    // fsync之前等待锁外的写回完成
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->writes_in_flight > 0) {
+        pthread_cond_wait(&pool->write_cond, &pool->mutex);
+    }
+
+    // 先一次持久化全部脏页需要的日志，之后逐页写回时不再等待
+    uint64_t max_lsn = 0;
+    for (uint32_t i = 0; i < pool->frame_count; i++) {
+        const BufferFrame* frame = &pool->frames[i];
+        uint64_t lsn = ((const BufferPageHeader*)frame->data)->lsn;
+        if (frame->valid && frame->dirty && !frame->unlogged && lsn > max_lsn) {
+            max_lsn = lsn;
+        }
+    }
+    bool success = !pool->wal || max_lsn == 0 || wal_flush(pool->wal, max_lsn);
+
+    // 没有日志的修改不写回，文件中保持修改之前的页面
+    bool unlogged = false;
+    for (uint32_t i = 0; i < pool->frame_count && success; i++) {
+        BufferFrame* frame = &pool->frames[i];
+        unlogged = unlogged || (frame->valid && frame->unlogged);
+        if (frame->valid && frame->dirty && !frame->unlogged) {
+            success = buffer_pool_write_frame(pool, frame);
+        }
+    }
+    if (success && fsync(pool->fd) != 0) {
+        fprintf(stderr, "Failed to sync page file\n");
+        success = false;
+    }
+    success = success && !unlogged;
+
+    pthread_mutex_unlock(&pool->mutex);
+    return success;
+}
+
+// 设置恢复模式
+void buffer_pool_set_recovering(BufferPool* pool, bool recovering) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->recovering = recovering;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// 获取统计信息
+void buffer_pool_get_stats(BufferPool* pool, BufferPoolStats* stats) {
+    if (!pool || !stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,101 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "wal.h"
+
+// 缓冲池
+// 页文件按固定大小的页划分，页号即文件中的位置（页号 * 页大小）。页面通过缓冲池读入内存帧，
+// 使用期间固定（pin）在帧中，未固定的帧按CLOCK算法淘汰。写回脏页之前先把日志持久化到
+// 页面的LSN（先写日志规则），每个页面写回时计算校验和，读入时校验，检测不完整的写入。
+// 淘汰脏页时在锁内复制页面，之后释放锁等待日志持久化并写回副本，期间其他页面的读取不受影响。
+// 修改没有记录日志的帧（写日志失败）不再写回也不再淘汰，重启时按日志恢复到修改之前。
+
+// 页大小范围
+#define BUFFER_POOL_MIN_PAGE_SIZE 512
+#define BUFFER_POOL_MAX_PAGE_SIZE 65536
+
+// 页面头部（由缓冲池维护，位于每个页面的开头）
+typedef struct {
+    uint64_t lsn; // 最后一次修改对应日志记录的结束LSN
+    uint32_t checksum; // 页面除本字段外全部内容的校验和（写回时计算）
+    uint32_t reserved;
+} BufferPageHeader;
+
+// 缓冲帧
+typedef struct {
+    uint64_t page_id;
+    uint8_t* data; // 页面内容（page_size字节）
+    uint32_t pin_count; // 固定计数，非零时不会被淘汰
+    uint32_t hash_next; // 页表中同一桶的下一个帧（UINT32_MAX表示没有）
+    bool valid; // 帧中是否有页面
+    bool dirty;
+    bool referenced; // CLOCK访问位
+    bool unlogged; // 有没有记录日志的修改，不能写回
+} BufferFrame;
+
+// 缓冲池统计
+typedef struct {
+    uint64_t hits; // 页面已在缓冲池中
+    uint64_t misses; // 需要从文件读入
+    uint64_t writes; // 写回的页面数
+    uint64_t evictions; // 淘汰的页面数
+    uint64_t torn_pages; // 校验失败的页面数
+} BufferPoolStats;
+
+// 缓冲池
+typedef struct BufferPool {
+    int fd;
+    size_t page_size;
+    uint64_t file_pages; // 文件中已有的页数，之后的页面读入时为全零
+
+    BufferFrame* frames;
+    uint8_t* memory; // 全部帧的页面内容（按页大小对齐）
+    uint32_t frame_count;
+    uint32_t clock_hand;
+
+    // 页表：页号到帧的哈希表（帧内链接）
+    uint32_t* buckets;
+    uint32_t bucket_count;
+
+    WriteAheadLog* wal; // 写回脏页前持久化日志，NULL表示不使用日志
+    bool recovering; // 恢复期间校验失败的页面作为全零页面返回，由日志重做
+    uint32_t writes_in_flight; // 淘汰时在锁外写回的页面数
+
+    pthread_mutex_t mutex; // 保护页表、帧状态和文件读写（淘汰的脏页在锁外写回）
+    pthread_cond_t write_cond; // 锁外的写回完成
+    BufferPoolStats stats;
+} BufferPool;
+
+// 打开页文件（不存在时创建）
+BufferPool* buffer_pool_open(const char* path, size_t page_size, uint32_t frame_count, WriteAheadLog* wal);
+
+// 写回全部脏页并关闭页文件
+void buffer_pool_close(BufferPool* pool);
+
+// 读取页面并固定在帧中，所有帧都被固定或读取失败时返回NULL
+BufferFrame* buffer_pool_fetch(BufferPool* pool, uint64_t page_id);
+
+// 再固定一次已固定的帧
+void buffer_pool_pin(BufferPool* pool, BufferFrame* frame);
+
+// 取消固定，dirty表示页面已修改
+void buffer_pool_unpin(BufferPool* pool, BufferFrame* frame, bool dirty);
+
+// 取消固定，帧中有没有记录日志的修改：之后不再写回也不再淘汰
+// （内存中保持修改后的内容，文件中的页面停留在修改之前，重启时由日志恢复）
+void buffer_pool_unpin_unlogged(BufferPool* pool, BufferFrame* frame);
+
+// 写回全部脏页并fsync（调用者保证期间没有修改页面），有不能写回的帧时返回false
+bool buffer_pool_flush(BufferPool* pool);
+
+// 恢复模式：校验失败的页面作为全零页面返回（页面LSN为0，由日志中的页面镜像重建）
+void buffer_pool_set_recovering(BufferPool* pool, bool recovering);
+
+// 获取统计信息
+void buffer_pool_get_stats(BufferPool* pool, BufferPoolStats* stats);
+
+#endif // BUFFER_POOL_H
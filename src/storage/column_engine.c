@@ -19,9 +19,14 @@ StorageEngine* create_column_engine(void* config) {
     data->tables = NULL;
     data->table_count = 0;
     data->next_transaction_id = 1;
+    pthread_rwlock_init(&data->catalog_lock, NULL);
 
     engine->type = STORAGE_ENGINE_COLUMN;
     engine->name = "column_engine";
+    engine->wal = NULL;
+    engine->active_transaction = 0;
+    engine->transaction_first_lsn = 0;
+    engine->transaction_base = 0;
     engine->data = data;
 
     // 设置函数指针
@@ -32,18 +37,25 @@ StorageEngine* create_column_engine(void* config) {
     engine->update = column_engine_update;
     engine->delete = column_engine_delete;
     engine->select = column_engine_select;
+    engine->select_view = column_engine_select_view;
+    engine->release_view = column_engine_release_view;
+    engine->scan_open = column_engine_scan_open;
+    engine->scan_next = column_engine_scan_next;
+    engine->scan_close = column_engine_scan_close;
     engine->batch_insert = column_engine_batch_insert;
     engine->begin_transaction = column_engine_begin_transaction;
     engine->commit_transaction = column_engine_commit_transaction;
     engine->rollback_transaction = column_engine_rollback_transaction;
     engine->optimize = column_engine_optimize;
     engine->checkpoint = column_engine_checkpoint;
+    engine->redo_insert = column_engine_redo_insert;
+    engine->snapshot_table = column_engine_snapshot_table;
     engine->destroy = column_engine_destroy;
 
     return engine;
 }
 
-// 获取列存引擎表数据
+// 获取列存引擎表数据（调用方需持有目录锁）
 ColumnEngineTableData* column_engine_get_table_data(StorageEngine* engine, const char* table_name) {
     if (!engine || !table_name) {
         return NULL;
@@ -59,6 +71,45 @@ ColumnEngineTableData* column_engine_get_table_data(StorageEngine* engine, const
     return NULL;
 }
 
+// 查找表并加锁，成功时同时持有目录读锁和表锁，目录读锁保证操作期间表不会被删除
+ColumnEngineTableData* column_engine_lock_table(StorageEngine* engine, const char* table_name, bool write) {
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        return NULL;
+    }
+
+    if (write) {
+        pthread_rwlock_wrlock(&table_data->lock);
+    } else {
+        pthread_rwlock_rdlock(&table_data->lock);
+    }
+
+    return table_data;
+}
+
+// 释放column_engine_lock_table获取的锁
+void column_engine_unlock_table(StorageEngine* engine, ColumnEngineTableData* table_data) {
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    pthread_rwlock_unlock(&table_data->lock);
+    pthread_rwlock_unlock(&data->catalog_lock);
+}
+
+// 检查表数据是否仍属于引擎（调用方需持有目录锁）
+bool column_engine_has_table_data(StorageEngine* engine, ColumnEngineTableData* table_data) {
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    for (size_t i = 0; i < data->table_count; i++) {
+        if (data->tables[i] == table_data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 // 扩展列容量
 bool column_engine_expand_column(ColumnEngineColumnData* column_data, size_t new_capacity) {
     if (!column_data || new_capacity <= column_data->capacity) {
@@ -95,6 +146,15 @@ bool column_engine_expand_table(StorageEngine* engine, ColumnEngineTableData* ta
         return false;
     }
 
+    bool* new_deleted = (bool*)realloc(table_data->deleted, sizeof(bool) * new_capacity);
+    if (!new_deleted) {
+        return false;
+    }
+    for (size_t i = table_data->capacity; i < new_capacity; i++) {
+        new_deleted[i] = false;
+    }
+    table_data->deleted = new_deleted;
+
     // 扩展所有列的容量
     for (size_t i = 0; i < table_data->column_count; i++) {
         if (!column_engine_expand_column(table_data->columns[i], new_capacity)) {
@@ -106,6 +166,64 @@ bool column_engine_expand_table(StorageEngine* engine, ColumnEngineTableData* ta
     return true;
 }
 
+// 回收旧值（存在只读视图时延迟到最后一个视图释放，调用方需持有表写锁）
+void column_engine_retire_value(ColumnEngineTableData* table_data, void* value) {
+    if (!value) {
+        return;
+    }
+
+    pthread_mutex_lock(&table_data->retire_lock);
+
+    if (table_data->view_count == 0) {
+        pthread_mutex_unlock(&table_data->retire_lock);
+        free(value);
+        return;
+    }
+
+    if (table_data->retired_count >= table_data->retired_capacity) {
+        size_t new_capacity = table_data->retired_capacity ? table_data->retired_capacity * 2 : 64;
+        void** new_values = (void**)realloc(table_data->retired_values, sizeof(void*) * new_capacity);
+        if (!new_values) {
+            // 无法延迟回收时宁可泄漏，也不能释放视图可能仍在引用的值
+            pthread_mutex_unlock(&table_data->retire_lock);
+            return;
+        }
+        table_data->retired_values = new_values;
+        table_data->retired_capacity = new_capacity;
+    }
+
+    table_data->retired_values[table_data->retired_count++] = value;
+
+    pthread_mutex_unlock(&table_data->retire_lock);
+}
+
+// 释放所有延迟回收的旧值（调用方需持有retire_lock或独占表）
+void column_engine_reclaim_values(ColumnEngineTableData* table_data) {
+    for (size_t i = 0; i < table_data->retired_count; i++) {
+        free(table_data->retired_values[i]);
+    }
+    table_data->retired_count = 0;
+}
+
+// 固定表中的值，之后被替换或删除的值延迟回收（调用方需持有表读锁）
+void column_engine_pin_values(ColumnEngineTableData* table_data) {
+    pthread_mutex_lock(&table_data->retire_lock);
+    table_data->view_count++;
+    pthread_mutex_unlock(&table_data->retire_lock);
+}
+
+// 取消固定，最后一个固定者负责回收旧值（不需要持有表锁）
+void column_engine_unpin_values(ColumnEngineTableData* table_data) {
+    pthread_mutex_lock(&table_data->retire_lock);
+    if (table_data->view_count > 0) {
+        table_data->view_count--;
+        if (table_data->view_count == 0) {
+            column_engine_reclaim_values(table_data);
+        }
+    }
+    pthread_mutex_unlock(&table_data->retire_lock);
+}
+
 // 创建表
 bool column_engine_create_table(StorageEngine* engine, Table* table) {
     if (!engine || !table) {
@@ -114,8 +232,11 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
 
     ColumnEngineData* data = (ColumnEngineData*)engine->data;
 
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 检查表是否已存在
     if (column_engine_get_table_data(engine, table->name)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table already exists\n");
         return false;
     }
@@ -123,6 +244,7 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
     // 创建表数据结构
     ColumnEngineTableData* table_data = (ColumnEngineTableData*)malloc(sizeof(ColumnEngineTableData));
     if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -131,14 +253,20 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
     table_data->column_count = table->column_count;
     table_data->row_count = 0;
     table_data->capacity = 1024; // 默认容量
+    table_data->deleted = NULL;
     table_data->next_row_id = 1;
     table_data->transaction_id = 0;
     table_data->in_transaction = false;
+    table_data->view_count = 0;
+    table_data->retired_values = NULL;
+    table_data->retired_count = 0;
+    table_data->retired_capacity = 0;
 
     // 创建列数据结构
     table_data->columns = (ColumnEngineColumnData**)malloc(sizeof(ColumnEngineColumnData*) * table->column_count);
     if (!table_data->columns) {
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -154,6 +282,7 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
             }
             free(table_data->columns);
             free(table_data);
+            pthread_rwlock_unlock(&data->catalog_lock);
             return false;
         }
 
@@ -173,6 +302,7 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
             }
             free(table_data->columns);
             free(table_data);
+            pthread_rwlock_unlock(&data->catalog_lock);
             return false;
         }
 
@@ -189,6 +319,7 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
             }
             free(table_data->columns);
             free(table_data);
+            pthread_rwlock_unlock(&data->catalog_lock);
             return false;
         }
 
@@ -201,8 +332,16 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
         table_data->columns[i] = column_data;
     }
 
+    // 分配删除标记
+    table_data->deleted = (bool*)malloc(sizeof(bool) * table_data->capacity);
+    if (table_data->deleted) {
+        for (size_t i = 0; i < table_data->capacity; i++) {
+            table_data->deleted[i] = false;
+        }
+    }
+
     // 将表数据添加到引擎
-    ColumnEngineTableData** new_tables = (ColumnEngineTableData**)realloc(data->tables, sizeof(ColumnEngineTableData*) * (data->table_count + 1));
+    ColumnEngineTableData** new_tables = table_data->deleted ? (ColumnEngineTableData**)realloc(data->tables, sizeof(ColumnEngineTableData*) * (data->table_count + 1)) : NULL;
     if (!new_tables) {
         // 释放表数据
         for (size_t i = 0; i < table_data->column_count; i++) {
@@ -211,10 +350,15 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
             free(table_data->columns[i]);
         }
         free(table_data->columns);
+        free(table_data->deleted);
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
+    pthread_mutex_init(&table_data->retire_lock, NULL);
+    pthread_rwlock_init(&table_data->lock, NULL);
+
     new_tables[data->table_count] = table_data;
     data->tables = new_tables;
     data->table_count++;
@@ -222,6 +366,8 @@ bool column_engine_create_table(StorageEngine* engine, Table* table) {
     // 设置表的引擎特定数据
     table->engine_specific_data = table_data;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
@@ -233,6 +379,9 @@ bool column_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     ColumnEngineData* data = (ColumnEngineData*)engine->data;
 
+    // 目录写锁等待所有进行中的操作结束
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 查找表
     size_t table_index = (size_t)-1;
     ColumnEngineTableData* table_data = NULL;
@@ -245,6 +394,7 @@ bool column_engine_drop_table(StorageEngine* engine, const char* table_name) {
     }
 
     if (table_index == (size_t)-1) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table not found\n");
         return false;
     }
@@ -265,6 +415,11 @@ bool column_engine_drop_table(StorageEngine* engine, const char* table_name) {
         free(table_data->columns[i]);
     }
     free(table_data->columns);
+    free(table_data->deleted);
+    column_engine_reclaim_values(table_data);
+    free(table_data->retired_values);
+    pthread_mutex_destroy(&table_data->retire_lock);
+    pthread_rwlock_destroy(&table_data->lock);
     free(table_data);
 
     // 从引擎中移除表
@@ -279,17 +434,25 @@ bool column_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     data->table_count--;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
 // 获取表
 Table* column_engine_get_table(StorageEngine* engine, const char* table_name) {
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
-    if (!table_data) {
+    if (!engine || !table_name) {
         return NULL;
     }
 
-    return table_data->table;
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    Table* table = table_data ? table_data->table : NULL;
+    pthread_rwlock_unlock(&data->catalog_lock);
+
+    return table;
 }
 
 // 插入数据
@@ -298,7 +461,7 @@ bool column_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
         return false;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -308,12 +471,18 @@ bool column_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
     if (table_data->row_count >= table_data->capacity) {
         size_t new_capacity = table_data->capacity * 2;
         if (!column_engine_expand_table(engine, table_data, new_capacity)) {
+            column_engine_unlock_table(engine, table_data);
             return false;
         }
     }
 
-    // 分配行ID
-    uint64_t row_id = table_data->next_row_id++;
+    // 行ID与行下标一一对应，日志记录实际的行下标，回放时放回相同位置
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, table_data->row_count + 1, row, NULL)) {
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    table_data->next_row_id++;
 
     // 插入行数据到每列
     for (size_t i = 0; i < table_data->column_count; i++) {
@@ -322,43 +491,11 @@ bool column_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
 
         if (value) {
             // 复制值
-            size_t value_size = 0;
-            switch (column_data->column->data_type) {
-                case DATA_TYPE_INT:
-                    value_size = sizeof(int);
-                    break;
-                case DATA_TYPE_BIGINT:
-                    value_size = sizeof(int64_t);
-                    break;
-                case DATA_TYPE_FLOAT:
-                    value_size = sizeof(float);
-                    break;
-                case DATA_TYPE_DOUBLE:
-                    value_size = sizeof(double);
-                    break;
-                case DATA_TYPE_CHAR:
-                case DATA_TYPE_VARCHAR:
-                    value_size = strlen((const char*)value) + 1;
-                    break;
-                case DATA_TYPE_DATE:
-                case DATA_TYPE_DATETIME:
-                    value_size = sizeof(time_t);
-                    break;
-                case DATA_TYPE_BOOLEAN:
-                    value_size = sizeof(bool);
-                    break;
-                case DATA_TYPE_BLOB:
-                    // 假设BLOB值是一个包含大小和数据的结构
-                    // 这里简化处理
-                    value_size = 1024;
-                    break;
-                default:
-                    value_size = 64;
-                    break;
-            }
+            size_t value_size = storage_value_size(column_data->column, value);
 
             void* copied_value = malloc(value_size);
             if (!copied_value) {
+                column_engine_unlock_table(engine, table_data);
                 return false;
             }
             memcpy(copied_value, value, value_size);
@@ -373,9 +510,15 @@ bool column_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
         column_data->value_count++;
     }
 
+    table_data->deleted[table_data->row_count] = false;
     table_data->row_count++;
     table_data->table->row_count = table_data->row_count;
 
+    column_engine_unlock_table(engine, table_data);
+
+    // 值已复制到列中，与其他引擎一致由引擎接管并释放传入的行
+    destroy_row(row);
+
     return true;
 }
 
@@ -385,7 +528,7 @@ bool column_engine_batch_insert(StorageEngine* engine, const char* table_name, R
         return false;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -398,13 +541,19 @@ bool column_engine_batch_insert(StorageEngine* engine, const char* table_name, R
             new_capacity *= 2;
         }
         if (!column_engine_expand_table(engine, table_data, new_capacity)) {
+            column_engine_unlock_table(engine, table_data);
             return false;
         }
     }
 
-    // 批量插入行数据
+    // 批量插入行数据，只插入已成功记录日志的行
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    size_t inserted = 0;
     for (size_t r = 0; r < row_count; r++) {
         Row* row = rows[r];
+        if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, table_data->row_count + r + 1, row, NULL)) {
+            break;
+        }
 
         // 插入行数据到每列
         for (size_t i = 0; i < table_data->column_count; i++) {
@@ -413,41 +562,11 @@ bool column_engine_batch_insert(StorageEngine* engine, const char* table_name, R
 
             if (value) {
                 // 复制值
-                size_t value_size = 0;
-                switch (column_data->column->data_type) {
-                    case DATA_TYPE_INT:
-                        value_size = sizeof(int);
-                        break;
-                    case DATA_TYPE_BIGINT:
-                        value_size = sizeof(int64_t);
-                        break;
-                    case DATA_TYPE_FLOAT:
-                        value_size = sizeof(float);
-                        break;
-                    case DATA_TYPE_DOUBLE:
-                        value_size = sizeof(double);
-                        break;
-                    case DATA_TYPE_CHAR:
-                    case DATA_TYPE_VARCHAR:
-                        value_size = strlen((const char*)value) + 1;
-                        break;
-                    case DATA_TYPE_DATE:
-                    case DATA_TYPE_DATETIME:
-                        value_size = sizeof(time_t);
-                        break;
-                    case DATA_TYPE_BOOLEAN:
-                        value_size = sizeof(bool);
-                        break;
-                    case DATA_TYPE_BLOB:
-                        value_size = 1024;
-                        break;
-                    default:
-                        value_size = 64;
-                        break;
-                }
+                size_t value_size = storage_value_size(column_data->column, value);
 
                 void* copied_value = malloc(value_size);
                 if (!copied_value) {
+                    column_engine_unlock_table(engine, table_data);
                     return false;
                 }
                 memcpy(copied_value, value, value_size);
@@ -461,12 +580,47 @@ bool column_engine_batch_insert(StorageEngine* engine, const char* table_name, R
 
             column_data->value_count++;
         }
+        table_data->deleted[table_data->row_count + r] = false;
+        inserted++;
     }
 
-    table_data->row_count += row_count;
-    table_data->next_row_id += row_count;
+    table_data->row_count += inserted;
+    table_data->next_row_id += inserted;
     table_data->table->row_count = table_data->row_count;
 
+    column_engine_unlock_table(engine, table_data);
+
+    for (size_t r = 0; r < inserted; r++) {
+        destroy_row(rows[r]);
+    }
+
+    return inserted == row_count;
+}
+
+// 以列数据构造临时行作为日志的撤销镜像（值直接引用列数据，只在持有表锁期间有效，调用方释放values）
+// 未启用日志时不构造；deleted取行的删除标记
+static bool column_engine_borrow_row(StorageEngine* engine, ColumnEngineTableData* table_data, size_t row_index, Row* row) {
+    row->values = NULL;
+    row->value_count = 0;
+    row->deleted = table_data->deleted[row_index];
+    row->version = table_data->transaction_id;
+    row->ref_count = 1;
+
+    if (!engine->wal) {
+        return true;
+    }
+
+    row->values = (void**)malloc(sizeof(void*) * (table_data->column_count ? table_data->column_count : 1));
+    if (!row->values) {
+        return false;
+    }
+    row->value_count = table_data->column_count;
+
+    for (size_t i = 0; i < table_data->column_count; i++) {
+        ColumnEngineColumnData* column_data = table_data->columns[i];
+        row->values[i] = column_data->null_mask[row_index] ? NULL : column_data->values[row_index];
+    }
+
     return true;
 }
 
@@ -476,7 +630,7 @@ bool column_engine_update(StorageEngine* engine, const char* table_name, uint64_
         return false;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -485,12 +639,30 @@ bool column_engine_update(StorageEngine* engine, const char* table_name, uint64_
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        column_engine_unlock_table(engine, table_data);
         return false;
     }
 
     size_t row_index = row_id - 1;
     if (row_index >= table_data->row_count) {
         fprintf(stderr, "Row not found\n");
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 旧行作为撤销镜像记录，已删除的行撤销时重新删除
+    Row before;
+    if (!column_engine_borrow_row(engine, table_data, row_index, &before)) {
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    bool logged = storage_engine_log_row(engine, WAL_RECORD_UPDATE, transaction_id, table_data->table, row_id, row,
+                                         before.deleted ? NULL : &before);
+    free(before.values);
+    if (!logged) {
+        column_engine_unlock_table(engine, table_data);
         return false;
     }
 
@@ -501,47 +673,17 @@ bool column_engine_update(StorageEngine* engine, const char* table_name, uint64_
 
         // 释放旧值
         if (column_data->values[row_index]) {
-            free(column_data->values[row_index]);
+            column_engine_retire_value(table_data, column_data->values[row_index]);
             column_data->values[row_index] = NULL;
         }
 
         if (value) {
             // 复制新值
-            size_t value_size = 0;
-            switch (column_data->column->data_type) {
-                case DATA_TYPE_INT:
-                    value_size = sizeof(int);
-                    break;
-                case DATA_TYPE_BIGINT:
-                    value_size = sizeof(int64_t);
-                    break;
-                case DATA_TYPE_FLOAT:
-                    value_size = sizeof(float);
-                    break;
-                case DATA_TYPE_DOUBLE:
-                    value_size = sizeof(double);
-                    break;
-                case DATA_TYPE_CHAR:
-                case DATA_TYPE_VARCHAR:
-                    value_size = strlen((const char*)value) + 1;
-                    break;
-                case DATA_TYPE_DATE:
-                case DATA_TYPE_DATETIME:
-                    value_size = sizeof(time_t);
-                    break;
-                case DATA_TYPE_BOOLEAN:
-                    value_size = sizeof(bool);
-                    break;
-                case DATA_TYPE_BLOB:
-                    value_size = 1024;
-                    break;
-                default:
-                    value_size = 64;
-                    break;
-            }
+            size_t value_size = storage_value_size(column_data->column, value);
 
             void* copied_value = malloc(value_size);
             if (!copied_value) {
+                column_engine_unlock_table(engine, table_data);
                 return false;
             }
             memcpy(copied_value, value, value_size);
@@ -552,6 +694,11 @@ bool column_engine_update(StorageEngine* engine, const char* table_name, uint64_
             column_data->null_mask[row_index] = true;
         }
     }
+    table_data->deleted[row_index] = false;
+
+    column_engine_unlock_table(engine, table_data);
+
+    destroy_row(row);
 
     return true;
 }
@@ -562,7 +709,7 @@ bool column_engine_delete(StorageEngine* engine, const char* table_name, uint64_
         return false;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -571,26 +718,45 @@ bool column_engine_delete(StorageEngine* engine, const char* table_name, uint64_
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        column_engine_unlock_table(engine, table_data);
         return false;
     }
 
     size_t row_index = row_id - 1;
     if (row_index >= table_data->row_count) {
         fprintf(stderr, "Row not found\n");
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    Row before;
+    if (!column_engine_borrow_row(engine, table_data, row_index, &before)) {
+        column_engine_unlock_table(engine, table_data);
         return false;
     }
 
-    // 标记行为删除状态
-    // 简化实现，实际应该使用删除标记或墓碑
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    bool logged = storage_engine_log_row(engine, WAL_RECORD_DELETE, transaction_id, table_data->table, row_id, NULL,
+                                         before.deleted ? NULL : &before);
+    free(before.values);
+    if (!logged) {
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 标记行为删除状态，释放各列的值
+    table_data->deleted[row_index] = true;
     for (size_t i = 0; i < table_data->column_count; i++) {
         ColumnEngineColumnData* column_data = table_data->columns[i];
         if (column_data->values[row_index]) {
-            free(column_data->values[row_index]);
+            column_engine_retire_value(table_data, column_data->values[row_index]);
             column_data->values[row_index] = NULL;
         }
         column_data->null_mask[row_index] = true;
     }
 
+    column_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
@@ -600,7 +766,7 @@ Row* column_engine_select(StorageEngine* engine, const char* table_name, uint64_
         return NULL;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return NULL;
@@ -609,18 +775,25 @@ Row* column_engine_select(StorageEngine* engine, const char* table_name, uint64_
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        column_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
     size_t row_index = row_id - 1;
     if (row_index >= table_data->row_count) {
         fprintf(stderr, "Row not found\n");
+        column_engine_unlock_table(engine, table_data);
+        return NULL;
+    }
+    if (table_data->deleted[row_index]) {
+        column_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
     // 创建行数据
     Row* row = create_row(table_data->column_count);
     if (!row) {
+        column_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
@@ -629,42 +802,12 @@ Row* column_engine_select(StorageEngine* engine, const char* table_name, uint64_
         ColumnEngineColumnData* column_data = table_data->columns[i];
         if (!column_data->null_mask[row_index] && column_data->values[row_index]) {
             // 复制值
-            size_t value_size = 0;
-            switch (column_data->column->data_type) {
-                case DATA_TYPE_INT:
-                    value_size = sizeof(int);
-                    break;
-                case DATA_TYPE_BIGINT:
-                    value_size = sizeof(int64_t);
-                    break;
-                case DATA_TYPE_FLOAT:
-                    value_size = sizeof(float);
-                    break;
-                case DATA_TYPE_DOUBLE:
-                    value_size = sizeof(double);
-                    break;
-                case DATA_TYPE_CHAR:
-                case DATA_TYPE_VARCHAR:
-                    value_size = strlen((const char*)column_data->values[row_index]) + 1;
-                    break;
-                case DATA_TYPE_DATE:
-                case DATA_TYPE_DATETIME:
-                    value_size = sizeof(time_t);
-                    break;
-                case DATA_TYPE_BOOLEAN:
-                    value_size = sizeof(bool);
-                    break;
-                case DATA_TYPE_BLOB:
-                    value_size = 1024;
-                    break;
-                default:
-                    value_size = 64;
-                    break;
-            }
+            size_t value_size = storage_value_size(column_data->column, column_data->values[row_index]);
 
             void* copied_value = malloc(value_size);
             if (!copied_value) {
                 destroy_row(row);
+                column_engine_unlock_table(engine, table_data);
                 return NULL;
             }
             memcpy(copied_value, column_data->values[row_index], value_size);
@@ -677,9 +820,177 @@ Row* column_engine_select(StorageEngine* engine, const char* table_name, uint64_
 
     row->version = table_data->transaction_id;
 
+    column_engine_unlock_table(engine, table_data);
+
     return row;
 }
 
+// 查询数据的只读视图
+const Row* column_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id) {
+    if (!engine || !table_name) {
+        return NULL;
+    }
+
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return NULL;
+    }
+
+    if (row_id == 0 || row_id > table_data->row_count || table_data->deleted[row_id - 1]) {
+        column_engine_unlock_table(engine, table_data);
+        return NULL;
+    }
+    size_t row_index = row_id - 1;
+
+    // 列存没有现成的行对象，视图只分配一次指针数组，值直接指向列数据
+    Row* view = (Row*)malloc(sizeof(Row) + sizeof(void*) * table_data->column_count);
+    if (!view) {
+        column_engine_unlock_table(engine, table_data);
+        return NULL;
+    }
+    view->values = (void**)(view + 1);
+    view->value_count = table_data->column_count;
+    view->deleted = false;
+    view->version = table_data->transaction_id;
+    view->ref_count = 1;
+
+    for (size_t i = 0; i < table_data->column_count; i++) {
+        ColumnEngineColumnData* column_data = table_data->columns[i];
+        view->values[i] = column_data->null_mask[row_index] ? NULL : column_data->values[row_index];
+    }
+
+    // 视图存在期间，被替换或删除的值延迟回收
+    column_engine_pin_values(table_data);
+
+    column_engine_unlock_table(engine, table_data);
+
+    return view;
+}
+
+// 释放只读视图
+void column_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view) {
+    if (!engine || !table_name || !view) {
+        return;
+    }
+
+    // 只需目录读锁保证表存在，不与表上的写操作互斥
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    if (table_data) {
+        column_engine_unpin_values(table_data);
+    }
+    pthread_rwlock_unlock(&data->catalog_lock);
+
+    // 只释放视图本身，值归列数据所有
+    free((Row*)view);
+}
+
+// 打开扫描游标
+ScanCursor* column_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options) {
+    if (!engine || !table_name) {
+        return NULL;
+    }
+
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return NULL;
+    }
+
+    ScanCursor* cursor = scan_cursor_create(engine, table_data, table_data->column_count, options);
+    column_engine_unlock_table(engine, table_data);
+
+    return cursor;
+}
+
+// 读取下一批数据
+size_t column_engine_scan_next(StorageEngine* engine, ScanCursor* cursor) {
+    if (!engine || !cursor || cursor->finished) {
+        return 0;
+    }
+
+    ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    ColumnEngineTableData* table_data = (ColumnEngineTableData*)cursor->table_data;
+    cursor->row_count = 0;
+
+    // 每批重新加锁，批次之间不阻塞写操作；表已被删除时结束扫描
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    if (!column_engine_has_table_data(engine, table_data)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        cursor->table_pinned = false;
+        cursor->finished = true;
+        return 0;
+    }
+
+    // 释放上一批的固定
+    if (cursor->table_pinned) {
+        column_engine_unpin_values(table_data);
+        cursor->table_pinned = false;
+    }
+
+    pthread_rwlock_rdlock(&table_data->lock);
+
+    // 没有谓词时只需要收集投影列
+    bool gather_all = cursor->options.predicate != NULL || cursor->options.projection == NULL;
+
+    while (cursor->position < table_data->row_count && !scan_cursor_full(cursor)) {
+        size_t row_index = cursor->position++;
+
+        if (table_data->deleted[row_index]) {
+            continue;
+        }
+
+        // 按行收集列值指针，不复制值
+        if (gather_all) {
+            for (size_t i = 0; i < table_data->column_count; i++) {
+                ColumnEngineColumnData* column_data = table_data->columns[i];
+                cursor->scratch_values[i] = column_data->null_mask[row_index] ? NULL : column_data->values[row_index];
+            }
+        } else {
+            for (size_t i = 0; i < cursor->options.projection_count; i++) {
+                ColumnEngineColumnData* column_data = table_data->columns[cursor->options.projection[i]];
+                cursor->scratch_values[cursor->options.projection[i]] = column_data->null_mask[row_index] ? NULL : column_data->values[row_index];
+            }
+        }
+
+        scan_cursor_emit(cursor, cursor->scratch_values, row_index + 1, table_data->transaction_id);
+    }
+
+    if (cursor->position >= table_data->row_count) {
+        cursor->finished = true;
+    }
+
+    // 本批输出的值指向列数据，固定到下一批或游标关闭
+    if (cursor->row_count > 0) {
+        column_engine_pin_values(table_data);
+        cursor->table_pinned = true;
+    }
+
+    column_engine_unlock_table(engine, table_data);
+
+    return cursor->row_count;
+}
+
+// 关闭扫描游标
+void column_engine_scan_close(StorageEngine* engine, ScanCursor* cursor) {
+    if (!cursor) {
+        return;
+    }
+
+    if (engine && cursor->table_pinned) {
+        ColumnEngineData* data = (ColumnEngineData*)engine->data;
+        pthread_rwlock_rdlock(&data->catalog_lock);
+        if (column_engine_has_table_data(engine, (ColumnEngineTableData*)cursor->table_data)) {
+            column_engine_unpin_values((ColumnEngineTableData*)cursor->table_data);
+        }
+        pthread_rwlock_unlock(&data->catalog_lock);
+    }
+
+    scan_cursor_destroy(cursor);
+}
+
 // 开始事务
 bool column_engine_begin_transaction(StorageEngine* engine) {
     if (!engine) {
@@ -687,13 +998,18 @@ bool column_engine_begin_transaction(StorageEngine* engine) {
     }
 
     ColumnEngineData* data = (ColumnEngineData*)engine->data;
-    uint64_t transaction_id = data->next_transaction_id++;
+    uint64_t transaction_id = __sync_fetch_and_add(&data->next_transaction_id, 1);
+    storage_engine_track_transaction(engine, storage_engine_transaction_id(engine, true, transaction_id));
 
     // 为所有表设置事务ID
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->transaction_id = transaction_id;
         data->tables[i]->in_transaction = true;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
     return true;
 }
@@ -705,13 +1021,21 @@ bool column_engine_commit_transaction(StorageEngine* engine) {
     }
 
     ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 提交记录持久化后事务的修改才算提交
+    bool success = storage_engine_log_transaction(engine, WAL_RECORD_COMMIT, transaction_id);
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 回滚事务
@@ -720,15 +1044,25 @@ bool column_engine_rollback_transaction(StorageEngine* engine) {
         return false;
     }
 
-    // 简化实现，实际应该恢复到事务开始前的状态
     ColumnEngineData* data = (ColumnEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
+
+    // 按日志中的撤销镜像恢复到事务开始前的状态（未启用日志时无法撤销）
+    bool success = storage_engine_undo_transaction(engine, transaction_id);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 回滚记录之前已写入全部补偿记录，恢复时不再撤销该事务
+    success = storage_engine_log_transaction(engine, WAL_RECORD_ABORT, transaction_id) && success;
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 优化表
@@ -737,24 +1071,29 @@ bool column_engine_optimize(StorageEngine* engine, const char* table_name) {
         return false;
     }
 
-    ColumnEngineTableData* table_data = column_engine_get_table_data(engine, table_name);
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
+    // 事务中删除的行回滚时要按原下标恢复，压缩不能撤销，事务结束后才能进行
+    if (table_data->in_transaction) {
+        fprintf(stderr, "Cannot optimize table %s inside a transaction\n", table_name);
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 压缩会改变行下标，回放时需要在相同位置重做
+    if (!storage_engine_log_row(engine, WAL_RECORD_OPTIMIZE, 0, table_data->table, 0, NULL, NULL)) {
+        column_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
     // 压缩表，移除已删除的行
     size_t new_row_count = 0;
     for (size_t i = 0; i < table_data->row_count; i++) {
-        bool row_deleted = true;
-        for (size_t j = 0; j < table_data->column_count; j++) {
-            if (!table_data->columns[j]->null_mask[i]) {
-                row_deleted = false;
-                break;
-            }
-        }
-
-        if (!row_deleted) {
+        if (!table_data->deleted[i]) {
             if (new_row_count != i) {
                 // 移动行数据
                 for (size_t j = 0; j < table_data->column_count; j++) {
@@ -766,13 +1105,14 @@ bool column_engine_optimize(StorageEngine* engine, const char* table_name) {
                     }
                     column_data->null_mask[new_row_count] = column_data->null_mask[i];
                 }
+                table_data->deleted[new_row_count] = false;
             }
             new_row_count++;
         } else {
             // 释放已删除行的数据
             for (size_t j = 0; j < table_data->column_count; j++) {
                 if (table_data->columns[j]->values[i]) {
-                    free(table_data->columns[j]->values[i]);
+                    column_engine_retire_value(table_data, table_data->columns[j]->values[i]);
                     table_data->columns[j]->values[i] = NULL;
                 }
             }
@@ -786,6 +1126,11 @@ bool column_engine_optimize(StorageEngine* engine, const char* table_name) {
             new_capacity = 1024;
         }
 
+        bool* new_deleted = (bool*)realloc(table_data->deleted, sizeof(bool) * new_capacity);
+        if (new_deleted) {
+            table_data->deleted = new_deleted;
+        }
+
         // 调整所有列的容量
         for (size_t i = 0; i < table_data->column_count; i++) {
             ColumnEngineColumnData* column_data = table_data->columns[i];
@@ -809,9 +1154,123 @@ bool column_engine_optimize(StorageEngine* engine, const char* table_name) {
     table_data->row_count = new_row_count;
     table_data->table->row_count = new_row_count;
 
+    column_engine_unlock_table(engine, table_data);
+
+    return true;
+}
+
+// 按日志重做插入（行ID即行下标加一，中间未回放的行作为已删除的行填充）
+bool column_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row) {
+    if (!engine || !table_name || !row || row_id == 0) {
+        return false;
+    }
+
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, true);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    size_t row_index = (size_t)(row_id - 1);
+    if (row_index >= table_data->capacity) {
+        size_t new_capacity = table_data->capacity;
+        while (new_capacity <= row_index) {
+            new_capacity *= 2;
+        }
+        if (!column_engine_expand_table(engine, table_data, new_capacity)) {
+            column_engine_unlock_table(engine, table_data);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < table_data->column_count; i++) {
+        ColumnEngineColumnData* column_data = table_data->columns[i];
+
+        // 填充空位
+        for (size_t j = table_data->row_count; j < row_index; j++) {
+            column_data->values[j] = NULL;
+            column_data->null_mask[j] = true;
+            column_data->value_count++;
+        }
+
+        // 行已存在时替换，重复回放结果相同
+        if (row_index < table_data->row_count) {
+            column_engine_retire_value(table_data, column_data->values[row_index]);
+        } else {
+            column_data->value_count++;
+        }
+
+        // 直接接管解码出的值，不再复制
+        void* value = i < row->value_count ? row->values[i] : NULL;
+        if (i < row->value_count) {
+            row->values[i] = NULL;
+        }
+        column_data->values[row_index] = value;
+        column_data->null_mask[row_index] = value == NULL;
+    }
+
+    for (size_t j = table_data->row_count; j < row_index; j++) {
+        table_data->deleted[j] = true;
+    }
+    table_data->deleted[row_index] = false;
+    if (row_index >= table_data->row_count) {
+        table_data->row_count = row_index + 1;
+    }
+    if (table_data->next_row_id <= row_id) {
+        table_data->next_row_id = row_id + 1;
+    }
+    table_data->table->row_count = table_data->row_count;
+
+    column_engine_unlock_table(engine, table_data);
+
+    destroy_row(row);
+
     return true;
 }
 
+// 生成表快照（持有表读锁期间复制行数据，已删除的行作为空位保留行ID）
+bool column_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot) {
+    if (!engine || !table_name || !snapshot) {
+        return false;
+    }
+
+    ColumnEngineTableData* table_data = column_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    // 持有表锁时读取日志位置，该表在此之前的修改都已反映在快照中
+    snapshot->lsn = engine->wal ? wal_current_lsn(engine->wal) : 0;
+    snapshot->schema = storage_engine_encode_table(table_data->table, &snapshot->schema_size);
+
+    void** values = (void**)malloc(sizeof(void*) * (table_data->column_count ? table_data->column_count : 1));
+    bool success = snapshot->schema != NULL && values != NULL;
+
+    for (size_t row_index = 0; row_index < table_data->row_count && success; row_index++) {
+        Row image = {values, table_data->column_count, table_data->deleted[row_index], table_data->transaction_id, 1};
+        for (size_t i = 0; i < table_data->column_count; i++) {
+            ColumnEngineColumnData* column_data = table_data->columns[i];
+            values[i] = column_data->null_mask[row_index] ? NULL : column_data->values[row_index];
+        }
+
+        Row* row = NULL;
+        if (!image.deleted) {
+            row = copy_row(&image, table_data->table);
+            if (!row) {
+                success = false;
+                break;
+            }
+        }
+        success = table_snapshot_add(snapshot, row_index + 1, row);
+    }
+
+    free(values);
+    column_engine_unlock_table(engine, table_data);
+
+    return success;
+}
+
 // 执行检查点
 bool column_engine_checkpoint(StorageEngine* engine) {
     // 简化实现，实际应该将内存中的数据持久化到磁盘
@@ -847,6 +1306,11 @@ void column_engine_destroy(StorageEngine* engine) {
         }
 
         free(table_data->columns);
+        free(table_data->deleted);
+        column_engine_reclaim_values(table_data);
+        free(table_data->retired_values);
+        pthread_mutex_destroy(&table_data->retire_lock);
+        pthread_rwlock_destroy(&table_data->lock);
         free(table_data);
     }
 
@@ -854,6 +1318,7 @@ void column_engine_destroy(StorageEngine* engine) {
         free(data->tables);
     }
 
+    pthread_rwlock_destroy(&data->catalog_lock);
     free(data);
     free(engine);
 }
\ No newline at end of file
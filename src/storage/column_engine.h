@@ -19,16 +19,24 @@ typedef struct {
     size_t column_count;
     size_t row_count;
     size_t capacity;
+    bool* deleted; // 行删除标记（全空值的行也是有效行）
     uint64_t next_row_id;
     uint64_t transaction_id;
     bool in_transaction;
+    uint32_t view_count; // 未释放的只读视图和扫描批次数量
+    void** retired_values; // 视图存在期间被替换的旧值，最后一个视图释放时回收
+    size_t retired_count;
+    size_t retired_capacity;
+    pthread_mutex_t retire_lock; // 保护view_count和旧值列表（释放视图时不持有表锁）
+    pthread_rwlock_t lock; // 表级读写锁，写操作独占，查询和扫描共享
 } ColumnEngineTableData;
 
 // 列存引擎数据结构
 typedef struct {
     ColumnEngineTableData** tables;
     size_t table_count;
-    uint64_t next_transaction_id;
+    uint64_t next_transaction_id; // 原子递增
+    pthread_rwlock_t catalog_lock; // 保护表数组，建表删表独占，数据操作共享
 } ColumnEngineData;
 
 // 创建列存引擎
@@ -44,8 +52,15 @@ bool column_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
 bool column_engine_update(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
 bool column_engine_delete(StorageEngine* engine, const char* table_name, uint64_t row_id);
 Row* column_engine_select(StorageEngine* engine, const char* table_name, uint64_t row_id);
+const Row* column_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id);
+void column_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view);
 bool column_engine_batch_insert(StorageEngine* engine, const char* table_name, Row** rows, size_t row_count);
 
+// 列存引擎扫描操作
+ScanCursor* column_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options);
+size_t column_engine_scan_next(StorageEngine* engine, ScanCursor* cursor);
+void column_engine_scan_close(StorageEngine* engine, ScanCursor* cursor);
+
 // 列存引擎事务操作
 bool column_engine_begin_transaction(StorageEngine* engine);
 bool column_engine_commit_transaction(StorageEngine* engine);
@@ -55,12 +70,23 @@ bool column_engine_rollback_transaction(StorageEngine* engine);
 bool column_engine_optimize(StorageEngine* engine, const char* table_name);
 bool column_engine_checkpoint(StorageEngine* engine);
 
+// 列存引擎恢复操作
+bool column_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
+bool column_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot);
+
 // 列存引擎销毁
 void column_engine_destroy(StorageEngine* engine);
 
 // 列存引擎辅助函数
 ColumnEngineTableData* column_engine_get_table_data(StorageEngine* engine, const char* table_name);
+ColumnEngineTableData* column_engine_lock_table(StorageEngine* engine, const char* table_name, bool write);
+void column_engine_unlock_table(StorageEngine* engine, ColumnEngineTableData* table_data);
+bool column_engine_has_table_data(StorageEngine* engine, ColumnEngineTableData* table_data);
 bool column_engine_expand_table(StorageEngine* engine, ColumnEngineTableData* table_data, size_t new_capacity);
 bool column_engine_expand_column(ColumnEngineColumnData* column_data, size_t new_capacity);
+void column_engine_retire_value(ColumnEngineTableData* table_data, void* value);
+void column_engine_reclaim_values(ColumnEngineTableData* table_data);
+void column_engine_pin_values(ColumnEngineTableData* table_data);
+void column_engine_unpin_values(ColumnEngineTableData* table_data);
 
 #endif // COLUMN_ENGINE_H
\ No newline at end of file
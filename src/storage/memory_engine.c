@@ -24,9 +24,14 @@ StorageEngine* create_memory_engine(void* config) {
     data->tables = NULL;
     data->table_count = 0;
     data->next_transaction_id = 1;
+    pthread_rwlock_init(&data->catalog_lock, NULL);
 
     engine->type = STORAGE_ENGINE_MEMORY;
     engine->name = "memory_engine";
+    engine->wal = NULL;
+    engine->active_transaction = 0;
+    engine->transaction_first_lsn = 0;
+    engine->transaction_base = 0;
     engine->data = data;
 
     // 设置函数指针
@@ -37,18 +42,25 @@ StorageEngine* create_memory_engine(void* config) {
     engine->update = memory_engine_update;
     engine->delete = memory_engine_delete;
     engine->select = memory_engine_select;
+    engine->select_view = memory_engine_select_view;
+    engine->release_view = memory_engine_release_view;
+    engine->scan_open = memory_engine_scan_open;
+    engine->scan_next = memory_engine_scan_next;
+    engine->scan_close = memory_engine_scan_close;
     engine->batch_insert = memory_engine_batch_insert;
     engine->begin_transaction = memory_engine_begin_transaction;
     engine->commit_transaction = memory_engine_commit_transaction;
     engine->rollback_transaction = memory_engine_rollback_transaction;
     engine->optimize = memory_engine_optimize;
     engine->checkpoint = memory_engine_checkpoint;
+    engine->redo_insert = memory_engine_redo_insert;
+    engine->snapshot_table = memory_engine_snapshot_table;
     engine->destroy = memory_engine_destroy;
 
     return engine;
 }
 
-// 获取内存表引擎表数据
+// 获取内存表引擎表数据（调用方需持有目录锁）
 MemoryEngineTableData* memory_engine_get_table_data(StorageEngine* engine, const char* table_name) {
     if (!engine || !table_name) {
         return NULL;
@@ -64,7 +76,89 @@ MemoryEngineTableData* memory_engine_get_table_data(StorageEngine* engine, const
     return NULL;
 }
 
-// 扩展表容量
+// 查找表并加锁，成功时同时持有目录读锁和表锁，目录读锁保证操作期间表不会被删除
+MemoryEngineTableData* memory_engine_lock_table(StorageEngine* engine, const char* table_name, bool write) {
+    MemoryEngineData* data = (MemoryEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        return NULL;
+    }
+
+    if (write) {
+        pthread_rwlock_wrlock(&table_data->lock);
+    } else {
+        pthread_rwlock_rdlock(&table_data->lock);
+    }
+
+    return table_data;
+}
+
+// 释放memory_engine_lock_table获取的锁
+void memory_engine_unlock_table(StorageEngine* engine, MemoryEngineTableData* table_data) {
+    MemoryEngineData* data = (MemoryEngineData*)engine->data;
+    pthread_rwlock_unlock(&table_data->lock);
+    pthread_rwlock_unlock(&data->catalog_lock);
+}
+
+// 检查表数据是否仍属于引擎（调用方需持有目录锁）
+bool memory_engine_has_table_data(StorageEngine* engine, MemoryEngineTableData* table_data) {
+    MemoryEngineData* data = (MemoryEngineData*)engine->data;
+    for (size_t i = 0; i < data->table_count; i++) {
+        if (data->tables[i] == table_data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// 获取哈希桶对应的分段锁
+pthread_mutex_t* memory_engine_bucket_lock(MemoryEngineTableData* table_data, uint64_t hash) {
+    return &table_data->bucket_locks[hash % MEMORY_ENGINE_LOCK_STRIPES];
+}
+
+// 在哈希桶中查找行（调用方需持有桶锁）
+MemoryEngineRow* memory_engine_find_row(MemoryEngineTableData* table_data, uint64_t hash, uint64_t row_id) {
+    MemoryEngineRow* memory_row = table_data->rows[hash];
+    while (memory_row) {
+        if (memory_row->row_id == row_id) {
+            return memory_row;
+        }
+        memory_row = memory_row->next;
+    }
+
+    return NULL;
+}
+
+// 保证哈希表能容纳新增的行（调用方持有表读锁，扩容时临时换成写锁）
+bool memory_engine_reserve(StorageEngine* engine, MemoryEngineTableData* table_data, size_t row_count) {
+    if (__atomic_load_n(&table_data->row_count, __ATOMIC_RELAXED) + row_count < table_data->capacity * 0.75) {
+        return true;
+    }
+
+    // 读写锁不能直接升级，换锁期间其他线程可能已经完成扩容，需要重新检查
+    pthread_rwlock_unlock(&table_data->lock);
+    pthread_rwlock_wrlock(&table_data->lock);
+
+    bool success = true;
+    if (table_data->row_count + row_count >= table_data->capacity * 0.75) {
+        size_t new_capacity = table_data->capacity;
+        while (table_data->row_count + row_count >= new_capacity * 0.75) {
+            new_capacity *= 2;
+        }
+        success = memory_engine_expand_table(engine, table_data, new_capacity);
+    }
+
+    pthread_rwlock_unlock(&table_data->lock);
+    pthread_rwlock_rdlock(&table_data->lock);
+
+    return success;
+}
+
+// 扩展表容量（调用方需持有表写锁）
 bool memory_engine_expand_table(StorageEngine* engine, MemoryEngineTableData* table_data, size_t new_capacity) {
     if (!engine || !table_data || new_capacity <= table_data->capacity) {
         return false;
@@ -114,8 +208,11 @@ bool memory_engine_create_table(StorageEngine* engine, Table* table) {
 
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
 
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 检查表是否已存在
     if (memory_engine_get_table_data(engine, table->name)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table already exists\n");
         return false;
     }
@@ -123,6 +220,7 @@ bool memory_engine_create_table(StorageEngine* engine, Table* table) {
     // 创建表数据结构
     MemoryEngineTableData* table_data = (MemoryEngineTableData*)malloc(sizeof(MemoryEngineTableData));
     if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -140,6 +238,7 @@ bool memory_engine_create_table(StorageEngine* engine, Table* table) {
     table_data->rows = (MemoryEngineRow**)malloc(sizeof(MemoryEngineRow*) * table_data->capacity);
     if (!table_data->rows) {
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -153,9 +252,15 @@ bool memory_engine_create_table(StorageEngine* engine, Table* table) {
     if (!new_tables) {
         free(table_data->rows);
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
+    pthread_rwlock_init(&table_data->lock, NULL);
+    for (size_t i = 0; i < MEMORY_ENGINE_LOCK_STRIPES; i++) {
+        pthread_mutex_init(&table_data->bucket_locks[i], NULL);
+    }
+
     new_tables[data->table_count] = table_data;
     data->tables = new_tables;
     data->table_count++;
@@ -163,6 +268,8 @@ bool memory_engine_create_table(StorageEngine* engine, Table* table) {
     // 设置表的引擎特定数据
     table->engine_specific_data = table_data;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
@@ -174,6 +281,9 @@ bool memory_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
 
+    // 目录写锁等待所有进行中的操作结束
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 查找表
     size_t table_index = (size_t)-1;
     MemoryEngineTableData* table_data = NULL;
@@ -186,11 +296,16 @@ bool memory_engine_drop_table(StorageEngine* engine, const char* table_name) {
     }
 
     if (table_index == (size_t)-1) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
     // 释放表数据
+    pthread_rwlock_destroy(&table_data->lock);
+    for (size_t i = 0; i < MEMORY_ENGINE_LOCK_STRIPES; i++) {
+        pthread_mutex_destroy(&table_data->bucket_locks[i]);
+    }
     for (size_t i = 0; i < table_data->capacity; i++) {
         MemoryEngineRow* row = table_data->rows[i];
         while (row) {
@@ -218,17 +333,25 @@ bool memory_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     data->table_count--;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
 // 获取表
 Table* memory_engine_get_table(StorageEngine* engine, const char* table_name) {
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
-    if (!table_data) {
+    if (!engine || !table_name) {
         return NULL;
     }
 
-    return table_data->table;
+    MemoryEngineData* data = (MemoryEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    Table* table = table_data ? table_data->table : NULL;
+    pthread_rwlock_unlock(&data->catalog_lock);
+
+    return table;
 }
 
 // 插入数据
@@ -237,22 +360,20 @@ bool memory_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
         return false;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
     // 检查是否需要扩展表容量
-    if (table_data->row_count >= table_data->capacity * 0.75) {
-        size_t new_capacity = table_data->capacity * 2;
-        if (!memory_engine_expand_table(engine, table_data, new_capacity)) {
-            return false;
-        }
+    if (!memory_engine_reserve(engine, table_data, 1)) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
     }
 
     // 分配行ID
-    uint64_t row_id = table_data->next_row_id++;
+    uint64_t row_id = __sync_fetch_and_add(&table_data->next_row_id, 1);
 
     // 计算哈希值
     uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
@@ -260,6 +381,15 @@ bool memory_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
     // 创建内存行结构
     MemoryEngineRow* memory_row = (MemoryEngineRow*)malloc(sizeof(MemoryEngineRow));
     if (!memory_row) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 行在链入哈希表之前不可见，此时记录日志即可保证先于该行的更新和删除
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, row_id, row, NULL)) {
+        free(memory_row);
+        memory_engine_unlock_table(engine, table_data);
         return false;
     }
 
@@ -267,22 +397,27 @@ bool memory_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
     memory_row->row = row;
     memory_row->row_id = row_id;
 
-    // 插入到哈希表
+    // 插入到哈希表，只锁目标桶所在的分段
+    pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+    pthread_mutex_lock(bucket_lock);
     memory_row->next = table_data->rows[hash];
     memory_row->prev = NULL;
     if (table_data->rows[hash]) {
         table_data->rows[hash]->prev = memory_row;
     }
     table_data->rows[hash] = memory_row;
+    pthread_mutex_unlock(bucket_lock);
 
-    table_data->row_count++;
-    table_data->table->row_count = table_data->row_count;
+    __sync_add_and_fetch(&table_data->row_count, 1);
+    __sync_add_and_fetch(&table_data->table->row_count, 1);
 
     // 如果需要持久化，写入持久化文件
     if (table_data->persistent && table_data->persist_file) {
         // 简化实现，实际应该实现持久化逻辑
     }
 
+    memory_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
@@ -292,54 +427,66 @@ bool memory_engine_batch_insert(StorageEngine* engine, const char* table_name, R
         return false;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
     // 检查是否需要扩展表容量
-    if (table_data->row_count + row_count >= table_data->capacity * 0.75) {
-        size_t new_capacity = table_data->capacity;
-        while (table_data->row_count + row_count >= new_capacity * 0.75) {
-            new_capacity *= 2;
-        }
-        if (!memory_engine_expand_table(engine, table_data, new_capacity)) {
-            return false;
-        }
+    if (!memory_engine_reserve(engine, table_data, row_count)) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
     }
 
+    // 一次性分配连续的行ID
+    uint64_t first_row_id = __sync_fetch_and_add(&table_data->next_row_id, row_count);
+
     // 批量插入行数据
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    size_t inserted = 0;
     for (size_t i = 0; i < row_count; i++) {
         Row* row = rows[i];
-        uint64_t row_id = table_data->next_row_id++;
+        uint64_t row_id = first_row_id + i;
         uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
 
         MemoryEngineRow* memory_row = (MemoryEngineRow*)malloc(sizeof(MemoryEngineRow));
         if (!memory_row) {
-            return false;
+            break;
+        }
+
+        if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, row_id, row, NULL)) {
+            free(memory_row);
+            break;
         }
 
         memory_row->row = row;
         memory_row->row_id = row_id;
 
+        pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+        pthread_mutex_lock(bucket_lock);
         memory_row->next = table_data->rows[hash];
         memory_row->prev = NULL;
         if (table_data->rows[hash]) {
             table_data->rows[hash]->prev = memory_row;
         }
         table_data->rows[hash] = memory_row;
+        pthread_mutex_unlock(bucket_lock);
+
+        inserted++;
     }
 
-    table_data->row_count += row_count;
-    table_data->table->row_count = table_data->row_count;
+    __sync_add_and_fetch(&table_data->row_count, inserted);
+    __sync_add_and_fetch(&table_data->table->row_count, inserted);
 
     // 如果需要持久化，写入持久化文件
     if (table_data->persistent && table_data->persist_file) {
         // 简化实现，实际应该实现批量持久化逻辑
     }
 
-    return true;
+    memory_engine_unlock_table(engine, table_data);
+
+    return inserted == row_count;
 }
 
 // 更新数据
@@ -348,7 +495,7 @@ bool memory_engine_update(StorageEngine* engine, const char* table_name, uint64_
         return false;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -357,31 +504,41 @@ bool memory_engine_update(StorageEngine* engine, const char* table_name, uint64_
     // 计算哈希值
     uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
 
-    // 查找行
-    MemoryEngineRow* memory_row = table_data->rows[hash];
-    while (memory_row) {
-        if (memory_row->row_id == row_id) {
-            break;
-        }
-        memory_row = memory_row->next;
+    // 查找行并替换，旧行在释放桶锁后再销毁
+    // 同一行的修改由桶锁串行化，在桶锁内记录日志保证日志顺序与修改顺序一致
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+    pthread_mutex_lock(bucket_lock);
+    MemoryEngineRow* memory_row = memory_engine_find_row(table_data, hash, row_id);
+    Row* old_row = NULL;
+    bool logged = memory_row && storage_engine_log_row(engine, WAL_RECORD_UPDATE, transaction_id, table_data->table, row_id, row, memory_row->row);
+    if (logged) {
+        old_row = memory_row->row;
+        memory_row->row = row;
     }
+    pthread_mutex_unlock(bucket_lock);
 
     if (!memory_row) {
+        memory_engine_unlock_table(engine, table_data);
         fprintf(stderr, "Row not found\n");
         return false;
     }
 
-    // 释放旧行
-    destroy_row(memory_row->row);
+    if (!logged) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
 
-    // 设置新行
-    memory_row->row = row;
+    // 释放旧行（仍有视图或扫描引用时只减少引用计数）
+    destroy_row(old_row);
 
     // 如果需要持久化，写入持久化文件
     if (table_data->persistent && table_data->persist_file) {
         // 简化实现，实际应该实现持久化逻辑
     }
 
+    memory_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
@@ -391,7 +548,7 @@ bool memory_engine_delete(StorageEngine* engine, const char* table_name, uint64_
         return false;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -400,101 +557,195 @@ bool memory_engine_delete(StorageEngine* engine, const char* table_name, uint64_
     // 计算哈希值
     uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
 
-    // 查找行
-    MemoryEngineRow* memory_row = table_data->rows[hash];
-    while (memory_row) {
-        if (memory_row->row_id == row_id) {
-            break;
+    // 查找行并从哈希表中移除
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+    pthread_mutex_lock(bucket_lock);
+    MemoryEngineRow* memory_row = memory_engine_find_row(table_data, hash, row_id);
+    if (memory_row && !storage_engine_log_row(engine, WAL_RECORD_DELETE, transaction_id, table_data->table, row_id, NULL, memory_row->row)) {
+        pthread_mutex_unlock(bucket_lock);
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    if (memory_row) {
+        if (memory_row->prev) {
+            memory_row->prev->next = memory_row->next;
+        } else {
+            table_data->rows[hash] = memory_row->next;
+        }
+        if (memory_row->next) {
+            memory_row->next->prev = memory_row->prev;
         }
-        memory_row = memory_row->next;
     }
+    pthread_mutex_unlock(bucket_lock);
 
     if (!memory_row) {
+        memory_engine_unlock_table(engine, table_data);
         fprintf(stderr, "Row not found\n");
         return false;
     }
 
-    // 从哈希表中移除
-    if (memory_row->prev) {
-        memory_row->prev->next = memory_row->next;
-    } else {
-        table_data->rows[hash] = memory_row->next;
-    }
-    if (memory_row->next) {
-        memory_row->next->prev = memory_row->prev;
-    }
-
     // 释放行数据
     destroy_row(memory_row->row);
     free(memory_row);
 
-    table_data->row_count--;
-    table_data->table->row_count = table_data->row_count;
+    __sync_sub_and_fetch(&table_data->row_count, 1);
+    __sync_sub_and_fetch(&table_data->table->row_count, 1);
 
     // 如果需要持久化，写入持久化文件
     if (table_data->persistent && table_data->persist_file) {
         // 简化实现，实际应该实现持久化逻辑
     }
 
+    memory_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
+// 在桶锁内查找行并增加引用，返回的行需要调用destroy_row释放（调用方需持有表读锁）
+static Row* memory_engine_pin_row(MemoryEngineTableData* table_data, uint64_t row_id) {
+    uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
+    pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+
+    pthread_mutex_lock(bucket_lock);
+    MemoryEngineRow* memory_row = memory_engine_find_row(table_data, hash, row_id);
+    Row* row = memory_row ? retain_row(memory_row->row) : NULL;
+    pthread_mutex_unlock(bucket_lock);
+
+    return row;
+}
+
 // 查询数据
 Row* memory_engine_select(StorageEngine* engine, const char* table_name, uint64_t row_id) {
     if (!engine || !table_name) {
         return NULL;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return NULL;
     }
 
-    // 计算哈希值
-    uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
+    // 固定行后在桶锁之外复制
+    Row* row = memory_engine_pin_row(table_data, row_id);
+    if (!row) {
+        memory_engine_unlock_table(engine, table_data);
+        fprintf(stderr, "Row not found\n");
+        return NULL;
+    }
 
-    // 查找行
-    MemoryEngineRow* memory_row = table_data->rows[hash];
-    while (memory_row) {
-        if (memory_row->row_id == row_id) {
-            break;
-        }
-        memory_row = memory_row->next;
+    // 返回行的副本，调用方拥有并负责销毁
+    Row* copy = copy_row(row, table_data->table);
+    destroy_row(row);
+
+    memory_engine_unlock_table(engine, table_data);
+
+    return copy;
+}
+
+// 查询数据的只读视图
+const Row* memory_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id) {
+    if (!engine || !table_name) {
+        return NULL;
     }
 
-    if (!memory_row) {
-        fprintf(stderr, "Row not found\n");
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
         return NULL;
     }
 
-    // 返回行的副本
-    Row* row_copy = create_row(memory_row->row->value_count);
-    if (!row_copy) {
+    // 通过引用计数固定行，更新或删除只会释放引擎自己的引用
+    Row* row = memory_engine_pin_row(table_data, row_id);
+    memory_engine_unlock_table(engine, table_data);
+
+    if (row && row->deleted) {
+        destroy_row(row);
         return NULL;
     }
 
-    for (size_t i = 0; i < row_copy->value_count; i++) {
-        if (memory_row->row->values[i]) {
-            // 复制值
-            size_t value_size = 0;
-            // 根据列类型计算值大小
-            // 简化实现，实际应该根据列类型计算
-            value_size = 64;
-            void* copied_value = malloc(value_size);
-            if (copied_value) {
-                memcpy(copied_value, memory_row->row->values[i], value_size);
-                row_copy->values[i] = copied_value;
-            }
-        } else {
-            row_copy->values[i] = NULL;
+    return row;
+}
+
+// 释放只读视图
+void memory_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view) {
+    (void)engine;
+    (void)table_name;
+    destroy_row((Row*)view);
+}
+
+// 打开扫描游标
+ScanCursor* memory_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options) {
+    if (!engine || !table_name) {
+        return NULL;
+    }
+
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return NULL;
+    }
+
+    ScanCursor* cursor = scan_cursor_create(engine, table_data, table_data->table->column_count, options);
+    memory_engine_unlock_table(engine, table_data);
+
+    if (cursor) {
+        // 行ID从1开始分配
+        cursor->position = 1;
+    }
+
+    return cursor;
+}
+
+// 读取下一批数据
+size_t memory_engine_scan_next(StorageEngine* engine, ScanCursor* cursor) {
+    if (!engine || !cursor || cursor->finished) {
+        return 0;
+    }
+
+    MemoryEngineData* data = (MemoryEngineData*)engine->data;
+    MemoryEngineTableData* table_data = (MemoryEngineTableData*)cursor->table_data;
+    cursor->row_count = 0;
+    scan_cursor_release_pins(cursor);
+
+    // 每批重新加锁，批次之间不阻塞写操作；表已被删除时结束扫描
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    if (!memory_engine_has_table_data(engine, table_data)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        cursor->finished = true;
+        return 0;
+    }
+    pthread_rwlock_rdlock(&table_data->lock);
+
+    // 按行ID顺序探测哈希表：批次之间扩容或删除都不影响游标位置，也不会重复输出
+    uint64_t next_row_id = __atomic_load_n(&table_data->next_row_id, __ATOMIC_ACQUIRE);
+    while (cursor->position < next_row_id && !scan_cursor_full(cursor)) {
+        uint64_t row_id = cursor->position++;
+        Row* row = memory_engine_pin_row(table_data, row_id);
+        if (!row) {
+            continue;
         }
+
+        if (!row->deleted) {
+            scan_cursor_emit_row(cursor, row, row_id);
+        }
+        destroy_row(row);
+    }
+
+    if (cursor->position >= next_row_id) {
+        cursor->finished = true;
     }
 
-    row_copy->version = memory_row->row->version;
-    row_copy->deleted = memory_row->row->deleted;
+    memory_engine_unlock_table(engine, table_data);
 
-    return row_copy;
+    return cursor->row_count;
+}
+
+// 关闭扫描游标
+void memory_engine_scan_close(StorageEngine* engine, ScanCursor* cursor) {
+    (void)engine;
+    scan_cursor_destroy(cursor);
 }
 
 // 开始事务
@@ -504,13 +755,18 @@ bool memory_engine_begin_transaction(StorageEngine* engine) {
     }
 
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
-    uint64_t transaction_id = data->next_transaction_id++;
+    uint64_t transaction_id = __sync_fetch_and_add(&data->next_transaction_id, 1);
+    storage_engine_track_transaction(engine, storage_engine_transaction_id(engine, true, transaction_id));
 
     // 为所有表设置事务ID
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->transaction_id = transaction_id;
         data->tables[i]->in_transaction = true;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
     return true;
 }
@@ -522,18 +778,26 @@ bool memory_engine_commit_transaction(StorageEngine* engine) {
     }
 
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
 
         // 如果需要持久化，写入持久化文件
         if (data->tables[i]->persistent && data->tables[i]->persist_file) {
             // 简化实现，实际应该实现持久化逻辑
         }
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 提交记录持久化后事务的修改才算提交
+    bool success = storage_engine_log_transaction(engine, WAL_RECORD_COMMIT, transaction_id);
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 回滚事务
@@ -542,15 +806,25 @@ bool memory_engine_rollback_transaction(StorageEngine* engine) {
         return false;
     }
 
-    // 简化实现，实际应该恢复到事务开始前的状态
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
+
+    // 按日志中的撤销镜像恢复到事务开始前的状态（未启用日志时无法撤销）
+    bool success = storage_engine_undo_transaction(engine, transaction_id);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 回滚记录之前已写入全部补偿记录，恢复时不再撤销该事务
+    success = storage_engine_log_transaction(engine, WAL_RECORD_ABORT, transaction_id) && success;
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 优化表
@@ -559,7 +833,8 @@ bool memory_engine_optimize(StorageEngine* engine, const char* table_name) {
         return false;
     }
 
-    MemoryEngineTableData* table_data = memory_engine_get_table_data(engine, table_name);
+    // 重新哈希需要独占整个表
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -574,9 +849,119 @@ bool memory_engine_optimize(StorageEngine* engine, const char* table_name) {
         memory_engine_expand_table(engine, table_data, new_capacity);
     }
 
+    memory_engine_unlock_table(engine, table_data);
+
+    return true;
+}
+
+// 按日志重做插入（行已存在时替换）
+bool memory_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row) {
+    if (!engine || !table_name || !row) {
+        return false;
+    }
+
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    if (!memory_engine_reserve(engine, table_data, 1)) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    MemoryEngineRow* new_row = (MemoryEngineRow*)malloc(sizeof(MemoryEngineRow));
+    if (!new_row) {
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    new_row->row = row;
+    new_row->row_id = row_id;
+
+    // 撤销删除时按原行ID重新链入，需要在桶锁内记录日志（恢复的重做阶段日志未挂接）
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    uint64_t hash = memory_engine_hash(row_id, table_data->capacity);
+    pthread_mutex_t* bucket_lock = memory_engine_bucket_lock(table_data, hash);
+    pthread_mutex_lock(bucket_lock);
+    if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, row_id, row, NULL)) {
+        pthread_mutex_unlock(bucket_lock);
+        free(new_row);
+        memory_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    MemoryEngineRow* memory_row = memory_engine_find_row(table_data, hash, row_id);
+    Row* old_row = NULL;
+    if (memory_row) {
+        old_row = memory_row->row;
+        memory_row->row = row;
+    } else {
+        new_row->next = table_data->rows[hash];
+        new_row->prev = NULL;
+        if (table_data->rows[hash]) {
+            table_data->rows[hash]->prev = new_row;
+        }
+        table_data->rows[hash] = new_row;
+    }
+    pthread_mutex_unlock(bucket_lock);
+
+    if (memory_row) {
+        destroy_row(old_row);
+        free(new_row);
+    } else {
+        __sync_add_and_fetch(&table_data->row_count, 1);
+        __sync_add_and_fetch(&table_data->table->row_count, 1);
+    }
+
+    // 之后分配的行ID必须大于回放过的行ID
+    uint64_t next_row_id = __atomic_load_n(&table_data->next_row_id, __ATOMIC_RELAXED);
+    while (next_row_id <= row_id && !__sync_bool_compare_and_swap(&table_data->next_row_id, next_row_id, row_id + 1)) {
+        next_row_id = __atomic_load_n(&table_data->next_row_id, __ATOMIC_RELAXED);
+    }
+
+    memory_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
+// 生成表快照（哈希表遍历需要独占表锁，期间只复制行引用）
+bool memory_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot) {
+    if (!engine || !table_name || !snapshot) {
+        return false;
+    }
+
+    MemoryEngineTableData* table_data = memory_engine_lock_table(engine, table_name, true);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    // 持有表锁时读取日志位置，该表在此之前的修改都已反映在快照中
+    snapshot->lsn = engine->wal ? wal_current_lsn(engine->wal) : 0;
+    snapshot->schema = storage_engine_encode_table(table_data->table, &snapshot->schema_size);
+    bool success = snapshot->schema != NULL;
+
+    uint64_t max_row_id = 0;
+    for (size_t i = 0; i < table_data->capacity && success; i++) {
+        for (MemoryEngineRow* memory_row = table_data->rows[i]; memory_row && success; memory_row = memory_row->next) {
+            success = table_snapshot_add(snapshot, memory_row->row_id, retain_row(memory_row->row));
+            if (memory_row->row_id > max_row_id) {
+                max_row_id = memory_row->row_id;
+            }
+        }
+    }
+
+    // 最后分配的行已删除时保留一个空位，恢复后不会重新分配这些行ID
+    uint64_t last_row_id = __atomic_load_n(&table_data->next_row_id, __ATOMIC_RELAXED) - 1;
+    if (success && last_row_id > max_row_id) {
+        success = table_snapshot_add(snapshot, last_row_id, NULL);
+    }
+
+    memory_engine_unlock_table(engine, table_data);
+
+    return success;
+}
+
 // 执行检查点
 bool memory_engine_checkpoint(StorageEngine* engine) {
     if (!engine) {
@@ -586,11 +971,15 @@ bool memory_engine_checkpoint(StorageEngine* engine) {
     MemoryEngineData* data = (MemoryEngineData*)engine->data;
 
     // 将所有需要持久化的表写入持久化文件
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_rdlock(&data->tables[i]->lock);
         if (data->tables[i]->persistent && data->tables[i]->persist_file) {
             // 简化实现，实际应该实现持久化逻辑
         }
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
     return true;
 }
@@ -622,6 +1011,10 @@ void memory_engine_destroy(StorageEngine* engine) {
         if (table_data->persist_file) {
             free(table_data->persist_file);
         }
+        pthread_rwlock_destroy(&table_data->lock);
+        for (size_t j = 0; j < MEMORY_ENGINE_LOCK_STRIPES; j++) {
+            pthread_mutex_destroy(&table_data->bucket_locks[j]);
+        }
         free(table_data);
     }
 
@@ -629,6 +1022,7 @@ void memory_engine_destroy(StorageEngine* engine) {
         free(data->tables);
     }
 
+    pthread_rwlock_destroy(&data->catalog_lock);
     free(data);
     free(engine);
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 
 #include "storage_engine.h"
 
+// 哈希桶锁分段数（桶下标按分段数取模映射到锁）
+#define MEMORY_ENGINE_LOCK_STRIPES 64
+
 // 内存表引擎行数据结构
-typedef struct {
+typedef struct MemoryEngineRow {
     Row* row;
     uint64_t row_id;
     struct MemoryEngineRow* next;
@@ -15,20 +18,23 @@ typedef struct {
 typedef struct {
     Table* table;
     MemoryEngineRow** rows; // 哈希表
-    size_t row_count;
+    size_t row_count; // 原子增减
     size_t capacity;
-    uint64_t next_row_id;
+    uint64_t next_row_id; // 原子递增
     uint64_t transaction_id;
     bool in_transaction;
     bool persistent; // 是否持久化
     char* persist_file; // 持久化文件路径
+    pthread_rwlock_t lock; // 保护哈希表结构：行操作共享，扩容和优化独占
+    pthread_mutex_t bucket_locks[MEMORY_ENGINE_LOCK_STRIPES]; // 分段桶锁，保护各桶的链表
 } MemoryEngineTableData;
 
 // 内存表引擎数据结构
 typedef struct {
     MemoryEngineTableData** tables;
     size_t table_count;
-    uint64_t next_transaction_id;
+    uint64_t next_transaction_id; // 原子递增
+    pthread_rwlock_t catalog_lock; // 保护表数组，建表删表独占，数据操作共享
 } MemoryEngineData;
 
 // 创建内存表引擎
@@ -44,8 +50,15 @@ bool memory_engine_insert(StorageEngine* engine, const char* table_name, Row* ro
 bool memory_engine_update(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
 bool memory_engine_delete(StorageEngine* engine, const char* table_name, uint64_t row_id);
 Row* memory_engine_select(StorageEngine* engine, const char* table_name, uint64_t row_id);
+const Row* memory_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id);
+void memory_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view);
 bool memory_engine_batch_insert(StorageEngine* engine, const char* table_name, Row** rows, size_t row_count);
 
+// 内存表引擎扫描操作
+ScanCursor* memory_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options);
+size_t memory_engine_scan_next(StorageEngine* engine, ScanCursor* cursor);
+void memory_engine_scan_close(StorageEngine* engine, ScanCursor* cursor);
+
 // 内存表引擎事务操作
 bool memory_engine_begin_transaction(StorageEngine* engine);
 bool memory_engine_commit_transaction(StorageEngine* engine);
@@ -55,11 +68,21 @@ bool memory_engine_rollback_transaction(StorageEngine* engine);
 bool memory_engine_optimize(StorageEngine* engine, const char* table_name);
 bool memory_engine_checkpoint(StorageEngine* engine);
 
+// 内存表引擎恢复操作
+bool memory_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
+bool memory_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot);
+
 // 内存表引擎销毁
 void memory_engine_destroy(StorageEngine* engine);
 
 // 内存表引擎辅助函数
 MemoryEngineTableData* memory_engine_get_table_data(StorageEngine* engine, const char* table_name);
+MemoryEngineTableData* memory_engine_lock_table(StorageEngine* engine, const char* table_name, bool write);
+void memory_engine_unlock_table(StorageEngine* engine, MemoryEngineTableData* table_data);
+bool memory_engine_has_table_data(StorageEngine* engine, MemoryEngineTableData* table_data);
+bool memory_engine_reserve(StorageEngine* engine, MemoryEngineTableData* table_data, size_t row_count);
+pthread_mutex_t* memory_engine_bucket_lock(MemoryEngineTableData* table_data, uint64_t hash);
+MemoryEngineRow* memory_engine_find_row(MemoryEngineTableData* table_data, uint64_t hash, uint64_t row_id);
 bool memory_engine_expand_table(StorageEngine* engine, MemoryEngineTableData* table_data, size_t new_capacity);
 uint64_t memory_engine_hash(uint64_t row_id, size_t capacity);
 bool memory_engine_persist_table(MemoryEngineTableData* table_data);
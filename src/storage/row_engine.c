@@ -19,9 +19,14 @@ StorageEngine* create_row_engine(void* config) {
     data->tables = NULL;
     data->table_count = 0;
     data->next_transaction_id = 1;
+    pthread_rwlock_init(&data->catalog_lock, NULL);
 
     engine->type = STORAGE_ENGINE_ROW;
     engine->name = "row_engine";
+    engine->wal = NULL;
+    engine->active_transaction = 0;
+    engine->transaction_first_lsn = 0;
+    engine->transaction_base = 0;
     engine->data = data;
 
     // 设置函数指针
@@ -32,18 +37,25 @@ StorageEngine* create_row_engine(void* config) {
     engine->update = row_engine_update;
     engine->delete = row_engine_delete;
     engine->select = row_engine_select;
+    engine->select_view = row_engine_select_view;
+    engine->release_view = row_engine_release_view;
+    engine->scan_open = row_engine_scan_open;
+    engine->scan_next = row_engine_scan_next;
+    engine->scan_close = row_engine_scan_close;
     engine->batch_insert = row_engine_batch_insert;
     engine->begin_transaction = row_engine_begin_transaction;
     engine->commit_transaction = row_engine_commit_transaction;
     engine->rollback_transaction = row_engine_rollback_transaction;
     engine->optimize = row_engine_optimize;
     engine->checkpoint = row_engine_checkpoint;
+    engine->redo_insert = row_engine_redo_insert;
+    engine->snapshot_table = row_engine_snapshot_table;
     engine->destroy = row_engine_destroy;
 
     return engine;
 }
 
-// 获取行存引擎表数据
+// 获取行存引擎表数据（调用方需持有目录锁）
 RowEngineTableData* row_engine_get_table_data(StorageEngine* engine, const char* table_name) {
     if (!engine || !table_name) {
         return NULL;
@@ -59,7 +71,46 @@ RowEngineTableData* row_engine_get_table_data(StorageEngine* engine, const char*
     return NULL;
 }
 
-// 扩展表容量
+// 查找表并加锁，成功时同时持有目录读锁和表锁，目录读锁保证操作期间表不会被删除
+RowEngineTableData* row_engine_lock_table(StorageEngine* engine, const char* table_name, bool write) {
+    RowEngineData* data = (RowEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        return NULL;
+    }
+
+    if (write) {
+        pthread_rwlock_wrlock(&table_data->lock);
+    } else {
+        pthread_rwlock_rdlock(&table_data->lock);
+    }
+
+    return table_data;
+}
+
+// 释放row_engine_lock_table获取的锁
+void row_engine_unlock_table(StorageEngine* engine, RowEngineTableData* table_data) {
+    RowEngineData* data = (RowEngineData*)engine->data;
+    pthread_rwlock_unlock(&table_data->lock);
+    pthread_rwlock_unlock(&data->catalog_lock);
+}
+
+// 检查表数据是否仍属于引擎（调用方需持有目录锁）
+bool row_engine_has_table_data(StorageEngine* engine, RowEngineTableData* table_data) {
+    RowEngineData* data = (RowEngineData*)engine->data;
+    for (size_t i = 0; i < data->table_count; i++) {
+        if (data->tables[i] == table_data) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// 扩展表容量（调用方需持有表写锁）
 bool row_engine_expand_table(StorageEngine* engine, RowEngineTableData* table_data, size_t new_capacity) {
     if (!engine || !table_data || new_capacity <= table_data->capacity) {
         return false;
@@ -89,8 +140,11 @@ bool row_engine_create_table(StorageEngine* engine, Table* table) {
 
     RowEngineData* data = (RowEngineData*)engine->data;
 
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 检查表是否已存在
     if (row_engine_get_table_data(engine, table->name)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table already exists\n");
         return false;
     }
@@ -98,6 +152,7 @@ bool row_engine_create_table(StorageEngine* engine, Table* table) {
     // 创建表数据结构
     RowEngineTableData* table_data = (RowEngineTableData*)malloc(sizeof(RowEngineTableData));
     if (!table_data) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -113,6 +168,7 @@ bool row_engine_create_table(StorageEngine* engine, Table* table) {
     table_data->rows = (Row**)malloc(sizeof(Row*) * table_data->capacity);
     if (!table_data->rows) {
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
@@ -126,9 +182,12 @@ bool row_engine_create_table(StorageEngine* engine, Table* table) {
     if (!new_tables) {
         free(table_data->rows);
         free(table_data);
+        pthread_rwlock_unlock(&data->catalog_lock);
         return false;
     }
 
+    pthread_rwlock_init(&table_data->lock, NULL);
+
     new_tables[data->table_count] = table_data;
     data->tables = new_tables;
     data->table_count++;
@@ -136,6 +195,8 @@ bool row_engine_create_table(StorageEngine* engine, Table* table) {
     // 设置表的引擎特定数据
     table->engine_specific_data = table_data;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
@@ -147,6 +208,9 @@ bool row_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     RowEngineData* data = (RowEngineData*)engine->data;
 
+    // 目录写锁等待所有进行中的操作结束
+    pthread_rwlock_wrlock(&data->catalog_lock);
+
     // 查找表
     size_t table_index = (size_t)-1;
     RowEngineTableData* table_data = NULL;
@@ -159,11 +223,13 @@ bool row_engine_drop_table(StorageEngine* engine, const char* table_name) {
     }
 
     if (table_index == (size_t)-1) {
+        pthread_rwlock_unlock(&data->catalog_lock);
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
     // 释放表数据
+    pthread_rwlock_destroy(&table_data->lock);
     if (table_data->rows) {
         for (size_t i = 0; i < table_data->row_count; i++) {
             if (table_data->rows[i]) {
@@ -186,17 +252,25 @@ bool row_engine_drop_table(StorageEngine* engine, const char* table_name) {
 
     data->table_count--;
 
+    pthread_rwlock_unlock(&data->catalog_lock);
+
     return true;
 }
 
 // 获取表
 Table* row_engine_get_table(StorageEngine* engine, const char* table_name) {
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
-    if (!table_data) {
+    if (!engine || !table_name) {
         return NULL;
     }
 
-    return table_data->table;
+    RowEngineData* data = (RowEngineData*)engine->data;
+
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    Table* table = table_data ? table_data->table : NULL;
+    pthread_rwlock_unlock(&data->catalog_lock);
+
+    return table;
 }
 
 // 插入数据
@@ -205,7 +279,7 @@ bool row_engine_insert(StorageEngine* engine, const char* table_name, Row* row)
         return false;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -215,12 +289,18 @@ bool row_engine_insert(StorageEngine* engine, const char* table_name, Row* row)
     if (table_data->row_count >= table_data->capacity) {
         size_t new_capacity = table_data->capacity * 2;
         if (!row_engine_expand_table(engine, table_data, new_capacity)) {
+            row_engine_unlock_table(engine, table_data);
             return false;
         }
     }
 
-    // 分配行ID
-    uint64_t row_id = table_data->next_row_id++;
+    // 行ID与行下标一一对应，日志记录实际的行下标，回放时放回相同位置
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, table_data->row_count + 1, row, NULL)) {
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    table_data->next_row_id++;
 
     // 设置行版本
     row->version = table_data->transaction_id;
@@ -232,6 +312,8 @@ bool row_engine_insert(StorageEngine* engine, const char* table_name, Row* row)
     // 更新表的行数
     table_data->table->row_count = table_data->row_count;
 
+    row_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
@@ -241,7 +323,7 @@ bool row_engine_batch_insert(StorageEngine* engine, const char* table_name, Row*
         return false;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -254,25 +336,35 @@ bool row_engine_batch_insert(StorageEngine* engine, const char* table_name, Row*
             new_capacity *= 2;
         }
         if (!row_engine_expand_table(engine, table_data, new_capacity)) {
+            row_engine_unlock_table(engine, table_data);
             return false;
         }
     }
 
-    // 批量插入行
+    // 批量插入行，只插入已成功记录日志的行
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    size_t inserted = 0;
     for (size_t i = 0; i < row_count; i++) {
+        if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, table_data->row_count + i + 1, rows[i], NULL)) {
+            break;
+        }
+
         // 设置行版本
         rows[i]->version = table_data->transaction_id;
 
         // 插入行
         table_data->rows[table_data->row_count + i] = rows[i];
+        inserted++;
     }
 
     // 更新表数据
-    table_data->row_count += row_count;
-    table_data->next_row_id += row_count;
+    table_data->row_count += inserted;
+    table_data->next_row_id += inserted;
     table_data->table->row_count = table_data->row_count;
 
-    return true;
+    row_engine_unlock_table(engine, table_data);
+
+    return inserted == row_count;
 }
 
 // 更新数据
@@ -281,7 +373,7 @@ bool row_engine_update(StorageEngine* engine, const char* table_name, uint64_t r
         return false;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -290,6 +382,7 @@ bool row_engine_update(StorageEngine* engine, const char* table_name, uint64_t r
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        row_engine_unlock_table(engine, table_data);
         return false;
     }
 
@@ -306,6 +399,19 @@ bool row_engine_update(StorageEngine* engine, const char* table_name, uint64_t r
 
     if (row_index == (size_t)-1) {
         fprintf(stderr, "Row not found\n");
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 旧行作为撤销镜像记录，已删除的行撤销时重新删除
+    Row* before = table_data->rows[row_index];
+    if (before && before->deleted) {
+        before = NULL;
+    }
+
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_UPDATE, transaction_id, table_data->table, row_id, row, before)) {
+        row_engine_unlock_table(engine, table_data);
         return false;
     }
 
@@ -320,6 +426,8 @@ bool row_engine_update(StorageEngine* engine, const char* table_name, uint64_t r
     // 更新行
     table_data->rows[row_index] = row;
 
+    row_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
@@ -329,7 +437,7 @@ bool row_engine_delete(StorageEngine* engine, const char* table_name, uint64_t r
         return false;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
@@ -338,6 +446,7 @@ bool row_engine_delete(StorageEngine* engine, const char* table_name, uint64_t r
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        row_engine_unlock_table(engine, table_data);
         return false;
     }
 
@@ -354,14 +463,38 @@ bool row_engine_delete(StorageEngine* engine, const char* table_name, uint64_t r
 
     if (row_index == (size_t)-1) {
         fprintf(stderr, "Row not found\n");
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    Row* before = table_data->rows[row_index];
+    if (before && before->deleted) {
+        before = NULL;
+    }
+
+    // 视图和扫描批次可能仍持有旧行，不能原地修改，换成一个空的删除标记行
+    Row* tombstone = create_row(table_data->table->column_count);
+    if (!tombstone) {
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+    tombstone->deleted = true;
+    tombstone->version = table_data->transaction_id;
+
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_DELETE, transaction_id, table_data->table, row_id, NULL, before)) {
+        destroy_row(tombstone);
+        row_engine_unlock_table(engine, table_data);
         return false;
     }
 
     // 标记行为删除状态
     if (table_data->rows[row_index]) {
-        table_data->rows[row_index]->deleted = true;
-        table_data->rows[row_index]->version = table_data->transaction_id;
+        destroy_row(table_data->rows[row_index]);
     }
+    table_data->rows[row_index] = tombstone;
+
+    row_engine_unlock_table(engine, table_data);
 
     return true;
 }
@@ -372,7 +505,7 @@ Row* row_engine_select(StorageEngine* engine, const char* table_name, uint64_t r
         return NULL;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, false);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return NULL;
@@ -381,6 +514,7 @@ Row* row_engine_select(StorageEngine* engine, const char* table_name, uint64_t r
     // 检查行ID是否有效
     if (row_id == 0 || row_id >= table_data->next_row_id) {
         fprintf(stderr, "Invalid row ID\n");
+        row_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
@@ -397,17 +531,125 @@ Row* row_engine_select(StorageEngine* engine, const char* table_name, uint64_t r
 
     if (row_index == (size_t)-1) {
         fprintf(stderr, "Row not found\n");
+        row_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
     Row* row = table_data->rows[row_index];
     if (!row || row->deleted) {
+        row_engine_unlock_table(engine, table_data);
+        return NULL;
+    }
+
+    // 返回行的副本，调用方拥有并负责销毁
+    Row* copy = copy_row(row, table_data->table);
+    row_engine_unlock_table(engine, table_data);
+
+    return copy;
+}
+
+// 查询数据的只读视图
+const Row* row_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id) {
+    if (!engine || !table_name) {
+        return NULL;
+    }
+
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return NULL;
+    }
+
+    // 行ID与行下标一一对应
+    if (row_id == 0 || row_id > table_data->row_count) {
+        row_engine_unlock_table(engine, table_data);
+        return NULL;
+    }
+
+    Row* row = table_data->rows[row_id - 1];
+    if (!row || row->deleted) {
+        row_engine_unlock_table(engine, table_data);
         return NULL;
     }
 
+    // 通过引用计数固定行，更新或删除只会释放引擎自己的引用
+    retain_row(row);
+    row_engine_unlock_table(engine, table_data);
+
     return row;
 }
 
+// 释放只读视图
+void row_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view) {
+    (void)engine;
+    (void)table_name;
+    destroy_row((Row*)view);
+}
+
+// 打开扫描游标
+ScanCursor* row_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options) {
+    if (!engine || !table_name) {
+        return NULL;
+    }
+
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return NULL;
+    }
+
+    ScanCursor* cursor = scan_cursor_create(engine, table_data, table_data->table->column_count, options);
+    row_engine_unlock_table(engine, table_data);
+
+    return cursor;
+}
+
+// 读取下一批数据
+size_t row_engine_scan_next(StorageEngine* engine, ScanCursor* cursor) {
+    if (!engine || !cursor || cursor->finished) {
+        return 0;
+    }
+
+    RowEngineData* data = (RowEngineData*)engine->data;
+    RowEngineTableData* table_data = (RowEngineTableData*)cursor->table_data;
+    cursor->row_count = 0;
+    scan_cursor_release_pins(cursor);
+
+    // 每批重新加锁，批次之间不阻塞写操作；表已被删除时结束扫描
+    pthread_rwlock_rdlock(&data->catalog_lock);
+    if (!row_engine_has_table_data(engine, table_data)) {
+        pthread_rwlock_unlock(&data->catalog_lock);
+        cursor->finished = true;
+        return 0;
+    }
+    pthread_rwlock_rdlock(&table_data->lock);
+
+    // 顺序遍历行数组，直接在原始行上求值谓词，不复制行
+    while (cursor->position < table_data->row_count && !scan_cursor_full(cursor)) {
+        size_t row_index = cursor->position++;
+        Row* row = table_data->rows[row_index];
+        if (!row || row->deleted) {
+            continue;
+        }
+
+        scan_cursor_emit_row(cursor, row, row_index + 1);
+    }
+
+    if (cursor->position >= table_data->row_count) {
+        cursor->finished = true;
+    }
+
+    row_engine_unlock_table(engine, table_data);
+
+    return cursor->row_count;
+}
+
+// 关闭扫描游标
+void row_engine_scan_close(StorageEngine* engine, ScanCursor* cursor) {
+    (void)engine;
+    scan_cursor_destroy(cursor);
+}
+
 // 开始事务
 bool row_engine_begin_transaction(StorageEngine* engine) {
     if (!engine) {
@@ -415,13 +657,18 @@ bool row_engine_begin_transaction(StorageEngine* engine) {
     }
 
     RowEngineData* data = (RowEngineData*)engine->data;
-    uint64_t transaction_id = data->next_transaction_id++;
+    uint64_t transaction_id = __sync_fetch_and_add(&data->next_transaction_id, 1);
+    storage_engine_track_transaction(engine, storage_engine_transaction_id(engine, true, transaction_id));
 
     // 为所有表设置事务ID
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->transaction_id = transaction_id;
         data->tables[i]->in_transaction = true;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
     return true;
 }
@@ -433,13 +680,21 @@ bool row_engine_commit_transaction(StorageEngine* engine) {
     }
 
     RowEngineData* data = (RowEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 提交记录持久化后事务的修改才算提交
+    bool success = storage_engine_log_transaction(engine, WAL_RECORD_COMMIT, transaction_id);
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 回滚事务
@@ -448,15 +703,25 @@ bool row_engine_rollback_transaction(StorageEngine* engine) {
         return false;
     }
 
-    // 简化实现，实际应该恢复到事务开始前的状态
     RowEngineData* data = (RowEngineData*)engine->data;
+    uint64_t transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
+
+    // 按日志中的撤销镜像恢复到事务开始前的状态（未启用日志时无法撤销）
+    bool success = storage_engine_undo_transaction(engine, transaction_id);
 
     // 结束所有表的事务
+    pthread_rwlock_rdlock(&data->catalog_lock);
     for (size_t i = 0; i < data->table_count; i++) {
+        pthread_rwlock_wrlock(&data->tables[i]->lock);
         data->tables[i]->in_transaction = false;
+        pthread_rwlock_unlock(&data->tables[i]->lock);
     }
+    pthread_rwlock_unlock(&data->catalog_lock);
 
-    return true;
+    // 回滚记录之前已写入全部补偿记录，恢复时不再撤销该事务
+    success = storage_engine_log_transaction(engine, WAL_RECORD_ABORT, transaction_id) && success;
+    storage_engine_track_transaction(engine, 0);
+    return success;
 }
 
 // 优化表
@@ -465,21 +730,34 @@ bool row_engine_optimize(StorageEngine* engine, const char* table_name) {
         return false;
     }
 
-    RowEngineTableData* table_data = row_engine_get_table_data(engine, table_name);
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
     if (!table_data) {
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
-    // 压缩表，移除已删除的行
+    // 事务中删除的行回滚时要按原下标恢复，压缩不能撤销，事务结束后才能进行
+    if (table_data->in_transaction) {
+        fprintf(stderr, "Cannot optimize table %s inside a transaction\n", table_name);
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 压缩会改变行下标，回放时需要在相同位置重做
+    if (!storage_engine_log_row(engine, WAL_RECORD_OPTIMIZE, 0, table_data->table, 0, NULL, NULL)) {
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 压缩表，移除已删除的行（恢复时未提交事务留下的空位一并移除）
     size_t new_row_count = 0;
     for (size_t i = 0; i < table_data->row_count; i++) {
-        if (!table_data->rows[i]->deleted) {
+        if (table_data->rows[i] && !table_data->rows[i]->deleted) {
             if (new_row_count != i) {
                 table_data->rows[new_row_count] = table_data->rows[i];
             }
             new_row_count++;
-        } else {
+        } else if (table_data->rows[i]) {
             destroy_row(table_data->rows[i]);
             table_data->rows[i] = NULL;
         }
@@ -502,9 +780,89 @@ bool row_engine_optimize(StorageEngine* engine, const char* table_name) {
     table_data->row_count = new_row_count;
     table_data->table->row_count = new_row_count;
 
+    row_engine_unlock_table(engine, table_data);
+
+    return true;
+}
+
+// 按日志重做插入（行ID即行下标加一，恢复时未提交事务的行不回放，可能留下空位）
+bool row_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row) {
+    if (!engine || !table_name || !row || row_id == 0) {
+        return false;
+    }
+
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, true);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    size_t row_index = (size_t)(row_id - 1);
+    if (row_index >= table_data->capacity) {
+        size_t new_capacity = table_data->capacity;
+        while (new_capacity <= row_index) {
+            new_capacity *= 2;
+        }
+        if (!row_engine_expand_table(engine, table_data, new_capacity)) {
+            row_engine_unlock_table(engine, table_data);
+            return false;
+        }
+    }
+
+    // 撤销删除时按原行ID重新插入，需要记录日志（恢复的重做阶段日志未挂接）
+    uint64_t transaction_id = storage_engine_transaction_id(engine, table_data->in_transaction, table_data->transaction_id);
+    if (!storage_engine_log_row(engine, WAL_RECORD_INSERT, transaction_id, table_data->table, row_id, row, NULL)) {
+        row_engine_unlock_table(engine, table_data);
+        return false;
+    }
+
+    // 行已存在时替换，重复回放结果相同
+    if (table_data->rows[row_index]) {
+        destroy_row(table_data->rows[row_index]);
+    }
+    row->version = table_data->transaction_id;
+    table_data->rows[row_index] = row;
+
+    if (row_index >= table_data->row_count) {
+        table_data->row_count = row_index + 1;
+    }
+    if (table_data->next_row_id <= row_id) {
+        table_data->next_row_id = row_id + 1;
+    }
+    table_data->table->row_count = table_data->row_count;
+
+    row_engine_unlock_table(engine, table_data);
+
     return true;
 }
 
+// 生成表快照（持有表读锁期间只复制行引用，已删除的行作为空位保留行ID）
+bool row_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot) {
+    if (!engine || !table_name || !snapshot) {
+        return false;
+    }
+
+    RowEngineTableData* table_data = row_engine_lock_table(engine, table_name, false);
+    if (!table_data) {
+        fprintf(stderr, "Table not found\n");
+        return false;
+    }
+
+    // 持有表锁时读取日志位置，该表在此之前的修改都已反映在快照中
+    snapshot->lsn = engine->wal ? wal_current_lsn(engine->wal) : 0;
+    snapshot->schema = storage_engine_encode_table(table_data->table, &snapshot->schema_size);
+    bool success = snapshot->schema != NULL;
+
+    for (size_t i = 0; i < table_data->row_count && success; i++) {
+        Row* row = table_data->rows[i];
+        success = table_snapshot_add(snapshot, i + 1, (row && !row->deleted) ? retain_row(row) : NULL);
+    }
+
+    row_engine_unlock_table(engine, table_data);
+
+    return success;
+}
+
 // 执行检查点
 bool row_engine_checkpoint(StorageEngine* engine) {
     // 简化实现，实际应该将内存中的数据持久化到磁盘
@@ -529,6 +887,7 @@ void row_engine_destroy(StorageEngine* engine) {
             }
             free(data->tables[i]->rows);
         }
+        pthread_rwlock_destroy(&data->tables[i]->lock);
         free(data->tables[i]);
     }
 
@@ -536,6 +895,7 @@ void row_engine_destroy(StorageEngine* engine) {
         free(data->tables);
     }
 
+    pthread_rwlock_destroy(&data->catalog_lock);
     free(data);
     free(engine);
 }
\ No newline at end of file
@@ -12,13 +12,15 @@ typedef struct {
     uint64_t next_row_id;
     uint64_t transaction_id;
     bool in_transaction;
+    pthread_rwlock_t lock; // 表级读写锁，写操作独占，查询和扫描共享
 } RowEngineTableData;
 
 // 行存引擎数据结构
 typedef struct {
     RowEngineTableData** tables;
     size_t table_count;
-    uint64_t next_transaction_id;
+    uint64_t next_transaction_id; // 原子递增
+    pthread_rwlock_t catalog_lock; // 保护表数组，建表删表独占，数据操作共享
 } RowEngineData;
 
 // 创建行存引擎
@@ -34,8 +36,15 @@ bool row_engine_insert(StorageEngine* engine, const char* table_name, Row* row);
 bool row_engine_update(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
 bool row_engine_delete(StorageEngine* engine, const char* table_name, uint64_t row_id);
 Row* row_engine_select(StorageEngine* engine, const char* table_name, uint64_t row_id);
+const Row* row_engine_select_view(StorageEngine* engine, const char* table_name, uint64_t row_id);
+void row_engine_release_view(StorageEngine* engine, const char* table_name, const Row* view);
 bool row_engine_batch_insert(StorageEngine* engine, const char* table_name, Row** rows, size_t row_count);
 
+// 行存引擎扫描操作
+ScanCursor* row_engine_scan_open(StorageEngine* engine, const char* table_name, const ScanOptions* options);
+size_t row_engine_scan_next(StorageEngine* engine, ScanCursor* cursor);
+void row_engine_scan_close(StorageEngine* engine, ScanCursor* cursor);
+
 // 行存引擎事务操作
 bool row_engine_begin_transaction(StorageEngine* engine);
 bool row_engine_commit_transaction(StorageEngine* engine);
@@ -45,11 +54,18 @@ bool row_engine_rollback_transaction(StorageEngine* engine);
 bool row_engine_optimize(StorageEngine* engine, const char* table_name);
 bool row_engine_checkpoint(StorageEngine* engine);
 
+// 行存引擎恢复操作
+bool row_engine_redo_insert(StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
+bool row_engine_snapshot_table(StorageEngine* engine, const char* table_name, TableSnapshot* snapshot);
+
 // 行存引擎销毁
 void row_engine_destroy(StorageEngine* engine);
 
 // 行存引擎辅助函数
 RowEngineTableData* row_engine_get_table_data(StorageEngine* engine, const char* table_name);
+RowEngineTableData* row_engine_lock_table(StorageEngine* engine, const char* table_name, bool write);
+void row_engine_unlock_table(StorageEngine* engine, RowEngineTableData* table_data);
+bool row_engine_has_table_data(StorageEngine* engine, RowEngineTableData* table_data);
 bool row_engine_expand_table(StorageEngine* engine, RowEngineTableData* table_data, size_t new_capacity);
 
 #endif // ROW_ENGINE_H
\ No newline at end of file
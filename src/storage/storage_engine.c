@@ -3,12 +3,22 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
 
 // 存储引擎实现前向声明
 static StorageEngine* create_row_storage_engine(config_system *config);
 static StorageEngine* create_column_storage_engine(config_system *config);
 static StorageEngine* create_memory_storage_engine(config_system *config);
 
+// 预写日志前向声明
+static bool storage_engine_open_wal(StorageEngineManager* manager, config_system *config);
+static bool storage_engine_sync_log(StorageEngineManager* manager, bool success);
+static void* storage_engine_checkpointer_main(void* arg);
+
 // 初始化存储引擎管理器
 StorageEngineManager* storage_engine_manager_init(config_system *config) {
     StorageEngineManager* manager = (StorageEngineManager*)malloc(sizeof(StorageEngineManager));
@@ -18,15 +28,62 @@ StorageEngineManager* storage_engine_manager_init(config_system *config) {
 
     manager->tables = NULL;
     manager->table_count = 0;
+    manager->wal = NULL;
+    pthread_rwlock_init(&manager->lock, NULL);
+    pthread_mutex_init(&manager->checkpoint_lock, NULL);
+    pthread_mutex_init(&manager->checkpointer_mutex, NULL);
+    pthread_cond_init(&manager->checkpointer_cond, NULL);
+    manager->checkpointer_running = false;
+    manager->checkpoint_interval = 0;
+    manager->checkpoint_lsn = 0;
 
     // 初始化三种存储引擎
     manager->engines[STORAGE_ENGINE_ROW] = create_row_storage_engine(config);
     manager->engines[STORAGE_ENGINE_COLUMN] = create_column_storage_engine(config);
     manager->engines[STORAGE_ENGINE_MEMORY] = create_memory_storage_engine(config);
 
+    // 打开预写日志并回放已提交的修改（需要显式启用）
+    if (config && config_get_bool(config, "storage.wal_enabled", false)) {
+        if (!storage_engine_open_wal(manager, config)) {
+            storage_engine_manager_destroy(manager);
+            return NULL;
+        }
+
+        // 定期执行检查点，限制重启时需要重做的日志量
+        int interval = config_get_int(config, "storage.checkpoint_interval", 300);
+        if (interval > 0) {
+            manager->checkpoint_interval = (uint32_t)interval;
+            manager->checkpointer_running = true;
+            if (pthread_create(&manager->checkpointer, NULL, storage_engine_checkpointer_main, manager) != 0) {
+                manager->checkpointer_running = false;
+                fprintf(stderr, "Failed to start checkpointer\n");
+            }
+        }
+    }
+
     return manager;
 }
 
+// 查找表所属的存储引擎（表列表只在读锁内访问，返回后引擎自行加锁）
+static StorageEngine* storage_engine_find_engine(StorageEngineManager* manager, const char* table_name) {
+    StorageEngine* engine = NULL;
+
+    pthread_rwlock_rdlock(&manager->lock);
+    for (size_t i = 0; i < manager->table_count; i++) {
+        if (strcmp(manager->tables[i]->name, table_name) == 0) {
+            engine = manager->engines[manager->tables[i]->storage_engine_type];
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&manager->lock);
+
+    if (!engine) {
+        fprintf(stderr, "Table not found\n");
+    }
+
+    return engine;
+}
+
 // 创建存储引擎
 StorageEngine* storage_engine_create(int type, config_system *config) {
     switch (type) {
@@ -53,6 +110,7 @@ bool storage_engine_register(StorageEngineManager* manager, StorageEngine* engin
         return false;
     }
 
+    engine->wal = manager->wal;
     manager->engines[engine->type] = engine;
     return true;
 }
@@ -63,37 +121,65 @@ bool storage_engine_create_table(StorageEngineManager* manager, Table* table) {
         return false;
     }
 
+    // 选择存储引擎
+    int engine_type = table->storage_engine_type;
+    if (engine_type < 0 || engine_type >= 3 || !manager->engines[engine_type]) {
+        fprintf(stderr, "Invalid storage engine type\n");
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&manager->lock);
+
     // 检查表是否已存在
     for (size_t i = 0; i < manager->table_count; i++) {
         if (strcmp(manager->tables[i]->name, table->name) == 0) {
+            pthread_rwlock_unlock(&manager->lock);
             fprintf(stderr, "Table already exists\n");
             return false;
         }
     }
 
-    // 选择存储引擎
-    int engine_type = table->storage_engine_type;
-    if (engine_type < 0 || engine_type >= 3 || !manager->engines[engine_type]) {
-        fprintf(stderr, "Invalid storage engine type\n");
+    // 先扩展表列表，保证引擎建表成功后登记不会失败
+    Table** new_tables = (Table**)realloc(manager->tables, sizeof(Table*) * (manager->table_count + 1));
+    if (!new_tables) {
+        pthread_rwlock_unlock(&manager->lock);
         return false;
     }
+    manager->tables = new_tables;
 
     // 调用存储引擎的创建表方法
-    if (!manager->engines[engine_type]->create_table(manager->engines[engine_type], table)) {
+    StorageEngine* engine = manager->engines[engine_type];
+    if (!engine->create_table(engine, table)) {
+        pthread_rwlock_unlock(&manager->lock);
         return false;
     }
 
-    // 添加到表列表
-    Table** new_tables = (Table**)realloc(manager->tables, sizeof(Table*) * (manager->table_count + 1));
-    if (!new_tables) {
-        return false;
+    // 在管理器写锁内记录日志，保证建表记录先于该表的任何数据修改
+    uint64_t lsn = 0;
+    if (manager->wal) {
+        size_t size = 0;
+        void* data = storage_engine_encode_table(table, &size);
+        if (data) {
+            lsn = wal_append(manager->wal, WAL_RECORD_CREATE_TABLE, 0, table->name, 0, data, size);
+            free(data);
+        }
+
+        if (lsn == 0) {
+            engine->drop_table(engine, table->name);
+            table->engine_specific_data = NULL;
+            pthread_rwlock_unlock(&manager->lock);
+            fprintf(stderr, "Failed to log table creation\n");
+            return false;
+        }
     }
 
-    new_tables[manager->table_count] = table;
-    manager->tables = new_tables;
+    // 添加到表列表
+    manager->tables[manager->table_count] = table;
     manager->table_count++;
 
-    return true;
+    pthread_rwlock_unlock(&manager->lock);
+
+    return lsn == 0 || wal_flush(manager->wal, lsn);
 }
 
 // 删除表
@@ -102,6 +188,8 @@ bool storage_engine_drop_table(StorageEngineManager* manager, const char* table_
         return false;
     }
 
+    pthread_rwlock_wrlock(&manager->lock);
+
     // 查找表
     size_t table_index = (size_t)-1;
     Table* table = NULL;
@@ -114,16 +202,23 @@ bool storage_engine_drop_table(StorageEngineManager* manager, const char* table_
     }
 
     if (table_index == (size_t)-1) {
+        pthread_rwlock_unlock(&manager->lock);
         fprintf(stderr, "Table not found\n");
         return false;
     }
 
     // 调用存储引擎的删除表方法
-    int engine_type = table->storage_engine_type;
-    if (!manager->engines[engine_type]->drop_table(manager->engines[engine_type], table_name)) {
+    StorageEngine* engine = manager->engines[table->storage_engine_type];
+    if (!engine->drop_table(engine, table_name)) {
+        pthread_rwlock_unlock(&manager->lock);
         return false;
     }
 
+    uint64_t lsn = 0;
+    if (manager->wal) {
+        lsn = wal_append(manager->wal, WAL_RECORD_DROP_TABLE, 0, table_name, 0, NULL, 0);
+    }
+
     // 从表列表中移除
     for (size_t i = table_index; i < manager->table_count - 1; i++) {
         manager->tables[i] = manager->tables[i + 1];
@@ -136,10 +231,13 @@ bool storage_engine_drop_table(StorageEngineManager* manager, const char* table_
 
     manager->table_count--;
 
-    // 释放表资源
+    pthread_rwlock_unlock(&manager->lock);
+
+    // 释放表资源（引擎表数据已由存储引擎释放）
+    table->engine_specific_data = NULL;
     destroy_table(table);
 
-    return true;
+    return lsn == 0 || wal_flush(manager->wal, lsn);
 }
 
 // 获取表
@@ -148,16 +246,14 @@ Table* storage_engine_get_table(StorageEngineManager* manager, const char* table
         return NULL;
     }
 
-    // 查找表
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            // 调用存储引擎的获取表方法
-            int engine_type = manager->tables[i]->storage_engine_type;
-            return manager->engines[engine_type]->get_table(manager->engines[engine_type], table_name);
-        }
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return NULL;
     }
 
-    return NULL;
+    // 调用存储引擎的获取表方法
+    return engine->get_table(engine, table_name);
 }
 
 // 插入数据
@@ -166,30 +262,15 @@ bool storage_engine_insert(StorageEngineManager* manager, const char* table_name
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的插入方法
-    int engine_type = table->storage_engine_type;
-    if (!manager->engines[engine_type]->insert(manager->engines[engine_type], table_name, row)) {
-        return false;
-    }
-
-    // 更新表的行数
-    table->row_count++;
-
-    return true;
+    // 表的行数由存储引擎维护
+    return storage_engine_sync_log(manager, engine->insert(engine, table_name, row));
 }
 
 // 更新数据
@@ -198,23 +279,14 @@ bool storage_engine_update(StorageEngineManager* manager, const char* table_name
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的更新方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->update(manager->engines[engine_type], table_name, row_id, row);
+    return storage_engine_sync_log(manager, engine->update(engine, table_name, row_id, row));
 }
 
 // 删除数据
@@ -223,23 +295,14 @@ bool storage_engine_delete(StorageEngineManager* manager, const char* table_name
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的删除方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->delete(manager->engines[engine_type], table_name, row_id);
+    return storage_engine_sync_log(manager, engine->delete(engine, table_name, row_id));
 }
 
 // 查询数据
@@ -248,55 +311,104 @@ Row* storage_engine_select(StorageEngineManager* manager, const char* table_name
         return NULL;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return NULL;
     }
 
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 调用存储引擎的查询方法
+    return engine->select(engine, table_name, row_id);
+}
+
+// 查询数据的只读视图
+const Row* storage_engine_select_view(StorageEngineManager* manager, const char* table_name, uint64_t row_id) {
+    if (!manager || !table_name) {
         return NULL;
     }
 
-    // 调用存储引擎的查询方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->select(manager->engines[engine_type], table_name, row_id);
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return NULL;
+    }
+
+    // 调用存储引擎的视图查询方法
+    return engine->select_view(engine, table_name, row_id);
 }
 
-// 批量插入数据
-bool storage_engine_batch_insert(StorageEngineManager* manager, const char* table_name, Row** rows, size_t row_count) {
-    if (!manager || !table_name || !rows || row_count == 0) {
-        return false;
+// 释放只读视图
+void storage_engine_release_view(StorageEngineManager* manager, const char* table_name, const Row* view) {
+    if (!manager || !table_name || !view) {
+        return;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return;
     }
 
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
-        return false;
+    // 调用存储引擎的视图释放方法
+    engine->release_view(engine, table_name, view);
+}
+
+// 打开扫描游标
+ScanCursor* storage_engine_scan_open(StorageEngineManager* manager, const char* table_name, const ScanOptions* options) {
+    if (!manager || !table_name) {
+        return NULL;
     }
 
-    // 调用存储引擎的批量插入方法
-    int engine_type = table->storage_engine_type;
-    if (!manager->engines[engine_type]->batch_insert(manager->engines[engine_type], table_name, rows, row_count)) {
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return NULL;
+    }
+
+    // 调用存储引擎的扫描方法
+    return engine->scan_open(engine, table_name, options);
+}
+
+// 读取下一批数据
+size_t storage_engine_scan_next(StorageEngineManager* manager, ScanCursor* cursor) {
+    if (!manager || !cursor || !cursor->engine) {
+        return 0;
+    }
+
+    StorageEngine* engine = (StorageEngine*)cursor->engine;
+    return engine->scan_next(engine, cursor);
+}
+
+// 关闭扫描游标
+void storage_engine_scan_close(StorageEngineManager* manager, ScanCursor* cursor) {
+    if (!manager || !cursor) {
+        return;
+    }
+
+    if (!cursor->engine) {
+        scan_cursor_destroy(cursor);
+        return;
+    }
+
+    StorageEngine* engine = (StorageEngine*)cursor->engine;
+    engine->scan_close(engine, cursor);
+}
+
+// 批量插入数据
+bool storage_engine_batch_insert(StorageEngineManager* manager, const char* table_name, Row** rows, size_t row_count) {
+    if (!manager || !table_name || !rows || row_count == 0) {
         return false;
     }
 
-    // 更新表的行数
-    table->row_count += row_count;
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
+        return false;
+    }
 
-    return true;
+    // 调用存储引擎的批量插入方法
+    // 表的行数由存储引擎维护
+    return storage_engine_sync_log(manager, engine->batch_insert(engine, table_name, rows, row_count));
 }
 
 // 开始事务
@@ -305,23 +417,14 @@ bool storage_engine_begin_transaction(StorageEngineManager* manager, const char*
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的开始事务方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->begin_transaction(manager->engines[engine_type]);
+    return engine->begin_transaction(engine);
 }
 
 // 提交事务
@@ -330,23 +433,14 @@ bool storage_engine_commit_transaction(StorageEngineManager* manager, const char
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的提交事务方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->commit_transaction(manager->engines[engine_type]);
+    return storage_engine_sync_log(manager, engine->commit_transaction(engine));
 }
 
 // 回滚事务
@@ -355,23 +449,14 @@ bool storage_engine_rollback_transaction(StorageEngineManager* manager, const ch
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的回滚事务方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->rollback_transaction(manager->engines[engine_type]);
+    return storage_engine_sync_log(manager, engine->rollback_transaction(engine));
 }
 
 // 优化表
@@ -380,23 +465,14 @@ bool storage_engine_optimize(StorageEngineManager* manager, const char* table_na
         return false;
     }
 
-    // 查找表
-    Table* table = NULL;
-    for (size_t i = 0; i < manager->table_count; i++) {
-        if (strcmp(manager->tables[i]->name, table_name) == 0) {
-            table = manager->tables[i];
-            break;
-        }
-    }
-
-    if (!table) {
-        fprintf(stderr, "Table not found\n");
+    // 查找表所属的存储引擎
+    StorageEngine* engine = storage_engine_find_engine(manager, table_name);
+    if (!engine) {
         return false;
     }
 
     // 调用存储引擎的优化方法
-    int engine_type = table->storage_engine_type;
-    return manager->engines[engine_type]->optimize(manager->engines[engine_type], table_name);
+    return storage_engine_sync_log(manager, engine->optimize(engine, table_name));
 }
 
 // 执行检查点
@@ -410,6 +486,11 @@ bool storage_engine_checkpoint(StorageEngineManager* manager, int engine_type) {
         return false;
     }
 
+    // 启用日志时先写出所有表的模糊检查点，再调用引擎自身的检查点
+    if (!storage_engine_manager_checkpoint(manager)) {
+        return false;
+    }
+
     return manager->engines[engine_type]->checkpoint(manager->engines[engine_type]);
 }
 
@@ -419,8 +500,18 @@ void storage_engine_manager_destroy(StorageEngineManager* manager) {
         return;
     }
 
-    // 销毁所有表
+    // 先停止后台检查点线程
+    if (manager->checkpointer_running) {
+        pthread_mutex_lock(&manager->checkpointer_mutex);
+        manager->checkpointer_running = false;
+        pthread_cond_signal(&manager->checkpointer_cond);
+        pthread_mutex_unlock(&manager->checkpointer_mutex);
+        pthread_join(manager->checkpointer, NULL);
+    }
+
+    // 销毁所有表（引擎表数据由存储引擎在销毁时释放）
     for (size_t i = 0; i < manager->table_count; i++) {
+        manager->tables[i]->engine_specific_data = NULL;
         destroy_table(manager->tables[i]);
     }
     if (manager->tables) {
@@ -434,6 +525,13 @@ void storage_engine_manager_destroy(StorageEngineManager* manager) {
         }
     }
 
+    // 所有操作已结束，关闭日志前会把缓冲区中的记录写盘
+    wal_close(manager->wal);
+
+    pthread_rwlock_destroy(&manager->lock);
+    pthread_mutex_destroy(&manager->checkpoint_lock);
+    pthread_mutex_destroy(&manager->checkpointer_mutex);
+    pthread_cond_destroy(&manager->checkpointer_cond);
     free(manager);
 }
 
@@ -492,16 +590,62 @@ Row* create_row(size_t column_count) {
     row->value_count = column_count;
     row->deleted = false;
     row->version = 0;
+    row->ref_count = 1;
 
     return row;
 }
 
-// 销毁行
+// 增加行的引用
+Row* retain_row(Row* row) {
+    if (row) {
+        __sync_add_and_fetch(&row->ref_count, 1);
+    }
+    return row;
+}
+
+// 深拷贝行（值大小由表的列类型决定）
+Row* copy_row(const Row* row, const Table* table) {
+    if (!row) {
+        return NULL;
+    }
+
+    Row* copy = create_row(row->value_count);
+    if (!copy) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < row->value_count; i++) {
+        if (!row->values[i]) {
+            continue;
+        }
+
+        const Column* column = (table && i < table->column_count) ? &table->columns[i] : NULL;
+        size_t value_size = storage_value_size(column, row->values[i]);
+        copy->values[i] = malloc(value_size);
+        if (!copy->values[i]) {
+            destroy_row(copy);
+            return NULL;
+        }
+        memcpy(copy->values[i], row->values[i], value_size);
+    }
+
+    copy->version = row->version;
+    copy->deleted = row->deleted;
+
+    return copy;
+}
+
+// 销毁行（释放一个引用，最后一个引用释放时回收内存）
 void destroy_row(Row* row) {
     if (!row) {
         return;
     }
 
+    // 引用计数可能被多个线程同时释放，只有减到零的线程回收内存
+    if (__sync_sub_and_fetch(&row->ref_count, 1) > 0) {
+        return;
+    }
+
     if (row->values) {
         // 释放值（假设值是动态分配的）
         for (size_t i = 0; i < row->value_count; i++) {
@@ -554,6 +698,1743 @@ void destroy_column(Column* column) {
     }
 }
 
+// 计算列值的存储大小
+size_t storage_value_size(const Column* column, const void* value) {
+    if (!column) {
+        return 64;
+    }
+
+    switch (column->data_type) {
+        case DATA_TYPE_INT:
+            return sizeof(int);
+        case DATA_TYPE_BIGINT:
+            return sizeof(int64_t);
+        case DATA_TYPE_FLOAT:
+            return sizeof(float);
+        case DATA_TYPE_DOUBLE:
+            return sizeof(double);
+        case DATA_TYPE_CHAR:
+        case DATA_TYPE_VARCHAR:
+            return value ? strlen((const char*)value) + 1 : 0;
+        case DATA_TYPE_DATE:
+        case DATA_TYPE_DATETIME:
+            return sizeof(time_t);
+        case DATA_TYPE_BOOLEAN:
+            return sizeof(bool);
+        case DATA_TYPE_BLOB:
+            // 假设BLOB值是一个包含大小和数据的结构
+            // 这里简化处理
+            return 1024;
+        default:
+            return 64;
+    }
+}
+
+// 编码缓冲区
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} StorageCodecBuffer;
+
+// 解码读取位置
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+} StorageCodecReader;
+
+// 空值的长度标记
+#define STORAGE_CODEC_NULL UINT32_MAX
+
+// 向编码缓冲区追加数据
+static void storage_codec_put(StorageCodecBuffer* buffer, const void* bytes, size_t size) {
+    if (buffer->failed || size == 0) {
+        return;
+    }
+
+    if (buffer->size + size > buffer->capacity) {
+        size_t new_capacity = buffer->capacity ? buffer->capacity : 64;
+        while (new_capacity < buffer->size + size) {
+            new_capacity *= 2;
+        }
+        uint8_t* new_data = (uint8_t*)realloc(buffer->data, new_capacity);
+        if (!new_data) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+
+    memcpy(buffer->data + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+static void storage_codec_put_u32(StorageCodecBuffer* buffer, uint32_t value) {
+    storage_codec_put(buffer, &value, sizeof(value));
+}
+
+// 追加带长度前缀的值，NULL编码为空值标记
+static void storage_codec_put_value(StorageCodecBuffer* buffer, const void* value, size_t size) {
+    if (!value) {
+        storage_codec_put_u32(buffer, STORAGE_CODEC_NULL);
+        return;
+    }
+
+    storage_codec_put_u32(buffer, (uint32_t)size);
+    storage_codec_put(buffer, value, size);
+}
+
+// 结束编码，返回数据（调用方释放）
+static void* storage_codec_finish(StorageCodecBuffer* buffer, size_t* size) {
+    if (buffer->failed) {
+        free(buffer->data);
+        return NULL;
+    }
+
+    *size = buffer->size;
+    return buffer->data;
+}
+
+// 从解码位置读取数据
+static bool storage_codec_get(StorageCodecReader* reader, void* bytes, size_t size) {
+    if (reader->size - reader->offset < size) {
+        return false;
+    }
+
+    memcpy(bytes, reader->data + reader->offset, size);
+    reader->offset += size;
+    return true;
+}
+
+// 读取带长度前缀的值，返回新分配的副本，空值时value为NULL
+static bool storage_codec_get_value(StorageCodecReader* reader, void** value, size_t extra) {
+    uint32_t size;
+    if (!storage_codec_get(reader, &size, sizeof(size))) {
+        return false;
+    }
+
+    *value = NULL;
+    if (size == STORAGE_CODEC_NULL) {
+        return true;
+    }
+
+    if (reader->size - reader->offset < size) {
+        return false;
+    }
+
+    // extra用于给字符串追加结束符
+    uint8_t* copy = (uint8_t*)malloc(size + extra + 1);
+    if (!copy) {
+        return false;
+    }
+    memcpy(copy, reader->data + reader->offset, size);
+    memset(copy + size, 0, extra + 1);
+    reader->offset += size;
+
+    *value = copy;
+    return true;
+}
+
+// 追加行编码（值个数，之后每个值为长度和内容）
+static void storage_codec_put_row(StorageCodecBuffer* buffer, const Table* table, const Row* row) {
+    storage_codec_put_u32(buffer, (uint32_t)row->value_count);
+    for (size_t i = 0; i < row->value_count; i++) {
+        const Column* column = (table && i < table->column_count) ? &table->columns[i] : NULL;
+        const void* value = row->values[i];
+        storage_codec_put_value(buffer, value, value ? storage_value_size(column, value) : 0);
+    }
+}
+
+// 编码行
+void* storage_engine_encode_row(const Table* table, const Row* row, size_t* size) {
+    if (!row || !size) {
+        return NULL;
+    }
+
+    StorageCodecBuffer buffer = {NULL, 0, 0, false};
+    storage_codec_put_row(&buffer, table, row);
+
+    return storage_codec_finish(&buffer, size);
+}
+
+// 编码行修改记录的数据：重做镜像长度（u32）、重做镜像（新行）、撤销镜像（旧行），镜像可以为空
+static void* storage_engine_encode_images(const Table* table, const Row* redo, const Row* undo, size_t* size) {
+    StorageCodecBuffer buffer = {NULL, 0, 0, false};
+
+    storage_codec_put_u32(&buffer, 0);
+    if (redo) {
+        storage_codec_put_row(&buffer, table, redo);
+    }
+    if (!buffer.failed) {
+        uint32_t redo_size = (uint32_t)(buffer.size - sizeof(uint32_t));
+        memcpy(buffer.data, &redo_size, sizeof(redo_size));
+    }
+    if (undo) {
+        storage_codec_put_row(&buffer, table, undo);
+    }
+
+    return storage_codec_finish(&buffer, size);
+}
+
+// 解码行
+Row* storage_engine_decode_row(const Table* table, const uint8_t* data, size_t size) {
+    StorageCodecReader reader = {data, size, 0};
+
+    uint32_t value_count;
+    if (!storage_codec_get(&reader, &value_count, sizeof(value_count))) {
+        return NULL;
+    }
+
+    size_t column_count = table ? table->column_count : value_count;
+    Row* row = create_row(column_count);
+    if (!row) {
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < value_count; i++) {
+        void* value;
+        if (!storage_codec_get_value(&reader, &value, 0)) {
+            destroy_row(row);
+            return NULL;
+        }
+
+        // 表结构与日志不一致时丢弃多余的值
+        if (i < column_count) {
+            row->values[i] = value;
+        } else {
+            free(value);
+        }
+    }
+
+    return row;
+}
+
+// 编码表结构（引擎类型、列数，之后每列的名称、类型和约束）
+void* storage_engine_encode_table(const Table* table, size_t* size) {
+    if (!table || !size) {
+        return NULL;
+    }
+
+    StorageCodecBuffer buffer = {NULL, 0, 0, false};
+    storage_codec_put_u32(&buffer, (uint32_t)table->storage_engine_type);
+    storage_codec_put_u32(&buffer, (uint32_t)table->column_count);
+    for (size_t i = 0; i < table->column_count; i++) {
+        const Column* column = &table->columns[i];
+        uint64_t length = column->length;
+        uint8_t flags[3] = {column->nullable, column->primary_key, column->auto_increment};
+
+        storage_codec_put_value(&buffer, column->name, column->name ? strlen(column->name) : 0);
+        storage_codec_put_u32(&buffer, (uint32_t)column->data_type);
+        storage_codec_put(&buffer, &length, sizeof(length));
+        storage_codec_put(&buffer, flags, sizeof(flags));
+        storage_codec_put_value(&buffer, column->default_value,
+                                column->default_value ? storage_value_size(column, column->default_value) : 0);
+    }
+
+    return storage_codec_finish(&buffer, size);
+}
+
+// 解码表结构
+Table* storage_engine_decode_table(const char* name, const uint8_t* data, size_t size) {
+    StorageCodecReader reader = {data, size, 0};
+
+    uint32_t engine_type;
+    uint32_t column_count;
+    if (!storage_codec_get(&reader, &engine_type, sizeof(engine_type)) ||
+        !storage_codec_get(&reader, &column_count, sizeof(column_count)) ||
+        column_count > size) {
+        return NULL;
+    }
+
+    Column* columns = (Column*)calloc(column_count ? column_count : 1, sizeof(Column));
+    if (!columns) {
+        return NULL;
+    }
+
+    bool success = true;
+    for (uint32_t i = 0; i < column_count && success; i++) {
+        Column* column = &columns[i];
+        uint32_t data_type;
+        uint64_t length;
+        uint8_t flags[3];
+        void* column_name;
+
+        success = storage_codec_get_value(&reader, &column_name, 0) &&
+                  storage_codec_get(&reader, &data_type, sizeof(data_type)) &&
+                  storage_codec_get(&reader, &length, sizeof(length)) &&
+                  storage_codec_get(&reader, flags, sizeof(flags));
+        if (!success) {
+            break;
+        }
+
+        column->name = (char*)column_name;
+        column->data_type = (int)data_type;
+        column->length = (size_t)length;
+        column->nullable = flags[0];
+        column->primary_key = flags[1];
+        column->auto_increment = flags[2];
+        success = storage_codec_get_value(&reader, &column->default_value, 0);
+    }
+
+    Table* table = success ? create_table(name, columns, column_count, (int)engine_type) : NULL;
+    if (!table) {
+        for (uint32_t i = 0; i < column_count; i++) {
+            destroy_column(&columns[i]);
+        }
+        free(columns);
+    }
+
+    return table;
+}
+
+// 本线程最近一次需要持久化的日志位置（自动提交的修改和事务提交记录）
+static __thread uint64_t storage_engine_pending_lsn = 0;
+
+// 撤销过程中的补偿上下文（撤销时调用引擎的普通写操作，由日志函数据此写入补偿记录）
+typedef struct {
+    bool active;
+    uint64_t transaction_id; // 被撤销的事务
+    uint64_t undo_lsn; // 被撤销的记录
+} StorageCompensation;
+
+static __thread StorageCompensation storage_engine_compensation = {false, 0, 0};
+
+// 生成日志中的事务ID，高8位区分引擎（各引擎的事务ID独立分配），0表示自动提交
+// 引擎内的事务ID重启后从1开始，加上恢复时确定的偏移避免与日志中已有的事务重复
+uint64_t storage_engine_transaction_id(StorageEngine* engine, bool in_transaction, uint64_t transaction_id) {
+    if (!engine || !in_transaction) {
+        return 0;
+    }
+
+    return ((uint64_t)engine->type << 56) | (engine->transaction_base + transaction_id);
+}
+
+// 记录行修改日志（row为新行，before为撤销用的旧行，均可为NULL）
+bool storage_engine_log_row(StorageEngine* engine, WalRecordType type, uint64_t transaction_id, const Table* table, uint64_t row_id, const Row* row, const Row* before) {
+    if (!engine || !engine->wal) {
+        return true;
+    }
+
+    WalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.transaction_id = transaction_id;
+    record.row_id = row_id;
+    record.table_name = table ? table->name : NULL;
+    record.table_name_length = record.table_name ? strlen(record.table_name) : 0;
+
+    // 撤销产生的修改记为所属事务的补偿记录，补偿记录本身不再撤销
+    if (storage_engine_compensation.active) {
+        record.transaction_id = storage_engine_compensation.transaction_id;
+        record.undo_lsn = storage_engine_compensation.undo_lsn;
+        record.flags = WAL_RECORD_FLAG_COMPENSATION;
+        before = NULL;
+    }
+
+    void* data = NULL;
+    size_t size = 0;
+    if (type == WAL_RECORD_INSERT || type == WAL_RECORD_UPDATE || type == WAL_RECORD_DELETE) {
+        data = storage_engine_encode_images(table, row, before, &size);
+        if (!data) {
+            return false;
+        }
+    }
+    record.data = (const uint8_t*)data;
+    record.data_length = size;
+
+    uint64_t lsn = wal_append_record(engine->wal, &record);
+    free(data);
+    if (lsn == 0) {
+        return false;
+    }
+
+    // 自动提交的修改在操作返回前持久化，事务内的修改等到提交时一起持久化
+    if (record.transaction_id == 0 && lsn > storage_engine_pending_lsn) {
+        storage_engine_pending_lsn = lsn;
+    }
+
+    return true;
+}
+
+// 记录事务提交或回滚
+bool storage_engine_log_transaction(StorageEngine* engine, WalRecordType type, uint64_t transaction_id) {
+    if (!engine || !engine->wal || transaction_id == 0) {
+        return true;
+    }
+
+    uint64_t lsn = wal_append(engine->wal, type, transaction_id, NULL, 0, NULL, 0);
+    if (lsn == 0) {
+        return false;
+    }
+
+    if (type == WAL_RECORD_COMMIT && lsn > storage_engine_pending_lsn) {
+        storage_engine_pending_lsn = lsn;
+    }
+
+    return true;
+}
+
+// 记录引擎当前的事务（开始时记下日志位置，回滚和检查点从这里查找事务的记录），0表示事务结束
+// 先写入开始位置再写入事务ID，检查点读到事务ID时开始位置已经有效
+void storage_engine_track_transaction(StorageEngine* engine, uint64_t transaction_id) {
+    if (!engine) {
+        return;
+    }
+
+    if (transaction_id != 0) {
+        __atomic_store_n(&engine->transaction_first_lsn, engine->wal ? wal_current_lsn(engine->wal) : 0, __ATOMIC_SEQ_CST);
+    }
+    __atomic_store_n(&engine->active_transaction, transaction_id, __ATOMIC_SEQ_CST);
+}
+
+// 等待本线程的日志持久化（在释放所有锁之后调用，多个线程的等待由一次fsync满足）
+static bool storage_engine_sync_log(StorageEngineManager* manager, bool success) {
+    uint64_t lsn = storage_engine_pending_lsn;
+    storage_engine_pending_lsn = 0;
+
+    if (!success || !manager->wal || lsn == 0) {
+        return success;
+    }
+
+    return wal_flush(manager->wal, lsn);
+}
+
+// 检查点文件（位于日志目录，文件名中的LSN为检查点开始位置）
+#define STORAGE_CHECKPOINT_MAGIC 0x54504B43 // "CKPT"
+#define STORAGE_CHECKPOINT_PREFIX "checkpoint_"
+#define STORAGE_CHECKPOINT_FILE_FORMAT "checkpoint_%016llx.dat"
+#define STORAGE_CHECKPOINT_TEMP_FORMAT "checkpoint_%016llx.tmp"
+
+// 检查点写入缓冲区超过此大小时写入文件
+#define STORAGE_CHECKPOINT_BUFFER_SIZE (1024 * 1024)
+
+// 并行重做的线程数，以及缓冲的重做记录达到此大小时先行应用
+#define STORAGE_REDO_THREADS 4
+#define STORAGE_REDO_BUFFER_LIMIT (64 * 1024 * 1024)
+
+// 检查点中的表（恢复时该表LSN之前的记录已反映在快照中）
+typedef struct {
+    char* name;
+    uint64_t lsn;
+} StorageRecoveryTable;
+
+// 分析阶段发现的事务
+typedef struct {
+    uint64_t transaction_id;
+    bool finished; // 已提交或已回滚
+} StorageRecoveryTransaction;
+
+// 缓冲的重做记录（只保留重做镜像）
+typedef struct {
+    uint64_t lsn;
+    uint64_t row_id;
+    WalRecordType type;
+    uint8_t* data;
+    size_t data_length;
+} StorageRedoRecord;
+
+// 单表的重做队列，同一表的记录按日志顺序应用，不同表并行
+typedef struct {
+    char* table_name;
+    StorageRedoRecord* records;
+    size_t record_count;
+    size_t record_capacity;
+} StorageRedoQueue;
+
+// 日志恢复上下文
+typedef struct {
+    StorageEngineManager* manager;
+
+    // 检查点
+    uint64_t begin_lsn; // 重做起点
+    uint64_t catalog_lsn; // 检查点读取表目录时的LSN，之前的建表删表已反映在检查点中
+    uint64_t analysis_lsn; // 分析起点（不晚于检查点时活跃事务的第一条记录）
+    StorageRecoveryTable* tables;
+    size_t table_count;
+
+    // 分析
+    StorageRecoveryTransaction* transactions;
+    size_t transaction_count;
+    size_t transaction_capacity;
+    uint64_t max_transaction[3]; // 各引擎日志中出现过的最大事务ID（不含引擎类型位）
+
+    // 重做
+    StorageRedoQueue* queues;
+    size_t queue_count;
+    size_t queue_capacity;
+    size_t buffered; // 队列中缓冲的字节数
+    size_t next_queue; // 工作线程领取队列的位置（原子递增）
+    size_t applied; // 原子递增
+    size_t failed; // 原子递增
+    bool aborted; // 内存不足等无法继续恢复的错误
+} StorageRecoveryContext;
+
+// 撤销阶段收集的记录
+typedef struct {
+    uint64_t lsn;
+    uint64_t transaction_id;
+    uint64_t row_id;
+    WalRecordType type;
+    char* table_name;
+    uint8_t* undo; // 撤销镜像（旧行）
+    size_t undo_length;
+} StorageUndoRecord;
+
+// 撤销上下文
+typedef struct {
+    const uint64_t* transactions; // 需要撤销的事务（已排序）
+    size_t transaction_count;
+    StorageUndoRecord* records;
+    size_t record_count;
+    size_t record_capacity;
+    uint64_t* compensated; // 已被补偿记录撤销过的LSN
+    size_t compensated_count;
+    size_t compensated_capacity;
+    bool failed;
+} StorageUndoContext;
+
+static int storage_engine_compare_transaction_id(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// 复制记录中的表名（不以'\0'结尾）
+static char* storage_engine_record_table_name(const WalRecord* record) {
+    char* table_name = (char*)malloc(record->table_name_length + 1);
+    if (table_name) {
+        memcpy(table_name, record->table_name, record->table_name_length);
+        table_name[record->table_name_length] = '\0';
+    }
+    return table_name;
+}
+
+// 拆分行修改记录的数据：重做镜像长度（u32）、重做镜像（新行）、撤销镜像（旧行）
+static bool storage_engine_split_images(const uint8_t* data, size_t size,
+                                        const uint8_t** redo, size_t* redo_size,
+                                        const uint8_t** undo, size_t* undo_size) {
+    uint32_t length;
+    if (!data || size < sizeof(length)) {
+        return false;
+    }
+
+    memcpy(&length, data, sizeof(length));
+    if (length > size - sizeof(length)) {
+        return false;
+    }
+
+    *redo = data + sizeof(length);
+    *redo_size = length;
+    *undo = *redo + length;
+    *undo_size = size - sizeof(length) - length;
+    return true;
+}
+
+// 撤销阶段第一步：收集需要撤销的记录和已补偿的记录
+static bool storage_engine_collect_undo(const WalRecord* record, void* arg) {
+    StorageUndoContext* context = (StorageUndoContext*)arg;
+
+    if (record->type != WAL_RECORD_INSERT && record->type != WAL_RECORD_UPDATE && record->type != WAL_RECORD_DELETE) {
+        return true;
+    }
+    if (record->transaction_id == 0 ||
+        !bsearch(&record->transaction_id, context->transactions, context->transaction_count, sizeof(uint64_t), storage_engine_compare_transaction_id)) {
+        return true;
+    }
+
+    // 补偿记录只说明对应的记录已撤销
+    if (record->flags & WAL_RECORD_FLAG_COMPENSATION) {
+        if (context->compensated_count >= context->compensated_capacity) {
+            size_t new_capacity = context->compensated_capacity ? context->compensated_capacity * 2 : 64;
+            uint64_t* new_compensated = (uint64_t*)realloc(context->compensated, sizeof(uint64_t) * new_capacity);
+            if (!new_compensated) {
+                context->failed = true;
+                return false;
+            }
+            context->compensated = new_compensated;
+            context->compensated_capacity = new_capacity;
+        }
+        context->compensated[context->compensated_count++] = record->undo_lsn;
+        return true;
+    }
+
+    const uint8_t* redo;
+    const uint8_t* undo;
+    size_t redo_size;
+    size_t undo_size;
+    if (!storage_engine_split_images(record->data, record->data_length, &redo, &redo_size, &undo, &undo_size)) {
+        fprintf(stderr, "Invalid WAL record at LSN %llu\n", (unsigned long long)record->lsn);
+        return true;
+    }
+
+    if (context->record_count >= context->record_capacity) {
+        size_t new_capacity = context->record_capacity ? context->record_capacity * 2 : 64;
+        StorageUndoRecord* new_records = (StorageUndoRecord*)realloc(context->records, sizeof(StorageUndoRecord) * new_capacity);
+        if (!new_records) {
+            context->failed = true;
+            return false;
+        }
+        context->records = new_records;
+        context->record_capacity = new_capacity;
+    }
+
+    StorageUndoRecord* undo_record = &context->records[context->record_count];
+    undo_record->lsn = record->lsn;
+    undo_record->transaction_id = record->transaction_id;
+    undo_record->row_id = record->row_id;
+    undo_record->type = record->type;
+    undo_record->table_name = storage_engine_record_table_name(record);
+    undo_record->undo = undo_size > 0 ? (uint8_t*)malloc(undo_size) : NULL;
+    undo_record->undo_length = undo_size;
+    if (!undo_record->table_name || (undo_size > 0 && !undo_record->undo)) {
+        free(undo_record->table_name);
+        free(undo_record->undo);
+        context->failed = true;
+        return false;
+    }
+    if (undo_size > 0) {
+        memcpy(undo_record->undo, undo, undo_size);
+    }
+
+    context->record_count++;
+    return true;
+}
+
+// 撤销一条记录：插入撤销为删除，更新恢复旧行，删除按原行ID重新插入旧行
+static bool storage_engine_undo_record(StorageEngine* engine, const StorageUndoRecord* record) {
+    Row* before = NULL;
+    if (record->undo_length > 0) {
+        Table* table = engine->get_table(engine, record->table_name);
+        before = table ? storage_engine_decode_row(table, record->undo, record->undo_length) : NULL;
+        if (!before) {
+            return false;
+        }
+    }
+
+    switch (record->type) {
+        case WAL_RECORD_INSERT:
+            destroy_row(before);
+            return engine->delete(engine, record->table_name, record->row_id);
+        case WAL_RECORD_UPDATE:
+            // 更新前行已删除时没有撤销镜像，撤销为重新删除
+            if (!before) {
+                return engine->delete(engine, record->table_name, record->row_id);
+            }
+            // 引擎只在成功时接管旧行
+            if (!engine->update(engine, record->table_name, record->row_id, before)) {
+                destroy_row(before);
+                return false;
+            }
+            return true;
+        case WAL_RECORD_DELETE:
+            if (!before) {
+                return true;
+            }
+            if (!engine->redo_insert(engine, record->table_name, record->row_id, before)) {
+                destroy_row(before);
+                return false;
+            }
+            return true;
+        default:
+            destroy_row(before);
+            return true;
+    }
+}
+
+// 撤销指定事务的修改（按日志倒序，跳过已有补偿记录的修改，每次撤销写入一条补偿记录）
+// 引擎按事务ID中的引擎类型选择，engines中为NULL的引擎的事务被跳过
+static bool storage_engine_undo(StorageEngine** engines, WriteAheadLog* wal, uint64_t start_lsn, uint64_t* transactions, size_t transaction_count) {
+    if (transaction_count == 0) {
+        return true;
+    }
+
+    qsort(transactions, transaction_count, sizeof(uint64_t), storage_engine_compare_transaction_id);
+
+    StorageUndoContext context;
+    memset(&context, 0, sizeof(context));
+    context.transactions = transactions;
+    context.transaction_count = transaction_count;
+
+    // 回放前会先把缓冲区中的日志写盘，事务的全部记录都能读到
+    bool success = wal_replay(wal, start_lsn, storage_engine_collect_undo, &context) && !context.failed;
+    if (success) {
+        qsort(context.compensated, context.compensated_count, sizeof(uint64_t), storage_engine_compare_transaction_id);
+
+        size_t failed = 0;
+        for (size_t i = context.record_count; i > 0; i--) {
+            StorageUndoRecord* record = &context.records[i - 1];
+            if (bsearch(&record->lsn, context.compensated, context.compensated_count, sizeof(uint64_t), storage_engine_compare_transaction_id)) {
+                continue;
+            }
+
+            uint64_t engine_type = record->transaction_id >> 56;
+            StorageEngine* engine = engine_type < 3 ? engines[engine_type] : NULL;
+            if (!engine) {
+                continue;
+            }
+
+            storage_engine_compensation.active = true;
+            storage_engine_compensation.transaction_id = record->transaction_id;
+            storage_engine_compensation.undo_lsn = record->lsn;
+            bool undone = storage_engine_undo_record(engine, record);
+            storage_engine_compensation.active = false;
+
+            if (!undone) {
+                failed++;
+                fprintf(stderr, "Failed to undo WAL record at LSN %llu\n", (unsigned long long)record->lsn);
+            }
+        }
+        success = failed == 0;
+    }
+
+    for (size_t i = 0; i < context.record_count; i++) {
+        free(context.records[i].table_name);
+        free(context.records[i].undo);
+    }
+    free(context.records);
+    free(context.compensated);
+
+    return success;
+}
+
+// 撤销引擎当前事务的修改（回滚时调用，此时事务尚未结束）
+bool storage_engine_undo_transaction(StorageEngine* engine, uint64_t transaction_id) {
+    if (!engine || transaction_id == 0) {
+        return true;
+    }
+
+    // 撤销镜像只记录在日志中，未启用日志时无法撤销事务的修改
+    if (!engine->wal) {
+        fprintf(stderr, "Cannot roll back a transaction without the write-ahead log\n");
+        return false;
+    }
+
+    StorageEngine* engines[3] = {NULL, NULL, NULL};
+    engines[engine->type] = engine;
+
+    uint64_t start_lsn = __atomic_load_n(&engine->transaction_first_lsn, __ATOMIC_SEQ_CST);
+    return storage_engine_undo(engines, engine->wal, start_lsn, &transaction_id, 1);
+}
+
+// 查找检查点中的表
+static StorageRecoveryTable* storage_engine_find_recovery_table(StorageRecoveryContext* context, const char* table_name) {
+    for (size_t i = 0; i < context->table_count; i++) {
+        if (strcmp(context->tables[i].name, table_name) == 0) {
+            return &context->tables[i];
+        }
+    }
+    return NULL;
+}
+
+// 登记分析阶段发现的事务（从后向前查找，最近的事务最可能再次出现）
+static StorageRecoveryTransaction* storage_engine_add_recovery_transaction(StorageRecoveryContext* context, uint64_t transaction_id) {
+    for (size_t i = context->transaction_count; i > 0; i--) {
+        if (context->transactions[i - 1].transaction_id == transaction_id) {
+            return &context->transactions[i - 1];
+        }
+    }
+
+    if (context->transaction_count >= context->transaction_capacity) {
+        size_t new_capacity = context->transaction_capacity ? context->transaction_capacity * 2 : 64;
+        StorageRecoveryTransaction* new_transactions = (StorageRecoveryTransaction*)realloc(
+            context->transactions, sizeof(StorageRecoveryTransaction) * new_capacity);
+        if (!new_transactions) {
+            return NULL;
+        }
+        context->transactions = new_transactions;
+        context->transaction_capacity = new_capacity;
+    }
+
+    // 记录各引擎出现过的最大事务ID，恢复后新事务的ID从其之后分配
+    uint64_t engine_type = transaction_id >> 56;
+    uint64_t local_id = transaction_id & ((1ULL << 56) - 1);
+    if (engine_type < 3 && local_id > context->max_transaction[engine_type]) {
+        context->max_transaction[engine_type] = local_id;
+    }
+
+    StorageRecoveryTransaction* transaction = &context->transactions[context->transaction_count++];
+    transaction->transaction_id = transaction_id;
+    transaction->finished = false;
+    return transaction;
+}
+
+// 分析阶段：确定崩溃时未完成的事务
+static bool storage_engine_analyze_record(const WalRecord* record, void* arg) {
+    StorageRecoveryContext* context = (StorageRecoveryContext*)arg;
+    if (record->transaction_id == 0) {
+        return true;
+    }
+
+    StorageRecoveryTransaction* transaction = storage_engine_add_recovery_transaction(context, record->transaction_id);
+    if (!transaction) {
+        context->aborted = true;
+        return false;
+    }
+
+    if (record->type == WAL_RECORD_COMMIT || record->type == WAL_RECORD_ABORT) {
+        transaction->finished = true;
+    }
+
+    return true;
+}
+
+// 应用一条重做记录
+static bool storage_engine_redo_apply(StorageEngine* engine, const char* table_name, const StorageRedoRecord* record) {
+    switch (record->type) {
+        case WAL_RECORD_INSERT:
+        case WAL_RECORD_UPDATE: {
+            Table* table = engine->get_table(engine, table_name);
+            Row* row = table ? storage_engine_decode_row(table, record->data, record->data_length) : NULL;
+            if (!row) {
+                return false;
+            }
+
+            // 引擎只在成功时接管行
+            bool applied = record->type == WAL_RECORD_INSERT ? engine->redo_insert(engine, table_name, record->row_id, row)
+                                                             : engine->update(engine, table_name, record->row_id, row);
+            if (!applied) {
+                destroy_row(row);
+            }
+            return applied;
+        }
+        case WAL_RECORD_DELETE:
+            return engine->delete(engine, table_name, record->row_id);
+        case WAL_RECORD_OPTIMIZE:
+            return engine->optimize(engine, table_name);
+        default:
+            return true;
+    }
+}
+
+// 重做工作线程：逐个领取表队列并按顺序应用
+static void* storage_engine_redo_worker(void* arg) {
+    StorageRecoveryContext* context = (StorageRecoveryContext*)arg;
+
+    while (true) {
+        size_t index = __sync_fetch_and_add(&context->next_queue, 1);
+        if (index >= context->queue_count) {
+            break;
+        }
+
+        StorageRedoQueue* queue = &context->queues[index];
+        StorageEngine* engine = storage_engine_find_engine(context->manager, queue->table_name);
+        for (size_t i = 0; i < queue->record_count; i++) {
+            StorageRedoRecord* record = &queue->records[i];
+            if (engine && storage_engine_redo_apply(engine, queue->table_name, record)) {
+                __sync_add_and_fetch(&context->applied, 1);
+            } else {
+                __sync_add_and_fetch(&context->failed, 1);
+                fprintf(stderr, "Failed to redo WAL record at LSN %llu\n", (unsigned long long)record->lsn);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// 并行应用所有缓冲的重做记录（遇到建表删表或缓冲过多时调用）
+static void storage_engine_redo_flush(StorageRecoveryContext* context) {
+    if (context->queue_count == 0) {
+        return;
+    }
+
+    size_t thread_count = context->queue_count < STORAGE_REDO_THREADS ? context->queue_count : STORAGE_REDO_THREADS;
+    pthread_t threads[STORAGE_REDO_THREADS];
+    size_t started = 0;
+
+    context->next_queue = 0;
+    for (size_t i = 1; i < thread_count; i++) {
+        if (pthread_create(&threads[started], NULL, storage_engine_redo_worker, context) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    // 当前线程也参与，线程创建失败时由它处理剩余的队列
+    storage_engine_redo_worker(context);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < context->queue_count; i++) {
+        StorageRedoQueue* queue = &context->queues[i];
+        for (size_t j = 0; j < queue->record_count; j++) {
+            free(queue->records[j].data);
+        }
+        free(queue->records);
+        free(queue->table_name);
+    }
+    context->queue_count = 0;
+    context->buffered = 0;
+}
+
+// 把重做记录加入所属表的队列
+static bool storage_engine_redo_enqueue(StorageRecoveryContext* context, const WalRecord* record, const char* table_name) {
+    const uint8_t* redo = NULL;
+    const uint8_t* undo;
+    size_t redo_size = 0;
+    size_t undo_size;
+    if (record->type != WAL_RECORD_OPTIMIZE &&
+        !storage_engine_split_images(record->data, record->data_length, &redo, &redo_size, &undo, &undo_size)) {
+        __sync_add_and_fetch(&context->failed, 1);
+        fprintf(stderr, "Invalid WAL record at LSN %llu\n", (unsigned long long)record->lsn);
+        return true;
+    }
+
+    // 查找表队列（通常只有少量表，顺序查找）
+    StorageRedoQueue* queue = NULL;
+    for (size_t i = context->queue_count; i > 0 && !queue; i--) {
+        if (strcmp(context->queues[i - 1].table_name, table_name) == 0) {
+            queue = &context->queues[i - 1];
+        }
+    }
+
+    if (!queue) {
+        if (context->queue_count >= context->queue_capacity) {
+            size_t new_capacity = context->queue_capacity ? context->queue_capacity * 2 : 8;
+            StorageRedoQueue* new_queues = (StorageRedoQueue*)realloc(context->queues, sizeof(StorageRedoQueue) * new_capacity);
+            if (!new_queues) {
+                return false;
+            }
+            context->queues = new_queues;
+            context->queue_capacity = new_capacity;
+        }
+
+        queue = &context->queues[context->queue_count];
+        queue->table_name = strdup(table_name);
+        queue->records = NULL;
+        queue->record_count = 0;
+        queue->record_capacity = 0;
+        if (!queue->table_name) {
+            return false;
+        }
+        context->queue_count++;
+    }
+
+    if (queue->record_count >= queue->record_capacity) {
+        size_t new_capacity = queue->record_capacity ? queue->record_capacity * 2 : 64;
+        StorageRedoRecord* new_records = (StorageRedoRecord*)realloc(queue->records, sizeof(StorageRedoRecord) * new_capacity);
+        if (!new_records) {
+            return false;
+        }
+        queue->records = new_records;
+        queue->record_capacity = new_capacity;
+    }
+
+    StorageRedoRecord* redo_record = &queue->records[queue->record_count];
+    redo_record->lsn = record->lsn;
+    redo_record->row_id = record->row_id;
+    redo_record->type = record->type;
+    redo_record->data = redo_size > 0 ? (uint8_t*)malloc(redo_size) : NULL;
+    redo_record->data_length = redo_size;
+    if (redo_size > 0) {
+        if (!redo_record->data) {
+            return false;
+        }
+        memcpy(redo_record->data, redo, redo_size);
+    }
+    queue->record_count++;
+
+    context->buffered += sizeof(StorageRedoRecord) + redo_size;
+    if (context->buffered >= STORAGE_REDO_BUFFER_LIMIT) {
+        storage_engine_redo_flush(context);
+    }
+
+    return true;
+}
+
+// 重做阶段：重复历史，包括未完成事务的修改（之后由撤销阶段回滚）
+// 检查点已包含的修改被跳过：快照LSN之前的表记录，以及读取表目录之前已删除的表
+static bool storage_engine_redo_record(const WalRecord* record, void* arg) {
+    StorageRecoveryContext* context = (StorageRecoveryContext*)arg;
+    StorageEngineManager* manager = context->manager;
+
+    // 磁盘索引的页面记录由索引打开时自行重做
+    if (record->type == WAL_RECORD_COMMIT || record->type == WAL_RECORD_ABORT || record->type == WAL_RECORD_INDEX_PAGE) {
+        return true;
+    }
+
+    char* table_name = storage_engine_record_table_name(record);
+    if (!table_name) {
+        context->aborted = true;
+        return false;
+    }
+
+    StorageRecoveryTable* checkpoint_table = storage_engine_find_recovery_table(context, table_name);
+    if ((checkpoint_table && record->lsn < checkpoint_table->lsn) ||
+        (!checkpoint_table && record->lsn < context->catalog_lsn)) {
+        free(table_name);
+        return true;
+    }
+
+    if (record->type != WAL_RECORD_CREATE_TABLE && record->type != WAL_RECORD_DROP_TABLE) {
+        bool success = storage_engine_redo_enqueue(context, record, table_name);
+        free(table_name);
+        if (!success) {
+            context->aborted = true;
+        }
+        return success;
+    }
+
+    // 建表删表改变表目录，先应用之前缓冲的全部记录
+    storage_engine_redo_flush(context);
+
+    bool success = false;
+    if (record->type == WAL_RECORD_CREATE_TABLE) {
+        Table* table = storage_engine_decode_table(table_name, record->data, record->data_length);
+        success = table && storage_engine_create_table(manager, table);
+        if (table && !success) {
+            destroy_table(table);
+        }
+    } else {
+        success = storage_engine_drop_table(manager, table_name);
+    }
+
+    if (success) {
+        context->applied++;
+    } else {
+        context->failed++;
+        fprintf(stderr, "Failed to redo WAL record at LSN %llu\n", (unsigned long long)record->lsn);
+    }
+
+    free(table_name);
+    return true;
+}
+
+// 读取带长度前缀的数据（返回指向解码缓冲区的指针）
+static bool storage_codec_get_bytes(StorageCodecReader* reader, const uint8_t** bytes, size_t* size) {
+    uint32_t length;
+    if (!storage_codec_get(reader, &length, sizeof(length)) || reader->size - reader->offset < length) {
+        return false;
+    }
+
+    *bytes = reader->data + reader->offset;
+    *size = length;
+    reader->offset += length;
+    return true;
+}
+
+// 读取整个文件
+static uint8_t* storage_engine_read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    uint8_t* data = NULL;
+    long length = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        length = ftell(file);
+    }
+    if (length >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = (uint8_t*)malloc(length > 0 ? (size_t)length : 1);
+        if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+
+    *size = length > 0 ? (size_t)length : 0;
+    return data;
+}
+
+// 同步目录（保证文件重命名持久化）
+static bool storage_engine_sync_directory(const char* directory) {
+    int fd = open(directory, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    bool success = fsync(fd) == 0;
+    close(fd);
+    return success;
+}
+
+// 列出目录中的检查点文件，按检查点LSN从新到旧排序
+static size_t storage_engine_list_checkpoints(const char* directory, uint64_t** lsns, bool temporary) {
+    *lsns = NULL;
+
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long long lsn;
+        char suffix[8];
+        if (strncmp(entry->d_name, STORAGE_CHECKPOINT_PREFIX, strlen(STORAGE_CHECKPOINT_PREFIX)) != 0 ||
+            sscanf(entry->d_name, "checkpoint_%16llx.%7s", &lsn, suffix) != 2) {
+            continue;
+        }
+        if (strcmp(suffix, temporary ? "tmp" : "dat") != 0) {
+            continue;
+        }
+
+        if (count >= capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 8;
+            uint64_t* new_lsns = (uint64_t*)realloc(*lsns, sizeof(uint64_t) * new_capacity);
+            if (!new_lsns) {
+                break;
+            }
+            *lsns = new_lsns;
+            capacity = new_capacity;
+        }
+        (*lsns)[count++] = (uint64_t)lsn;
+    }
+    closedir(dir);
+
+    qsort(*lsns, count, sizeof(uint64_t), storage_engine_compare_transaction_id);
+    for (size_t i = 0; i < count / 2; i++) {
+        uint64_t lsn = (*lsns)[i];
+        (*lsns)[i] = (*lsns)[count - 1 - i];
+        (*lsns)[count - 1 - i] = lsn;
+    }
+
+    return count;
+}
+
+// 按检查点重建表和数据，返回false表示检查点内容无效
+static bool storage_engine_apply_checkpoint(StorageRecoveryContext* context, const uint8_t* data, size_t size) {
+    StorageEngineManager* manager = context->manager;
+    StorageCodecReader reader = {data, size, 0};
+
+    uint32_t magic;
+    uint32_t transaction_count;
+    if (!storage_codec_get(&reader, &magic, sizeof(magic)) || magic != STORAGE_CHECKPOINT_MAGIC ||
+        !storage_codec_get(&reader, &context->begin_lsn, sizeof(uint64_t)) ||
+        !storage_codec_get(&reader, &context->catalog_lsn, sizeof(uint64_t)) ||
+        !storage_codec_get(&reader, &context->analysis_lsn, sizeof(uint64_t)) ||
+        !storage_codec_get(&reader, &transaction_count, sizeof(transaction_count))) {
+        return false;
+    }
+
+    // 检查点时的活跃事务，分析阶段没有遇到其提交或回滚记录时作为未完成事务撤销
+    for (uint32_t i = 0; i < transaction_count; i++) {
+        uint64_t transaction[2];
+        if (!storage_codec_get(&reader, transaction, sizeof(transaction)) ||
+            !storage_engine_add_recovery_transaction(context, transaction[0])) {
+            return false;
+        }
+    }
+
+    uint32_t table_count;
+    if (!storage_codec_get(&reader, &table_count, sizeof(table_count)) || table_count > size) {
+        return false;
+    }
+
+    context->tables = (StorageRecoveryTable*)calloc(table_count ? table_count : 1, sizeof(StorageRecoveryTable));
+    if (!context->tables) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < table_count; i++) {
+        void* name;
+        const uint8_t* schema;
+        size_t schema_size;
+        uint64_t lsn;
+        if (!storage_codec_get_value(&reader, &name, 0) || !name) {
+            return false;
+        }
+        context->tables[context->table_count].name = (char*)name;
+        context->table_count++;
+
+        if (!storage_codec_get_bytes(&reader, &schema, &schema_size) ||
+            !storage_codec_get(&reader, &lsn, sizeof(lsn))) {
+            return false;
+        }
+        context->tables[context->table_count - 1].lsn = lsn;
+
+        Table* table = storage_engine_decode_table((char*)name, schema, schema_size);
+        if (!table) {
+            return false;
+        }
+        if (!storage_engine_create_table(manager, table)) {
+            destroy_table(table);
+            return false;
+        }
+
+        // 快照中的行按原行ID放回，空位先插入再删除以保留行ID的分配位置
+        StorageEngine* engine = manager->engines[table->storage_engine_type];
+        while (true) {
+            uint64_t row_id;
+            uint32_t row_size;
+            if (!storage_codec_get(&reader, &row_id, sizeof(row_id))) {
+                return false;
+            }
+            if (row_id == 0) {
+                break;
+            }
+            if (!storage_codec_get(&reader, &row_size, sizeof(row_size))) {
+                return false;
+            }
+
+            Row* row;
+            if (row_size == STORAGE_CODEC_NULL) {
+                row = create_row(table->column_count);
+            } else if (reader.size - reader.offset >= row_size) {
+                row = storage_engine_decode_row(table, reader.data + reader.offset, row_size);
+                reader.offset += row_size;
+            } else {
+                return false;
+            }
+
+            if (!row) {
+                return false;
+            }
+            if (!engine->redo_insert(engine, table->name, row_id, row)) {
+                destroy_row(row);
+                return false;
+            }
+            if (row_size == STORAGE_CODEC_NULL && !engine->delete(engine, table->name, row_id)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// 加载最新的有效检查点，没有检查点时从日志开头恢复
+static bool storage_engine_load_checkpoint(StorageRecoveryContext* context, WriteAheadLog* wal) {
+    uint64_t* lsns;
+    size_t count = storage_engine_list_checkpoints(wal->directory, &lsns, false);
+
+    bool loaded = false;
+    bool success = true;
+    for (size_t i = 0; i < count && !loaded; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/" STORAGE_CHECKPOINT_FILE_FORMAT, wal->directory, (unsigned long long)lsns[i]);
+
+        size_t size = 0;
+        uint8_t* data = storage_engine_read_file(path, &size);
+        uint32_t checksum = 0;
+        if (data && size >= sizeof(checksum)) {
+            memcpy(&checksum, data + size - sizeof(checksum), sizeof(checksum));
+        }
+
+        // 校验失败的检查点（例如写入时崩溃）被忽略，尝试更早的检查点
+        if (!data || size < sizeof(checksum) || checksum != wal_checksum(0, data, size - sizeof(checksum))) {
+            fprintf(stderr, "Ignoring invalid checkpoint: %s\n", path);
+            free(data);
+            continue;
+        }
+
+        // 校验通过后开始重建，失败时引擎中已有部分数据，无法再尝试其他检查点
+        success = storage_engine_apply_checkpoint(context, data, size - sizeof(checksum));
+        if (!success) {
+            fprintf(stderr, "Failed to load checkpoint: %s\n", path);
+        }
+        loaded = true;
+        free(data);
+    }
+    free(lsns);
+
+    if (!loaded) {
+        context->begin_lsn = 0;
+        context->catalog_lsn = 0;
+        context->analysis_lsn = 0;
+    }
+    context->manager->checkpoint_lsn = context->begin_lsn;
+
+    return success;
+}
+
+// 释放恢复上下文
+static void storage_engine_recovery_cleanup(StorageRecoveryContext* context) {
+    storage_engine_redo_flush(context);
+    free(context->queues);
+
+    for (size_t i = 0; i < context->table_count; i++) {
+        free(context->tables[i].name);
+    }
+    free(context->tables);
+    free(context->transactions);
+}
+
+// 打开预写日志并执行崩溃恢复（加载检查点、分析、重做、撤销）
+static bool storage_engine_open_wal(StorageEngineManager* manager, config_system *config) {
+    WalConfig wal_config;
+    wal_config.directory = config_get_string(config, "storage.wal_dir", "./data/wal");
+    wal_config.buffer_size = (size_t)config_get_int(config, "storage.wal_buffer_size", 16) * 1024 * 1024;
+    wal_config.segment_size = (uint64_t)config_get_int(config, "storage.wal_segment_size", 64) * 1024 * 1024;
+    wal_config.commit_delay_us = (uint32_t)config_get_int(config, "storage.wal_commit_delay_us", 0);
+
+    WriteAheadLog* wal = wal_open(&wal_config);
+    if (!wal) {
+        fprintf(stderr, "Failed to open write-ahead log\n");
+        return false;
+    }
+
+    // 加载检查点和重做期间引擎和管理器不记录日志，重做的修改本身已在日志中
+    StorageRecoveryContext context;
+    memset(&context, 0, sizeof(context));
+    context.manager = manager;
+
+    bool success = storage_engine_load_checkpoint(&context, wal);
+    if (success) {
+        success = wal_replay(wal, context.analysis_lsn, storage_engine_analyze_record, &context) && !context.aborted;
+    }
+    if (success) {
+        success = wal_replay(wal, context.begin_lsn, storage_engine_redo_record, &context) && !context.aborted;
+        storage_engine_redo_flush(&context);
+    }
+
+    if (!success) {
+        storage_engine_recovery_cleanup(&context);
+        wal_close(wal);
+        return false;
+    }
+
+    if (context.failed > 0) {
+        fprintf(stderr, "WAL recovery skipped %zu records\n", context.failed);
+    }
+
+    // 挂接日志，之后的撤销写入补偿记录；新事务的ID不与日志中已有的事务重复
+    manager->wal = wal;
+    for (int i = 0; i < 3; i++) {
+        if (manager->engines[i]) {
+            manager->engines[i]->transaction_base = context.max_transaction[i];
+            manager->engines[i]->wal = wal;
+        }
+    }
+
+    // 撤销崩溃时未完成的事务，完成后写入回滚记录
+    uint64_t* losers = (uint64_t*)malloc(sizeof(uint64_t) * (context.transaction_count ? context.transaction_count : 1));
+    size_t loser_count = 0;
+    for (size_t i = 0; losers && i < context.transaction_count; i++) {
+        if (!context.transactions[i].finished) {
+            losers[loser_count++] = context.transactions[i].transaction_id;
+        }
+    }
+
+    success = losers && storage_engine_undo(manager->engines, wal, context.analysis_lsn, losers, loser_count);
+    for (size_t i = 0; success && i < loser_count; i++) {
+        success = wal_append(wal, WAL_RECORD_ABORT, losers[i], NULL, 0, NULL, 0) != 0;
+    }
+    if (success) {
+        success = wal_flush(wal, wal_current_lsn(wal));
+    }
+    if (!success) {
+        fprintf(stderr, "Failed to roll back incomplete transactions\n");
+    }
+
+    free(losers);
+    storage_engine_recovery_cleanup(&context);
+
+    return success;
+}
+
+// 检查点写入状态（数据先在编码缓冲区中累积，定期写入文件并更新校验和）
+typedef struct {
+    FILE* file;
+    StorageCodecBuffer buffer;
+    uint32_t checksum;
+    bool failed;
+} StorageCheckpointWriter;
+
+static void storage_checkpoint_drain(StorageCheckpointWriter* writer) {
+    if (writer->buffer.failed) {
+        writer->failed = true;
+    }
+    if (writer->failed || writer->buffer.size == 0) {
+        return;
+    }
+
+    if (fwrite(writer->buffer.data, 1, writer->buffer.size, writer->file) != writer->buffer.size) {
+        writer->failed = true;
+        return;
+    }
+    writer->checksum = wal_checksum(writer->checksum, writer->buffer.data, writer->buffer.size);
+    writer->buffer.size = 0;
+}
+
+// 写入一个表的快照：表名、表结构、快照LSN、行（行ID、行长度、行数据），以行ID 0结束
+static void storage_checkpoint_write_table(StorageCheckpointWriter* writer, const char* table_name, const Table* table, const TableSnapshot* snapshot) {
+    uint64_t end = 0;
+
+    storage_codec_put_value(&writer->buffer, table_name, strlen(table_name));
+    storage_codec_put_value(&writer->buffer, snapshot->schema, snapshot->schema_size);
+    storage_codec_put(&writer->buffer, &snapshot->lsn, sizeof(snapshot->lsn));
+
+    for (size_t i = 0; i < snapshot->row_count && !writer->failed; i++) {
+        storage_codec_put(&writer->buffer, &snapshot->row_ids[i], sizeof(uint64_t));
+        if (!snapshot->rows[i]) {
+            storage_codec_put_u32(&writer->buffer, STORAGE_CODEC_NULL);
+        } else {
+            // 先写入长度占位，编码后回填
+            size_t offset = writer->buffer.size;
+            storage_codec_put_u32(&writer->buffer, 0);
+            storage_codec_put_row(&writer->buffer, table, snapshot->rows[i]);
+            if (!writer->buffer.failed) {
+                uint32_t row_size = (uint32_t)(writer->buffer.size - offset - sizeof(uint32_t));
+                memcpy(writer->buffer.data + offset, &row_size, sizeof(row_size));
+            }
+        }
+
+        if (writer->buffer.size >= STORAGE_CHECKPOINT_BUFFER_SIZE) {
+            storage_checkpoint_drain(writer);
+        }
+    }
+
+    storage_codec_put(&writer->buffer, &end, sizeof(end));
+}
+
+// 删除早于指定检查点的检查点文件和未完成的临时文件
+static void storage_engine_remove_checkpoints(const char* directory, uint64_t lsn) {
+    for (int temporary = 0; temporary < 2; temporary++) {
+        uint64_t* lsns;
+        size_t count = storage_engine_list_checkpoints(directory, &lsns, temporary);
+        for (size_t i = 0; i < count; i++) {
+            if (lsns[i] >= lsn && !temporary) {
+                continue;
+            }
+
+            char path[1024];
+            if (temporary) {
+                snprintf(path, sizeof(path), "%s/" STORAGE_CHECKPOINT_TEMP_FORMAT, directory, (unsigned long long)lsns[i]);
+            } else {
+                snprintf(path, sizeof(path), "%s/" STORAGE_CHECKPOINT_FILE_FORMAT, directory, (unsigned long long)lsns[i]);
+            }
+            unlink(path);
+        }
+        free(lsns);
+    }
+}
+
+// 执行模糊检查点
+// 快照逐表生成，每个表只在复制行期间阻塞写操作；整个检查点期间持有管理器读锁，只阻塞建表删表
+bool storage_engine_manager_checkpoint(StorageEngineManager* manager) {
+    if (!manager) {
+        return false;
+    }
+
+    // 未启用日志时没有可恢复的状态，也没有需要截断的日志
+    WriteAheadLog* wal = manager->wal;
+    if (!wal) {
+        return true;
+    }
+
+    pthread_mutex_lock(&manager->checkpoint_lock);
+
+    // 检查点开始位置，恢复时从这里开始重做
+    uint64_t begin_lsn = wal_current_lsn(wal);
+
+    // 活跃事务表：在开始位置之后读取，之后开始的事务的记录都在开始位置之后
+    // 分析起点取活跃事务第一条记录和开始位置中较早的一个，保证能看到这些事务的提交记录
+    uint64_t transactions[3][2];
+    uint32_t transaction_count = 0;
+    uint64_t analysis_lsn = begin_lsn;
+    for (int i = 0; i < 3; i++) {
+        StorageEngine* engine = manager->engines[i];
+        if (!engine) {
+            continue;
+        }
+
+        // 两次读取事务ID相同，第一条记录位置才属于该事务
+        uint64_t transaction_id;
+        uint64_t first_lsn;
+        do {
+            transaction_id = __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST);
+            first_lsn = __atomic_load_n(&engine->transaction_first_lsn, __ATOMIC_SEQ_CST);
+        } while (transaction_id != __atomic_load_n(&engine->active_transaction, __ATOMIC_SEQ_CST));
+
+        if (transaction_id == 0) {
+            continue;
+        }
+        transactions[transaction_count][0] = transaction_id;
+        transactions[transaction_count][1] = first_lsn;
+        transaction_count++;
+        if (first_lsn < analysis_lsn) {
+            analysis_lsn = first_lsn;
+        }
+    }
+
+    char temp_path[1024];
+    char path[1024];
+    snprintf(temp_path, sizeof(temp_path), "%s/" STORAGE_CHECKPOINT_TEMP_FORMAT, wal->directory, (unsigned long long)begin_lsn);
+    snprintf(path, sizeof(path), "%s/" STORAGE_CHECKPOINT_FILE_FORMAT, wal->directory, (unsigned long long)begin_lsn);
+
+    StorageCheckpointWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.file = fopen(temp_path, "wb");
+    if (!writer.file) {
+        pthread_mutex_unlock(&manager->checkpoint_lock);
+        fprintf(stderr, "Failed to create checkpoint file: %s\n", temp_path);
+        return false;
+    }
+
+    pthread_rwlock_rdlock(&manager->lock);
+
+    // 表目录在读锁内不会变化，之前的建表删表记录已反映在检查点中
+    uint64_t catalog_lsn = wal_current_lsn(wal);
+    uint32_t magic = STORAGE_CHECKPOINT_MAGIC;
+    uint32_t table_count = (uint32_t)manager->table_count;
+
+    storage_codec_put(&writer.buffer, &magic, sizeof(magic));
+    storage_codec_put(&writer.buffer, &begin_lsn, sizeof(begin_lsn));
+    storage_codec_put(&writer.buffer, &catalog_lsn, sizeof(catalog_lsn));
+    storage_codec_put(&writer.buffer, &analysis_lsn, sizeof(analysis_lsn));
+    storage_codec_put_u32(&writer.buffer, transaction_count);
+    for (uint32_t i = 0; i < transaction_count; i++) {
+        storage_codec_put(&writer.buffer, transactions[i], sizeof(transactions[i]));
+    }
+    storage_codec_put_u32(&writer.buffer, table_count);
+
+    for (size_t i = 0; i < manager->table_count && !writer.failed; i++) {
+        Table* table = manager->tables[i];
+        StorageEngine* engine = manager->engines[table->storage_engine_type];
+
+        TableSnapshot snapshot;
+        memset(&snapshot, 0, sizeof(snapshot));
+        if (!engine->snapshot_table(engine, table->name, &snapshot)) {
+            writer.failed = true;
+        } else {
+            storage_checkpoint_write_table(&writer, table->name, table, &snapshot);
+            storage_checkpoint_drain(&writer);
+        }
+        table_snapshot_release(&snapshot);
+    }
+
+    pthread_rwlock_unlock(&manager->lock);
+
+    storage_checkpoint_drain(&writer);
+    if (!writer.failed && fwrite(&writer.checksum, 1, sizeof(writer.checksum), writer.file) != sizeof(writer.checksum)) {
+        writer.failed = true;
+    }
+    if (!writer.failed && (fflush(writer.file) != 0 || fsync(fileno(writer.file)) != 0)) {
+        writer.failed = true;
+    }
+    fclose(writer.file);
+    free(writer.buffer.data);
+
+    // 快照可能包含尚未持久化的修改，先持久化日志再使检查点生效
+    bool success = !writer.failed && wal_flush(wal, wal_current_lsn(wal)) &&
+                   rename(temp_path, path) == 0 && storage_engine_sync_directory(wal->directory);
+    if (!success) {
+        unlink(temp_path);
+        pthread_mutex_unlock(&manager->checkpoint_lock);
+        fprintf(stderr, "Failed to write checkpoint\n");
+        return false;
+    }
+
+    // 恢复只需要分析起点之后的日志和最新的检查点（共用日志的磁盘索引登记了保留点，截断不会越过索引的检查点）
+    wal_truncate(wal, analysis_lsn);
+    storage_engine_remove_checkpoints(wal->directory, begin_lsn);
+    manager->checkpoint_lsn = begin_lsn;
+
+    pthread_mutex_unlock(&manager->checkpoint_lock);
+
+    return true;
+}
+
+// 后台检查点线程：按配置的间隔执行检查点，限制崩溃后需要重做的日志量
+static void* storage_engine_checkpointer_main(void* arg) {
+    StorageEngineManager* manager = (StorageEngineManager*)arg;
+
+    pthread_mutex_lock(&manager->checkpointer_mutex);
+    while (manager->checkpointer_running) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += manager->checkpoint_interval;
+
+        int result = 0;
+        while (manager->checkpointer_running && result != ETIMEDOUT) {
+            result = pthread_cond_timedwait(&manager->checkpointer_cond, &manager->checkpointer_mutex, &deadline);
+        }
+        if (!manager->checkpointer_running) {
+            break;
+        }
+
+        pthread_mutex_unlock(&manager->checkpointer_mutex);
+        storage_engine_manager_checkpoint(manager);
+        pthread_mutex_lock(&manager->checkpointer_mutex);
+    }
+    pthread_mutex_unlock(&manager->checkpointer_mutex);
+
+    return NULL;
+}
+
+// 向表快照追加一行（接管行的引用，row为NULL表示该行ID是空位）
+bool table_snapshot_add(TableSnapshot* snapshot, uint64_t row_id, Row* row) {
+    if (snapshot->row_count >= snapshot->capacity) {
+        size_t new_capacity = snapshot->capacity ? snapshot->capacity * 2 : 1024;
+        Row** new_rows = (Row**)realloc(snapshot->rows, sizeof(Row*) * new_capacity);
+        if (new_rows) {
+            snapshot->rows = new_rows;
+        }
+        uint64_t* new_row_ids = new_rows ? (uint64_t*)realloc(snapshot->row_ids, sizeof(uint64_t) * new_capacity) : NULL;
+        if (!new_row_ids) {
+            destroy_row(row);
+            return false;
+        }
+        snapshot->row_ids = new_row_ids;
+        snapshot->capacity = new_capacity;
+    }
+
+    snapshot->rows[snapshot->row_count] = row;
+    snapshot->row_ids[snapshot->row_count] = row_id;
+    snapshot->row_count++;
+    return true;
+}
+
+// 释放表快照
+void table_snapshot_release(TableSnapshot* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+
+    for (size_t i = 0; i < snapshot->row_count; i++) {
+        destroy_row(snapshot->rows[i]);
+    }
+    free(snapshot->rows);
+    free(snapshot->row_ids);
+    free(snapshot->schema);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// 创建扫描游标
+ScanCursor* scan_cursor_create(struct StorageEngine* engine, void* table_data, size_t column_count, const ScanOptions* options) {
+    ScanCursor* cursor = (ScanCursor*)malloc(sizeof(ScanCursor));
+    if (!cursor) {
+        return NULL;
+    }
+    memset(cursor, 0, sizeof(ScanCursor));
+
+    if (options) {
+        cursor->options = *options;
+    }
+    if (cursor->options.batch_size == 0) {
+        cursor->options.batch_size = STORAGE_SCAN_BATCH_SIZE;
+    }
+
+    // 检查投影列
+    if (cursor->options.projection) {
+        for (size_t i = 0; i < cursor->options.projection_count; i++) {
+            if (cursor->options.projection[i] >= column_count) {
+                fprintf(stderr, "Invalid projection column\n");
+                free(cursor);
+                return NULL;
+            }
+        }
+        cursor->output_count = cursor->options.projection_count;
+    } else {
+        cursor->output_count = column_count;
+    }
+
+    cursor->engine = engine;
+    cursor->table_data = table_data;
+    cursor->column_count = column_count;
+
+    size_t batch_size = cursor->options.batch_size;
+    cursor->scratch_values = (void**)calloc(column_count > 0 ? column_count : 1, sizeof(void*));
+    cursor->rows = (Row*)calloc(batch_size, sizeof(Row));
+    cursor->row_ids = (uint64_t*)calloc(batch_size, sizeof(uint64_t));
+    cursor->batch_values = (void**)calloc(batch_size * (cursor->output_count > 0 ? cursor->output_count : 1), sizeof(void*));
+    cursor->pinned_rows = (Row**)calloc(batch_size, sizeof(Row*));
+    if (!cursor->scratch_values || !cursor->rows || !cursor->row_ids || !cursor->batch_values || !cursor->pinned_rows) {
+        scan_cursor_destroy(cursor);
+        return NULL;
+    }
+
+    // 输出行预先指向各自的值区间，扫描过程中不再分配内存
+    for (size_t i = 0; i < batch_size; i++) {
+        cursor->rows[i].values = cursor->batch_values + i * cursor->output_count;
+        cursor->rows[i].value_count = cursor->output_count;
+    }
+
+    cursor->scratch.value_count = column_count;
+
+    return cursor;
+}
+
+// 对一行求值谓词并按投影写入当前批次，返回该行是否被输出
+bool scan_cursor_emit(ScanCursor* cursor, void** values, uint64_t row_id, uint64_t version) {
+    if (!cursor || !values || scan_cursor_full(cursor)) {
+        return false;
+    }
+
+    if (cursor->options.predicate) {
+        cursor->scratch.values = values;
+        cursor->scratch.version = version;
+        cursor->scratch.deleted = false;
+        if (!cursor->options.predicate(&cursor->scratch, cursor->options.predicate_arg)) {
+            return false;
+        }
+    }
+
+    Row* row = &cursor->rows[cursor->row_count];
+    if (cursor->options.projection) {
+        for (size_t i = 0; i < cursor->output_count; i++) {
+            row->values[i] = values[cursor->options.projection[i]];
+        }
+    } else {
+        memcpy(row->values, values, sizeof(void*) * cursor->output_count);
+    }
+    row->deleted = false;
+    row->version = version;
+
+    cursor->row_ids[cursor->row_count] = row_id;
+    cursor->row_count++;
+
+    return true;
+}
+
+// 输出引擎中的一行，并固定该行直到下一批或游标关闭
+bool scan_cursor_emit_row(ScanCursor* cursor, Row* row, uint64_t row_id) {
+    if (!row || !scan_cursor_emit(cursor, row->values, row_id, row->version)) {
+        return false;
+    }
+
+    cursor->pinned_rows[cursor->pinned_count++] = retain_row(row);
+    return true;
+}
+
+// 释放上一批固定的行
+void scan_cursor_release_pins(ScanCursor* cursor) {
+    for (size_t i = 0; i < cursor->pinned_count; i++) {
+        destroy_row(cursor->pinned_rows[i]);
+    }
+    cursor->pinned_count = 0;
+}
+
+// 检查当前批次是否已满
+bool scan_cursor_full(ScanCursor* cursor) {
+    return cursor->row_count >= cursor->options.batch_size;
+}
+
+// 销毁扫描游标
+void scan_cursor_destroy(ScanCursor* cursor) {
+    if (!cursor) {
+        return;
+    }
+
+    if (cursor->scratch_values) {
+        free(cursor->scratch_values);
+    }
+    if (cursor->rows) {
+        free(cursor->rows);
+    }
+    if (cursor->row_ids) {
+        free(cursor->row_ids);
+    }
+    if (cursor->batch_values) {
+        free(cursor->batch_values);
+    }
+    if (cursor->pinned_rows) {
+        scan_cursor_release_pins(cursor);
+        free(cursor->pinned_rows);
+    }
+
+    free(cursor);
+}
+
 // 行存引擎实现
 #include "row_engine.h"
 
@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <pthread.h>
+#include "wal.h"
 
 // 前向声明
 struct config_system;
@@ -52,10 +54,61 @@ typedef struct {
     size_t value_count;
     bool deleted;
     uint64_t version;
+    uint32_t ref_count; // 引用计数（原子增减），归零时释放行
 } Row;
 
-// 存储引擎接口
+// 扫描默认批量大小
+#define STORAGE_SCAN_BATCH_SIZE 1024
+
+// 扫描谓词（返回true表示该行满足条件）
+typedef bool (*ScanPredicate)(const Row* row, void* arg);
+
+// 扫描选项
+typedef struct {
+    ScanPredicate predicate; // 下推谓词，NULL表示不过滤
+    void* predicate_arg;
+    const size_t* projection; // 投影列下标，NULL表示输出全部列
+    size_t projection_count;
+    size_t batch_size; // 每批最大行数，0表示使用默认值
+} ScanOptions;
+
+// 扫描游标
+// 每次scan_next输出的行只在下一次scan_next或scan_close之前有效，
+// 行中的值直接指向引擎内部数据，调用方不能修改或释放。
+// 引擎在批次之间不持有表锁，本批输出的行通过引用计数（或列存的视图计数）固定，
+// 并发的更新和删除不会释放仍在使用的值
+typedef struct {
+    struct StorageEngine* engine;
+    void* table_data; // 引擎表数据
+    ScanOptions options;
+    size_t column_count; // 表的列数
+    size_t output_count; // 输出列数
+    size_t position; // 引擎内部扫描位置（行下标或下一个行ID）
+    Row scratch; // 谓词求值使用的临时行
+    void** scratch_values; // 临时行的值数组（列存引擎按行收集列值）
+    Row* rows; // 当前批次输出行
+    uint64_t* row_ids; // 当前批次输出行ID
+    void** batch_values; // 当前批次的值数组（batch_size * output_count）
+    size_t row_count; // 当前批次行数
+    Row** pinned_rows; // 当前批次固定的引擎行（batch_size个）
+    size_t pinned_count;
+    bool table_pinned; // 列存引擎：当前批次是否持有表的视图计数
+    bool finished;
+} ScanCursor;
+
+// 表快照（检查点使用），行通过引用计数持有，使用后调用table_snapshot_release释放
 typedef struct {
+    void* schema; // 编码后的表结构（storage_engine_encode_table）
+    size_t schema_size;
+    uint64_t lsn; // 快照包含此LSN之前该表的全部修改，恢复时从这里开始重做
+    Row** rows;
+    uint64_t* row_ids;
+    size_t row_count;
+    size_t capacity;
+} TableSnapshot;
+
+// 存储引擎接口
+typedef struct StorageEngine {
     int type;
     char* name;
     
@@ -70,6 +123,15 @@ typedef struct {
     bool (*delete)(struct StorageEngine* engine, const char* table_name, uint64_t row_id);
     Row* (*select)(struct StorageEngine* engine, const char* table_name, uint64_t row_id);
     
+    // 只读视图查询（不复制行数据，使用后必须调用release_view释放）
+    const Row* (*select_view)(struct StorageEngine* engine, const char* table_name, uint64_t row_id);
+    void (*release_view)(struct StorageEngine* engine, const char* table_name, const Row* view);
+    
+    // 扫描操作
+    ScanCursor* (*scan_open)(struct StorageEngine* engine, const char* table_name, const ScanOptions* options);
+    size_t (*scan_next)(struct StorageEngine* engine, ScanCursor* cursor);
+    void (*scan_close)(struct StorageEngine* engine, ScanCursor* cursor);
+    
     // 批量操作
     bool (*batch_insert)(struct StorageEngine* engine, const char* table_name, Row** rows, size_t row_count);
     
@@ -82,9 +144,23 @@ typedef struct {
     bool (*optimize)(struct StorageEngine* engine, const char* table_name);
     bool (*checkpoint)(struct StorageEngine* engine);
     
+    // 恢复操作：按日志中的行ID重做插入（行已存在时替换），引擎接管传入的行
+    bool (*redo_insert)(struct StorageEngine* engine, const char* table_name, uint64_t row_id, Row* row);
+    
+    // 检查点操作：只在复制行引用期间阻塞该表的写操作，快照与日志中的LSN对应
+    bool (*snapshot_table)(struct StorageEngine* engine, const char* table_name, TableSnapshot* snapshot);
+    
     // 销毁引擎
     void (*destroy)(struct StorageEngine* engine);
     
+    // 预写日志，NULL表示不记录日志（恢复期间也为NULL）
+    WriteAheadLog* wal;
+    
+    // 当前事务的日志信息（回滚和检查点使用）
+    uint64_t active_transaction; // 日志中的事务ID，0表示没有进行中的事务
+    uint64_t transaction_first_lsn; // 事务开始时的日志位置，回滚时从这里查找事务的记录
+    uint64_t transaction_base; // 事务ID偏移，恢复后大于日志中出现过的事务ID
+    
     // 引擎特定数据
     void* data;
 } StorageEngine;
@@ -94,6 +170,17 @@ typedef struct {
     StorageEngine* engines[3]; // 三种存储引擎
     Table** tables;
     size_t table_count;
+    pthread_rwlock_t lock; // 保护表列表，数据操作只在查找引擎时持有读锁
+    WriteAheadLog* wal; // 预写日志，未启用时为NULL
+    
+    // 模糊检查点
+    pthread_mutex_t checkpoint_lock; // 同一时间只执行一个检查点
+    pthread_mutex_t checkpointer_mutex;
+    pthread_cond_t checkpointer_cond;
+    pthread_t checkpointer; // 后台检查点线程（启用日志且间隔大于0时运行）
+    bool checkpointer_running;
+    uint32_t checkpoint_interval; // 检查点间隔（秒）
+    uint64_t checkpoint_lsn; // 最近一次检查点的起始LSN
 } StorageEngineManager;
 
 // 初始化存储引擎管理器
@@ -126,6 +213,21 @@ bool storage_engine_delete(StorageEngineManager* manager, const char* table_name
 // 查询数据
 Row* storage_engine_select(StorageEngineManager* manager, const char* table_name, uint64_t row_id);
 
+// 查询数据的只读视图（不复制，调用方不拥有返回的行）
+const Row* storage_engine_select_view(StorageEngineManager* manager, const char* table_name, uint64_t row_id);
+
+// 释放只读视图
+void storage_engine_release_view(StorageEngineManager* manager, const char* table_name, const Row* view);
+
+// 打开扫描游标
+ScanCursor* storage_engine_scan_open(StorageEngineManager* manager, const char* table_name, const ScanOptions* options);
+
+// 读取下一批数据，返回本批行数，0表示扫描结束
+size_t storage_engine_scan_next(StorageEngineManager* manager, ScanCursor* cursor);
+
+// 关闭扫描游标
+void storage_engine_scan_close(StorageEngineManager* manager, ScanCursor* cursor);
+
 // 批量插入数据
 bool storage_engine_batch_insert(StorageEngineManager* manager, const char* table_name, Row** rows, size_t row_count);
 
@@ -144,6 +246,9 @@ bool storage_engine_optimize(StorageEngineManager* manager, const char* table_na
 // 执行检查点
 bool storage_engine_checkpoint(StorageEngineManager* manager, int engine_type);
 
+// 执行模糊检查点（写出所有表的快照和活跃事务表，之后截断不再需要的日志）
+bool storage_engine_manager_checkpoint(StorageEngineManager* manager);
+
 // 销毁存储引擎管理器
 void storage_engine_manager_destroy(StorageEngineManager* manager);
 
@@ -151,8 +256,34 @@ void storage_engine_manager_destroy(StorageEngineManager* manager);
 Column* create_column(const char* name, int data_type, size_t length, bool nullable, bool primary_key, bool auto_increment, void* default_value);
 Table* create_table(const char* name, Column* columns, size_t column_count, int storage_engine_type);
 Row* create_row(size_t column_count);
+Row* retain_row(Row* row);
+Row* copy_row(const Row* row, const Table* table);
 void destroy_row(Row* row);
+size_t storage_value_size(const Column* column, const void* value);
 void destroy_table(Table* table);
 void destroy_column(Column* column);
 
+// 预写日志辅助函数（引擎在持有表锁时调用，保证日志顺序与修改顺序一致）
+uint64_t storage_engine_transaction_id(StorageEngine* engine, bool in_transaction, uint64_t transaction_id);
+bool storage_engine_log_row(StorageEngine* engine, WalRecordType type, uint64_t transaction_id, const Table* table, uint64_t row_id, const Row* row, const Row* before);
+bool storage_engine_log_transaction(StorageEngine* engine, WalRecordType type, uint64_t transaction_id);
+void storage_engine_track_transaction(StorageEngine* engine, uint64_t transaction_id);
+bool storage_engine_undo_transaction(StorageEngine* engine, uint64_t transaction_id);
+void* storage_engine_encode_row(const Table* table, const Row* row, size_t* size);
+Row* storage_engine_decode_row(const Table* table, const uint8_t* data, size_t size);
+void* storage_engine_encode_table(const Table* table, size_t* size);
+Table* storage_engine_decode_table(const char* name, const uint8_t* data, size_t size);
+
+// 表快照辅助函数
+bool table_snapshot_add(TableSnapshot* snapshot, uint64_t row_id, Row* row);
+void table_snapshot_release(TableSnapshot* snapshot);
+
+// 扫描游标辅助函数
+ScanCursor* scan_cursor_create(struct StorageEngine* engine, void* table_data, size_t column_count, const ScanOptions* options);
+bool scan_cursor_emit(ScanCursor* cursor, void** values, uint64_t row_id, uint64_t version);
+bool scan_cursor_emit_row(ScanCursor* cursor, Row* row, uint64_t row_id);
+void scan_cursor_release_pins(ScanCursor* cursor);
+bool scan_cursor_full(ScanCursor* cursor);
+void scan_cursor_destroy(ScanCursor* cursor);
+
 #endif // STORAGE_ENGINE_H
\ No newline at end of file
@@ -0,0 +1,832 @@
+#include "wal.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+// 缓冲区最小容量
+#define WAL_MIN_BUFFER_SIZE (64 * 1024)
+
+// 刷盘线程空闲时的周期（毫秒），保证缓冲区在没有提交时也会被清空
+#define WAL_FLUSH_INTERVAL_MS 10
+
+// 日志读取器（恢复时顺序读取段文件）
+typedef struct {
+    WriteAheadLog* wal;
+    int fd;
+    uint64_t segment_number;
+} WalReader;
+
+// CRC32C查找表
+static uint32_t wal_crc_table[256];
+static pthread_once_t wal_crc_once = PTHREAD_ONCE_INIT;
+
+static void wal_crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        }
+        wal_crc_table[i] = crc;
+    }
+}
+
+// 校验和（CRC32C，可分段累加）
+uint32_t wal_checksum(uint32_t seed, const void* data, size_t size) {
+    pthread_once(&wal_crc_once, wal_crc_init);
+
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t crc = ~seed;
+    for (size_t i = 0; i < size; i++) {
+        crc = wal_crc_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// 计算记录的校验和（头部length和checksum之后的部分、表名和数据）
+static uint32_t wal_record_checksum(const WalRecordHeader* header, const void* table_name, const void* data) {
+    size_t skip = offsetof(WalRecordHeader, lsn);
+    uint32_t checksum = wal_checksum(0, (const uint8_t*)header + skip, sizeof(WalRecordHeader) - skip);
+    checksum = wal_checksum(checksum, table_name, header->table_name_length);
+    return wal_checksum(checksum, data, header->data_length);
+}
+
+// 记录对齐后的总长度
+static size_t wal_record_size(size_t table_name_length, size_t data_length) {
+    size_t size = sizeof(WalRecordHeader) + table_name_length + data_length;
+    return (size + WAL_ALIGNMENT - 1) & ~(size_t)(WAL_ALIGNMENT - 1);
+}
+
+// 确保目录存在（逐级创建）
+static bool wal_ensure_directory(const char* directory) {
+    char* path = strdup(directory);
+    if (!path) {
+        return false;
+    }
+
+    for (char* p = path + 1; ; p++) {
+        if (*p != '/' && *p != '\0') {
+            continue;
+        }
+
+        char saved = *p;
+        *p = '\0';
+        if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+            fprintf(stderr, "Failed to create WAL directory: %s\n", path);
+            free(path);
+            return false;
+        }
+        *p = saved;
+
+        if (saved == '\0') {
+            break;
+        }
+    }
+
+    free(path);
+    return true;
+}
+
+// 生成段文件路径
+static void wal_segment_path(WriteAheadLog* wal, uint64_t segment_number, char* path, size_t size) {
+    char name[64];
+    snprintf(name, sizeof(name), WAL_SEGMENT_FILE_FORMAT, (unsigned long long)segment_number);
+    snprintf(path, size, "%s/%s", wal->directory, name);
+}
+
+// 切换当前写入的段文件（切换前先把旧段刷盘）
+static bool wal_switch_segment(WriteAheadLog* wal, uint64_t segment_number) {
+    if (wal->segment_fd >= 0 && wal->segment_number == segment_number) {
+        return true;
+    }
+
+    if (wal->segment_fd >= 0) {
+        bool synced = fsync(wal->segment_fd) == 0;
+        close(wal->segment_fd);
+        wal->segment_fd = -1;
+        if (!synced) {
+            fprintf(stderr, "Failed to sync WAL segment\n");
+            return false;
+        }
+    }
+
+    char path[1024];
+    wal_segment_path(wal, segment_number, path, sizeof(path));
+    wal->segment_fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (wal->segment_fd < 0) {
+        fprintf(stderr, "Failed to open WAL segment: %s\n", path);
+        return false;
+    }
+    wal->segment_number = segment_number;
+
+    return true;
+}
+
+// 把缓冲区中[start, end)的日志写入段文件并刷盘
+static bool wal_write_range(WriteAheadLog* wal, uint64_t start, uint64_t end) {
+    uint64_t lsn = start;
+    while (lsn < end) {
+        uint64_t segment_offset = lsn % wal->segment_size;
+        size_t buffer_offset = (size_t)(lsn & (wal->capacity - 1));
+
+        // 每次写入不跨越缓冲区回绕点和段边界
+        uint64_t chunk = end - lsn;
+        if (chunk > wal->capacity - buffer_offset) {
+            chunk = wal->capacity - buffer_offset;
+        }
+        if (chunk > wal->segment_size - segment_offset) {
+            chunk = wal->segment_size - segment_offset;
+        }
+
+        if (!wal_switch_segment(wal, lsn / wal->segment_size)) {
+            return false;
+        }
+
+        ssize_t written = pwrite(wal->segment_fd, wal->buffer + buffer_offset, (size_t)chunk, (off_t)segment_offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed to write WAL segment\n");
+            return false;
+        }
+        lsn += (uint64_t)written;
+    }
+
+    if (wal->segment_fd >= 0 && fdatasync(wal->segment_fd) != 0) {
+        fprintf(stderr, "Failed to sync WAL segment\n");
+        return false;
+    }
+
+    return true;
+}
+
+// 从flushed_lsn开始查找连续就绪记录的末尾
+static uint64_t wal_ready_lsn(WriteAheadLog* wal) {
+    uint64_t lsn = wal->flushed_lsn;
+    uint64_t reserved = __atomic_load_n(&wal->reserved_lsn, __ATOMIC_ACQUIRE);
+
+    // 只检查一个缓冲区容量之内的位置，更远的位置与尚未写盘的记录重叠
+    while (lsn < reserved && lsn - wal->flushed_lsn < wal->capacity) {
+        uint32_t* length = (uint32_t*)(wal->buffer + (lsn & (wal->capacity - 1)));
+        uint32_t record_length = __atomic_load_n(length, __ATOMIC_ACQUIRE);
+        if (record_length == 0) {
+            break;
+        }
+        lsn += record_length;
+    }
+
+    return lsn;
+}
+
+// 把就绪的记录写盘，调用方持有mutex（写盘期间临时释放）
+static void wal_flush_ready(WriteAheadLog* wal) {
+    uint64_t start = wal->flushed_lsn;
+    uint64_t end = wal_ready_lsn(wal);
+    if (end == start) {
+        return;
+    }
+
+    // 写盘期间不持有锁，写入者可以继续追加、提交者可以继续排队
+    pthread_mutex_unlock(&wal->mutex);
+    bool success = wal_write_range(wal, start, end);
+    pthread_mutex_lock(&wal->mutex);
+
+    // 写盘失败后已写出的部分是否持久化无法确定，不再推进flushed_lsn，唤醒全部等待者返回失败
+    if (!success) {
+        __atomic_store_n(&wal->failed, true, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&wal->flushed_cond);
+        return;
+    }
+
+    // 清零已写盘的区域，使长度字段可以重新作为就绪标记
+    uint64_t lsn = start;
+    while (lsn < end) {
+        size_t offset = (size_t)(lsn & (wal->capacity - 1));
+        size_t chunk = wal->capacity - offset;
+        if (chunk > end - lsn) {
+            chunk = (size_t)(end - lsn);
+        }
+        memset(wal->buffer + offset, 0, chunk);
+        lsn += chunk;
+    }
+
+    wal->stats.syncs++;
+    __atomic_store_n(&wal->flushed_lsn, end, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&wal->flushed_cond);
+}
+
+// 刷盘线程
+static void* wal_flusher_main(void* arg) {
+    WriteAheadLog* wal = (WriteAheadLog*)arg;
+
+    pthread_mutex_lock(&wal->mutex);
+    while (wal->running) {
+        if (wal->failed) {
+            pthread_cond_wait(&wal->flush_cond, &wal->mutex);
+            continue;
+        }
+        if (wal->requested_lsn <= wal->flushed_lsn) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += WAL_FLUSH_INTERVAL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&wal->flush_cond, &wal->mutex, &deadline);
+        } else if (wal->commit_delay_us > 0) {
+            // 组提交：等待一小段时间，让更多并发提交进入同一次fsync
+            pthread_mutex_unlock(&wal->mutex);
+            struct timespec delay = {0, (long)wal->commit_delay_us * 1000L};
+            nanosleep(&delay, NULL);
+            pthread_mutex_lock(&wal->mutex);
+        }
+
+        uint64_t flushed = wal->flushed_lsn;
+        wal_flush_ready(wal);
+
+        // 请求的记录还在复制中，稍后重试
+        if (!wal->failed && wal->flushed_lsn == flushed && wal->requested_lsn > flushed) {
+            pthread_mutex_unlock(&wal->mutex);
+            sched_yield();
+            pthread_mutex_lock(&wal->mutex);
+        }
+    }
+
+    // 退出前写盘全部记录
+    if (!wal->failed) {
+        wal_flush_ready(wal);
+    }
+    pthread_mutex_unlock(&wal->mutex);
+
+    return NULL;
+}
+
+// 打开段文件读取
+static bool wal_reader_read(WalReader* reader, uint64_t lsn, void* data, size_t size) {
+    WriteAheadLog* wal = reader->wal;
+    uint8_t* bytes = (uint8_t*)data;
+
+    while (size > 0) {
+        uint64_t segment_number = lsn / wal->segment_size;
+        uint64_t segment_offset = lsn % wal->segment_size;
+
+        if (reader->fd < 0 || reader->segment_number != segment_number) {
+            if (reader->fd >= 0) {
+                close(reader->fd);
+            }
+            char path[1024];
+            wal_segment_path(wal, segment_number, path, sizeof(path));
+            reader->fd = open(path, O_RDONLY);
+            reader->segment_number = segment_number;
+            if (reader->fd < 0) {
+                return false;
+            }
+        }
+
+        size_t chunk = size;
+        if (chunk > wal->segment_size - segment_offset) {
+            chunk = (size_t)(wal->segment_size - segment_offset);
+        }
+
+        ssize_t read_size = pread(reader->fd, bytes, chunk, (off_t)segment_offset);
+        if (read_size <= 0) {
+            return false;
+        }
+
+        bytes += read_size;
+        lsn += (uint64_t)read_size;
+        size -= (size_t)read_size;
+    }
+
+    return true;
+}
+
+// 从start_lsn开始遍历完整且校验通过的记录，返回日志的有效末尾
+static uint64_t wal_scan(WriteAheadLog* wal, uint64_t start_lsn, WalReplayCallback callback, void* arg) {
+    WalReader reader = {wal, -1, 0};
+    uint8_t* buffer = NULL;
+    size_t buffer_size = 0;
+    uint64_t lsn = start_lsn;
+
+    while (true) {
+        WalRecordHeader header;
+        if (!wal_reader_read(&reader, lsn, &header, sizeof(header))) {
+            break;
+        }
+
+        // 长度为零、格式错误或LSN不匹配表示到达日志末尾（或残留的旧数据）
+        if (header.length < sizeof(WalRecordHeader) || header.length % WAL_ALIGNMENT != 0 || header.lsn != lsn ||
+            wal_record_size(header.table_name_length, header.data_length) != header.length) {
+            break;
+        }
+
+        size_t payload_size = header.length - sizeof(WalRecordHeader);
+        if (payload_size > buffer_size) {
+            uint8_t* new_buffer = (uint8_t*)realloc(buffer, payload_size);
+            if (!new_buffer) {
+                break;
+            }
+            buffer = new_buffer;
+            buffer_size = payload_size;
+        }
+        if (payload_size > 0 && !wal_reader_read(&reader, lsn + sizeof(header), buffer, payload_size)) {
+            break;
+        }
+
+        // 校验失败表示记录写了一半（崩溃时的残缺记录）
+        if (wal_record_checksum(&header, buffer, buffer + header.table_name_length) != header.checksum) {
+            break;
+        }
+
+        if (callback) {
+            WalRecord record;
+            record.lsn = lsn;
+            record.end_lsn = lsn + header.length;
+            record.transaction_id = header.transaction_id;
+            record.row_id = header.row_id;
+            record.undo_lsn = header.undo_lsn;
+            record.type = (WalRecordType)header.type;
+            record.flags = header.flags;
+            record.table_name = (const char*)buffer;
+            record.table_name_length = header.table_name_length;
+            record.data = buffer + header.table_name_length;
+            record.data_length = header.data_length;
+            if (!callback(&record, arg)) {
+                lsn += header.length;
+                break;
+            }
+        }
+
+        lsn += header.length;
+    }
+
+    if (reader.fd >= 0) {
+        close(reader.fd);
+    }
+    free(buffer);
+
+    return lsn;
+}
+
+// 找到第一条记录后停止遍历
+static bool wal_stop_at_first(const WalRecord* record, void* arg) {
+    *(uint64_t*)arg = record->lsn;
+    return false;
+}
+
+// 查找段内第一条完整记录的位置（截断后保留的第一个段开头可能是跨段记录的后半部分）
+// 记录头部包含自身的LSN，按对齐位置逐个检查，再用校验和确认
+static uint64_t wal_find_first_record(WriteAheadLog* wal, uint64_t segment_lsn) {
+    WalReader reader = {wal, -1, 0};
+    uint64_t found = segment_lsn;
+
+    for (uint64_t lsn = segment_lsn; lsn < segment_lsn + wal->segment_size; lsn += WAL_ALIGNMENT) {
+        WalRecordHeader header;
+        if (!wal_reader_read(&reader, lsn, &header, sizeof(header))) {
+            break;
+        }
+
+        uint64_t first = UINT64_MAX;
+        if (header.lsn == lsn && header.length >= sizeof(WalRecordHeader) &&
+            wal_scan(wal, lsn, wal_stop_at_first, &first) > lsn && first == lsn) {
+            found = lsn;
+            break;
+        }
+    }
+
+    if (reader.fd >= 0) {
+        close(reader.fd);
+    }
+    return found;
+}
+
+// 查找已有段文件的段号范围
+static bool wal_find_segments(WriteAheadLog* wal, uint64_t* first, uint64_t* last) {
+    DIR* dir = opendir(wal->directory);
+    if (!dir) {
+        return false;
+    }
+
+    bool found = false;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long long number;
+        char suffix[8];
+        if (sscanf(entry->d_name, "wal_%16llx.%3s", &number, suffix) != 2 || strcmp(suffix, "log") != 0) {
+            continue;
+        }
+
+        if (!found || number < *first) {
+            *first = number;
+        }
+        if (!found || number > *last) {
+            *last = number;
+        }
+        found = true;
+    }
+
+    closedir(dir);
+    return found;
+}
+
+// 截断有效末尾之后的残留数据，避免之后追加的记录与旧数据混在一起
+static void wal_truncate_tail(WriteAheadLog* wal, uint64_t end_lsn, uint64_t last_segment) {
+    char path[1024];
+    uint64_t end_segment = end_lsn / wal->segment_size;
+
+    wal_segment_path(wal, end_segment, path, sizeof(path));
+    if (truncate(path, (off_t)(end_lsn % wal->segment_size)) != 0 && errno != ENOENT) {
+        fprintf(stderr, "Failed to truncate WAL segment: %s\n", path);
+    }
+
+    for (uint64_t segment = end_segment + 1; segment <= last_segment; segment++) {
+        wal_segment_path(wal, segment, path, sizeof(path));
+        unlink(path);
+    }
+}
+
+// 打开WAL
+WriteAheadLog* wal_open(const WalConfig* config) {
+    if (!config || !config->directory || config->segment_size == 0) {
+        return NULL;
+    }
+
+    if (!wal_ensure_directory(config->directory)) {
+        return NULL;
+    }
+
+    WriteAheadLog* wal = (WriteAheadLog*)malloc(sizeof(WriteAheadLog));
+    if (!wal) {
+        return NULL;
+    }
+    memset(wal, 0, sizeof(WriteAheadLog));
+
+    // 缓冲区容量取2的幂，便于用掩码定位
+    size_t capacity = WAL_MIN_BUFFER_SIZE;
+    while (capacity < config->buffer_size) {
+        capacity <<= 1;
+    }
+
+    wal->directory = strdup(config->directory);
+    wal->buffer = (uint8_t*)calloc(1, capacity);
+    if (!wal->directory || !wal->buffer) {
+        free(wal->directory);
+        free(wal->buffer);
+        free(wal);
+        return NULL;
+    }
+    wal->capacity = capacity;
+    wal->segment_size = (config->segment_size + WAL_ALIGNMENT - 1) & ~(uint64_t)(WAL_ALIGNMENT - 1);
+    wal->commit_delay_us = config->commit_delay_us;
+    wal->segment_fd = -1;
+
+    // 定位已有日志的有效末尾，新记录从这里继续追加
+    uint64_t first_segment = 0;
+    uint64_t last_segment = 0;
+    if (wal_find_segments(wal, &first_segment, &last_segment)) {
+        wal->start_lsn = first_segment * wal->segment_size;
+        if (first_segment > 0) {
+            wal->start_lsn = wal_find_first_record(wal, wal->start_lsn);
+        }
+        uint64_t end_lsn = wal_scan(wal, wal->start_lsn, NULL, NULL);
+        wal_truncate_tail(wal, end_lsn, last_segment);
+        wal->reserved_lsn = end_lsn;
+        wal->flushed_lsn = end_lsn;
+        wal->requested_lsn = end_lsn;
+    }
+
+    pthread_mutex_init(&wal->mutex, NULL);
+    pthread_cond_init(&wal->flush_cond, NULL);
+    pthread_cond_init(&wal->flushed_cond, NULL);
+
+    wal->running = true;
+    if (pthread_create(&wal->flusher, NULL, wal_flusher_main, wal) != 0) {
+        fprintf(stderr, "Failed to start WAL flusher\n");
+        pthread_mutex_destroy(&wal->mutex);
+        pthread_cond_destroy(&wal->flush_cond);
+        pthread_cond_destroy(&wal->flushed_cond);
+        free(wal->directory);
+        free(wal->buffer);
+        free(wal);
+        return NULL;
+    }
+
+    return wal;
+}
+
+// 关闭WAL
+void wal_close(WriteAheadLog* wal) {
+    if (!wal) {
+        return;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    wal->running = false;
+    pthread_cond_signal(&wal->flush_cond);
+    pthread_mutex_unlock(&wal->mutex);
+    pthread_join(wal->flusher, NULL);
+
+    if (wal->segment_fd >= 0) {
+        if (fsync(wal->segment_fd) != 0) {
+            fprintf(stderr, "Failed to sync WAL segment\n");
+        }
+        close(wal->segment_fd);
+    }
+
+    pthread_mutex_destroy(&wal->mutex);
+    pthread_cond_destroy(&wal->flush_cond);
+    pthread_cond_destroy(&wal->flushed_cond);
+    free(wal->directory);
+    free(wal->buffer);
+    free(wal);
+}
+
+// 向环形缓冲区写入数据（处理回绕）
+static void wal_buffer_write(WriteAheadLog* wal, uint64_t lsn, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (size > 0) {
+        size_t offset = (size_t)(lsn & (wal->capacity - 1));
+        size_t chunk = wal->capacity - offset;
+        if (chunk > size) {
+            chunk = size;
+        }
+        memcpy(wal->buffer + offset, bytes, chunk);
+        bytes += chunk;
+        lsn += chunk;
+        size -= chunk;
+    }
+}
+
+// 等待缓冲区腾出[lsn, end)所需的空间，写盘失败时返回false
+static bool wal_wait_for_space(WriteAheadLog* wal, uint64_t end) {
+    if (end - __atomic_load_n(&wal->flushed_lsn, __ATOMIC_ACQUIRE) <= wal->capacity) {
+        return true;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    wal->stats.buffer_waits++;
+    while (end - wal->flushed_lsn > wal->capacity && !wal->failed) {
+        if (wal->requested_lsn < end - wal->capacity) {
+            wal->requested_lsn = end - wal->capacity;
+        }
+        pthread_cond_signal(&wal->flush_cond);
+        pthread_cond_wait(&wal->flushed_cond, &wal->mutex);
+    }
+    bool available = !wal->failed;
+    pthread_mutex_unlock(&wal->mutex);
+    return available;
+}
+
+// 追加记录
+uint64_t wal_append(WriteAheadLog* wal, WalRecordType type, uint64_t transaction_id, const char* table_name, uint64_t row_id, const void* data, size_t data_length) {
+    WalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.transaction_id = transaction_id;
+    record.table_name = table_name;
+    record.table_name_length = table_name ? strlen(table_name) : 0;
+    record.row_id = row_id;
+    record.data = (const uint8_t*)data;
+    record.data_length = data_length;
+
+    return wal_append_record(wal, &record);
+}
+
+// 追加记录（通用形式）
+uint64_t wal_append_record(WriteAheadLog* wal, const WalRecord* record) {
+    if (!wal || !record) {
+        return 0;
+    }
+
+    const char* table_name = record->table_name;
+    const void* data = record->data;
+    size_t table_name_length = table_name ? record->table_name_length : 0;
+    size_t data_length = data ? record->data_length : 0;
+    size_t length = wal_record_size(table_name_length, data_length);
+    if (length > wal->capacity || length > UINT32_MAX) {
+        fprintf(stderr, "WAL record too large\n");
+        return 0;
+    }
+    if (__atomic_load_n(&wal->failed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    // 原子预留日志空间，并发写入者各自复制记录，互不等待
+    // （写盘失败时预留的空间不再写入：缓冲区中对应位置的记录还没有写盘）
+    uint64_t lsn = __sync_fetch_and_add(&wal->reserved_lsn, (uint64_t)length);
+    if (!wal_wait_for_space(wal, lsn + length)) {
+        return 0;
+    }
+
+    WalRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.lsn = lsn;
+    header.transaction_id = record->transaction_id;
+    header.row_id = record->row_id;
+    header.undo_lsn = record->undo_lsn;
+    header.type = (uint32_t)record->type;
+    header.flags = record->flags;
+    header.table_name_length = (uint32_t)table_name_length;
+    header.data_length = (uint32_t)data_length;
+    header.checksum = wal_record_checksum(&header, table_name, data);
+
+    // 先写长度字段之后的内容，填充字节在缓冲区清零时已经为零
+    size_t skip = offsetof(WalRecordHeader, checksum);
+    wal_buffer_write(wal, lsn + skip, (const uint8_t*)&header + skip, sizeof(header) - skip);
+    if (table_name_length > 0) {
+        wal_buffer_write(wal, lsn + sizeof(header), table_name, table_name_length);
+    }
+    if (data_length > 0) {
+        wal_buffer_write(wal, lsn + sizeof(header) + table_name_length, data, data_length);
+    }
+
+    // 最后发布长度字段，刷盘线程看到非零长度才会写出该记录
+    uint32_t* length_field = (uint32_t*)(wal->buffer + (lsn & (wal->capacity - 1)));
+    __atomic_store_n(length_field, (uint32_t)length, __ATOMIC_RELEASE);
+
+    __sync_fetch_and_add(&wal->stats.records, 1);
+    __sync_fetch_and_add(&wal->stats.bytes, (uint64_t)length);
+
+    return lsn + length;
+}
+
+// 等待日志持久化到指定LSN
+bool wal_flush(WriteAheadLog* wal, uint64_t lsn) {
+    if (!wal) {
+        return false;
+    }
+
+    if (__atomic_load_n(&wal->flushed_lsn, __ATOMIC_ACQUIRE) >= lsn) {
+        return true;
+    }
+
+    // 多个提交者同时等待时由刷盘线程一次fsync全部满足
+    pthread_mutex_lock(&wal->mutex);
+    wal->stats.commit_waits++;
+    if (wal->requested_lsn < lsn) {
+        wal->requested_lsn = lsn;
+        pthread_cond_signal(&wal->flush_cond);
+    }
+    while (wal->flushed_lsn < lsn && wal->running && !wal->failed) {
+        pthread_cond_wait(&wal->flushed_cond, &wal->mutex);
+    }
+    bool flushed = wal->flushed_lsn >= lsn;
+    pthread_mutex_unlock(&wal->mutex);
+
+    return flushed;
+}
+
+// 追加提交记录并等待持久化
+bool wal_commit(WriteAheadLog* wal, uint64_t transaction_id) {
+    uint64_t lsn = wal_append(wal, WAL_RECORD_COMMIT, transaction_id, NULL, 0, NULL, 0);
+    if (lsn == 0) {
+        return false;
+    }
+
+    return wal_flush(wal, lsn);
+}
+
+// 当前已预留的日志末尾
+uint64_t wal_current_lsn(WriteAheadLog* wal) {
+    return wal ? __atomic_load_n(&wal->reserved_lsn, __ATOMIC_ACQUIRE) : 0;
+}
+
+// 当前已持久化的日志末尾
+uint64_t wal_flushed_lsn(WriteAheadLog* wal) {
+    return wal ? __atomic_load_n(&wal->flushed_lsn, __ATOMIC_ACQUIRE) : 0;
+}
+
+// 获取统计信息
+void wal_get_stats(WriteAheadLog* wal, WalStats* stats) {
+    if (!wal || !stats) {
+        return;
+    }
+
+    stats->records = __atomic_load_n(&wal->stats.records, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&wal->stats.bytes, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&wal->mutex);
+    stats->syncs = wal->stats.syncs;
+    stats->commit_waits = wal->stats.commit_waits;
+    stats->buffer_waits = wal->stats.buffer_waits;
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+// 遍历日志记录
+bool wal_replay(WriteAheadLog* wal, uint64_t start_lsn, WalReplayCallback callback, void* arg) {
+    if (!wal || !callback) {
+        return false;
+    }
+
+    uint64_t first_lsn = wal_start_lsn(wal);
+    if (start_lsn < first_lsn) {
+        start_lsn = first_lsn;
+    }
+
+    // 只遍历已持久化的部分
+    wal_flush(wal, wal_current_lsn(wal));
+    wal_scan(wal, start_lsn, callback, arg);
+
+    return true;
+}
+
+// 删除完全位于指定LSN之前的段文件
+void wal_truncate(WriteAheadLog* wal, uint64_t lsn) {
+    if (!wal) {
+        return;
+    }
+
+    // 只能截断已持久化的部分
+    uint64_t flushed = wal_flushed_lsn(wal);
+    if (lsn > flushed) {
+        lsn = flushed;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    // 其他模块恢复时仍需要保留点之后的日志
+    for (WalRetainer* retainer = wal->retainers; retainer; retainer = retainer->next) {
+        if (retainer->lsn < lsn) {
+            lsn = retainer->lsn;
+        }
+    }
+    uint64_t first_segment = wal->start_lsn / wal->segment_size;
+    uint64_t end_segment = lsn / wal->segment_size;
+
+    // 至少保留包含日志末尾的段，重新打开时才能定位到原来的LSN
+    if (lsn > 0 && lsn % wal->segment_size == 0) {
+        end_segment--;
+    }
+
+    for (uint64_t segment = first_segment; segment < end_segment; segment++) {
+        char path[1024];
+        wal_segment_path(wal, segment, path, sizeof(path));
+        unlink(path);
+    }
+    // 保留的第一个段开头可能是跨段记录的后半部分，起点取截断位置（一定是记录边界）
+    if (end_segment > first_segment && lsn > wal->start_lsn) {
+        wal->start_lsn = lsn;
+    }
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+// 登记保留点
+void wal_add_retainer(WriteAheadLog* wal, WalRetainer* retainer, uint64_t lsn) {
+    if (!wal || !retainer) {
+        return;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    retainer->lsn = lsn;
+    retainer->next = wal->retainers;
+    wal->retainers = retainer;
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+// 推进保留点
+void wal_set_retainer(WriteAheadLog* wal, WalRetainer* retainer, uint64_t lsn) {
+    if (!wal || !retainer) {
+        return;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    retainer->lsn = lsn;
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+// 取消登记保留点
+void wal_remove_retainer(WriteAheadLog* wal, WalRetainer* retainer) {
+    if (!wal || !retainer) {
+        return;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    WalRetainer** link = &wal->retainers;
+    while (*link && *link != retainer) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = retainer->next;
+    }
+    pthread_mutex_unlock(&wal->mutex);
+}
+
+// 最早仍保留的LSN
+uint64_t wal_start_lsn(WriteAheadLog* wal) {
+    if (!wal) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&wal->mutex);
+    uint64_t lsn = wal->start_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+
+    return lsn;
+}
@@ -0,0 +1,172 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// 预写日志（WAL）
+// LSN是记录在日志字节流中的起始偏移，日志按固定大小切分为多个段文件。
+// 写入者通过原子递增预留日志缓冲区空间并各自复制记录，无需加锁；
+// 记录的长度字段最后写入，作为记录就绪的标记。
+// 刷盘线程按LSN顺序把连续就绪的记录写入段文件，一次fsync提交一组事务（组提交）。
+
+// 记录按8字节对齐
+#define WAL_ALIGNMENT 8
+
+// 段文件名格式（段号为十六进制）
+#define WAL_SEGMENT_FILE_FORMAT "wal_%016llx.log"
+
+// 记录类型
+typedef enum {
+    WAL_RECORD_CREATE_TABLE = 1, // 建表（数据为表结构）
+    WAL_RECORD_DROP_TABLE,       // 删表
+    WAL_RECORD_INSERT,           // 插入（数据为新行）
+    WAL_RECORD_UPDATE,           // 更新（数据为新行和撤销用的旧行）
+    WAL_RECORD_DELETE,           // 删除（数据为撤销用的旧行）
+    WAL_RECORD_COMMIT,           // 事务提交
+    WAL_RECORD_ABORT,            // 事务回滚
+    WAL_RECORD_OPTIMIZE,         // 表压缩（会改变行ID，回放时需要按相同顺序重做）
+    WAL_RECORD_INDEX_PAGE        // 磁盘索引的页面修改（表名字段为索引名，只重做）
+} WalRecordType;
+
+// 记录标志
+#define WAL_RECORD_FLAG_COMPENSATION 0x1 // 补偿记录（撤销其他记录时写入，只重做不撤销）
+
+// 记录头部（磁盘格式与缓冲区格式相同）
+// 头部之后依次是表名、记录数据和对齐填充
+typedef struct {
+    uint32_t length; // 记录总长度（含头部和填充），最后写入，非零表示记录就绪
+    uint32_t checksum; // 除length和checksum外全部内容的校验和
+    uint64_t lsn; // 记录起始LSN
+    uint64_t transaction_id; // 事务ID，0表示自动提交
+    uint64_t row_id;
+    uint64_t undo_lsn; // 补偿记录撤销的原记录LSN
+    uint32_t type; // WalRecordType
+    uint32_t table_name_length;
+    uint32_t data_length;
+    uint32_t flags; // WAL_RECORD_FLAG_*
+} WalRecordHeader;
+
+// 解析后的日志记录（指针指向读取缓冲区，只在回调期间有效）
+typedef struct {
+    uint64_t lsn;
+    uint64_t end_lsn; // 下一条记录的LSN
+    uint64_t transaction_id;
+    uint64_t row_id;
+    uint64_t undo_lsn;
+    WalRecordType type;
+    uint32_t flags;
+    const char* table_name;
+    size_t table_name_length;
+    const uint8_t* data;
+    size_t data_length;
+} WalRecord;
+
+// WAL配置
+typedef struct {
+    const char* directory; // 段文件目录
+    size_t buffer_size; // 日志缓冲区大小（字节，向上取整为2的幂）
+    uint64_t segment_size; // 段文件大小（字节）
+    uint32_t commit_delay_us; // 组提交等待时间（微秒），0表示不等待
+} WalConfig;
+
+// WAL统计
+typedef struct {
+    uint64_t records; // 追加的记录数
+    uint64_t bytes; // 追加的字节数
+    uint64_t syncs; // fsync次数
+    uint64_t commit_waits; // 等待持久化的次数
+    uint64_t buffer_waits; // 缓冲区满导致的等待次数
+} WalStats;
+
+// 日志保留点：其他模块（如磁盘索引的页文件）在恢复时从登记的LSN开始重做日志，
+// 截断日志时不会越过任何保留点。结构由登记者持有，登记期间不能释放
+typedef struct WalRetainer {
+    uint64_t lsn; // 恢复需要的最早LSN
+    struct WalRetainer* next;
+} WalRetainer;
+
+// 预写日志
+typedef struct WriteAheadLog {
+    char* directory;
+    uint64_t segment_size;
+    uint32_t commit_delay_us;
+
+    // 日志缓冲区（环形），按LSN对容量取模定位
+    uint8_t* buffer;
+    size_t capacity;
+
+    uint64_t start_lsn; // 最早仍保留在段文件中的LSN
+    uint64_t reserved_lsn; // 已预留的日志末尾（原子递增）
+    uint64_t flushed_lsn; // 已持久化的日志末尾
+    uint64_t requested_lsn; // 等待持久化的最大LSN
+
+    // 当前写入的段文件
+    int segment_fd;
+    uint64_t segment_number;
+
+    pthread_mutex_t mutex; // 保护刷盘状态和条件变量
+    pthread_cond_t flush_cond; // 唤醒刷盘线程
+    pthread_cond_t flushed_cond; // 通知等待持久化的线程和等待缓冲区空间的写入者
+    pthread_t flusher;
+    bool running;
+    bool failed; // 写盘或fsync失败（之后不再接受追加，等待持久化的调用返回false）
+    WalRetainer* retainers; // 登记的保留点（由mutex保护）
+
+    WalStats stats;
+} WriteAheadLog;
+
+// 记录回放回调，返回false终止遍历
+typedef bool (*WalReplayCallback)(const WalRecord* record, void* arg);
+
+// 打开WAL（定位已有日志的末尾并启动刷盘线程）
+WriteAheadLog* wal_open(const WalConfig* config);
+
+// 关闭WAL（刷盘全部记录后停止刷盘线程）
+void wal_close(WriteAheadLog* wal);
+
+// 追加记录，返回记录结束LSN（等待持久化时使用），失败返回0
+uint64_t wal_append(WriteAheadLog* wal, WalRecordType type, uint64_t transaction_id, const char* table_name, uint64_t row_id, const void* data, size_t data_length);
+
+// 追加记录（使用record中除lsn和end_lsn外的全部字段）
+uint64_t wal_append_record(WriteAheadLog* wal, const WalRecord* record);
+
+// 等待日志持久化到指定LSN
+bool wal_flush(WriteAheadLog* wal, uint64_t lsn);
+
+// 追加提交记录并等待持久化
+bool wal_commit(WriteAheadLog* wal, uint64_t transaction_id);
+
+// 当前已预留的日志末尾
+uint64_t wal_current_lsn(WriteAheadLog* wal);
+
+// 当前已持久化的日志末尾
+uint64_t wal_flushed_lsn(WriteAheadLog* wal);
+
+// 获取统计信息
+void wal_get_stats(WriteAheadLog* wal, WalStats* stats);
+
+// 从指定LSN开始按顺序遍历日志记录，遇到损坏或不完整的记录时停止
+bool wal_replay(WriteAheadLog* wal, uint64_t start_lsn, WalReplayCallback callback, void* arg);
+
+// 删除完全位于指定LSN之前的段文件（检查点完成后调用），不越过登记的保留点
+void wal_truncate(WriteAheadLog* wal, uint64_t lsn);
+
+// 登记保留点，lsn必须是记录边界
+void wal_add_retainer(WriteAheadLog* wal, WalRetainer* retainer, uint64_t lsn);
+
+// 推进保留点（检查点完成后调用）
+void wal_set_retainer(WriteAheadLog* wal, WalRetainer* retainer, uint64_t lsn);
+
+// 取消登记保留点
+void wal_remove_retainer(WriteAheadLog* wal, WalRetainer* retainer);
+
+// 最早仍保留的LSN
+uint64_t wal_start_lsn(WriteAheadLog* wal);
+
+// 校验和
+uint32_t wal_checksum(uint32_t seed, const void* data, size_t size);
+
+#endif // WAL_H
@@ -0,0 +1,328 @@
+#include "compression.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPRESSION_MIN_MATCH 4
+#define COMPRESSION_MAX_OFFSET 65535
+#define COMPRESSION_LAST_LITERALS 5 // 末尾至少这么多字节作为字面量
+#define COMPRESSION_FAST_HASH_BITS 14
+#define COMPRESSION_FAST_SKIP_SHIFT 5 // 连续未命中时加大步长，不可压缩的数据很快跳过
+#define COMPRESSION_HIGH_MAX_ATTEMPTS 128 // 哈希链上最多比较的候选位置数
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hash32(uint32_t value, uint32_t bits) {
+    return (value * 2654435761U) >> (32 - bits);
+}
+
+// 输出游标
+typedef struct {
+    uint8_t *data;
+    uint8_t *end;
+    bool overflow;
+} compression_output;
+
+static void output_length(compression_output *out, size_t length) {
+    while (length >= 255) {
+        if (out->data == out->end) {
+            out->overflow = true;
+            return;
+        }
+        *out->data++ = 255;
+        length -= 255;
+    }
+    if (out->data == out->end) {
+        out->overflow = true;
+        return;
+    }
+    *out->data++ = (uint8_t)length;
+}
+
+// 写入一个序列，match_length为0时是只有字面量的最后一个序列
+static void output_sequence(compression_output *out, const uint8_t *literals, size_t literal_length, size_t offset,
+                            size_t match_length) {
+    if (out->overflow || out->data == out->end) {
+        out->overflow = true;
+        return;
+    }
+
+    size_t match_code = match_length ? match_length - COMPRESSION_MIN_MATCH : 0;
+    uint8_t *token = out->data++;
+    *token = (uint8_t)(((literal_length < 15 ? literal_length : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (literal_length >= 15) {
+        output_length(out, literal_length - 15);
+    }
+    if (out->overflow || (size_t)(out->end - out->data) < literal_length) {
+        out->overflow = true;
+        return;
+    }
+    memcpy(out->data, literals, literal_length);
+    out->data += literal_length;
+    if (match_length == 0) {
+        return;
+    }
+
+    if (out->end - out->data < 2) {
+        out->overflow = true;
+        return;
+    }
+    *out->data++ = (uint8_t)(offset & 0xFF);
+    *out->data++ = (uint8_t)(offset >> 8);
+    if (match_code >= 15) {
+        output_length(out, match_code - 15);
+    }
+}
+
+static size_t match_length(const uint8_t *src, size_t match, size_t position, size_t limit) {
+    size_t length = 0;
+    while (position + length < limit && src[match + length] == src[position + length]) {
+        length++;
+    }
+    return length;
+}
+
+// 快速算法：每个位置按4字节的哈希只记住最近的一个位置
+static bool compress_fast(const uint8_t *src, size_t size, compression_output *out) {
+    size_t anchor = 0;
+    if (size >= COMPRESSION_MIN_MATCH + COMPRESSION_LAST_LITERALS + 1) {
+        // 哈希表按输入大小取，小块不用清空整个表
+        uint32_t table[1 << COMPRESSION_FAST_HASH_BITS]; // 位置加1，0表示空
+        uint32_t hash_bits = 8;
+        while (hash_bits < COMPRESSION_FAST_HASH_BITS && ((size_t)1 << hash_bits) < size) {
+            hash_bits++;
+        }
+        memset(table, 0, sizeof(uint32_t) << hash_bits);
+        size_t match_end = size - COMPRESSION_LAST_LITERALS;
+        size_t search_end = match_end - COMPRESSION_MIN_MATCH;
+        size_t position = 0;
+        uint32_t misses = 0;
+        while (position <= search_end && !out->overflow) {
+            uint32_t hash = hash32(read32(src + position), hash_bits);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)position + 1;
+            if (candidate == 0 || position - (candidate - 1) > COMPRESSION_MAX_OFFSET ||
+                read32(src + candidate - 1) != read32(src + position)) {
+                position += 1 + (misses++ >> COMPRESSION_FAST_SKIP_SHIFT);
+                continue;
+            }
+
+            // 匹配向前延伸到上一个序列的末尾
+            size_t match = candidate - 1;
+            while (position > anchor && match > 0 && src[position - 1] == src[match - 1]) {
+                position--;
+                match--;
+            }
+            size_t length = COMPRESSION_MIN_MATCH + match_length(src, match + COMPRESSION_MIN_MATCH, position + COMPRESSION_MIN_MATCH, match_end);
+            output_sequence(out, src + anchor, position - anchor, position - match, length);
+            position += length;
+            anchor = position;
+            misses = 0;
+            if (position - 2 <= search_end) {
+                table[hash32(read32(src + position - 2), hash_bits)] = (uint32_t)(position - 2) + 1;
+            }
+        }
+    }
+    output_sequence(out, src + anchor, size - anchor, 0, 0);
+    return !out->overflow;
+}
+
+// 高压缩率算法的匹配查找器：同一个哈希的位置串成链，从新到旧比较
+typedef struct {
+    int32_t *head;
+    int32_t *previous;
+    uint32_t hash_bits;
+    size_t next_insert; // 下一个要插入链中的位置
+} compression_chain;
+
+static void chain_insert_until(compression_chain *chain, const uint8_t *src, size_t position) {
+    while (chain->next_insert < position) {
+        uint32_t hash = hash32(read32(src + chain->next_insert), chain->hash_bits);
+        chain->previous[chain->next_insert] = chain->head[hash];
+        chain->head[hash] = (int32_t)chain->next_insert;
+        chain->next_insert++;
+    }
+}
+
+static size_t chain_find(compression_chain *chain, const uint8_t *src, size_t position, size_t match_end, size_t *match) {
+    chain_insert_until(chain, src, position);
+    size_t best = 0;
+    int32_t candidate = chain->head[hash32(read32(src + position), chain->hash_bits)];
+    for (uint32_t attempts = 0; candidate >= 0 && attempts < COMPRESSION_HIGH_MAX_ATTEMPTS; attempts++) {
+        if (position - (size_t)candidate > COMPRESSION_MAX_OFFSET) {
+            break;
+        }
+        // 先比较能超过当前最长匹配的那个字节
+        if (src[candidate + best] == src[position + best]) {
+            size_t length = match_length(src, (size_t)candidate, position, match_end);
+            if (length > best) {
+                best = length;
+                *match = (size_t)candidate;
+                if (position + length == match_end) {
+                    break;
+                }
+            }
+        }
+        candidate = chain->previous[candidate];
+    }
+    return best >= COMPRESSION_MIN_MATCH ? best : 0;
+}
+
+// 高压缩率算法：在哈希链上找最长匹配，下一个位置的匹配更长时先输出一个字面量
+static bool compress_high(const uint8_t *src, size_t size, compression_output *out) {
+    size_t anchor = 0;
+    if (size >= COMPRESSION_MIN_MATCH + COMPRESSION_LAST_LITERALS + 1) {
+        compression_chain chain;
+        chain.hash_bits = 8;
+        while (chain.hash_bits < 16 && ((size_t)1 << chain.hash_bits) < size) {
+            chain.hash_bits++;
+        }
+        chain.head = (int32_t *)malloc(sizeof(int32_t) << chain.hash_bits);
+        chain.previous = (int32_t *)malloc(sizeof(int32_t) * size);
+        chain.next_insert = 0;
+        if (!chain.head || !chain.previous) {
+            free(chain.head);
+            free(chain.previous);
+            return compress_fast(src, size, out);
+        }
+        memset(chain.head, 0xFF, sizeof(int32_t) << chain.hash_bits);
+
+        size_t match_end = size - COMPRESSION_LAST_LITERALS;
+        size_t search_end = match_end - COMPRESSION_MIN_MATCH;
+        size_t position = 0;
+        while (position <= search_end && !out->overflow) {
+            size_t match = 0;
+            size_t length = chain_find(&chain, src, position, match_end, &match);
+            if (length == 0) {
+                position++;
+                continue;
+            }
+            while (position + 1 <= search_end) {
+                size_t next_match = 0;
+                size_t next_length = chain_find(&chain, src, position + 1, match_end, &next_match);
+                if (next_length <= length) {
+                    break;
+                }
+                position++;
+                match = next_match;
+                length = next_length;
+            }
+            output_sequence(out, src + anchor, position - anchor, position - match, length);
+            position += length;
+            anchor = position;
+        }
+        free(chain.head);
+        free(chain.previous);
+    }
+    output_sequence(out, src + anchor, size - anchor, 0, 0);
+    return !out->overflow;
+}
+
+bool compression_codec_valid(uint8_t codec) {
+    return codec == COMPRESSION_NONE || codec == COMPRESSION_FAST || codec == COMPRESSION_HIGH;
+}
+
+size_t compression_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t compression_compress(compression_codec codec, const char *src, size_t src_size, char *dst, size_t dst_capacity) {
+    compression_output out;
+    out.data = (uint8_t *)dst;
+    out.end = (uint8_t *)dst + dst_capacity;
+    out.overflow = false;
+
+    switch (codec) {
+        case COMPRESSION_NONE:
+            if (src_size > dst_capacity) {
+                return 0;
+            }
+            memcpy(dst, src, src_size);
+            return src_size;
+        case COMPRESSION_FAST:
+            return compress_fast((const uint8_t *)src, src_size, &out) ? (size_t)(out.data - (uint8_t *)dst) : 0;
+        case COMPRESSION_HIGH:
+            return compress_high((const uint8_t *)src, src_size, &out) ? (size_t)(out.data - (uint8_t *)dst) : 0;
+        default:
+            return 0;
+    }
+}
+
+// 读取长度扩展字节
+static bool input_length(const uint8_t **input, const uint8_t *end, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*input == end) {
+            return false;
+        }
+        byte = *(*input)++;
+        if (*length > SIZE_MAX - byte) {
+            return false;
+        }
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool compression_decompress(compression_codec codec, const char *src, size_t src_size, char *dst, size_t dst_size) {
+    if (codec == COMPRESSION_NONE) {
+        if (src_size != dst_size) {
+            return false;
+        }
+        memcpy(dst, src, src_size);
+        return true;
+    }
+    if (codec != COMPRESSION_FAST && codec != COMPRESSION_HIGH) {
+        return false;
+    }
+
+    const uint8_t *input = (const uint8_t *)src;
+    const uint8_t *input_end = input + src_size;
+    uint8_t *output = (uint8_t *)dst;
+    uint8_t *output_end = output + dst_size;
+    while (input < input_end) {
+        uint8_t token = *input++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !input_length(&input, input_end, &literal_length)) {
+            return false;
+        }
+        if (literal_length > (size_t)(input_end - input) || literal_length > (size_t)(output_end - output)) {
+            return false;
+        }
+        memcpy(output, input, literal_length);
+        input += literal_length;
+        output += literal_length;
+        if (input == input_end) {
+            break;
+        }
+
+        if (input_end - input < 2) {
+            return false;
+        }
+        size_t offset = (size_t)input[0] | ((size_t)input[1] << 8);
+        input += 2;
+        size_t length = token & 15;
+        if (length == 15 && !input_length(&input, input_end, &length)) {
+            return false;
+        }
+        length += COMPRESSION_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(output - (uint8_t *)dst) || length > (size_t)(output_end - output)) {
+            return false;
+        }
+
+        // 偏移小于长度时源和目标重叠，逐字节复制
+        const uint8_t *match = output - offset;
+        if (offset >= length) {
+            memcpy(output, match, length);
+            output += length;
+        } else {
+            while (length-- > 0) {
+                *output++ = *match++;
+            }
+        }
+    }
+    return output == output_end;
+}
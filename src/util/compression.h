@@ -0,0 +1,34 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// 块压缩
+// 快速算法和高压缩率算法输出同一种LZ77格式，只是查找匹配的力度不同，解压速度相同：
+// 每个序列是[标记][字面量长度扩展][字面量][偏移(2字节，小端)][匹配长度扩展]，
+// 标记的高4位是字面量长度、低4位是匹配长度减4，等于15时之后每个255字节继续累加，直到小于255的字节。
+// 最后一个序列只有字面量。匹配偏移最大65535，输出可以与自身重叠（重复的短串）。
+// 不依赖外部库；压缩后不比原数据小时由调用者决定是否存原数据。
+
+// 压缩算法编号（写入块头，不能改变已有的值）
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_FAST = 1, // 哈希表找最近的一个匹配，贪心
+    COMPRESSION_HIGH = 2 // 哈希链找最长匹配，惰性匹配
+} compression_codec;
+
+// 是否是已知的压缩算法
+bool compression_codec_valid(uint8_t codec);
+
+// 压缩size字节最多需要的输出空间
+size_t compression_bound(size_t size);
+
+// 压缩到dst，返回输出的字节数，输出超过dst_capacity或算法未知时返回0
+size_t compression_compress(compression_codec codec, const char *src, size_t src_size, char *dst, size_t dst_capacity);
+
+// 解压到dst，输出必须恰好是dst_size字节，数据损坏时返回false
+bool compression_decompress(compression_codec codec, const char *src, size_t src_size, char *dst, size_t dst_size);
+
+#endif // COMPRESSION_H
@@ -0,0 +1,86 @@
+#include "hash.h"
+#include <string.h>
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t hash_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * HASH_PRIME2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * HASH_PRIME1;
+}
+
+static uint64_t hash_merge_round(uint64_t hash, uint64_t accumulator) {
+    hash ^= hash_round(0, accumulator);
+    return hash * HASH_PRIME1 + HASH_PRIME4;
+}
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + size;
+    uint64_t hash;
+
+    // 每32字节更新四个独立的累加器
+    if (size >= 32) {
+        uint64_t v1 = seed + HASH_PRIME1 + HASH_PRIME2;
+        uint64_t v2 = seed + HASH_PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HASH_PRIME1;
+        do {
+            v1 = hash_round(v1, read64(p));
+            v2 = hash_round(v2, read64(p + 8));
+            v3 = hash_round(v3, read64(p + 16));
+            v4 = hash_round(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = hash_merge_round(hash, v1);
+        hash = hash_merge_round(hash, v2);
+        hash = hash_merge_round(hash, v3);
+        hash = hash_merge_round(hash, v4);
+    } else {
+        hash = seed + HASH_PRIME5;
+    }
+    hash += (uint64_t)size;
+
+    while (end - p >= 8) {
+        hash ^= hash_round(0, read64(p));
+        hash = rotate_left(hash, 27) * HASH_PRIME1 + HASH_PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        hash ^= (uint64_t)read32(p) * HASH_PRIME1;
+        hash = rotate_left(hash, 23) * HASH_PRIME2 + HASH_PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (*p++) * HASH_PRIME5;
+        hash = rotate_left(hash, 11) * HASH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
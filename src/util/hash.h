@@ -0,0 +1,10 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 64位哈希（XXH64算法），输出的每一位都充分混合，可以直接拆成多个独立的哈希值使用
+uint64_t hash64(const void *data, size_t size, uint64_t seed);
+
+#endif // HASH_H
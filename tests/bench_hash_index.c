@@ -0,0 +1,140 @@
+#include "../src/index/hash_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// 并发哈希索引吞吐量基准测试（不属于单元测试，用make bench运行）
+// 在1、2、4……个线程下分别测量查询和更新的吞吐量，线程数上限默认为CPU数（至少4），
+// 也可以由第一个参数指定
+
+#define BENCH_KEYS 100000
+#define BENCH_OPS_PER_THREAD 400000
+#define BENCH_MAX_THREADS 64
+
+typedef enum {
+    BENCH_LOOKUP,
+    BENCH_UPDATE
+} bench_mode;
+
+typedef struct {
+    concurrent_hash_index *index;
+    pthread_barrier_t *barrier;
+    bench_mode mode;
+    int thread_id;
+    int failures;
+} bench_context;
+
+// 按线程号确定的伪随机键序列；更新写入与键相同的值，查询结果总是确定的
+static void *bench_worker(void *arg) {
+    bench_context *context = (bench_context *)arg;
+    uint32_t state = (uint32_t)context->thread_id * 2654435761U + 1;
+    char key[32];
+
+    pthread_barrier_wait(context->barrier);
+    for (int i = 0; i < BENCH_OPS_PER_THREAD; i++) {
+        state = state * 1664525U + 1013904223U;
+        int id = (int)((state >> 8) % BENCH_KEYS);
+        int key_size = snprintf(key, sizeof(key), "chx%06d", id);
+        if (context->mode == BENCH_UPDATE) {
+            if (!concurrent_hash_index_insert(context->index, key, key_size, key, key_size)) {
+                context->failures++;
+            }
+            continue;
+        }
+        uint32_t value_size = 0;
+        char *value = concurrent_hash_index_get(context->index, key, key_size, &value_size);
+        if (!value || value_size != (uint32_t)key_size || memcmp(value, key, value_size) != 0) {
+            context->failures++;
+        }
+        free(value);
+    }
+    return NULL;
+}
+
+// 运行一轮，返回每秒操作数（失败时返回负数）
+static double bench_run(concurrent_hash_index *index, bench_mode mode, int thread_count) {
+    bench_context contexts[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)thread_count + 1);
+
+    for (int i = 0; i < thread_count; i++) {
+        contexts[i].index = index;
+        contexts[i].barrier = &barrier;
+        contexts[i].mode = mode;
+        contexts[i].thread_id = i;
+        contexts[i].failures = 0;
+        if (pthread_create(&threads[i], NULL, bench_worker, &contexts[i]) != 0) {
+            // 已启动的线程在屏障处等待，无法继续
+            fprintf(stderr, "Failed to start benchmark thread\n");
+            exit(1);
+        }
+    }
+
+    // 全部线程就绪后开始计时
+    struct timespec start;
+    struct timespec end;
+    pthread_barrier_wait(&barrier);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failures = 0;
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+        failures += contexts[i].failures;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&barrier);
+
+    if (failures > 0) {
+        return -1.0;
+    }
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)thread_count * BENCH_OPS_PER_THREAD / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        max_threads = strtol(argv[1], NULL, 10);
+    } else if (max_threads < 4) {
+        max_threads = 4;
+    }
+    if (max_threads < 1 || max_threads > BENCH_MAX_THREADS) {
+        fprintf(stderr, "Thread count must be between 1 and %d\n", BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    concurrent_hash_index *index = concurrent_hash_index_create(0);
+    if (!index) {
+        fprintf(stderr, "Failed to create concurrent hash index\n");
+        return 1;
+    }
+    char key[32];
+    for (int id = 0; id < BENCH_KEYS; id++) {
+        int key_size = snprintf(key, sizeof(key), "chx%06d", id);
+        if (!concurrent_hash_index_insert(index, key, key_size, key, key_size)) {
+            fprintf(stderr, "Failed to insert hash index key\n");
+            concurrent_hash_index_destroy(index);
+            return 1;
+        }
+    }
+
+    printf("concurrent_hash_index: %d keys, %d operations per thread\n", BENCH_KEYS, BENCH_OPS_PER_THREAD);
+    printf("%8s %16s %16s\n", "threads", "lookup ops/s", "update ops/s");
+    int status = 0;
+    for (long thread_count = 1; thread_count <= max_threads && status == 0; thread_count *= 2) {
+        double lookup = bench_run(index, BENCH_LOOKUP, (int)thread_count);
+        double update = bench_run(index, BENCH_UPDATE, (int)thread_count);
+        if (lookup < 0 || update < 0) {
+            fprintf(stderr, "Concurrent hash index returned a wrong value or failed an update\n");
+            status = 1;
+            break;
+        }
+        printf("%8ld %16.0f %16.0f\n", thread_count, lookup, update);
+    }
+
+    concurrent_hash_index_destroy(index);
+    return status;
+}
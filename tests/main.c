@@ -7,6 +7,12 @@
 #include "../src/memory/memory_cache.h"
 #include "../src/storage/storage_engine.h"
 #include "../src/index/b_plus_tree.h"
+#include "../src/index/disk_b_plus_tree.h"
+#include "../src/index/disk_hash_index.h"
+#include "../src/index/lsm_tree.h"
+#include "../src/index/hash_index.h"
+#include "../src/util/compression.h"
+#include "../src/util/hash.h"
 #include "../src/security/security.h"
 #include "../src/network/network.h"
 #include "../src/transaction/transaction.h"
@@ -23,6 +29,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 
 // 配置测试
 static int test_config_create(void) {
@@ -124,9 +136,827 @@ static int test_storage_engine_create(void) {
     return result;
 }
 
+// 扫描谓词：第一列为偶数
+static bool test_scan_even_predicate(const Row *row, void *arg) {
+    (void)arg;
+    return row->values[0] && (*(int *)row->values[0] % 2) == 0;
+}
+
+static int test_storage_engine_scan(void) {
+    config_system *config = config_init(NULL);
+    if (!config) {
+        return ERROR_FAIL;
+    }
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    if (!storage) {
+        config_destroy(config);
+        return ERROR_FAIL;
+    }
+
+    Column *columns = (Column *)malloc(sizeof(Column) * 2);
+    columns[0].name = strdup("id");
+    columns[0].data_type = DATA_TYPE_INT;
+    columns[0].default_value = NULL;
+    columns[1].name = strdup("score");
+    columns[1].data_type = DATA_TYPE_INT;
+    columns[1].default_value = NULL;
+    Table *table = create_table("scan_test", columns, 2, STORAGE_ENGINE_ROW);
+    storage_engine_create_table(storage, table);
+
+    for (int i = 0; i < 3000; i++) {
+        Row *row = create_row(2);
+        row->values[0] = malloc(sizeof(int));
+        row->values[1] = malloc(sizeof(int));
+        *(int *)row->values[0] = i;
+        *(int *)row->values[1] = i * 10;
+        storage_engine_insert(storage, "scan_test", row);
+    }
+
+    size_t projection[] = {1};
+    ScanOptions options = {
+        .predicate = test_scan_even_predicate,
+        .predicate_arg = NULL,
+        .projection = projection,
+        .projection_count = 1,
+        .batch_size = 0
+    };
+    ScanCursor *cursor = storage_engine_scan_open(storage, "scan_test", &options);
+    int result = test_assert_not_null(cursor, "Failed to open scan cursor");
+    size_t total = 0;
+    size_t batch = 0;
+    while (result == SUCCESS && (batch = storage_engine_scan_next(storage, cursor)) > 0) {
+        result = test_assert_true(batch <= STORAGE_SCAN_BATCH_SIZE, "Scan batch exceeds batch size");
+        for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+            result = test_assert_equal(1, (int)cursor->rows[i].value_count, "Projection not applied");
+            if (result == SUCCESS) {
+                result = test_assert_equal(0, *(int *)cursor->rows[i].values[0] % 20, "Predicate not applied");
+            }
+        }
+        total += batch;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(1500, (int)total, "Unexpected scanned row count");
+    }
+    storage_engine_scan_close(storage, cursor);
+
+    storage_engine_manager_destroy(storage);
+    config_destroy(config);
+    return result;
+}
+
+// 各引擎的扫描：删除的行不输出，所有列都为空的行是有效行，压缩表后仍然保留；
+// 投影按给定顺序输出列，只有投影没有谓词时列存引擎只收集投影列；批次不超过批量大小
+#define SCAN_ENGINE_ROW_COUNT 3000
+
+static int test_scan_engine_table(StorageEngineManager *storage, const char *table_name, int engine_type) {
+    Column *columns = (Column *)malloc(sizeof(Column) * 2);
+    columns[0].name = strdup("id");
+    columns[0].data_type = DATA_TYPE_INT;
+    columns[0].default_value = NULL;
+    columns[1].name = strdup("score");
+    columns[1].data_type = DATA_TYPE_INT;
+    columns[1].default_value = NULL;
+    Table *table = create_table(table_name, columns, 2, engine_type);
+    int result = test_assert_true(storage_engine_create_table(storage, table), "Failed to create scan table");
+
+    for (int i = 0; i < SCAN_ENGINE_ROW_COUNT && result == SUCCESS; i++) {
+        Row *row = create_row(2);
+        row->values[0] = malloc(sizeof(int));
+        row->values[1] = malloc(sizeof(int));
+        *(int *)row->values[0] = i;
+        *(int *)row->values[1] = i * 10;
+        result = test_assert_true(storage_engine_insert(storage, table_name, row), "Failed to insert scan row");
+    }
+    for (int i = 4; i < SCAN_ENGINE_ROW_COUNT && result == SUCCESS; i += 5) {
+        result = test_assert_true(storage_engine_delete(storage, table_name, (uint64_t)i + 1), "Failed to delete scan row");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(storage_engine_insert(storage, table_name, create_row(2)), "Failed to insert NULL row");
+    }
+    int expected = SCAN_ENGINE_ROW_COUNT - SCAN_ENGINE_ROW_COUNT / 5 + 1;
+
+    // 只有投影（反序），批量大小不整除行数
+    size_t reversed[] = {1, 0};
+    ScanOptions options = {NULL, NULL, reversed, 2, 7};
+    ScanCursor *cursor = result == SUCCESS ? storage_engine_scan_open(storage, table_name, &options) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(cursor, "Failed to open scan cursor");
+    }
+    int total = 0;
+    uint64_t last_row_id = 0;
+    size_t batch = 0;
+    while (result == SUCCESS && (batch = storage_engine_scan_next(storage, cursor)) > 0) {
+        result = test_assert_true(batch <= 7, "Scan batch exceeds batch size");
+        for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+            const Row *row = &cursor->rows[i];
+            uint64_t row_id = cursor->row_ids[i];
+            bool null_row = !row->values[0] && !row->values[1];
+            bool valid = row->value_count == 2 && row_id > last_row_id && (row_id - 1) % 5 != 4 &&
+                         (null_row ? row_id == SCAN_ENGINE_ROW_COUNT + 1 :
+                          *(int *)row->values[1] == (int)row_id - 1 && *(int *)row->values[0] == ((int)row_id - 1) * 10);
+            result = test_assert_true(valid, "Projected scan returned a wrong row");
+            last_row_id = row_id;
+        }
+        total += (int)batch;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(expected, total, "Unexpected projected scan row count");
+    }
+    storage_engine_scan_close(storage, cursor);
+
+    // 谓词和投影，批量大小整除行数
+    size_t projection[] = {1};
+    ScanOptions filtered = {test_scan_even_predicate, NULL, projection, 1, SCAN_ENGINE_ROW_COUNT / 3};
+    cursor = result == SUCCESS ? storage_engine_scan_open(storage, table_name, &filtered) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(cursor, "Failed to open scan cursor");
+    }
+    total = 0;
+    while (result == SUCCESS && (batch = storage_engine_scan_next(storage, cursor)) > 0) {
+        result = test_assert_true(batch <= SCAN_ENGINE_ROW_COUNT / 3, "Scan batch exceeds batch size");
+        for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+            const Row *row = &cursor->rows[i];
+            result = test_assert_true(row->value_count == 1 && row->values[0] && *(int *)row->values[0] % 20 == 0 &&
+                                      *(int *)row->values[0] == ((int)cursor->row_ids[i] - 1) * 10,
+                                      "Filtered scan returned a wrong row");
+        }
+        total += (int)batch;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(SCAN_ENGINE_ROW_COUNT / 2 - SCAN_ENGINE_ROW_COUNT / 10, total, "Unexpected filtered scan row count");
+    }
+    storage_engine_scan_close(storage, cursor);
+
+    // 压缩表只移除删除的行
+    if (result == SUCCESS) {
+        result = test_assert_true(storage_engine_optimize(storage, table_name), "Failed to optimize scan table");
+    }
+    cursor = result == SUCCESS ? storage_engine_scan_open(storage, table_name, NULL) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(cursor, "Failed to open scan cursor");
+    }
+    total = 0;
+    int null_rows = 0;
+    while (result == SUCCESS && (batch = storage_engine_scan_next(storage, cursor)) > 0) {
+        for (size_t i = 0; i < batch; i++) {
+            null_rows += !cursor->rows[i].values[0] && !cursor->rows[i].values[1];
+        }
+        total += (int)batch;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(total == expected && null_rows == 1, "Optimize dropped a live row");
+    }
+    storage_engine_scan_close(storage, cursor);
+    return result;
+}
+
+static int test_storage_engine_scan_engines(void) {
+    config_system *config = config_init(NULL);
+    if (!config) {
+        return ERROR_FAIL;
+    }
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    if (!storage) {
+        config_destroy(config);
+        return ERROR_FAIL;
+    }
+
+    int result = SUCCESS;
+    int engine_types[] = {STORAGE_ENGINE_ROW, STORAGE_ENGINE_COLUMN, STORAGE_ENGINE_MEMORY};
+    const char *table_names[] = {"scan_row", "scan_column", "scan_memory"};
+    for (int e = 0; e < 3 && result == SUCCESS; e++) {
+        result = test_scan_engine_table(storage, table_names[e], engine_types[e]);
+    }
+
+    storage_engine_manager_destroy(storage);
+    config_destroy(config);
+    return result;
+}
+
+static int test_storage_engine_select_view(void) {
+    config_system *config = config_init(NULL);
+    if (!config) {
+        return ERROR_FAIL;
+    }
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    if (!storage) {
+        config_destroy(config);
+        return ERROR_FAIL;
+    }
+
+    Column *columns = (Column *)malloc(sizeof(Column));
+    columns[0].name = strdup("value");
+    columns[0].data_type = DATA_TYPE_INT;
+    columns[0].default_value = NULL;
+    Table *table = create_table("view_test", columns, 1, STORAGE_ENGINE_MEMORY);
+    storage_engine_create_table(storage, table);
+
+    Row *row = create_row(1);
+    row->values[0] = malloc(sizeof(int));
+    *(int *)row->values[0] = 7;
+    storage_engine_insert(storage, "view_test", row);
+
+    const Row *view = storage_engine_select_view(storage, "view_test", 1);
+    int result = test_assert_not_null((void *)view, "Failed to select row view");
+
+    // 更新后视图仍指向旧版本
+    if (result == SUCCESS) {
+        Row *updated = create_row(1);
+        updated->values[0] = malloc(sizeof(int));
+        *(int *)updated->values[0] = 8;
+        storage_engine_update(storage, "view_test", 1, updated);
+        result = test_assert_equal(7, *(int *)view->values[0], "View changed after update");
+        storage_engine_release_view(storage, "view_test", view);
+    }
+
+    // 行存引擎删除后视图仍是删除前的行
+    Column *row_columns = (Column *)malloc(sizeof(Column));
+    row_columns[0].name = strdup("value");
+    row_columns[0].data_type = DATA_TYPE_INT;
+    row_columns[0].default_value = NULL;
+    storage_engine_create_table(storage, create_table("view_row_test", row_columns, 1, STORAGE_ENGINE_ROW));
+    row = create_row(1);
+    row->values[0] = malloc(sizeof(int));
+    *(int *)row->values[0] = 7;
+    storage_engine_insert(storage, "view_row_test", row);
+    view = result == SUCCESS ? storage_engine_select_view(storage, "view_row_test", 1) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null((void *)view, "Failed to select row view");
+    }
+    if (result == SUCCESS) {
+        storage_engine_delete(storage, "view_row_test", 1);
+        result = test_assert_true(!view->deleted && *(int *)view->values[0] == 7, "View changed after delete");
+        storage_engine_release_view(storage, "view_row_test", view);
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(storage_engine_select_view(storage, "view_row_test", 1) == NULL, "Deleted row still visible");
+    }
+
+    storage_engine_manager_destroy(storage);
+    config_destroy(config);
+    return result;
+}
+
+// 并发压力测试：写线程插入并更新，读线程同时扫描和查询视图
+#define STRESS_WRITER_COUNT 4
+#define STRESS_READER_COUNT 2
+#define STRESS_ROWS_PER_WRITER 2000
+
+typedef struct {
+    StorageEngineManager *storage;
+    const char *table_name;
+    int *writers_done;
+    int failures;
+} stress_context;
+
+static void *stress_writer(void *arg) {
+    stress_context *context = (stress_context *)arg;
+    for (int i = 0; i < STRESS_ROWS_PER_WRITER; i++) {
+        Row *row = create_row(1);
+        row->values[0] = malloc(sizeof(int));
+        *(int *)row->values[0] = i;
+        if (!storage_engine_insert(context->storage, context->table_name, row)) {
+            destroy_row(row);
+            context->failures++;
+        }
+
+        // 同时更新已存在的行，与扫描和视图竞争
+        if (i % 8 == 0) {
+            Row *updated = create_row(1);
+            updated->values[0] = malloc(sizeof(int));
+            *(int *)updated->values[0] = i;
+            if (!storage_engine_update(context->storage, context->table_name, (uint64_t)i + 1, updated)) {
+                destroy_row(updated);
+            }
+        }
+    }
+    __sync_fetch_and_add(context->writers_done, 1);
+    return NULL;
+}
+
+static void *stress_reader(void *arg) {
+    stress_context *context = (stress_context *)arg;
+    while (__atomic_load_n(context->writers_done, __ATOMIC_ACQUIRE) < STRESS_WRITER_COUNT) {
+        ScanCursor *cursor = storage_engine_scan_open(context->storage, context->table_name, NULL);
+        if (!cursor) {
+            context->failures++;
+            break;
+        }
+        size_t batch = 0;
+        while ((batch = storage_engine_scan_next(context->storage, cursor)) > 0) {
+            for (size_t i = 0; i < batch; i++) {
+                if (!cursor->rows[i].values[0] || *(int *)cursor->rows[i].values[0] < 0) {
+                    context->failures++;
+                }
+            }
+        }
+        storage_engine_scan_close(context->storage, cursor);
+
+        const Row *view = storage_engine_select_view(context->storage, context->table_name, 1);
+        if (view) {
+            if (*(int *)view->values[0] != 0) {
+                context->failures++;
+            }
+            storage_engine_release_view(context->storage, context->table_name, view);
+        }
+    }
+    return NULL;
+}
+
+static int test_storage_engine_concurrency(void) {
+    config_system *config = config_init(NULL);
+    if (!config) {
+        return ERROR_FAIL;
+    }
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    if (!storage) {
+        config_destroy(config);
+        return ERROR_FAIL;
+    }
+
+    int result = SUCCESS;
+    int engine_types[] = {STORAGE_ENGINE_ROW, STORAGE_ENGINE_COLUMN, STORAGE_ENGINE_MEMORY};
+    const char *table_names[] = {"stress_row", "stress_column", "stress_memory"};
+    for (int e = 0; e < 3 && result == SUCCESS; e++) {
+        Column *columns = (Column *)malloc(sizeof(Column));
+        columns[0].name = strdup("value");
+        columns[0].data_type = DATA_TYPE_INT;
+        columns[0].default_value = NULL;
+        Table *table = create_table(table_names[e], columns, 1, engine_types[e]);
+        storage_engine_create_table(storage, table);
+
+        int writers_done = 0;
+        stress_context contexts[STRESS_WRITER_COUNT + STRESS_READER_COUNT];
+        pthread_t threads[STRESS_WRITER_COUNT + STRESS_READER_COUNT];
+        for (int i = 0; i < STRESS_WRITER_COUNT + STRESS_READER_COUNT; i++) {
+            contexts[i].storage = storage;
+            contexts[i].table_name = table_names[e];
+            contexts[i].writers_done = &writers_done;
+            contexts[i].failures = 0;
+            pthread_create(&threads[i], NULL, i < STRESS_WRITER_COUNT ? stress_writer : stress_reader, &contexts[i]);
+        }
+
+        int failures = 0;
+        for (int i = 0; i < STRESS_WRITER_COUNT + STRESS_READER_COUNT; i++) {
+            pthread_join(threads[i], NULL);
+            failures += contexts[i].failures;
+        }
+        result = test_assert_equal(0, failures, "Concurrent operation failed");
+
+        // 所有写线程结束后，扫描结果必须包含全部插入的行
+        size_t total = 0;
+        ScanCursor *cursor = storage_engine_scan_open(storage, table_names[e], NULL);
+        if (result == SUCCESS) {
+            result = test_assert_not_null(cursor, "Failed to open scan cursor");
+        }
+        size_t batch = 0;
+        while (cursor && (batch = storage_engine_scan_next(storage, cursor)) > 0) {
+            total += batch;
+        }
+        storage_engine_scan_close(storage, cursor);
+        if (result == SUCCESS) {
+            result = test_assert_equal(STRESS_WRITER_COUNT * STRESS_ROWS_PER_WRITER, (int)total, "Rows lost under concurrency");
+        }
+    }
+
+    storage_engine_manager_destroy(storage);
+    config_destroy(config);
+    return result;
+}
+
+// 删除测试使用的日志目录
+static void test_remove_directory(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (dir) {
+        struct dirent *entry;
+        char path[1024];
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(directory);
+}
+
+// 创建单个INT列的表
+static Table *test_create_int_table(const char *name, int engine_type) {
+    Column *columns = (Column *)malloc(sizeof(Column));
+    columns[0].name = strdup("value");
+    columns[0].data_type = DATA_TYPE_INT;
+    columns[0].length = 0;
+    columns[0].nullable = true;
+    columns[0].primary_key = false;
+    columns[0].auto_increment = false;
+    columns[0].default_value = NULL;
+    return create_table(name, columns, 1, engine_type);
+}
+
+static Row *test_create_int_row(int value) {
+    Row *row = create_row(1);
+    row->values[0] = malloc(sizeof(int));
+    *(int *)row->values[0] = value;
+    return row;
+}
+
+// 组提交测试：并发的自动提交插入共享fsync
+#define WAL_COMMIT_THREAD_COUNT 8
+#define WAL_COMMITS_PER_THREAD 200
+
+static void *wal_commit_worker(void *arg) {
+    stress_context *context = (stress_context *)arg;
+    for (int i = 0; i < WAL_COMMITS_PER_THREAD; i++) {
+        Row *row = test_create_int_row(i);
+        if (!storage_engine_insert(context->storage, context->table_name, row)) {
+            destroy_row(row);
+            context->failures++;
+        }
+    }
+    return NULL;
+}
+
+static int test_storage_engine_wal_group_commit(void) {
+    char directory[] = "/tmp/wal_group_commit_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    config_system *config = config_init(NULL);
+    if (!config) {
+        rmdir(directory);
+        return ERROR_FAIL;
+    }
+    config_set_bool(config, "storage.wal_enabled", true, "Enable write-ahead log");
+    config_set_string(config, "storage.wal_dir", directory, "Write-ahead log directory");
+    config_set_int(config, "storage.wal_commit_delay_us", 200, "Group commit delay in microseconds");
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    int result = test_assert_not_null(storage, "Failed to create storage engine manager");
+    if (!storage) {
+        config_destroy(config);
+        test_remove_directory(directory);
+        return result;
+    }
+
+    storage_engine_create_table(storage, test_create_int_table("wal_commit", STORAGE_ENGINE_MEMORY));
+
+    stress_context contexts[WAL_COMMIT_THREAD_COUNT];
+    pthread_t threads[WAL_COMMIT_THREAD_COUNT];
+    for (int i = 0; i < WAL_COMMIT_THREAD_COUNT; i++) {
+        contexts[i].storage = storage;
+        contexts[i].table_name = "wal_commit";
+        contexts[i].writers_done = NULL;
+        contexts[i].failures = 0;
+        pthread_create(&threads[i], NULL, wal_commit_worker, &contexts[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < WAL_COMMIT_THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+        failures += contexts[i].failures;
+    }
+    result = test_assert_equal(0, failures, "Durable insert failed");
+
+    // 每次插入都在返回前持久化，但并发提交应当合并为少得多的fsync
+    WalStats stats;
+    wal_get_stats(storage->wal, &stats);
+    if (result == SUCCESS) {
+        result = test_assert_true(stats.syncs < WAL_COMMIT_THREAD_COUNT * WAL_COMMITS_PER_THREAD, "Commits were not grouped");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(wal_flushed_lsn(storage->wal) == wal_current_lsn(storage->wal), "Log not flushed");
+    }
+
+    storage_engine_manager_destroy(storage);
+    config_destroy(config);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 统计表中可见的行数，同时检查没有出现未提交的值
+static int test_count_rows(StorageEngineManager *storage, const char *table_name) {
+    ScanCursor *cursor = storage_engine_scan_open(storage, table_name, NULL);
+    if (!cursor) {
+        return -1;
+    }
+    int total = 0;
+    size_t batch = 0;
+    while ((batch = storage_engine_scan_next(storage, cursor)) > 0) {
+        for (size_t i = 0; i < batch; i++) {
+            if (cursor->rows[i].values[0] && *(int *)cursor->rows[i].values[0] < 0) {
+                total = -1000000;
+            }
+        }
+        total += (int)batch;
+    }
+    storage_engine_scan_close(storage, cursor);
+    return total;
+}
+
+// 崩溃恢复测试：重新打开后回放已提交的修改，未提交事务的修改被丢弃
+static int test_storage_engine_wal_recovery(void) {
+    char directory[] = "/tmp/wal_recovery_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    config_system *config = config_init(NULL);
+    if (!config) {
+        rmdir(directory);
+        return ERROR_FAIL;
+    }
+    config_set_bool(config, "storage.wal_enabled", true, "Enable write-ahead log");
+    config_set_string(config, "storage.wal_dir", directory, "Write-ahead log directory");
+
+    int engine_types[] = {STORAGE_ENGINE_ROW, STORAGE_ENGINE_COLUMN, STORAGE_ENGINE_MEMORY};
+    const char *table_names[] = {"recover_row", "recover_column", "recover_memory"};
+
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    int result = test_assert_not_null(storage, "Failed to create storage engine manager");
+    if (storage) {
+        for (int e = 0; e < 3; e++) {
+            storage_engine_create_table(storage, test_create_int_table(table_names[e], engine_types[e]));
+            for (int i = 0; i < 100; i++) {
+                storage_engine_insert(storage, table_names[e], test_create_int_row(i));
+            }
+            storage_engine_update(storage, table_names[e], 1, test_create_int_row(1000));
+        }
+        storage_engine_delete(storage, "recover_row", 2);
+        storage_engine_delete(storage, "recover_memory", 2);
+
+        // 未提交的事务
+        storage_engine_begin_transaction(storage, "recover_row");
+        storage_engine_insert(storage, "recover_row", test_create_int_row(-1));
+        storage_engine_update(storage, "recover_row", 3, test_create_int_row(-1));
+
+        storage_engine_manager_destroy(storage);
+    }
+
+    // 重新打开，表结构和数据都从日志恢复
+    storage = result == SUCCESS ? storage_engine_manager_init(config) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(storage, "Failed to reopen storage engine manager");
+    }
+    int expected[] = {99, 100, 99};
+    for (int e = 0; e < 3 && result == SUCCESS; e++) {
+        result = test_assert_equal(expected[e], test_count_rows(storage, table_names[e]), "Recovered row count mismatch");
+        if (result == SUCCESS) {
+            Row *row = storage_engine_select(storage, table_names[e], 1);
+            result = test_assert_not_null(row, "Recovered row missing");
+            if (result == SUCCESS) {
+                result = test_assert_equal(1000, *(int *)row->values[0], "Update not recovered");
+            }
+            destroy_row(row);
+        }
+    }
+
+    // 恢复后继续写入，新行ID不能与回放的行冲突
+    if (result == SUCCESS) {
+        result = test_assert_true(storage_engine_insert(storage, "recover_memory", test_create_int_row(100)), "Insert after recovery failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(100, test_count_rows(storage, "recover_memory"), "Row ID reused after recovery");
+    }
+
+    if (storage) {
+        storage_engine_manager_destroy(storage);
+    }
+    config_destroy(config);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 写盘失败后WAL不再接受记录，等待持久化的提交立即返回false
+static int test_storage_engine_wal_write_failure(void) {
+    char directory[] = "/tmp/wal_failure_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    WalConfig wal_config = {directory, 64 * 1024, 1024 * 1024, 0};
+    WriteAheadLog *wal = wal_open(&wal_config);
+    int result = test_assert_not_null(wal, "Failed to open WAL");
+    if (result == SUCCESS) {
+        result = test_assert_true(wal_commit(wal, 1), "WAL commit failed");
+    }
+
+    // 把段文件换成只读的文件描述符，之后的写盘都会失败
+    int fd = open("/dev/null", O_RDONLY);
+    if (result == SUCCESS) {
+        result = test_assert_true(fd >= 0 && dup2(fd, wal->segment_fd) >= 0, "Failed to replace WAL segment");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(!wal_commit(wal, 2), "WAL commit succeeded after a write error");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(wal_append(wal, WAL_RECORD_COMMIT, 3, NULL, 0, NULL, 0) == 0 && !wal_flush(wal, wal_current_lsn(wal)),
+                                  "WAL accepted a record after a write error");
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 读取单个INT列的值，行不存在时返回-1
+static int test_select_int(StorageEngineManager *storage, const char *table_name, uint64_t row_id) {
+    Row *row = storage_engine_select(storage, table_name, row_id);
+    int value = (row && row->values[0]) ? *(int *)row->values[0] : -1;
+    destroy_row(row);
+    return value;
+}
+
+// 事务中不能压缩表：回滚要按原下标恢复事务删除的行
+static int test_storage_engine_optimize_transaction(void) {
+    char directory[] = "/tmp/optimize_transaction_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    config_system *config = config_init(NULL);
+    if (!config) {
+        rmdir(directory);
+        return ERROR_FAIL;
+    }
+    config_set_bool(config, "storage.wal_enabled", true, "Enable write-ahead log");
+    config_set_string(config, "storage.wal_dir", directory, "Write-ahead log directory");
+
+    int engine_types[] = {STORAGE_ENGINE_ROW, STORAGE_ENGINE_COLUMN};
+    const char *table_names[] = {"optimize_row", "optimize_column"};
+
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    int result = test_assert_not_null(storage, "Failed to create storage engine manager");
+    for (int e = 0; e < 2 && result == SUCCESS; e++) {
+        storage_engine_create_table(storage, test_create_int_table(table_names[e], engine_types[e]));
+        for (int i = 0; i < 10; i++) {
+            storage_engine_insert(storage, table_names[e], test_create_int_row(i));
+        }
+
+        storage_engine_begin_transaction(storage, table_names[e]);
+        storage_engine_delete(storage, table_names[e], 2);
+        result = test_assert_true(!storage_engine_optimize(storage, table_names[e]), "Optimize succeeded inside a transaction");
+        if (result == SUCCESS) {
+            result = test_assert_true(storage_engine_rollback_transaction(storage, table_names[e]), "Rollback failed");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(10, test_count_rows(storage, table_names[e]), "Rollback row count mismatch");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(1, test_select_int(storage, table_names[e], 2), "Deleted row not restored");
+        }
+
+        // 事务结束后可以压缩
+        if (result == SUCCESS) {
+            storage_engine_delete(storage, table_names[e], 3);
+            result = test_assert_true(storage_engine_optimize(storage, table_names[e]), "Optimize failed after the transaction");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(9, test_count_rows(storage, table_names[e]), "Optimize row count mismatch");
+        }
+    }
+
+    if (storage) {
+        storage_engine_manager_destroy(storage);
+    }
+    config_destroy(config);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 未启用日志时没有撤销镜像，回滚报告失败而不是保留修改后返回成功
+static int test_storage_engine_rollback_without_wal(void) {
+    config_system *config = config_init(NULL);
+    if (!config) {
+        return ERROR_FAIL;
+    }
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    int result = test_assert_not_null(storage, "Failed to create storage engine manager");
+    if (result == SUCCESS) {
+        storage_engine_create_table(storage, test_create_int_table("rollback_row", STORAGE_ENGINE_ROW));
+        storage_engine_begin_transaction(storage, "rollback_row");
+        storage_engine_insert(storage, "rollback_row", test_create_int_row(1));
+        result = test_assert_true(!storage_engine_rollback_transaction(storage, "rollback_row"), "Rollback succeeded without a log");
+    }
+
+    if (storage) {
+        storage_engine_manager_destroy(storage);
+    }
+    config_destroy(config);
+    return result;
+}
+
+// 检查点恢复测试：检查点之后截断日志，重启时从检查点恢复，回滚和未完成事务按撤销镜像撤销
+#define CHECKPOINT_ROW_COUNT 20000
+
+static int test_storage_engine_checkpoint_recovery(void) {
+    char directory[] = "/tmp/checkpoint_recovery_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    config_system *config = config_init(NULL);
+    if (!config) {
+        rmdir(directory);
+        return ERROR_FAIL;
+    }
+    config_set_bool(config, "storage.wal_enabled", true, "Enable write-ahead log");
+    config_set_string(config, "storage.wal_dir", directory, "Write-ahead log directory");
+    config_set_int(config, "storage.wal_segment_size", 1, "Write-ahead log segment size in MB");
+    config_set_int(config, "storage.checkpoint_interval", 0, "Checkpoint interval in seconds");
+
+    StorageEngineManager *storage = storage_engine_manager_init(config);
+    int result = test_assert_not_null(storage, "Failed to create storage engine manager");
+    if (storage) {
+        storage_engine_create_table(storage, test_create_int_table("checkpoint_row", STORAGE_ENGINE_ROW));
+        storage_engine_create_table(storage, test_create_int_table("checkpoint_column", STORAGE_ENGINE_COLUMN));
+        storage_engine_create_table(storage, test_create_int_table("checkpoint_memory", STORAGE_ENGINE_MEMORY));
+        for (int i = 0; i < 100; i++) {
+            storage_engine_insert(storage, "checkpoint_row", test_create_int_row(i));
+            storage_engine_insert(storage, "checkpoint_column", test_create_int_row(i));
+        }
+
+        // 写满第一个日志段
+        Row **rows = (Row **)malloc(sizeof(Row *) * CHECKPOINT_ROW_COUNT);
+        for (int i = 0; i < CHECKPOINT_ROW_COUNT; i++) {
+            rows[i] = test_create_int_row(i);
+        }
+        storage_engine_batch_insert(storage, "checkpoint_memory", rows, CHECKPOINT_ROW_COUNT);
+        free(rows);
+
+        // 运行时回滚按日志撤销
+        storage_engine_begin_transaction(storage, "checkpoint_column");
+        storage_engine_update(storage, "checkpoint_column", 1, test_create_int_row(-1));
+        storage_engine_delete(storage, "checkpoint_column", 2);
+        storage_engine_insert(storage, "checkpoint_column", test_create_int_row(-1));
+        result = test_assert_true(storage_engine_rollback_transaction(storage, "checkpoint_column"), "Rollback failed");
+        if (result == SUCCESS) {
+            result = test_assert_equal(0, test_select_int(storage, "checkpoint_column", 1), "Update not rolled back");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(100, test_count_rows(storage, "checkpoint_column"), "Rollback row count mismatch");
+        }
+
+        // 全空值的行经过检查点快照仍是有效行
+        storage_engine_insert(storage, "checkpoint_column", create_row(1));
+
+        // 跨越检查点的未完成事务
+        storage_engine_begin_transaction(storage, "checkpoint_row");
+        storage_engine_insert(storage, "checkpoint_row", test_create_int_row(-1));
+        storage_engine_update(storage, "checkpoint_row", 3, test_create_int_row(-1));
+
+        if (result == SUCCESS) {
+            result = test_assert_true(storage_engine_manager_checkpoint(storage), "Checkpoint failed");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(wal_start_lsn(storage->wal) > 0, "Log not truncated after checkpoint");
+        }
+
+        storage_engine_delete(storage, "checkpoint_row", 4);
+        storage_engine_update(storage, "checkpoint_memory", 1, test_create_int_row(1000));
+        storage_engine_insert(storage, "checkpoint_memory", test_create_int_row(1));
+
+        // 不提交直接关闭，相当于崩溃
+        storage_engine_manager_destroy(storage);
+    }
+
+    // 两次重启结果相同：第一次撤销写入的补偿记录和回滚记录使第二次无需再撤销
+    for (int restart = 0; restart < 2 && result == SUCCESS; restart++) {
+        storage = storage_engine_manager_init(config);
+        result = test_assert_not_null(storage, "Failed to reopen storage engine manager");
+        if (result == SUCCESS) {
+            result = test_assert_equal(100, test_count_rows(storage, "checkpoint_row"), "Loser insert not undone");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(2, test_select_int(storage, "checkpoint_row", 3), "Loser update not undone");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(3, test_select_int(storage, "checkpoint_row", 4), "Loser delete not undone");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(101, test_count_rows(storage, "checkpoint_column"), "Column table not recovered");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(CHECKPOINT_ROW_COUNT + 1, test_count_rows(storage, "checkpoint_memory"), "Memory table not recovered");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(1000, test_select_int(storage, "checkpoint_memory", 1), "Update after checkpoint not recovered");
+        }
+        if (storage) {
+            storage_engine_manager_destroy(storage);
+        }
+    }
+
+    config_destroy(config);
+    test_remove_directory(directory);
+    return result;
+}
+
 // B+树索引测试
+static int test_compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
 static int test_b_plus_tree_create(void) {
-    BPlusTree *tree = b_plus_tree_create(16);
+    BPlusTree *tree = b_plus_tree_create(16, sizeof(int64_t), sizeof(void *), test_compare_int64, NULL, NULL);
     int result = test_assert_not_null(tree, "Failed to create B+ tree");
     if (tree) {
         b_plus_tree_destroy(tree);
@@ -134,6 +964,1854 @@ static int test_b_plus_tree_create(void) {
     return result;
 }
 
+static int test_b_plus_tree_fixed_keys(void) {
+    // 小节点使树有多层，按乱序插入触发各层分裂
+    BPlusTree *tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_INT64, 0, 256, NULL);
+    int result = test_assert_not_null(tree, "Failed to create int64 B+ tree");
+    const int64_t count = 10000;
+    for (int64_t i = 0; result == SUCCESS && i < count; i++) {
+        int64_t key = (i * 7919) % count;
+        result = test_assert_true(b_plus_tree_insert(tree, &key, (void *)(intptr_t)(key + 1)), "Failed to insert int64 key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(b_plus_tree_height(tree) > 2, "Fixed-key tree did not grow");
+    }
+    for (int64_t key = 0; result == SUCCESS && key < count; key += 2) {
+        result = test_assert_true(b_plus_tree_delete(tree, &key), "Failed to delete int64 key");
+    }
+    for (int64_t key = 0; result == SUCCESS && key < count; key++) {
+        void *expected = key % 2 ? (void *)(intptr_t)(key + 1) : NULL;
+        result = test_assert_true(b_plus_tree_find(tree, &key) == expected, "Wrong value for int64 key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal((int)b_plus_tree_key_count(tree), (int)(count / 2), "Wrong key count after delete");
+    }
+    if (tree) {
+        b_plus_tree_destroy(tree);
+    }
+
+    // 定长字节键按memcmp排序
+    tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_FIXED, 8, 0, NULL);
+    if (result == SUCCESS) {
+        result = test_assert_not_null(tree, "Failed to create fixed-size B+ tree");
+    }
+    if (result == SUCCESS) {
+        b_plus_tree_insert(tree, "banana!!", (void *)2);
+        b_plus_tree_insert(tree, "apple!!!", (void *)1);
+        b_plus_tree_insert(tree, "cherry!!", (void *)3);
+        result = test_assert_true(b_plus_tree_find(tree, "apple!!!") == (void *)1, "Failed to find fixed-size key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(memcmp(b_plus_tree_node_key(tree, tree->first_leaf, 2), "cherry!!", 8) == 0,
+                                  "Fixed-size keys out of order");
+    }
+    if (tree) {
+        b_plus_tree_destroy(tree);
+    }
+    return result;
+}
+
+static int test_b_plus_tree_cursor(void) {
+    BPlusTree *tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_INT64, 0, 256, NULL);
+    if (!tree) {
+        return ERROR_FAIL;
+    }
+    for (int64_t key = 0; key < 10000; key += 2) {
+        b_plus_tree_insert(tree, &key, (void *)(intptr_t)(key + 1));
+    }
+
+    // 正向和反向按批遍历[101, 3001]，范围内共有1450个偶数键
+    int result = SUCCESS;
+    int64_t start = 101;
+    int64_t end = 3001;
+    int64_t keys[64];
+    void *values[64];
+    for (int reverse = 0; reverse < 2 && result == SUCCESS; reverse++) {
+        BPlusTreeCursor *cursor = b_plus_tree_cursor_open(tree, &start, &end, reverse);
+        result = test_assert_not_null(cursor, "Failed to open B+ tree cursor");
+        int64_t expected = reverse ? 3000 : 102;
+        size_t total = 0;
+        size_t batch = 0;
+        while (result == SUCCESS && (batch = b_plus_tree_cursor_next(cursor, keys, values, 64)) > 0) {
+            for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+                result = test_assert_true(keys[i] == expected && values[i] == (void *)(intptr_t)(expected + 1),
+                                          "B+ tree cursor returned wrong key");
+                expected += reverse ? -2 : 2;
+            }
+            total += batch;
+        }
+        if (result == SUCCESS) {
+            result = test_assert_equal(1450, (int)total, "B+ tree cursor returned wrong number of keys");
+        }
+        b_plus_tree_cursor_close(cursor);
+    }
+
+    // 范围查询只在起点定位一次
+    void **range_keys = NULL;
+    void **range_values = NULL;
+    size_t count = 0;
+    if (result == SUCCESS) {
+        result = test_assert_true(b_plus_tree_range_query(tree, &start, &end, &range_keys, &range_values, &count),
+                                  "B+ tree range query failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(1450, (int)count, "B+ tree range query returned wrong number of keys");
+    }
+    free(range_keys);
+    free(range_values);
+
+    b_plus_tree_destroy(tree);
+    return result;
+}
+
+static int test_b_plus_tree_bulk_load(void) {
+    BPlusTree *tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_INT64, 0, 256, NULL);
+    int64_t *data = (int64_t *)malloc(sizeof(int64_t) * 100000);
+    void **keys = (void **)malloc(sizeof(void *) * 100000);
+    void **values = (void **)malloc(sizeof(void *) * 100000);
+    int result = test_assert_true(tree && data && keys && values, "Failed to create B+ tree");
+    for (int64_t i = 0; i < 100000 && result == SUCCESS; i++) {
+        data[i] = i * 2;
+        keys[i] = &data[i];
+        values[i] = (void *)(intptr_t)(i * 2 + 1);
+    }
+
+    if (result == SUCCESS) {
+        result = test_assert_true(b_plus_tree_bulk_load_sorted(tree, keys, values, 100000, 0.9),
+                                  "B+ tree bulk load failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(100000, (int)b_plus_tree_key_count(tree), "B+ tree bulk load lost keys");
+    }
+    for (int64_t i = 0; i < 100000 && result == SUCCESS; i++) {
+        result = test_assert_true(b_plus_tree_find(tree, &data[i]) == values[i], "Bulk loaded key not found");
+    }
+
+    // 加载后的树可以正常插入和删除
+    for (int64_t key = 1; key < 20000 && result == SUCCESS; key += 2) {
+        result = test_assert_true(b_plus_tree_insert(tree, &key, (void *)(intptr_t)(key + 1)),
+                                  "Insert after bulk load failed");
+    }
+    for (int64_t i = 0; i < 100000 && result == SUCCESS; i += 3) {
+        result = test_assert_true(b_plus_tree_delete(tree, &data[i]), "Delete after bulk load failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(100000 + 10000 - 33334, (int)b_plus_tree_key_count(tree),
+                                   "B+ tree has wrong number of keys after updates");
+    }
+
+    // 乱序且含重复键的批量插入按最后一个值生效
+    if (tree) {
+        b_plus_tree_destroy(tree);
+    }
+    tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_INT64, 0, 256, NULL);
+    for (int64_t i = 0; i < 100000 && result == SUCCESS; i++) {
+        data[i] = (i * 7919) % 50000;
+        values[i] = (void *)(intptr_t)i;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(tree && b_plus_tree_insert_batch(tree, keys, values, 100000),
+                                  "B+ tree batch insert failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(50000, (int)b_plus_tree_key_count(tree), "B+ tree batch insert lost keys");
+    }
+    for (int64_t i = 50000; i < 100000 && result == SUCCESS; i++) {
+        result = test_assert_true(b_plus_tree_find(tree, &data[i]) == values[i],
+                                  "B+ tree batch insert kept an older value");
+    }
+
+    if (tree) {
+        b_plus_tree_destroy(tree);
+    }
+    free(data);
+    free(keys);
+    free(values);
+    return result;
+}
+
+// 共享长前缀的URL键
+static void b_plus_tree_url_key(BPlusTreeKey *key, int64_t id) {
+    key->length = (uint16_t)snprintf((char *)key->data, sizeof(key->data), "https://www.example.com/catalog/item/%06lld",
+                                     (long long)id);
+}
+
+static int test_b_plus_tree_variable_keys(void) {
+    BPlusTree *tree = b_plus_tree_create_variable(128, 4096, NULL);
+    if (!tree) {
+        return ERROR_FAIL;
+    }
+
+    int result = SUCCESS;
+    BPlusTreeKey key;
+    for (int64_t i = 0; i < 20000 && result == SUCCESS; i++) {
+        int64_t id = (i * 7919) % 20000;
+        b_plus_tree_url_key(&key, id);
+        result = test_assert_true(b_plus_tree_insert(tree, &key, (void *)(intptr_t)(id + 1)),
+                                  "Failed to insert variable-length key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(20000, (int)b_plus_tree_key_count(tree), "B+ tree lost variable-length keys");
+    }
+    for (int64_t id = 0; id < 20000 && result == SUCCESS; id++) {
+        b_plus_tree_url_key(&key, id);
+        result = test_assert_true(b_plus_tree_find(tree, &key) == (void *)(intptr_t)(id + 1),
+                                  "Variable-length key not found");
+    }
+    if (result == SUCCESS) {
+        // 键的前缀不能匹配更长的键
+        key.length = 30;
+        result = test_assert_true(b_plus_tree_find(tree, &key) == NULL, "Key prefix matched a longer key");
+    }
+
+    // 删除偶数键后游标按字节顺序返回完整的奇数键
+    for (int64_t id = 0; id < 20000 && result == SUCCESS; id += 2) {
+        b_plus_tree_url_key(&key, id);
+        result = test_assert_true(b_plus_tree_delete(tree, &key), "Failed to delete variable-length key");
+    }
+    BPlusTreeCursor *cursor = result == SUCCESS ? b_plus_tree_cursor_open(tree, NULL, NULL, false) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(cursor, "Failed to open B+ tree cursor");
+    }
+    size_t stride = tree->key_stride;
+    uint8_t *keys = (uint8_t *)malloc(stride * 32);
+    void *values[32];
+    int64_t expected = 1;
+    size_t batch = 0;
+    while (result == SUCCESS && keys && (batch = b_plus_tree_cursor_next(cursor, keys, values, 32)) > 0) {
+        for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+            const BPlusTreeKey *found = (const BPlusTreeKey *)(keys + i * stride);
+            b_plus_tree_url_key(&key, expected);
+            result = test_assert_true(found->length == key.length && memcmp(found->data, key.data, key.length) == 0 &&
+                                      values[i] == (void *)(intptr_t)(expected + 1),
+                                      "B+ tree cursor returned wrong variable-length key");
+            expected += 2;
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(20001, (int)expected, "B+ tree cursor missed variable-length keys");
+    }
+    b_plus_tree_cursor_close(cursor);
+    free(keys);
+    b_plus_tree_destroy(tree);
+
+    // 规范化的(int64, 字符串)复合键按列依次比较：负数排在正数之前，"a" < "a\0" < "b"
+    tree = b_plus_tree_create_variable(64, 0, NULL);
+    if (!tree) {
+        return ERROR_FAIL;
+    }
+    const char *strings[] = {"b", "a\0", "a"};
+    const size_t lengths[] = {1, 2, 1};
+    for (int64_t i = 99; i >= -100 && result == SUCCESS; i--) {
+        for (int s = 0; s < 3 && result == SUCCESS; s++) {
+            b_plus_tree_key_init(&key);
+            b_plus_tree_key_append_int64(&key, i);
+            b_plus_tree_key_append_string(&key, strings[s], lengths[s]);
+            result = test_assert_true(b_plus_tree_insert(tree, &key, (void *)(intptr_t)((i + 100) * 3 + (2 - s) + 1)),
+                                      "Failed to insert normalized key");
+        }
+    }
+    cursor = result == SUCCESS ? b_plus_tree_cursor_open(tree, NULL, NULL, false) : NULL;
+    expected = 1;
+    while (result == SUCCESS && cursor && (batch = b_plus_tree_cursor_next(cursor, NULL, values, 32)) > 0) {
+        for (size_t i = 0; i < batch && result == SUCCESS; i++) {
+            result = test_assert_true(values[i] == (void *)(intptr_t)expected++, "Normalized keys are out of order");
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(601, (int)expected, "Normalized keys collided");
+    }
+    b_plus_tree_cursor_close(cursor);
+    b_plus_tree_destroy(tree);
+    return result;
+}
+
+// 磁盘B+树测试：子进程写入后不关闭直接退出，重新打开时按日志恢复
+#define DISK_TREE_KEY_COUNT 6000
+#define DISK_TREE_CHECKPOINT_KEYS 5000
+
+static DiskBPlusTree *test_disk_b_plus_tree_open(const char *directory, WriteAheadLog **wal) {
+    WalConfig wal_config = {directory, 1024 * 1024, 4 * 1024 * 1024, 0};
+    *wal = wal_open(&wal_config);
+    if (!*wal) {
+        return NULL;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/index.db", directory);
+    // 小页面和少量帧，让写操作期间不断淘汰和写回页面
+    DiskBPlusTreeConfig config = {path, "test_index", BPLUS_TREE_KEY_INT64, 0, 512, 64, *wal};
+    DiskBPlusTree *tree = disk_b_plus_tree_open(&config);
+    if (!tree) {
+        wal_close(*wal);
+        *wal = NULL;
+    }
+    return tree;
+}
+
+static bool test_disk_b_plus_tree_count(const void *key, uint64_t value, void *arg) {
+    int64_t k;
+    memcpy(&k, key, sizeof(k));
+    int64_t *state = (int64_t *)arg;
+    // state[0]为上一个键，state[1]为扫描到的键数，state[2]为错误数
+    state[2] += k <= state[0] || value != (uint64_t)k + 1;
+    state[0] = k;
+    state[1]++;
+    return true;
+}
+
+static int test_disk_b_plus_tree_verify(DiskBPlusTree *tree) {
+    int result = SUCCESS;
+    for (int64_t key = 0; key < DISK_TREE_KEY_COUNT && result == SUCCESS; key++) {
+        uint64_t value = 0;
+        bool expected = key >= DISK_TREE_CHECKPOINT_KEYS || key % 3 != 0;
+        bool found = disk_b_plus_tree_find(tree, &key, &value);
+        result = test_assert_true(found == expected && (!found || value == (uint64_t)key + 1),
+                                  "Disk B+ tree lost or kept a key after reopen");
+    }
+
+    int64_t start = 100;
+    int64_t end = 199;
+    int64_t state[3] = {-1, 0, 0};
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_b_plus_tree_scan(tree, &start, &end, test_disk_b_plus_tree_count, state) &&
+                                  state[1] == 67 && state[2] == 0, "Disk B+ tree range scan is wrong");
+    }
+    return result;
+}
+
+static int test_disk_b_plus_tree_persistence(void) {
+    char directory[] = "/tmp/disk_b_plus_tree_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    // 子进程：检查点之前插入并删除部分键，检查点之后继续插入，持久化日志后模拟崩溃
+    pid_t pid = fork();
+    if (pid == 0) {
+        WriteAheadLog *wal = NULL;
+        DiskBPlusTree *tree = test_disk_b_plus_tree_open(directory, &wal);
+        bool success = tree != NULL;
+        for (int64_t i = 0; i < DISK_TREE_CHECKPOINT_KEYS && success; i++) {
+            int64_t key = (i * 7919) % DISK_TREE_CHECKPOINT_KEYS;
+            success = disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1);
+        }
+        for (int64_t key = 0; key < DISK_TREE_CHECKPOINT_KEYS && success; key += 3) {
+            success = disk_b_plus_tree_delete(tree, &key);
+        }
+        success = success && disk_b_plus_tree_checkpoint(tree);
+        for (int64_t key = DISK_TREE_KEY_COUNT - 1; key >= DISK_TREE_CHECKPOINT_KEYS && success; key--) {
+            success = disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1);
+        }
+        success = success && wal_flush(wal, wal_current_lsn(wal));
+        _exit(success ? 0 : 1);
+    }
+
+    int status = -1;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    int result = test_assert_true(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                                  "Disk B+ tree writer process failed");
+
+    // 从检查点恢复
+    WriteAheadLog *wal = NULL;
+    DiskBPlusTree *tree = result == SUCCESS ? test_disk_b_plus_tree_open(directory, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(tree, "Failed to recover disk B+ tree");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_b_plus_tree_height(tree) > 1, "Disk B+ tree did not split");
+    }
+    if (result == SUCCESS) {
+        result = test_disk_b_plus_tree_verify(tree);
+    }
+
+    // 正常关闭后重新打开
+    disk_b_plus_tree_close(tree);
+    wal_close(wal);
+    wal = NULL;
+    tree = result == SUCCESS ? test_disk_b_plus_tree_open(directory, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(tree, "Failed to reopen disk B+ tree");
+    }
+    if (result == SUCCESS) {
+        result = test_disk_b_plus_tree_verify(tree);
+    }
+
+    // 删除全部键后合并回单个叶子节点
+    for (int64_t key = 0; key < DISK_TREE_KEY_COUNT && result == SUCCESS; key++) {
+        bool expected = key >= DISK_TREE_CHECKPOINT_KEYS || key % 3 != 0;
+        result = test_assert_true(disk_b_plus_tree_delete(tree, &key) == expected, "Failed to delete disk B+ tree key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(1, (int)disk_b_plus_tree_height(tree), "Disk B+ tree did not shrink");
+    }
+    disk_b_plus_tree_close(tree);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 日志写入失败后磁盘B+树只读，没有日志的页面不写回，重新打开时恢复到失败之前的内容
+static int test_disk_b_plus_tree_log_failure(void) {
+    char directory[] = "/tmp/disk_b_plus_tree_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    WriteAheadLog *wal = NULL;
+    DiskBPlusTree *tree = test_disk_b_plus_tree_open(directory, &wal);
+    int result = test_assert_not_null(tree, "Failed to open disk B+ tree");
+    for (int64_t key = 0; key < DISK_TREE_CHECKPOINT_KEYS && result == SUCCESS; key++) {
+        result = test_assert_true(disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1), "Failed to insert disk B+ tree key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(wal_flush(wal, wal_current_lsn(wal)), "Failed to flush WAL");
+    }
+
+    // 段文件换成只读的文件描述符后日志写盘失败，之后的写操作都不能记录日志
+    int fd = open("/dev/null", O_RDONLY);
+    if (result == SUCCESS) {
+        result = test_assert_true(fd >= 0 && dup2(fd, wal->segment_fd) >= 0, "Failed to replace WAL segment");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(!wal_commit(wal, 1), "WAL commit succeeded after a write error");
+    }
+    int64_t key = DISK_TREE_CHECKPOINT_KEYS;
+    if (result == SUCCESS) {
+        result = test_assert_true(!disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1), "Disk B+ tree accepted a write without a log");
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    disk_b_plus_tree_close(tree);
+    wal_close(wal);
+
+    wal = NULL;
+    tree = result == SUCCESS ? test_disk_b_plus_tree_open(directory, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(tree, "Failed to recover disk B+ tree");
+    }
+    for (key = 0; key < DISK_TREE_CHECKPOINT_KEYS && result == SUCCESS; key++) {
+        uint64_t value = 0;
+        result = test_assert_true(disk_b_plus_tree_find(tree, &key, &value) && value == (uint64_t)key + 1,
+                                  "Disk B+ tree lost a logged key");
+    }
+    if (result == SUCCESS) {
+        key = DISK_TREE_CHECKPOINT_KEYS;
+        result = test_assert_true(!disk_b_plus_tree_find(tree, &key, NULL), "Disk B+ tree kept an unlogged key");
+    }
+    disk_b_plus_tree_close(tree);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 与其他模块共用日志时，其他模块的检查点截断日志不会删除磁盘B+树重做需要的记录
+static DiskBPlusTree *test_disk_b_plus_tree_open_shared(const char *directory, WriteAheadLog **wal) {
+    // 小段文件，检查点之后的修改跨越多个段
+    WalConfig wal_config = {directory, 1024 * 1024, 64 * 1024, 0};
+    *wal = wal_open(&wal_config);
+    if (!*wal) {
+        return NULL;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/index.db", directory);
+    DiskBPlusTreeConfig config = {path, "shared_index", BPLUS_TREE_KEY_INT64, 0, 512, 64, *wal};
+    DiskBPlusTree *tree = disk_b_plus_tree_open(&config);
+    if (!tree) {
+        wal_close(*wal);
+        *wal = NULL;
+    }
+    return tree;
+}
+
+static int test_disk_b_plus_tree_shared_wal(void) {
+    char directory[] = "/tmp/disk_b_plus_tree_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    // 子进程：索引检查点之后继续写入，按日志末尾截断后模拟崩溃
+    pid_t pid = fork();
+    if (pid == 0) {
+        WriteAheadLog *wal = NULL;
+        DiskBPlusTree *tree = test_disk_b_plus_tree_open_shared(directory, &wal);
+        bool success = tree != NULL;
+        for (int64_t key = 0; key < DISK_TREE_CHECKPOINT_KEYS && success; key++) {
+            success = disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1);
+        }
+        success = success && disk_b_plus_tree_checkpoint(tree);
+        for (int64_t key = DISK_TREE_CHECKPOINT_KEYS; key < DISK_TREE_KEY_COUNT && success; key++) {
+            success = disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1);
+        }
+        success = success && wal_flush(wal, wal_current_lsn(wal));
+        if (success) {
+            wal_truncate(wal, wal_current_lsn(wal));
+            success = wal_start_lsn(wal) <= disk_b_plus_tree_checkpoint_lsn(tree);
+        }
+        _exit(success ? 0 : 1);
+    }
+
+    int status = -1;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    int result = test_assert_true(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                                  "Disk B+ tree writer process failed");
+
+    WriteAheadLog *wal = NULL;
+    DiskBPlusTree *tree = result == SUCCESS ? test_disk_b_plus_tree_open_shared(directory, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(tree, "Failed to recover disk B+ tree after WAL truncation");
+    }
+    for (int64_t key = 0; key < DISK_TREE_KEY_COUNT && result == SUCCESS; key++) {
+        uint64_t value = 0;
+        result = test_assert_true(disk_b_plus_tree_find(tree, &key, &value) && value == (uint64_t)key + 1,
+                                  "Disk B+ tree lost a key after WAL truncation");
+    }
+
+    // 索引检查点推进保留点之后，截断可以删除旧的段
+    uint64_t start_lsn = wal_start_lsn(wal);
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_b_plus_tree_checkpoint(tree), "Failed to checkpoint disk B+ tree");
+    }
+    if (result == SUCCESS) {
+        int64_t key = DISK_TREE_KEY_COUNT;
+        result = test_assert_true(disk_b_plus_tree_insert(tree, &key, (uint64_t)key + 1) &&
+                                  wal_flush(wal, wal_current_lsn(wal)), "Failed to insert disk B+ tree key");
+    }
+    if (result == SUCCESS) {
+        wal_truncate(wal, wal_current_lsn(wal));
+        result = test_assert_true(wal_start_lsn(wal) > start_lsn, "WAL was not truncated after the index checkpoint");
+    }
+    disk_b_plus_tree_close(tree);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// LSM树内存表测试：同一个键的新版本覆盖旧版本，查找返回最新版本
+#define LSM_TEST_KEY_COUNT 20000
+
+static int test_lsm_tree_memtable(void) {
+    char directory[] = "/tmp/lsm_tree_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+
+    char key[32];
+    char value[32];
+    for (int round = 0; round < 2 && result == SUCCESS; round++) {
+        for (int i = 0; i < LSM_TEST_KEY_COUNT && result == SUCCESS; i++) {
+            int id = (i * 7919) % LSM_TEST_KEY_COUNT;
+            if (round == 1 && id % 2 != 0) {
+                continue;
+            }
+            int key_size = snprintf(key, sizeof(key), "key%05d", id);
+            int value_size = snprintf(value, sizeof(value), "value%d-%d", id, round);
+            result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(LSM_TEST_KEY_COUNT + LSM_TEST_KEY_COUNT / 2, (int)tree->active_memtable->entry_count,
+                                   "LSM memtable lost a version");
+    }
+
+    for (int id = 0; id < LSM_TEST_KEY_COUNT && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "value%d-%d", id, id % 2 == 0);
+        uint32_t found_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &found_size);
+        result = test_assert_true(found && found_size == (uint32_t)value_size && memcmp(found, value, value_size) == 0,
+                                  "LSM lookup did not return the newest version");
+        free(found);
+    }
+    if (result == SUCCESS) {
+        uint32_t found_size = 0;
+        result = test_assert_true(lsm_tree_get(tree, "key0000", 7, &found_size) == NULL, "LSM key prefix matched a longer key");
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+// SSTable测试：刷写后超过1MB的文件中每个键都能通过索引块找到
+static int test_lsm_tree_sstable(void) {
+    char directory[] = "/tmp/lsm_sstable_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+
+    char key[32];
+    char value[128];
+    for (int i = 0; i < LSM_TEST_KEY_COUNT && result == SUCCESS; i++) {
+        int id = (i * 7919) % LSM_TEST_KEY_COUNT;
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%0100d", id);
+        result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_flush(tree) && tree->sstable_counts[0] == 1 &&
+                                  tree->active_memtable->entry_count == 0, "Failed to flush LSM memtable");
+    }
+    if (result == SUCCESS) {
+        lsm_sstable_meta *meta = tree->sstables[0][0];
+        sstable_reader *reader = sstable_reader_open(meta->filename, meta->file_number, NULL);
+        // 数据块默认压缩，文件比值的总大小小
+        result = test_assert_true(reader && reader->size < LSM_TEST_KEY_COUNT * 100 && reader->entry_count == LSM_TEST_KEY_COUNT &&
+                                  memcmp(reader->smallest_key, "key00000", 8) == 0 &&
+                                  memcmp(reader->largest_key, "key19999", 8) == 0, "SSTable metadata is wrong");
+        sstable_reader_close(reader);
+    }
+
+    for (int id = 0; id < LSM_TEST_KEY_COUNT && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%0100d", id);
+        uint32_t found_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &found_size);
+        result = test_assert_true(found && found_size == (uint32_t)value_size && memcmp(found, value, value_size) == 0,
+                                  "SSTable lookup failed");
+        free(found);
+    }
+    if (result == SUCCESS) {
+        uint32_t found_size = 0;
+        result = test_assert_true(lsm_tree_get(tree, "key20000", 8, &found_size) == NULL &&
+                                  lsm_tree_get(tree, "key", 3, &found_size) == NULL, "SSTable found a missing key");
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+static int test_lsm_tree_compaction(void) {
+    char directory[] = "/tmp/lsm_compaction_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+
+    // 每轮覆盖一部分键并删除一部分键，第LSM_L0_COMPACTION_TRIGGER次刷写后后台把第0层压缩到第1层
+    char key[32];
+    char value[128];
+    for (int round = 0; round < LSM_L0_COMPACTION_TRIGGER && result == SUCCESS; round++) {
+        for (int id = round * 1000; id < LSM_TEST_KEY_COUNT && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "key%05d", id);
+            int value_size = snprintf(value, sizeof(value), "%d-%0100d", round, id);
+            if (round > 0 && id % 10 == round) {
+                result = test_assert_true(lsm_tree_delete(tree, key, key_size), "Failed to delete LSM key");
+            } else {
+                result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+            }
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree), "Failed to flush LSM memtable");
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_compact(tree) && tree->sstable_counts[0] == 0 && tree->sstable_counts[1] > 0,
+                                  "Level 0 was not compacted");
+    }
+
+    // 第1层的文件按键排序且互不重叠，压缩后不再保留旧版本和墓碑
+    uint64_t entries = 0;
+    for (uint32_t i = 0; i < tree->sstable_counts[1] && result == SUCCESS; i++) {
+        lsm_sstable_meta *meta = tree->sstables[1][i];
+        entries += meta->entry_count;
+        if (i > 0) {
+            lsm_sstable_meta *previous = tree->sstables[1][i - 1];
+            result = test_assert_true(sstable_compare_keys(previous->max_key, previous->max_key_size,
+                                                           meta->min_key, meta->min_key_size) < 0,
+                                      "Level 1 files overlap");
+        }
+    }
+
+    int live_keys = 0;
+    for (int id = 0; id < LSM_TEST_KEY_COUNT && result == SUCCESS; id++) {
+        // 最后一次写入该键的轮次
+        int round = id / 1000 < LSM_L0_COMPACTION_TRIGGER - 1 ? id / 1000 : LSM_L0_COMPACTION_TRIGGER - 1;
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%d-%0100d", round, id);
+        uint32_t found_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &found_size);
+        if (round > 0 && id % 10 == round) {
+            result = test_assert_true(found == NULL, "Compaction kept a deleted key");
+        } else {
+            live_keys++;
+            result = test_assert_true(found && found_size == (uint32_t)value_size && memcmp(found, value, value_size) == 0,
+                                      "Compacted lookup returned a stale value");
+        }
+        free(found);
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(live_keys, (int)entries, "Compaction kept shadowed versions");
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 合并操作：把操作数追加到已有值之后
+static char *lsm_tree_append_operator(const char *key, uint32_t key_size, const char *existing, uint32_t existing_size,
+                                      const char *operand, uint32_t operand_size, uint32_t *result_size, void *arg) {
+    (void)key;
+    (void)key_size;
+    (void)arg;
+    uint32_t size = existing ? existing_size : 0;
+    char *result = (char *)malloc(size + operand_size + 1);
+    if (result) {
+        if (existing) {
+            memcpy(result, existing, existing_size);
+        }
+        memcpy(result + size, operand, operand_size);
+        *result_size = size + operand_size;
+    }
+    return result;
+}
+
+static int lsm_tree_expect_value(lsm_tree *tree, const lsm_snapshot *snapshot, const char *key, const char *expected) {
+    uint32_t found_size = 0;
+    char *found = lsm_tree_snapshot_get(tree, snapshot, key, (uint32_t)strlen(key), &found_size);
+    int result = expected ? test_assert_true(found && found_size == strlen(expected) && memcmp(found, expected, found_size) == 0,
+                                             "LSM lookup returned a wrong version")
+                          : test_assert_true(found == NULL, "LSM lookup returned a deleted key");
+    free(found);
+    return result;
+}
+
+// LSM树快照测试：删除和覆盖对快照不可见，第0层从新到旧查找，压缩在快照释放后丢弃旧版本和删除标记
+static int test_lsm_tree_snapshots(void) {
+    char directory[] = "/tmp/lsm_snapshot_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+    if (result != SUCCESS) {
+        test_remove_directory(directory);
+        return result;
+    }
+
+    result = test_assert_true(!lsm_tree_merge(tree, "c", 1, "x", 1), "LSM merge succeeded without a merge operator");
+    lsm_tree_set_merge_operator(tree, lsm_tree_append_operator, NULL);
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_insert(tree, "a", 1, "1", 1) && lsm_tree_insert(tree, "b", 1, "1", 1) &&
+                                  lsm_tree_merge(tree, "c", 1, "x", 1), "Failed to write LSM keys");
+    }
+    lsm_snapshot *snapshot = lsm_tree_create_snapshot(tree);
+    if (result == SUCCESS) {
+        result = test_assert_true(snapshot && lsm_tree_insert(tree, "a", 1, "2", 1) && lsm_tree_delete(tree, "b", 1) &&
+                                  lsm_tree_merge(tree, "c", 1, "y", 1), "Failed to write LSM keys");
+    }
+
+    // 每轮覆盖a后刷写，第0层中较新的文件覆盖较旧的文件
+    char value[32];
+    for (int round = 0; round < LSM_L0_COMPACTION_TRIGGER && result == SUCCESS; round++) {
+        snprintf(value, sizeof(value), "a%d", round);
+        result = test_assert_true(lsm_tree_insert(tree, "a", 1, value, (uint32_t)strlen(value)) && lsm_tree_flush(tree),
+                                  "Failed to flush LSM memtable");
+        if (result == SUCCESS) {
+            result = lsm_tree_expect_value(tree, NULL, "a", value);
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_compact(tree) && tree->sstable_counts[0] == 0, "Level 0 was not compacted");
+    }
+    const char *expected[][3] = {{"a", "1", value}, {"b", "1", NULL}, {"c", "x", "xy"}};
+    for (int i = 0; i < 3 && result == SUCCESS; i++) {
+        result = lsm_tree_expect_value(tree, snapshot, expected[i][0], expected[i][1]);
+        if (result == SUCCESS) {
+            result = lsm_tree_expect_value(tree, NULL, expected[i][0], expected[i][2]);
+        }
+    }
+    lsm_tree_release_snapshot(tree, snapshot);
+
+    // 释放快照后再次压缩：a只剩最新版本，b的旧版本和删除标记都被丢弃，合并操作数保留
+    for (int round = 0; round < LSM_L0_COMPACTION_TRIGGER && result == SUCCESS; round++) {
+        char key[8];
+        snprintf(key, sizeof(key), "e%d", round);
+        snprintf(value, sizeof(value), "b%d", round);
+        result = test_assert_true(lsm_tree_insert(tree, "a", 1, value, (uint32_t)strlen(value)) &&
+                                  lsm_tree_insert(tree, key, (uint32_t)strlen(key), value, (uint32_t)strlen(value)) &&
+                                  lsm_tree_flush(tree), "Failed to flush LSM memtable");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_compact(tree) && tree->sstable_counts[0] == 0, "Level 0 was not compacted");
+    }
+    uint64_t entries = 0;
+    for (uint32_t i = 0; i < tree->sstable_counts[1]; i++) {
+        entries += tree->sstables[1][i]->entry_count;
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(1 + 2 + LSM_L0_COMPACTION_TRIGGER, (int)entries, "Compaction kept garbage versions");
+    }
+    if (result == SUCCESS) {
+        result = lsm_tree_expect_value(tree, NULL, "a", value);
+    }
+    if (result == SUCCESS) {
+        result = lsm_tree_expect_value(tree, NULL, "b", NULL);
+    }
+    if (result == SUCCESS) {
+        result = lsm_tree_expect_value(tree, NULL, "c", "xy");
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+// LSM树迭代器测试：合并内存表、第0层和第1层，按范围和前缀扫描，迭代器看到的是创建时的状态
+#define LSM_ITERATOR_KEY_COUNT 3000
+
+static int lsm_tree_scan(lsm_iterator *iterator, const int *versions, int first, int last, const char *what) {
+    char key[32];
+    char value[32];
+    int result = test_assert_not_null(iterator, "Failed to create LSM iterator");
+    for (int id = first; id < last && result == SUCCESS; id++) {
+        if (versions[id] < 0) {
+            continue;
+        }
+        int key_size = snprintf(key, sizeof(key), "evt%06d", id);
+        int value_size = snprintf(value, sizeof(value), "%d-%d", id, versions[id]);
+        result = test_assert_true(iterator->valid && iterator->key_size == (uint32_t)key_size &&
+                                  memcmp(iterator->key, key, key_size) == 0 && iterator->value_size == (uint32_t)value_size &&
+                                  memcmp(iterator->value, value, value_size) == 0, what);
+        lsm_iterator_next(iterator);
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(!iterator->valid && !iterator->failed, what);
+    }
+    return result;
+}
+
+static int test_lsm_tree_iterator(void) {
+    char directory[] = "/tmp/lsm_iterator_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+    if (result != SUCCESS) {
+        test_remove_directory(directory);
+        return result;
+    }
+
+    // 第0-3轮压缩到第1层，第4轮留在第0层，第5轮的删除和覆盖留在内存表
+    static int versions[LSM_ITERATOR_KEY_COUNT];
+    char key[32];
+    char value[32];
+    for (int round = 0; round < 6 && result == SUCCESS; round++) {
+        for (int id = 0; id < LSM_ITERATOR_KEY_COUNT && result == SUCCESS; id++) {
+            bool write = round == 0 || (round < 4 && id % 4 == round) || (round == 4 && id % 3 == 0) || (round == 5 && id % 7 == 0);
+            int key_size = snprintf(key, sizeof(key), "evt%06d", id);
+            if (round == 5 && id % 5 == 0) {
+                result = test_assert_true(lsm_tree_delete(tree, key, key_size), "Failed to delete LSM key");
+                versions[id] = -1;
+            }
+            if (write && result == SUCCESS) {
+                int value_size = snprintf(value, sizeof(value), "%d-%d", id, round);
+                result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+                versions[id] = round;
+            }
+        }
+        if (round < 5 && result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree), "Failed to flush LSM memtable");
+        }
+        if (round == 3 && result == SUCCESS) {
+            result = test_assert_true(lsm_tree_compact(tree) && tree->sstable_counts[1] > 0, "Level 0 was not compacted");
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(tree->sstable_counts[0] == 1 && tree->active_memtable->entry_count > 0,
+                                  "LSM data is not spread over memtable and levels");
+    }
+
+    lsm_iterator *iterator = NULL;
+    if (result == SUCCESS) {
+        iterator = lsm_tree_iterator_create(tree, NULL, NULL, 0, NULL, 0);
+        lsm_iterator_seek_first(iterator);
+        result = lsm_tree_scan(iterator, versions, 0, LSM_ITERATOR_KEY_COUNT, "Full LSM scan is wrong");
+        lsm_iterator_destroy(iterator);
+    }
+    if (result == SUCCESS) {
+        iterator = lsm_tree_iterator_create(tree, NULL, "evt001000", 9, "evt002000", 9);
+        lsm_iterator_seek_first(iterator);
+        result = lsm_tree_scan(iterator, versions, 1000, 2000, "Bounded LSM scan is wrong");
+        lsm_iterator_destroy(iterator);
+    }
+    if (result == SUCCESS) {
+        iterator = lsm_tree_prefix_iterator_create(tree, NULL, "evt0012", 7);
+        lsm_iterator_seek(iterator, "evt001250x", 10);
+        result = lsm_tree_scan(iterator, versions, 1251, 1300, "Prefix LSM scan is wrong");
+        lsm_iterator_destroy(iterator);
+    }
+
+    // 迭代器创建后的覆盖、刷写和压缩对它不可见
+    if (result == SUCCESS) {
+        iterator = lsm_tree_iterator_create(tree, NULL, NULL, 0, NULL, 0);
+        result = test_assert_not_null(iterator, "Failed to create LSM iterator");
+    }
+    for (int round = 0; round < LSM_L0_COMPACTION_TRIGGER && result == SUCCESS; round++) {
+        for (int id = 0; id < LSM_ITERATOR_KEY_COUNT && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "evt%06d", id);
+            result = test_assert_true(lsm_tree_insert(tree, key, key_size, "new", 3), "Failed to insert LSM key");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree), "Failed to flush LSM memtable");
+        }
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_compact(tree), "Failed to compact LSM tree");
+    }
+    if (result == SUCCESS) {
+        lsm_iterator_seek_first(iterator);
+        result = lsm_tree_scan(iterator, versions, 0, LSM_ITERATOR_KEY_COUNT, "LSM iterator saw later writes");
+    }
+    lsm_iterator_destroy(iterator);
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+static int lsm_tree_check_keys(lsm_tree *tree, int count) {
+    char key[32];
+    char value[128];
+    int result = SUCCESS;
+    for (int id = 0; id < count && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%0100d", id);
+        uint32_t found_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &found_size);
+        result = test_assert_true(found && found_size == (uint32_t)value_size && memcmp(found, value, value_size) == 0,
+                                  "Recovered LSM lookup failed");
+        free(found);
+    }
+    return result;
+}
+
+#define LSM_BLOOM_KEY_COUNT 10000
+
+// 只写入偶数编号的键，奇数编号的键用来统计假阳性率
+static int test_lsm_tree_bloom_filters(void) {
+    int result = SUCCESS;
+    for (int partitioned = 0; partitioned < 2 && result == SUCCESS; partitioned++) {
+        char directory[] = "/tmp/lsm_bloom_XXXXXX";
+        if (!mkdtemp(directory)) {
+            return ERROR_FAIL;
+        }
+        lsm_tree_config config;
+        memset(&config, 0, sizeof(config));
+        config.bloom_bits_per_key = 10;
+        config.partitioned_filters = partitioned;
+        lsm_tree *tree = lsm_tree_create_with_config(directory, &config);
+        result = test_assert_not_null(tree, "Failed to create LSM tree");
+        if (result != SUCCESS) {
+            test_remove_directory(directory);
+            return result;
+        }
+
+        char key[32];
+        for (int id = 0; id < LSM_BLOOM_KEY_COUNT * 2 && result == SUCCESS; id += 2) {
+            int key_size = snprintf(key, sizeof(key), "blm%07d", id);
+            result = test_assert_true(lsm_tree_insert(tree, key, key_size, key, key_size), "Failed to insert LSM key");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree) && tree->sstable_counts[0] == 1, "Failed to flush LSM memtable");
+        }
+
+        sstable_reader *reader = NULL;
+        if (result == SUCCESS) {
+            lsm_sstable_meta *meta = tree->sstables[0][0];
+            reader = sstable_reader_open(meta->filename, meta->file_number, NULL);
+            result = test_assert_not_null(reader, "Failed to open SSTable");
+        }
+        if (result == SUCCESS && partitioned) {
+            result = test_assert_true(reader->filter_partition_count > 1, "SSTable filter should be partitioned");
+        }
+        int false_positives = 0;
+        for (int id = 0; id < LSM_BLOOM_KEY_COUNT * 2 && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "blm%07d", id);
+            bool contains = sstable_reader_may_contain(reader, key, key_size);
+            if (id % 2 == 0) {
+                result = test_assert_true(contains, "SSTable filter has a false negative");
+            } else if (contains) {
+                false_positives++;
+            }
+        }
+        if (result == SUCCESS) {
+            // 每键10位时理论假阳性率约1%
+            result = test_assert_true(false_positives < LSM_BLOOM_KEY_COUNT * 3 / 100, "SSTable filter false positive rate too high");
+        }
+
+        sstable_reader_close(reader);
+
+        for (int id = 0; id < 200 && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "blm%07d", id);
+            uint32_t value_size = 0;
+            char *value = lsm_tree_get(tree, key, key_size, &value_size);
+            if (id % 2 == 0) {
+                result = test_assert_true(value && value_size == (uint32_t)key_size && memcmp(value, key, value_size) == 0,
+                                          "LSM lookup returned wrong value");
+            } else {
+                result = test_assert_true(value == NULL, "LSM lookup found absent key");
+            }
+            free(value);
+        }
+
+        lsm_tree_destroy(tree);
+        test_remove_directory(directory);
+    }
+    return result;
+}
+
+// 分块布隆过滤器：按目标假阳性率确定每个键的位数，没有假阴性，实测假阳性率不超过目标的两倍
+static int test_blocked_bloom_filter(void) {
+    int result = SUCCESS;
+    double rates[] = {0.05, 0.01, 0.001};
+    char key[32];
+    for (int r = 0; r < 3 && result == SUCCESS; r++) {
+        uint32_t bits_per_key = blocked_bloom_filter_bits_per_key(rates[r]);
+        blocked_bloom_filter *filter = blocked_bloom_filter_create(LSM_BLOOM_KEY_COUNT * 10, bits_per_key);
+        result = test_assert_not_null(filter, "Failed to create blocked bloom filter");
+        for (int id = 0; id < LSM_BLOOM_KEY_COUNT * 10 && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "bbf%07d", id);
+            result = test_assert_true(blocked_bloom_filter_add(filter, key, key_size), "Failed to add blocked bloom filter key");
+        }
+        for (int id = 0; id < LSM_BLOOM_KEY_COUNT * 10 && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "bbf%07d", id);
+            result = test_assert_true(blocked_bloom_filter_contains(filter, key, key_size), "Blocked bloom filter has a false negative");
+        }
+        int false_positives = 0;
+        for (int id = 0; id < LSM_BLOOM_KEY_COUNT * 10 && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "bbx%07d", id);
+            false_positives += blocked_bloom_filter_contains(filter, key, key_size);
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(false_positives < LSM_BLOOM_KEY_COUNT * 10 * rates[r] * 2,
+                                      "Blocked bloom filter false positive rate too high");
+        }
+        blocked_bloom_filter_destroy(filter);
+    }
+    return result;
+}
+
+// 三个第0层文件、最多同时打开两个文件；热点键第一次读取后从块缓存读取
+static int test_lsm_tree_caches(void) {
+    char directory[] = "/tmp/lsm_cache_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree_config config;
+    memset(&config, 0, sizeof(config));
+    config.block_cache_size = 1024 * 1024;
+    config.max_open_files = 2;
+    lsm_tree *tree = lsm_tree_create_with_config(directory, &config);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+    if (result != SUCCESS) {
+        test_remove_directory(directory);
+        return result;
+    }
+
+    char key[32];
+    char value[64];
+    for (int file = 0; file < 3 && result == SUCCESS; file++) {
+        for (int id = file; id < 6000 && result == SUCCESS; id += 3) {
+            int key_size = snprintf(key, sizeof(key), "cch%06d", id);
+            int value_size = snprintf(value, sizeof(value), "value-%06d-%032d", id, id);
+            result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree), "Failed to flush LSM memtable");
+        }
+    }
+
+    // 读取全部键：每个文件都要打开，表缓存只保留两个
+    for (int id = 0; id < 6000 && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "cch%06d", id);
+        int expected_size = snprintf(value, sizeof(value), "value-%06d-%032d", id, id);
+        uint32_t value_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &value_size);
+        result = test_assert_true(found && value_size == (uint32_t)expected_size && memcmp(found, value, value_size) == 0,
+                                  "LSM lookup returned wrong value");
+        free(found);
+    }
+    lsm_cache_stats block_stats;
+    lsm_cache_stats table_stats;
+    if (result == SUCCESS) {
+        lsm_tree_get_cache_stats(tree, &block_stats, &table_stats);
+        result = test_assert_true(table_stats.entry_count <= 2 && table_stats.misses > 0, "Table cache exceeded its capacity");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(block_stats.usage <= block_stats.capacity && block_stats.hits > 0, "Block cache exceeded its capacity");
+    }
+
+    // 热点键只在第一次读取时未命中
+    uint64_t misses = block_stats.misses;
+    uint64_t hits = block_stats.hits;
+    for (int i = 0; i < 100 && result == SUCCESS; i++) {
+        uint32_t value_size = 0;
+        char *found = lsm_tree_get(tree, "cch002999", 9, &value_size);
+        result = test_assert_not_null(found, "LSM lookup failed");
+        free(found);
+    }
+    if (result == SUCCESS) {
+        lsm_tree_get_cache_stats(tree, &block_stats, &table_stats);
+        result = test_assert_true(block_stats.misses - misses <= 1 && block_stats.hits - hits >= 99, "Hot block was not cached");
+    }
+
+    monitoring_system *monitoring = monitoring_init(NULL);
+    if (result == SUCCESS) {
+        result = test_assert_not_null(monitoring, "Failed to create monitoring system");
+    }
+    if (result == SUCCESS) {
+        monitoring_record_cache(monitoring, "lsm.block_cache", block_stats.hits, block_stats.misses, block_stats.usage);
+        double hit_rate = 0;
+        result = test_assert_true(monitoring_get_stat(monitoring, "lsm.block_cache.hit_rate", &hit_rate) && hit_rate > 0 && hit_rate <= 1,
+                                  "Block cache hit rate not exported");
+    }
+    monitoring_destroy(monitoring);
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+#define LSM_COMPRESSION_KEY_COUNT 4000
+
+// 压缩算法往返，以及三种压缩方式写出的文件大小和读取结果
+static int test_lsm_tree_compression(void) {
+    static const compression_codec codecs[] = {COMPRESSION_FAST, COMPRESSION_HIGH};
+    char text[8192];
+    char output[8192 + 64];
+    char restored[8192];
+    for (uint32_t i = 0; i < sizeof(text); i++) {
+        // 前半部分是重复的文本，后半部分是伪随机字节（不可压缩）
+        text[i] = i < sizeof(text) / 2 ? "row engine, column engine, lsm tree "[i % 36] : (char)((i * 2654435761U) >> 13);
+    }
+    int result = SUCCESS;
+    for (uint32_t i = 0; i < 2 && result == SUCCESS; i++) {
+        size_t size = compression_compress(codecs[i], text, sizeof(text), output, compression_bound(sizeof(text)));
+        result = test_assert_true(size > 0 && size < sizeof(text) && compression_decompress(codecs[i], output, size, restored, sizeof(restored)) &&
+                                  memcmp(text, restored, sizeof(text)) == 0, "Compression roundtrip failed");
+        if (result == SUCCESS) {
+            result = test_assert_true(!compression_decompress(codecs[i], output, size - 1, restored, sizeof(restored)),
+                                      "Truncated compressed data was accepted");
+        }
+    }
+
+    static const lsm_compression modes[] = {LSM_COMPRESSION_NONE, LSM_COMPRESSION_FAST, LSM_COMPRESSION_HIGH};
+    uint64_t file_sizes[3] = {0, 0, 0};
+    for (int mode = 0; mode < 3 && result == SUCCESS; mode++) {
+        char directory[] = "/tmp/lsm_compression_XXXXXX";
+        if (!mkdtemp(directory)) {
+            return ERROR_FAIL;
+        }
+        lsm_tree_config config;
+        memset(&config, 0, sizeof(config));
+        for (int level = 0; level < LSM_SSTABLE_LEVELS; level++) {
+            config.compression[level] = modes[mode];
+        }
+        lsm_tree *tree = lsm_tree_create_with_config(directory, &config);
+        result = test_assert_not_null(tree, "Failed to create LSM tree");
+        if (result != SUCCESS) {
+            test_remove_directory(directory);
+            return result;
+        }
+
+        char key[32];
+        char value[128];
+        for (int id = 0; id < LSM_COMPRESSION_KEY_COUNT && result == SUCCESS; id++) {
+            int key_size = snprintf(key, sizeof(key), "cmp%06d", id);
+            int value_size = snprintf(value, sizeof(value), "customer-%d status=active region=north tier=gold notes=none", id % 50);
+            result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+        }
+        if (result == SUCCESS) {
+            result = test_assert_true(lsm_tree_flush(tree) && tree->sstable_counts[0] == 1, "Failed to flush LSM memtable");
+        }
+        if (result == SUCCESS) {
+            file_sizes[mode] = tree->sstables[0][0]->file_size;
+        }
+        for (int id = 0; id < LSM_COMPRESSION_KEY_COUNT && result == SUCCESS; id += 7) {
+            int key_size = snprintf(key, sizeof(key), "cmp%06d", id);
+            int expected_size = snprintf(value, sizeof(value), "customer-%d status=active region=north tier=gold notes=none", id % 50);
+            uint32_t value_size = 0;
+            char *found = lsm_tree_get(tree, key, key_size, &value_size);
+            result = test_assert_true(found && value_size == (uint32_t)expected_size && memcmp(found, value, value_size) == 0,
+                                      "LSM lookup returned wrong value");
+            free(found);
+        }
+        lsm_tree_destroy(tree);
+        test_remove_directory(directory);
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(file_sizes[1] < file_sizes[0] / 2 && file_sizes[2] <= file_sizes[1], "SSTable blocks were not compressed");
+    }
+    return result;
+}
+
+static int test_lsm_tree_recovery(void) {
+    char directory[] = "/tmp/lsm_recovery_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+
+    // 分批刷写（触发压缩），最后一批留在内存表中，关闭时刷写
+    char key[32];
+    char value[128];
+    for (int id = 0; id < LSM_TEST_KEY_COUNT && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%0100d", id);
+        result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+        if (result == SUCCESS && id % 3000 == 2999) {
+            result = test_assert_true(lsm_tree_flush(tree), "Failed to flush LSM memtable");
+        }
+    }
+    uint64_t next_file_number = tree ? tree->next_file_number : 0;
+    lsm_tree_destroy(tree);
+    tree = NULL;
+
+    // 崩溃留下的未记录文件和MANIFEST末尾不完整的记录在恢复时丢弃
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%06llu.sst", directory, (unsigned long long)next_file_number + 100);
+    FILE *file = fopen(path, "w");
+    if (file) {
+        fputs("orphan", file);
+        fclose(file);
+    }
+    char manifest[64] = "";
+    snprintf(value, sizeof(value), "%s/CURRENT", directory);
+    file = fopen(value, "r");
+    if (file) {
+        if (!fgets(manifest, sizeof(manifest), file)) {
+            manifest[0] = '\0';
+        }
+        fclose(file);
+    }
+    manifest[strcspn(manifest, "\n")] = '\0';
+    snprintf(value, sizeof(value), "%s/%s", directory, manifest);
+    file = fopen(value, "ab");
+    if (result == SUCCESS) {
+        result = test_assert_true(file && fwrite("torn", 4, 1, file) == 1, "Failed to find LSM manifest");
+    }
+    if (file) {
+        fclose(file);
+    }
+
+    if (result == SUCCESS) {
+        tree = lsm_tree_create(directory);
+        result = test_assert_not_null(tree, "Failed to reopen LSM tree");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(tree->sstable_counts[1] > 0 && tree->next_file_number >= next_file_number &&
+                                  access(path, F_OK) != 0, "LSM version set was not recovered");
+    }
+    if (result == SUCCESS) {
+        result = lsm_tree_check_keys(tree, LSM_TEST_KEY_COUNT);
+    }
+
+    // 恢复后继续写入，再次打开
+    for (int id = LSM_TEST_KEY_COUNT; id < LSM_TEST_KEY_COUNT + 1000 && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%05d", id);
+        int value_size = snprintf(value, sizeof(value), "%0100d", id);
+        result = test_assert_true(lsm_tree_insert(tree, key, key_size, value, value_size), "Failed to insert LSM key");
+    }
+    lsm_tree_destroy(tree);
+    tree = NULL;
+    if (result == SUCCESS) {
+        tree = lsm_tree_create(directory);
+        result = test_assert_not_null(tree, "Failed to reopen LSM tree");
+    }
+    if (result == SUCCESS) {
+        result = lsm_tree_check_keys(tree, LSM_TEST_KEY_COUNT + 1000);
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+typedef struct {
+    lsm_tree *tree;
+    int first_id;
+    int failures;
+} lsm_tree_writer_context;
+
+#define LSM_BACKGROUND_KEY_COUNT 20000
+
+static void *lsm_tree_background_writer(void *arg) {
+    lsm_tree_writer_context *context = (lsm_tree_writer_context *)arg;
+    char key[32];
+    char value[1024];
+    for (int i = 0; i < LSM_BACKGROUND_KEY_COUNT; i++) {
+        int id = context->first_id + i * 2;
+        int key_size = snprintf(key, sizeof(key), "key%06d", id);
+        memset(value, 'a' + id % 26, sizeof(value));
+        if (!lsm_tree_insert(context->tree, key, key_size, value, sizeof(value))) {
+            context->failures++;
+        }
+    }
+    return NULL;
+}
+
+static int test_lsm_tree_background(void) {
+    char directory[] = "/tmp/lsm_background_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+    lsm_tree *tree = lsm_tree_create(directory);
+    int result = test_assert_not_null(tree, "Failed to create LSM tree");
+
+    // 两个写入者共写入约40MB，内存表写满后由后台线程刷写和压缩
+    lsm_tree_writer_context contexts[2];
+    pthread_t threads[2];
+    for (int i = 0; i < 2 && result == SUCCESS; i++) {
+        contexts[i].tree = tree;
+        contexts[i].first_id = i;
+        contexts[i].failures = 0;
+        result = test_assert_true(pthread_create(&threads[i], NULL, lsm_tree_background_writer, &contexts[i]) == 0,
+                                  "Failed to start LSM writer");
+        if (result == SUCCESS && i == 1) {
+            pthread_join(threads[0], NULL);
+            pthread_join(threads[1], NULL);
+            result = test_assert_true(contexts[0].failures == 0 && contexts[1].failures == 0, "LSM writer failed");
+        }
+    }
+
+    lsm_tree_stats stats;
+    if (result == SUCCESS) {
+        lsm_tree_get_stats(tree, &stats);
+        result = test_assert_true(stats.flushes >= 3, "Full memtables were not flushed in the background");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(lsm_tree_flush(tree) && lsm_tree_compact(tree), "Failed to wait for background compaction");
+    }
+    if (result == SUCCESS) {
+        lsm_tree_get_stats(tree, &stats);
+        result = test_assert_true(stats.compactions > 0 && tree->sstable_counts[0] < LSM_L0_COMPACTION_TRIGGER &&
+                                  tree->sstable_counts[1] > 0, "Level 0 was not compacted in the background");
+    }
+
+    char key[32];
+    for (int id = 0; id < LSM_BACKGROUND_KEY_COUNT * 2 && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "key%06d", id);
+        uint32_t found_size = 0;
+        char *found = lsm_tree_get(tree, key, key_size, &found_size);
+        result = test_assert_true(found && found_size == 1024 && found[0] == 'a' + id % 26 && found[1023] == found[0],
+                                  "Background flushed lookup failed");
+        free(found);
+    }
+
+    lsm_tree_destroy(tree);
+    test_remove_directory(directory);
+    return result;
+}
+
+typedef struct {
+    BPlusTree *tree;
+    int64_t first_key;
+    int *writers_done;
+    int failures;
+} b_plus_tree_stress_context;
+
+#define B_PLUS_TREE_STRESS_KEYS 20000
+
+static void *b_plus_tree_stress_writer(void *arg) {
+    b_plus_tree_stress_context *context = (b_plus_tree_stress_context *)arg;
+    // 插入后删除其中一半，使分裂和合并都与读者竞争
+    for (int64_t i = 0; i < B_PLUS_TREE_STRESS_KEYS; i++) {
+        int64_t key = context->first_key + i;
+        if (!b_plus_tree_insert(context->tree, &key, (void *)(intptr_t)(key + 1))) {
+            context->failures++;
+        }
+    }
+    for (int64_t i = 0; i < B_PLUS_TREE_STRESS_KEYS; i += 2) {
+        int64_t key = context->first_key + i;
+        if (!b_plus_tree_delete(context->tree, &key)) {
+            context->failures++;
+        }
+    }
+    __sync_fetch_and_add(context->writers_done, 1);
+    return NULL;
+}
+
+static void *b_plus_tree_stress_reader(void *arg) {
+    b_plus_tree_stress_context *context = (b_plus_tree_stress_context *)arg;
+    int64_t key = 0;
+    while (__atomic_load_n(context->writers_done, __ATOMIC_ACQUIRE) < STRESS_WRITER_COUNT) {
+        // 查到的值必须与键对应，不能读到分裂或合并过程中的中间状态
+        void *value = b_plus_tree_find(context->tree, &key);
+        if (value && value != (void *)(intptr_t)(key + 1)) {
+            context->failures++;
+        }
+        key = (key + 7919) % (STRESS_WRITER_COUNT * B_PLUS_TREE_STRESS_KEYS);
+    }
+    return NULL;
+}
+
+static int test_b_plus_tree_concurrency(void) {
+    BPlusTree *tree = b_plus_tree_create_fixed(BPLUS_TREE_KEY_INT64, 0, 512, NULL);
+    if (!tree) {
+        return ERROR_FAIL;
+    }
+
+    int writers_done = 0;
+    b_plus_tree_stress_context contexts[STRESS_WRITER_COUNT + STRESS_READER_COUNT];
+    pthread_t threads[STRESS_WRITER_COUNT + STRESS_READER_COUNT];
+    for (int i = 0; i < STRESS_WRITER_COUNT + STRESS_READER_COUNT; i++) {
+        contexts[i].tree = tree;
+        contexts[i].first_key = (int64_t)i * B_PLUS_TREE_STRESS_KEYS;
+        contexts[i].writers_done = &writers_done;
+        contexts[i].failures = 0;
+        pthread_create(&threads[i], NULL, i < STRESS_WRITER_COUNT ? b_plus_tree_stress_writer : b_plus_tree_stress_reader, &contexts[i]);
+    }
+
+    int failures = 0;
+    for (int i = 0; i < STRESS_WRITER_COUNT + STRESS_READER_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+        failures += contexts[i].failures;
+    }
+    int result = test_assert_equal(0, failures, "Concurrent B+ tree operation failed");
+
+    // 所有写线程结束后，奇数键全部保留，偶数键全部删除
+    for (int64_t key = 0; result == SUCCESS && key < STRESS_WRITER_COUNT * B_PLUS_TREE_STRESS_KEYS; key++) {
+        void *expected = key % 2 ? (void *)(intptr_t)(key + 1) : NULL;
+        result = test_assert_true(b_plus_tree_find(tree, &key) == expected, "B+ tree lost or kept a key under concurrency");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(STRESS_WRITER_COUNT * B_PLUS_TREE_STRESS_KEYS / 2, (int)b_plus_tree_key_count(tree),
+                                   "Wrong B+ tree key count under concurrency");
+    }
+
+    b_plus_tree_destroy(tree);
+    return result;
+}
+
+#define HASH_INDEX_TEST_KEYS 50000
+
+// 按编号生成值：偶数编号的键值可以内联，奇数编号的存在单独的内存中；version改变值的长度
+static int hash_index_test_value(char *value, size_t capacity, int id, int version) {
+    return snprintf(value, capacity, id % 2 ? "external-value-%d-%d-padding-padding" : "v%d.%d", id, version);
+}
+
+// 从很小的初始容量开始插入（多次扩容和渐进迁移），更新时在内联和单独存储之间切换，删除后再插入
+static int test_hash_index(void) {
+    hash_index *index = hash_index_create(16);
+    int result = test_assert_not_null(index, "Failed to create hash index");
+    char key[32];
+    char value[64];
+    for (int id = 0; id < HASH_INDEX_TEST_KEYS && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "hix%06d", id);
+        int value_size = hash_index_test_value(value, sizeof(value), id, 0);
+        result = test_assert_true(hash_index_insert(index, key, key_size, value, value_size), "Failed to insert hash index key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(hash_index_size(index) == HASH_INDEX_TEST_KEYS && index->table.capacity >= HASH_INDEX_TEST_KEYS,
+                                  "Hash index did not grow");
+    }
+
+    // 每三个键更新一个，偶数编号的键删除
+    for (int id = 0; id < HASH_INDEX_TEST_KEYS && result == SUCCESS; id += 3) {
+        int key_size = snprintf(key, sizeof(key), "hix%06d", id);
+        int value_size = hash_index_test_value(value, sizeof(value), id + 1, 1);
+        result = test_assert_true(hash_index_insert(index, key, key_size, value, value_size), "Failed to update hash index key");
+    }
+    for (int id = 0; id < HASH_INDEX_TEST_KEYS && result == SUCCESS; id += 2) {
+        int key_size = snprintf(key, sizeof(key), "hix%06d", id);
+        result = test_assert_true(hash_index_delete(index, key, key_size), "Failed to delete hash index key");
+    }
+    for (int id = 0; id < HASH_INDEX_TEST_KEYS && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "hix%06d", id);
+        int expected_size = id % 3 == 0 ? hash_index_test_value(value, sizeof(value), id + 1, 1)
+                                         : hash_index_test_value(value, sizeof(value), id, 0);
+        uint32_t value_size = 0;
+        char *found = hash_index_get(index, key, key_size, &value_size);
+        if (id % 2 == 0) {
+            result = test_assert_true(found == NULL, "Deleted hash index key still found");
+        } else {
+            result = test_assert_true(found && value_size == (uint32_t)expected_size && memcmp(found, value, value_size) == 0,
+                                      "Hash index returned wrong value");
+        }
+        free(found);
+    }
+
+    // 删除留下的槽位被重新使用
+    for (int id = 0; id < HASH_INDEX_TEST_KEYS && result == SUCCESS; id += 2) {
+        int key_size = snprintf(key, sizeof(key), "hix%06d", id);
+        result = test_assert_true(hash_index_insert(index, key, key_size, key, key_size), "Failed to reinsert hash index key");
+    }
+    if (result == SUCCESS) {
+        uint32_t value_size = 0;
+        char *found = hash_index_get(index, "hix000010", 9, &value_size);
+        result = test_assert_true(found && value_size == 9 && memcmp(found, "hix000010", 9) == 0 &&
+                                  hash_index_size(index) == HASH_INDEX_TEST_KEYS && !hash_index_delete(index, "absent", 6),
+                                  "Hash index lost a reinserted key");
+        free(found);
+    }
+
+    hash_index_destroy(index);
+    return result;
+}
+
+#define CONCURRENT_HASH_TEST_KEYS 100000
+#define CONCURRENT_HASH_TEST_OPS 400000
+#define CONCURRENT_HASH_TEST_THREADS 4
+
+typedef struct {
+    concurrent_hash_index *index;
+    int thread_id;
+    int thread_count;
+    int failures;
+} concurrent_hash_test_context;
+
+// 90%查询、10%更新（值不变，查询结果总是确定的）
+static void *concurrent_hash_lookup_worker(void *arg) {
+    concurrent_hash_test_context *context = (concurrent_hash_test_context *)arg;
+    uint32_t state = (uint32_t)context->thread_id * 2654435761U + 1;
+    char key[32];
+    for (int i = 0; i < CONCURRENT_HASH_TEST_OPS / context->thread_count; i++) {
+        state = state * 1664525U + 1013904223U;
+        int id = (int)((state >> 8) % CONCURRENT_HASH_TEST_KEYS);
+        int key_size = snprintf(key, sizeof(key), "chx%06d", id);
+        if (state % 10 == 0) {
+            if (!concurrent_hash_index_insert(context->index, key, key_size, key, key_size)) {
+                context->failures++;
+            }
+            continue;
+        }
+        uint32_t value_size = 0;
+        char *value = concurrent_hash_index_get(context->index, key, key_size, &value_size);
+        if (!value || value_size != (uint32_t)key_size || memcmp(value, key, value_size) != 0) {
+            context->failures++;
+        }
+        free(value);
+    }
+    return NULL;
+}
+
+// 每个线程插入自己的一段键（各分片并发扩容），再删除其中的偶数编号
+static void *concurrent_hash_churn_worker(void *arg) {
+    concurrent_hash_test_context *context = (concurrent_hash_test_context *)arg;
+    char key[32];
+    for (int id = context->thread_id; id < CONCURRENT_HASH_TEST_KEYS; id += context->thread_count) {
+        int key_size = snprintf(key, sizeof(key), "new%06d", id);
+        if (!concurrent_hash_index_insert(context->index, key, key_size, key, key_size)) {
+            context->failures++;
+        }
+    }
+    for (int id = context->thread_id; id < CONCURRENT_HASH_TEST_KEYS; id += context->thread_count) {
+        int key_size = snprintf(key, sizeof(key), "new%06d", id);
+        if (id % 2 == 0 && !concurrent_hash_index_delete(context->index, key, key_size)) {
+            context->failures++;
+        }
+    }
+    return NULL;
+}
+
+static int concurrent_hash_run_threads(concurrent_hash_index *index, void *(*worker)(void *)) {
+    concurrent_hash_test_context contexts[CONCURRENT_HASH_TEST_THREADS];
+    pthread_t threads[CONCURRENT_HASH_TEST_THREADS];
+    for (int i = 0; i < CONCURRENT_HASH_TEST_THREADS; i++) {
+        contexts[i].index = index;
+        contexts[i].thread_id = i;
+        contexts[i].thread_count = CONCURRENT_HASH_TEST_THREADS;
+        contexts[i].failures = 0;
+        pthread_create(&threads[i], NULL, worker, &contexts[i]);
+    }
+    int failures = 0;
+    for (int i = 0; i < CONCURRENT_HASH_TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        failures += contexts[i].failures;
+    }
+    return failures;
+}
+
+// 并发哈希索引：多个线程同时查询和更新，以及并发插入删除后的内容
+static int test_concurrent_hash_index(void) {
+    concurrent_hash_index *index = concurrent_hash_index_create(0);
+    int result = test_assert_not_null(index, "Failed to create concurrent hash index");
+    char key[32];
+    for (int id = 0; id < CONCURRENT_HASH_TEST_KEYS && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "chx%06d", id);
+        result = test_assert_true(concurrent_hash_index_insert(index, key, key_size, key, key_size), "Failed to insert hash index key");
+    }
+
+    if (result == SUCCESS) {
+        result = test_assert_equal(0, concurrent_hash_run_threads(index, concurrent_hash_lookup_worker),
+                                   "Concurrent hash index lookup failed");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_equal(0, concurrent_hash_run_threads(index, concurrent_hash_churn_worker),
+                                   "Concurrent hash index insert or delete failed");
+    }
+    for (int id = 0; id < CONCURRENT_HASH_TEST_KEYS && result == SUCCESS; id++) {
+        int key_size = snprintf(key, sizeof(key), "new%06d", id);
+        uint32_t value_size = 0;
+        char *value = concurrent_hash_index_get(index, key, key_size, &value_size);
+        result = test_assert_true(id % 2 ? value != NULL : value == NULL, "Concurrent hash index lost or kept a key");
+        free(value);
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(concurrent_hash_index_size(index) == CONCURRENT_HASH_TEST_KEYS + CONCURRENT_HASH_TEST_KEYS / 2,
+                                  "Wrong concurrent hash index size");
+    }
+
+    concurrent_hash_index_destroy(index);
+    return result;
+}
+
+// 磁盘哈希索引测试：子进程写入后不关闭直接退出，重新打开时按日志恢复
+#define DISK_HASH_TEST_KEY_COUNT 6000
+#define DISK_HASH_TEST_CHECKPOINT_KEYS 5000
+// 512字节页面，每页30个条目，一个桶最多放满DISK_HASH_INDEX_MAX_CHAIN页
+#define DISK_HASH_TEST_PAGE_SIZE 512
+#define DISK_HASH_TEST_PAGE_ENTRIES 30
+#define DISK_HASH_TEST_CHAIN_KEYS (DISK_HASH_INDEX_MAX_CHAIN * DISK_HASH_TEST_PAGE_ENTRIES)
+
+static DiskHashIndex *test_disk_hash_index_open(const char *directory, uint32_t initial_buckets, WriteAheadLog **wal) {
+    WalConfig wal_config = {directory, 1024 * 1024, 4 * 1024 * 1024, 0};
+    *wal = wal_open(&wal_config);
+    if (!*wal) {
+        return NULL;
+    }
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/hash.db", directory);
+    // 小页面和少量帧，让写入期间不断分裂桶并淘汰页面
+    DiskHashIndexConfig config = {path, "test_hash", 0, DISK_HASH_TEST_PAGE_SIZE, initial_buckets, 64, *wal};
+    DiskHashIndex *index = disk_hash_index_open(&config);
+    if (!index) {
+        wal_close(*wal);
+        *wal = NULL;
+    }
+    return index;
+}
+
+static int test_disk_hash_index_verify(DiskHashIndex *index) {
+    int result = SUCCESS;
+    for (int64_t key = 0; key < DISK_HASH_TEST_KEY_COUNT && result == SUCCESS; key++) {
+        uint64_t value = 0;
+        bool expected = key >= DISK_HASH_TEST_CHECKPOINT_KEYS || key % 3 != 0;
+        bool found = disk_hash_index_find(index, &key, &value);
+        result = test_assert_true(found == expected && (!found || value == (uint64_t)key + 1),
+                                  "Disk hash index lost or kept a key after reopen");
+    }
+    return result;
+}
+
+static int test_disk_hash_index_persistence(void) {
+    char directory[] = "/tmp/disk_hash_index_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        WriteAheadLog *wal = NULL;
+        DiskHashIndex *index = test_disk_hash_index_open(directory, 4, &wal);
+        bool success = index != NULL;
+        for (int64_t key = 0; key < DISK_HASH_TEST_CHECKPOINT_KEYS && success; key++) {
+            success = disk_hash_index_insert(index, &key, (uint64_t)key + 1);
+        }
+        for (int64_t key = 0; key < DISK_HASH_TEST_CHECKPOINT_KEYS && success; key += 3) {
+            success = disk_hash_index_delete(index, &key);
+        }
+        success = success && disk_hash_index_checkpoint(index);
+        for (int64_t key = DISK_HASH_TEST_CHECKPOINT_KEYS; key < DISK_HASH_TEST_KEY_COUNT && success; key++) {
+            success = disk_hash_index_insert(index, &key, (uint64_t)key + 1);
+        }
+        success = success && wal_flush(wal, wal_current_lsn(wal));
+        _exit(success ? 0 : 1);
+    }
+
+    int status = -1;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    int result = test_assert_true(pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                                  "Disk hash index writer process failed");
+
+    WriteAheadLog *wal = NULL;
+    DiskHashIndex *index = result == SUCCESS ? test_disk_hash_index_open(directory, 4, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(index, "Failed to recover disk hash index");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_hash_index_bucket_count(index) > 4, "Disk hash index did not split");
+    }
+    if (result == SUCCESS) {
+        result = test_disk_hash_index_verify(index);
+    }
+
+    // 正常关闭后重新打开，缓冲池为空时每次查找平均读入的页数接近1
+    disk_hash_index_close(index);
+    wal_close(wal);
+    wal = NULL;
+    index = result == SUCCESS ? test_disk_hash_index_open(directory, 4, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(index, "Failed to reopen disk hash index");
+    }
+    if (result == SUCCESS) {
+        result = test_disk_hash_index_verify(index);
+    }
+    if (result == SUCCESS) {
+        BufferPoolStats stats;
+        buffer_pool_get_stats(index->file.pool, &stats);
+        result = test_assert_true(stats.misses < DISK_HASH_TEST_KEY_COUNT * 3 / 2, "Disk hash index reads too many pages per lookup");
+    }
+
+    for (int64_t key = 0; key < DISK_HASH_TEST_KEY_COUNT && result == SUCCESS; key++) {
+        bool expected = key >= DISK_HASH_TEST_CHECKPOINT_KEYS || key % 3 != 0;
+        result = test_assert_true(disk_hash_index_delete(index, &key) == expected, "Failed to delete disk hash index key");
+    }
+    for (int64_t key = 0; key < DISK_HASH_TEST_KEY_COUNT && result == SUCCESS; key++) {
+        result = test_assert_true(!disk_hash_index_find(index, &key, NULL), "Disk hash index kept a deleted key");
+    }
+    disk_hash_index_close(index);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 溢出页链表：哈希值低8位都为0的键在桶数达到256之前都落在第0个桶中。删空的溢出页放回空闲页链表，
+// 再次插入时复用；桶的页数达到上限后分裂不能分开这些键，插入失败但索引仍然可写
+static int test_disk_hash_index_overflow(void) {
+    char directory[] = "/tmp/disk_hash_index_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    int64_t keys[DISK_HASH_TEST_CHAIN_KEYS + 1];
+    int64_t other = -1;
+    int found = 0;
+    for (int64_t key = 0; found <= DISK_HASH_TEST_CHAIN_KEYS || other < 0; key++) {
+        if ((hash64(&key, sizeof(key), 0) & 0xFF) != 0) {
+            other = other < 0 ? key : other;
+        } else if (found <= DISK_HASH_TEST_CHAIN_KEYS) {
+            keys[found++] = key;
+        }
+    }
+
+    // 64个初始桶：插入期间的分裂都在第一轮之内，不会预留新的页面
+    WriteAheadLog *wal = NULL;
+    DiskHashIndex *index = test_disk_hash_index_open(directory, 64, &wal);
+    int result = test_assert_not_null(index, "Failed to open disk hash index");
+    for (int i = 0; i < DISK_HASH_TEST_CHAIN_KEYS && result == SUCCESS; i++) {
+        result = test_assert_true(disk_hash_index_insert(index, &keys[i], (uint64_t)i), "Failed to insert colliding key");
+    }
+    for (int i = 0; i < DISK_HASH_TEST_CHAIN_KEYS && result == SUCCESS; i++) {
+        result = test_assert_true(disk_hash_index_delete(index, &keys[i]), "Failed to delete colliding key");
+    }
+    uint64_t page_count = disk_hash_index_page_count(index);
+    for (int i = 0; i < DISK_HASH_TEST_CHAIN_KEYS && result == SUCCESS; i++) {
+        result = test_assert_true(disk_hash_index_insert(index, &keys[i], (uint64_t)i), "Failed to reinsert colliding key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_hash_index_page_count(index) == page_count, "Disk hash index did not reuse free pages");
+    }
+
+    // 桶已满：分裂直到这个桶被分裂之后放弃
+    if (result == SUCCESS) {
+        result = test_assert_true(!disk_hash_index_insert(index, &keys[DISK_HASH_TEST_CHAIN_KEYS], 0),
+                                  "Disk hash index grew a bucket beyond its page limit");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(disk_hash_index_insert(index, &other, 1), "Disk hash index rejected a write after a full bucket");
+    }
+
+    disk_hash_index_close(index);
+    wal_close(wal);
+    wal = NULL;
+    index = result == SUCCESS ? test_disk_hash_index_open(directory, 64, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(index, "Failed to reopen disk hash index");
+    }
+    for (int i = 0; i < DISK_HASH_TEST_CHAIN_KEYS && result == SUCCESS; i++) {
+        uint64_t value = 0;
+        result = test_assert_true(disk_hash_index_find(index, &keys[i], &value) && value == (uint64_t)i,
+                                  "Disk hash index lost a colliding key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(!disk_hash_index_find(index, &keys[DISK_HASH_TEST_CHAIN_KEYS], NULL) &&
+                                  disk_hash_index_find(index, &other, NULL), "Disk hash index kept the wrong keys");
+    }
+    disk_hash_index_close(index);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
+// 日志写入失败后磁盘哈希索引只读，没有日志的页面不写回，重新打开时恢复到失败之前的内容
+static int test_disk_hash_index_log_failure(void) {
+    char directory[] = "/tmp/disk_hash_index_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return ERROR_FAIL;
+    }
+
+    WriteAheadLog *wal = NULL;
+    DiskHashIndex *index = test_disk_hash_index_open(directory, 4, &wal);
+    int result = test_assert_not_null(index, "Failed to open disk hash index");
+    for (int64_t key = 0; key < DISK_HASH_TEST_CHECKPOINT_KEYS && result == SUCCESS; key++) {
+        result = test_assert_true(disk_hash_index_insert(index, &key, (uint64_t)key + 1), "Failed to insert disk hash index key");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(wal_flush(wal, wal_current_lsn(wal)), "Failed to flush WAL");
+    }
+
+    // 段文件换成只读的文件描述符后日志写盘失败
+    int fd = open("/dev/null", O_RDONLY);
+    if (result == SUCCESS) {
+        result = test_assert_true(fd >= 0 && dup2(fd, wal->segment_fd) >= 0, "Failed to replace WAL segment");
+    }
+    if (result == SUCCESS) {
+        result = test_assert_true(!wal_commit(wal, 1), "WAL commit succeeded after a write error");
+    }
+    int64_t key = DISK_HASH_TEST_CHECKPOINT_KEYS;
+    if (result == SUCCESS) {
+        result = test_assert_true(!disk_hash_index_insert(index, &key, (uint64_t)key + 1), "Disk hash index accepted a write without a log");
+    }
+    if (result == SUCCESS) {
+        key = 0;
+        result = test_assert_true(!disk_hash_index_delete(index, &key), "Disk hash index accepted a delete after a log failure");
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    disk_hash_index_close(index);
+    wal_close(wal);
+
+    wal = NULL;
+    index = result == SUCCESS ? test_disk_hash_index_open(directory, 4, &wal) : NULL;
+    if (result == SUCCESS) {
+        result = test_assert_not_null(index, "Failed to recover disk hash index");
+    }
+    for (key = 0; key < DISK_HASH_TEST_CHECKPOINT_KEYS && result == SUCCESS; key++) {
+        uint64_t value = 0;
+        result = test_assert_true(disk_hash_index_find(index, &key, &value) && value == (uint64_t)key + 1,
+                                  "Disk hash index lost a logged key");
+    }
+    if (result == SUCCESS) {
+        key = DISK_HASH_TEST_CHECKPOINT_KEYS;
+        result = test_assert_true(!disk_hash_index_find(index, &key, NULL), "Disk hash index kept an unlogged key");
+    }
+    disk_hash_index_close(index);
+    wal_close(wal);
+    test_remove_directory(directory);
+    return result;
+}
+
 // 安全测试
 static int test_security_create(void) {
     security_system *security = security_init();
@@ -386,10 +3064,44 @@ int main(int argc, char *argv[]) {
     // 存储测试
     test_suite *storage_suite = test_runner_add_suite(runner, "Storage");
     test_suite_add_test(storage_suite, "create", test_storage_engine_create);
+    test_suite_add_test(storage_suite, "scan", test_storage_engine_scan);
+    test_suite_add_test(storage_suite, "scan_engines", test_storage_engine_scan_engines);
+    test_suite_add_test(storage_suite, "select_view", test_storage_engine_select_view);
+    test_suite_add_test(storage_suite, "concurrency", test_storage_engine_concurrency);
+    test_suite_add_test(storage_suite, "wal_group_commit", test_storage_engine_wal_group_commit);
+    test_suite_add_test(storage_suite, "wal_recovery", test_storage_engine_wal_recovery);
+    test_suite_add_test(storage_suite, "wal_write_failure", test_storage_engine_wal_write_failure);
+    test_suite_add_test(storage_suite, "optimize_transaction", test_storage_engine_optimize_transaction);
+    test_suite_add_test(storage_suite, "rollback_without_wal", test_storage_engine_rollback_without_wal);
+    test_suite_add_test(storage_suite, "checkpoint_recovery", test_storage_engine_checkpoint_recovery);
 
     // 索引测试
     test_suite *index_suite = test_runner_add_suite(runner, "Index");
     test_suite_add_test(index_suite, "b_plus_tree_create", test_b_plus_tree_create);
+    test_suite_add_test(index_suite, "b_plus_tree_fixed_keys", test_b_plus_tree_fixed_keys);
+    test_suite_add_test(index_suite, "b_plus_tree_concurrency", test_b_plus_tree_concurrency);
+    test_suite_add_test(index_suite, "b_plus_tree_cursor", test_b_plus_tree_cursor);
+    test_suite_add_test(index_suite, "b_plus_tree_bulk_load", test_b_plus_tree_bulk_load);
+    test_suite_add_test(index_suite, "b_plus_tree_variable_keys", test_b_plus_tree_variable_keys);
+    test_suite_add_test(index_suite, "disk_b_plus_tree_persistence", test_disk_b_plus_tree_persistence);
+    test_suite_add_test(index_suite, "disk_b_plus_tree_log_failure", test_disk_b_plus_tree_log_failure);
+    test_suite_add_test(index_suite, "disk_b_plus_tree_shared_wal", test_disk_b_plus_tree_shared_wal);
+    test_suite_add_test(index_suite, "lsm_tree_memtable", test_lsm_tree_memtable);
+    test_suite_add_test(index_suite, "lsm_tree_sstable", test_lsm_tree_sstable);
+    test_suite_add_test(index_suite, "lsm_tree_compaction", test_lsm_tree_compaction);
+    test_suite_add_test(index_suite, "lsm_tree_snapshots", test_lsm_tree_snapshots);
+    test_suite_add_test(index_suite, "lsm_tree_iterator", test_lsm_tree_iterator);
+    test_suite_add_test(index_suite, "lsm_tree_bloom_filters", test_lsm_tree_bloom_filters);
+    test_suite_add_test(index_suite, "blocked_bloom_filter", test_blocked_bloom_filter);
+    test_suite_add_test(index_suite, "lsm_tree_caches", test_lsm_tree_caches);
+    test_suite_add_test(index_suite, "lsm_tree_compression", test_lsm_tree_compression);
+    test_suite_add_test(index_suite, "lsm_tree_background", test_lsm_tree_background);
+    test_suite_add_test(index_suite, "lsm_tree_recovery", test_lsm_tree_recovery);
+    test_suite_add_test(index_suite, "hash_index", test_hash_index);
+    test_suite_add_test(index_suite, "concurrent_hash_index", test_concurrent_hash_index);
+    test_suite_add_test(index_suite, "disk_hash_index_persistence", test_disk_hash_index_persistence);
+    test_suite_add_test(index_suite, "disk_hash_index_overflow", test_disk_hash_index_overflow);
+    test_suite_add_test(index_suite, "disk_hash_index_log_failure", test_disk_hash_index_log_failure);
 
     // 安全测试
     test_suite *security_suite = test_runner_add_suite(runner, "Security");